@@ -22,6 +22,7 @@
 #include <framework/array.h>
 #include <framework/common.h>
 #include <framework/window.h>
+#include <framework/shared_mutex.h>
 
 #include <foundation/memory.h>
 #include <foundation/version.h>
@@ -59,6 +60,7 @@ struct app_input_dialog_t
 struct app_menu_t
 {
     hash_t context;
+    int order{ 0 };
     char path[128]{ 0 };
     char shortcut[16]{ 0 };
     string_t* paths{ nullptr };
@@ -76,6 +78,7 @@ struct app_menu_t
 };
 
 static app_menu_t* _menus = nullptr;
+static shared_mutex _menus_lock;
 static app_dialog_t** _dialogs = nullptr;
 
 //
@@ -99,6 +102,7 @@ FOUNDATION_STATIC void app_dialogs_shutdown()
 
 FOUNDATION_STATIC void app_menus_shutdown()
 {
+    SHARED_WRITE_LOCK(_menus_lock);
     for (unsigned i = 0, end = array_size(_menus); i < end; ++i)
     {
         app_menu_t& menu = _menus[i];
@@ -111,6 +115,7 @@ FOUNDATION_STATIC void app_menus_shutdown()
 
 FOUNDATION_STATIC bool app_menu_handle_shortcuts(GLFWwindow* window)
 {
+    SHARED_READ_LOCK(_menus_lock);
     foreach(menu, _menus)
     {
         const bool has_shortcut = menu->shortcut_key != 0;
@@ -133,6 +138,7 @@ FOUNDATION_STATIC void app_menu(bool appended)
         return;
 
     // Render register menus
+    SHARED_READ_LOCK(_menus_lock);
     foreach(menu, _menus)
     {
         FOUNDATION_ASSERT(array_size(menu->paths) > 1);
@@ -400,6 +406,7 @@ void app_register_menu(
 
     app_menu_t menu{};
     menu.context = context;
+    menu.order = module_initialization_order();
     menu.handler = std::move(handler);
     menu.flags = flags;
     menu.user_data = user_data;
@@ -426,7 +433,13 @@ void app_register_menu(
     menu.paths = string_split(STRING_ARGS(full_path), STRING_CONST("/"));
     FOUNDATION_ASSERT_MSG(array_size(menu.paths) > 1, "Menu path must have at least 2 parts, i.e. File/Settings");
 
-    array_push_memcpy(_menus, &menu);
+    // Modules can register menus concurrently while they get initialized, so menus are 
+    // kept in module order to be rendered the same way as if modules were initialized serially.
+    SHARED_WRITE_LOCK(_menus_lock);
+    unsigned insert_at = array_size(_menus);
+    while (insert_at > 0 && _menus[insert_at - 1].order > menu.order)
+        --insert_at;
+    array_insert_memcpy(_menus, insert_at, &menu);
 }
 
 void app_menu_begin(GLFWwindow* window)
@@ -12,6 +12,7 @@
 #include <framework/common.h>
 #include <framework/dispatcher.h>
 #include <framework/profiler.h>
+#include <framework/epoch.h>
 #include <framework/math.h>
 #include <framework/system.h>
 
@@ -28,6 +29,7 @@
 
 #if BUILD_TESTS
 static bool _run_tests = false;
+static bool _run_benchmarks = false;
 #endif
 #if BUILD_ENABLE_PROFILE
 static double _smooth_elapsed_time_ms = 0.0f;
@@ -78,7 +80,7 @@ FOUNDATION_STATIC int main_process_command_line(foundation_config_t& config, app
 {
     LOG_PREFIX(false);
 
-    if (BUILD_DEPLOY && environment_argument("run-tests"))
+    if (BUILD_DEPLOY && (environment_argument("run-tests") || environment_argument("bench")))
     {
         log_error(0, ERROR_ACCESS_DENIED, STRING_CONST("Tests cannot run in deploy mode"));
         return -1;
@@ -110,7 +112,12 @@ extern int main_initialize()
     memset(&application, 0, sizeof application);
 
     #if BUILD_ENABLE_MEMORY_TRACKER
-        memory_set_tracker(memory_tracker_local());
+        #if BUILD_TESTS
+            extern memory_tracker_t bench_memory_tracker(memory_tracker_t tracker);
+            memory_set_tracker(bench_memory_tracker(memory_tracker_local()));
+        #else
+            memory_set_tracker(memory_tracker_local());
+        #endif
     #endif
     
     #if BUILD_ENABLE_STATIC_HASH_DEBUG
@@ -127,7 +134,9 @@ extern int main_initialize()
     #endif
     
     #if BUILD_TESTS
-    _run_tests = environment_argument("run-tests");
+    // Benchmarks run through the test runner so that queries get served by mocks.
+    _run_benchmarks = environment_argument("bench");
+    _run_tests = _run_benchmarks || environment_argument("run-tests");
     #endif
 
     int command_line_result = main_process_command_line(config, application);
@@ -151,9 +160,9 @@ extern int main_initialize()
         }
     }
 
-    // Check if running batch mode (which is incompatible with running tests)
+    // Check if running batch mode (which is incompatible with running tests, except for headless benchmarks)
     const bool run_eval_mode = environment_argument("eval");
-    _batch_mode = !main_is_running_tests() && (environment_argument("batch-mode") || run_eval_mode);
+    _batch_mode = main_is_running_benchmarks() || (!main_is_running_tests() && (environment_argument("batch-mode") || run_eval_mode));
 
     dispatcher_initialize();
     main_handle_debug_break();
@@ -271,6 +280,19 @@ extern bool main_is_running_tests()
     #endif
 }
 
+/*! Checks if the application is running the benchmark scenarios.
+ *
+ *  @todo Move to app.h
+ */
+extern bool main_is_running_benchmarks()
+{
+    #if BUILD_TESTS
+        return _run_benchmarks;
+    #else
+        return false;
+    #endif
+}
+
 /*! Returns how much a batch of tick took time to execute in average.
  *
  *  @todo Move to app.h
@@ -467,12 +489,18 @@ extern void main_tick(GLFWwindow* window)
 {
     PERFORMANCE_TRACKER("main_tick");
 
-    main_update(window, app_update);
+    {
+        EPOCH_SCOPE();
+        main_update(window, app_update);
 
-    #if BUILD_APPLICATION
-    if (window)
-        main_render(window, app_render, nullptr, nullptr);
-    #endif
+        #if BUILD_APPLICATION
+        if (window)
+            main_render(window, app_render, nullptr, nullptr);
+        #endif
+    }
+
+    // Release memory retired during the frame once no thread can read it anymore.
+    epoch_collect();
 }
 
 /*! Poll any windowing and dispatcher events that occurred since last tick.
@@ -559,6 +559,14 @@ extern bool main_is_interactive_mode(bool exclude_debugger = false);
  */
 extern bool main_is_running_tests();
 
+/*! Returns true if the application is running the benchmark scenarios with --bench.
+ *
+ *  @remark Running benchmarks is also considered running tests.
+ *
+ *  @return True if the application is running the benchmark scenarios.
+ */
+extern bool main_is_running_benchmarks();
+
 /*! Returns the amount of time in milliseconds that has elapsed since the last application tick. 
  *
  *  @remark This is the time that has elapsed since the last call to #main_tick().
@@ -16,27 +16,104 @@
 #include <framework/string.h>
 #include <framework/array.h>
 #include <framework/system.h>
+#include <framework/profiler.h>
 
 #include <foundation/log.h>
 #include <foundation/error.h>
 #include <foundation/hashstrings.h>
 #include <foundation/stream.h>
+#include <foundation/atomic.h>
+#include <foundation/thread.h>
 
 #define HASH_CONSOLE static_hash_string("console", 7, 0xf4408b2738af51e7ULL)
 
+/*! Number of log records each logging thread can queue before the main thread consumes them.
+ *  This must be a power of two.
+ */
+constexpr int64_t CONSOLE_RING_CAPACITY = 256;
+
+/*! Number of message characters stored inline in a log record. Longer messages spill on the heap. */
+constexpr size_t CONSOLE_RECORD_INLINE_TEXT_SIZE = 208;
+
+/*! Maximum number of messages kept in the console before the oldest ones get evicted. */
+constexpr size_t CONSOLE_MAX_MESSAGES = 20000;
+
+/*! Maximum length of the single line preview rendered in the message list. */
+constexpr size_t CONSOLE_PREVIEW_MAX_LENGTH = 256;
+
+static_assert((CONSOLE_RING_CAPACITY & (CONSOLE_RING_CAPACITY - 1)) == 0, "Ring capacity must be a power of two");
+
+/*! Log record produced by any thread and consumed by the main thread. */
+struct log_record_t
+{
+    tick_t timestamp;
+    hash_t context;
+    error_level_t severity;
+    bool prefix;
+    bool visible;
+    uint32_t length;
+    char* overflow;
+    char text[CONSOLE_RECORD_INLINE_TEXT_SIZE];
+};
+
+/*! Ownership states of a thread log ring. */
+enum log_ring_state_t : int32_t
+{
+    LOG_RING_FREE = 0,     // The owning thread exited, the ring can be reused.
+    LOG_RING_OWNED = 1,    // A live thread logs records in the ring.
+    LOG_RING_RETIRED = 2,  // The console shut down, the owning thread releases the ring when it exits.
+};
+
+/*! Single producer/single consumer ring of log records owned by a logging thread.
+ * 
+ *  The owning thread is the only one to advance #head and the main thread is the only
+ *  one to advance #tail, therefore no lock is needed to hand off records.
+ */
+struct log_ring_t
+{
+    atomic64_t head;
+    atomic64_t tail;
+    atomic32_t state;
+    atomic32_t dropped;
+    log_ring_t* next;
+    uint64_t thread_id;
+    int64_t consumed_head;
+    log_record_t records[CONSOLE_RING_CAPACITY];
+};
+
+/*! Release the thread ring ownership when the logging thread exits so another thread can reuse it. */
+struct log_ring_owner_t
+{
+    log_ring_t* ring{ nullptr };
+
+    ~log_ring_owner_t()
+    {
+        if (ring == nullptr)
+            return;
+
+        // The console already shut down and left the ring to us.
+        if (!atomic_cas32(&ring->state, LOG_RING_FREE, LOG_RING_OWNED, memory_order_release, memory_order_acquire))
+            memory_deallocate(ring);
+        ring = nullptr;
+    }
+};
+
 struct log_message_t
 {
     size_t id{ 0 };
     hash_t key;
     error_level_t severity;
-    string_table_symbol_t msg_symbol{ STRING_TABLE_NULL_SYMBOL };
-    string_table_symbol_t preview_symbol{ STRING_TABLE_NULL_SYMBOL };
+    string_t msg{};
+    string_t preview{};
+    bool preview_resolved{ false };
     size_t occurence{ 1 };
     bool selectable{ false };
     bool prefix{ false };
     hash_t context;
 };
 
+static thread_local log_ring_owner_t _log_ring_owner;
+
 static struct CONSOLE_MODULE
 {
     mutex_t* lock = nullptr;
@@ -47,7 +124,6 @@ static struct CONSOLE_MODULE
     int filtered_message_count = -1;
     size_t next_log_message_id = 1;
     string_t selected_msg;
-    string_table_t* strings = nullptr;
     bool concat_messages = false;
     char expression_buffer[4096]{ "" };
     bool expression_explicitly_set = false;
@@ -55,117 +131,450 @@ static struct CONSOLE_MODULE
     size_t max_context_name_length = 0;
     string_t* secret_keys{ nullptr };
 
+    atomicptr_t rings{ nullptr };
+    atomic32_t ring_count{ 0 };
+    log_record_t** pending_records{ nullptr };
+    size_t evicted_message_count = 0;
+    size_t dropped_message_count = 0;
+    bool processing_records = false;
+    atomic32_t active_loggers{ 0 };
+    atomic32_t shutting_down{ 0 };
+
     generics::fixed_loop < string_t, 20, [](string_t& s) { string_deallocate(s.str); } > saved_expressions;
 
+    mutex_t* log_stream_lock = nullptr;
     stream_t* log_stream = nullptr;
 
 } *_console_module;
 
-FOUNDATION_STATIC string_table_symbol_t console_string_encode(const char* s, size_t length /* = 0*/)
+/*! Append a log message to the log file. 
+ * 
+ *  @remark The log file is written by the main thread when records are consumed and by 
+ *          logging threads whose ring is full, so the file never misses a message.
+ */
+FOUNDATION_STATIC void console_log_stream_write(const char* msg, size_t length)
 {
-    if (length == 0)
-        length = string_length(s);
+    if (_console_module->log_stream == nullptr)
+        return;
+
+    scoped_mutex_t lock(_console_module->log_stream_lock);
+    stream_write_string(_console_module->log_stream, msg, length);
+    stream_write_endl(_console_module->log_stream);
+}
+
+FOUNDATION_STATIC void console_message_deallocate(log_message_t& m)
+{
+    string_deallocate(m.preview.str);
+    string_deallocate(m.msg.str);
+    m.preview = {};
+    m.msg = {};
+}
+
+FOUNDATION_STATIC void console_messages_deallocate()
+{
+    foreach(m, _console_module->messages)
+        console_message_deallocate(*m);
+    array_deallocate(_console_module->messages);
+}
 
+FOUNDATION_STATIC string_t console_string_clone(const char* s, size_t length)
+{
     if (length == 0)
-        return STRING_TABLE_NULL_SYMBOL;
+        return {};
 
     string_t str = string_clone(s, length);
 
     // Remove secret key tokens
+    scoped_mutex_t lock(_console_module->lock);
     for (size_t i = 0; i < array_size(_console_module->secret_keys); ++i)
     {
         string_t key = _console_module->secret_keys[i];
         str = string_replace(STRING_ARGS_CAPACITY(str), STRING_ARGS(key), STRING_CONST("***"), true);
     }
 
-    string_table_symbol_t symbol = string_table_to_symbol(_console_module->strings, STRING_ARGS(str));
-    while (symbol == STRING_TABLE_FULL)
+    return str;
+}
+
+FOUNDATION_STATIC string_const_t console_message_preview(log_message_t& log)
+{
+    // The single line preview is only generated when the message is about to be rendered.
+    if (!log.preview_resolved)
     {
-        string_table_grow(&_console_module->strings, (int)(_console_module->strings->allocated_bytes * 2.0f));
-        symbol = string_table_to_symbol(_console_module->strings, STRING_ARGS(str));
+        if (string_find(STRING_ARGS(log.msg), '\n', 0) != STRING_NPOS)
+        {
+            char preview_buffer[CONSOLE_PREVIEW_MAX_LENGTH];
+            string_const_t preview = string_remove_line_returns(STRING_BUFFER(preview_buffer), STRING_ARGS(log.msg));
+            log.preview = string_clone(STRING_ARGS(preview));
+        }
+        else if (log.msg.length >= CONSOLE_PREVIEW_MAX_LENGTH)
+        {
+            log.preview = string_clone(log.msg.str, CONSOLE_PREVIEW_MAX_LENGTH - 1);
+        }
+        log.preview_resolved = true;
     }
 
-    string_deallocate(str.str);
-
-    return symbol;
+    if (log.preview.length)
+        return string_to_const(log.preview);
+    return string_to_const(log.msg);
 }
 
-FOUNDATION_STATIC void logger(hash_t context, error_level_t severity, const char* msg, size_t length)
+FOUNDATION_STATIC void console_apply_search_filter()
 {
-    if (_console_module->log_stream)
+    _console_module->filtered_message_count = 0;
+    const size_t filter_length = string_length(_console_module->search_filter);
+    if (filter_length > 0)
+    {
+        size_t log_count = array_size(_console_module->messages);
+        for (_console_module->filtered_message_count = 0; _console_module->filtered_message_count < log_count;)
+        {
+            const log_message_t& log = _console_module->messages[_console_module->filtered_message_count];
+            if (string_contains_nocase(STRING_ARGS(log.msg), _console_module->search_filter, filter_length))
+            {
+                _console_module->filtered_message_count++;
+            }
+            else
+            {
+                std::swap(_console_module->messages[_console_module->filtered_message_count], _console_module->messages[log_count - 1]);
+                log_count--;
+            }
+        }
+    }
+    else
     {
-        stream_write_string(_console_module->log_stream, msg, length);
-        stream_write_endl(_console_module->log_stream);
+        array_sort(_console_module->messages, ARRAY_LESS_BY(id));
     }
+}
 
-	#if BUILD_DEBUG
-    if (error() == ERROR_ASSERT)
+FOUNDATION_STATIC void console_evict_old_messages()
+{
+    const size_t message_count = array_size(_console_module->messages);
+    if (message_count <= CONSOLE_MAX_MESSAGES)
         return;
 
-    if (system_debugger_attached() && severity <= ERRORLEVEL_DEBUG)
-        return;
-	#endif
+    // Evict a quarter of the messages at once to amortize the cost of shifting the remaining ones.
+    const size_t evict_count = message_count - CONSOLE_MAX_MESSAGES * 3 / 4;
+
+    const bool filtered = _console_module->filtered_message_count > 0;
+    if (filtered)
+        array_sort(_console_module->messages, ARRAY_LESS_BY(id));
+
+    for (size_t i = 0; i < evict_count; ++i)
+        console_message_deallocate(_console_module->messages[i]);
+    array_erase_ordered_range_safe(_console_module->messages, 0, evict_count);
+    _console_module->evicted_message_count += evict_count;
 
-    memory_context_push(HASH_CONSOLE);
+    if (filtered)
+        console_apply_search_filter();
+}
 
+FOUNDATION_STATIC void console_add_message(const log_record_t* record, const char* msg, size_t length)
+{
     if (_console_module->concat_messages)
     {
-        scoped_mutex_t lock(_console_module->lock);
         log_message_t* last_message = array_last(_console_module->messages);
         if (last_message)
         {
-            string_const_t prev = string_table_to_string_const(_console_module->strings, last_message->msg_symbol);
-            string_t new_msg = string_allocate_concat(STRING_ARGS(prev), msg, length);
-            last_message->msg_symbol = console_string_encode(new_msg.str, new_msg.length);
-            string_deallocate(new_msg.str);
+            string_t new_msg = string_allocate_concat(STRING_ARGS(last_message->msg), msg, length);
+            string_deallocate(last_message->msg.str);
+            string_deallocate(last_message->preview.str);
+            last_message->msg = new_msg;
+            last_message->preview = {};
+            last_message->preview_resolved = false;
             return;
         }
     }
 
+    log_message_t m{ _console_module->next_log_message_id++, string_hash(msg, length), record->severity };
+    m.context = record->context;
+    m.prefix = record->prefix;
+
+    #if BUILD_ENABLE_STATIC_HASH_DEBUG
+    hash_t context = m.context ? m.context : HASH_DEFAULT;
+    string_const_t context_name = hash_to_string(context);
+    const size_t hash_code_start = string_find(msg, length, '<', 12);
+    const size_t hash_code_end = string_find(msg, length, '>', hash_code_start);
+    if (context_name.length != 0 && hash_code_start != STRING_NPOS && hash_code_end != STRING_NPOS)
+    {
+        _console_module->max_context_name_length = max(_console_module->max_context_name_length, context_name.length);
+        string_t formatted_msg = string_allocate_format(STRING_CONST("%.*s %-*.*s : %.*s"), 
+            (int)hash_code_start - 1, msg,
+            (int)_console_module->max_context_name_length, STRING_FORMAT(context_name),
+            (int)(length - hash_code_end - 1), msg + hash_code_end + 2);
+
+        m.msg = console_string_clone(formatted_msg.str, formatted_msg.length);
+        string_deallocate(formatted_msg.str);
+    }
+    else
+    #endif
+    {
+        m.msg = console_string_clone(msg, length);
+    }
+
+    if (m.msg.length == 0)
+        return;
+
+    array_push_memcpy(_console_module->messages, &m);
+}
+
+FOUNDATION_STATIC void console_add_dropped_message(log_ring_t* ring, int32_t dropped)
+{
+    log_record_t record{};
+    record.context = HASH_CONSOLE;
+    record.severity = ERRORLEVEL_WARNING;
+
+    char dropped_buffer[128];
+    string_t dropped_msg = string_format(STRING_BUFFER(dropped_buffer), 
+        STRING_CONST("Console dropped %d log messages from thread %" PRIu64 " (logging faster than the console can consume)"), dropped, ring->thread_id);
+    console_add_message(&record, STRING_ARGS(dropped_msg));
+    _console_module->dropped_message_count += dropped;
+}
+
+/*! Consume all pending log records of all thread rings.
+ * 
+ *  @remark Only the main thread consumes records.
+ * 
+ *  @return Number of log records consumed.
+ */
+FOUNDATION_EXTERN size_t console_process_records()
+{
+    if (_console_module == nullptr || _console_module->processing_records)
+        return 0;
+
+    PERFORMANCE_TRACKER("console_process_records");
+
+    _console_module->processing_records = true;
+
+    // Gather all pending records
+    log_ring_t* first_ring = (log_ring_t*)atomic_load_ptr(&_console_module->rings, memory_order_acquire);
+    for (log_ring_t* ring = first_ring; ring; ring = ring->next)
+    {
+        const int64_t tail = atomic_load64(&ring->tail, memory_order_relaxed);
+        ring->consumed_head = atomic_load64(&ring->head, memory_order_acquire);
+        for (int64_t i = tail; i < ring->consumed_head; ++i)
+            array_push(_console_module->pending_records, &ring->records[i & (CONSOLE_RING_CAPACITY - 1)]);
+    }
+
+    // Preserve the chronological order of records emitted by different threads.
+    const size_t record_count = array_size(_console_module->pending_records);
+    if (record_count > 1)
+    {
+        array_sort(_console_module->pending_records, [](const log_record_t* a, const log_record_t* b)
+        {
+            return a->timestamp < b->timestamp ? -1 : (a->timestamp > b->timestamp ? 1 : 0);
+        });
+    }
+
+    if (record_count > 0)
+    {
+        memory_context_push(HASH_CONSOLE);
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            log_record_t* record = _console_module->pending_records[i];
+            const char* msg = record->overflow ? record->overflow : record->text;
+
+            console_log_stream_write(msg, record->length);
+
+            if (record->visible)
+                console_add_message(record, msg, record->length);
+
+            if (record->overflow)
+            {
+                memory_deallocate(record->overflow);
+                record->overflow = nullptr;
+            }
+        }
+        memory_context_pop();
+
+        _console_module->focus_last_message = true;
+        array_clear(_console_module->pending_records);
+    }
+
+    // Release consumed slots and report messages that could not be queued.
+    for (log_ring_t* ring = first_ring; ring; ring = ring->next)
     {
-        log_message_t m{ _console_module->next_log_message_id++, string_hash(msg, length), severity };
-        m.context = context;
-        m.prefix = log_is_prefix_enabled();
+        atomic_store64(&ring->tail, ring->consumed_head, memory_order_release);
 
-        #if BUILD_ENABLE_STATIC_HASH_DEBUG
-        context = context ? context : HASH_DEFAULT;
-        string_const_t context_name = hash_to_string(context);
-        const size_t hash_code_start = string_find(msg, length, '<', 12);
-        const size_t hash_code_end = string_find(msg, length, '>', hash_code_start);
+        const int32_t dropped = atomic_load32(&ring->dropped, memory_order_relaxed);
+        if (dropped > 0)
+        {
+            atomic_add32(&ring->dropped, -dropped, memory_order_relaxed);
+            console_add_dropped_message(ring, dropped);
+        }
+    }
 
-        scoped_mutex_t lock(_console_module->lock);
-        if (context_name.length != 0 && hash_code_start != STRING_NPOS && hash_code_end != STRING_NPOS)
+    console_evict_old_messages();
+    _console_module->processing_records = false;
+    return record_count;
+}
+
+FOUNDATION_STATIC log_ring_t* console_thread_ring()
+{
+    log_ring_t* ring = _log_ring_owner.ring;
+    if (ring)
+        return ring;
+
+    // Reuse a ring released by a thread that exited if possible.
+    ring = (log_ring_t*)atomic_load_ptr(&_console_module->rings, memory_order_acquire);
+    for (; ring; ring = ring->next)
+    {
+        if (atomic_load32(&ring->state, memory_order_relaxed) == LOG_RING_FREE && 
+            atomic_cas32(&ring->state, LOG_RING_OWNED, LOG_RING_FREE, memory_order_acquire, memory_order_relaxed))
         {
-            _console_module->max_context_name_length = max(_console_module->max_context_name_length, context_name.length);
-            string_t formatted_msg = string_allocate_format(STRING_CONST("%.*s %-*.*s : %.*s"), 
-                (int)hash_code_start - 1, msg,
-                (int)_console_module->max_context_name_length, STRING_FORMAT(context_name),
-                (int)(length - hash_code_end - 1), msg + hash_code_end + 2);
-
-            m.msg_symbol = console_string_encode(formatted_msg.str, formatted_msg.length);
-            string_deallocate(formatted_msg.str);
+            break;
         }
-        else
-        #endif
+    }
+
+    if (ring == nullptr)
+    {
+        ring = (log_ring_t*)memory_allocate(HASH_CONSOLE, sizeof(log_ring_t), 64, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+        atomic_store32(&ring->state, LOG_RING_OWNED, memory_order_relaxed);
+
+        void* first_ring = nullptr;
+        do
         {
-            m.msg_symbol = console_string_encode(msg, length);
+            first_ring = atomic_load_ptr(&_console_module->rings, memory_order_acquire);
+            ring->next = (log_ring_t*)first_ring;
+        } while (!atomic_cas_ptr(&_console_module->rings, ring, first_ring, memory_order_release, memory_order_acquire));
+
+        atomic_incr32(&_console_module->ring_count, memory_order_relaxed);
+    }
+
+    ring->thread_id = thread_id();
+    _log_ring_owner.ring = ring;
+    return ring;
+}
+
+FOUNDATION_STATIC void console_rings_deallocate()
+{
+    log_ring_t* ring = (log_ring_t*)atomic_load_ptr(&_console_module->rings, memory_order_acquire);
+    atomic_store_ptr(&_console_module->rings, nullptr, memory_order_release);
+    atomic_store32(&_console_module->ring_count, 0, memory_order_relaxed);
+    if (_log_ring_owner.ring)
+    {
+        atomic_store32(&_log_ring_owner.ring->state, LOG_RING_FREE, memory_order_release);
+        _log_ring_owner.ring = nullptr;
+    }
+
+    // Threads still running no longer log, but their ring is retired and released when they exit.
+    while (ring)
+    {
+        log_ring_t* next = ring->next;
+        const int64_t head = atomic_load64(&ring->head, memory_order_acquire);
+        for (int64_t i = atomic_load64(&ring->tail, memory_order_acquire); i < head; ++i)
+        {
+            log_record_t& record = ring->records[i & (CONSOLE_RING_CAPACITY - 1)];
+            if (record.overflow)
+                memory_deallocate(record.overflow);
         }
+        atomic_store64(&ring->tail, head, memory_order_release);
+
+        if (!atomic_cas32(&ring->state, LOG_RING_RETIRED, LOG_RING_OWNED, memory_order_acq_rel, memory_order_acquire))
+            memory_deallocate(ring);
+        ring = next;
+    }
+}
+
+FOUNDATION_STATIC void console_logger_push(hash_t context, error_level_t severity, const char* msg, size_t length)
+{
+    bool visible = true;
+
+    #if BUILD_DEBUG
+    if (error() == ERROR_ASSERT)
+        visible = false;
 
-        string_const_t log_msg = string_table_to_string_const(_console_module->strings, m.msg_symbol);
-        string_const_t preview = string_remove_line_returns(SHARED_BUFFER(256), STRING_ARGS(log_msg));
+    if (system_debugger_attached() && severity <= ERRORLEVEL_DEBUG)
+        visible = false;
+    #endif
 
-        m.preview_symbol = console_string_encode(STRING_ARGS(preview));
-        array_push_memcpy(_console_module->messages, &m);
+    log_ring_t* ring = console_thread_ring();
+    const int64_t head = atomic_load64(&ring->head, memory_order_relaxed);
+    if (head - atomic_load64(&ring->tail, memory_order_acquire) >= CONSOLE_RING_CAPACITY)
+    {
+        // Only the main thread can make room by itself, other threads never wait for the consumer.
+        if (!thread_is_main() || console_process_records() == 0)
+        {
+            // The message will not show in the console, but it still goes to the log file.
+            console_log_stream_write(msg, length);
+            atomic_incr32(&ring->dropped, memory_order_relaxed);
+            return;
+        }
     }
 
-    _console_module->focus_last_message = true;
-    memory_context_pop();
+    log_record_t* record = &ring->records[head & (CONSOLE_RING_CAPACITY - 1)];
+    record->timestamp = time_current();
+    record->context = context;
+    record->severity = severity;
+    record->prefix = log_is_prefix_enabled();
+    record->visible = visible;
+    record->length = (uint32_t)length;
+    if (length < sizeof(record->text))
+    {
+        memcpy(record->text, msg, length);
+        record->text[length] = '\0';
+        record->overflow = nullptr;
+    }
+    else
+    {
+        record->overflow = (char*)memory_allocate(HASH_CONSOLE, length + 1, 0, MEMORY_PERSISTENT);
+        memcpy(record->overflow, msg, length);
+        record->overflow[length] = '\0';
+    }
+
+    atomic_store64(&ring->head, head + 1, memory_order_release);
+}
+
+/*! Log handler installed for the application. 
+ * 
+ *  Any thread can log without taking any lock. Records are queued in the logging thread ring 
+ *  and then consumed by the main thread in #console_process_records.
+ */
+FOUNDATION_EXTERN void console_logger(hash_t context, error_level_t severity, const char* msg, size_t length)
+{
+    if (_console_module == nullptr)
+        return;
+
+    // Shutdown waits for loggers that already entered the handler before releasing the rings.
+    atomic_incr32(&_console_module->active_loggers, memory_order_acquire);
+    if (atomic_load32(&_console_module->shutting_down, memory_order_acquire) == 0)
+        console_logger_push(context, severity, msg, length);
+    atomic_decr32(&_console_module->active_loggers, memory_order_release);
+}
+
+/*! Returns an estimation of the memory used by the console log records and messages.
+ * 
+ *  @param out_message_count Number of messages currently held by the console.
+ *  @param out_dropped_count Number of messages dropped because a thread ring was full.
+ * 
+ *  @return Number of bytes used by the console logs.
+ */
+FOUNDATION_EXTERN size_t console_memory_usage(size_t* out_message_count, size_t* out_dropped_count)
+{
+    if (_console_module == nullptr)
+        return 0;
+
+    const size_t message_count = array_size(_console_module->messages);
+    size_t memory_usage = atomic_load32(&_console_module->ring_count, memory_order_relaxed) * sizeof(log_ring_t);
+    memory_usage += array_capacity(_console_module->messages) * sizeof(log_message_t);
+    memory_usage += array_capacity(_console_module->pending_records) * sizeof(log_record_t*);
+    for (size_t i = 0; i < message_count; ++i)
+    {
+        const log_message_t& m = _console_module->messages[i];
+        memory_usage += m.msg.length + 1;
+        if (m.preview.str)
+            memory_usage += m.preview.length + 1;
+    }
+
+    if (out_message_count)
+        *out_message_count = message_count;
+    if (out_dropped_count)
+        *out_dropped_count = _console_module->dropped_message_count;
+    return memory_usage;
 }
 
 FOUNDATION_STATIC string_const_t console_get_log_trimmed_text(const log_message_t& log)
 {
     // Find the first : character and truncate the text length
-    string_const_t tooltip_log_message = string_table_to_string_const(_console_module->strings, log.msg_symbol);
+    string_const_t tooltip_log_message = string_to_const(log.msg);
     if (!log.prefix)
         return tooltip_log_message;
     
@@ -191,51 +600,45 @@ FOUNDATION_STATIC void console_render_logs(const ImRect& rect)
         if (clipper.DisplayStart >= clipper.DisplayEnd)
             continue;
 
-        if (mutex_lock(_console_module->lock))
+        const float window_width = ImGui::GetWindowWidth();
+        const float item_available_width = ImGui::GetContentRegionAvail().x;
+        for (size_t i = clipper.DisplayStart; i < min(clipper.DisplayEnd, (int)array_size(_console_module->messages)); ++i)
         {
-            const float window_width = ImGui::GetWindowWidth();
-            const float item_available_width = ImGui::GetContentRegionAvail().x;
-            for (size_t i = clipper.DisplayStart; i < min(clipper.DisplayEnd, (int)array_size(_console_module->messages)); ++i)
-            {
-                log_message_t& log = _console_module->messages[i];
+            log_message_t& log = _console_module->messages[i];
 
-                if (log.severity == ERRORLEVEL_ERROR)
-                    ImGui::PushStyleColor(ImGuiCol_Text, TEXT_BAD_COLOR);
-                else if (log.severity == ERRORLEVEL_WARNING)
-                    ImGui::PushStyleColor(ImGuiCol_Text, TEXT_WARN_COLOR);
+            if (log.severity == ERRORLEVEL_ERROR)
+                ImGui::PushStyleColor(ImGuiCol_Text, TEXT_BAD_COLOR);
+            else if (log.severity == ERRORLEVEL_WARNING)
+                ImGui::PushStyleColor(ImGuiCol_Text, TEXT_WARN_COLOR);
 
-                ImGui::PushStyleVar(ImGuiStyleVar_SelectableTextAlign, ImVec2(0.0f, 0.0f));
-                string_const_t msg_str = log.preview_symbol != STRING_TABLE_NULL_SYMBOL ? 
-                    string_table_to_string_const(_console_module->strings,log.preview_symbol) :
-                    string_table_to_string_const(_console_module->strings, log.msg_symbol);
+            ImGui::PushStyleVar(ImGuiStyleVar_SelectableTextAlign, ImVec2(0.0f, 0.0f));
+            string_const_t msg_str = console_message_preview(log);
 
-                if (ImGui::Selectable(msg_str.str, &log.selectable, ImGuiSelectableFlags_DontClosePopups, {0, 0}))
-                {
-                    string_deallocate(_console_module->selected_msg.str);
-                    string_const_t csmm = console_get_log_trimmed_text(log);
-                    _console_module->selected_msg = string_clone(STRING_ARGS(csmm));
-                    ImGui::SetClipboardText(_console_module->selected_msg.str);
-                }
-                ImGui::PopStyleVar();
+            if (ImGui::Selectable(msg_str.str, &log.selectable, ImGuiSelectableFlags_DontClosePopups, {0, 0}))
+            {
+                string_deallocate(_console_module->selected_msg.str);
+                string_const_t csmm = console_get_log_trimmed_text(log);
+                _console_module->selected_msg = string_clone(STRING_ARGS(csmm));
+                ImGui::SetClipboardText(_console_module->selected_msg.str);
+            }
+            ImGui::PopStyleVar();
 
-                // Check if last item is clipped in order to display a tooltip if it is the case.
-                const float item_renderered_width = ImGui::GetItemRectMax().x - ImGui::GetItemRectMin().x;
-                if (ImGui::IsItemHovered() && item_renderered_width > window_width)
+            // Check if last item is clipped in order to display a tooltip if it is the case.
+            const float item_renderered_width = ImGui::GetItemRectMax().x - ImGui::GetItemRectMin().x;
+            if (ImGui::IsItemHovered() && item_renderered_width > window_width)
+            {
+                ImGui::SetNextWindowSize({ window_width * 0.9f, 0 });
+                if (ImGui::BeginTooltip())
                 {
-                    ImGui::SetNextWindowSize({ window_width * 0.9f, 0 });
-                    if (ImGui::BeginTooltip())
-                    {
-                        string_const_t tooltip_log_message = console_get_log_trimmed_text(log);
-                        ImGui::TextWrapped("%.*s", STRING_FORMAT(tooltip_log_message));
-                        ImGui::EndTooltip();
-                    }
-                    
+                    string_const_t tooltip_log_message = console_get_log_trimmed_text(log);
+                    ImGui::TextWrapped("%.*s", STRING_FORMAT(tooltip_log_message));
+                    ImGui::EndTooltip();
                 }
-
-                if (log.severity == ERRORLEVEL_ERROR || log.severity == ERRORLEVEL_WARNING)
-                    ImGui::PopStyleColor(1);
+                
             }
-            mutex_unlock(_console_module->lock);
+
+            if (log.severity == ERRORLEVEL_ERROR || log.severity == ERRORLEVEL_WARNING)
+                ImGui::PopStyleColor(1);
         }
     }
 
@@ -285,20 +688,13 @@ FOUNDATION_STATIC void console_clear_all()
 {
     string_deallocate(_console_module->selected_msg.str);
     _console_module->selected_msg = {};
-    
-    if (!mutex_lock(_console_module->lock))
-        return;
 
     _console_module->filtered_message_count = -1;
     _console_module->search_filter[0] = '\0';
-    array_deallocate(_console_module->messages);
-
-    int new_size = to_int(_console_module->strings->allocated_bytes);
-    string_table_deallocate(_console_module->strings);
-    _console_module->strings = string_table_allocate(new_size, 64);
+    console_messages_deallocate();
     _console_module->max_context_name_length = 0;
-    
-    mutex_unlock(_console_module->lock);
+    _console_module->evicted_message_count = 0;
+    _console_module->dropped_message_count = 0;
 }
 
 FOUNDATION_STATIC void console_render_toolbar()
@@ -308,32 +704,7 @@ FOUNDATION_STATIC void console_render_toolbar()
     ImGui::BeginGroup();
     ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - clear_button_width - button_frame_padding);
     if (ImGui::InputTextWithHint("##SearchLog", tr("Search logs..."), STRING_BUFFER(_console_module->search_filter)))
-    {
-        _console_module->filtered_message_count = 0;
-        const size_t filter_length = string_length(_console_module->search_filter);
-        if (filter_length > 0)
-        {
-            size_t log_count = array_size(_console_module->messages);
-            for (_console_module->filtered_message_count = 0; _console_module->filtered_message_count < log_count;)
-            {
-                const log_message_t& log = _console_module->messages[_console_module->filtered_message_count];
-                string_const_t log_msg = string_table_to_string_const(_console_module->strings, log.msg_symbol);
-                if (string_contains_nocase(STRING_ARGS(log_msg), _console_module->search_filter, filter_length))
-                {
-                    _console_module->filtered_message_count++;
-                }
-                else
-                {
-                    std::swap(_console_module->messages[_console_module->filtered_message_count], _console_module->messages[log_count - 1]);
-                    log_count--;
-                }
-            }
-        }
-        else
-        {
-            array_sort(_console_module->messages, ARRAY_LESS_BY(id));
-        }
-    }
+        console_apply_search_filter();
 
     ImGui::SameLine();
     if (ImGui::Button(tr("Clear")))
@@ -525,6 +896,7 @@ FOUNDATION_STATIC void console_module_ensure_initialized()
     {
         _console_module = MEM_NEW(HASH_CONSOLE, CONSOLE_MODULE);
         _console_module->lock = mutex_allocate(STRING_CONST("console_lock"));
+        _console_module->log_stream_lock = mutex_allocate(STRING_CONST("console_log_stream_lock"));
         
         string_const_t log_path = session_get_user_file_path(STRING_CONST("log.txt"));
         if (fs_is_file(STRING_ARGS(log_path)))
@@ -580,11 +952,10 @@ FOUNDATION_STATIC void console_initialize()
 {
     console_module_ensure_initialized();
 
-    _console_module->strings = string_table_allocate(64 * 1024, 64);
-
     if (BUILD_APPLICATION && !main_is_running_tests())
     {
-        log_set_handler(logger);
+        log_set_handler(console_logger);
+        module_register_update(HASH_CONSOLE, []() { console_process_records(); });
         _console_module->opened = environment_argument("console") || session_get_bool("show_console", _console_module->opened);
         module_register_menu(HASH_CONSOLE, console_menu);
 
@@ -609,12 +980,18 @@ FOUNDATION_STATIC void console_initialize()
 
 FOUNDATION_STATIC void console_shutdown()
 {
-    {
-        scoped_mutex_t lock(_console_module->lock);
-        log_set_handler(nullptr);
-    }
+    log_set_handler(nullptr);
+
+    // Wait for threads that were logging when the handler got removed to be done with their ring.
+    atomic_store32(&_console_module->shutting_down, 1, memory_order_release);
+    while (atomic_load32(&_console_module->active_loggers, memory_order_acquire) > 0)
+        thread_sleep(1);
+
+    console_process_records();
 
     console_clear_all();
+    console_rings_deallocate();
+    array_deallocate(_console_module->pending_records);
     mutex_deallocate(_console_module->lock);
     session_set_bool("show_console", _console_module->opened);
     string_deallocate(_console_module->selected_msg.str);
@@ -626,7 +1003,6 @@ FOUNDATION_STATIC void console_shutdown()
         _console_module->saved_expressions.clear();
     }
 
-    string_table_deallocate(_console_module->strings);
     string_array_deallocate(_console_module->secret_keys);
 
     if (_console_module->log_stream)
@@ -634,8 +1010,9 @@ FOUNDATION_STATIC void console_shutdown()
         stream_deallocate(_console_module->log_stream);
         _console_module->log_stream = nullptr;
     }
+    mutex_deallocate(_console_module->log_stream_lock);
 
     MEM_DELETE(_console_module);
 }
 
-DEFINE_MODULE(CONSOLE, console_initialize, console_shutdown, MODULE_PRIORITY_UI_HEADLESS);
+DEFINE_MODULE(CONSOLE, console_initialize, console_shutdown, MODULE_PRIORITY_UI_HEADLESS, MODULE_MAIN_THREAD);
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2022-2023 - All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ */
+
+#include "epoch.h"
+
+#include <framework/shared_mutex.h>
+#include <framework/array.h>
+
+#include <foundation/atomic.h>
+#include <foundation/thread.h>
+
+/*! Number of retired pointers after which retiring tries to release memory. */
+constexpr size_t EPOCH_COLLECT_THRESHOLD = 32;
+
+/*! Maximum number of threads alive at the same time that can enter epochs. */
+constexpr int32_t EPOCH_MAX_THREADS = 256;
+
+struct epoch_thread_t
+{
+    atomic64_t      epoch;      // Epoch observed when the thread entered, 0 when outside
+    atomic32_t      in_use;     // Set while a thread owns the record
+    uint32_t        depth;      // Nesting depth, only accessed by the owning thread
+};
+
+struct epoch_garbage_t
+{
+    void*           ptr;
+    epoch_deleter_t deleter;
+    int64_t         epoch;
+};
+
+/*! Releases the thread record when the thread exits so it can be reused. */
+struct epoch_thread_slot_t
+{
+    epoch_thread_t* record{ nullptr };
+
+    ~epoch_thread_slot_t()
+    {
+        if (record == nullptr)
+            return;
+        atomic_store64(&record->epoch, 0, memory_order_release);
+        atomic_store32(&record->in_use, 0, memory_order_release);
+    }
+};
+
+static atomic64_t _epoch_global{ 1 };
+static atomic32_t _epoch_thread_count{};
+static epoch_thread_t _epoch_threads[EPOCH_MAX_THREADS]{};
+static thread_local epoch_thread_slot_t _epoch_thread_slot;
+
+static shared_mutex _epoch_garbage_lock;
+static epoch_garbage_t* _epoch_garbage = nullptr;
+
+//
+// # PRIVATE
+//
+
+FOUNDATION_STATIC epoch_thread_t* epoch_thread_record()
+{
+    epoch_thread_t* record = _epoch_thread_slot.record;
+    if (record)
+        return record;
+
+    // Reuse the record of a thread that exited or claim a new one.
+    for (;;)
+    {
+        const int32_t thread_count = atomic_load32(&_epoch_thread_count, memory_order_acquire);
+        for (int32_t i = 0; i < thread_count; ++i)
+        {
+            record = &_epoch_threads[i];
+            if (atomic_load32(&record->in_use, memory_order_relaxed) == 0 &&
+                atomic_cas32(&record->in_use, 1, 0, memory_order_acquire, memory_order_relaxed))
+            {
+                record->depth = 0;
+                _epoch_thread_slot.record = record;
+                return record;
+            }
+        }
+
+        FOUNDATION_ASSERT_MSG(thread_count < EPOCH_MAX_THREADS, "Too many threads using epochs");
+        if (thread_count < EPOCH_MAX_THREADS)
+        {
+            // Only the thread claiming the next record can publish it.
+            record = &_epoch_threads[thread_count];
+            if (atomic_cas32(&record->in_use, 1, 0, memory_order_acquire, memory_order_relaxed))
+            {
+                atomic_store32(&_epoch_thread_count, thread_count + 1, memory_order_release);
+                _epoch_thread_slot.record = record;
+                return record;
+            }
+        }
+
+        thread_yield();
+    }
+}
+
+FOUNDATION_STATIC int64_t epoch_try_advance()
+{
+    const int64_t global = atomic_load64(&_epoch_global, memory_order_seq_cst);
+
+    // Every thread inside an epoch must have observed the current one.
+    const int32_t thread_count = atomic_load32(&_epoch_thread_count, memory_order_acquire);
+    for (int32_t i = 0; i < thread_count; ++i)
+    {
+        const int64_t epoch = atomic_load64(&_epoch_threads[i].epoch, memory_order_seq_cst);
+        if (epoch != 0 && epoch != global)
+            return global;
+    }
+
+    if (atomic_cas64(&_epoch_global, global + 1, global, memory_order_seq_cst, memory_order_relaxed))
+        return global + 1;
+    return atomic_load64(&_epoch_global, memory_order_seq_cst);
+}
+
+//
+// # PUBLIC API
+//
+
+void epoch_enter()
+{
+    epoch_thread_t* record = epoch_thread_record();
+    if (record->depth++ > 0)
+        return;
+
+    atomic_store64(&record->epoch, atomic_load64(&_epoch_global, memory_order_seq_cst), memory_order_seq_cst);
+}
+
+void epoch_leave()
+{
+    epoch_thread_t* record = _epoch_thread_slot.record;
+    FOUNDATION_ASSERT(record && record->depth > 0);
+    if (--record->depth > 0)
+        return;
+
+    atomic_store64(&record->epoch, 0, memory_order_release);
+}
+
+void epoch_retire(void* ptr, epoch_deleter_t deleter)
+{
+    if (ptr == nullptr)
+        return;
+
+    FOUNDATION_ASSERT(deleter);
+
+    size_t pending_count = 0;
+    {
+        SHARED_WRITE_LOCK(_epoch_garbage_lock);
+        epoch_garbage_t garbage{ ptr, deleter, atomic_load64(&_epoch_global, memory_order_seq_cst) };
+        array_push_memcpy(_epoch_garbage, &garbage);
+        pending_count = array_size(_epoch_garbage);
+    }
+
+    if (pending_count >= EPOCH_COLLECT_THRESHOLD)
+        epoch_collect();
+}
+
+size_t epoch_collect()
+{
+    const int64_t global = epoch_try_advance();
+
+    epoch_garbage_t* released = nullptr;
+    {
+        SHARED_WRITE_LOCK(_epoch_garbage_lock);
+        for (unsigned i = 0; i < array_size(_epoch_garbage);)
+        {
+            // Readers can only have observed the retired memory up to the epoch it was retired in.
+            if (_epoch_garbage[i].epoch + 2 <= global)
+            {
+                array_push_memcpy(released, &_epoch_garbage[i]);
+                array_erase_memcpy(_epoch_garbage, i);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    const size_t released_count = array_size(released);
+    foreach(e, released)
+        e->deleter(e->ptr);
+    array_deallocate(released);
+    return released_count;
+}
+
+size_t epoch_pending_count()
+{
+    SHARED_READ_LOCK(_epoch_garbage_lock);
+    return array_size(_epoch_garbage);
+}
+
+void epoch_shutdown()
+{
+    SHARED_WRITE_LOCK(_epoch_garbage_lock);
+    foreach(e, _epoch_garbage)
+        e->deleter(e->ptr);
+    array_deallocate(_epoch_garbage);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2022-2023 - All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ *
+ * Epoch based memory reclamation.
+ *
+ * Readers enter an epoch before reading shared memory that writers can replace and leave it when done.
+ * Writers retire the memory they replaced with #epoch_retire instead of releasing it right away.
+ * Retired memory is released once every thread that was inside an epoch when it got retired has left it.
+ *
+ * The main thread ticks inside an epoch, so readers on the main thread are covered without having to enter one.
+ * Other threads, including job handlers, enter one only around their reads, never while they wait, since a
+ * thread staying in an epoch holds back the release of all the memory retired meanwhile.
+ */
+
+#pragma once
+
+#include <foundation/platform.h>
+
+typedef void(*epoch_deleter_t)(void* ptr);
+
+/*! Enter an epoch on the calling thread. Epochs can be nested.
+ *
+ *  @remark Entering an epoch never blocks.
+ */
+void epoch_enter();
+
+/*! Leave the epoch entered with #epoch_enter. */
+void epoch_leave();
+
+/*! Retire memory that readers might still be using.
+ *
+ *  @param ptr       Pointer to release
+ *  @param deleter   Function used to release the pointer once no reader can access it anymore
+ */
+void epoch_retire(void* ptr, epoch_deleter_t deleter);
+
+/*! Advance the global epoch if possible and release retired memory that is no longer reachable.
+ *
+ *  @return Number of retired pointers that were released.
+ */
+size_t epoch_collect();
+
+/*! Returns the number of retired pointers waiting to be released. */
+size_t epoch_pending_count();
+
+/*! Release all retired memory. Must only be called once no other thread can be inside an epoch. */
+void epoch_shutdown();
+
+/*! Scope inside which the calling thread is inside an epoch. */
+struct EpochScope
+{
+    FOUNDATION_FORCEINLINE EpochScope() { epoch_enter(); }
+    FOUNDATION_FORCEINLINE ~EpochScope() { epoch_leave(); }
+};
+
+#define EPOCH_SCOPE_COUNTER_EXPAND(COUNTER) EpochScope __var_epoch_scope__##COUNTER
+#define EPOCH_SCOPE_COUNTER(COUNTER) EPOCH_SCOPE_COUNTER_EXPAND(COUNTER)
+#define EPOCH_SCOPE() EPOCH_SCOPE_COUNTER(__LINE__)
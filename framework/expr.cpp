@@ -14,6 +14,7 @@
 #include <framework/plot_expr.h>
 #include <framework/table_expr.h>
 #include <framework/array.h>
+#include <framework/shared_mutex.h>
 
 #include <foundation/random.h>
 #include <foundation/system.h>
@@ -30,6 +31,9 @@ static thread_local const expr_result_t** _expr_lists = nullptr;
 static expr_func_t* _expr_user_funcs = nullptr;
 static string_t* _expr_user_funcs_names = nullptr;
 
+// Modules can register functions concurrently while they get initialized.
+static shared_mutex _expr_user_funcs_lock;
+
 typedef struct {
     string_argument_type_t type; 
     union {
@@ -2384,7 +2388,11 @@ expr_result_t eval(string_const_t expression)
         }
     }
 
-    expr_t* e = expr_create(STRING_ARGS(expression), &_global_vars, _expr_user_funcs);
+    expr_t* e = nullptr;
+    {
+        SHARED_READ_LOCK(_expr_user_funcs_lock);
+        e = expr_create(STRING_ARGS(expression), &_global_vars, _expr_user_funcs);
+    }
     if (e == NULL)
     {
         memory_context_pop();
@@ -2410,10 +2418,72 @@ expr_result_t eval(string_const_t expression)
     return result;
 }
 
+expr_t* expr_compile(const char* expression, size_t expression_length, expr_var_list_t* vars)
+{
+    FOUNDATION_ASSERT(vars);
+
+    memory_context_push(HASH_EXPR);
+    expr_t* e = nullptr;
+    {
+        SHARED_READ_LOCK(_expr_user_funcs_lock);
+        e = expr_create(expression, expression_length, vars, _expr_user_funcs);
+    }
+    memory_context_pop();
+
+    return e;
+}
+
+expr_result_t expr_eval_compiled(expr_t* e, expr_var_list_t* vars, string_const_t expression)
+{
+    FOUNDATION_ASSERT(vars);
+
+    if (e == nullptr)
+        return NIL;
+
+    memory_context_push(HASH_EXPR);
+
+    for (size_t i = 0; i < array_size(_expr_lists); ++i)
+        array_deallocate(_expr_lists[i]);
+    array_clear(_expr_lists);
+
+    // Functions such as MAP or FILTER set $0, $1, etc. as global variables, 
+    // so we make the compiled variables the globals of this thread while evaluating.
+    expr_var_list_t thread_vars = _global_vars;
+    _global_vars = *vars;
+
+    expr_set_or_create_global_var(STRING_CONST("$0"), nullptr);
+
+    expr_result_t result;
+    try
+    {
+        EXPR_ERROR_CODE = EXPR_ERROR_NONE;
+        result = expr_eval(e);
+    }
+    catch (ExprError err)
+    {
+        expr_error(err.code, expression, nullptr,
+            "%.*s", err.message_length, err.message);
+    }
+
+    *vars = _global_vars;
+    _global_vars = thread_vars;
+
+    memory_context_pop();
+    return result;
+}
+
+void expr_compile_release(expr_t* e, expr_var_list_t* vars)
+{
+    expr_destroy(e, vars);
+    if (vars)
+        vars->head = nullptr;
+}
+
 void expr_register_function(const char* name, exprfn_t fn, exprfn_cleanup_t cleanup /*= nullptr*/, size_t context_size /*= 0*/)
 {
     FOUNDATION_ASSERT(fn);
 
+    SHARED_WRITE_LOCK(_expr_user_funcs_lock);
     memory_context_push(HASH_EXPR);
 
     string_t name_copy = string_clone(name, string_length(name));
@@ -2431,6 +2501,7 @@ void expr_register_function(const char* name, exprfn_t fn, exprfn_cleanup_t clea
 
 bool expr_unregister_function(const char* name, exprfn_t fn /*= nullptr*/)
 {
+    SHARED_WRITE_LOCK(_expr_user_funcs_lock);
     const size_t name_length = string_length(name);
     for (unsigned i = 0, end = array_size(_expr_user_funcs); i < end; ++i)
     {
@@ -1251,6 +1251,38 @@ expr_result_t eval(string_const_t expression);
  */
 expr_result_t eval(const char* expression, size_t expression_length = -1);
 
+/*! Compile an expression once so it can be evaluated many times with #expr_eval_compiled.
+ *
+ *  @param expression        Expression to compile.
+ *  @param expression_length Length of the expression string.
+ *  @param vars              Variable list owning all variables referenced by the expression.
+ *
+ *  @remark The expression string must remain valid as long as the compiled expression is used.
+ *
+ *  @return Compiled expression or nullptr if the expression is invalid.
+ */
+expr_t* expr_compile(const char* expression, size_t expression_length, expr_var_list_t* vars);
+
+/*! Evaluate a compiled expression. 
+ * 
+ *  During the evaluation, @vars is used as the global variable list of the calling thread, 
+ *  so the same compiled expression can be evaluated by any thread (but only one thread at a time).
+ *
+ *  @param e          Compiled expression returned by #expr_compile.
+ *  @param vars       Variable list used to compile the expression.
+ *  @param expression Original expression string used to report errors.
+ *
+ *  @return Result of the expression evaluation.
+ */
+expr_result_t expr_eval_compiled(expr_t* e, expr_var_list_t* vars, string_const_t expression);
+
+/*! Release a compiled expression and its variables.
+ *
+ *  @param e    Compiled expression returned by #expr_compile.
+ *  @param vars Variable list used to compile the expression.
+ */
+void expr_compile_release(expr_t* e, expr_var_list_t* vars);
+
 /*! Set a global expression variable to point to an application pointer.
  * 
  *  @remark Nothing special is done to manage the ptr lifespan. It is up to the application to ensure
@@ -8,9 +8,11 @@
 #include "common.h"
 #include "concurrent_queue.h"
 #include "dispatcher.h"
+#include "profiler.h"
 
 #include <foundation/thread.h>
 #include <foundation/semaphore.h>
+#include <foundation/mutex.h>
 
 #ifndef MAX_JOB_THREADS
 #define MAX_JOB_THREADS 8
@@ -18,6 +20,7 @@
 
 static concurrent_queue<job_t*> _scheduled_jobs{};
 static thread_t* _job_threads[MAX_JOB_THREADS]{ nullptr };
+static mutex_t* _job_completed_signal = nullptr;
 
 static void* job_thread_fn(void* arg)
 {
@@ -27,11 +30,15 @@ static void* job_thread_fn(void* arg)
     {
         if (_scheduled_jobs.try_pop(job, 16))
         {
-            job->status = job->handler((payload_t*)job->payload);
+            {
+                TraceFlowScope trace_scope(STRING_CONST("job"), job->trace_flow_id);
+                job->status = job->handler((payload_t*)job->payload);
+            }
             job->completed = true;
 
             if (job->flags & JOB_DEALLOCATE_AFTER_EXECUTION)
                 job_deallocate(job);
+            mutex_signal(_job_completed_signal);
             signal_thread();
         }
     }
@@ -50,6 +57,7 @@ static void* job_thread_fn(void* arg)
 void jobs_initialize()
 {
     _scheduled_jobs.create();
+    _job_completed_signal = mutex_allocate(STRING_CONST("job_completed"));
 
     const size_t thread_count = ARRAY_COUNT(_job_threads);
     for (int i = 0; i < thread_count; ++i)
@@ -73,6 +81,8 @@ void jobs_shutdown()
     }
 
     _scheduled_jobs.destroy();
+    mutex_deallocate(_job_completed_signal);
+    _job_completed_signal = nullptr;
 
     for (size_t i = 0; i < thread_count; ++i)
     {
@@ -127,6 +137,7 @@ job_t* job_execute(const job_handler_t& handler, void* payload, size_t payload_s
     }
 
     new_job->flags = flags;
+    new_job->trace_flow_id = profiler_trace_flow_begin(STRING_CONST("job"));
     new_job->scheduled = true;
     _scheduled_jobs.push(new_job);
     signal_thread();
@@ -144,3 +155,29 @@ bool job_completed(job_t* job)
     _scheduled_jobs.signal();
     return false;
 }
+
+bool job_wait(job_t* job, unsigned timeout_ms /*= UINT32_MAX*/)
+{
+    if (job == nullptr)
+        return true;
+
+    const tick_t start = time_current();
+    while (!job->completed)
+    {
+        if (timeout_ms != UINT32_MAX && time_elapsed(start) * 1000.0 >= timeout_ms)
+            return false;
+
+        // Job threads signal each completed job, the timeout only covers a signal consumed by another waiter.
+        job_wait_any(10);
+    }
+
+    return true;
+}
+
+bool job_wait_any(unsigned timeout_ms)
+{
+    if (!mutex_try_wait(_job_completed_signal, timeout_ms))
+        return false;
+    mutex_unlock(_job_completed_signal);
+    return true;
+}
@@ -26,6 +26,7 @@ struct job_t
     size_t payload_size{  0};
 
     int status { 0 };
+    uint64_t trace_flow_id { 0 };
     volatile bool scheduled { false };
     volatile bool completed { false };
 };
@@ -43,3 +44,20 @@ job_t* job_execute(const job_handler_t& handler, void* payload = nullptr, job_fl
 job_t* job_execute(const job_handler_t& handler, void* payload, size_t payload_size, job_flags_t flags = JOB_FLAGS_NONE);
 
 bool job_completed(job_t* job);
+
+/*! Block the calling thread until the job completes or the timeout expires.
+ *  
+ *  @param job          Job to wait for. It must not be flagged to be deallocated after its execution.
+ *  @param timeout_ms   Maximum time to wait in milliseconds, UINT32_MAX to wait until the job completes.
+ * 
+ *  @return True if the job completed.
+ */
+bool job_wait(job_t* job, unsigned timeout_ms = UINT32_MAX);
+
+/*! Block the calling thread until any job completes or the timeout expires.
+ *  
+ *  @param timeout_ms   Maximum time to wait in milliseconds.
+ * 
+ *  @return True if a job completed, false if the timeout expired or another waiter consumed the completion.
+ */
+bool job_wait_any(unsigned timeout_ms);
@@ -17,6 +17,7 @@
 
 #include <foundation/path.h>
 #include <foundation/environment.h>
+#include <foundation/stream.h>
 
 #if FOUNDATION_PLATFORM_WINDOWS
 #include <framework/resource.h>
@@ -25,6 +26,10 @@
 
 #define HASH_LOCALIZATION static_hash_string("localization", 12, 0xf40f9a08f45a6556ULL)
 
+constexpr uint32_t LOCALIZATION_CATALOG_VERSION = 1;
+constexpr uint32_t LOCALIZATION_CATALOG_MAX_SEED = 1 << 20;
+constexpr uint32_t LOCALIZATION_LITERAL_CACHE_SHIFT = 10;
+
 struct localization_language_t
 {
     string_const_t lang;
@@ -66,9 +71,58 @@ struct string_locale_t
     config_handle_t         cv;
 };
 
+/*! Compiled locale catalog file header.
+ *
+ *  The header is followed by the perfect hash bucket seeds, the slots and the translated string blob.
+ *  Each translated string is null terminated so it can be returned as is from the mapped memory.
+ */
+FOUNDATION_ALIGNED_STRUCT(localization_catalog_header_t, 8)
+{
+    char     magic[4];          // LCAT
+    uint32_t version;
+    char     lang[8];
+    uint128_t source_md5;       // MD5 of the locales.sjson the catalog was compiled from
+    uint32_t entry_count;
+    uint32_t bucket_count;
+    uint32_t slot_count;
+    uint32_t strings_size;
+};
+
+FOUNDATION_ALIGNED_STRUCT(localization_catalog_slot_t, 8)
+{
+    hash_t   key;
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct localization_catalog_t
+{
+    const localization_catalog_header_t* header{ nullptr };
+    size_t                               size{ 0 };
+    const uint32_t*                      seeds{ nullptr };
+    const localization_catalog_slot_t*   slots{ nullptr };
+    const char*                          strings{ nullptr };
+};
+
+struct localization_catalog_entry_t
+{
+    hash_t         key;
+    uint32_t       bucket;
+    string_const_t value;
+};
+
+struct localization_literal_cache_t
+{
+    const char*    str;
+    size_t         length;
+    uint32_t       generation;
+    string_const_t value;
+};
+
 struct localization_dictionary_t
 {
     char lang[8]{ "en" };
+    localization_catalog_t* catalog{ nullptr };
     config_handle_t config{};
     string_table_t* strings{ nullptr };
     string_locale_t* locales{ nullptr };
@@ -83,8 +137,13 @@ static struct LOCALIZATION_MODULE
     bool build_locales{ false };
     localization_dictionary_t* locales{ nullptr };
 
+    // Incremented each time the dictionary is reloaded to invalidate cached literals.
+    atomic32_t generation{ 1 };
+
 } *_localization_module = nullptr;
 
+static thread_local localization_literal_cache_t _localization_literal_cache[1 << LOCALIZATION_LITERAL_CACHE_SHIFT];
+
 FOUNDATION_FORCEINLINE int localization_string_locale_key_compare(const string_locale_t& lc, const hash_t& key)
 {
     if (lc.key < key)
@@ -98,7 +157,6 @@ FOUNDATION_STATIC string_locale_t* localization_find_string_locale(const localiz
 {
     FOUNDATION_ASSERT(dict);
 
-    // TODO: Add quick hashtable access for literals
     const hash_t key = string_hash(str, length);
     if (out_key)
         *out_key = key;
@@ -117,10 +175,325 @@ FOUNDATION_FORCEINLINE string_const_t localization_locale_to_string_const(const
     return string_table_to_string_const(dict->strings, lc->symbol);
 }
 
+//
+// CATALOG
+//
+
+FOUNDATION_FORCEINLINE uint32_t localization_catalog_bucket(hash_t key, uint32_t bucket_count)
+{
+    return (uint32_t)((key >> 32) % bucket_count);
+}
+
+FOUNDATION_FORCEINLINE uint32_t localization_catalog_slot(hash_t key, uint32_t seed, uint32_t slot_count)
+{
+    uint64_t h = key ^ (seed * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uint32_t)(h % slot_count);
+}
+
+FOUNDATION_FORCEINLINE size_t localization_catalog_seeds_size(uint32_t bucket_count)
+{
+    return ((bucket_count * sizeof(uint32_t)) + 7) & ~(size_t)7;
+}
+
+FOUNDATION_EXTERN bool localization_catalog_lookup(const localization_catalog_t* catalog, hash_t key, string_const_t* out_value)
+{
+    const localization_catalog_header_t* header = catalog->header;
+    if (header->entry_count == 0)
+        return false;
+
+    const uint32_t seed = catalog->seeds[localization_catalog_bucket(key, header->bucket_count)];
+    const localization_catalog_slot_t* slot = catalog->slots + localization_catalog_slot(key, seed, header->slot_count);
+    if (slot->key != key)
+        return false;
+
+    *out_value = string_const(catalog->strings + slot->offset, slot->length);
+    return true;
+}
+
+FOUNDATION_STATIC bool localization_catalog_build_buckets(const localization_catalog_entry_t* entries, uint32_t slot_count, uint32_t* seeds, localization_catalog_slot_t* slots)
+{
+    struct bucket_range_t { uint32_t start, count; };
+    bucket_range_t* buckets = nullptr;
+
+    // Entries are sorted by bucket, so each bucket is a contiguous range of entries.
+    const uint32_t entry_count = array_size(entries);
+    for (uint32_t i = 0; i < entry_count;)
+    {
+        uint32_t end = i + 1;
+        while (end < entry_count && entries[end].bucket == entries[i].bucket)
+            ++end;
+        bucket_range_t range{ i, end - i };
+        array_push(buckets, range);
+        i = end;
+    }
+
+    // Place larger buckets first while most slots are still free.
+    array_sort(buckets, ARRAY_COMPARE_EXPRESSION((int)b.count - (int)a.count));
+
+    bool* taken = (bool*)memory_allocate(HASH_LOCALIZATION, slot_count * sizeof(bool), 0, MEMORY_TEMPORARY | MEMORY_ZERO_INITIALIZED);
+    uint32_t bucket_slots[64];
+
+    bool success = true;
+    foreach(range, buckets)
+    {
+        if (range->count > ARRAY_COUNT(bucket_slots))
+        {
+            success = false;
+            break;
+        }
+
+        uint32_t seed = 0;
+        for (; seed < LOCALIZATION_CATALOG_MAX_SEED; ++seed)
+        {
+            bool collision = false;
+            for (uint32_t i = 0; i < range->count && !collision; ++i)
+            {
+                const uint32_t slot = localization_catalog_slot(entries[range->start + i].key, seed, slot_count);
+                collision = taken[slot];
+                for (uint32_t j = 0; j < i && !collision; ++j)
+                    collision = bucket_slots[j] == slot;
+                bucket_slots[i] = slot;
+            }
+
+            if (!collision)
+                break;
+        }
+
+        if (seed == LOCALIZATION_CATALOG_MAX_SEED)
+        {
+            success = false;
+            break;
+        }
+
+        seeds[entries[range->start].bucket] = seed;
+        for (uint32_t i = 0; i < range->count; ++i)
+        {
+            taken[bucket_slots[i]] = true;
+            slots[bucket_slots[i]].key = entries[range->start + i].key;
+            slots[bucket_slots[i]].offset = range->start + i;
+        }
+    }
+
+    memory_deallocate(taken);
+    array_deallocate(buckets);
+    return success;
+}
+
+/*! Compile a catalog file of translated strings indexed by their source string hash.
+ *
+ *  @param path         Catalog file path
+ *  @param path_length  Length of the catalog file path
+ *  @param lang         Catalog language code
+ *  @param lang_length  Length of the language code
+ *  @param source_md5   Hash of the source the catalog is compiled from, used to invalidate the catalog.
+ *  @param keys         Source string hashes
+ *  @param values       Translated strings for each key
+ *  @param count        Number of keys and values
+ *
+ *  @return True if the catalog file was written.
+ */
+FOUNDATION_EXTERN bool localization_catalog_write(
+    const char* path, size_t path_length,
+    const char* lang, size_t lang_length, uint128_t source_md5,
+    const hash_t* keys, const string_const_t* values, uint32_t count)
+{
+    localization_catalog_entry_t* entries = nullptr;
+    array_reserve(entries, count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // Null keys are reserved for empty slots.
+        if (keys[i] == 0)
+            continue;
+        localization_catalog_entry_t e{ keys[i], 0, values[i] };
+        array_push_memcpy(entries, &e);
+    }
+
+    // Drop duplicated keys, the first translation wins.
+    array_sort(entries, ARRAY_COMPARE_EXPRESSION(a.key < b.key ? -1 : (a.key > b.key ? 1 : 0)));
+    for (uint32_t i = 1; i < array_size(entries);)
+    {
+        if (entries[i].key == entries[i - 1].key)
+            array_erase_ordered(entries, i);
+        else
+            ++i;
+    }
+
+    localization_catalog_header_t header{};
+    memcpy(header.magic, "LCAT", sizeof(header.magic));
+    header.version = LOCALIZATION_CATALOG_VERSION;
+    string_copy(STRING_BUFFER(header.lang), lang, lang_length);
+    header.source_md5 = source_md5;
+    header.entry_count = array_size(entries);
+    header.bucket_count = max(1U, header.entry_count / 4);
+    header.slot_count = max(1U, header.entry_count + header.entry_count / 4);
+
+    uint32_t strings_size = 0;
+    foreach(e, entries)
+    {
+        e->bucket = localization_catalog_bucket(e->key, header.bucket_count);
+        strings_size += (uint32_t)e->value.length + 1;
+    }
+    array_sort(entries, ARRAY_COMPARE_EXPRESSION((int)a.bucket - (int)b.bucket));
+
+    const size_t seeds_size = localization_catalog_seeds_size(header.bucket_count);
+    uint32_t* seeds = (uint32_t*)memory_allocate(HASH_LOCALIZATION, seeds_size, 8, MEMORY_TEMPORARY | MEMORY_ZERO_INITIALIZED);
+    localization_catalog_slot_t* slots = (localization_catalog_slot_t*)memory_allocate(HASH_LOCALIZATION,
+        header.slot_count * sizeof(localization_catalog_slot_t), 8, MEMORY_TEMPORARY | MEMORY_ZERO_INITIALIZED);
+
+    char* strings = (char*)memory_allocate(HASH_LOCALIZATION, max(1U, strings_size), 0, MEMORY_TEMPORARY);
+
+    bool success = localization_catalog_build_buckets(entries, header.slot_count, seeds, slots);
+    if (success)
+    {
+        // Lay out translated strings in slot order, slots hold their entry index until then.
+        for (uint32_t i = 0; i < header.slot_count; ++i)
+        {
+            localization_catalog_slot_t& slot = slots[i];
+            if (slot.key == 0)
+                continue;
+
+            const string_const_t& value = entries[slot.offset].value;
+            slot.offset = header.strings_size;
+            slot.length = (uint32_t)value.length;
+            memcpy(strings + slot.offset, value.str, value.length);
+            strings[slot.offset + slot.length] = 0;
+            header.strings_size += slot.length + 1;
+        }
+
+        // The catalog is written next to the previous one and then replaces it, 
+        // so a catalog mapped by another session is never truncated under its feet.
+        char temp_path_buffer[BUILD_MAX_PATHLEN];
+        string_t temp_path = string_format(STRING_BUFFER(temp_path_buffer), STRING_CONST("%.*s.tmp"), (int)path_length, path);
+        stream_t* stream = fs_open_file(STRING_ARGS(temp_path), STREAM_OUT | STREAM_BINARY | STREAM_CREATE | STREAM_TRUNCATE);
+        if (stream)
+        {
+            stream_write(stream, &header, sizeof(header));
+            stream_write(stream, seeds, seeds_size);
+            stream_write(stream, slots, header.slot_count * sizeof(localization_catalog_slot_t));
+            stream_write(stream, strings, header.strings_size);
+            stream_deallocate(stream);
+
+            success = system_replace_file(STRING_ARGS(temp_path), path, path_length);
+            if (!success)
+                fs_remove_file(STRING_ARGS(temp_path));
+        }
+        else
+        {
+            success = false;
+        }
+    }
+
+    if (!success)
+    {
+        log_warnf(HASH_LOCALIZATION, WARNING_RESOURCE, STRING_CONST("Failed to compile locale catalog %.*s"), (int)path_length, path);
+    }
+
+    memory_deallocate(strings);
+    memory_deallocate(slots);
+    memory_deallocate(seeds);
+    array_deallocate(entries);
+    return success;
+}
+
+FOUNDATION_EXTERN void localization_catalog_close(localization_catalog_t*& catalog)
+{
+    if (catalog == nullptr)
+        return;
+    system_unmap_file(catalog->header, catalog->size);
+    MEM_DELETE(catalog);
+}
+
+/*! Map a compiled catalog and validate that it is up to date.
+ *
+ *  @param path         Catalog file path
+ *  @param path_length  Length of the catalog file path
+ *  @param lang         Expected catalog language code
+ *  @param lang_length  Length of the language code
+ *  @param source_md5   Expected source hash
+ *
+ *  @return Mapped catalog or null if the catalog is missing or out of date.
+ */
+FOUNDATION_EXTERN localization_catalog_t* localization_catalog_open(const char* path, size_t path_length, const char* lang, size_t lang_length, uint128_t source_md5)
+{
+    size_t size = 0;
+    const void* data = system_map_file(path, path_length, &size);
+    if (data == nullptr)
+        return nullptr;
+
+    const localization_catalog_header_t* header = (const localization_catalog_header_t*)data;
+    if (size < sizeof(localization_catalog_header_t) ||
+        memcmp(header->magic, "LCAT", sizeof(header->magic)) != 0 ||
+        header->version != LOCALIZATION_CATALOG_VERSION ||
+        header->lang[sizeof(header->lang) - 1] != 0 ||
+        !string_equal(header->lang, string_length(header->lang), lang, lang_length) ||
+        !uint128_equal(header->source_md5, source_md5) ||
+        header->bucket_count == 0 || header->slot_count == 0)
+    {
+        system_unmap_file(data, size);
+        return nullptr;
+    }
+
+    const size_t seeds_size = localization_catalog_seeds_size(header->bucket_count);
+    const size_t expected_size = sizeof(localization_catalog_header_t) + seeds_size +
+        header->slot_count * sizeof(localization_catalog_slot_t) + header->strings_size;
+    if (size != expected_size)
+    {
+        system_unmap_file(data, size);
+        return nullptr;
+    }
+
+    localization_catalog_t* catalog = MEM_NEW(HASH_LOCALIZATION, localization_catalog_t);
+    catalog->header = header;
+    catalog->size = size;
+    catalog->seeds = (const uint32_t*)(header + 1);
+    catalog->slots = (const localization_catalog_slot_t*)((const uint8_t*)catalog->seeds + seeds_size);
+    catalog->strings = (const char*)(catalog->slots + header->slot_count);
+    return catalog;
+}
+
+FOUNDATION_STATIC string_const_t localization_catalog_path(const char* lang, size_t lang_length)
+{
+    char catalog_name_buffer[32];
+    string_t catalog_name = string_format(STRING_BUFFER(catalog_name_buffer), STRING_CONST("locales_%.*s"), (int)lang_length, lang);
+    return session_get_user_file_path(STRING_ARGS(catalog_name), STRING_CONST("cache"), STRING_CONST("catalog"), true);
+}
+
+FOUNDATION_STATIC bool localization_catalog_compile(localization_dictionary_t* dict, string_const_t catalog_path, uint128_t source_md5)
+{
+    hash_t* keys = nullptr;
+    string_const_t* values = nullptr;
+    foreach(lc, dict->locales)
+    {
+        if (lc->symbol == 0 || any(lc->type, LocaleType::Default | LocaleType::Missing))
+            continue;
+        array_push(keys, lc->key);
+        array_push(values, string_table_to_string_const(dict->strings, lc->symbol));
+    }
+
+    const bool compiled = localization_catalog_write(STRING_ARGS(catalog_path), dict->lang, string_length(dict->lang),
+        source_md5, keys, values, array_size(keys));
+    array_deallocate(values);
+    array_deallocate(keys);
+    return compiled;
+}
+
 FOUNDATION_STATIC string_const_t localization_get_locale(const localization_dictionary_t* dict, const char* str, size_t length, bool literal)
 {
     FOUNDATION_ASSERT(dict);
 
+    PERFORMANCE_TRACKER("tr");
+
+    if (dict->catalog)
+    {
+        string_const_t value;
+        if (localization_catalog_lookup(dict->catalog, string_hash(str, length), &value))
+            return value;
+        return string_const(str, length);
+    }
+
     string_locale_t* string_locale = localization_find_string_locale(dict, str, length, literal);
     if (string_locale == nullptr)
         return string_const(str, length);
@@ -128,6 +501,22 @@ FOUNDATION_STATIC string_const_t localization_get_locale(const localization_dict
     return localization_locale_to_string_const(dict, string_locale, str, length);
 }
 
+FOUNDATION_STATIC string_const_t localization_get_literal_locale(const localization_dictionary_t* dict, const char* str, size_t length)
+{
+    // Literals have a stable address, so the address identifies the call site string without hashing its content.
+    const uint32_t generation = (uint32_t)atomic_load32(&_localization_module->generation, memory_order_relaxed);
+    const size_t index = (size_t)(((uintptr_t)str * 0x9E3779B97F4A7C15ULL) >> (64 - LOCALIZATION_LITERAL_CACHE_SHIFT));
+    localization_literal_cache_t& cache = _localization_literal_cache[index];
+    if (cache.str == str && cache.length == length && cache.generation == generation)
+        return cache.value;
+
+    cache.value = localization_get_locale(dict, str, length, true);
+    cache.str = str;
+    cache.length = length;
+    cache.generation = generation;
+    return cache.value;
+}
+
 FOUNDATION_STATIC config_handle_t localization_create_locale_config(localization_dictionary_t* dict)
 {
     config_handle_t& config = dict->config;
@@ -248,15 +637,7 @@ FOUNDATION_STATIC localization_dictionary_t* localization_load_system_locales(st
 
     const bool has_config_locales = fs_is_file(STRING_ARGS(locales_json_path));
 
-    config_handle_t cv = has_config_locales ? 
-        config_parse_file(STRING_ARGS(locales_json_path), CONFIG_OPTION_PRESERVE_INSERTION_ORDER | CONFIG_OPTION_PARSE_UNICODE_UTF8) :
-        localization_locales_new_config();
-    FOUNDATION_ASSERT(cv);
-
     localization_dictionary_t* dict = MEM_NEW(HASH_LOCALIZATION, localization_dictionary_t);
-    
-    dict->config = cv;
-    dict->strings = string_table_allocate(64 * 1024, 32);
 
     // Check if language is specified through the command line
     if (string_is_null(user_lang))
@@ -279,6 +660,28 @@ FOUNDATION_STATIC localization_dictionary_t* localization_load_system_locales(st
 
     dict->is_default_language = string_equal_nocase(STRING_ARGS(user_lang), STRING_CONST("en"));
 
+    // Use the compiled catalog unless we are building locales, in which case we need the editable config.
+    const bool use_catalog = has_config_locales && !_localization_module->build_locales;
+    const uint128_t source_md5 = use_catalog ? fs_md5(STRING_ARGS(locales_json_path)) : uint128_null();
+    char catalog_path_buffer[BUILD_MAX_PATHLEN];
+    string_const_t catalog_path{};
+    if (use_catalog)
+    {
+        string_const_t path = localization_catalog_path(STRING_ARGS(user_lang));
+        catalog_path = string_to_const(string_copy(STRING_BUFFER(catalog_path_buffer), STRING_ARGS(path)));
+        dict->catalog = localization_catalog_open(STRING_ARGS(catalog_path), STRING_ARGS(user_lang), source_md5);
+        if (dict->catalog)
+            return dict;
+    }
+
+    config_handle_t cv = has_config_locales ? 
+        config_parse_file(STRING_ARGS(locales_json_path), CONFIG_OPTION_PRESERVE_INSERTION_ORDER | CONFIG_OPTION_PARSE_UNICODE_UTF8) :
+        localization_locales_new_config();
+    FOUNDATION_ASSERT(cv);
+
+    dict->config = cv;
+    dict->strings = string_table_allocate(64 * 1024, 32);
+
     // Load locale string
     auto strings = cv["strings"];
     for (auto str : strings)
@@ -324,14 +727,20 @@ FOUNDATION_STATIC localization_dictionary_t* localization_load_system_locales(st
 
     dict->locales = localization_sort_locales(dict->locales);
 
+    // Compile the catalog so the next session can map it instead of parsing the locales.
+    if (use_catalog && localization_catalog_compile(dict, catalog_path, source_md5))
+        dict->catalog = localization_catalog_open(STRING_ARGS(catalog_path), STRING_ARGS(user_lang), source_md5);
+
     return dict;
 }
 
 FOUNDATION_STATIC void localization_dictionary_deallocate(localization_dictionary_t*& dict)
 {
+    localization_catalog_close(dict->catalog);
     array_deallocate(dict->locales);
     config_deallocate(dict->config);
-    string_table_deallocate(dict->strings);
+    if (dict->strings)
+        string_table_deallocate(dict->strings);
     MEM_DELETE(dict);
 }
 
@@ -350,8 +759,6 @@ const char* tr_cstr(const char* str, size_t length /*= SIZE_MAX*/)
 #if BUILD_ENABLE_LOCALIZATION
 string_const_t tr(const char* str, size_t length, bool literal /*= false*/)
 {
-    PERFORMANCE_TRACKER("tr");
-
     if (str == nullptr || _localization_module == nullptr)
         return string_null();
 
@@ -367,6 +774,9 @@ string_const_t tr(const char* str, size_t length, bool literal /*= false*/)
         return localization_dict_build_locale(dict, str, length, literal);
     #endif
 
+    if (literal)
+        return localization_get_literal_locale(dict, str, length);
+
     return localization_get_locale(dict, str, length, literal);
 }
 
@@ -421,6 +831,7 @@ bool localization_set_current_language(const char* lang, size_t lang_length)
             // Reload the locales
             localization_dictionary_deallocate(_localization_module->locales);
             _localization_module->locales = localization_load_system_locales(locales_lang);
+            atomic_incr32(&_localization_module->generation, memory_order_release);
             return dispatcher_post_event(EVENT_LOCALIZATION_LANGUAGE_CHANGED, (void*)locales_lang.str, locales_lang.length, DISPATCHER_EVENT_OPTION_COPY_DATA);
         }
     }
@@ -41,8 +41,8 @@ extern thread_local size_t _tr_out_size;
  * 
  *  @param str String to translate.
  *  @param length Length of the string.
- *  @param literal If true, the string is a literal.
- *                 Compile time constant string use an hashtable to quickly retrieve the translated string.
+ *  @param literal If true, the string is a literal with a stable address.
+ *                 Literals are cached per thread by address, so repeated calls resolve without hashing the string.
  * 
  *  @return Translated constant string object.
  */
@@ -8,6 +8,9 @@
 #include <framework/array.h>
 #include <framework/common.h>
 #include <framework/profiler.h>
+#include <framework/jobs.h>
+
+#include <foundation/environment.h>
 
 #define HASH_SERVICE_TABS (static_hash_string("service_tabs", 12, 0xeee279126075ccf8ULL))
 #define HASH_SERVICE_MENU (static_hash_string("service_menu", 12, 0x597ea6b5d910db56ULL))
@@ -26,6 +29,8 @@ struct module_t
     hash_t key;
     char name[64];
     int priority;
+    module_flags_t flags;
+    const char* dependencies;
 
     // Creation handlers
     module_initialize_handler_t initialize;
@@ -35,6 +40,21 @@ struct module_t
     module_handler_t* handlers{ nullptr };
 };
 
+/*! Initialization state of a module, indexed like #_modules. */
+struct module_init_t
+{
+    const module_t* module{ nullptr };
+    int      index{ -1 };           // Order of the module, i.e. see #module_initialization_order
+    uint64_t dependencies{ 0 };     // Bit mask of the modules to initialize first
+    job_t*   job{ nullptr };
+    bool     started{ false };
+    bool     completed{ false };
+    bool     main_thread{ false };
+    int      blocker{ -1 };         // Last dependency to complete, used to report the critical path
+    tick_t   start{ 0 };
+    tick_t   end{ 0 };
+};
+
 /*! Modules are usually registered before main() is called,
  *  that is why we provide a fixed set of them.
  */
@@ -46,6 +66,9 @@ static size_t _module_count = 0;
 /*! Flag to check if static modules have been initialized. */
 static bool _modules_initialize = false;
 
+/*! Index of the module being initialized by the current thread. */
+static thread_local int _module_initializing = -1;
+
 //
 // PRIVATE
 // 
@@ -53,7 +76,7 @@ static bool _modules_initialize = false;
 Module::Module(const char* FOUNDATION_RESTRICT name, hash_t service_hash,
     module_initialize_handler_t initialize_handler,
     module_shutdown_handler_t shutdown_handler,
-    int priority)
+    int priority, module_flags_t flags, const char* dependencies)
 {
     const size_t MAX_SERVICE_COUNT = ARRAY_COUNT(_modules);
     FOUNDATION_ASSERT(_modules_initialize == false);
@@ -62,6 +85,8 @@ Module::Module(const char* FOUNDATION_RESTRICT name, hash_t service_hash,
     module_t s{ service_hash };
     string_copy(STRING_BUFFER(s.name), name, string_length(name));
     s.priority = priority;
+    s.flags = flags;
+    s.dependencies = dependencies;
     s.initialize = initialize_handler;
     s.shutdown = shutdown_handler;
 
@@ -103,34 +128,253 @@ FOUNDATION_STATIC module_handler_t* service_get_or_create_handler(module_t* serv
     return array_last(service->handlers);
 }
 
-//
-// # PUBLIC API
-// 
+FOUNDATION_STATIC int module_index_of(const module_t* modules, size_t count, const char* name, size_t length)
+{
+    for (size_t i = 0; i != count; ++i)
+    {
+        if (string_equal_nocase(name, length, modules[i].name, string_length(modules[i].name)))
+            return (int)i;
+    }
 
-void module_initialize()
+    return -1;
+}
+
+FOUNDATION_STATIC void module_resolve_dependencies(module_t* modules, size_t count, module_init_t* inits, bool serial)
 {
-    for (size_t i = 0, end = _module_count; i != end; ++i)
+    for (size_t i = 0; i != count; ++i)
     {
-        module_t& s = _modules[i];
+        const module_t& s = modules[i];
+        module_init_t& init = inits[i];
+        init = {};
+        init.module = &modules[i];
+        init.index = (int)i;
+        init.main_thread = serial || 
+            s.priority <= MODULE_PRIORITY_SYSTEM || s.priority >= MODULE_PRIORITY_UI || 
+            (s.flags & MODULE_MAIN_THREAD) != 0;
+
+        for (size_t j = 0; j != i; ++j)
+        {
+            // Critical and system modules are always initialized first.
+            const module_t& d = modules[j];
+            if (d.priority < s.priority && (s.dependencies == nullptr || d.priority <= MODULE_PRIORITY_SYSTEM))
+                init.dependencies |= 1ULL << j;
+        }
 
-        if (s.priority >= MODULE_PRIORITY_UI && main_is_batch_mode())
+        string_const_t r = string_const(s.dependencies, string_length(s.dependencies));
+        while (r.length > 0)
         {
-            s.shutdown = nullptr;
-            log_debugf(s.key, STRING_CONST("Service %s skipped (batch mode)"), s.name);
+            string_const_t name;
+            string_split(STRING_ARGS(r), STRING_CONST(","), &name, &r, false);
+            name = string_trim(name);
+            if (name.length == 0)
+                continue;
+
+            const int dependency_index = module_index_of(modules, count, STRING_ARGS(name));
+            if (dependency_index < 0 || dependency_index == (int)i)
+            {
+                log_warnf(s.key, WARNING_INVALID_VALUE, STRING_CONST("Module %s has an invalid dependency %.*s"), s.name, STRING_FORMAT(name));
+                continue;
+            }
+            init.dependencies |= 1ULL << dependency_index;
+        }
+    }
+}
+
+FOUNDATION_STATIC bool module_dependencies_completed(const module_init_t* inits, size_t count, module_init_t& init)
+{
+    tick_t last_end = 0;
+    for (int index = 0, end = (int)count; index != end; ++index)
+    {
+        if ((init.dependencies & (1ULL << index)) == 0)
             continue;
+
+        if (!inits[index].completed)
+            return false;
+
+        if (inits[index].end >= last_end)
+        {
+            last_end = inits[index].end;
+            init.blocker = index;
         }
+    }
+
+    return true;
+}
+
+FOUNDATION_STATIC void module_initialize_service(module_init_t& init)
+{
+    const module_t& s = *init.module;
+    log_debugf(s.key, STRING_CONST("Service %s initialization"), s.name);
+
+    _module_initializing = init.index;
+    init.start = time_current();
+    {
+        PERFORMANCE_TRACKER_FORMAT("Service::%s", s.name);
+        s.initialize();
+    }
+    init.end = time_current();
+    _module_initializing = -1;
+}
+
+FOUNDATION_STATIC void module_log_critical_path(const module_init_t* inits, size_t count, double elapsed_time)
+{
+    int last = -1;
+    double total_time = 0;
+    for (size_t i = 0; i != count; ++i)
+    {
+        if (inits[i].end == 0)
+            continue;
+
+        const double module_time = time_ticks_to_milliseconds(inits[i].end - inits[i].start);
+        total_time += module_time;
+        log_debugf(inits[i].module->key, STRING_CONST("Service %s initialized in %.3lf ms%s"), 
+            inits[i].module->name, module_time, inits[i].main_thread ? " (main thread)" : "");
+        if (last < 0 || inits[i].end > inits[last].end)
+            last = (int)i;
+    }
+
+    // Walk back the chain of modules that delayed the last module to complete.
+    char path_buffer[1024];
+    size_t path_length = 0;
+    for (int i = last; i >= 0; i = inits[i].blocker)
+    {
+        if (inits[i].end == 0)
+            continue;
         
-        log_debugf(s.key, STRING_CONST("Service %s initialization"), s.name);
+        string_t step = string_format(path_buffer + path_length, sizeof(path_buffer) - path_length, 
+            STRING_CONST("%s%s (%.1lf ms)"), path_length ? " < " : "", inits[i].module->name, 
+            time_ticks_to_milliseconds(inits[i].end - inits[i].start));
+        path_length += step.length;
+    }
+
+    log_infof(0, STRING_CONST("Modules initialized in %.1lf ms (%.1lf ms of initialization), critical path: %.*s"),
+        elapsed_time * 1000.0, total_time, (int)path_length, path_buffer);
+}
 
+/*! Initialize modules as soon as their dependencies are initialized.
+ * 
+ *  @return Number of modules left uninitialized, which is only the case if dependencies have a cycle.
+ */
+FOUNDATION_STATIC size_t module_schedule(module_t* modules, size_t count, bool serial)
+{
+    static_assert(ARRAY_COUNT(_modules) <= 64, "Module dependencies are stored in a 64 bits mask");
+    FOUNDATION_ASSERT(count <= ARRAY_COUNT(_modules));
+
+    module_init_t inits[ARRAY_COUNT(_modules)];
+    module_resolve_dependencies(modules, count, inits, serial);
+
+    const tick_t start_time = time_current();
+    size_t remaining = count;
+    while (remaining > 0)
+    {
+        bool progress = false;
+        for (size_t i = 0; i != count; ++i)
         {
-            PERFORMANCE_TRACKER_FORMAT("Service::%s", s.name);
-            s.initialize();
+            module_t& s = modules[i];
+            module_init_t& init = inits[i];
+
+            if (init.started && !init.completed && job_completed(init.job))
+            {
+                job_deallocate(init.job);
+                init.completed = true;
+                progress = true;
+                remaining--;
+            }
+
+            if (init.started || !module_dependencies_completed(inits, count, init))
+                continue;
+
+            init.started = true;
+            if (s.priority >= MODULE_PRIORITY_UI && main_is_batch_mode())
+            {
+                s.shutdown = nullptr;
+                log_debugf(s.key, STRING_CONST("Service %s skipped (batch mode)"), s.name);
+                init.completed = true;
+            }
+            else if (init.main_thread)
+            {
+                module_initialize_service(init);
+                init.completed = true;
+            }
+            else
+            {
+                init.job = job_execute([](payload_t* payload)
+                {
+                    module_initialize_service(*(module_init_t*)payload);
+                    return 0;
+                }, &init);
+            }
+
+            progress = true;
+            if (init.completed)
+                remaining--;
+        }
+
+        if (!progress)
+        {
+            // Make sure we are not waiting for modules that can never be initialized.
+            bool running = false;
+            for (size_t i = 0; i != count && !running; ++i)
+                running = inits[i].started && !inits[i].completed;
+            if (!running)
+            {
+                log_errorf(0, ERROR_INTERNAL_FAILURE, STRING_CONST("Module dependency cycle detected, %zu modules left uninitialized"), remaining);
+                break;
+            }
+
+            // Sleep until a module job completes, the timeout covers completions consumed by other waiters.
+            job_wait_any(100);
         }
     }
 
+    module_log_critical_path(inits, count, time_elapsed(start_time));
+    return remaining;
+}
+
+//
+// # PUBLIC API
+// 
+
+void module_initialize()
+{
+    const bool serial = environment_argument("serial-init");
+    const size_t uninitialized_count = module_schedule(_modules, _module_count, serial);
+    FOUNDATION_ASSERT_MSG(uninitialized_count == 0, "Module dependency cycle detected");
+    FOUNDATION_UNUSED(uninitialized_count);
+
     _modules_initialize = true;
 }
 
+int module_initialization_order()
+{
+    if (_module_initializing >= 0)
+        return _module_initializing;
+    return (int)_module_count;
+}
+
+#if BUILD_TESTS
+size_t module_initialize_test(const module_test_t* tests, size_t count, bool serial)
+{
+    module_t modules[ARRAY_COUNT(_modules)];
+    FOUNDATION_ASSERT(count <= ARRAY_COUNT(modules));
+
+    for (size_t i = 0; i != count; ++i)
+    {
+        const module_test_t& t = tests[i];
+        module_t& s = modules[i];
+        s = module_t{ string_hash(t.name, string_length(t.name)) };
+        string_copy(STRING_BUFFER(s.name), t.name, string_length(t.name));
+        s.priority = t.priority;
+        s.flags = t.flags;
+        s.dependencies = t.dependencies;
+        s.initialize = t.initialize;
+    }
+    array_sort(modules, count, [](const auto& a, const auto& b) { return a.priority - b.priority; });
+
+    return count - module_schedule(modules, count, serial);
+}
+#endif
+
 void module_shutdown()
 {
     for (int i = (int)_module_count - 1; i >= 0; --i)
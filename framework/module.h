@@ -30,6 +30,17 @@ constexpr int MODULE_PRIORITY_TESTS       =  (100);
 constexpr int MODULE_PRIORITY_UI_HEADLESS =  (190);
 constexpr int MODULE_PRIORITY_UI          =  (200);
 
+typedef enum ModuleFlags : uint32_t
+{
+    MODULE_FLAGS_NONE = 0,
+
+    /*! The module must be initialized on the main thread. 
+     *  Modules with a priority of #MODULE_PRIORITY_SYSTEM or less and #MODULE_PRIORITY_UI or more are always pinned to the main thread.
+     */
+    MODULE_MAIN_THREAD = 1 << 0,
+
+} module_flags_t;
+
 FOUNDATION_FORCEINLINE const char* module_name_to_lower_static(const char* name, size_t len)
 {
     static thread_local char ts_name_buffer[16];
@@ -44,7 +55,9 @@ FOUNDATION_FORCEINLINE const char* module_name_to_lower_static(const char* name,
  * @param NAME          Name of the module/service.
  * @param initialize_fn Function to call to initialize the service.
  * @param shutdown_fn   Function to call to shutdown the service.
- * @param ...           Optional priority of the service.
+ * @param ...           Optional priority of the service, #module_flags_t and comma separated
+ *                      names of the modules it depends on, i.e. "STOCK,EOD". 
+ *                      Without explicit dependencies, a module depends on all modules of lower priority.
  */
 #define DEFINE_MODULE(NAME, initialize_fn, shutdown_fn, ...)    \
     const Module __##NAME##_service(#NAME, HASH_##NAME, [](){   \
@@ -62,7 +75,9 @@ public:
     FOUNDATION_NOINLINE Module(const char* FOUNDATION_RESTRICT name, hash_t module_hash,
         module_initialize_handler_t initialize_handler,
         module_shutdown_handler_t shutdown_handler,
-        int priority);
+        int priority, 
+        module_flags_t flags = MODULE_FLAGS_NONE, 
+        const char* dependencies = nullptr);
 
     FOUNDATION_NOINLINE Module(const char* FOUNDATION_RESTRICT name, hash_t module_hash,
         module_initialize_handler_t initialize_handler,
@@ -72,9 +87,44 @@ public:
     }
 };
 
-/*! Initialize the service system and all statically registered services. */
+/*! Initialize the service system and all statically registered services. 
+ * 
+ *  Modules are initialized following their dependencies. Modules not pinned to the main thread
+ *  are initialized on the job threads as soon as their dependencies are initialized.
+ *  Use the --serial-init command line argument to initialize all modules on the main thread.
+ */
 void module_initialize();
 
+/*! Returns the order of the module being initialized by the calling thread.
+ * 
+ *  Modules can get initialized concurrently, so registries filled by modules use 
+ *  this order to stay deterministic. Registrations made outside of a module 
+ *  initialization come after all modules.
+ */
+int module_initialization_order();
+
+#if BUILD_TESTS
+/*! Module description used to exercise the module initialization schedule in tests. */
+struct module_test_t
+{
+    const char* name;
+    int priority;
+    module_flags_t flags;
+    const char* dependencies;
+    module_initialize_handler_t initialize;
+};
+
+/*! Initialize a set of test modules following the same schedule as #module_initialize.
+ *
+ *  @param modules  Modules to initialize.
+ *  @param count    Number of modules.
+ *  @param serial   Initialize all modules on the calling thread.
+ *
+ *  @return Number of modules initialized, which is less than @count if dependencies have a cycle.
+ */
+size_t module_initialize_test(const module_test_t* modules, size_t count, bool serial);
+#endif
+
 /*! Shutdown the service system and all other registered services. */
 void module_shutdown();
 
@@ -19,6 +19,8 @@
 #include <foundation/stream.h>
 #include <foundation/environment.h>
 #include <foundation/time.h>
+#include <foundation/thread.h>
+#include <foundation/fs.h>
 
 #include <bx/sort.h>
 
@@ -29,6 +31,9 @@
 #define PROFILE_ID_ENDFRAME (4)
 #define PROFILE_LAST_BUILTIN_ID (12)
 
+#define PROFILER_TRACE_BUFFER_CAPACITY (16 * 1024)
+#define PROFILER_TRACE_MAX_DEPTH (64)
+
 struct profile_block_data_t {
     int32_t id;
     int32_t parentid;
@@ -55,8 +60,72 @@ struct profile_tracker_t {
     char name[MAX_MESSAGE_LENGTH + 1];
 };
 
+struct profiler_trace_event_t
+{
+    tick_t   start;
+    tick_t   end;
+    uint64_t flow_id;
+    char     phase;     // Chrome trace event phase, X for complete scopes, s and f for flows.
+    char     name[39];
+};  // sizeof(profiler_trace_event_t) == 64
+
+struct profiler_trace_frame_t
+{
+    tick_t start;
+    char   name[ARRAY_COUNT(profiler_trace_event_t::name)];
+};
+
+/*! Ownership states of a thread trace buffer. */
+enum profiler_trace_buffer_state_t : int32_t
+{
+    PROFILER_TRACE_BUFFER_FREE = 0,     // The owning thread exited, the buffer can be reused.
+    PROFILER_TRACE_BUFFER_OWNED = 1,    // A live thread records events in the buffer.
+    PROFILER_TRACE_BUFFER_RETIRED = 2,  // The profiler shut down, the owning thread releases the buffer when it exits.
+};
+
+/*! Single producer ring of trace events owned by one thread. 
+ *  Only the owning thread writes events and advances #head, and the exporter reads events 
+ *  between #tail and #head. Clearing only moves #tail so the owning thread is never disturbed.
+ */
+struct profiler_trace_buffer_t
+{
+    profiler_trace_buffer_t* next;
+    uint64_t                 thread_id;
+    char                     thread_name[32];
+
+    atomic32_t               state;
+    atomic64_t               tail;
+    atomic64_t               head;
+    unsigned                 depth;
+    profiler_trace_frame_t   stack[PROFILER_TRACE_MAX_DEPTH];
+    profiler_trace_event_t   events[PROFILER_TRACE_BUFFER_CAPACITY];
+};
+
+atomic32_t _profiler_trace_enabled{};
+static atomic64_t _profiler_trace_flow_counter{};
+static atomicptr_t _profiler_trace_buffers{};
+static tick_t _profiler_trace_start_time = 0;
+/*! Release the thread trace buffer when the owning thread exits so another thread can reuse it. */
+struct profiler_trace_buffer_owner_t
+{
+    profiler_trace_buffer_t* buffer{ nullptr };
+
+    ~profiler_trace_buffer_owner_t()
+    {
+        if (buffer == nullptr)
+            return;
+
+        // The profiler already shut down and left the buffer to us.
+        if (!atomic_cas32(&buffer->state, PROFILER_TRACE_BUFFER_FREE, PROFILER_TRACE_BUFFER_OWNED, memory_order_release, memory_order_acquire))
+            memory_deallocate(buffer);
+        buffer = nullptr;
+    }
+};
+
+static thread_local profiler_trace_buffer_owner_t _profiler_trace_owner;
+static string_t _profiler_trace_log_path{};
+
 static bool _profiler_initialized = false;
-static stream_t* _profile_stream = nullptr;
 
 static shared_mutex _trackers_lock;
 static profile_tracker_t* _trackers = nullptr;
@@ -152,8 +221,96 @@ FOUNDATION_STATIC void profiler_tracker(void* buffer, size_t size)
             //system_process_debug_output(profile_msg);
         }
     }
-    if (_profile_stream)
-        stream_write(_profile_stream, buffer, size);
+}
+
+FOUNDATION_STATIC profiler_trace_buffer_t* profiler_trace_thread_buffer()
+{
+    profiler_trace_buffer_t* buffer = _profiler_trace_owner.buffer;
+    if (buffer)
+        return buffer;
+
+    // Reuse a buffer released by a thread that exited if possible.
+    buffer = (profiler_trace_buffer_t*)atomic_load_ptr(&_profiler_trace_buffers, memory_order_acquire);
+    for (; buffer; buffer = buffer->next)
+    {
+        if (atomic_load32(&buffer->state, memory_order_relaxed) == PROFILER_TRACE_BUFFER_FREE &&
+            atomic_cas32(&buffer->state, PROFILER_TRACE_BUFFER_OWNED, PROFILER_TRACE_BUFFER_FREE, memory_order_acquire, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    const bool reused = buffer != nullptr;
+    if (reused)
+    {
+        // Events of the previous thread would be exported under the new thread name, so they are dropped.
+        atomic_store64(&buffer->tail, atomic_load64(&buffer->head, memory_order_relaxed), memory_order_release);
+        buffer->depth = 0;
+    }
+    else
+    {
+        buffer = (profiler_trace_buffer_t*)memory_allocate(HASH_PROFILER, 
+            sizeof(profiler_trace_buffer_t), 8, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+        atomic_store32(&buffer->state, PROFILER_TRACE_BUFFER_OWNED, memory_order_relaxed);
+    }
+
+    buffer->thread_id = thread_id();
+    thread_t* thread = thread_self();
+    string_const_t name = thread ? thread_name(thread) : (thread_is_main() ? CTEXT("Main") : CTEXT("Thread"));
+    string_copy(STRING_BUFFER(buffer->thread_name), STRING_ARGS(name));
+
+    // Publish new buffers in the lock free list of thread buffers.
+    if (!reused)
+    {
+        void* head = nullptr;
+        do
+        {
+            head = atomic_load_ptr(&_profiler_trace_buffers, memory_order_acquire);
+            buffer->next = (profiler_trace_buffer_t*)head;
+        } while (!atomic_cas_ptr(&_profiler_trace_buffers, buffer, head, memory_order_release, memory_order_acquire));
+    }
+
+    _profiler_trace_owner.buffer = buffer;
+    return buffer;
+}
+
+FOUNDATION_STATIC void profiler_trace_push_event(profiler_trace_buffer_t* buffer, char phase, tick_t start, tick_t end, uint64_t flow_id, const char* name, size_t length)
+{
+    const int64_t head = atomic_load64(&buffer->head, memory_order_relaxed);
+    profiler_trace_event_t& e = buffer->events[head & (PROFILER_TRACE_BUFFER_CAPACITY - 1)];
+    e.start = start;
+    e.end = end;
+    e.flow_id = flow_id;
+    e.phase = phase;
+    string_copy(STRING_BUFFER(e.name), name, length);
+    atomic_store64(&buffer->head, head + 1, memory_order_release);
+}
+
+FOUNDATION_STATIC double profiler_trace_time_us(tick_t time)
+{
+    return time_ticks_to_seconds(time - _profiler_trace_start_time) * 1000000.0;
+}
+
+FOUNDATION_STATIC void profiler_trace_write_json_string(stream_t* stream, const char* str)
+{
+    char buffer[ARRAY_COUNT(profiler_trace_event_t::name) * 2 + 2];
+    size_t length = 0;
+    buffer[length++] = '"';
+    for (; *str; ++str)
+    {
+        const char c = *str;
+        if (c == '"' || c == '\\')
+            buffer[length++] = '\\';
+        buffer[length++] = ((unsigned char)c < 0x20) ? ' ' : c;
+    }
+    buffer[length++] = '"';
+    stream_write(stream, buffer, length);
+}
+
+FOUNDATION_STATIC string_const_t profiler_trace_default_path()
+{
+    string_const_t timestamp = string_from_uint_static(time_system(), false, 0, 0);
+    return session_get_user_file_path(STRING_ARGS(timestamp), STRING_CONST("profiles"), STRING_CONST("json"), true);
 }
 
 FOUNDATION_STATIC void profiler_render_time_ms_column(double time_ms)
@@ -239,6 +396,17 @@ FOUNDATION_STATIC void profiler_window_render()
         if (_profiler_table == nullptr)
             profiler_create_table();
 
+        bool trace_enabled = profiler_trace_enabled();
+        if (ImGui::Checkbox(tr("Record trace"), &trace_enabled))
+            profiler_trace_enable(trace_enabled);
+
+        ImGui::SameLine();
+        if (ImGui::Button(tr("Export trace")))
+        {
+            string_const_t trace_path = profiler_trace_default_path();
+            profiler_trace_export(STRING_ARGS(trace_path));
+        }
+
         if (_trackers_lock.shared_lock())
         {
             table_render(_profiler_table, _trackers, array_size(_trackers), sizeof(profile_tracker_t), 0.0f, 0.0f);
@@ -279,6 +447,128 @@ FOUNDATION_STATIC void profiler_menu()
 // # PUBLIC API
 //
 
+void profiler_trace_enable(bool enabled)
+{
+    if (enabled && _profiler_trace_start_time == 0)
+        _profiler_trace_start_time = time_current();
+    atomic_store32(&_profiler_trace_enabled, enabled ? 1 : 0, memory_order_release);
+}
+
+void profiler_trace_clear()
+{
+    // Only move the read position of each ring, the owning threads keep writing 
+    // from their own head and scopes currently opened remain on their stack.
+    profiler_trace_buffer_t* buffer = (profiler_trace_buffer_t*)atomic_load_ptr(&_profiler_trace_buffers, memory_order_acquire);
+    for (; buffer; buffer = buffer->next)
+        atomic_store64(&buffer->tail, atomic_load64(&buffer->head, memory_order_acquire), memory_order_release);
+}
+
+void profiler_trace_begin(const char* name, size_t length)
+{
+    profiler_trace_buffer_t* buffer = profiler_trace_thread_buffer();
+    if (buffer->depth < PROFILER_TRACE_MAX_DEPTH)
+    {
+        profiler_trace_frame_t& frame = buffer->stack[buffer->depth];
+        string_copy(STRING_BUFFER(frame.name), name, length);
+        frame.start = time_current();
+    }
+    buffer->depth++;
+}
+
+void profiler_trace_end()
+{
+    profiler_trace_buffer_t* buffer = _profiler_trace_owner.buffer;
+    if (buffer == nullptr || buffer->depth == 0)
+        return;
+
+    const tick_t end = time_current();
+    if (--buffer->depth >= PROFILER_TRACE_MAX_DEPTH)
+        return;
+
+    const profiler_trace_frame_t& frame = buffer->stack[buffer->depth];
+    profiler_trace_push_event(buffer, 'X', frame.start, end, 0, frame.name, string_length(frame.name));
+}
+
+uint64_t profiler_trace_flow_begin(const char* name, size_t length)
+{
+    if (!profiler_trace_enabled())
+        return 0;
+
+    const uint64_t flow_id = (uint64_t)atomic_incr64(&_profiler_trace_flow_counter, memory_order_relaxed);
+
+    // Flow events bind to an enclosing slice, so the submission gets its own slice.
+    profiler_trace_buffer_t* buffer = profiler_trace_thread_buffer();
+    const tick_t start = time_current();
+    profiler_trace_push_event(buffer, 's', start, start, flow_id, name, length);
+    profiler_trace_push_event(buffer, 'X', start, start + max((tick_t)1, time_ticks_per_second() / 1000000), 0, name, length);
+    return flow_id;
+}
+
+void profiler_trace_flow_end(uint64_t flow_id, const char* name, size_t length)
+{
+    if (flow_id == 0)
+        return;
+
+    profiler_trace_buffer_t* buffer = profiler_trace_thread_buffer();
+    const tick_t time = time_current();
+    profiler_trace_push_event(buffer, 'f', time, time, flow_id, name, length);
+}
+
+bool profiler_trace_export(const char* path, size_t length)
+{
+    stream_t* stream = fs_open_file(path, length, STREAM_CREATE | STREAM_OUT | STREAM_TRUNCATE);
+    if (stream == nullptr)
+        return false;
+
+    char line_buffer[256];
+    size_t event_count = 0;
+    stream_write(stream, STRING_CONST("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+
+    const profiler_trace_buffer_t* buffer = (const profiler_trace_buffer_t*)atomic_load_ptr(&_profiler_trace_buffers, memory_order_acquire);
+    for (; buffer; buffer = buffer->next)
+    {
+        string_t line = string_format(STRING_BUFFER(line_buffer), 
+            STRING_CONST("%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%llu,\"name\":\"thread_name\",\"args\":{\"name\":"),
+            event_count++ ? "," : "", buffer->thread_id);
+        stream_write(stream, STRING_ARGS(line));
+        profiler_trace_write_json_string(stream, buffer->thread_name);
+        stream_write(stream, STRING_CONST("}}"));
+
+        // Skip the oldest events of a full ring as the owning thread might be overwriting them.
+        const int64_t head = atomic_load64(&buffer->head, memory_order_acquire);
+        int64_t tail = atomic_load64(&buffer->tail, memory_order_acquire);
+        if (head >= PROFILER_TRACE_BUFFER_CAPACITY)
+            tail = max(tail, head - PROFILER_TRACE_BUFFER_CAPACITY + PROFILER_TRACE_MAX_DEPTH);
+
+        for (int64_t i = tail; i < head; ++i)
+        {
+            const profiler_trace_event_t& e = buffer->events[i & (PROFILER_TRACE_BUFFER_CAPACITY - 1)];
+            if (e.phase == 'X')
+            {
+                line = string_format(STRING_BUFFER(line_buffer), 
+                    STRING_CONST(",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3lf,\"dur\":%.3lf,\"name\":"),
+                    buffer->thread_id, profiler_trace_time_us(e.start), time_ticks_to_seconds(e.end - e.start) * 1000000.0);
+            }
+            else
+            {
+                line = string_format(STRING_BUFFER(line_buffer), 
+                    STRING_CONST(",\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%llu,\"ts\":%.3lf,\"id\":%llu,\"cat\":\"flow\",%s\"name\":"),
+                    e.phase, buffer->thread_id, profiler_trace_time_us(e.start), e.flow_id, e.phase == 'f' ? "\"bp\":\"e\"," : "");
+            }
+            stream_write(stream, STRING_ARGS(line));
+            profiler_trace_write_json_string(stream, e.name);
+            stream_write(stream, STRING_CONST("}"));
+            event_count++;
+        }
+    }
+
+    stream_write(stream, STRING_CONST("\n]}\n"));
+    stream_deallocate(stream);
+
+    log_infof(HASH_PROFILER, STRING_CONST("Exported %zu trace events to %.*s"), event_count, (int)length, path);
+    return true;
+}
+
 void profiler_menu_timer()
 {
     #if BUILD_DEVELOPMENT && BUILD_ENABLE_PROFILE
@@ -322,7 +612,9 @@ void profiler_menu_timer()
 
 FOUNDATION_STATIC void profiler_initialize()
 {
-    if (!environment_argument("profile"))
+    string_const_t session_profile_file_path;
+    const bool profile_log = environment_argument("profile-log", &session_profile_file_path);
+    if (!environment_argument("profile") && !profile_log)
         return;
         
     const size_t profile_buffer_size = 2 * 1024 * 1024;
@@ -331,17 +623,13 @@ FOUNDATION_STATIC void profiler_initialize()
     profile_initialize(STRING_ARGS(app->name), _profile_buffer, profile_buffer_size);
     profile_enable(true);
 
-    string_const_t session_profile_file_path;
-    if (environment_argument("profile-log", &session_profile_file_path))
+    if (profile_log)
     {
+        // Record the whole session and export it as a Chrome trace when the application exits.
         if (string_is_null(session_profile_file_path))
-        {
-            string_const_t timestamp = string_from_uint_static(time_current(), false, 0, 0);
-            session_profile_file_path = session_get_user_file_path(STRING_ARGS(timestamp), 
-                STRING_CONST("profiles"), STRING_CONST("profile"), true);
-        }
-        _profile_stream = fs_open_file(STRING_ARGS(session_profile_file_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY);
-        FOUNDATION_ASSERT(_profile_stream);
+            session_profile_file_path = profiler_trace_default_path();
+        _profiler_trace_log_path = string_clone(STRING_ARGS(session_profile_file_path));
+        profiler_trace_enable(true);
     }
 
     profile_set_output(profiler_tracker);
@@ -355,12 +643,29 @@ FOUNDATION_STATIC void profiler_shutdown()
     if (_profiler_table)
         table_deallocate(_profiler_table);
 
-    if (_profile_stream)
+    if (!string_is_null(_profiler_trace_log_path))
+    {
+        profiler_trace_export(STRING_ARGS(_profiler_trace_log_path));
+        string_deallocate(_profiler_trace_log_path.str);
+    }
+
+    // Threads still running will not record any more scopes, but they might still close 
+    // scopes opened before, so their buffers are retired and released when they exit.
+    profiler_trace_enable(false);
+    if (_profiler_trace_owner.buffer)
+    {
+        atomic_store32(&_profiler_trace_owner.buffer->state, PROFILER_TRACE_BUFFER_FREE, memory_order_release);
+        _profiler_trace_owner.buffer = nullptr;
+    }
+
+    profiler_trace_buffer_t* trace_buffer = (profiler_trace_buffer_t*)atomic_load_ptr(&_profiler_trace_buffers, memory_order_acquire);
+    atomic_store_ptr(&_profiler_trace_buffers, nullptr, memory_order_release);
+    while (trace_buffer)
     {
-        string_const_t profile_log_saved_path = stream_path(_profile_stream);
-        if (!string_is_null(profile_log_saved_path))
-            log_infof(HASH_PROFILER, STRING_CONST("Session profile log saved at %.*s"), STRING_FORMAT(profile_log_saved_path));
-        stream_deallocate(_profile_stream);
+        profiler_trace_buffer_t* next = trace_buffer->next;
+        if (!atomic_cas32(&trace_buffer->state, PROFILER_TRACE_BUFFER_RETIRED, PROFILER_TRACE_BUFFER_OWNED, memory_order_acq_rel, memory_order_acquire))
+            memory_deallocate(trace_buffer);
+        trace_buffer = next;
     }
     
     if (_profiler_initialized)
@@ -370,6 +675,6 @@ FOUNDATION_STATIC void profiler_shutdown()
     array_deallocate(_trackers);
 }
 
-DEFINE_MODULE(PROFILER, profiler_initialize, profiler_shutdown, MODULE_PRIORITY_UI_HEADLESS);
+DEFINE_MODULE(PROFILER, profiler_initialize, profiler_shutdown, MODULE_PRIORITY_UI_HEADLESS, MODULE_MAIN_THREAD);
 
 #endif
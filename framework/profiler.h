@@ -14,12 +14,80 @@
 
 #include <foundation/string.h>
 #include <foundation/profile.h>
+#include <foundation/atomic.h>
+
+extern atomic32_t _profiler_trace_enabled;
+
+/*! Checks if the trace recorder is capturing scopes. 
+ * 
+ *  @return True if tracing is enabled.
+ */
+FOUNDATION_FORCEINLINE bool profiler_trace_enabled()
+{
+    return atomic_load32(&_profiler_trace_enabled, memory_order_relaxed) != 0;
+}
+
+/*! Enable or disable the trace recorder. 
+ * 
+ *  @param enabled True to start recording scopes of all threads.
+ */
+void profiler_trace_enable(bool enabled);
+
+/*! Discard all recorded trace events. */
+void profiler_trace_clear();
+
+/*! Begin a trace scope on the calling thread.
+ * 
+ *  @remark Scopes are recorded in a per thread buffer once they end.
+ * 
+ *  @param name   Name of the scope
+ *  @param length Length of the scope name
+ */
+void profiler_trace_begin(const char* name, size_t length);
+
+/*! End the last trace scope started on the calling thread. */
+void profiler_trace_end();
+
+/*! Record the submission of some asynchronous work that completes elsewhere.
+ * 
+ *  @param name   Name of the submission, i.e. "job"
+ *  @param length Length of the submission name
+ * 
+ *  @return Flow identifier to pass to #profiler_trace_flow_end, or 0 if tracing is disabled.
+ */
+uint64_t profiler_trace_flow_begin(const char* name, size_t length);
+
+/*! Record the completion of asynchronous work linked to its submission.
+ * 
+ *  @remark The flow is bound to the trace scope enclosing the call.
+ * 
+ *  @param flow_id Flow identifier returned by #profiler_trace_flow_begin
+ *  @param name    Name of the flow, same as the submission
+ *  @param length  Length of the flow name
+ */
+void profiler_trace_flow_end(uint64_t flow_id, const char* name, size_t length);
+
+/*! Export recorded trace events to a Chrome Trace Event JSON file.
+ * 
+ *  @remark The file can be opened with chrome://tracing or https://ui.perfetto.dev
+ * 
+ *  @param path   Path of the file to write
+ *  @param length Length of the file path
+ * 
+ *  @return True if the trace file was written.
+ */
+bool profiler_trace_export(const char* path, size_t length);
 
 struct TrackerScope
 {
+    bool traced;
+
     FOUNDATION_FORCEINLINE TrackerScope(const char* name, size_t name_length)
+        : traced(profiler_trace_enabled())
     {
         profile_begin_block(name, name_length);
+        if (traced)
+            profiler_trace_begin(name, name_length);
     }
 
     template <size_t N> FOUNDATION_FORCEINLINE
@@ -29,6 +97,7 @@ struct TrackerScope
     }
 
     FOUNDATION_FORCEINLINE TrackerScope(int counter, const char* fmt, ...)
+        : traced(profiler_trace_enabled())
     {   
         FOUNDATION_UNUSED(counter);
         va_list list;
@@ -37,14 +106,40 @@ struct TrackerScope
         string_t vname = string_vformat(STRING_BUFFER(vname_buffer), fmt, string_length(fmt), list);
         va_end(list);
         profile_begin_block(STRING_ARGS(vname));
+        if (traced)
+            profiler_trace_begin(STRING_ARGS(vname));
     }
 
     FOUNDATION_FORCEINLINE ~TrackerScope()
     {
+        if (traced)
+            profiler_trace_end();
         profile_end_block();
     }
 };
 
+/*! Trace scope of asynchronous work completing a flow started with #profiler_trace_flow_begin. */
+struct TraceFlowScope
+{
+    bool traced;
+
+    FOUNDATION_FORCEINLINE TraceFlowScope(const char* name, size_t name_length, uint64_t flow_id)
+        : traced(flow_id != 0 && profiler_trace_enabled())
+    {
+        if (traced)
+        {
+            profiler_trace_begin(name, name_length);
+            profiler_trace_flow_end(flow_id, name, name_length);
+        }
+    }
+
+    FOUNDATION_FORCEINLINE ~TraceFlowScope()
+    {
+        if (traced)
+            profiler_trace_end();
+    }
+};
+
 #define PERFORMANCE_TRACKER_NAME_COUNTER_EXPAND(NAME, COUNTER) TrackerScope __var_tracker__##COUNTER (NAME)
 #define PERFORMANCE_TRACKER_NAME_COUNTER(NAME, COUNTER) PERFORMANCE_TRACKER_NAME_COUNTER_EXPAND(NAME, COUNTER)
 #define PERFORMANCE_TRACKER(NAME) PERFORMANCE_TRACKER_NAME_COUNTER(NAME, __LINE__)
@@ -62,6 +157,23 @@ void profiler_menu_timer();
 
 FOUNDATION_FORCEINLINE void profiler_menu_timer() {}
 
+FOUNDATION_FORCEINLINE bool profiler_trace_enabled() { return false; }
+FOUNDATION_FORCEINLINE void profiler_trace_enable(bool enabled) { FOUNDATION_UNUSED(enabled); }
+FOUNDATION_FORCEINLINE void profiler_trace_clear() {}
+FOUNDATION_FORCEINLINE void profiler_trace_begin(const char* name, size_t length) { FOUNDATION_UNUSED(name, length); }
+FOUNDATION_FORCEINLINE void profiler_trace_end() {}
+FOUNDATION_FORCEINLINE uint64_t profiler_trace_flow_begin(const char* name, size_t length) { FOUNDATION_UNUSED(name, length); return 0; }
+FOUNDATION_FORCEINLINE void profiler_trace_flow_end(uint64_t flow_id, const char* name, size_t length) { FOUNDATION_UNUSED(flow_id, name, length); }
+FOUNDATION_FORCEINLINE bool profiler_trace_export(const char* path, size_t length) { FOUNDATION_UNUSED(path, length); return false; }
+
+struct TraceFlowScope
+{
+    FOUNDATION_FORCEINLINE TraceFlowScope(const char* name, size_t name_length, uint64_t flow_id) 
+    { 
+        FOUNDATION_UNUSED(name, name_length, flow_id); 
+    }
+};
+
 #endif
 
 #if BUILD_DEBUG && BUILD_ENABLE_PROFILE
@@ -19,6 +19,7 @@
 #include <framework/dispatcher.h>
 #include <framework/string.h>
 #include <framework/system.h>
+#include <framework/epoch.h>
 
 #include <foundation/log.h>
 #include <foundation/hashstrings.h>
@@ -81,6 +82,7 @@ struct json_query_request_t
     query_format_t format{};
     query_callback_t callback{};
     uint64_t invalid_cache_query_after_seconds{ 15ULL * 60ULL };
+    uint64_t trace_flow_id{ 0 };
 
     json_query_request_t()
         : tick(time_current())
@@ -747,6 +749,7 @@ bool query_execute_async_json(const char* query, const config_handle_t& body, co
     }    
 
     request.invalid_cache_query_after_seconds = 0;
+    request.trace_flow_id = profiler_trace_flow_begin(STRING_CONST("query"));
     _fetcher_requests.push(request);
     signal_thread();
 
@@ -767,6 +770,7 @@ bool query_execute_async_json(const char* query, query_format_t format, const qu
     request.format = format;
     request.callback = json_callback;
     request.invalid_cache_query_after_seconds = invalid_cache_query_after_seconds;
+    request.trace_flow_id = profiler_trace_flow_begin(STRING_CONST("query"));
     _fetcher_requests.push(request);
 
     progress_set(min(_fetcher_requests.size(), ARRAY_COUNT(_fetcher_threads)), ARRAY_COUNT(_fetcher_threads));
@@ -813,16 +817,22 @@ FOUNDATION_STATIC void* fetcher_thread_fn(void* arg)
         if (!_fetcher_requests.try_pop(req, 16))
             continue;
 
-        if (req.format == FORMAT_IN_FILE_OUT_JSON)
         {
-            query_execute_send_file(req.query.str, req.format, req.body, req.callback);
-        }
-        else if (!query_execute_json(req.query.str, req.format, req.body, req.callback, req.invalid_cache_query_after_seconds))
-        {
-            if (req.format != FORMAT_JSON_WITH_ERROR)
+            TraceFlowScope trace_scope(STRING_CONST("query"), req.trace_flow_id);
+
+            // Callbacks read shared data released by epochs, i.e. stock histories.
+            EPOCH_SCOPE();
+            if (req.format == FORMAT_IN_FILE_OUT_JSON)
             {
-                log_errorf(HASH_QUERY, ERROR_NETWORK,
-                    STRING_CONST("Failed to execute query %.*s"), STRING_FORMAT(req.query));
+                query_execute_send_file(req.query.str, req.format, req.body, req.callback);
+            }
+            else if (!query_execute_json(req.query.str, req.format, req.body, req.callback, req.invalid_cache_query_after_seconds))
+            {
+                if (req.format != FORMAT_JSON_WITH_ERROR)
+                {
+                    log_errorf(HASH_QUERY, ERROR_NETWORK,
+                        STRING_CONST("Failed to execute query %.*s"), STRING_FORMAT(req.query));
+                }
             }
         }
 
@@ -168,4 +168,7 @@ void query_mock_register_request_response(
 
 bool query_mock_is_enabled(const char* query, bool* mock_success, string_t* result);
 
+/*! Returns the number of queries answered with mocked responses so far. */
+unsigned query_mock_request_count();
+
 #endif
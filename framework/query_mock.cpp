@@ -9,6 +9,7 @@
 #include <framework/common.h>
 
 #include <foundation/path.h>
+#include <foundation/atomic.h>
 
 #if ENABLE_QUERY_MOCKING
 
@@ -25,6 +26,94 @@ static bool _query_mock_enabled = false;
 // We assume mocks are registered at startup and do not change afterward, 
 // therefore we can safely read them in any thread.
 static query_mock_request_response_t* _query_mocks = nullptr;
+static atomic32_t _query_mock_request_count{};
+
+FOUNDATION_STATIC const query_mock_request_response_t* query_mock_find(const char* path, size_t path_length)
+{
+    const hash_t path_hash = string_hash(path, path_length);
+    foreach(e, _query_mocks)
+    {
+        if (path_hash == e->request_hash)
+            return e;
+    }
+
+    return nullptr;
+}
+
+/*! Answer multi-symbol queries (i.e. real-time/A.US?s=B.US,C.US) by joining
+ *  the responses registered for each symbol in an array.
+ */
+FOUNDATION_STATIC bool query_mock_join_symbols(string_const_t uri_path, string_const_t params, string_t* result)
+{
+    size_t pos = string_find_string(STRING_ARGS(params), STRING_CONST("&s="), 0);
+    if (pos == STRING_NPOS)
+        pos = string_find_string(STRING_ARGS(params), STRING_CONST("?s="), 0);
+    if (pos == STRING_NPOS)
+        return false;
+
+    string_const_t symbols = string_substr(STRING_ARGS(params), pos + 3, params.length - pos - 3);
+    pos = string_find(STRING_ARGS(symbols), '&', 0);
+    if (pos != STRING_NPOS)
+        symbols = string_substr(STRING_ARGS(symbols), 0, pos);
+
+    char symbols_buffer[2048];
+    string_t symbols_copy = string_copy(STRING_BUFFER(symbols_buffer), STRING_ARGS(symbols));
+    symbols = url_decode(STRING_ARGS(symbols_copy));
+
+    // Replace the symbol of the path with each symbol of the list
+    const size_t symbol_pos = string_rfind(STRING_ARGS(uri_path), '/', STRING_NPOS);
+    if (symbol_pos == STRING_NPOS)
+        return false;
+    string_const_t endpoint = string_substr(STRING_ARGS(uri_path), 0, symbol_pos + 1);
+
+    const query_mock_request_response_t** responses = nullptr;
+    const query_mock_request_response_t* m = query_mock_find(STRING_ARGS(uri_path));
+    if (m)
+        array_push(responses, m);
+
+    unsigned symbol_count = 0;
+    string_const_t symbol, remaining = symbols;
+    while (remaining.length > 0)
+    {
+        string_split(STRING_ARGS(remaining), STRING_CONST(","), &symbol, &remaining, false);
+
+        char path_buffer[256];
+        string_t path = string_copy(STRING_BUFFER(path_buffer), STRING_ARGS(endpoint));
+        path = string_append(STRING_ARGS(path), sizeof(path_buffer), STRING_ARGS(symbol));
+        if (string_equal(STRING_ARGS(path), STRING_ARGS(uri_path)))
+            continue;
+
+        symbol_count++;
+        m = query_mock_find(STRING_ARGS(path));
+        if (m)
+            array_push(responses, m);
+    }
+
+    // Queries for a single symbol return the registered response as is.
+    if (symbol_count == 0)
+    {
+        array_deallocate(responses);
+        return false;
+    }
+
+    size_t capacity = 3;
+    foreach(r, responses)
+        capacity += (*r)->response.length + 1;
+
+    string_t response = string_allocate(0, capacity);
+    response = string_append(STRING_ARGS(response), capacity, STRING_CONST("["));
+    foreach(e, responses)
+    {
+        if (response.length > 1)
+            response = string_append(STRING_ARGS(response), capacity, STRING_CONST(","));
+        response = string_append(STRING_ARGS(response), capacity, STRING_ARGS((*e)->response));
+    }
+    response = string_append(STRING_ARGS(response), capacity, STRING_CONST("]"));
+    array_deallocate(responses);
+
+    *result = response;
+    return true;
+}
 
 void query_mock_register_request_response(
     const char* query, size_t query_size,
@@ -65,25 +154,45 @@ bool query_mock_is_enabled(const char* query, bool* mock_success, string_t* resu
         return false;
 
     uri_path = string_substr(STRING_ARGS(uri_path), pos + 1, uri_path.length - pos - 1);
+    string_const_t params{};
     pos = string_find(STRING_ARGS(uri_path), '?', 0);
     if (pos != STRING_NPOS)
+    {
+        params = string_substr(STRING_ARGS(uri_path), pos, uri_path.length - pos);
         uri_path = string_substr(STRING_ARGS(uri_path), 0, pos);
+    }
     if (uri_path.length == 0)
         return false;
 
-    const hash_t uri_hash = string_hash(uri_path.str, uri_path.length);
-    foreach(e, _query_mocks)
+    string_t joined_response{};
+    if (query_mock_join_symbols(uri_path, params, &joined_response))
     {
-        if (uri_hash == e->request_hash)
-        {
-            if (result)
-                *result = string_clone(STRING_ARGS(e->response));
-
-            return true;
-        }
+        atomic_incr32(&_query_mock_request_count, memory_order_relaxed);
+        if (mock_success)
+            *mock_success = true;
+        if (result)
+            *result = joined_response;
+        else
+            string_deallocate(joined_response.str);
+        return true;
     }
 
-    return false;
+    const query_mock_request_response_t* e = query_mock_find(STRING_ARGS(uri_path));
+    if (e == nullptr)
+        return false;
+
+    atomic_incr32(&_query_mock_request_count, memory_order_relaxed);
+    if (mock_success)
+        *mock_success = true;
+    if (result)
+        *result = string_clone(STRING_ARGS(e->response));
+
+    return true;
+}
+
+unsigned query_mock_request_count()
+{
+    return (unsigned)atomic_load32(&_query_mock_request_count, memory_order_relaxed);
 }
 
 void query_mock_initialize()
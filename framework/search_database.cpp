@@ -14,11 +14,28 @@
 #include <framework/string.h>
 #include <framework/array.h>
 #include <framework/profiler.h>
+#include <framework/jobs.h>
+#include <framework/system.h>
 
 #include <foundation/stream.h>
+#include <foundation/thread.h>
+#include <foundation/atomic.h>
+#include <foundation/fs.h>
 
  /*! Search database version */
-constexpr uint8_t SEARCH_DATABASE_VERSION = 12;
+constexpr uint8_t SEARCH_DATABASE_VERSION = 13;
+
+/*! Previous search database version, which was deserialized field by field. */
+constexpr uint8_t SEARCH_DATABASE_STREAM_VERSION = 12;
+
+/*! Number of index entries of the mutable segment before it gets sealed in an immutable segment. */
+constexpr unsigned SEARCH_DATABASE_MUTABLE_SEGMENT_CAPACITY = 4096;
+
+/*! Number of segments of the same tier merged together in the background. */
+constexpr unsigned SEARCH_DATABASE_SEGMENT_MERGE_FACTOR = 4;
+
+/*! Cached index count value meaning that it needs to be counted again. */
+constexpr uint32_t SEARCH_DATABASE_INDEX_COUNT_INVALID = UINT32_MAX;
 
 /*! List of common words of three characters or more that we should skip for indexing text or words. */
 constexpr string_const_t COMMON_WORDS[] = {
@@ -58,7 +75,8 @@ typedef enum class SearchIndexType : uint32_t
     Word        = (1 << 0),
     Variation   = (1 << 1),
     Number      = (1 << 2),
-    Property    = (1 << 3)
+    Property    = (1 << 3),
+    Trigram     = (1 << 4)
 } search_index_type_t;
 DEFINE_ENUM_FLAGS(SearchIndexType);
 
@@ -87,7 +105,10 @@ typedef enum class SearchDocumentType : unsigned char
 } search_document_type_t;
 DEFINE_ENUM_FLAGS(SearchDocumentType);
 
-/*! Search database index key entry */
+/*! Search database index key entry
+ * 
+ *  Trigram entries use the trigram code as #crc and the label string symbol as #hash.
+ */
 FOUNDATION_ALIGNED_STRUCT(search_index_key_t, 8)
 {
     /*! Type of the index entry */
@@ -116,6 +137,7 @@ FOUNDATION_ALIGNED_STRUCT(search_index_t, 8)
         search_document_handle_t  doc;
         search_document_handle_t  docs[6]; // Ideally align this padding with 8 bytes
         search_document_handle_t* docs_list{ nullptr };
+        uint64_t                  docs_offset;  // Offset of the documents in the postings of a mapped segment
     };
 };
 
@@ -127,19 +149,56 @@ FOUNDATION_ALIGNED_STRUCT(search_document_t, 8)
     time_t                  timestamp{ 0 };
 };
 
+/*! Immutable run of sorted index entries. */
+FOUNDATION_ALIGNED_STRUCT(search_segment_t, 8)
+{
+    search_index_t*         indexes{ nullptr };
+    uint32_t                level{ 0 };
+    bool                    merging{ false };
+
+    /*! Postings of the entries used in place from a database image, null for allocated entries. */
+    const search_document_handle_t* postings{ nullptr };
+    uint64_t                        posting_count{ 0 };
+};
+
+/*! Read position in a run of sorted index entries. */
+struct search_segment_cursor_t
+{
+    const search_index_t*   indexes{ nullptr };
+    unsigned                count{ 0 };
+    unsigned                at{ 0 };
+    const search_document_handle_t* postings{ nullptr };
+    uint64_t                posting_count{ 0 };
+};
+
 /*! Search database structure
  * 
  * The search database is thread safe and use a shared mutex to allow multiple reads concurrently.
+ * 
+ * New index entries are inserted in a small mutable segment, which gets sealed in an immutable segment 
+ * once full. Segments of the same tier are merged in the background and queries look up all segments.
+ * Removed documents are tombstones until the merges drop their index entries, then their slots get reused.
+ * 
+ * A database image (i.e. a mapped file) is used in place: its indexes are an immutable segment, and
+ * the string table and the document names point in the image until they need to grow or be released.
  */
 FOUNDATION_ALIGNED_STRUCT(search_database_t, 8)
 {
     shared_mutex            mutex;
-    search_index_t*         indexes{ nullptr };
+    search_index_t*         indexes{ nullptr };     // Mutable segment
+    search_segment_t*       segments{ nullptr };    // Immutable segments
+    job_t*                  merge_job{ nullptr };
+    bool                    merging{ false };
     search_document_t*      documents{ nullptr };
     uint32_t                document_count{ 0 };
     string_table_t*         strings{ nullptr };
     search_database_flags_t options{ SearchDatabaseFlags::Default };
     bool                    dirty{ false };
+    atomic32_t              index_count{ (int32_t)SEARCH_DATABASE_INDEX_COUNT_INVALID }; // Distinct keys indexing live documents
+
+    void*                   image{ nullptr };       // Mapped file or loaded buffer used in place
+    size_t                  image_size{ 0 };
+    bool                    image_mapped{ false };
 
     search_query_t**         queries{ nullptr };
 };
@@ -160,29 +219,111 @@ FOUNDATION_ALIGNED_STRUCT(search_database_header_t, 8) {
     sizeof(string_table_t)
 };
 
+/*! Layout of a database image following its header. Offsets are from the beginning of the image 
+ *  and sections are aligned on 8 bytes so that they can be used in place.
+ */
+FOUNDATION_ALIGNED_STRUCT(search_database_layout_t, 8)
+{
+    uint64_t image_size{ 0 };
+
+    uint64_t documents_offset{ 0 };
+    uint32_t document_count{ 0 };
+    uint32_t index_count{ 0 };
+
+    uint64_t names_offset{ 0 };
+    uint64_t names_size{ 0 };
+
+    uint64_t strings_offset{ 0 };
+    uint64_t strings_size{ 0 };
+
+    uint64_t indexes_offset{ 0 };   // Preceded by a foundation array header, so array functions work on the entries
+    uint64_t postings_offset{ 0 };
+    uint64_t posting_count{ 0 };
+};
+
+/*! Document record of a database image, its name is stored in the name pool. */
+FOUNDATION_ALIGNED_STRUCT(search_database_image_document_t, 8)
+{
+    time_t                  timestamp{ 0 };
+    uint32_t                name_offset{ 0 };
+    uint32_t                name_length{ 0 };
+    search_document_type_t  type{ SearchDocumentType::Unused };
+};
+
 //
 // # PRIVATE
 //
 
+FOUNDATION_FORCEINLINE bool search_database_image_contains(const search_database_t* db, const void* ptr)
+{
+    return db->image && ptr >= db->image && ptr < (const uint8_t*)db->image + db->image_size;
+}
+
+FOUNDATION_STATIC void search_database_deallocate_name(search_database_t* db, string_t& name)
+{
+    // Names of documents loaded from an image point in its name pool.
+    if (search_database_image_contains(db, name.str))
+        name = {};
+    else
+        string_deallocate(name);
+}
+
+FOUNDATION_STATIC void search_database_deallocate_strings(search_database_t* db)
+{
+    if (!search_database_image_contains(db, db->strings))
+        string_table_deallocate(db->strings);
+    db->strings = nullptr;
+}
+
+FOUNDATION_STATIC void search_database_release_image(search_database_t* db)
+{
+    if (db->image == nullptr)
+        return;
+
+    if (db->image_mapped)
+        system_unmap_file(db->image, db->image_size);
+    else
+        memory_deallocate(db->image);
+    db->image = nullptr;
+    db->image_size = 0;
+    db->image_mapped = false;
+}
+
 FOUNDATION_STATIC void search_database_deallocate_documents(search_database_t*& db)
 {
     for (unsigned i = 0, end = array_size(db->documents); i < end; ++i)
     {
         search_document_t& doc = db->documents[i];
-        string_deallocate(doc.name);
+        search_database_deallocate_name(db, doc.name);
     }
     array_deallocate(db->documents);
 }
 
-FOUNDATION_STATIC void search_database_deallocate_indexes(search_database_t*& db)
+FOUNDATION_STATIC void search_database_deallocate_index_array(search_index_t*& indexes)
 {
-    for (unsigned i = 0, end = array_size(db->indexes); i < end; ++i)
+    for (unsigned i = 0, end = array_size(indexes); i < end; ++i)
     {
-        search_index_t& index = db->indexes[i];
+        search_index_t& index = indexes[i];
         if (index.document_count > ARRAY_COUNT(index.docs))
             array_deallocate(index.docs_list);
     }
-    array_deallocate(db->indexes);
+    array_deallocate(indexes);
+}
+
+FOUNDATION_STATIC void search_database_deallocate_segment(search_segment_t& segment)
+{
+    // Entries used in place from a database image are released with the image.
+    if (segment.postings == nullptr)
+        search_database_deallocate_index_array(segment.indexes);
+    segment.indexes = nullptr;
+}
+
+FOUNDATION_STATIC void search_database_deallocate_indexes(search_database_t*& db)
+{
+    search_database_deallocate_index_array(db->indexes);
+    foreach(segment, db->segments)
+        search_database_deallocate_segment(*segment);
+    array_deallocate(db->segments);
 }
 
 FOUNDATION_STATIC string_const_t search_database_format_word(const char* word, size_t& word_length, search_indexing_flags_t flags)
@@ -275,255 +416,667 @@ FOUNDATION_FORCEINLINE int search_database_index_compare(const search_index_t& s
     return search_database_index_key_compare(s.key, key);
 }
 
+FOUNDATION_STATIC int search_database_find_run_index(const search_index_t* indexes, const search_index_key_t& key)
+{
+    return array_binary_search_compare(indexes, key, search_database_index_compare);
+}
+
 FOUNDATION_STATIC int search_database_find_index(search_database_t* db, const search_index_key_t& key)
 {
-    return array_binary_search_compare(db->indexes, key, search_database_index_compare);
+    return search_database_find_run_index(db->indexes, key);
 }
 
-FOUNDATION_STATIC int search_database_insert_index(search_database_t* db, search_document_handle_t doc, const search_index_key_t& key)
+/*! Add a document to an index entry.
+ *
+ *  @return True if the document was not already indexed by the entry.
+ */
+FOUNDATION_STATIC bool search_database_index_add_document(search_index_t& index, search_document_handle_t doc)
 {
-    SHARED_WRITE_LOCK(db->mutex);
-    
-    int insert_at = search_database_find_index(db, key);
-    if (insert_at >= 0)
+    if (index.document_count == 0)
     {
-        // Found existing index, add document to list
-        search_index_t& index = db->indexes[insert_at];
-
-        if (index.document_count == 0)
-        {
-            // This can happen if a document gets removed eventually.
-            db->dirty = true;
-            index.doc = doc;
-            index.document_count = 1;
-        }
-        else if (index.document_count < ARRAY_COUNT(index.docs))
-        {
-            // Check if doc already exist
-            for (unsigned i = 0; i < index.document_count; ++i)
-            {
-                if (index.docs[i] == doc)
-                    return insert_at;
-            }
-            db->dirty = true;
-            index.docs[index.document_count++] = doc;
-        }
-        else if (index.document_count == ARRAY_COUNT(index.docs))
+        // This can happen if a document gets removed eventually.
+        index.doc = doc;
+        index.document_count = 1;
+    }
+    else if (index.document_count < ARRAY_COUNT(index.docs))
+    {
+        // Check if doc already exist
+        for (unsigned i = 0; i < index.document_count; ++i)
         {
-            // Check if doc already exist
-            for (unsigned i = 0; i < index.document_count; ++i)
-            {
-                if (index.docs[i] == doc)
-                    return insert_at;
-            }
-            
-            // Create new list and copy existing docs
-            search_document_handle_t* docs = nullptr;
-            for (int i = 0; i < ARRAY_COUNT(index.docs); ++i)
-                array_push(docs, index.docs[i]);
-            db->dirty = true;
-            array_push(docs, doc);
-            index.docs_list = docs;
-            index.document_count = array_size(docs);
-            FOUNDATION_ASSERT(index.document_count > ARRAY_COUNT(index.docs));
+            if (index.docs[i] == doc)
+                return false;
         }
-        else
+        index.docs[index.document_count++] = doc;
+    }
+    else if (index.document_count == ARRAY_COUNT(index.docs))
+    {
+        // Check if doc already exist
+        for (unsigned i = 0; i < index.document_count; ++i)
         {
-            // Check if doc already exist
-            for (unsigned i = 0, end = array_size(index.docs_list); i < end; ++i)
-            {
-                if (index.docs_list[i] == doc)
-                    return insert_at;
-            }
-            
-            // Add to existing list
-            db->dirty = true;
-            array_push(index.docs_list, doc);
-            index.document_count = array_size(index.docs_list);
-            FOUNDATION_ASSERT(index.document_count > ARRAY_COUNT(index.docs));
+            if (index.docs[i] == doc)
+                return false;
         }
+
+        // Create new list and copy existing docs
+        search_document_handle_t* docs = nullptr;
+        for (int i = 0; i < ARRAY_COUNT(index.docs); ++i)
+            array_push(docs, index.docs[i]);
+        array_push(docs, doc);
+        index.docs_list = docs;
+        index.document_count = array_size(docs);
+        FOUNDATION_ASSERT(index.document_count > ARRAY_COUNT(index.docs));
     }
     else
     {
-        // Create new index
-        insert_at = ~insert_at;
-        search_index_t index{ key };
-        index.docs[0] = doc;
-        for (int i = 1; i < ARRAY_COUNT(index.docs); ++i)
-            index.docs[i] = SEARCH_DOCUMENT_INVALID_ID;
-        index.document_count = 1;
-        db->dirty = true;
-        array_insert_memcpy(db->indexes, insert_at, &index);
+        // Check if doc already exist
+        for (unsigned i = 0, end = array_size(index.docs_list); i < end; ++i)
+        {
+            if (index.docs_list[i] == doc)
+                return false;
+        }
+
+        // Add to existing list
+        array_push(index.docs_list, doc);
+        index.document_count = array_size(index.docs_list);
+        FOUNDATION_ASSERT(index.document_count > ARRAY_COUNT(index.docs));
     }
 
-    return insert_at;
+    return true;
 }
 
-FOUNDATION_FORCEINLINE string_const_t search_database_clean_up_text(const char* text, size_t text_length)
+FOUNDATION_FORCEINLINE search_index_t search_database_make_index(const search_index_key_t& key, search_document_handle_t doc)
 {
-    string_const_t clean_text = string_const(text, text_length);
-    clean_text = string_trim(clean_text, '"');
-    clean_text = string_trim(clean_text, '\'');
-    clean_text = string_trim(clean_text, '.');
-    clean_text = string_trim(clean_text, ':');
-    return string_trim(clean_text, ' ');
+    search_index_t index{ key };
+    index.docs[0] = doc;
+    for (int i = 1; i < ARRAY_COUNT(index.docs); ++i)
+        index.docs[i] = SEARCH_DOCUMENT_INVALID_ID;
+    index.document_count = 1;
+    return index;
 }
 
-FOUNDATION_STATIC hash_t search_database_string_to_symbol(search_database_t* db, const char* str, size_t length)
+/*! Returns the number of documents that can be read from an index entry.
+ *
+ *  @remark Postings of a database image are only validated once read, so an entry 
+ *          whose range is out of the postings has no readable document.
+ */
+FOUNDATION_FORCEINLINE uint32_t search_database_get_indexed_document_count(
+    const search_index_t& idx, const search_document_handle_t* postings = nullptr, uint64_t posting_count = 0)
 {
-    string_table_symbol_t symbol = string_table_to_symbol(db->strings, str, length);
-    while (symbol == STRING_TABLE_FULL)
+    if (postings && idx.document_count > ARRAY_COUNT(idx.docs) &&
+        (idx.docs_offset > posting_count || idx.document_count > posting_count - idx.docs_offset))
     {
-        const int grow_size = (int)math_align_up(db->strings->allocated_bytes * 1.5f, 8);
-        log_debugf(0, STRING_CONST("Search database string table full, growing to %d bytes"), grow_size);
-        string_table_grow(&db->strings, grow_size);
-        symbol = string_table_to_symbol(db->strings, str, length);
+        return 0;
     }
 
-    FOUNDATION_ASSERT(symbol > 0);
-    return (hash_t)(symbol);
+    return idx.document_count;
 }
 
-FOUNDATION_STATIC int32_t search_database_string_to_key(search_database_t* db, const char* str, size_t length, search_index_key_t& key)
+FOUNDATION_FORCEINLINE search_document_handle_t search_database_get_indexed_document(
+    const search_index_t& idx, uint32_t element_at, const search_document_handle_t* postings = nullptr)
 {
-    key.hash = string_hash(str, length);
-    key.crc = search_database_string_to_symbol(db, str, length);
-    return -to_int(length);
+    FOUNDATION_ASSERT(idx.document_count > 0 && element_at < idx.document_count);
+        
+    if (idx.document_count <= ARRAY_COUNT(idx.docs))
+        return idx.docs[element_at];
+
+    if (postings)
+        return postings[idx.docs_offset + element_at];
+
+    return idx.docs_list[element_at];
 }
 
-FOUNDATION_STATIC bool search_database_skip_word(const char* _word, size_t _word_length, SearchIndexingFlags flags)
+FOUNDATION_STATIC bool search_database_is_document_live_nolock(search_database_t* db, search_document_handle_t doc)
 {
-    string_const_t word = string_const(_word, _word_length);
-
-    if ((flags & SearchIndexingFlags::TrimWord) == SearchIndexingFlags::TrimWord)
-        word = search_database_clean_up_text(word.str, word.length);
+    // Handles read from a database image are only checked here.
+    return doc != SEARCH_DOCUMENT_INVALID_ID && doc < array_size(db->documents) && db->documents[doc].type == SearchDocumentType::Default;
+}
 
-    if (word.str == nullptr || word.length < 3)
-        return true;
+/*! Invalidate the cached index count once documents get indexed or removed. Must be called with the write lock. */
+FOUNDATION_FORCEINLINE void search_database_invalidate_index_count_nolock(search_database_t* db)
+{
+    atomic_store32(&db->index_count, (int32_t)SEARCH_DATABASE_INDEX_COUNT_INVALID, memory_order_relaxed);
+}
 
-    const bool skip_common_words = (flags & SearchIndexingFlags::SkipCommonWords) != 0;
-    if (skip_common_words)
+/*! Flag the tombstones still indexed by a run of sorted entries. */
+FOUNDATION_STATIC void search_database_mark_referenced_tombstones(
+    const search_index_t* indexes, const search_document_handle_t* postings, uint64_t posting_count,
+    const search_document_handle_t* tombstones, bool* referenced)
+{
+    for (unsigned i = 0, end = array_size(indexes); i < end; ++i)
     {
-        for (const auto& cw : COMMON_WORDS)
+        const search_index_t& index = indexes[i];
+        for (unsigned d = 0, count = search_database_get_indexed_document_count(index, postings, posting_count); d < count; ++d)
         {
-            if (string_equal_nocase(STRING_ARGS(cw), STRING_ARGS(word)))
-                return true;
+            const int at = array_binary_search(tombstones, search_database_get_indexed_document(index, d, postings));
+            if (at >= 0)
+                referenced[at] = true;
         }
     }
-
-    return false;
 }
 
-FOUNDATION_STATIC bool search_database_index_word(
-    search_database_t* db, search_document_handle_t doc, 
-    const char* _word, size_t _word_length, 
-    SearchIndexingFlags flags)
+FOUNDATION_STATIC unsigned search_database_segment_level(unsigned index_count)
 {
-    FOUNDATION_ASSERT(db);
-
-    if (search_database_skip_word(_word, _word_length, flags))
-        return false;
-        
-    if (!search_database_is_document_valid(db, doc))
-        return false;
-
-    string_const_t word = search_database_format_word(_word, _word_length, flags);
-
-    // Insert exact word
-    search_index_key_t key;
-    key.type = SearchIndexType::Word;
-    key.score = search_database_string_to_key(db, STRING_ARGS(word), key);
-    search_database_insert_index(db, doc, key);
-
-    const bool include_variations = (flags & SearchIndexingFlags::Variations) != SearchIndexingFlags::None;
-    if (!include_variations)
-        return true;
+    unsigned level = 0;
+    for (size_t tier_size = SEARCH_DATABASE_MUTABLE_SEGMENT_CAPACITY * SEARCH_DATABASE_SEGMENT_MERGE_FACTOR; 
+        index_count >= tier_size; tier_size *= SEARCH_DATABASE_SEGMENT_MERGE_FACTOR)
+    {
+        ++level;
+    }
+    return level;
+}
 
-    word.length--;
-    if (word.length < 3)
-        return true;
+/*! Append an index entry with a list of sorted unique documents to a run of sorted entries. */
+FOUNDATION_STATIC void search_database_segment_push(search_index_t*& indexes, const search_index_key_t& key, const search_document_handle_t* docs, unsigned doc_count)
+{
+    FOUNDATION_ASSERT(doc_count > 0);
 
-    key.type = SearchIndexType::Variation;
-    for (; word.length > 2; --word.length, ++key.score)
+    search_index_t index{ key };
+    index.document_count = doc_count;
+    if (doc_count <= ARRAY_COUNT(index.docs))
     {
-        // Skip spaces at the end
-        if (word.str[word.length - 1] == ' ')
-            continue;
-            
-        search_database_string_to_key(db, word.str, word.length, key);
-        search_database_insert_index(db, doc, key);
+        for (unsigned i = 0; i < ARRAY_COUNT(index.docs); ++i)
+            index.docs[i] = i < doc_count ? docs[i] : SEARCH_DOCUMENT_INVALID_ID;
+    }
+    else
+    {
+        index.docs_list = nullptr;
+        array_resize(index.docs_list, doc_count);
+        memcpy(index.docs_list, docs, sizeof(search_document_handle_t) * doc_count);
     }
 
-    return true;
+    array_push_memcpy(indexes, &index);
 }
 
-FOUNDATION_FORCEINLINE SearchIndexingFlags search_database_case_indexing_flag(search_database_t* db)
+/*! Sort the documents, remove duplicates and those that are not live anymore.
+ * 
+ *  @return Number of documents kept at the beginning of the array.
+ */
+template<typename IsLive>
+FOUNDATION_STATIC unsigned search_database_unique_live_documents(search_document_handle_t* docs, const IsLive& is_live)
 {
-    SearchIndexingFlags flags = SearchIndexingFlags::None;
-    if ((db->options & SearchDatabaseFlags::CaseSensitive) == 0)
-        flags |= SearchIndexingFlags::Lowercase;
+    const unsigned count = array_size(docs);
+    if (count > 1)
+        array_sort(docs, [](search_document_handle_t a, search_document_handle_t b) { return a < b ? -1 : a > b ? 1 : 0; });
 
-    if ((db->options & SearchDatabaseFlags::SkipCommonWords) != 0)
-        flags |= SearchIndexingFlags::SkipCommonWords;
+    unsigned live_count = 0;
+    search_document_handle_t previous = SEARCH_DOCUMENT_INVALID_ID;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const search_document_handle_t doc = docs[i];
+        if (doc == previous)
+            continue;
+        previous = doc;
+        if (is_live(doc))
+            docs[live_count++] = doc;
+    }
 
-    return flags;
+    return live_count;
 }
 
-//
-// # PUBLIC API
-//
-
-search_database_t* search_database_allocate(search_database_flags_t flags /*= SearchDatabaseFlags::None*/)
+/*! Visit in order the distinct keys of sorted runs with the documents of all the runs indexed by each key. */
+template<typename Handler>
+FOUNDATION_STATIC void search_database_visit_runs(search_segment_cursor_t* cursors, const Handler& handler)
 {
-    FOUNDATION_ASSERT(sizeof(search_index_t) <= 64);
+    const unsigned cursor_count = array_size(cursors);
+    search_document_handle_t* docs = nullptr;
+    for (;;)
+    {
+        const search_index_t* next = nullptr;
+        for (unsigned i = 0; i < cursor_count; ++i)
+        {
+            const search_segment_cursor_t& c = cursors[i];
+            if (c.at < c.count && (next == nullptr || search_database_index_key_compare(c.indexes[c.at].key, next->key) < 0))
+                next = &c.indexes[c.at];
+        }
 
-    search_database_t* db = MEM_NEW(0, search_database_t);
-    if (flags != SearchDatabaseFlags::None)
-        db->options = flags;
+        if (next == nullptr)
+            break;
 
-    db->strings = string_table_allocate(1024, 10);
+        array_clear(docs);
+        for (unsigned i = 0; i < cursor_count; ++i)
+        {
+            search_segment_cursor_t& c = cursors[i];
+            if (c.at >= c.count || search_database_index_key_compare(c.indexes[c.at].key, next->key) != 0)
+                continue;
 
-    // Add a dummy query so the handle indexes start at 1
-    array_push(db->queries, nullptr);
-    
-    // Add first "special" root document
-    search_document_t root{};
-    root.type = SearchDocumentType::Root;
-    root.name = string_clone(STRING_CONST("<root>"));
-    root.timestamp = time_now();
-    array_push_memcpy(db->documents, &root);
-    
-    return db;
+            const search_index_t& index = c.indexes[c.at++];
+            for (unsigned d = 0, count = search_database_get_indexed_document_count(index, c.postings, c.posting_count); d < count; ++d)
+                array_push(docs, search_database_get_indexed_document(index, d, c.postings));
+        }
+
+        handler(next->key, docs);
+    }
+    array_deallocate(docs);
 }
 
-void search_database_deallocate(search_database_t*& db)
+FOUNDATION_STATIC void search_database_push_cursor(search_segment_cursor_t*& cursors, const search_index_t* indexes, const search_document_handle_t* postings = nullptr, uint64_t posting_count = 0)
 {
-    if (db == nullptr)
+    if (array_size(indexes) == 0)
         return;
+    search_segment_cursor_t cursor{ indexes, array_size(indexes), 0, postings, posting_count };
+    array_push_memcpy(cursors, &cursor);
+}
 
-    search_database_deallocate_indexes(db);
-    search_database_deallocate_documents(db);
-    
-    string_table_deallocate(db->strings);
+/*! Returns cursors over all the segments of the database, including the mutable one. */
+FOUNDATION_STATIC search_segment_cursor_t* search_database_cursors_nolock(search_database_t* db)
+{
+    search_segment_cursor_t* cursors = nullptr;
+    foreach(segment, db->segments)
+        search_database_push_cursor(cursors, segment->indexes, segment->postings, segment->posting_count);
+    search_database_push_cursor(cursors, db->indexes);
+    return cursors;
+}
 
-    for (unsigned i = 0, end = array_size(db->queries); i < end; ++i)
-        search_query_deallocate(db->queries[i]);
-    array_deallocate(db->queries);
-    
-    MEM_DELETE(db);
-    db = nullptr;
+/*! Merge sorted runs in a new run, dropping the documents that are not live anymore. */
+template<typename IsLive>
+FOUNDATION_STATIC search_index_t* search_database_merge_runs(search_segment_cursor_t* cursors, const IsLive& is_live)
+{
+    search_index_t* merged = nullptr;
+    search_database_visit_runs(cursors, [&merged, &is_live](const search_index_key_t& key, search_document_handle_t* docs)
+    {
+        const unsigned live_count = search_database_unique_live_documents(docs, is_live);
+        if (live_count > 0)
+            search_database_segment_push(merged, key, docs, live_count);
+    });
+    return merged;
 }
 
-bool search_database_is_dirty(search_database_t* database)
+/*! Merge all the segments of the database in a single run, without its tombstones. */
+FOUNDATION_STATIC search_index_t* search_database_snapshot_indexes_nolock(search_database_t* db)
 {
-    FOUNDATION_ASSERT(database);
-    return database->dirty;
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(db);
+    search_index_t* indexes = search_database_merge_runs(cursors, [db](search_document_handle_t doc)
+    {
+        return search_database_is_document_live_nolock(db, doc);
+    });
+    array_deallocate(cursors);
+    return indexes;
 }
 
-bool search_database_document_update_timestamp(search_database_t* db, search_document_handle_t document, time_t timestamp /*= 0*/)
+/*! Returns the lowest tier having enough segments to be merged, or -1 if none. */
+FOUNDATION_STATIC int search_database_merge_level_nolock(search_database_t* db)
 {
-    if (!search_database_is_document_valid(db, document))
-        return false;
+    unsigned level_counts[32] = { 0 };
+    foreach(segment, db->segments)
+    {
+        if (!segment->merging && segment->level < ARRAY_COUNT(level_counts))
+            level_counts[segment->level]++;
+    }
+
+    for (int level = 0; level < (int)ARRAY_COUNT(level_counts); ++level)
+    {
+        if (level_counts[level] >= SEARCH_DATABASE_SEGMENT_MERGE_FACTOR)
+            return level;
+    }
+
+    return -1;
+}
+
+FOUNDATION_STATIC int search_database_merge_job(payload_t* payload)
+{
+    search_database_t* db = (search_database_t*)payload;
+
+    for (;;)
+    {
+        uint32_t level = 0;
+        unsigned segment_count = 0;
+        unsigned document_count = 0;
+        search_segment_cursor_t* cursors = nullptr;
+        search_segment_cursor_t* others = nullptr;
+        search_document_handle_t* tombstones = nullptr;
+
+        // Pick the segments to merge and the tombstones to resolve
+        {
+            SHARED_WRITE_LOCK(db->mutex);
+            const int merge_level = search_database_merge_level_nolock(db);
+            if (merge_level < 0)
+            {
+                db->merging = false;
+                return 0;
+            }
+
+            level = (uint32_t)merge_level;
+            segment_count = array_size(db->segments);
+            foreach(segment, db->segments)
+            {
+                if (segment->merging || segment->level != level)
+                {
+                    search_database_push_cursor(others, segment->indexes, segment->postings, segment->posting_count);
+                    continue;
+                }
+                segment->merging = true;
+                search_database_push_cursor(cursors, segment->indexes, segment->postings, segment->posting_count);
+            }
+
+            document_count = array_size(db->documents);
+            for (unsigned i = 1; i < document_count; ++i)
+            {
+                if (db->documents[i].type == SearchDocumentType::Removed)
+                    array_push(tombstones, i);
+            }
+        }
+
+        // Segments are immutable, so they get merged without holding the lock.
+        search_index_t* merged = search_database_merge_runs(cursors, [tombstones, document_count](search_document_handle_t doc)
+        {
+            return doc != SEARCH_DOCUMENT_INVALID_ID && doc < document_count && array_binary_search(tombstones, doc) < 0;
+        });
+
+        // Tombstones that the other segments do not refer to can be reused once the merged segments are dropped.
+        // Only this job releases segments, so the other ones are scanned without holding the lock.
+        bool* referenced = nullptr;
+        if (array_size(tombstones) > 0)
+        {
+            array_resize(referenced, array_size(tombstones));
+            memset(referenced, 0, sizeof(bool) * array_size(tombstones));
+            foreach(c, others)
+                search_database_mark_referenced_tombstones(c->indexes, c->postings, c->posting_count, tombstones, referenced);
+        }
+
+        {
+            SHARED_WRITE_LOCK(db->mutex);
+
+            if (referenced)
+            {
+                // Segments sealed meanwhile are appended after the ones that were scanned.
+                for (unsigned i = segment_count, end = array_size(db->segments); i < end; ++i)
+                {
+                    const search_segment_t& segment = db->segments[i];
+                    search_database_mark_referenced_tombstones(segment.indexes, segment.postings, segment.posting_count, tombstones, referenced);
+                }
+                search_database_mark_referenced_tombstones(db->indexes, nullptr, 0, tombstones, referenced);
+
+                for (unsigned i = 0, end = array_size(tombstones); i < end; ++i)
+                {
+                    search_document_t& doc = db->documents[tombstones[i]];
+                    if (!referenced[i] && doc.type == SearchDocumentType::Removed)
+                        doc = search_document_t{};
+                }
+            }
+
+            for (unsigned i = 0; i < array_size(db->segments);)
+            {
+                search_segment_t& segment = db->segments[i];
+                if (segment.merging && segment.level == level)
+                {
+                    search_database_deallocate_segment(segment);
+                    array_erase_ordered_safe(db->segments, i);
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+
+            if (array_size(merged) > 0)
+            {
+                search_segment_t segment{};
+                segment.indexes = merged;
+                segment.level = max(level + 1, search_database_segment_level(array_size(merged)));
+                array_push_memcpy(db->segments, &segment);
+            }
+        }
+
+        array_deallocate(referenced);
+        array_deallocate(tombstones);
+        array_deallocate(others);
+        array_deallocate(cursors);
+    }
+}
+
+FOUNDATION_STATIC void search_database_schedule_merge_nolock(search_database_t* db)
+{
+    if (db->merging || search_database_merge_level_nolock(db) < 0)
+        return;
+
+    // The previous merge job is done merging and is about to complete.
+    if (db->merge_job)
+    {
+        while (!job_completed(db->merge_job))
+            thread_yield();
+        job_deallocate(db->merge_job);
+    }
+
+    db->merging = true;
+    db->merge_job = job_execute(search_database_merge_job, (payload_t*)db);
+}
+
+FOUNDATION_STATIC void search_database_wait_merges(search_database_t* db)
+{
+    if (db->merge_job == nullptr)
+        return;
+
+    while (!job_completed(db->merge_job))
+        thread_sleep(1);
+    job_deallocate(db->merge_job);
+}
+
+FOUNDATION_STATIC void search_database_add_segment_nolock(search_database_t* db, search_index_t* indexes, const search_document_handle_t* postings = nullptr, uint64_t posting_count = 0)
+{
+    if (array_size(indexes) == 0)
+    {
+        if (postings == nullptr)
+            array_deallocate(indexes);
+        return;
+    }
+
+    search_segment_t segment{};
+    segment.indexes = indexes;
+    segment.postings = postings;
+    segment.posting_count = posting_count;
+    segment.level = search_database_segment_level(array_size(indexes));
+    array_push_memcpy(db->segments, &segment);
+    search_database_schedule_merge_nolock(db);
+}
+
+FOUNDATION_STATIC int search_database_insert_index(search_database_t* db, search_document_handle_t doc, const search_index_key_t& key)
+{
+    SHARED_WRITE_LOCK(db->mutex);
+    
+    int insert_at = search_database_find_index(db, key);
+    if (insert_at >= 0)
+    {
+        // Found existing index, add document to list
+        if (search_database_index_add_document(db->indexes[insert_at], doc))
+        {
+            db->dirty = true;
+            search_database_invalidate_index_count_nolock(db);
+        }
+    }
+    else
+    {
+        // Create new index
+        insert_at = ~insert_at;
+        search_index_t index = search_database_make_index(key, doc);
+        db->dirty = true;
+        search_database_invalidate_index_count_nolock(db);
+        array_insert_memcpy(db->indexes, insert_at, &index);
+
+        // Seal the mutable segment so that inserting keeps moving a bounded number of entries.
+        if (array_size(db->indexes) >= SEARCH_DATABASE_MUTABLE_SEGMENT_CAPACITY)
+        {
+            search_database_add_segment_nolock(db, db->indexes);
+            db->indexes = nullptr;
+        }
+    }
+
+    return insert_at;
+}
+
+FOUNDATION_FORCEINLINE string_const_t search_database_clean_up_text(const char* text, size_t text_length)
+{
+    string_const_t clean_text = string_const(text, text_length);
+    clean_text = string_trim(clean_text, '"');
+    clean_text = string_trim(clean_text, '\'');
+    clean_text = string_trim(clean_text, '.');
+    clean_text = string_trim(clean_text, ':');
+    return string_trim(clean_text, ' ');
+}
+
+FOUNDATION_STATIC hash_t search_database_string_to_symbol(search_database_t* db, const char* str, size_t length)
+{
+    string_table_symbol_t symbol = string_table_to_symbol(db->strings, str, length);
+    while (symbol == STRING_TABLE_FULL)
+    {
+        const int grow_size = (int)math_align_up(db->strings->allocated_bytes * 1.5f, 8);
+        log_debugf(0, STRING_CONST("Search database string table full, growing to %d bytes"), grow_size);
+
+        // The string table of a database image gets copied before growing.
+        if (search_database_image_contains(db, db->strings))
+        {
+            string_table_t* strings = (string_table_t*)memory_allocate(0, db->strings->allocated_bytes, 4, MEMORY_PERSISTENT);
+            memcpy(strings, db->strings, db->strings->allocated_bytes);
+            db->strings = strings;
+        }
+        string_table_grow(&db->strings, grow_size);
+        symbol = string_table_to_symbol(db->strings, str, length);
+    }
+
+    FOUNDATION_ASSERT(symbol > 0);
+    return (hash_t)(symbol);
+}
+
+FOUNDATION_STATIC int32_t search_database_string_to_key(search_database_t* db, const char* str, size_t length, search_index_key_t& key)
+{
+    key.hash = string_hash(str, length);
+    key.crc = search_database_string_to_symbol(db, str, length);
+    return -to_int(length);
+}
+
+FOUNDATION_STATIC bool search_database_skip_word(const char* _word, size_t _word_length, SearchIndexingFlags flags)
+{
+    string_const_t word = string_const(_word, _word_length);
+
+    if ((flags & SearchIndexingFlags::TrimWord) == SearchIndexingFlags::TrimWord)
+        word = search_database_clean_up_text(word.str, word.length);
+
+    if (word.str == nullptr || word.length < 3)
+        return true;
+
+    const bool skip_common_words = (flags & SearchIndexingFlags::SkipCommonWords) != 0;
+    if (skip_common_words)
+    {
+        for (const auto& cw : COMMON_WORDS)
+        {
+            if (string_equal_nocase(STRING_ARGS(cw), STRING_ARGS(word)))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+FOUNDATION_STATIC bool search_database_index_word(
+    search_database_t* db, search_document_handle_t doc, 
+    const char* _word, size_t _word_length, 
+    SearchIndexingFlags flags)
+{
+    FOUNDATION_ASSERT(db);
+
+    if (search_database_skip_word(_word, _word_length, flags))
+        return false;
+        
+    if (!search_database_is_document_valid(db, doc))
+        return false;
+
+    string_const_t word = search_database_format_word(_word, _word_length, flags);
+
+    // Insert exact word
+    search_index_key_t key;
+    key.type = SearchIndexType::Word;
+    key.score = search_database_string_to_key(db, STRING_ARGS(word), key);
+    search_database_insert_index(db, doc, key);
+
+    const bool include_variations = (flags & SearchIndexingFlags::Variations) != SearchIndexingFlags::None;
+    if (!include_variations)
+        return true;
+
+    word.length--;
+    if (word.length < 3)
+        return true;
+
+    key.type = SearchIndexType::Variation;
+    for (; word.length > 2; --word.length, ++key.score)
+    {
+        // Skip spaces at the end
+        if (word.str[word.length - 1] == ' ')
+            continue;
+            
+        search_database_string_to_key(db, word.str, word.length, key);
+        search_database_insert_index(db, doc, key);
+    }
+
+    return true;
+}
+
+FOUNDATION_FORCEINLINE SearchIndexingFlags search_database_case_indexing_flag(search_database_t* db)
+{
+    SearchIndexingFlags flags = SearchIndexingFlags::None;
+    if ((db->options & SearchDatabaseFlags::CaseSensitive) == 0)
+        flags |= SearchIndexingFlags::Lowercase;
+
+    if ((db->options & SearchDatabaseFlags::SkipCommonWords) != 0)
+        flags |= SearchIndexingFlags::SkipCommonWords;
+
+    return flags;
+}
+
+//
+// # PUBLIC API
+//
+
+search_database_t* search_database_allocate(search_database_flags_t flags /*= SearchDatabaseFlags::None*/)
+{
+    FOUNDATION_ASSERT(sizeof(search_index_t) <= 64);
+
+    search_database_t* db = MEM_NEW(0, search_database_t);
+    if (flags != SearchDatabaseFlags::None)
+        db->options = flags;
+
+    db->strings = string_table_allocate(1024, 10);
+
+    // Add a dummy query so the handle indexes start at 1
+    array_push(db->queries, nullptr);
+    
+    // Add first "special" root document
+    search_document_t root{};
+    root.type = SearchDocumentType::Root;
+    root.name = string_clone(STRING_CONST("<root>"));
+    root.timestamp = time_now();
+    array_push_memcpy(db->documents, &root);
+    
+    return db;
+}
+
+void search_database_deallocate(search_database_t*& db)
+{
+    if (db == nullptr)
+        return;
+
+    search_database_wait_merges(db);
+    search_database_deallocate_indexes(db);
+    search_database_deallocate_documents(db);
+    search_database_deallocate_strings(db);
+    search_database_release_image(db);
+
+    for (unsigned i = 0, end = array_size(db->queries); i < end; ++i)
+        search_query_deallocate(db->queries[i]);
+    array_deallocate(db->queries);
+    
+    MEM_DELETE(db);
+    db = nullptr;
+}
+
+bool search_database_is_dirty(search_database_t* database)
+{
+    FOUNDATION_ASSERT(database);
+    return database->dirty;
+}
+
+bool search_database_document_update_timestamp(search_database_t* db, search_document_handle_t document, time_t timestamp /*= 0*/)
+{
+    if (!search_database_is_document_valid(db, document))
+        return false;
 
     if (timestamp == 0)
         timestamp = time_now();
@@ -562,23 +1115,13 @@ search_document_handle_t search_database_find_document(search_database_t* db, co
     return SEARCH_DOCUMENT_INVALID_ID;
 }
 
-search_document_handle_t search_database_add_document(search_database_t* db, const char* name, size_t name_length)
+FOUNDATION_STATIC search_document_handle_t search_database_add_document_nolock(search_database_t* db, const search_document_t& document)
 {
-    FOUNDATION_ASSERT(db);
-    FOUNDATION_ASSERT(name && name_length > 0);
-    
-    search_document_t document{};
-    document.type = SearchDocumentType::Default;
-    document.name = string_clone(name, name_length);
-    document.timestamp = time_now();
-
-    SHARED_WRITE_LOCK(db->mutex);
-
-    // Find removed slot if any
+    // Find unused slot if any, removed documents are tombstones that segments can still refer to.
     for (unsigned doc_index = 1, end = array_size(db->documents); doc_index < end; ++doc_index)
     {
         search_document_t& doc = db->documents[doc_index];
-        if (doc.type == SearchDocumentType::Removed)
+        if (doc.type == SearchDocumentType::Unused)
         {
             doc = document;
             db->dirty = true;
@@ -593,6 +1136,20 @@ search_document_handle_t search_database_add_document(search_database_t* db, con
     return array_size(db->documents) - 1;
 }
 
+search_document_handle_t search_database_add_document(search_database_t* db, const char* name, size_t name_length)
+{
+    FOUNDATION_ASSERT(db);
+    FOUNDATION_ASSERT(name && name_length > 0);
+    
+    search_document_t document{};
+    document.type = SearchDocumentType::Default;
+    document.name = string_clone(name, name_length);
+    document.timestamp = time_now();
+
+    SHARED_WRITE_LOCK(db->mutex);
+    return search_database_add_document_nolock(db, document);
+}
+
 search_document_handle_t search_database_get_or_add_document(search_database_t* db, const char* name, size_t name_length)
 {
     FOUNDATION_ASSERT(db);
@@ -668,6 +1225,67 @@ bool search_database_index_exact_match(search_database_t* db, search_document_ha
     return search_database_insert_index(db, document, key) >= 0;
 }
 
+/*! Extract the distinct trigrams of a formatted label. Trigrams are padded at the beginning so that
+ *  the first trigrams of a label are also the ones of its prefixes.
+ *
+ *  @return Number of trigrams written, at most the label length.
+ */
+FOUNDATION_STATIC unsigned search_database_label_trigrams(string_const_t label, uint64_t* trigrams)
+{
+    unsigned count = 0;
+    for (size_t i = 0; i < label.length; ++i)
+    {
+        const uint8_t c0 = i >= 2 ? (uint8_t)label.str[i - 2] : 0;
+        const uint8_t c1 = i >= 1 ? (uint8_t)label.str[i - 1] : 0;
+        const uint8_t c2 = (uint8_t)label.str[i];
+        const uint64_t trigram = ((uint64_t)c0 << 16) | ((uint64_t)c1 << 8) | (uint64_t)c2;
+
+        bool exists = false;
+        for (unsigned t = 0; t < count && !exists; ++t)
+            exists = trigrams[t] == trigram;
+        if (!exists)
+            trigrams[count++] = trigram;
+    }
+    return count;
+}
+
+FOUNDATION_STATIC string_const_t search_database_format_label(const char* label, size_t label_length)
+{
+    size_t length = min(label_length, (size_t)SEARCH_INDEX_WORD_MAX_LENGTH - 1);
+    return search_database_format_word(label, length, SearchIndexingFlags::Lowercase);
+}
+
+bool search_database_index_label(search_database_t* db, search_document_handle_t document, const char* label, size_t label_length)
+{
+    FOUNDATION_ASSERT(db);
+
+    if (!label || label_length == 0)
+        return false;
+
+    if (!search_database_is_document_valid(db, document))
+        return false;
+
+    string_const_t formatted_label = search_database_format_label(label, label_length);
+    if (formatted_label.length == 0)
+        return false;
+
+    uint64_t trigrams[SEARCH_INDEX_WORD_MAX_LENGTH];
+    const unsigned trigram_count = search_database_label_trigrams(formatted_label, trigrams);
+
+    // Trigram entries refer to the label so that candidates can be ranked by edit distance.
+    search_index_key_t key{ SearchIndexType::Trigram };
+    key.hash = search_database_string_to_symbol(db, STRING_ARGS(formatted_label));
+
+    bool indexed = false;
+    for (unsigned i = 0; i < trigram_count; ++i)
+    {
+        key.crc = trigrams[i];
+        indexed |= search_database_insert_index(db, document, key) >= 0;
+    }
+
+    return indexed;
+}
+
 bool search_database_index_word(search_database_t* db, search_document_handle_t doc, const char* word, size_t word_length, bool include_variations /*= true*/)
 {
     search_indexing_flags_t flags = search_database_case_indexing_flag(db) | SearchIndexingFlags::TrimWord;
@@ -678,7 +1296,30 @@ bool search_database_index_word(search_database_t* db, search_document_handle_t
 
 uint32_t search_database_index_count(search_database_t* database)
 {
-    return array_size(database->indexes);
+    SHARED_READ_LOCK(database->mutex);
+
+    // Counting merges all the segments, so the count is cached until documents get indexed or removed.
+    const uint32_t cached_count = (uint32_t)atomic_load32(&database->index_count, memory_order_relaxed);
+    if (cached_count != SEARCH_DATABASE_INDEX_COUNT_INVALID)
+        return cached_count;
+
+    // Count the distinct keys that still index live documents
+    uint32_t count = 0;
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(database);
+    search_database_visit_runs(cursors, [database, &count](const search_index_key_t& key, const search_document_handle_t* docs)
+    {
+        foreach(doc, docs)
+        {
+            if (search_database_is_document_live_nolock(database, *doc))
+            {
+                count++;
+                break;
+            }
+        }
+    });
+    array_deallocate(cursors);
+    atomic_store32(&database->index_count, (int32_t)count, memory_order_relaxed);
+    return count;
 }
 
 uint32_t search_database_document_count(search_database_t* database)
@@ -695,24 +1336,44 @@ string_const_t search_database_document_name(search_database_t* database, search
     return string_to_const(database->documents[document].name);
 }
 
+/*! Returns the number of live documents indexed by a key in all segments. */
+FOUNDATION_STATIC uint32_t search_database_key_document_count_nolock(search_database_t* db, const search_index_key_t& key)
+{
+    search_document_handle_t* docs = nullptr;
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(db);
+    foreach(c, cursors)
+    {
+        const int index = search_database_find_run_index(c->indexes, key);
+        if (index < 0)
+            continue;
+
+        const search_index_t& idx = c->indexes[index];
+        for (unsigned d = 0, count = search_database_get_indexed_document_count(idx, c->postings, c->posting_count); d < count; ++d)
+            array_push(docs, search_database_get_indexed_document(idx, d, c->postings));
+    }
+    array_deallocate(cursors);
+
+    const uint32_t count = search_database_unique_live_documents(docs, [db](search_document_handle_t doc)
+    {
+        return search_database_is_document_live_nolock(db, doc);
+    });
+    array_deallocate(docs);
+    return count;
+}
+
 uint32_t search_database_word_document_count(search_database_t* db, const char* _word, size_t _word_length, bool include_variations /*= false*/)
 {    
     string_const_t word = search_database_format_word(_word, _word_length, search_database_case_indexing_flag(db) | SearchIndexingFlags::TrimWord);
     search_index_key_t key{ SearchIndexType::Word };
     search_database_string_to_key(db, STRING_ARGS(word), key);
 
-    int count = 0;
     SHARED_READ_LOCK(db->mutex);
-    int index = search_database_find_index(db, key);
-    if (index >= 0)
-        count = db->indexes[index].document_count;
+    uint32_t count = search_database_key_document_count_nolock(db, key);
 
     if (include_variations)
     {
         key.type = SearchIndexType::Variation;
-        index = search_database_find_index(db, key);
-        if (index >= 0)
-            count += db->indexes[index].document_count;
+        count += search_database_key_document_count_nolock(db, key);
     }
 
     return count;
@@ -810,14 +1471,260 @@ bool search_database_is_document_valid(search_database_t* database, search_docum
     return (database->documents[document].type == SearchDocumentType::Default);
 }
 
-FOUNDATION_FORCEINLINE search_document_handle_t search_database_get_indexed_document(const search_index_t& idx, uint32_t element_at)
+/*! Trigram of a label shared with a completed text. */
+struct search_database_label_hit_t
 {
-    FOUNDATION_ASSERT(idx.document_count > 0 && element_at < idx.document_count);
-        
-    if (idx.document_count <= ARRAY_COUNT(idx.docs))
-        return idx.docs[element_at];
+    uint64_t                        label;
+    unsigned                        trigram;    // Index of the trigram in the completed text
+    const search_index_t*           index;
+    const search_document_handle_t* postings;
+    uint64_t                        posting_count;
+};
 
-    return idx.docs_list[element_at];
+/*! Range of the entries of a trigram in a segment. The count of the first segment is the total of all segments. */
+struct search_database_trigram_range_t
+{
+    unsigned                        start;
+    unsigned                        end;
+    unsigned                        count;
+};
+
+/*! Label completing a text, with the range of its hits. */
+struct search_database_label_match_t
+{
+    int32_t                         score;
+    unsigned                        hit_start;
+    unsigned                        hit_count;
+};
+
+/*! Returns the edit distance between a text and the closest prefix of a label, 
+ *  or UINT_MAX if it is over the maximum distance. Swapping two adjacent letters counts as a single edit.
+ */
+FOUNDATION_STATIC unsigned search_database_prefix_distance(string_const_t text, string_const_t label, unsigned max_distance)
+{
+    FOUNDATION_ASSERT(text.length < SEARCH_INDEX_WORD_MAX_LENGTH && label.length < SEARCH_INDEX_WORD_MAX_LENGTH);
+
+    unsigned rows[3][SEARCH_INDEX_WORD_MAX_LENGTH + 1];
+    unsigned* before = rows[0];
+    unsigned* previous = rows[1];
+    unsigned* current = rows[2];
+    for (size_t j = 0; j <= label.length; ++j)
+        previous[j] = (unsigned)j;
+
+    for (size_t i = 1; i <= text.length; ++i)
+    {
+        current[0] = (unsigned)i;
+        unsigned row_min = current[0];
+        for (size_t j = 1; j <= label.length; ++j)
+        {
+            const unsigned cost = text.str[i - 1] == label.str[j - 1] ? 0 : 1;
+            current[j] = min(min(previous[j] + 1, current[j - 1] + 1), previous[j - 1] + cost);
+            if (i > 1 && j > 1 && text.str[i - 1] == label.str[j - 2] && text.str[i - 2] == label.str[j - 1])
+                current[j] = min(current[j], before[j - 2] + 1);
+            row_min = min(row_min, current[j]);
+        }
+
+        // Distances never decrease from one row to the next
+        if (row_min > max_distance)
+            return UINT_MAX;
+
+        unsigned* recycled = before;
+        before = previous;
+        previous = current;
+        current = recycled;
+    }
+
+    unsigned distance = UINT_MAX;
+    for (size_t j = 0; j <= label.length; ++j)
+        distance = min(distance, previous[j]);
+    return distance <= max_distance ? distance : UINT_MAX;
+}
+
+/*! Returns the rank of a label completing a text, lower is better, or -1 if the label is too far from the text.
+ * 
+ *  Exact matches come first, then labels starting with the text and then labels with a prefix close to the text.
+ *  Ties are ranked by edit distance and then by label length.
+ */
+FOUNDATION_STATIC int32_t search_database_label_score(string_const_t text, string_const_t label, unsigned max_distance)
+{
+    unsigned kind = 2, distance = 0;
+    if (string_equal(STRING_ARGS(text), STRING_ARGS(label)))
+        kind = 0;
+    else if (label.length > text.length && string_equal(label.str, text.length, STRING_ARGS(text)))
+        kind = 1;
+    else if ((distance = search_database_prefix_distance(text, label, max_distance)) == UINT_MAX)
+        return -1;
+
+    return (int32_t)((kind << 16) | (distance << 8) | min(label.length, (size_t)255));
+}
+
+/*! Insert a match in a sorted list holding only the best matches. */
+FOUNDATION_STATIC void search_database_keep_best_match(search_database_label_match_t*& matches, const search_database_label_match_t& match, unsigned capacity)
+{
+    unsigned at = array_size(matches);
+    if (at == capacity && matches[at - 1].score <= match.score)
+        return;
+
+    while (at > 0 && matches[at - 1].score > match.score)
+        --at;
+    array_insert_memcpy(matches, at, &match);
+    if (array_size(matches) > capacity)
+        array_pop(matches);
+}
+
+search_result_t* search_database_complete(search_database_t* db, const char* text, size_t text_length, unsigned max_results /*= 10*/)
+{
+    FOUNDATION_ASSERT(db);
+
+    if (!text || text_length == 0 || max_results == 0)
+        return nullptr;
+
+    char text_buffer[SEARCH_INDEX_WORD_MAX_LENGTH];
+    string_const_t formatted_text = search_database_format_label(text, text_length);
+    string_const_t query = string_to_const(string_copy(STRING_BUFFER(text_buffer), STRING_ARGS(formatted_text)));
+    if (query.length == 0)
+        return nullptr;
+
+    uint64_t trigrams[SEARCH_INDEX_WORD_MAX_LENGTH];
+    const unsigned trigram_count = search_database_label_trigrams(query, trigrams);
+
+    // Short texts only complete prefixes, longer ones tolerate typos and each edit changes at most four trigrams.
+    const unsigned max_distance = query.length <= 3 ? 0 : (query.length <= 6 ? 1 : 2);
+    const unsigned min_hits = trigram_count > max_distance * 4 ? trigram_count - max_distance * 4 : 1;
+
+    SHARED_READ_LOCK(db->mutex);
+
+    // Find the range of entries of each trigram in all segments
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(db);
+    const unsigned cursor_count = array_size(cursors);
+    if (cursor_count == 0)
+    {
+        array_deallocate(cursors);
+        return nullptr;
+    }
+
+    search_database_trigram_range_t* ranges = nullptr;
+    array_resize(ranges, trigram_count * cursor_count);
+    for (unsigned t = 0; t < trigram_count; ++t)
+    {
+        search_index_key_t key{ SearchIndexType::Trigram };
+        key.crc = trigrams[t];
+        ranges[t * cursor_count].count = 0;
+        for (unsigned c = 0; c < cursor_count; ++c)
+        {
+            search_database_trigram_range_t& range = ranges[t * cursor_count + c];
+            int at = search_database_find_run_index(cursors[c].indexes, key);
+            range.start = at < 0 ? ~at : at;
+
+            key.crc = trigrams[t] + 1;
+            at = search_database_find_run_index(cursors[c].indexes, key);
+            range.end = at < 0 ? ~at : at;
+            key.crc = trigrams[t];
+
+            ranges[t * cursor_count].count += range.end - range.start;
+        }
+    }
+
+    // Candidates share at least the minimum number of trigrams with the text, so the most common trigrams
+    // (i.e. the first letters of ISINs) can be skipped as long as the others are enough to find them.
+    bool skipped[SEARCH_INDEX_WORD_MAX_LENGTH] = { false };
+    unsigned required_hits = min_hits;
+    for (; required_hits > 1; --required_hits)
+    {
+        unsigned most_common = UINT_MAX;
+        for (unsigned t = 0; t < trigram_count; ++t)
+        {
+            if (!skipped[t] && (most_common == UINT_MAX || ranges[t * cursor_count].count > ranges[most_common * cursor_count].count))
+                most_common = t;
+        }
+        skipped[most_common] = true;
+    }
+
+    // Gather the labels sharing the remaining trigrams with the text
+    search_database_label_hit_t* hits = nullptr;
+    for (unsigned t = 0; t < trigram_count; ++t)
+    {
+        if (skipped[t])
+            continue;
+
+        for (unsigned c = 0; c < cursor_count; ++c)
+        {
+            const search_database_trigram_range_t& range = ranges[t * cursor_count + c];
+            for (unsigned at = range.start; at < range.end; ++at)
+            {
+                const search_index_t& index = cursors[c].indexes[at];
+                search_database_label_hit_t hit{ index.key.hash, t, &index, cursors[c].postings, cursors[c].posting_count };
+                array_push_memcpy(hits, &hit);
+            }
+        }
+    }
+    array_deallocate(ranges);
+    array_deallocate(cursors);
+
+    array_sort(hits, [](const search_database_label_hit_t& a, const search_database_label_hit_t& b)
+    {
+        if (a.label != b.label)
+            return a.label < b.label ? -1 : 1;
+        return a.trigram < b.trigram ? -1 : a.trigram > b.trigram ? 1 : 0;
+    });
+
+    // Rank the labels sharing enough trigrams with the text, only the distance of these candidates is computed.
+    search_database_label_match_t* matches = nullptr;
+    const unsigned match_capacity = max_results * 4;
+    for (unsigned i = 0, end = array_size(hits); i < end;)
+    {
+        unsigned j = i + 1, shared_count = 1;
+        for (; j < end && hits[j].label == hits[i].label; ++j)
+        {
+            if (hits[j].trigram != hits[j - 1].trigram)
+                shared_count++;
+        }
+
+        if (shared_count >= required_hits)
+        {
+            string_const_t label = string_table_to_string_const(db->strings, (string_table_symbol_t)hits[i].label);
+            search_database_label_match_t match{ search_database_label_score(query, label, max_distance), i, j - i };
+            if (match.score >= 0)
+                search_database_keep_best_match(matches, match, match_capacity);
+        }
+
+        i = j;
+    }
+
+    // Collect the live documents of the best labels
+    search_result_t* results = nullptr;
+    search_document_handle_t* docs = nullptr;
+    foreach(m, matches)
+    {
+        array_clear(docs);
+        for (unsigned h = m->hit_start, end = m->hit_start + m->hit_count; h < end; ++h)
+        {
+            const search_database_label_hit_t& hit = hits[h];
+            for (unsigned d = 0, count = search_database_get_indexed_document_count(*hit.index, hit.postings, hit.posting_count); d < count; ++d)
+                array_push(docs, search_database_get_indexed_document(*hit.index, d, hit.postings));
+        }
+
+        const unsigned live_count = search_database_unique_live_documents(docs, [db](search_document_handle_t doc)
+        {
+            return search_database_is_document_live_nolock(db, doc);
+        });
+
+        for (unsigned d = 0; d < live_count && array_size(results) < max_results; ++d)
+        {
+            if (array_contains(results, docs[d]))
+                continue;
+            search_result_t result{ docs[d], m->score };
+            array_push_memcpy(results, &result);
+        }
+
+        if (array_size(results) >= max_results)
+            break;
+    }
+
+    array_deallocate(docs);
+    array_deallocate(matches);
+    array_deallocate(hits);
+    return results;
 }
 
 FOUNDATION_STATIC bool search_database_insert_result(search_result_t*& results, const search_result_t& new_entry)
@@ -845,13 +1752,19 @@ FOUNDATION_STATIC bool search_database_insert_result(search_result_t*& results,
     return false;
 }
 
-FOUNDATION_STATIC search_result_t* search_database_get_index_document_results(search_database_t* db, const search_index_t& idx, const search_result_t* and_set, search_result_t*& results)
+FOUNDATION_STATIC search_result_t* search_database_get_index_document_results(
+    search_database_t* db, const search_index_t& idx, const search_document_handle_t* postings, uint64_t posting_count,
+    const search_result_t* and_set, search_result_t*& results)
 {
     search_result_t entry;
     search_result_t* matches = nullptr;
-    for (uint32_t i = 0; i < idx.document_count; ++i)
+    for (uint32_t i = 0, count = search_database_get_indexed_document_count(idx, postings, posting_count); i < count; ++i)
     {
-        entry.id = search_database_get_indexed_document(idx, i);
+        entry.id = search_database_get_indexed_document(idx, i, postings);
+
+        // Skip tombstones that are not merged away yet
+        if (!search_database_is_document_live_nolock(db, (search_document_handle_t)entry.id))
+            continue;
 
         if (and_set == nullptr || array_contains(and_set, entry.id))
         {
@@ -866,12 +1779,20 @@ FOUNDATION_STATIC search_result_t* search_database_get_index_document_results(se
 
 FOUNDATION_STATIC search_result_t* search_database_get_key_document_results(search_database_t* db, const search_index_key_t& key, const search_result_t* and_set, search_result_t*& results)
 {
-    int index = search_database_find_index(db, key);
-    if (index < 0)
-        return nullptr;
-     
-    const search_index_t& idx = db->indexes[index];
-    return search_database_get_index_document_results(db, idx, and_set, results);
+    // Look up the key in every segment, the same document can be indexed by more than one segment.
+    search_result_t* matches = nullptr;
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(db);
+    foreach(c, cursors)
+    {
+        const int index = search_database_find_run_index(c->indexes, key);
+        if (index < 0)
+            continue;
+
+        if (search_database_get_index_document_results(db, c->indexes[index], c->postings, c->posting_count, and_set, results))
+            matches = results;
+    }
+    array_deallocate(cursors);
+    return matches;
 }
 
 FOUNDATION_STATIC search_result_t* search_database_exclude_documents(search_database_t* db, search_result_t*& results)
@@ -900,60 +1821,54 @@ FOUNDATION_STATIC search_result_t* search_database_exclude_documents(search_data
     return included_set;
 }
 
-FOUNDATION_STATIC search_result_t* search_database_query_property_number(
-    search_database_t* db, 
+FOUNDATION_STATIC void search_database_query_run_number(
+    search_database_t* db, const search_segment_cursor_t& run,
     search_query_eval_flags_t eval_flags, const search_index_key_t& key, 
     search_result_t* and_set, search_result_t*& results)
 {
-    // We expect the db to already be locked
-    FOUNDATION_ASSERT(db->mutex.locked());
-    
-    // Find the range of numbers to match
-    int start = search_database_find_index(db, key);
-    if (start < 0)
-        start = ~start;
-
-    int end = start;
-
-    // Try to fix the insertion point by one index
-    if (db->indexes[start].key.type == key.type && db->indexes[start].key.crc != key.crc)
-        start++;
+    const search_index_t* indexes = run.indexes;
+    const int index_count = (int)run.count;
+    if (index_count == 0)
+        return;
 
-    if (db->indexes[end].key.type == key.type && db->indexes[end].key.crc != key.crc)
-        end--;
+    // Find the range of numbers to match
+    int insert_at = search_database_find_run_index(indexes, key);
+    if (insert_at < 0)
+        insert_at = ~insert_at;
 
-    if (db->indexes[start].key.crc != key.crc || db->indexes[end].key.crc != key.crc)
-        return results; // Nothing to be found
-    
-    // Rewind to first index with same crc
-    while (start > 0 && db->indexes[start - 1].key.crc == key.crc)
+    // Expand the range to all the entries of the same property
+    const auto same_property = [&key](const search_index_t& idx) { return idx.key.type == key.type && idx.key.crc == key.crc; };
+    int start = insert_at;
+    while (start > 0 && same_property(indexes[start - 1]))
         --start;
-    FOUNDATION_ASSERT(db->indexes[start].key.type == key.type && db->indexes[start].key.crc == key.crc);
 
-    // Forward to the last index with same crc
-    const int index_count = array_size(db->indexes);
-    while (end < index_count - 1 && db->indexes[end + 1].key.crc == key.crc)
+    int end = insert_at - 1;
+    while (end < index_count - 1 && same_property(indexes[end + 1]))
         ++end;
-    FOUNDATION_ASSERT(db->indexes[end].key.type == key.type && db->indexes[end].key.crc == key.crc);
+
+    if (start > end)
+        return; // Nothing to be found
+    
+    FOUNDATION_ASSERT(same_property(indexes[start]) && same_property(indexes[end]));
 
     if (any(eval_flags, SearchQueryEvalFlags::OpLess | SearchQueryEvalFlags::OpLessEq))
     {
         for (; start <= end; ++start)
         {
-            const search_index_t& idx = db->indexes[start];
+            const search_index_t& idx = indexes[start];
             if (idx.key.number >= key.number)
                 break;
-            search_database_get_index_document_results(db, idx, and_set, results);
+            search_database_get_index_document_results(db, idx, run.postings, run.posting_count, and_set, results);
         }
         
         if (test(eval_flags, SearchQueryEvalFlags::OpLessEq))
         {
             for (; start <= end; ++start)
             {
-                const search_index_t& idx = db->indexes[start];
+                const search_index_t& idx = indexes[start];
                 if (idx.key.number > key.number)
                     break;
-                search_database_get_index_document_results(db, idx, and_set, results);
+                search_database_get_index_document_results(db, idx, run.postings, run.posting_count, and_set, results);
             }
         }
     }
@@ -961,20 +1876,20 @@ FOUNDATION_STATIC search_result_t* search_database_query_property_number(
     {
         for (; end >= start; --end)
         {
-            const search_index_t& idx = db->indexes[end];
+            const search_index_t& idx = indexes[end];
             if (idx.key.number <= key.number)
                 break;
-            search_database_get_index_document_results(db, idx, and_set, results);
+            search_database_get_index_document_results(db, idx, run.postings, run.posting_count, and_set, results);
         }
 
         if (test(eval_flags, SearchQueryEvalFlags::OpGreaterEq))
         {
             for (; end >= start; --end)
             {
-                const search_index_t& idx = db->indexes[end];
+                const search_index_t& idx = indexes[end];
                 if (idx.key.number < key.number)
                     break;
-                search_database_get_index_document_results(db, idx, and_set, results);
+                search_database_get_index_document_results(db, idx, run.postings, run.posting_count, and_set, results);
             }
         }
     }
@@ -982,6 +1897,20 @@ FOUNDATION_STATIC search_result_t* search_database_query_property_number(
     {
         FOUNDATION_ASSERT_FAIL("Invalid number query operator");
     }    
+}
+
+FOUNDATION_STATIC search_result_t* search_database_query_property_number(
+    search_database_t* db, 
+    search_query_eval_flags_t eval_flags, const search_index_key_t& key, 
+    search_result_t* and_set, search_result_t*& results)
+{
+    // We expect the db to already be locked
+    FOUNDATION_ASSERT(db->mutex.locked());
+
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(db);
+    foreach(c, cursors)
+        search_database_query_run_number(db, *c, eval_flags, key, and_set, results);
+    array_deallocate(cursors);
 
     return results;
 }
@@ -1079,7 +2008,7 @@ FOUNDATION_STATIC search_result_t* search_database_handle_query_evaluation(
     search_database_t* db = (search_database_t*)user_data;
     FOUNDATION_ASSERT(db);
 
-    if (array_size(db->indexes) == 0)
+    if (array_size(db->indexes) == 0 && array_size(db->segments) == 0)
         return nullptr;
     
     SearchIndexingFlags indexing_flags = search_database_case_indexing_flag(db);
@@ -1171,14 +2100,47 @@ bool search_database_query_dispose(search_database_t* database, search_query_han
     return database->queries[query] == nullptr;
 }
 
-bool search_database_load(search_database_t* db, stream_t* stream)
+/*! Replace the content of the database with loaded documents, indexes and strings.
+ *
+ *  @param image Image holding the loaded content used in place, if any.
+ */
+FOUNDATION_STATIC void search_database_replace(
+    search_database_t* db, 
+    search_document_t* documents, search_index_t* indexes, const search_document_handle_t* postings, uint64_t posting_count, string_table_t* strings, 
+    void* image, size_t image_size, bool image_mapped)
+{
+    search_database_wait_merges(db);
+    SHARED_WRITE_LOCK(db->mutex);
+
+    // Release the previous content before the image it might be using
+    search_database_deallocate_documents(db);
+    search_database_deallocate_indexes(db);
+    search_database_deallocate_strings(db);
+    search_database_release_image(db);
+
+    db->image = image;
+    db->image_size = image_size;
+    db->image_mapped = image_mapped;
+
+    db->dirty = false;
+    search_database_invalidate_index_count_nolock(db);
+    db->documents = documents;
+    db->document_count = 0;
+    for (uint32_t i = 1, end = array_size(documents); i < end; ++i)
+    {
+        if (documents[i].type == SearchDocumentType::Default)
+            db->document_count++;
+    }
+
+    // Loaded indexes become a single immutable segment
+    search_database_add_segment_nolock(db, indexes, postings, posting_count);
+
+    db->strings = strings;
+}
+
+/*! Load a database saved with #SEARCH_DATABASE_STREAM_VERSION, which gets deserialized field by field. */
+FOUNDATION_STATIC bool search_database_load_stream(search_database_t* db, stream_t* stream)
 {
-    // Read database header
-    search_database_header_t header;
-    stream_read(stream, &header, sizeof(SEARCH_DATABASE_HEADER));
-    if (memcmp(&header, &SEARCH_DATABASE_HEADER, sizeof(SEARCH_DATABASE_HEADER)) != 0)
-        return false;
-        
     // Read documents
     search_document_t* documents = nullptr;
     uint32_t document_count = stream_read_uint32(stream);
@@ -1189,6 +2151,10 @@ bool search_database_load(search_database_t* db, stream_t* stream)
         doc->type = (search_document_type_t)stream_read_uint8(stream);
         doc->name = stream_read_string(stream);
         doc->timestamp = stream_read_uint64(stream);
+
+        // Saved indexes never refer to removed documents, so their slots can be reused.
+        if (doc->type == SearchDocumentType::Removed)
+            doc->type = SearchDocumentType::Unused;
     }
     
     // Read string table
@@ -1228,18 +2194,157 @@ bool search_database_load(search_database_t* db, stream_t* stream)
     }
 
     // So far so good, lets swap new entries.
-    SHARED_WRITE_LOCK(db->mutex);
-    search_database_deallocate_documents(db);
-    db->dirty = false;
-    db->documents = documents;
-    db->document_count = document_count - 1; /* -1 to exclude the root document */
+    search_database_replace(db, documents, indexes, nullptr, 0, strings, nullptr, 0, false);
+    return true;
+}
 
-    search_database_deallocate_indexes(db);
-    db->indexes = indexes;
+/*! Returns the layout of a database image or null if the image is not valid.
+ *
+ *  @remark Only the header and the section bounds are validated, so the image pages are read once queried.
+ *          The postings range of an index entry is checked when its documents are read.
+ */
+FOUNDATION_STATIC const search_database_layout_t* search_database_image_layout(const void* image, size_t size)
+{
+    if (size < sizeof(search_database_header_t) + sizeof(search_database_layout_t))
+        return nullptr;
+
+    // The database structure is never serialized, so its size does not invalidate the image.
+    search_database_header_t header = *(const search_database_header_t*)image;
+    header.db_struct_size = SEARCH_DATABASE_HEADER.db_struct_size;
+    if (memcmp(&header, &SEARCH_DATABASE_HEADER, sizeof(SEARCH_DATABASE_HEADER)) != 0)
+        return nullptr;
+
+    const uint8_t* base = (const uint8_t*)image;
+    const search_database_layout_t* layout = (const search_database_layout_t*)(base + sizeof(search_database_header_t));
+    const auto section_valid = [size](uint64_t offset, uint64_t section_size)
+    {
+        return (offset % 8) == 0 && offset <= size && section_size <= size - offset;
+    };
+
+    const size_t array_header_size = sizeof(uint32_t) * 4;
+    if (layout->image_size != size ||
+        !section_valid(layout->documents_offset, sizeof(search_database_image_document_t) * (uint64_t)layout->document_count) ||
+        !section_valid(layout->names_offset, layout->names_size) ||
+        !section_valid(layout->strings_offset, layout->strings_size) || layout->strings_size < sizeof(string_table_t) ||
+        layout->indexes_offset < array_header_size ||
+        !section_valid(layout->indexes_offset - array_header_size, array_header_size + sizeof(search_index_t) * (uint64_t)layout->index_count) ||
+        !section_valid(layout->postings_offset, sizeof(search_document_handle_t) * layout->posting_count))
+    {
+        return nullptr;
+    }
+
+    const string_table_t* strings = (const string_table_t*)(base + layout->strings_offset);
+    const uint32_t* array_header = (const uint32_t*)(base + layout->indexes_offset) - 4;
+    if (strings->allocated_bytes != layout->strings_size || strings->free_slots != nullptr ||
+        array_header[0] != layout->index_count || array_header[1] != layout->index_count)
+    {
+        return nullptr;
+    }
+
+    return layout;
+}
+
+/*! Use the content of a database image in place.
+ *
+ *  Only the documents are built, the index entries, their postings, the string table and the 
+ *  document names are used from the image, so pages are only read once a query needs them.
+ *
+ *  @param mapped True if the image is a mapped file, otherwise it is memory owned by the database once used.
+ *
+ *  @return False if the image is not valid, in which case the database is left untouched.
+ */
+FOUNDATION_STATIC bool search_database_use_image(search_database_t* db, void* image, size_t size, bool mapped)
+{
+    const search_database_layout_t* layout = search_database_image_layout(image, size);
+    if (layout == nullptr)
+        return false;
+
+    uint8_t* base = (uint8_t*)image;
+    char* names = (char*)(base + layout->names_offset);
+    const search_database_image_document_t* records = (const search_database_image_document_t*)(base + layout->documents_offset);
+
+    search_document_t* documents = nullptr;
+    array_resize(documents, layout->document_count);
+    for (uint32_t i = 0; i < layout->document_count; ++i)
+    {
+        const search_database_image_document_t& record = records[i];
+        search_document_t& doc = documents[i];
+        doc.type = record.type;
+        doc.timestamp = record.timestamp;
+        doc.name = {};
+        if (record.name_length > 0 && (uint64_t)record.name_offset + record.name_length <= layout->names_size)
+            doc.name = string_t{ names + record.name_offset, record.name_length };
+    }
+
+    search_index_t* indexes = layout->index_count > 0 ? (search_index_t*)(base + layout->indexes_offset) : nullptr;
+    const search_document_handle_t* postings = (const search_document_handle_t*)(base + layout->postings_offset);
+    string_table_t* strings = (string_table_t*)(base + layout->strings_offset);
+    search_database_replace(db, documents, indexes, postings, layout->posting_count, strings, image, size, mapped);
+    return true;
+}
+
+bool search_database_load(search_database_t* db, stream_t* stream)
+{
+    // Read database header
+    const size_t start = stream_tell(stream);
+    search_database_header_t header;
+    stream_read(stream, &header, sizeof(SEARCH_DATABASE_HEADER));
+
+    // The database structure is never serialized, so its size does not invalidate the stream.
+    const uint8_t version = header.version;
+    header.version = SEARCH_DATABASE_HEADER.version;
+    header.db_struct_size = SEARCH_DATABASE_HEADER.db_struct_size;
+    if (memcmp(&header, &SEARCH_DATABASE_HEADER, sizeof(SEARCH_DATABASE_HEADER)) != 0)
+        return false;
+
+    if (version == SEARCH_DATABASE_STREAM_VERSION)
+        return search_database_load_stream(db, stream);
+
+    if (version != SEARCH_DATABASE_VERSION)
+        return false;
+
+    // Read the whole image and use it in place like a mapped file
+    const size_t size = stream_size(stream) - start;
+    void* image = memory_allocate(0, size, 8, MEMORY_PERSISTENT);
+    stream_seek(stream, (ssize_t)start, STREAM_SEEK_BEGIN);
+    if (stream_read(stream, image, size) != size || !search_database_use_image(db, image, size, false))
+    {
+        memory_deallocate(image);
+        return false;
+    }
+
+    return true;
+}
+
+bool search_database_load_file(search_database_t* db, const char* path, size_t path_length)
+{
+    FOUNDATION_ASSERT(db);
+
+    stream_t* stream = fs_open_file(path, path_length, STREAM_IN | STREAM_BINARY);
+    if (stream == nullptr)
+        return false;
+
+    const bool loaded = search_database_load(db, stream);
+    stream_deallocate(stream);
+    return loaded;
+}
+
+bool search_database_map(search_database_t* db, const char* path, size_t path_length)
+{
+    FOUNDATION_ASSERT(db);
+
+    // Pages of the mapped file are copied once written, i.e. when new strings are added to the table.
+    size_t size = 0;
+    void* image = (void*)system_map_file(path, path_length, &size, true);
+    if (image == nullptr)
+        return false;
+
+    if (!search_database_use_image(db, image, size, true))
+    {
+        system_unmap_file(image, size);
+        return false;
+    }
 
-    string_table_deallocate(db->strings);
-    db->strings = strings;    
-    
     return true;
 }
 
@@ -1250,28 +2355,172 @@ string_t* search_database_property_keywords(search_database_t* database)
     // Iterate all indexes with the type property
     SHARED_READ_LOCK(database->mutex);
     
-    for (uint32_t i = 0; i < array_size(database->indexes); ++i)
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(database);
+    foreach(c, cursors)
     {
-        const search_index_t* index = database->indexes + i;
-        if (index->key.type == SearchIndexType::Property || index->key.type == SearchIndexType::Number)
+        for (uint32_t i = 0; i < c->count; ++i)
         {
-            string_const_t keyword = string_table_to_string_const(database->strings, (string_table_symbol_t)index->key.crc);
-            if (keyword.length && !array_contains(keywords, keyword, LC2(string_equal(STRING_ARGS(_1), STRING_ARGS(_2)))))
-                array_push(keywords, string_clone(STRING_ARGS(keyword)));
+            const search_index_t* index = c->indexes + i;
+            if (index->key.type == SearchIndexType::Property || index->key.type == SearchIndexType::Number)
+            {
+                string_const_t keyword = string_table_to_string_const(database->strings, (string_table_symbol_t)index->key.crc);
+                if (keyword.length && !array_contains(keywords, keyword, LC2(string_equal(STRING_ARGS(_1), STRING_ARGS(_2)))))
+                    array_push(keywords, string_clone(STRING_ARGS(keyword)));
+            }
         }
     }
+    array_deallocate(cursors);
 
     return keywords;
 }
 
+FOUNDATION_FORCEINLINE uint64_t search_database_image_align(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+FOUNDATION_FORCEINLINE bool search_database_image_has_name(const search_document_t& doc)
+{
+    return doc.type != SearchDocumentType::Unused && doc.type != SearchDocumentType::Removed;
+}
+
 bool search_database_save(search_database_t* db, stream_t* stream)
+{
+    SHARED_READ_LOCK(db->mutex);
+
+    // Merge the indexes of all segments together without tombstones
+    search_index_t* indexes = nullptr;
+    {
+        TIME_TRACKER("Merge indexes");
+        indexes = search_database_snapshot_indexes_nolock(db);
+        string_table_pack(db->strings);
+    }
+
+    // Lay out the image sections
+    search_database_layout_t layout{};
+    layout.document_count = array_size(db->documents);
+    layout.index_count = array_size(indexes);
+    layout.documents_offset = search_database_image_align(sizeof(search_database_header_t) + sizeof(search_database_layout_t));
+    layout.names_offset = layout.documents_offset + sizeof(search_database_image_document_t) * layout.document_count;
+    foreach(d, db->documents)
+    {
+        if (search_database_image_has_name(*d))
+            layout.names_size += d->name.length + 1;
+    }
+    layout.strings_offset = search_database_image_align(layout.names_offset + layout.names_size);
+    layout.strings_size = db->strings->allocated_bytes;
+    layout.indexes_offset = search_database_image_align(layout.strings_offset + layout.strings_size) + sizeof(uint32_t) * 4;
+    layout.postings_offset = layout.indexes_offset + sizeof(search_index_t) * layout.index_count;
+    foreach(idx, indexes)
+    {
+        if (idx->document_count > ARRAY_COUNT(idx->docs))
+            layout.posting_count += idx->document_count;
+    }
+    layout.image_size = layout.postings_offset + sizeof(search_document_handle_t) * layout.posting_count;
+
+    uint64_t offset = 0, written = 0;
+    const auto write = [stream, &offset, &written](const void* data, uint64_t size)
+    {
+        written += stream_write(stream, data, size);
+        offset += size;
+    };
+    const auto pad = [&write, &offset](uint64_t section_offset)
+    {
+        static const uint8_t zeros[16]{};
+        FOUNDATION_ASSERT(section_offset >= offset && section_offset - offset <= sizeof(zeros));
+        write(zeros, section_offset - offset);
+    };
+
+    // Save database header and layout
+    write(&SEARCH_DATABASE_HEADER, sizeof(SEARCH_DATABASE_HEADER));
+    write(&layout, sizeof(layout));
+
+    // Save documents and their name pool
+    {
+        TIME_TRACKER("Write documents");
+        pad(layout.documents_offset);
+        uint32_t name_offset = 0;
+        foreach(d, db->documents)
+        {
+            search_database_image_document_t record;
+            memset(&record, 0, sizeof(record));
+            record.timestamp = d->timestamp;
+
+            // Saved indexes never refer to removed documents, so their slots can be reused.
+            record.type = d->type == SearchDocumentType::Removed ? SearchDocumentType::Unused : d->type;
+            if (search_database_image_has_name(*d))
+            {
+                record.name_offset = name_offset;
+                record.name_length = (uint32_t)d->name.length;
+                name_offset += record.name_length + 1;
+            }
+            write(&record, sizeof(record));
+        }
+
+        foreach(doc, db->documents)
+        {
+            if (!search_database_image_has_name(*doc))
+                continue;
+            write(doc->name.str, doc->name.length);
+            write("", 1);
+        }
+    }
+
+    // Save string table, its free slots are allocated separately
+    {
+        TIME_TRACKER("Write string table");
+        pad(layout.strings_offset);
+        string_table_t strings = *db->strings;
+        strings.free_slots = nullptr;
+        write(&strings, sizeof(strings));
+        write(db->strings + 1, layout.strings_size - sizeof(strings));
+    }
+
+    // Save index entries after a foundation array header, followed by the postings of entries with many documents
+    {
+        TIME_TRACKER("Write indexes");
+        pad(layout.indexes_offset - sizeof(uint32_t) * 4);
+        uint32_t array_header[4] = { 0 };
+        if (indexes)
+            memcpy(array_header, (const uint32_t*)indexes - 4, sizeof(array_header));
+        array_header[0] = array_header[1] = layout.index_count;
+        write(array_header, sizeof(array_header));
+
+        uint64_t docs_offset = 0;
+        foreach(e, indexes)
+        {
+            search_index_t entry = *e;
+            if (entry.document_count > ARRAY_COUNT(entry.docs))
+            {
+                entry.docs_offset = docs_offset;
+                docs_offset += entry.document_count;
+            }
+            write(&entry, sizeof(entry));
+        }
+
+        foreach(idx, indexes)
+        {
+            if (idx->document_count > ARRAY_COUNT(idx->docs))
+                write(idx->docs_list, sizeof(search_document_handle_t) * idx->document_count);
+        }
+        search_database_deallocate_index_array(indexes);
+    }
+
+    FOUNDATION_ASSERT(offset == layout.image_size);
+    db->dirty = false;
+    return written == layout.image_size;
+}
+
+FOUNDATION_EXTERN bool search_database_save_stream(search_database_t* db, stream_t* stream)
 {
     SHARED_READ_LOCK(db->mutex);
     
     // Save database header
     {
         TIME_TRACKER("Write header");
-        stream_write(stream, &SEARCH_DATABASE_HEADER, sizeof(SEARCH_DATABASE_HEADER));
+        search_database_header_t header = SEARCH_DATABASE_HEADER;
+        header.version = SEARCH_DATABASE_STREAM_VERSION;
+        stream_write(stream, &header, sizeof(header));
     }
 
     // Save documents
@@ -1296,11 +2545,12 @@ bool search_database_save(search_database_t* db, stream_t* stream)
         stream_write(stream, db->strings, db->strings->allocated_bytes);
     }
 
-    // Save indexes
+    // Save indexes of all segments merged together without tombstones
     {
         TIME_TRACKER("Write indexes");
-        stream_write_uint32(stream, array_size(db->indexes));
-        foreach(e, db->indexes)
+        search_index_t* indexes = search_database_snapshot_indexes_nolock(db);
+        stream_write_uint32(stream, array_size(indexes));
+        foreach(e, indexes)
         {
             stream_write(stream, &e->key, sizeof(e->key));
 
@@ -1315,89 +2565,97 @@ bool search_database_save(search_database_t* db, stream_t* stream)
                 stream_write(stream, e->docs_list, sizeof(uint32_t) * e->document_count);
             }
         }
+        search_database_deallocate_index_array(indexes);
     }
 
-    db->dirty = false;
     return true;
 }
 
-FOUNDATION_STATIC bool search_database_remove_document_nolock(search_database_t* db, search_document_handle_t document)
+bool search_database_save_file(search_database_t* db, const char* path, size_t path_length)
 {
-    bool document_removed = false;
-    search_document_t* doc = &db->documents[document];
-    if (doc->type == SearchDocumentType::Removed)
-        return false;
+    // Write to a temporary file first, so the current file is kept if anything fails.
+    char temp_path_buffer[BUILD_MAX_PATHLEN];
+    string_t temp_path = string_copy(STRING_BUFFER(temp_path_buffer), path, path_length);
+    temp_path = string_append(STRING_ARGS(temp_path), sizeof(temp_path_buffer), STRING_CONST(".tmp"));
+
+    bool success = false;
+    stream_t* stream = fs_open_file(STRING_ARGS(temp_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+    if (stream)
+    {
+        success = search_database_save(db, stream);
+        stream_deallocate(stream);
+    }
+
+    // A mapped file cannot be replaced on Windows, so the database first stops using the file 
+    // it maps by loading what was just saved. Otherwise it keeps mapping the current file.
+    const bool mapped = db->image_mapped;
+    if (success && mapped)
+        success = search_database_load_file(db, STRING_ARGS(temp_path));
 
-    for (unsigned i = 0, end = array_size(db->indexes); i < end/* && !document_removed*/; ++i)
+    if (!success || !system_replace_file(STRING_ARGS(temp_path), path, path_length))
     {
-        search_index_t& index = db->indexes[i];
+        // The current file is left untouched and the database keeps its content.
+        log_errorf(0, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to save search database %.*s"), (int)path_length, path);
+        fs_remove_file(STRING_ARGS(temp_path));
+        return false;
+    }
 
-        // Remove document from index
-        if (index.document_count <= ARRAY_COUNT(index.docs))
-        {
-            for (unsigned j = 0, endj = ARRAY_COUNT(index.docs); j < endj; ++j)
-            {
-                if (index.docs[j] == document)
-                {
-                    --index.document_count;
-                    if (index.document_count > 0)
-                    {
-                        // Remove element and memmove the rest
-                        memmove(index.docs + j, index.docs + j + 1, sizeof(search_document_handle_t) * (ARRAY_COUNT(index.docs) - j - 1));
-                    }
-                    document_removed = true;
-                    break;
-                }
-            }
-        }
-        else
-        {
-            for (unsigned j = 0, endj = array_size(index.docs_list); j < endj; ++j)
-            {
-                if (index.docs_list[j] == document)
-                {
-                    array_erase_ordered_safe(index.docs_list, j);
-                    --index.document_count;
-                    FOUNDATION_ASSERT(index.document_count == array_size(index.docs_list));
+    // Use the new file in place again rather than the loaded copy.
+    if (mapped)
+        search_database_map(db, path, path_length);
 
-                    if (index.document_count <= ARRAY_COUNT(index.docs))
-                    {
-                        // Move all documents from list to array
-                        search_document_handle_t static_docs[ARRAY_COUNT(index.docs)];
-                        for (unsigned k = 0, endk = array_size(index.docs_list); k < endk; ++k)
-                            static_docs[k] = index.docs_list[k];
-                        array_deallocate(index.docs_list);
-                        memcpy(&index.docs, &static_docs, sizeof(static_docs));
-                    }
+    return true;
+}
 
-                    document_removed = true;
-                    break;
-                }
-            }
-        }
+bool search_database_upgrade_file(const char* path, size_t path_length)
+{
+    stream_t* stream = fs_open_file(path, path_length, STREAM_IN | STREAM_BINARY);
+    if (stream == nullptr)
+        return false;
 
-        if (index.document_count == 0)
-        {
-            const char* value = (int32_t)index.key.hash > 0 ? string_table_to_string(db->strings, (uint32_t)index.key.hash) : nullptr;
-            #if 0
-            log_debugf(0, STRING_CONST("Deleting index %u (%d) -> %s:%s(%.lf)"), 
-                i, index.key.type, 
-                string_table_to_string(db->strings, (int32_t)index.key.crc),
-                value ? value : "NA", index.key.number);
-            #endif
-            array_erase_ordered_safe(db->indexes, i);
-            --i;
-            --end;
-            FOUNDATION_ASSERT(array_size(db->indexes) == end);
-        }
+    search_database_header_t header;
+    const bool previous_version = 
+        stream_read(stream, &header, sizeof(header)) == sizeof(header) &&
+        header.version == SEARCH_DATABASE_STREAM_VERSION;
+    stream_seek(stream, 0, STREAM_SEEK_BEGIN);
+
+    search_database_t* db = nullptr;
+    if (previous_version)
+    {
+        db = search_database_allocate();
+        if (!search_database_load(db, stream))
+            search_database_deallocate(db);
+    }
+
+    // Close the file before replacing it
+    stream_deallocate(stream);
+    if (db == nullptr)
+        return false;
+
+    const bool converted = search_database_save_file(db, path, path_length);
+    if (converted)
+    {
+        log_infof(0, STRING_CONST("Converted search database %.*s from version %u to %u"), 
+            (int)path_length, path, SEARCH_DATABASE_STREAM_VERSION, SEARCH_DATABASE_VERSION);
     }
+    search_database_deallocate(db);
+    return converted;
+}
+
+FOUNDATION_STATIC bool search_database_remove_document_nolock(search_database_t* db, search_document_handle_t document)
+{
+    search_document_t* doc = &db->documents[document];
+    if (doc->type != SearchDocumentType::Default)
+        return false;
 
+    // The document becomes a tombstone, its index entries are dropped when segments get merged.
     FOUNDATION_ASSERT(db->document_count > 0);
     db->document_count--;
     doc->type = SearchDocumentType::Removed;
-    db->dirty |= document_removed;
-    string_deallocate(doc->name);
-    return document_removed;
+    db->dirty = true;
+    search_database_invalidate_index_count_nolock(db);
+    search_database_deallocate_name(db, doc->name);
+    return true;
 }
 
 bool search_database_remove_document(search_database_t* db, search_document_handle_t document)
@@ -1422,7 +2680,7 @@ bool search_database_remove_old_documents(search_database_t* db, time_t referenc
             return false;
 
         search_document_t& doc = db->documents[i];
-        if (doc.type == SearchDocumentType::Removed)
+        if (doc.type != SearchDocumentType::Default)
             continue;
 
         if (doc.timestamp < reference)
@@ -1440,35 +2698,201 @@ bool search_database_remove_old_documents(search_database_t* db, time_t referenc
     return time > 0;
 }
 
+/*! Document name key used to resolve merged documents by name. */
+struct search_database_merge_name_t
+{
+    hash_t                   key;
+    search_document_handle_t doc;
+};
+
+/*! Index entry of a source database remapped to the target database. */
+struct search_database_merge_entry_t
+{
+    search_index_key_t       key;
+    search_document_handle_t doc;
+};
+
+FOUNDATION_STATIC hash_t search_database_merge_name_key(string_const_t name)
+{
+    char name_buffer[256];
+    string_t lower_name = string_to_lower_utf8(STRING_BUFFER(name_buffer), STRING_ARGS(name));
+    return string_hash(STRING_ARGS(lower_name));
+}
+
+FOUNDATION_STATIC search_document_handle_t search_database_merge_find_document(search_database_t* db, const search_database_merge_name_t* names, string_const_t name)
+{
+    const hash_t key = search_database_merge_name_key(name);
+    int i = array_binary_search_compare(names, key, [](const search_database_merge_name_t& n, const hash_t& key)
+    {
+        if (n.key < key) return -1;
+        if (n.key > key) return 1;
+        return 0;
+    });
+    if (i < 0)
+        return SEARCH_DOCUMENT_INVALID_ID;
+
+    // Check all documents sharing the same name key
+    while (i > 0 && names[i - 1].key == key)
+        --i;
+    for (unsigned end = array_size(names); i < (int)end && names[i].key == key; ++i)
+    {
+        const search_document_t& doc = db->documents[names[i].doc];
+        if (string_equal_nocase(STRING_ARGS(doc.name), STRING_ARGS(name)))
+            return names[i].doc;
+    }
+
+    return SEARCH_DOCUMENT_INVALID_ID;
+}
+
+FOUNDATION_STATIC uint64_t search_database_merge_symbol(search_database_t* db, search_database_t* source, uint64_t symbol)
+{
+    string_const_t str = string_table_to_string_const(source->strings, (string_table_symbol_t)symbol);
+    return search_database_string_to_symbol(db, STRING_ARGS(str));
+}
+
+uint32_t search_database_merge(search_database_t* db, search_database_t* source)
+{
+    FOUNDATION_ASSERT(db && source && db != source);
+
+    SHARED_READ_LOCK(source->mutex);
+    if (source->document_count == 0)
+        return 0;
+
+    SHARED_WRITE_LOCK(db->mutex);
+
+    // Resolve target documents by name using a sorted name table rather than scanning all documents.
+    search_database_merge_name_t* names = nullptr;
+    array_reserve(names, array_size(db->documents));
+    for (unsigned i = 1, end = array_size(db->documents); i < end; ++i)
+    {
+        const search_document_t& doc = db->documents[i];
+        if (doc.type != SearchDocumentType::Default)
+            continue;
+        search_database_merge_name_t name{ search_database_merge_name_key(string_to_const(doc.name)), i };
+        array_push_memcpy(names, &name);
+    }
+    array_sort(names, ARRAY_LESS_BY(key));
+
+    // Map source documents to target documents
+    uint32_t merge_count = 0;
+    const unsigned source_document_count = array_size(source->documents);
+    search_document_handle_t* doc_map = nullptr;
+    array_resize(doc_map, source_document_count);
+    for (unsigned i = 0; i < source_document_count; ++i)
+    {
+        doc_map[i] = SEARCH_DOCUMENT_INVALID_ID;
+
+        const search_document_t& source_doc = source->documents[i];
+        if (source_doc.type != SearchDocumentType::Default)
+            continue;
+
+        doc_map[i] = search_database_merge_find_document(db, names, string_to_const(source_doc.name));
+        if (doc_map[i] == SEARCH_DOCUMENT_INVALID_ID)
+        {
+            search_document_t document{};
+            document.type = SearchDocumentType::Default;
+            document.name = string_clone(STRING_ARGS(source_doc.name));
+            document.timestamp = source_doc.timestamp;
+            doc_map[i] = search_database_add_document_nolock(db, document);
+        }
+
+        merge_count++;
+    }
+    array_deallocate(names);
+
+    // Remap source index entries of all its segments to the target string table.
+    search_database_merge_entry_t* entries = nullptr;
+    search_segment_cursor_t* cursors = search_database_cursors_nolock(source);
+    search_database_visit_runs(cursors, [db, source, doc_map, &entries](const search_index_key_t& source_key, const search_document_handle_t* docs)
+    {
+        search_index_key_t key = source_key;
+        if (key.type != SearchIndexType::Trigram)
+            key.crc = search_database_merge_symbol(db, source, key.crc);
+        if (key.type == SearchIndexType::Property || key.type == SearchIndexType::Trigram)
+            key.hash = search_database_merge_symbol(db, source, key.hash);
+
+        foreach(doc, docs)
+        {
+            if (doc_map[*doc] == SEARCH_DOCUMENT_INVALID_ID)
+                continue;
+            search_database_merge_entry_t entry{ key, doc_map[*doc] };
+            array_push_memcpy(entries, &entry);
+        }
+    });
+    array_deallocate(cursors);
+
+    array_sort(entries, [](const search_database_merge_entry_t& a, const search_database_merge_entry_t& b)
+    {
+        const int c = search_database_index_key_compare(a.key, b.key);
+        if (c != 0)
+            return c;
+        return a.doc < b.doc ? -1 : a.doc > b.doc ? 1 : 0;
+    });
+
+    // Add the sorted entries as a new segment instead of inserting them one by one.
+    search_index_t* indexes = nullptr;
+    search_document_handle_t* docs = nullptr;
+    for (unsigned e = 0, entry_count = array_size(entries); e < entry_count;)
+    {
+        const search_index_key_t& key = entries[e].key;
+
+        array_clear(docs);
+        for (; e < entry_count && search_database_index_key_compare(entries[e].key, key) == 0; ++e)
+        {
+            // Entries are sorted by document, so duplicates are adjacent.
+            if (array_size(docs) == 0 || *array_last(docs) != entries[e].doc)
+                array_push(docs, entries[e].doc);
+        }
+
+        search_database_segment_push(indexes, key, docs, array_size(docs));
+    }
+    search_database_add_segment_nolock(db, indexes);
+    search_database_invalidate_index_count_nolock(db);
+
+    if (merge_count > 0)
+        db->dirty = true;
+
+    array_deallocate(docs);
+    array_deallocate(entries);
+    array_deallocate(doc_map);
+    return merge_count;
+}
+
 void search_database_print_stats(search_database_t* db)
 {
     SHARED_READ_LOCK(db->mutex);
 
+    log_infof(0, STRING_CONST("Segments: %u (%u mutable entries)"), array_size(db->segments), array_size(db->indexes));
+
+    search_index_t* indexes = search_database_snapshot_indexes_nolock(db);
+    if (array_size(indexes) == 0)
+        return;
+
     // Print the average document count per index.
     {
         uint64_t total = 0;
-        for (unsigned i = 0, end = array_size(db->indexes); i < end; ++i)
-            total += db->indexes[i].document_count;
-        log_infof(0, STRING_CONST("Average document count per index: %.1lf"), (double)total / (double)array_size(db->indexes));
+        for (unsigned i = 0, end = array_size(indexes); i < end; ++i)
+            total += indexes[i].document_count;
+        log_infof(0, STRING_CONST("Average document count per index: %.1lf"), (double)total / (double)array_size(indexes));
     }
 
     // Print the index with the most documents
     {
         unsigned max_index = 0;
         unsigned max_count = 0;
-        for (unsigned i = 0, end = array_size(db->indexes); i < end; ++i)
+        for (unsigned i = 0, end = array_size(indexes); i < end; ++i)
         {
-            if (db->indexes[i].document_count > max_count)
+            if (indexes[i].document_count > max_count)
             {
                 max_index = i;
-                max_count = db->indexes[i].document_count;
+                max_count = indexes[i].document_count;
             }
         }
         log_infof(0, STRING_CONST("Index with most documents: %u (%d) -> %s:%s(%.lf)"), 
-            max_index, db->indexes[max_index].key.type, 
-            string_table_to_string(db->strings, (int32_t)db->indexes[max_index].key.crc),
-            string_table_to_string(db->strings, (int32_t)db->indexes[max_index].key.hash),
-            db->indexes[max_index].key.number);
+            max_index, indexes[max_index].key.type, 
+            string_table_to_string(db->strings, (int32_t)indexes[max_index].key.crc),
+            string_table_to_string(db->strings, (int32_t)indexes[max_index].key.hash),
+            indexes[max_index].key.number);
     }
 
     // Print the top 50 of the most used word
@@ -1480,11 +2904,11 @@ void search_database_print_stats(search_database_t* db)
         };
 
         word_count_t* word_counts = 0;
-        for (unsigned i = 0, end = array_size(db->indexes); i < end; ++i)
+        for (unsigned i = 0, end = array_size(indexes); i < end; ++i)
         {
-            if (db->indexes[i].key.type == SearchIndexType::Word)
+            if (indexes[i].key.type == SearchIndexType::Word)
             {
-                string_table_symbol_t symbol = (string_table_symbol_t)db->indexes[i].key.crc;
+                string_table_symbol_t symbol = (string_table_symbol_t)indexes[i].key.crc;
                 if (symbol > 0)
                 {
                     bool found = false;
@@ -1492,7 +2916,7 @@ void search_database_print_stats(search_database_t* db)
                     {
                         if (word_counts[j].symbol == symbol)
                         {
-                            word_counts[j].document_count += db->indexes[i].document_count;
+                            word_counts[j].document_count += indexes[i].document_count;
                             found = true;
                             break;
                         }
@@ -1500,7 +2924,7 @@ void search_database_print_stats(search_database_t* db)
 
                     if (!found)
                     {
-                        word_count_t wc = { symbol, db->indexes[i].document_count };
+                        word_count_t wc = { symbol, indexes[i].document_count };
                         array_push(word_counts, wc);
                     }
                 }
@@ -1535,11 +2959,11 @@ void search_database_print_stats(search_database_t* db)
         };
 
         property_count_t* property_counts = 0;
-        for (unsigned i = 0, end = array_size(db->indexes); i < end; ++i)
+        for (unsigned i = 0, end = array_size(indexes); i < end; ++i)
         {
-            if (db->indexes[i].key.type == SearchIndexType::Property)
+            if (indexes[i].key.type == SearchIndexType::Property)
             {
-                string_table_symbol_t symbol = (string_table_symbol_t)db->indexes[i].key.hash;
+                string_table_symbol_t symbol = (string_table_symbol_t)indexes[i].key.hash;
                 if (symbol > 0)
                 {
                     bool found = false;
@@ -1547,7 +2971,7 @@ void search_database_print_stats(search_database_t* db)
                     {
                         if (property_counts[j].symbol == symbol)
                         {
-                            property_counts[j].document_count += db->indexes[i].document_count;
+                            property_counts[j].document_count += indexes[i].document_count;
                             found = true;
                             break;
                         }
@@ -1555,7 +2979,7 @@ void search_database_print_stats(search_database_t* db)
 
                     if (!found)
                     {
-                        property_count_t pc = { (string_table_symbol_t)db->indexes[i].key.crc, symbol, db->indexes[i].document_count };
+                        property_count_t pc = { (string_table_symbol_t)indexes[i].key.crc, symbol, indexes[i].document_count };
                         array_push(property_counts, pc);
                     }
                 }
@@ -1580,4 +3004,6 @@ void search_database_print_stats(search_database_t* db)
 
         array_deallocate(property_counts);
     }
+
+    search_database_deallocate_index_array(indexes);
 }
@@ -88,6 +88,29 @@ bool search_database_index_property(
     const char* value, size_t value_length,
     bool include_variations = true);
 
+/*! Index a label of a document, i.e. its symbol, company name or ISIN, so that it can be found 
+ *  from a partial or misspelled text with #search_database_complete.
+ * 
+ *  @remark Labels are indexed by their trigrams and are not matched by regular queries.
+ */
+bool search_database_index_label(
+    search_database_t* database, search_document_handle_t document, 
+    const char* label, size_t label_length);
+
+/*! Complete a partial or misspelled text using the labels indexed with #search_database_index_label.
+ * 
+ *  Documents with a label equal to the text come first, then documents with a label starting with the text
+ *  and then documents with a label prefix a few edits away from the text.
+ * 
+ *  @param max_results Maximum number of documents to return
+ * 
+ *  @return Documents from the best match (lowest score) to the worst, the array must be deallocated by the caller.
+ */
+search_result_t* search_database_complete(
+    search_database_t* database, 
+    const char* text, size_t text_length, 
+    unsigned max_results = 10);
+
 uint32_t search_database_index_count(search_database_t* database);
 
 uint32_t search_database_document_count(search_database_t* database);
@@ -101,6 +124,12 @@ uint32_t search_database_word_document_count(
 
 uint32_t search_database_word_count(search_database_t* database);
 
+/*! Remove a document from the database.
+ * 
+ *  The document becomes a tombstone that queries skip until segment merges drop its index entries.
+ * 
+ *  @return True if the document was removed.
+ */
 bool search_database_remove_document(search_database_t* database, search_document_handle_t document);
 
 bool search_database_is_document_valid(search_database_t* database, search_document_handle_t document);
@@ -115,10 +144,49 @@ const search_result_t* search_database_query_results(search_database_t* database
 
 bool search_database_query_dispose(search_database_t* database, search_query_handle_t query);
 
+/*! Load a search database from a stream.
+ * 
+ *  Streams saved with the current version are read at once and used in place, streams saved with 
+ *  the previous version are deserialized.
+ * 
+ *  @return True if the database was loaded.
+ */
 bool search_database_load(search_database_t* database, stream_t* stream);
 
+/*! Save the search database as an image that can be mapped with #search_database_map. */
 bool search_database_save(search_database_t* database, stream_t* stream);
 
+/*! Map a search database file saved with #search_database_save_file.
+ * 
+ *  Loading takes the same time regardless of the database size, its index entries, postings and strings 
+ *  are used in place and their pages are only read once queried.
+ * 
+ *  @return False if the file is missing or saved with a previous version (see #search_database_upgrade_file).
+ */
+bool search_database_map(search_database_t* database, const char* path, size_t path_length);
+
+/*! Load in memory a search database file, saved with the current or the previous version.
+ * 
+ *  @remark Prefer #search_database_map for files saved with the current version.
+ * 
+ *  @return False if the file is missing or not valid, in which case the database is left untouched.
+ */
+bool search_database_load_file(search_database_t* database, const char* path, size_t path_length);
+
+/*! Save the search database to a file that can be mapped, even if the database is mapping the same file.
+ * 
+ *  @remark The database must not be updated while saving. If it maps the file, it gets reloaded from the saved content.
+ * 
+ *  @return False if the file could not be saved, in which case the previous file is left untouched.
+ */
+bool search_database_save_file(search_database_t* database, const char* path, size_t path_length);
+
+/*! Convert in place a search database file saved with the previous version so that it can be mapped.
+ * 
+ *  @return True if the file was converted, false if it is missing, invalid or already up to date.
+ */
+bool search_database_upgrade_file(const char* path, size_t path_length);
+
 string_t* search_database_property_keywords(search_database_t* database);
 
 /*! Print statistics about the search database to the console.
@@ -136,3 +204,16 @@ void search_database_print_stats(search_database_t* database);
  *  @return True if any documents were removed and the timeout was not reached, false otherwise.
  */
 bool search_database_remove_old_documents(search_database_t* database, time_t reference, double timeout_seconds = 0.0);
+
+/*! Merge the documents and indexes of another database into the database.
+ * 
+ *  Documents are matched by name, and missing documents are added with the source timestamp.
+ *  The source indexes are added in bulk as a new segment, which is much faster than
+ *  indexing the same documents again one entry at a time.
+ * 
+ *  @param database The search database to merge documents into.
+ *  @param source   The search database to merge documents from, it is left unchanged.
+ * 
+ *  @return Number of documents merged.
+ */
+uint32_t search_database_merge(search_database_t* database, search_database_t* source);
@@ -20,10 +20,19 @@
     #include <foundation/windows.h>
     #include <Commdlg.h>
     #include <CommCtrl.h>
+    #include <Psapi.h>
 
     #include <iostream>
 
     #pragma comment( lib, "comctl32.lib" )
+    #pragma comment( lib, "psapi.lib" )
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/resource.h>
+    #include <stdio.h>
 #endif
 
 extern void* _window_handle;
@@ -486,6 +495,152 @@ string_const_t system_executable_resource_to_file(const char* resource_name, con
 #endif    
 }
 
+const void* system_map_file(const char* path, size_t length, size_t* out_size, bool copy_on_write /*= false*/)
+{
+    FOUNDATION_ASSERT(out_size);
+    *out_size = 0;
+
+    char path_buffer[BUILD_MAX_PATHLEN];
+    string_t file_path = string_copy(STRING_BUFFER(path_buffer), path, length);
+
+#if FOUNDATION_PLATFORM_WINDOWS
+
+    HANDLE file = CreateFileA(file_path.str, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return nullptr;
+
+    // The view keeps a reference on the mapping object.
+    const void* data = MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == nullptr)
+        return nullptr;
+
+    *out_size = (size_t)file_size.QuadPart;
+    return data;
+
+#else
+
+    int fd = open(file_path.str, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    // The mapping remains valid once the file descriptor is closed.
+    void* data = copy_on_write ?
+        mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) :
+        mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    *out_size = (size_t)st.st_size;
+    return data;
+
+#endif
+}
+
+void system_unmap_file(const void* data, size_t size)
+{
+    if (data == nullptr)
+        return;
+
+#if FOUNDATION_PLATFORM_WINDOWS
+    FOUNDATION_UNUSED(size);
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+bool system_replace_file(const char* source_path, size_t source_path_length, const char* dest_path, size_t dest_path_length)
+{
+    char source_buffer[BUILD_MAX_PATHLEN];
+    char dest_buffer[BUILD_MAX_PATHLEN];
+    string_t source = string_copy(STRING_BUFFER(source_buffer), source_path, source_path_length);
+    string_t dest = string_copy(STRING_BUFFER(dest_buffer), dest_path, dest_path_length);
+
+#if FOUNDATION_PLATFORM_WINDOWS
+    // Unlike fs_move_file, the destination gets replaced if it already exists.
+    if (MoveFileExA(source.str, dest.str, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        return true;
+
+    string_const_t errmsg = system_error_message(0);
+    log_warnf(0, WARNING_SYSTEM_CALL_FAIL, STRING_CONST("Failed to replace %.*s with %.*s: %.*s"),
+        STRING_FORMAT(dest), STRING_FORMAT(source), STRING_FORMAT(errmsg));
+    return false;
+#else
+    // Renaming atomically replaces the destination, mappings of the previous file remain valid.
+    if (rename(source.str, dest.str) == 0)
+        return true;
+
+    string_const_t errmsg = system_error_message(0);
+    log_warnf(0, WARNING_SYSTEM_CALL_FAIL, STRING_CONST("Failed to replace %.*s with %.*s: %.*s"),
+        STRING_FORMAT(dest), STRING_FORMAT(source), STRING_FORMAT(errmsg));
+    return false;
+#endif
+}
+
+double system_process_cpu_time()
+{
+#if FOUNDATION_PLATFORM_WINDOWS
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        return 0;
+
+    // File times are expressed in 100 nanosecond intervals.
+    const uint64_t kernel = ((uint64_t)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    const uint64_t user = ((uint64_t)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+    return (double)(kernel + user) / 10000000.0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+#endif
+}
+
+size_t system_process_peak_memory()
+{
+#if FOUNDATION_PLATFORM_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    #if FOUNDATION_PLATFORM_MACOS
+        return (size_t)usage.ru_maxrss;
+    #else
+        // Linux reports the maximum resident set size in kilobytes.
+        return (size_t)usage.ru_maxrss * 1024;
+    #endif
+#endif
+}
+
 bool system_notification_push(const char* title, size_t title_length, const char* message, size_t message_length)
 {
 #if FOUNDATION_PLATFORM_WINDOWS
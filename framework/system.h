@@ -189,3 +189,47 @@ string_const_t system_get_last_error_message(uint32_t* error = nullptr);
  *  @return Path to the extracted resource file.
  */
 string_const_t system_executable_resource_to_file(const char* resource_name, const char* resource_type);
+
+/*! Map a file in read-only memory.
+ *
+ *  @remark The mapped memory remains valid until #system_unmap_file is called, even if the file is deleted.
+ *
+ *  @param path          Path of the file to map
+ *  @param length        Length of the file path
+ *  @param out_size      Size of the mapped memory, which is the file size
+ *  @param copy_on_write If true, the mapped memory can be written to. Written pages are copied and 
+ *                       changes are never written back to the file.
+ *
+ *  @return Pointer to the mapped memory or null if the file could not be mapped.
+ */
+const void* system_map_file(const char* path, size_t length, size_t* out_size, bool copy_on_write = false);
+
+/*! Release memory mapped with #system_map_file.
+ *
+ *  @param data        Pointer returned by #system_map_file
+ *  @param size        Size of the mapped memory
+ */
+void system_unmap_file(const void* data, size_t size);
+
+/*! Move a file over another one, replacing the destination file if it exists.
+ *
+ *  @remark On Windows, the destination file cannot be replaced while it is mapped,
+ *          so any mapping of the destination must be released first.
+ *
+ *  @param source_path          Path of the file to move, usually a temporary file written next to the destination
+ *  @param source_path_length   Length of the source path
+ *  @param dest_path            Path of the file to replace
+ *  @param dest_path_length     Length of the destination path
+ *
+ *  @return True if the destination file was replaced. If not, both files are left untouched.
+ */
+bool system_replace_file(const char* source_path, size_t source_path_length, const char* dest_path, size_t dest_path_length);
+
+/*! Returns the processor time consumed by all the threads of the process, in seconds.
+ *
+ *  @remark Compare it with the elapsed time of an operation to tell whether threads were busy or waiting.
+ */
+double system_process_cpu_time();
+
+/*! Returns the largest amount of physical memory the process used since it started, in bytes. */
+size_t system_process_peak_memory();
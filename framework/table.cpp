@@ -1124,6 +1124,12 @@ void table_render(table_t* table, table_element_ptr_const_t elements, const int
     ImGui::EndTable();
 }
 
+void table_update_rows(table_t* table, table_element_ptr_const_t elements, const int element_count, size_t element_size)
+{
+    table_render_update_ordered_elements(table, elements, element_count, element_size);
+    table_render_filter_rows(table);
+}
+
 void table_clear_columns(table_t* table)
 {
     const size_t column_count = sizeof(table->columns) / sizeof(table->columns[0]);
@@ -655,6 +655,17 @@ float table_default_row_height();
  */
 void table_set_search_filter(table_t* table, const char* filter, size_t filter_length);
 
+/*! Update the table rows from a set of elements without rendering the table.
+ * 
+ *  @remark This is used to export a table that was never rendered, i.e. when running headless.
+ * 
+ *  @param table            The table
+ *  @param elements         The elements to be displayed
+ *  @param element_count    The number of elements
+ *  @param element_size     The size of each element
+ */
+void table_update_rows(table_t* table, table_element_ptr_const_t elements, const int element_count, size_t element_size);
+
 /*! Export the table content into a csv file. 
  *  @param table            The table
  *  @param path             The path to the csv file
@@ -30,6 +30,7 @@
 #include <framework/table.h>
 #include <framework/array.h>
 #include <framework/system.h>
+#include <framework/shared_mutex.h>
 
 #define HASH_TABLE_EXPRESSION static_hash_string("table_expr", 10, 0x20a95260d96304aULL)
 
@@ -40,6 +41,7 @@ struct table_expr_type_drawer_t
 };
 
 static table_expr_type_drawer_t* _table_expr_type_drawers{ nullptr };
+static shared_mutex _table_expr_type_drawers_lock;
 
 typedef enum TableExprValueType {
     DYNAMIC_TABLE_VALUE_NULL = 0,
@@ -252,6 +254,7 @@ FOUNDATION_STATIC expr_result_t table_expr_eval(const expr_func_t* f, vec_expr_t
                     else
                     {
                         // Check if we have a registered drawer for the format string
+                        SHARED_READ_LOCK(_table_expr_type_drawers_lock);
                         for (unsigned int j = 0; j < array_size(_table_expr_type_drawers); ++j)
                         {
                             auto* drawer = _table_expr_type_drawers + j;
@@ -376,6 +379,8 @@ void table_expr_add_type_drawer(const char* type, size_t length, const function<
     table_expr_type_drawer_t drawer{};
     drawer.type = string_clone(type, length);
     drawer.handler = handler;
+
+    SHARED_WRITE_LOCK(_table_expr_type_drawers_lock);
     array_push_memcpy(_table_expr_type_drawers, &drawer);
 }
 
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2023 - All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ */
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS
+
+#include "bench.h"
+
+#include <framework/common.h>
+#include <framework/config.h>
+#include <framework/system.h>
+#include <framework/query.h>
+#include <framework/array.h>
+#include <framework/math.h>
+
+#include <foundation/memory.h>
+#include <foundation/atomic.h>
+#include <foundation/environment.h>
+
+#include <stdio.h>
+
+#define HASH_BENCH static_hash_string("bench", 5, 0xaaacea8630722704ULL)
+
+/*! Number of times each scenario runs when --bench-iterations is not specified. */
+constexpr unsigned BENCH_DEFAULT_ITERATION_COUNT = 5;
+
+struct bench_result_t
+{
+    string_t name{};
+    double*  samples{ nullptr };        // Elapsed time of each iteration in milliseconds
+    double   cpu_time{ 0 };             // Process CPU time consumed by all iterations in seconds
+    uint64_t allocations{ 0 };          // Number of allocations made by all iterations
+    uint64_t allocated_high_water{ 0 }; // Largest amount of memory allocated during an iteration over what was allocated before the scenario
+    size_t   peak_memory_growth{ 0 };   // Growth of the process peak memory while the scenario ran
+    unsigned queries{ 0 };              // Number of queries served by mocks
+};
+
+static bench_result_t* _bench_results = nullptr;
+
+// Tracker the benchmark tracker forwards allocations to.
+static memory_tracker_t _bench_memory_tracker{};
+// Largest amount of memory allocated since the counter was reset.
+static atomic64_t _bench_allocated_high_water{ 0 };
+
+//
+// # PRIVATE
+//
+
+FOUNDATION_STATIC double bench_percentile(const double* sorted_samples, double percentile)
+{
+    const unsigned count = array_size(sorted_samples);
+    if (count == 0)
+        return NAN;
+
+    const unsigned rank = (unsigned)math_ceil(count * percentile);
+    return sorted_samples[min(count - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+FOUNDATION_STATIC void bench_memory_track(hash_t context, void* addr, size_t size)
+{
+    _bench_memory_tracker.track(context, addr, size);
+
+    // Transient allocations are caught here, while sampling after an iteration would miss them.
+    const int64_t allocated = (int64_t)memory_statistics().allocated_current;
+    int64_t high_water = atomic_load64(&_bench_allocated_high_water, memory_order_relaxed);
+    while (allocated > high_water && !atomic_cas64(&_bench_allocated_high_water, allocated, high_water, memory_order_relaxed, memory_order_relaxed))
+        high_water = atomic_load64(&_bench_allocated_high_water, memory_order_relaxed);
+}
+
+FOUNDATION_STATIC void bench_memory_high_water_reset()
+{
+    atomic_store64(&_bench_allocated_high_water, (int64_t)memory_statistics().allocated_current, memory_order_relaxed);
+}
+
+FOUNDATION_STATIC unsigned bench_query_count()
+{
+    #if ENABLE_QUERY_MOCKING
+        return query_mock_request_count();
+    #else
+        return 0;
+    #endif
+}
+
+FOUNDATION_STATIC void bench_write_result(config_handle_t scenarios, const bench_result_t& r)
+{
+    double* sorted_samples = nullptr;
+    array_copy(sorted_samples, r.samples);
+    sorted_samples = array_sort(sorted_samples);
+
+    const double average = array_size(sorted_samples) > 0 ? math_average(sorted_samples, array_size(sorted_samples)) : NAN;
+
+    config_handle_t cv = config_array_push(scenarios, CONFIG_VALUE_OBJECT);
+    config_set(cv, STRING_CONST("name"), STRING_ARGS(r.name));
+    config_set(cv, STRING_CONST("iterations"), (double)array_size(r.samples));
+    config_set(cv, STRING_CONST("min_ms"), bench_percentile(sorted_samples, 0.0));
+    config_set(cv, STRING_CONST("mean_ms"), average);
+    config_set(cv, STRING_CONST("p50_ms"), bench_percentile(sorted_samples, 0.50));
+    config_set(cv, STRING_CONST("p90_ms"), bench_percentile(sorted_samples, 0.90));
+    config_set(cv, STRING_CONST("p99_ms"), bench_percentile(sorted_samples, 0.99));
+    config_set(cv, STRING_CONST("max_ms"), bench_percentile(sorted_samples, 1.0));
+    config_set(cv, STRING_CONST("cpu_time_ms"), r.cpu_time * 1000.0);
+    config_set(cv, STRING_CONST("allocations"), (double)r.allocations);
+    config_set(cv, STRING_CONST("allocated_high_water_bytes"), (double)r.allocated_high_water);
+    config_set(cv, STRING_CONST("peak_memory_growth_bytes"), (double)r.peak_memory_growth);
+    config_set(cv, STRING_CONST("queries"), (double)r.queries);
+
+    config_handle_t samples = config_set_array(cv, STRING_CONST("samples_ms"));
+    foreach(s, r.samples)
+        config_array_push(samples, *s);
+
+    array_deallocate(sorted_samples);
+}
+
+//
+// # PUBLIC API
+//
+
+memory_tracker_t bench_memory_tracker(memory_tracker_t tracker)
+{
+    if (tracker.track == nullptr)
+        return tracker;
+
+    _bench_memory_tracker = tracker;
+    tracker.track = bench_memory_track;
+    return tracker;
+}
+
+unsigned bench_iteration_count()
+{
+    string_const_t count_string;
+    if (environment_argument("bench-iterations", &count_string))
+    {
+        const unsigned count = string_to_uint(STRING_ARGS(count_string), false);
+        if (count > 0)
+            return count;
+    }
+
+    return BENCH_DEFAULT_ITERATION_COUNT;
+}
+
+double bench_run(const char* name, size_t name_length, const bench_handler_t& run, const bench_handler_t& reset /*= nullptr*/)
+{
+    FOUNDATION_ASSERT(run);
+
+    bench_result_t r{};
+    r.name = string_clone(name, name_length);
+
+    const unsigned iteration_count = bench_iteration_count();
+    const memory_statistics_t memory_start = memory_statistics();
+    const size_t peak_memory_start = system_process_peak_memory();
+    const unsigned queries_start = bench_query_count();
+
+    for (unsigned i = 0; i < iteration_count; ++i)
+    {
+        // Allocations made by the reset handler of the previous iteration are not accounted.
+        bench_memory_high_water_reset();
+
+        const double cpu_time_start = system_process_cpu_time();
+        const tick_t start = time_current();
+        run(i);
+        const double elapsed_ms = time_elapsed(start) * 1000.0;
+        r.cpu_time += system_process_cpu_time() - cpu_time_start;
+        array_push(r.samples, elapsed_ms);
+
+        const uint64_t high_water = (uint64_t)atomic_load64(&_bench_allocated_high_water, memory_order_relaxed);
+        if (high_water > memory_start.allocated_current)
+            r.allocated_high_water = max(r.allocated_high_water, high_water - memory_start.allocated_current);
+
+        if (reset)
+            reset(i);
+    }
+
+    r.allocations = memory_statistics().allocations_total - memory_start.allocations_total;
+    r.peak_memory_growth = system_process_peak_memory() - peak_memory_start;
+    r.queries = bench_query_count() - queries_start;
+
+    double* sorted_samples = nullptr;
+    array_copy(sorted_samples, r.samples);
+    sorted_samples = array_sort(sorted_samples);
+    const double median = bench_percentile(sorted_samples, 0.50);
+    array_deallocate(sorted_samples);
+
+    log_infof(HASH_BENCH, STRING_CONST("%.*s: %u iterations, p50 %.3lf ms, cpu time %.3lf ms"),
+        (int)name_length, name, iteration_count, median, r.cpu_time * 1000.0);
+
+    array_push_memcpy(_bench_results, &r);
+    return median;
+}
+
+bool bench_write_results(const char* path, size_t path_length)
+{
+    config_handle_t results = config_allocate(CONFIG_VALUE_OBJECT, CONFIG_OPTION_PRESERVE_INSERTION_ORDER);
+
+    const application_t* app = environment_application();
+    string_const_t version_string = string_from_version_static(app->version);
+    config_set(results, STRING_CONST("version"), STRING_ARGS(version_string));
+    config_set(results, STRING_CONST("timestamp"), (double)time_system() / 1000.0);
+    config_set(results, STRING_CONST("iterations"), (double)bench_iteration_count());
+    config_set(results, STRING_CONST("peak_memory_bytes"), (double)system_process_peak_memory());
+
+    config_handle_t scenarios = config_set_array(results, STRING_CONST("scenarios"));
+    foreach(r, _bench_results)
+        bench_write_result(scenarios, *r);
+
+    bool written = false;
+    if (path_length > 0)
+    {
+        written = config_write_file(path, path_length, results, CONFIG_OPTION_WRITE_JSON);
+        if (written)
+            log_infof(HASH_BENCH, STRING_CONST("Benchmark results written to %.*s"), (int)path_length, path);
+        else
+            log_errorf(HASH_BENCH, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to write benchmark results to %.*s"), (int)path_length, path);
+    }
+    else
+    {
+        config_sjson_const_t json = config_sjson(results, CONFIG_OPTION_WRITE_JSON);
+        string_const_t json_string = config_sjson_to_string(json);
+        fprintf(stdout, "%.*s\n", STRING_FORMAT(json_string));
+        fflush(stdout);
+        config_sjson_deallocate(json);
+        written = true;
+    }
+
+    config_deallocate(results);
+    return written;
+}
+
+void bench_results_clear()
+{
+    foreach(r, _bench_results)
+    {
+        string_deallocate(r->name.str);
+        array_deallocate(r->samples);
+    }
+    array_deallocate(_bench_results);
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2023 - All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ *
+ * Benchmark helpers used by the test cases of the `Bench` test suite.
+ *
+ * Scenarios only run with --bench, i.e.
+ *      > ./build/<app>.exe --bench --bench-iterations=10 --bench-out=artifacts/bench.json
+ *
+ * Timings of each scenario are written as JSON once all scenarios ran, so they can be compared between versions.
+ */
+
+#pragma once
+
+#include <framework/function.h>
+
+#include <foundation/platform.h>
+#include <foundation/memory.h>
+
+#if BUILD_TESTS
+
+/*! Name of the test suite holding the benchmark scenarios. */
+#define BENCH_TEST_SUITE "Bench"
+
+/*! Benchmark scenario iteration handler. */
+typedef function<void(unsigned iteration)> bench_handler_t;
+
+/*! Wraps a memory tracker so the scenarios record the largest amount of memory allocated by each iteration.
+ *
+ *  @param tracker Tracker the allocations are forwarded to.
+ *
+ *  @return The tracker to install with #memory_set_tracker.
+ */
+memory_tracker_t bench_memory_tracker(memory_tracker_t tracker);
+
+/*! Returns the number of times each scenario runs, which can be set with --bench-iterations=<count>. */
+unsigned bench_iteration_count();
+
+/*! Run a benchmark scenario and record the elapsed time and memory usage of each iteration.
+ *
+ *  @param name         Name of the scenario as it appears in the results.
+ *  @param name_length  Length of the scenario name.
+ *  @param run          Handler measured at each iteration.
+ *  @param reset        Handler invoked after each iteration and not measured, i.e. to release what the iteration created.
+ *
+ *  @return The median time of the iterations in milliseconds.
+ */
+double bench_run(const char* name, size_t name_length, const bench_handler_t& run, const bench_handler_t& reset = nullptr);
+
+/*! Write the results of all the scenarios that ran as JSON.
+ *
+ *  @param path         Path of the JSON file. If empty, the results are printed to the standard output.
+ *  @param path_length  Length of the path.
+ *
+ *  @return True if the results were written.
+ */
+bool bench_write_results(const char* path, size_t path_length);
+
+/*! Release the results of the scenarios that ran. */
+void bench_results_clear();
+
+#endif
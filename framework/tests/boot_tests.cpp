@@ -5,6 +5,9 @@
  * Example how to run tests: 
  *      > ./build/<app>.exe --run-tests & cat artifacts/tests.log
  *      > ./build/<app>.exe --run-tests --minimal=false --duration=true && n artifacts/tests.log
+ *
+ * Example how to run benchmarks:
+ *      > ./build/<app>.exe --bench --bench-iterations=10 & cat artifacts/bench.json
  */
 
 #include <foundation/platform.h>
@@ -12,6 +15,7 @@
 #if BUILD_TESTS
 
 #include "test_utils.h"
+#include "bench.h"
 
 #include <framework/glfw.h>
 
@@ -184,6 +188,33 @@ struct TestReporter : public doctest::IReporter
     }
 };
 
+/*! Resolves the path of a file in the artifacts folder next to the build folder.
+ *
+ *  @return The file path or an empty string if the artifacts folder does not exist.
+ */
+FOUNDATION_STATIC string_t main_tests_artifact_path(char* buffer, size_t capacity, const char* file_name, size_t file_name_length)
+{
+    string_const_t exe_dir = environment_executable_directory();
+    string_t artifacts_path = path_concat(buffer, capacity,
+        STRING_ARGS(exe_dir), 
+    #if FOUNDATION_PLATFORM_WINDOWS
+        STRING_CONST("../artifacts"));
+    #elif FOUNDATION_PLATFORM_MACOS
+        STRING_CONST("../../../../artifacts"));
+    #else
+        #error Platform not supported
+    #endif
+    artifacts_path = path_clean(STRING_ARGS(artifacts_path), capacity);
+
+    if (!fs_is_directory(STRING_ARGS(artifacts_path)))
+    {
+        log_warnf(0, WARNING_INVALID_VALUE, STRING_CONST("Missing artifacts folder `%.*s`"), STRING_FORMAT(artifacts_path));
+        return string_t{ buffer, 0 };
+    }
+
+    return path_append(STRING_ARGS(artifacts_path), capacity, file_name, file_name_length);
+}
+
 extern int main_tests(void* _context, GLFWwindow* window)
 {
     doctest::Context context;
@@ -198,26 +229,27 @@ extern int main_tests(void* _context, GLFWwindow* window)
     context.setOption("no-path-filenames", "true");
     context.setOption("no-debug-output", "true");
 
+    const bool run_benchmarks = main_is_running_benchmarks();
+    if (run_benchmarks)
+    {
+        // Only run the benchmark scenarios and let them all run even if one fails.
+        context.setOption("test-suite", BENCH_TEST_SUITE);
+        context.setOption("abort-after", 0);
+    }
+    else
+    {
+        // Benchmark scenarios take a while and are only useful when their results get written.
+        context.setOption("test-suite-exclude", BENCH_TEST_SUITE);
+    }
+
     if (!environment_argument("out"))
     {
         char test_log_path_buffer[BUILD_MAX_PATHLEN];
-        string_const_t exe_dir = environment_executable_directory();
-        string_t test_log_path = path_concat(STRING_BUFFER(test_log_path_buffer),
-            STRING_ARGS(exe_dir), 
-        #if FOUNDATION_PLATFORM_WINDOWS
-            STRING_CONST("../artifacts/tests.log"));
-        #elif FOUNDATION_PLATFORM_MACOS
-            STRING_CONST("../../../../artifacts/tests.log"));
-        #else
-            #error Platform not supported
-        #endif
-        test_log_path = path_clean(STRING_ARGS(test_log_path), BUILD_MAX_PATHLEN);
-        string_const_t test_log_dir = path_directory_name(STRING_ARGS(test_log_path));
-
-        if (fs_is_directory(STRING_ARGS(test_log_dir)))
+        string_t test_log_path = run_benchmarks ? 
+            main_tests_artifact_path(STRING_BUFFER(test_log_path_buffer), STRING_CONST("bench.log")) :
+            main_tests_artifact_path(STRING_BUFFER(test_log_path_buffer), STRING_CONST("tests.log"));
+        if (test_log_path.length)
             context.setOption("out", test_log_path.str);
-        else
-            log_warnf(0, WARNING_INVALID_VALUE, STRING_CONST("Missing artifacts folder `%.*s`"), STRING_FORMAT(test_log_dir));
     }
 
     context.setAssertHandler([](const doctest::AssertData& in)
@@ -241,6 +273,22 @@ extern int main_tests(void* _context, GLFWwindow* window)
 
     _test_window = window;
     int res = context.run();
+
+    if (run_benchmarks)
+    {
+        // Results are printed to the standard output when there is nowhere to write them.
+        string_const_t bench_results_path;
+        char bench_results_path_buffer[BUILD_MAX_PATHLEN];
+        if (!environment_argument("bench-out", &bench_results_path))
+        {
+            bench_results_path = string_to_const(main_tests_artifact_path(
+                STRING_BUFFER(bench_results_path_buffer), STRING_CONST("bench.json")));
+        }
+        if (!bench_write_results(STRING_ARGS(bench_results_path)) && res == 0)
+            res = -1;
+        bench_results_clear();
+    }
+
     if (context.shouldExit())
         return res;
     return res;
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2022-2023 - All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ *
+ * Console logger tests
+ */
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS
+
+#include "test_utils.h"
+#include "bench.h"
+
+#include <framework/console.h>
+
+#include <foundation/log.h>
+#include <foundation/thread.h>
+#include <foundation/atomic.h>
+
+FOUNDATION_EXTERN size_t console_process_records();
+FOUNDATION_EXTERN void console_logger(hash_t context, error_level_t severity, const char* msg, size_t length);
+FOUNDATION_EXTERN size_t console_memory_usage(size_t* out_message_count, size_t* out_dropped_count);
+
+constexpr int CONSOLE_TEST_THREAD_COUNT = 16;
+constexpr int CONSOLE_TEST_MESSAGE_PER_THREAD = 20000;
+
+static atomic32_t _console_test_running_threads;
+
+FOUNDATION_STATIC void* console_test_logging_thread_fn(void* arg)
+{
+    const int thread_index = (int)(uintptr_t)arg;
+
+    char msg_buffer[128];
+    for (int i = 0; i < CONSOLE_TEST_MESSAGE_PER_THREAD; ++i)
+    {
+        string_t msg = string_format(STRING_BUFFER(msg_buffer), STRING_CONST("Thread %d logging message %d"), thread_index, i);
+        console_logger(0, ERRORLEVEL_INFO, STRING_ARGS(msg));
+    }
+
+    atomic_decr32(&_console_test_running_threads, memory_order_release);
+    return 0;
+}
+
+TEST_SUITE("Console")
+{
+    TEST_CASE("Main thread records")
+    {
+        console_clear();
+
+        size_t message_count = 0;
+        console_logger(0, ERRORLEVEL_INFO, STRING_CONST("First message"));
+        console_logger(0, ERRORLEVEL_WARNING, STRING_CONST("Second message\nwith a line return"));
+        CHECK_EQ(console_process_records(), 2);
+
+        console_memory_usage(&message_count, nullptr);
+        CHECK_EQ(message_count, 2);
+
+        // Filling the main thread ring forces the main thread to consume its own records.
+        for (int i = 0; i < 1000; ++i)
+            console_logger(0, ERRORLEVEL_INFO, STRING_CONST("Flooding the main thread ring"));
+        console_process_records();
+
+        size_t dropped_count = 0;
+        console_memory_usage(&message_count, &dropped_count);
+        CHECK_EQ(message_count, 1002);
+        CHECK_EQ(dropped_count, 0);
+
+        console_clear();
+    }
+
+    TEST_CASE("Benchmark 16 threads" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(60))
+    {
+        console_clear();
+
+        thread_t* threads[CONSOLE_TEST_THREAD_COUNT];
+        atomic_store32(&_console_test_running_threads, CONSOLE_TEST_THREAD_COUNT, memory_order_release);
+        for (int i = 0; i < CONSOLE_TEST_THREAD_COUNT; ++i)
+            threads[i] = thread_allocate(console_test_logging_thread_fn, (void*)(uintptr_t)i, STRING_CONST("console_test"), THREAD_PRIORITY_NORMAL, 0);
+
+        size_t processed_count = 0;
+        size_t peak_memory_usage = 0;
+        const tick_t start_time = time_current();
+        for (int i = 0; i < CONSOLE_TEST_THREAD_COUNT; ++i)
+            thread_start(threads[i]);
+
+        // Consume records like the main loop would do while threads are logging.
+        while (atomic_load32(&_console_test_running_threads, memory_order_acquire) > 0)
+        {
+            processed_count += console_process_records();
+            peak_memory_usage = max(peak_memory_usage, console_memory_usage(nullptr, nullptr));
+            thread_yield();
+        }
+        processed_count += console_process_records();
+        const double elapsed_time = time_elapsed(start_time);
+
+        for (int i = 0; i < CONSOLE_TEST_THREAD_COUNT; ++i)
+        {
+            thread_join(threads[i]);
+            thread_deallocate(threads[i]);
+        }
+
+        size_t message_count = 0, dropped_count = 0;
+        const size_t memory_usage = console_memory_usage(&message_count, &dropped_count);
+        const size_t logged_count = CONSOLE_TEST_THREAD_COUNT * CONSOLE_TEST_MESSAGE_PER_THREAD;
+
+        MESSAGE(string_format_static_const("Logged %zu messages in %.3lf seconds (%.0lf messages/sec), %zu processed, %zu dropped",
+            logged_count, elapsed_time, logged_count / elapsed_time, processed_count, dropped_count));
+        MESSAGE(string_format_static_const("Console memory usage %.2lf MB (peak %.2lf MB) for %zu messages",
+            memory_usage / 1024.0 / 1024.0, peak_memory_usage / 1024.0 / 1024.0, message_count));
+
+        // Every message is either processed or accounted as dropped, and the console never grows past its capacity.
+        CHECK_EQ(processed_count + dropped_count, logged_count);
+        CHECK_LE(message_count, 20000);
+
+        console_clear();
+    }
+}
+
+#endif
@@ -932,6 +932,35 @@ TEST_SUITE("Expressions")
         test_expr("zzlowercase(COUCOU)=='coucou'", true);
         CHECK_EQ(eval("zzlowercase('')").as_boolean(), false);
     }
+
+    TEST_CASE("Compiled")
+    {
+        string_const_t expression = CTEXT("SUM(MAP([1, 2, 3], $1 * $X))");
+
+        expr_var_list_t vars{ nullptr };
+        expr_t* e = expr_compile(STRING_ARGS(expression), &vars);
+        REQUIRE_NE(e, nullptr);
+
+        expr_var_t* x = nullptr;
+        for (expr_var_t* v = vars.head; v; v = v->next)
+        {
+            if (string_equal(STRING_ARGS(v->name), STRING_CONST("$X")))
+                x = v;
+        }
+        REQUIRE_NE(x, nullptr);
+
+        x->value = expr_result_t(2.0);
+        CHECK_EQ(expr_eval_compiled(e, &vars, expression).as_number(), 12.0);
+
+        x->value = expr_result_t(10.0);
+        CHECK_EQ(expr_eval_compiled(e, &vars, expression).as_number(), 60.0);
+
+        // Compiled variables do not leak into the thread globals.
+        CHECK(expr_get_global_var_value(STRING_CONST("$X")).is_null());
+
+        expr_compile_release(e, &vars);
+        CHECK_EQ(vars.head, nullptr);
+    }
 }
 
 #endif // BUILD_TESTS
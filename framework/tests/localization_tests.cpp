@@ -1,7 +1,7 @@
 /*
  * Copyright 2022-2023 - All rights reserved.
  * License: https://wiimag.com/LICENSE
- * 
+ *
  * Test the localization APIs
  */
 
@@ -10,8 +10,34 @@
 #if BUILD_TESTS
 
 #include "test_utils.h"
+#include "bench.h"
 
 #include <framework/localization.h>
+#include <framework/string_table.h>
+
+#include <foundation/fs.h>
+#include <foundation/path.h>
+#include <foundation/hash.h>
+
+struct localization_catalog_t;
+
+FOUNDATION_EXTERN bool localization_catalog_write(
+    const char* path, size_t path_length,
+    const char* lang, size_t lang_length, uint128_t source_md5,
+    const hash_t* keys, const string_const_t* values, uint32_t count);
+FOUNDATION_EXTERN localization_catalog_t* localization_catalog_open(const char* path, size_t path_length, const char* lang, size_t lang_length, uint128_t source_md5);
+FOUNDATION_EXTERN bool localization_catalog_lookup(const localization_catalog_t* catalog, hash_t key, string_const_t* out_value);
+FOUNDATION_EXTERN void localization_catalog_close(localization_catalog_t*& catalog);
+
+// A sample of the labels an application frame translates from table headers, menus and tooltips.
+static const char* LOCALIZATION_FRAME_LITERALS[] = {
+    "File", "Create", "Open", "Language", "EOD API Key", "Show logo banners", "Font scaling", "Frame Throttling",
+    "Title", "Name", "Price", "Day %", "Quantity", "Buy", "Sell", "Total", "Gain", "Gain %", "Dividends", "Yield",
+    "Currency", "Exchange", "Industry", "Sector", "Country", "Type", "Date", "Open", "Close", "High", "Low", "Volume",
+    "Market Cap", "PE", "EPS", "Beta", "Change", "Change %", "Average", "Ask", "Bid", "Short Ratio", "Description",
+    "Website", "Summary", "Report", "Wallet", "Funds", "History", "Settings", "Windows", "Help", "About", "Search",
+    "Symbols", "Patterns", "Notes", "Alerts", "Watches", "Expression", "Evaluate", "Refresh", "Delete", "Rename",
+};
 
 TEST_SUITE("Localization")
 {
@@ -19,6 +45,122 @@ TEST_SUITE("Localization")
     {
         // TODO: We need to add API to create a new localization DB on the fly.
     }
+
+    TEST_CASE("Compiled catalog")
+    {
+        constexpr uint32_t ENTRY_COUNT = 5000;
+
+        hash_t* keys = nullptr;
+        string_const_t* values = nullptr;
+        string_table_t* strings = string_table_allocate(ENTRY_COUNT * 32, 24);
+        for (uint32_t i = 0; i < ENTRY_COUNT; ++i)
+        {
+            char buffer[64];
+            string_t source = string_format(STRING_BUFFER(buffer), STRING_CONST("Source string %u"), i);
+            array_push(keys, string_hash(STRING_ARGS(source)));
+
+            string_t translated = string_format(STRING_BUFFER(buffer), STRING_CONST("Translated string %u"), i);
+            array_push(values, string_table_to_string_const(strings, string_table_to_symbol(strings, STRING_ARGS(translated))));
+        }
+
+        string_t catalog_path = path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN));
+        const uint128_t source_md5 = uint128_make(0x1234, 0x5678);
+        REQUIRE(localization_catalog_write(STRING_ARGS(catalog_path), STRING_CONST("fr"), source_md5, keys, values, ENTRY_COUNT));
+
+        // Catalogs compiled from another source or for another language are rejected.
+        localization_catalog_t* catalog = localization_catalog_open(STRING_ARGS(catalog_path), STRING_CONST("en"), source_md5);
+        CHECK_EQ(catalog, nullptr);
+        catalog = localization_catalog_open(STRING_ARGS(catalog_path), STRING_CONST("fr"), uint128_make(0x1234, 0x5679));
+        CHECK_EQ(catalog, nullptr);
+
+        catalog = localization_catalog_open(STRING_ARGS(catalog_path), STRING_CONST("fr"), source_md5);
+        REQUIRE_NE(catalog, nullptr);
+
+        for (uint32_t i = 0; i < ENTRY_COUNT; ++i)
+        {
+            string_const_t value;
+            REQUIRE(localization_catalog_lookup(catalog, keys[i], &value));
+            CHECK_EQ(value, values[i]);
+            CHECK_EQ(value.str[value.length], '\0');
+        }
+
+        string_const_t missing;
+        CHECK_FALSE(localization_catalog_lookup(catalog, string_hash(STRING_CONST("Not in the catalog")), &missing));
+
+        localization_catalog_close(catalog);
+        CHECK_EQ(catalog, nullptr);
+
+        fs_remove_file(STRING_ARGS(catalog_path));
+        string_table_deallocate(strings);
+        array_deallocate(values);
+        array_deallocate(keys);
+    }
+
+    TEST_CASE("Literals follow language changes")
+    {
+        char lang_buffer[8];
+        string_const_t current_lang = localization_current_language();
+        string_t lang = string_copy(STRING_BUFFER(lang_buffer), STRING_ARGS(current_lang));
+
+        localization_set_current_language(STRING_CONST("fr"));
+        CHECK_EQ(string_to_const(tr("File")), CTEXT("Fichier"));
+        CHECK_EQ(RTEXT("Language"), CTEXT("Langue"));
+
+        localization_set_current_language(STRING_CONST("en"));
+        CHECK_EQ(string_to_const(tr("File")), CTEXT("File"));
+        CHECK_EQ(RTEXT("Language"), CTEXT("Language"));
+
+        localization_set_current_language(STRING_ARGS(lang));
+    }
+
+    TEST_CASE("Benchmark frame" * doctest::test_suite(BENCH_TEST_SUITE))
+    {
+        constexpr int FRAME_COUNT = 2000;
+        constexpr int CALLS_PER_LITERAL = 6;
+        const size_t literal_count = ARRAY_COUNT(LOCALIZATION_FRAME_LITERALS);
+
+        size_t lengths[ARRAY_COUNT(LOCALIZATION_FRAME_LITERALS)];
+        for (size_t i = 0; i < literal_count; ++i)
+            lengths[i] = string_length(LOCALIZATION_FRAME_LITERALS[i]);
+
+        // Both paths must resolve to the same translations.
+        for (size_t i = 0; i < literal_count; ++i)
+        {
+            string_const_t cached = tr(LOCALIZATION_FRAME_LITERALS[i], lengths[i], true);
+            string_const_t looked_up = tr(LOCALIZATION_FRAME_LITERALS[i], lengths[i], false);
+            CHECK_EQ(cached, looked_up);
+        }
+
+        size_t total_length = 0;
+        tick_t start_time = time_current();
+        for (int f = 0; f < FRAME_COUNT; ++f)
+        {
+            for (int c = 0; c < CALLS_PER_LITERAL; ++c)
+            {
+                for (size_t i = 0; i < literal_count; ++i)
+                    total_length += tr(LOCALIZATION_FRAME_LITERALS[i], lengths[i], false).length;
+            }
+        }
+        const double lookup_elapsed_time = time_elapsed(start_time);
+
+        start_time = time_current();
+        for (int f = 0; f < FRAME_COUNT; ++f)
+        {
+            for (int c = 0; c < CALLS_PER_LITERAL; ++c)
+            {
+                for (size_t i = 0; i < literal_count; ++i)
+                    total_length -= tr(LOCALIZATION_FRAME_LITERALS[i], lengths[i], true).length;
+            }
+        }
+        const double cached_elapsed_time = time_elapsed(start_time);
+        CHECK_EQ(total_length, 0);
+
+        const size_t calls_per_frame = literal_count * CALLS_PER_LITERAL;
+        MESSAGE(string_format_static_const("%zu tr() calls per frame (%s): lookup %.3lf us/frame, literal cache %.3lf us/frame (%.1lfx)",
+            calls_per_frame, localization_current_language().str,
+            lookup_elapsed_time * 1e6 / FRAME_COUNT, cached_elapsed_time * 1e6 / FRAME_COUNT,
+            lookup_elapsed_time / max(cached_elapsed_time, 1e-9)));
+    }
 }
 
 #endif
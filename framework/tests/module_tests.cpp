@@ -0,0 +1,96 @@
+/*
+ * Copyright 2022-2023 - All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ *
+ * Module initialization schedule tests
+ */
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS
+
+#include "test_utils.h"
+
+#include <framework/module.h>
+
+#include <foundation/atomic.h>
+#include <foundation/thread.h>
+
+#include <doctest/doctest.h>
+
+static atomic32_t _module_test_counter{};
+static int32_t _module_test_orders[8]{};
+static uint64_t _module_test_thread_ids[8]{};
+
+FOUNDATION_STATIC void module_test_reset()
+{
+    atomic_store32(&_module_test_counter, 0, memory_order_release);
+    memset(_module_test_orders, 0, sizeof(_module_test_orders));
+    memset(_module_test_thread_ids, 0, sizeof(_module_test_thread_ids));
+}
+
+template<int Index>
+FOUNDATION_STATIC void module_test_initialize()
+{
+    // Give other modules a chance to run concurrently and reveal any ordering issue.
+    thread_sleep(5);
+    _module_test_thread_ids[Index] = thread_id();
+    _module_test_orders[Index] = atomic_incr32(&_module_test_counter, memory_order_acq_rel);
+}
+
+TEST_SUITE("Modules")
+{
+    TEST_CASE("Dependency order")
+    {
+        const module_test_t modules[] = {
+            { "MT_E", MODULE_PRIORITY_LOW,    MODULE_FLAGS_NONE,  nullptr, module_test_initialize<4> },
+            { "MT_C", MODULE_PRIORITY_MODULE, MODULE_FLAGS_NONE,  "MT_B",  module_test_initialize<2> },
+            { "MT_B", MODULE_PRIORITY_MODULE, MODULE_FLAGS_NONE,  "MT_A",  module_test_initialize<1> },
+            { "MT_D", MODULE_PRIORITY_MODULE, MODULE_MAIN_THREAD, "MT_A",  module_test_initialize<3> },
+            { "MT_A", MODULE_PRIORITY_BASE,   MODULE_FLAGS_NONE,  nullptr, module_test_initialize<0> },
+        };
+
+        for (const bool serial : { false, true })
+        {
+            CAPTURE(serial);
+            module_test_reset();
+
+            REQUIRE_EQ(module_initialize_test(modules, ARRAY_COUNT(modules), serial), ARRAY_COUNT(modules));
+
+            for (int i = 0; i < (int)ARRAY_COUNT(modules); ++i)
+                CHECK_GT(_module_test_orders[i], 0);
+
+            // MT_A < MT_B < MT_C, MT_A < MT_D and MT_E after all modules of lower priority.
+            CHECK_LT(_module_test_orders[0], _module_test_orders[1]);
+            CHECK_LT(_module_test_orders[1], _module_test_orders[2]);
+            CHECK_LT(_module_test_orders[0], _module_test_orders[3]);
+            CHECK_EQ(_module_test_orders[4], (int32_t)ARRAY_COUNT(modules));
+
+            CHECK_EQ(_module_test_thread_ids[3], thread_id());
+            if (serial)
+            {
+                for (int i = 0; i < (int)ARRAY_COUNT(modules); ++i)
+                    CHECK_EQ(_module_test_thread_ids[i], thread_id());
+            }
+        }
+    }
+
+    TEST_CASE("Dependency cycle")
+    {
+        const module_test_t modules[] = {
+            { "MT_X", MODULE_PRIORITY_MODULE, MODULE_FLAGS_NONE, "MT_Y", module_test_initialize<0> },
+            { "MT_Y", MODULE_PRIORITY_MODULE, MODULE_FLAGS_NONE, "MT_X", module_test_initialize<1> },
+            { "MT_Z", MODULE_PRIORITY_MODULE, MODULE_FLAGS_NONE, nullptr, module_test_initialize<2> },
+        };
+
+        module_test_reset();
+
+        // Modules of the cycle are never initialized, but the schedule does not hang and other modules still get initialized.
+        CHECK_EQ(module_initialize_test(modules, ARRAY_COUNT(modules), false), 1);
+        CHECK_EQ(_module_test_orders[0], 0);
+        CHECK_EQ(_module_test_orders[1], 0);
+        CHECK_EQ(_module_test_orders[2], 1);
+    }
+}
+
+#endif // BUILD_TESTS
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2022-2023 - All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ *
+ * Profiler trace recorder tests
+ */
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS && BUILD_ENABLE_PROFILE
+
+#include "test_utils.h"
+#include "bench.h"
+
+#include <framework/profiler.h>
+#include <framework/jobs.h>
+
+#include <foundation/fs.h>
+#include <foundation/path.h>
+
+constexpr int PROFILER_TEST_SCOPE_COUNT = 200000;
+
+FOUNDATION_STATIC int profiler_test_run_scopes()
+{
+    int sum = 0;
+    for (int i = 0; i < PROFILER_TEST_SCOPE_COUNT; ++i)
+    {
+        PERFORMANCE_TRACKER("profiler_test_scope");
+        sum += i & 1;
+    }
+    return sum;
+}
+
+TEST_SUITE("Profiler")
+{
+    TEST_CASE("Trace export")
+    {
+        profiler_trace_clear();
+        profiler_trace_enable(true);
+
+        job_t* job = nullptr;
+        {
+            PERFORMANCE_TRACKER("profiler_test_outer");
+            {
+                PERFORMANCE_TRACKER("profiler_test_inner");
+            }
+
+            job = job_execute([](payload_t* payload)
+            {
+                PERFORMANCE_TRACKER("profiler_test_job");
+                return 0;
+            });
+        }
+
+        while (!job_completed(job))
+            thread_yield();
+        job_deallocate(job);
+
+        profiler_trace_enable(false);
+
+        string_t trace_path = path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN));
+        REQUIRE(profiler_trace_export(STRING_ARGS(trace_path)));
+
+        config_handle_t trace = config_parse_file(STRING_ARGS(trace_path));
+        REQUIRE(trace);
+
+        int scope_count = 0, flow_start_count = 0, flow_end_count = 0, thread_count = 0;
+        double outer_start = 0, outer_duration = 0, inner_start = 0, inner_duration = 0;
+        for (auto e : trace["traceEvents"])
+        {
+            string_const_t phase = e["ph"].as_string();
+            string_const_t name = e["name"].as_string();
+            if (string_equal(STRING_ARGS(phase), STRING_CONST("M")))
+            {
+                thread_count++;
+            }
+            else if (string_equal(STRING_ARGS(phase), STRING_CONST("X")))
+            {
+                if (string_equal(STRING_ARGS(name), STRING_CONST("profiler_test_outer")))
+                {
+                    outer_start = e["ts"].as_number();
+                    outer_duration = e["dur"].as_number();
+                    scope_count++;
+                }
+                else if (string_equal(STRING_ARGS(name), STRING_CONST("profiler_test_inner")))
+                {
+                    inner_start = e["ts"].as_number();
+                    inner_duration = e["dur"].as_number();
+                    scope_count++;
+                }
+                else if (string_equal(STRING_ARGS(name), STRING_CONST("profiler_test_job")))
+                {
+                    scope_count++;
+                }
+            }
+            else if (string_equal(STRING_ARGS(name), STRING_CONST("job")))
+            {
+                if (string_equal(STRING_ARGS(phase), STRING_CONST("s")))
+                    flow_start_count++;
+                else if (string_equal(STRING_ARGS(phase), STRING_CONST("f")))
+                    flow_end_count++;
+            }
+        }
+
+        // The job runs on another thread and its completion is linked to its submission.
+        CHECK_GE(thread_count, 2);
+        CHECK_EQ(scope_count, 3);
+        CHECK_GE(flow_start_count, 1);
+        CHECK_EQ(flow_start_count, flow_end_count);
+
+        // Nested scopes are enclosed by their parent.
+        CHECK_GE(inner_start, outer_start);
+        CHECK_LE(inner_start + inner_duration, outer_start + outer_duration);
+
+        config_deallocate(trace);
+        fs_remove_file(STRING_ARGS(trace_path));
+        profiler_trace_clear();
+    }
+
+    TEST_CASE("Benchmark overhead" * doctest::test_suite(BENCH_TEST_SUITE))
+    {
+        profiler_trace_enable(false);
+        tick_t start_time = time_current();
+        int sum = profiler_test_run_scopes();
+        const double disabled_elapsed_time = time_elapsed(start_time);
+
+        profiler_trace_clear();
+        profiler_trace_enable(true);
+        start_time = time_current();
+        sum -= profiler_test_run_scopes();
+        const double enabled_elapsed_time = time_elapsed(start_time);
+        profiler_trace_enable(false);
+        profiler_trace_clear();
+
+        CHECK_EQ(sum, 0);
+        MESSAGE(string_format_static_const("%d scopes, tracing disabled %.1lf ns/scope, tracing enabled %.1lf ns/scope",
+            PROFILER_TEST_SCOPE_COUNT,
+            disabled_elapsed_time * 1e9 / PROFILER_TEST_SCOPE_COUNT,
+            enabled_elapsed_time * 1e9 / PROFILER_TEST_SCOPE_COUNT));
+    }
+}
+
+#endif
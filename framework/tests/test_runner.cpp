@@ -346,6 +346,6 @@ FOUNDATION_STATIC void test_runner_shutdown()
 }
 
 REGISTER_REPORTER("test_runner", 2, TestRunnerReporter);
-DEFINE_MODULE(TEST_RUNNER, test_runner_initialize, test_runner_shutdown, MODULE_PRIORITY_TESTS);
+DEFINE_MODULE(TEST_RUNNER, test_runner_initialize, test_runner_shutdown, MODULE_PRIORITY_TESTS, MODULE_MAIN_THREAD);
 
 #endif
\ No newline at end of file
@@ -129,6 +129,6 @@ FOUNDATION_STATIC void test_utils_shutdown()
     TEST_CLEAR_FRAME();
 }
 
-DEFINE_MODULE(TEST, test_utils_initialize, test_utils_shutdown, MODULE_PRIORITY_TESTS-1);
+DEFINE_MODULE(TEST, test_utils_initialize, test_utils_shutdown, MODULE_PRIORITY_TESTS-1, MODULE_MAIN_THREAD);
 
 #endif
@@ -6,6 +6,8 @@
 #include "alerts.h"
 
 #include "logo.h"
+#include "stock.h"
+#include "report.h"
 #include "pattern.h"
 
 #include <framework/app.h>
@@ -19,11 +21,47 @@
 #include <framework/localization.h>
 #include <framework/system.h>
 #include <framework/dispatcher.h>
+#include <framework/jobs.h>
+#include <framework/shared_mutex.h>
+
+#include <foundation/atomic.h>
 
 #define HASH_ALERTS static_hash_string("alerts", 5, 0x3a6761b0fb57262bULL)
 
 constexpr const char* SHOW_ALERTS_KEY = "show_alerts";
 
+/*! Stock data read by an alert expression. */
+struct alert_dependency_t
+{
+    hash_t        stock_id;
+    fetch_level_t levels;
+};
+
+/*! Alert expression compiled once and evaluated on the job pool when the stock data it reads changes. 
+ *  Expressions calling functions that are not thread safe are evaluated on the main thread instead.
+ */
+struct alert_program_t
+{
+    uint32_t            id{ 0 };
+    char                title[32]{ '\0' };
+    char                description[64]{ '\0' };
+    string_t            source{};
+    expr_t*             expr{ nullptr };
+    expr_var_list_t     vars{ nullptr };
+
+    alert_dependency_t* dependencies{ nullptr };
+    bool                periodic{ false }; // Some inputs are unknown, so the expression is also evaluated at the alert frequency
+    bool                main_thread{ false };
+
+    atomic32_t          dirty{};
+    atomic32_t          running{};
+    atomic32_t          cancelled{};
+    atomic32_t          references{};      // Jobs evaluating the program
+    atomic32_t          triggered{};
+    atomic64_t          changed_tick{};    // Oldest change not evaluated yet, or 0
+    atomic64_t          last_run_time{};
+};
+
 /*! Expression evaluator. */
 struct expr_evaluator_t
 {
@@ -36,6 +74,8 @@ struct expr_evaluator_t
     time_t last_run_time{ 0 };
     time_t triggered_time{ 0 };
     bool discarded{ false };
+
+    alert_program_t* program{ nullptr };
 };
 
 static struct ALERTS_MODULE {
@@ -44,10 +84,13 @@ static struct ALERTS_MODULE {
     bool                show_window{ false };
     bool                new_notifications{ false };
 
-    tick_t              last_evaluation{ 0 };
+    tick_t              startup_time{ 0 };
     bool                evaluation_disabled{ false };
 
-    unsigned            async_index{ 0 };
+    shared_mutex        programs_lock;
+    alert_program_t**   programs{ nullptr }; // Programs listening to stock changes
+    alert_program_t**   retired_programs{ nullptr }; // Deleted programs still referenced by a job
+    uint32_t            program_id{ 0 };
 } *_alerts_module;
 
 FOUNDATION_STATIC string_const_t alerts_config_file_path()
@@ -159,56 +202,338 @@ FOUNDATION_STATIC void alerts_push_notification(expr_evaluator_t& e)
         description.length--;
     }
 
-    system_notification_push(STRING_ARGS(title), STRING_ARGS(description));
+    if (!main_is_running_tests())
+        system_notification_push(STRING_ARGS(title), STRING_ARGS(description));
 }
 
-FOUNDATION_STATIC void alerts_run_evaluators()
+FOUNDATION_STATIC expr_evaluator_t* alerts_find_evaluator(uint32_t program_id)
 {
-    // Skip evaluation if last evaluation occurred less than 5 seconds ago
-    if (_alerts_module->evaluation_disabled || time_elapsed(_alerts_module->last_evaluation) < 5)
+    foreach(e, _alerts_module->evaluators)
+    {
+        if (e->program && e->program->id == program_id)
+            return e;
+    }
+
+    return nullptr;
+}
+
+FOUNDATION_STATIC void alerts_program_triggered(uint32_t program_id, tick_t changed_tick)
+{
+    if (_alerts_module == nullptr)
         return;
 
-    expr_evaluator_t* evaluators = _alerts_module->evaluators;
-    for (;_alerts_module->async_index < array_size(evaluators);)
-    {
-        expr_evaluator_t& e = evaluators[_alerts_module->async_index++];
+    // The alert might have been deleted or edited since the job evaluated it.
+    expr_evaluator_t* e = alerts_find_evaluator(program_id);
+    if (e == nullptr || e->triggered_time || e->discarded)
+        return;
 
-        // Check if expression has already triggered
-        if (e.triggered_time || e.discarded)
+    if (changed_tick)
+        log_debugf(HASH_ALERTS, STRING_CONST("Alert triggered %.3lf ms after its inputs changed"), time_elapsed(changed_tick) * 1000.0);
+    alerts_push_notification(*e);
+}
+
+FOUNDATION_STATIC tick_t alerts_program_take_changed_tick(alert_program_t* program)
+{
+    int64_t changed_tick = atomic_load64(&program->changed_tick, memory_order_relaxed);
+    while (!atomic_cas64(&program->changed_tick, 0, changed_tick, memory_order_relaxed, memory_order_relaxed))
+        changed_tick = atomic_load64(&program->changed_tick, memory_order_relaxed);
+    return (tick_t)changed_tick;
+}
+
+/*! Evaluate the program until it is no longer dirty. */
+FOUNDATION_STATIC void alerts_program_evaluate(alert_program_t* program)
+{
+    while (atomic_cas32(&program->dirty, 0, 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        const tick_t changed_tick = alerts_program_take_changed_tick(program);
+        if (atomic_load32(&program->triggered, memory_order_relaxed) || atomic_load32(&program->cancelled, memory_order_relaxed))
             continue;
 
-        // Check if the expression is due to be evaluated
-        if ((time_now() - e.last_run_time) < e.frequency)
+        atomic_store64(&program->last_run_time, (int64_t)time_now(), memory_order_relaxed);
+        expr_result_t result = expr_eval_compiled(program->expr, &program->vars, string_to_const(program->source));
+        if (!alerts_check_expression_condition_result(result))
             continue;
 
-        // Mark the expression has being evaluated
-        e.last_run_time = time_now();
-            
-        // Check if the expression is valid
-        const size_t expression_length = string_length(e.expression);
-        if (expression_length == 0)
+        // Notifications are pushed on the main thread where the evaluators live.
+        const uint32_t program_id = program->id;
+        atomic_store32(&program->triggered, 1, memory_order_relaxed);
+        dispatch([program_id, changed_tick]() { alerts_program_triggered(program_id, changed_tick); });
+    }
+}
+
+/*! Evaluate the program until no new change is published while evaluating. 
+ *  Only one job at a time evaluates a given program. 
+ */
+FOUNDATION_STATIC int alerts_program_evaluate_job(payload_t* payload)
+{
+    alert_program_t* program = (alert_program_t*)payload;
+
+    do
+    {
+        alerts_program_evaluate(program);
+        atomic_store32(&program->running, 0, memory_order_seq_cst);
+    } while (atomic_load32(&program->dirty, memory_order_seq_cst) && 
+             atomic_cas32(&program->running, 1, 0, memory_order_seq_cst, memory_order_relaxed));
+
+    // The program can be released by the main thread once the job no longer references it.
+    atomic_decr32(&program->references, memory_order_release);
+    return 0;
+}
+
+/*! Mark the program dirty and start a job evaluating it unless one is already running. Can be called from any thread. 
+ *  Programs that must run on the main thread are evaluated by the next module update.
+ */
+FOUNDATION_STATIC void alerts_program_schedule(alert_program_t* program, tick_t changed_tick)
+{
+    // Keep the oldest change to know how long it took to fire the alert.
+    atomic_cas64(&program->changed_tick, (int64_t)changed_tick, 0, memory_order_relaxed, memory_order_relaxed);
+    atomic_store32(&program->dirty, 1, memory_order_seq_cst);
+    if (program->main_thread)
+        return;
+
+    if (atomic_cas32(&program->running, 1, 0, memory_order_seq_cst, memory_order_relaxed))
+    {
+        atomic_incr32(&program->references, memory_order_relaxed);
+        job_execute(alerts_program_evaluate_job, program, JOB_DEALLOCATE_AFTER_EXECUTION);
+    }
+}
+
+FOUNDATION_STATIC void alerts_stock_changed(hash_t stock_id, fetch_level_t changed_levels, void* context)
+{
+    FOUNDATION_UNUSED(context);
+
+    const tick_t changed_tick = time_current();
+    SHARED_READ_LOCK(_alerts_module->programs_lock);
+    foreach(p, _alerts_module->programs)
+    {
+        alert_program_t* program = *p;
+        if (atomic_load32(&program->triggered, memory_order_relaxed))
             continue;
 
-        // Set the alert variables (i.e. $TITLE, $DESCRIPTION, etc.)
-        expr_set_global_var(STRING_CONST("$TITLE"), e.title, string_length(e.title));
-        expr_set_global_var(STRING_CONST("$DESCRIPTION"), e.description, string_length(e.description));
+        foreach(dep, program->dependencies)
+        {
+            if (dep->stock_id == stock_id && any(dep->levels, changed_levels))
+            {
+                alerts_program_schedule(program, changed_tick);
+                break;
+            }
+        }
+    }
+}
+
+FOUNDATION_STATIC void alerts_program_add_dependency(alert_program_t* program, string_const_t symbol, fetch_level_t levels)
+{
+    const hash_t stock_id = hash(STRING_ARGS(symbol));
+    foreach(d, program->dependencies)
+    {
+        if (d->stock_id == stock_id)
+        {
+            d->levels |= levels;
+            return;
+        }
+    }
+
+    alert_dependency_t dep{ stock_id, levels };
+    array_push_memcpy(program->dependencies, &dep);
+}
+
+/*! Collect the stocks and data levels read by S(...) and F(...) calls. 
+ *  The program is marked periodic if a call reads a stock or a field only known when evaluating.
+ */
+FOUNDATION_STATIC void alerts_program_collect_dependencies(alert_program_t* program, expr_t* e)
+{
+    if (e->type == OP_CONST || e->type == OP_VAR)
+        return;
+
+    if (e->type == OP_FUNC)
+    {
+        string_const_t fn_name = e->param.func.f->name;
+        const bool stock_call = 
+            string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("S")) || 
+            string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("STOCK")) || 
+            string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("EOD"));
+        const bool fundamental_call = 
+            string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("F")) || 
+            string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("FUNDAMENTALS"));
+
+        if (stock_call || fundamental_call)
+        {
+            fetch_level_t levels = FetchLevel::NONE;
+            const expr_t* symbol_arg = e->args.len >= 2 ? &e->args.buf[0] : nullptr;
+            const expr_t* field_arg = e->args.len >= 2 ? &e->args.buf[1] : nullptr;
+            if (symbol_arg && (symbol_arg->type == OP_CONST || symbol_arg->type == OP_VAR))
+            {
+                if (fundamental_call)
+                {
+                    levels = FetchLevel::FUNDAMENTALS;
+                }
+                else if (e->args.len > 2)
+                {
+                    levels = FetchLevel::REALTIME | FetchLevel::EOD;
+                }
+                else if (field_arg->type == OP_CONST || field_arg->type == OP_VAR)
+                {
+                    string_const_t field_name = expr_eval((expr_t*)field_arg).as_string();
+                    const int field_index = report_field_find(STRING_ARGS(field_name), true);
+                    if (field_index >= 0)
+                        levels = report_field_fetch_level(field_index);
+                }
+            }
+
+            string_const_t symbol = levels != FetchLevel::NONE ? expr_eval((expr_t*)symbol_arg).as_string() : string_const_t{};
+            if (symbol.length > 0)
+                alerts_program_add_dependency(program, symbol, levels);
+            else
+                program->periodic = true;
+        }
+    }
+
+    for (int i = 0; i < e->args.len; ++i)
+        alerts_program_collect_dependencies(program, &e->args.buf[i]);
+}
 
-        log_debugf(HASH_ALERTS, STRING_CONST("Evaluating expression: %s"), e.expression);
+/*! Compile the alert expression and start listening to the changes of the stocks it reads. Must be called on the main thread. */
+FOUNDATION_STATIC alert_program_t* alerts_program_compile(const expr_evaluator_t& e)
+{
+    alert_program_t* program = MEM_NEW(HASH_ALERTS, alert_program_t);
+    program->id = ++_alerts_module->program_id;
+    string_copy(STRING_BUFFER(program->title), e.title, string_length(e.title));
+    string_copy(STRING_BUFFER(program->description), e.description, string_length(e.description));
+    program->source = string_clone(e.expression, string_length(e.expression));
+    program->expr = expr_compile(STRING_ARGS(program->source), &program->vars);
+    if (program->expr == nullptr)
+    {
+        log_warnf(HASH_ALERTS, WARNING_INVALID_VALUE, STRING_CONST("Failed to compile alert expression: %s"), e.expression);
+        return program;
+    }
 
-        // Evaluate the expression
-        string_const_t expression = string_const(e.expression, expression_length);
-        expr_result_t result = eval(expression);
+    // Bind the alert variables (i.e. $TITLE, $DESCRIPTION, etc.) and the application global variables as they are now.
+    for (expr_var_t* v = program->vars.head; v; v = v->next)
+    {
+        if (string_equal(STRING_ARGS(v->name), STRING_CONST("$TITLE")))
+        {
+            v->value = expr_result_t(string_const(program->title, string_length(program->title)));
+        }
+        else if (string_equal(STRING_ARGS(v->name), STRING_CONST("$DESCRIPTION")))
+        {
+            v->value = expr_result_t(string_const(program->description, string_length(program->description)));
+        }
+        else
+        {
+            const expr_result_t global_value = expr_get_global_var_value(STRING_ARGS(v->name));
+            if (!global_value.is_null() && global_value.type != EXPR_RESULT_ARRAY)
+                v->value = global_value;
+        }
+    }
 
-        if (alerts_check_expression_condition_result(result))
-            alerts_push_notification(e);
+    alerts_program_collect_dependencies(program, program->expr);
+    if (array_size(program->dependencies) == 0)
+        program->periodic = true;
+    program->main_thread = !report_expression_thread_safe(program->expr);
 
-        // Evaluate one expression per frame
-        _alerts_module->last_evaluation = time_current();
-        break;
+    {
+        SHARED_WRITE_LOCK(_alerts_module->programs_lock);
+        array_push(_alerts_module->programs, program);
     }
 
-    if (_alerts_module->async_index >= array_size(evaluators))
-        _alerts_module->async_index = 0;
+    // Evaluate the alert once with the data already available.
+    alerts_program_schedule(program, 0);
+    return program;
+}
+
+FOUNDATION_STATIC void alerts_program_free(alert_program_t* program)
+{
+    expr_compile_release(program->expr, &program->vars);
+    array_deallocate(program->dependencies);
+    string_deallocate(program->source.str);
+    MEM_DELETE(program);
+}
+
+FOUNDATION_STATIC void alerts_program_deallocate(alert_program_t*& program)
+{
+    if (program == nullptr)
+        return;
+
+    {
+        SHARED_WRITE_LOCK(_alerts_module->programs_lock);
+        for (unsigned i = 0, end = array_size(_alerts_module->programs); i < end; ++i)
+        {
+            if (_alerts_module->programs[i] == program)
+            {
+                array_erase_memcpy(_alerts_module->programs, i);
+                break;
+            }
+        }
+    }
+
+    // Changes can no longer schedule the program, the job in progress releases it when done.
+    atomic_store32(&program->cancelled, 1, memory_order_relaxed);
+    if (atomic_load32(&program->references, memory_order_acquire) == 0)
+        alerts_program_free(program);
+    else
+        array_push(_alerts_module->retired_programs, program);
+    program = nullptr;
+}
+
+/*! Release the deleted programs that are no longer referenced by a job. */
+FOUNDATION_STATIC void alerts_programs_collect()
+{
+    for (unsigned i = array_size(_alerts_module->retired_programs); i > 0; --i)
+    {
+        alert_program_t* program = _alerts_module->retired_programs[i - 1];
+        if (atomic_load32(&program->references, memory_order_acquire) != 0)
+            continue;
+
+        alerts_program_free(program);
+        array_erase_memcpy(_alerts_module->retired_programs, i - 1);
+    }
+}
+
+FOUNDATION_STATIC void alerts_evaluator_delete(unsigned index)
+{
+    alerts_program_deallocate(_alerts_module->evaluators[index].program);
+    array_erase_ordered(_alerts_module->evaluators, index);
+}
+
+/*! Compile new alerts and schedule the evaluation of periodic alerts. 
+ *  Other alerts are evaluated on the job pool as soon as the stock data they read changes.
+ */
+FOUNDATION_STATIC void alerts_run_evaluators()
+{
+    if (array_size(_alerts_module->retired_programs) > 0)
+        alerts_programs_collect();
+
+    // Let the application start before compiling the alerts.
+    if (_alerts_module->evaluation_disabled || time_elapsed(_alerts_module->startup_time) < 5)
+        return;
+
+    const time_t now = time_now();
+    foreach(e, _alerts_module->evaluators)
+    {
+        // Check if expression has already triggered
+        if (e->triggered_time || e->discarded || e->expression[0] == 0)
+            continue;
+
+        if (e->program == nullptr)
+        {
+            e->last_run_time = now;
+            e->program = alerts_program_compile(*e);
+            continue;
+        }
+
+        alert_program_t* program = e->program;
+        if (program->main_thread && atomic_load32(&program->dirty, memory_order_relaxed))
+            alerts_program_evaluate(program);
+
+        e->last_run_time = max(e->last_run_time, (time_t)atomic_load64(&program->last_run_time, memory_order_relaxed));
+
+        // Check if the expression is due to be evaluated
+        if (!program->periodic || program->expr == nullptr || (now - e->last_run_time) < e->frequency)
+            continue;
+
+        e->last_run_time = now;
+        alerts_program_schedule(program, 0);
+    }
 }
 
 FOUNDATION_STATIC void alerts_render_table(expr_evaluator_t*& evaluators)
@@ -406,6 +731,7 @@ FOUNDATION_STATIC void alerts_render_table(expr_evaluator_t*& evaluators)
                     ev.discarded = false;
                     ev.triggered_time = 0;
                     ev.frequency = max(0.0, ev.frequency);
+                    alerts_program_deallocate(ev.program);
                 }
             }
 
@@ -415,7 +741,7 @@ FOUNDATION_STATIC void alerts_render_table(expr_evaluator_t*& evaluators)
                 ImGui::PushStyleColor(ImGuiCol_Button, BACKGROUND_CRITITAL_COLOR);
                 if (ImGui::Button(ICON_MD_DELETE_FOREVER))
                 {
-                    array_erase_ordered(evaluators, i);
+                    alerts_evaluator_delete(i);
                     i--;
                     evaluate_expression = false;
                 }
@@ -432,6 +758,7 @@ FOUNDATION_STATIC void alerts_render_table(expr_evaluator_t*& evaluators)
                 ev.last_run_time = 0;
                 ev.triggered_time = 0;
                 ev.discarded = false;
+                alerts_program_deallocate(ev.program);
             }
 
             ImGui::PopID();
@@ -519,7 +846,7 @@ bool alerts_add_price_change(const char* title, size_t title_length, double pric
     int found_index = alerts_index_of_expression_starts_with(STRING_ARGS(expression_prefix));
     if (found_index >= 0)
     {
-        array_erase_ordered(_alerts_module->evaluators, found_index);
+        alerts_evaluator_delete(found_index);
     }
 
     // Generate the expression to evaluate
@@ -530,12 +857,41 @@ bool alerts_add_price_change(const char* title, size_t title_length, double pric
     new_alert.triggered_time = 0.0;
     new_alert.discarded = false;
     new_alert.creation_date = time_now();
+    if (!_alerts_module->evaluation_disabled)
+        new_alert.program = alerts_program_compile(new_alert);
 
     array_insert_memcpy_safe(_alerts_module->evaluators, 0, &new_alert);
 
     return true;
 }
 
+bool alerts_is_triggered(const char* title, size_t title_length)
+{
+    foreach(e, _alerts_module->evaluators)
+    {
+        if (e->triggered_time && !e->discarded && string_equal(e->title, string_length(e->title), title, title_length))
+            return true;
+    }
+
+    return false;
+}
+
+unsigned alerts_delete(const char* title, size_t title_length)
+{
+    unsigned deleted_count = 0;
+    for (unsigned i = array_size(_alerts_module->evaluators); i > 0; --i)
+    {
+        const expr_evaluator_t& e = _alerts_module->evaluators[i - 1];
+        if (!string_equal(e.title, string_length(e.title), title, title_length))
+            continue;
+
+        alerts_evaluator_delete(i - 1);
+        deleted_count++;
+    }
+
+    return deleted_count;
+}
+
 bool alerts_add_price_increase(const char* title, size_t title_length, double price)
 {
     return alerts_add_price_change(title, title_length, price, ICON_MD_TRENDING_UP, ">=");
@@ -632,7 +988,7 @@ void alerts_notification_menu()
             ImGui::AlignTextToFramePadding();
             if (ImGui::SmallButton(ICON_MD_DELETE))
             {
-                array_erase_ordered_safe(_alerts_module->evaluators, i);
+                alerts_evaluator_delete(i);
                 break;
             }
 
@@ -672,8 +1028,10 @@ FOUNDATION_STATIC void alerts_initialize()
 
     _alerts_module = MEM_NEW(HASH_ALERTS, ALERTS_MODULE);
     _alerts_module->show_window = session_get_bool(SHOW_ALERTS_KEY, false);
-    _alerts_module->last_evaluation = time_current();
+    _alerts_module->startup_time = time_current();
     _alerts_module->evaluation_disabled = environment_argument("disable-alerts");
+    if (!_alerts_module->evaluation_disabled)
+        stock_register_change_listener(alerts_stock_changed, nullptr);
 
     if (!main_is_interactive_mode())
         return;
@@ -701,6 +1059,16 @@ FOUNDATION_STATIC void alerts_shutdown()
         session_set_bool(SHOW_ALERTS_KEY, _alerts_module->show_window);
     }
 
+    stock_unregister_change_listener(alerts_stock_changed, nullptr);
+    foreach(e, _alerts_module->evaluators)
+        alerts_program_deallocate(e->program);
+    array_deallocate(_alerts_module->programs);
+
+    // Jobs are shut down already, so programs they did not get to evaluate can be released.
+    foreach(p, _alerts_module->retired_programs)
+        alerts_program_free(*p);
+    array_deallocate(_alerts_module->retired_programs);
+
     array_deallocate(_alerts_module->evaluators);
     MEM_DELETE(_alerts_module);
 }
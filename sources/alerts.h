@@ -35,3 +35,21 @@ bool alerts_add_price_increase(const char* title, size_t title_length, double pr
  *  @return True if the alert was added successfully, false otherwise.
  */
 bool alerts_add_price_decrease(const char* title, size_t title_length, double price);
+
+/*! Checks if an alert of the specified title was triggered and not discarded yet.
+ * 
+ *  @param title The title of the alert.
+ *  @param title_length The length of the title string.
+ * 
+ *  @return True if an alert of the title is triggered, false otherwise.
+ */
+bool alerts_is_triggered(const char* title, size_t title_length);
+
+/*! Delete all the alerts of the specified title.
+ * 
+ *  @param title The title of the alerts.
+ *  @param title_length The length of the title string.
+ * 
+ *  @return The number of alerts deleted.
+ */
+unsigned alerts_delete(const char* title, size_t title_length);
@@ -22,6 +22,7 @@
 #include <framework/dispatcher.h>
 #include <framework/localization.h>
 #include <framework/about.h>
+#include <framework/epoch.h>
 
 #include <foundation/version.h>
 #include <foundation/process.h>
@@ -171,6 +172,7 @@ extern void app_shutdown()
     // App systems
     module_shutdown();
     settings_shutdown();
+    epoch_shutdown();
     
     // Framework systems
     tabs_shutdown();
@@ -635,4 +635,4 @@ FOUNDATION_STATIC void eod_shutdown()
     MEM_DELETE(EOD);
 }
 
-DEFINE_MODULE(EOD, eod_initialize, eod_shutdown, MODULE_PRIORITY_BASE);
+DEFINE_MODULE(EOD, eod_initialize, eod_shutdown, MODULE_PRIORITY_BASE, MODULE_MAIN_THREAD);
@@ -18,17 +18,30 @@
 #include <framework/profiler.h>
 #include <framework/array.h>
 #include <framework/window.h>
+#include <framework/expr.h>
+#include <framework/scoped_mutex.h>
+#include <framework/system.h>
+
+#include <foundation/fs.h>
+#include <foundation/stream.h>
+#include <foundation/mutex.h>
 
 #define HASH_FINANCIALS static_hash_string("financials", 10, 0x3b2f926a5f4bff66ULL)
 
+/*! Financial statement field descriptor.
+ *  The field index in its statement table is the column index in the statement store.
+ */
 template<typename T>
-FOUNDATION_FORCEINLINE ImPlotPoint financial_field_plot(int idx, void* user_data, size_t field_offset)
+struct financial_field_t
 {
-    const auto* r = ((T*)user_data) + idx;
-    const double x = (double)r->date;
-    const double y = *(double*)(((const uint8_t*)r) + field_offset);
-    return ImPlotPoint(x, y);
-}
+    T code;
+    string_const_t name;
+    string_const_t key; // Fundamentals JSON field name
+    
+    bool selected{ false };
+};
+
+#define FIELD_KEY(FIELD) CTEXT(#FIELD)
 
 //
 // Balance Sheet
@@ -100,151 +113,69 @@ typedef enum class FinancialBalance : uint64_t
     commonStockSharesOutstanding = 1ULL << 60ULL,
 } financial_balance_value_t;
 
-struct financial_balance_sheet_t
-{
-    time_t date;
-    double totalAssets;
-    double intangibleAssets;
-    double earningAssets;
-    double otherCurrentAssets;
-    double totalLiab;
-    double totalStockholderEquity;
-    double deferredLongTermLiab; //" : null,
-    double otherCurrentLiab;
-    double commonStock;
-    double capitalStock;
-    double retainedEarnings;
-    double otherLiab; //" : null,
-    double goodWill;
-    double otherAssets;
-    double cash;
-    double cashAndEquivalents;
-    double totalCurrentLiabilities;
-    double currentDeferredRevenue; //" : null,
-    double netDebt;
-    double shortTermDebt;
-    double shortLongTermDebt;
-    double shortLongTermDebtTotal; //" : null,
-    double otherStockholderEquity;
-    double propertyPlantEquipment;
-    double totalCurrentAssets;
-    double longTermInvestments;
-    double netTangibleAssets; //" : null,
-    double shortTermInvestments;
-    double netReceivables;
-    double longTermDebt;
-    double inventory;
-    double accountsPayable;
-    double totalPermanentEquity; //" : null,
-    double noncontrollingInterestInConsolidatedEntity; //" : null,
-    double temporaryEquityRedeemableNoncontrollingInterests; //" : null,
-    double accumulatedOtherComprehensiveIncome; //" : null,
-    double additionalPaidInCapital; //"" : null,
-    double commonStockTotalEquity; //"" : null,
-    double preferredStockTotalEquity; //"" : null,
-    double retainedEarningsTotalEquity; //"" : null,
-    double treasuryStock; //"" : null,
-    double accumulatedAmortization; //"" : null,
-    double nonCurrrentAssetsOther;
-    double deferredLongTermAssetCharges; //"" : null,
-    double nonCurrentAssetsTotal;
-    double capitalLeaseObligations;
-    double longTermDebtTotal;
-    double nonCurrentLiabilitiesOther;
-    double nonCurrentLiabilitiesTotal;
-    double negativeGoodwill; //"" : null,
-    double warrants; //"" : null,
-    double preferredStockRedeemable; //"" : null,
-    double capitalSurpluse;
-    double liabilitiesAndStockholdersEquity;
-    double cashAndShortTermInvestments;
-    double propertyPlantAndEquipmentGross; //"" : null,
-    double propertyPlantAndEquipmentNet; //"" : null,
-    double accumulatedDepreciation; //"" : null,
-    double netWorkingCapital;
-    double netInvestedCapital;
-    double commonStockSharesOutstanding;
-};
-
-#undef FIELD_PLOT
-#define FIELD_PLOT(FIELD) \
-    offsetof(financial_balance_sheet_t, FIELD),  \
-    [](int idx, void* user_data)->ImPlotPoint \
-    { \
-        return financial_field_plot<financial_balance_sheet_t>(idx, user_data, offsetof(financial_balance_sheet_t, FIELD)); \
-    } \
-    
-struct {
-    financial_balance_value_t code;
-    string_const_t name;
-    size_t field_offset{ 0 };
-    ImPlotGetter plot_fn{ nullptr };
-    
-    bool selected{ false };
-
-} BALANCE_FIELDS[] = {
-
-    { FinancialBalance::totalAssets, CTEXT("Total Assets"), FIELD_PLOT(totalAssets), true },
-    { FinancialBalance::cash, CTEXT("Cash"), FIELD_PLOT(cash), true },
-    { FinancialBalance::accountsPayable, CTEXT("Accounts Payable"), FIELD_PLOT(accountsPayable) },
-    { FinancialBalance::accumulatedAmortization, CTEXT("Accumulated Amortization"), FIELD_PLOT(accumulatedAmortization) },
-    { FinancialBalance::accumulatedDepreciation, CTEXT("Accumulated Depreciation"), FIELD_PLOT(accumulatedDepreciation) },
-    { FinancialBalance::accumulatedOtherComprehensiveIncome, CTEXT("Accumulated Other Comprehensive Income"), FIELD_PLOT(accumulatedOtherComprehensiveIncome) },
-    { FinancialBalance::additionalPaidInCapital, CTEXT("Additional Paid In Capital"), FIELD_PLOT(additionalPaidInCapital) },
-    { FinancialBalance::capitalLeaseObligations, CTEXT("Capital Lease Obligations"), FIELD_PLOT(capitalLeaseObligations) },
-    { FinancialBalance::capitalStock, CTEXT("Capital Stock"), FIELD_PLOT(capitalStock) },
-    { FinancialBalance::capitalSurpluse, CTEXT("Capital Surpluse"), FIELD_PLOT(capitalSurpluse) },
-    { FinancialBalance::cashAndEquivalents, CTEXT("Cash and Equivalents"), FIELD_PLOT(cashAndEquivalents) },
-    { FinancialBalance::cashAndShortTermInvestments, CTEXT("Cash And Short Term Investments"), FIELD_PLOT(cashAndShortTermInvestments) },
-    { FinancialBalance::commonStock, CTEXT("Common Stock"), FIELD_PLOT(commonStock) },
-    { FinancialBalance::commonStockSharesOutstanding, CTEXT("Common Stock Shares Outstanding"), FIELD_PLOT(commonStockSharesOutstanding) },
-    { FinancialBalance::commonStockTotalEquity, CTEXT("Common Stock Total Equity"), FIELD_PLOT(commonStockTotalEquity) },
-    { FinancialBalance::currentDeferredRevenue, CTEXT("Current Deferred Revenue"), FIELD_PLOT(currentDeferredRevenue) },
-    { FinancialBalance::deferredLongTermAssetCharges, CTEXT("Deferred Long Term Asset Charges"), FIELD_PLOT(deferredLongTermAssetCharges) },
-    { FinancialBalance::deferredLongTermLiab, CTEXT("Deferred Long Term Liabilities"), FIELD_PLOT(deferredLongTermLiab) },
-    { FinancialBalance::earningAssets, CTEXT("Earning Assets"), FIELD_PLOT(earningAssets) },
-    { FinancialBalance::goodWill, CTEXT("Good Will"), FIELD_PLOT(goodWill) },
-    { FinancialBalance::intangibleAssets, CTEXT("Intangible Assets"), FIELD_PLOT(intangibleAssets) },
-    { FinancialBalance::inventory, CTEXT("Inventory"), FIELD_PLOT(inventory) },
-    { FinancialBalance::liabilitiesAndStockholdersEquity, CTEXT("Liabilities And Stockholders Equity"), FIELD_PLOT(liabilitiesAndStockholdersEquity) },
-    { FinancialBalance::longTermDebt, CTEXT("Long Term Debt"), FIELD_PLOT(longTermDebt) },
-    { FinancialBalance::longTermDebtTotal, CTEXT("Long Term Debt Total"), FIELD_PLOT(longTermDebtTotal) },
-    { FinancialBalance::longTermInvestments, CTEXT("Long Term Investments"), FIELD_PLOT(longTermInvestments) },
-    { FinancialBalance::negativeGoodwill, CTEXT("Negative Goodwill"), FIELD_PLOT(negativeGoodwill) },
-    { FinancialBalance::netDebt, CTEXT("Net Debt"), FIELD_PLOT(netDebt) },
-    { FinancialBalance::netInvestedCapital, CTEXT("Net Invested Capital"), FIELD_PLOT(netInvestedCapital) },
-    { FinancialBalance::netReceivables, CTEXT("Net Receivables"), FIELD_PLOT(netReceivables) },
-    { FinancialBalance::netTangibleAssets, CTEXT("Net Tangible Assets"), FIELD_PLOT(netTangibleAssets) },
-    { FinancialBalance::netWorkingCapital, CTEXT("Net Working Capital"), FIELD_PLOT(netWorkingCapital) },
-    { FinancialBalance::noncontrollingInterestInConsolidatedEntity, CTEXT("Noncontrolling Interest In Consolidated Entity"), FIELD_PLOT(noncontrollingInterestInConsolidatedEntity) },
-    { FinancialBalance::nonCurrentAssetsTotal, CTEXT("Non Current Assets Total"), FIELD_PLOT(nonCurrentAssetsTotal) },
-    { FinancialBalance::nonCurrentLiabilitiesOther, CTEXT("Non Current Liabilities Other"), FIELD_PLOT(nonCurrentLiabilitiesOther) },
-    { FinancialBalance::nonCurrentLiabilitiesTotal, CTEXT("Non Current Liabilities Total"), FIELD_PLOT(nonCurrentLiabilitiesTotal) },
-    { FinancialBalance::nonCurrrentAssetsOther, CTEXT("Non Current Assets Other"), FIELD_PLOT(nonCurrrentAssetsOther) },
-    { FinancialBalance::otherAssets, CTEXT("Other Assets"), FIELD_PLOT(otherAssets) },
-    { FinancialBalance::otherCurrentAssets, CTEXT("Other Current Assets"), FIELD_PLOT(otherCurrentAssets) },
-    { FinancialBalance::otherCurrentLiab, CTEXT("Other Current Liabilities"), FIELD_PLOT(otherCurrentLiab) },
-    { FinancialBalance::otherLiab, CTEXT("Other Liabilities"), FIELD_PLOT(otherLiab) },
-    { FinancialBalance::otherStockholderEquity, CTEXT("Other Stockholder Equity"), FIELD_PLOT(otherStockholderEquity) },
-    { FinancialBalance::preferredStockRedeemable, CTEXT("Preferred Stock Redeemable"), FIELD_PLOT(preferredStockRedeemable) },
-    { FinancialBalance::preferredStockTotalEquity, CTEXT("Preferred Stock Total Equity"), FIELD_PLOT(preferredStockTotalEquity) },
-    { FinancialBalance::propertyPlantAndEquipmentGross, CTEXT("Property Plant And Equipment Gross"), FIELD_PLOT(propertyPlantAndEquipmentGross) },
-    { FinancialBalance::propertyPlantAndEquipmentNet, CTEXT("Property Plant And Equipment Net"), FIELD_PLOT(propertyPlantAndEquipmentNet) },
-    { FinancialBalance::propertyPlantEquipment, CTEXT("Property Plant Equipment"), FIELD_PLOT(propertyPlantEquipment) },
-    { FinancialBalance::retainedEarnings, CTEXT("Retained Earnings"), FIELD_PLOT(retainedEarnings) },
-    { FinancialBalance::retainedEarningsTotalEquity, CTEXT("Retained Earnings Total Equity"), FIELD_PLOT(retainedEarningsTotalEquity) },
-    { FinancialBalance::shortLongTermDebt, CTEXT("Short Long Term Debt"), FIELD_PLOT(shortLongTermDebt) },
-    { FinancialBalance::shortLongTermDebtTotal, CTEXT("Short Long Term Debt Total"), FIELD_PLOT(shortLongTermDebtTotal), true },
-    { FinancialBalance::shortTermDebt, CTEXT("Short Term Debt"), FIELD_PLOT(shortTermDebt) },
-    { FinancialBalance::shortTermInvestments, CTEXT("Short Term Investments"), FIELD_PLOT(shortTermInvestments) },
-    { FinancialBalance::temporaryEquityRedeemableNoncontrollingInterests, CTEXT("Temporary Equity Redeemable Noncontrolling Interests"), FIELD_PLOT(temporaryEquityRedeemableNoncontrollingInterests) },
-    { FinancialBalance::totalCurrentAssets, CTEXT("Total Current Assets"), FIELD_PLOT(totalCurrentAssets) },
-    { FinancialBalance::totalCurrentLiabilities, CTEXT("Total Current Liabilities"), FIELD_PLOT(totalCurrentLiabilities) },
-    { FinancialBalance::totalLiab, CTEXT("Total Liabilities"), FIELD_PLOT(totalLiab) },
-    { FinancialBalance::totalPermanentEquity, CTEXT("Total Permanent Equity"), FIELD_PLOT(totalPermanentEquity) },
-    { FinancialBalance::totalStockholderEquity, CTEXT("Total Stockholder Equity"), FIELD_PLOT(totalStockholderEquity) },
-    { FinancialBalance::treasuryStock, CTEXT("Treasury Stock"), FIELD_PLOT(treasuryStock) },
-    { FinancialBalance::warrants, CTEXT("Warrants"), FIELD_PLOT(warrants) },
+financial_field_t<financial_balance_value_t> BALANCE_FIELDS[] = {
+
+    { FinancialBalance::totalAssets, CTEXT("Total Assets"), FIELD_KEY(totalAssets), true },
+    { FinancialBalance::cash, CTEXT("Cash"), FIELD_KEY(cash), true },
+    { FinancialBalance::accountsPayable, CTEXT("Accounts Payable"), FIELD_KEY(accountsPayable) },
+    { FinancialBalance::accumulatedAmortization, CTEXT("Accumulated Amortization"), FIELD_KEY(accumulatedAmortization) },
+    { FinancialBalance::accumulatedDepreciation, CTEXT("Accumulated Depreciation"), FIELD_KEY(accumulatedDepreciation) },
+    { FinancialBalance::accumulatedOtherComprehensiveIncome, CTEXT("Accumulated Other Comprehensive Income"), FIELD_KEY(accumulatedOtherComprehensiveIncome) },
+    { FinancialBalance::additionalPaidInCapital, CTEXT("Additional Paid In Capital"), FIELD_KEY(additionalPaidInCapital) },
+    { FinancialBalance::capitalLeaseObligations, CTEXT("Capital Lease Obligations"), FIELD_KEY(capitalLeaseObligations) },
+    { FinancialBalance::capitalStock, CTEXT("Capital Stock"), FIELD_KEY(capitalStock) },
+    { FinancialBalance::capitalSurpluse, CTEXT("Capital Surpluse"), FIELD_KEY(capitalSurpluse) },
+    { FinancialBalance::cashAndEquivalents, CTEXT("Cash and Equivalents"), FIELD_KEY(cashAndEquivalents) },
+    { FinancialBalance::cashAndShortTermInvestments, CTEXT("Cash And Short Term Investments"), FIELD_KEY(cashAndShortTermInvestments) },
+    { FinancialBalance::commonStock, CTEXT("Common Stock"), FIELD_KEY(commonStock) },
+    { FinancialBalance::commonStockSharesOutstanding, CTEXT("Common Stock Shares Outstanding"), FIELD_KEY(commonStockSharesOutstanding) },
+    { FinancialBalance::commonStockTotalEquity, CTEXT("Common Stock Total Equity"), FIELD_KEY(commonStockTotalEquity) },
+    { FinancialBalance::currentDeferredRevenue, CTEXT("Current Deferred Revenue"), FIELD_KEY(currentDeferredRevenue) },
+    { FinancialBalance::deferredLongTermAssetCharges, CTEXT("Deferred Long Term Asset Charges"), FIELD_KEY(deferredLongTermAssetCharges) },
+    { FinancialBalance::deferredLongTermLiab, CTEXT("Deferred Long Term Liabilities"), FIELD_KEY(deferredLongTermLiab) },
+    { FinancialBalance::earningAssets, CTEXT("Earning Assets"), FIELD_KEY(earningAssets) },
+    { FinancialBalance::goodWill, CTEXT("Good Will"), FIELD_KEY(goodWill) },
+    { FinancialBalance::intangibleAssets, CTEXT("Intangible Assets"), FIELD_KEY(intangibleAssets) },
+    { FinancialBalance::inventory, CTEXT("Inventory"), FIELD_KEY(inventory) },
+    { FinancialBalance::liabilitiesAndStockholdersEquity, CTEXT("Liabilities And Stockholders Equity"), FIELD_KEY(liabilitiesAndStockholdersEquity) },
+    { FinancialBalance::longTermDebt, CTEXT("Long Term Debt"), FIELD_KEY(longTermDebt) },
+    { FinancialBalance::longTermDebtTotal, CTEXT("Long Term Debt Total"), FIELD_KEY(longTermDebtTotal) },
+    { FinancialBalance::longTermInvestments, CTEXT("Long Term Investments"), FIELD_KEY(longTermInvestments) },
+    { FinancialBalance::negativeGoodwill, CTEXT("Negative Goodwill"), FIELD_KEY(negativeGoodwill) },
+    { FinancialBalance::netDebt, CTEXT("Net Debt"), FIELD_KEY(netDebt) },
+    { FinancialBalance::netInvestedCapital, CTEXT("Net Invested Capital"), FIELD_KEY(netInvestedCapital) },
+    { FinancialBalance::netReceivables, CTEXT("Net Receivables"), FIELD_KEY(netReceivables) },
+    { FinancialBalance::netTangibleAssets, CTEXT("Net Tangible Assets"), FIELD_KEY(netTangibleAssets) },
+    { FinancialBalance::netWorkingCapital, CTEXT("Net Working Capital"), FIELD_KEY(netWorkingCapital) },
+    { FinancialBalance::noncontrollingInterestInConsolidatedEntity, CTEXT("Noncontrolling Interest In Consolidated Entity"), FIELD_KEY(noncontrollingInterestInConsolidatedEntity) },
+    { FinancialBalance::nonCurrentAssetsTotal, CTEXT("Non Current Assets Total"), FIELD_KEY(nonCurrentAssetsTotal) },
+    { FinancialBalance::nonCurrentLiabilitiesOther, CTEXT("Non Current Liabilities Other"), FIELD_KEY(nonCurrentLiabilitiesOther) },
+    { FinancialBalance::nonCurrentLiabilitiesTotal, CTEXT("Non Current Liabilities Total"), FIELD_KEY(nonCurrentLiabilitiesTotal) },
+    { FinancialBalance::nonCurrrentAssetsOther, CTEXT("Non Current Assets Other"), FIELD_KEY(nonCurrrentAssetsOther) },
+    { FinancialBalance::otherAssets, CTEXT("Other Assets"), FIELD_KEY(otherAssets) },
+    { FinancialBalance::otherCurrentAssets, CTEXT("Other Current Assets"), FIELD_KEY(otherCurrentAssets) },
+    { FinancialBalance::otherCurrentLiab, CTEXT("Other Current Liabilities"), FIELD_KEY(otherCurrentLiab) },
+    { FinancialBalance::otherLiab, CTEXT("Other Liabilities"), FIELD_KEY(otherLiab) },
+    { FinancialBalance::otherStockholderEquity, CTEXT("Other Stockholder Equity"), FIELD_KEY(otherStockholderEquity) },
+    { FinancialBalance::preferredStockRedeemable, CTEXT("Preferred Stock Redeemable"), FIELD_KEY(preferredStockRedeemable) },
+    { FinancialBalance::preferredStockTotalEquity, CTEXT("Preferred Stock Total Equity"), FIELD_KEY(preferredStockTotalEquity) },
+    { FinancialBalance::propertyPlantAndEquipmentGross, CTEXT("Property Plant And Equipment Gross"), FIELD_KEY(propertyPlantAndEquipmentGross) },
+    { FinancialBalance::propertyPlantAndEquipmentNet, CTEXT("Property Plant And Equipment Net"), FIELD_KEY(propertyPlantAndEquipmentNet) },
+    { FinancialBalance::propertyPlantEquipment, CTEXT("Property Plant Equipment"), FIELD_KEY(propertyPlantEquipment) },
+    { FinancialBalance::retainedEarnings, CTEXT("Retained Earnings"), FIELD_KEY(retainedEarnings) },
+    { FinancialBalance::retainedEarningsTotalEquity, CTEXT("Retained Earnings Total Equity"), FIELD_KEY(retainedEarningsTotalEquity) },
+    { FinancialBalance::shortLongTermDebt, CTEXT("Short Long Term Debt"), FIELD_KEY(shortLongTermDebt) },
+    { FinancialBalance::shortLongTermDebtTotal, CTEXT("Short Long Term Debt Total"), FIELD_KEY(shortLongTermDebtTotal), true },
+    { FinancialBalance::shortTermDebt, CTEXT("Short Term Debt"), FIELD_KEY(shortTermDebt) },
+    { FinancialBalance::shortTermInvestments, CTEXT("Short Term Investments"), FIELD_KEY(shortTermInvestments) },
+    { FinancialBalance::temporaryEquityRedeemableNoncontrollingInterests, CTEXT("Temporary Equity Redeemable Noncontrolling Interests"), FIELD_KEY(temporaryEquityRedeemableNoncontrollingInterests) },
+    { FinancialBalance::totalCurrentAssets, CTEXT("Total Current Assets"), FIELD_KEY(totalCurrentAssets) },
+    { FinancialBalance::totalCurrentLiabilities, CTEXT("Total Current Liabilities"), FIELD_KEY(totalCurrentLiabilities) },
+    { FinancialBalance::totalLiab, CTEXT("Total Liabilities"), FIELD_KEY(totalLiab) },
+    { FinancialBalance::totalPermanentEquity, CTEXT("Total Permanent Equity"), FIELD_KEY(totalPermanentEquity) },
+    { FinancialBalance::totalStockholderEquity, CTEXT("Total Stockholder Equity"), FIELD_KEY(totalStockholderEquity) },
+    { FinancialBalance::treasuryStock, CTEXT("Treasury Stock"), FIELD_KEY(treasuryStock) },
+    { FinancialBalance::warrants, CTEXT("Warrants"), FIELD_KEY(warrants) },
 };
 
 //
@@ -287,88 +218,36 @@ typedef enum class FinancialCashFlow : uint64_t
     
 } financial_cash_flow_value_t;
 
-struct financial_cash_flow_sheet_t
-{
-    time_t date;
-
-    double investments;
-    double changeToLiabilities;
-    double totalCashflowsFromInvestingActivities;
-    double netBorrowings;
-    double totalCashFromFinancingActivities;
-    double changeToOperatingActivities;
-    double netIncome;
-    double changeInCash;
-    double beginPeriodCashFlow;
-    double endPeriodCashFlow;
-    double totalCashFromOperatingActivities;
-    double issuanceOfCapitalStock;
-    double depreciation;
-    double otherCashflowsFromInvestingActivities;
-    double dividendsPaid;
-    double changeToInventory;
-    double changeToAccountReceivables;
-    double salePurchaseOfStock;
-    double otherCashflowsFromFinancingActivities;
-    double changeToNetincome;
-    double capitalExpenditures;
-    double changeReceivables;
-    double cashFlowsOtherOperating;
-    double exchangeRateChanges;
-    double cashAndCashEquivalentsChanges;
-    double changeInWorkingCapital;
-    double stockBasedCompensation;
-    double otherNonCashItems;
-    double freeCashFlow;
-    
-};
-
-#undef FIELD_PLOT
-#define FIELD_PLOT(FIELD) \
-    offsetof(financial_cash_flow_sheet_t, FIELD),  \
-    [](int idx, void* user_data)->ImPlotPoint \
-    { \
-        return financial_field_plot<financial_cash_flow_sheet_t>(idx, user_data, offsetof(financial_cash_flow_sheet_t, FIELD)); \
-    } \
-
-struct {
-    financial_cash_flow_value_t code;
-    string_const_t name;
-    size_t field_offset{ 0 };
-    ImPlotGetter plot_fn{ nullptr };
-
-    bool selected{ false };
-
-} CASH_FLOW_FIELDS[] = {
-
-    { FinancialCashFlow::investments, CTEXT("Investiments"), FIELD_PLOT(investments), false },
-    { FinancialCashFlow::beginPeriodCashFlow, CTEXT("Begin Period Cash Flow"), FIELD_PLOT(beginPeriodCashFlow) },
-    { FinancialCashFlow::capitalExpenditures, CTEXT("Capital Expenditures"), FIELD_PLOT(capitalExpenditures) },
-    { FinancialCashFlow::cashAndCashEquivalentsChanges, CTEXT("Cash And Cash Equivalents Changes"), FIELD_PLOT(cashAndCashEquivalentsChanges) },
-    { FinancialCashFlow::cashFlowsOtherOperating, CTEXT("Cash Flows Other Operating"), FIELD_PLOT(cashFlowsOtherOperating) },
-    { FinancialCashFlow::changeInCash, CTEXT("Change In Cash"), FIELD_PLOT(changeInCash) },
-    { FinancialCashFlow::changeInWorkingCapital, CTEXT("Change In Working Capital"), FIELD_PLOT(changeInWorkingCapital) },
-    { FinancialCashFlow::changeReceivables, CTEXT("Change Receivables"), FIELD_PLOT(changeReceivables) },
-    { FinancialCashFlow::changeToAccountReceivables, CTEXT("Change To Account Receivables"), FIELD_PLOT(changeToAccountReceivables) },
-    { FinancialCashFlow::changeToInventory, CTEXT("Change To Inventory"), FIELD_PLOT(changeToInventory) },
-    { FinancialCashFlow::changeToLiabilities, CTEXT("Change To Liabilities"), FIELD_PLOT(changeToLiabilities) },
-    { FinancialCashFlow::changeToNetincome, CTEXT("Change To Netincome"), FIELD_PLOT(changeToNetincome) },
-    { FinancialCashFlow::changeToOperatingActivities, CTEXT("Change To Operating Activities"), FIELD_PLOT(changeToOperatingActivities) },
-    { FinancialCashFlow::depreciation, CTEXT("Depreciation"), FIELD_PLOT(depreciation) },
-    { FinancialCashFlow::dividendsPaid, CTEXT("Dividends Paid"), FIELD_PLOT(dividendsPaid) },
-    { FinancialCashFlow::endPeriodCashFlow, CTEXT("End Period Cash Flow"), FIELD_PLOT(endPeriodCashFlow) },
-    { FinancialCashFlow::exchangeRateChanges, CTEXT("Exchange Rate Changes"), FIELD_PLOT(exchangeRateChanges) },
-    { FinancialCashFlow::freeCashFlow, CTEXT("Free Cash Flow"), FIELD_PLOT(freeCashFlow), true },
-    { FinancialCashFlow::issuanceOfCapitalStock, CTEXT("Issuance Of Capital Stock"), FIELD_PLOT(issuanceOfCapitalStock) },
-    { FinancialCashFlow::netBorrowings, CTEXT("Net Borrowings"), FIELD_PLOT(netBorrowings) },
-    { FinancialCashFlow::netIncome, CTEXT("Net Income"), FIELD_PLOT(netIncome) },
-    { FinancialCashFlow::otherCashflowsFromFinancingActivities, CTEXT("Other Cashflows From Financing Activities"), FIELD_PLOT(otherCashflowsFromFinancingActivities) },
-    { FinancialCashFlow::otherNonCashItems, CTEXT("Other Non Cash Items"), FIELD_PLOT(otherNonCashItems) },
-    { FinancialCashFlow::salePurchaseOfStock, CTEXT("Sale Purchase Of Stock"), FIELD_PLOT(salePurchaseOfStock) },
-    { FinancialCashFlow::stockBasedCompensation, CTEXT("Stock Based Compensation"), FIELD_PLOT(stockBasedCompensation) },
-    { FinancialCashFlow::totalCashflowsFromInvestingActivities, CTEXT("Total Cashflows From Investing Activities"), FIELD_PLOT(totalCashflowsFromInvestingActivities), true },
-    { FinancialCashFlow::totalCashFromFinancingActivities, CTEXT("Total Cash From Financing Activities"), FIELD_PLOT(totalCashFromFinancingActivities) },
-    { FinancialCashFlow::totalCashFromOperatingActivities, CTEXT("Total Cash From Operating Activities"), FIELD_PLOT(totalCashFromOperatingActivities) },
+financial_field_t<financial_cash_flow_value_t> CASH_FLOW_FIELDS[] = {
+
+    { FinancialCashFlow::investments, CTEXT("Investiments"), FIELD_KEY(investments), false },
+    { FinancialCashFlow::beginPeriodCashFlow, CTEXT("Begin Period Cash Flow"), FIELD_KEY(beginPeriodCashFlow) },
+    { FinancialCashFlow::capitalExpenditures, CTEXT("Capital Expenditures"), FIELD_KEY(capitalExpenditures) },
+    { FinancialCashFlow::cashAndCashEquivalentsChanges, CTEXT("Cash And Cash Equivalents Changes"), FIELD_KEY(cashAndCashEquivalentsChanges) },
+    { FinancialCashFlow::cashFlowsOtherOperating, CTEXT("Cash Flows Other Operating"), FIELD_KEY(cashFlowsOtherOperating) },
+    { FinancialCashFlow::changeInCash, CTEXT("Change In Cash"), FIELD_KEY(changeInCash) },
+    { FinancialCashFlow::changeInWorkingCapital, CTEXT("Change In Working Capital"), FIELD_KEY(changeInWorkingCapital) },
+    { FinancialCashFlow::changeReceivables, CTEXT("Change Receivables"), FIELD_KEY(changeReceivables) },
+    { FinancialCashFlow::changeToAccountReceivables, CTEXT("Change To Account Receivables"), FIELD_KEY(changeToAccountReceivables) },
+    { FinancialCashFlow::changeToInventory, CTEXT("Change To Inventory"), FIELD_KEY(changeToInventory) },
+    { FinancialCashFlow::changeToLiabilities, CTEXT("Change To Liabilities"), FIELD_KEY(changeToLiabilities) },
+    { FinancialCashFlow::changeToNetincome, CTEXT("Change To Netincome"), FIELD_KEY(changeToNetincome) },
+    { FinancialCashFlow::changeToOperatingActivities, CTEXT("Change To Operating Activities"), FIELD_KEY(changeToOperatingActivities) },
+    { FinancialCashFlow::depreciation, CTEXT("Depreciation"), FIELD_KEY(depreciation) },
+    { FinancialCashFlow::dividendsPaid, CTEXT("Dividends Paid"), FIELD_KEY(dividendsPaid) },
+    { FinancialCashFlow::endPeriodCashFlow, CTEXT("End Period Cash Flow"), FIELD_KEY(endPeriodCashFlow) },
+    { FinancialCashFlow::exchangeRateChanges, CTEXT("Exchange Rate Changes"), FIELD_KEY(exchangeRateChanges) },
+    { FinancialCashFlow::freeCashFlow, CTEXT("Free Cash Flow"), FIELD_KEY(freeCashFlow), true },
+    { FinancialCashFlow::issuanceOfCapitalStock, CTEXT("Issuance Of Capital Stock"), FIELD_KEY(issuanceOfCapitalStock) },
+    { FinancialCashFlow::netBorrowings, CTEXT("Net Borrowings"), FIELD_KEY(netBorrowings) },
+    { FinancialCashFlow::netIncome, CTEXT("Net Income"), FIELD_KEY(netIncome) },
+    { FinancialCashFlow::otherCashflowsFromFinancingActivities, CTEXT("Other Cashflows From Financing Activities"), FIELD_KEY(otherCashflowsFromFinancingActivities) },
+    { FinancialCashFlow::otherNonCashItems, CTEXT("Other Non Cash Items"), FIELD_KEY(otherNonCashItems) },
+    { FinancialCashFlow::salePurchaseOfStock, CTEXT("Sale Purchase Of Stock"), FIELD_KEY(salePurchaseOfStock) },
+    { FinancialCashFlow::stockBasedCompensation, CTEXT("Stock Based Compensation"), FIELD_KEY(stockBasedCompensation) },
+    { FinancialCashFlow::totalCashflowsFromInvestingActivities, CTEXT("Total Cashflows From Investing Activities"), FIELD_KEY(totalCashflowsFromInvestingActivities), true },
+    { FinancialCashFlow::totalCashFromFinancingActivities, CTEXT("Total Cash From Financing Activities"), FIELD_KEY(totalCashFromFinancingActivities) },
+    { FinancialCashFlow::totalCashFromOperatingActivities, CTEXT("Total Cash From Operating Activities"), FIELD_KEY(totalCashFromOperatingActivities) },
 };
 
 //
@@ -413,111 +292,111 @@ typedef enum class FinancialIncome : uint64_t
 
 } financial_income_value_t;
 
-struct financial_income_sheet_t
-{
-    time_t date;
-
-    double researchDevelopment;
-    double effectOfAccountingCharges;
-    double incomeBeforeTax;
-    double minorityInterest;
-    double netIncome;
-    double sellingGeneralAdministrative;
-    double sellingAndMarketingExpenses;
-    double grossProfit;
-    double reconciledDepreciation;
-    double ebit;
-    double ebitda;
-    double depreciationAndAmortization;
-    double nonOperatingIncomeNetOther;
-    double operatingIncome;
-    double otherOperatingExpenses;
-    double interestExpense;
-    double taxProvision;
-    double interestIncome;
-    double netInterestIncome;
-    double extraordinaryItems;
-    double nonRecurring;
-    double otherItems;
-    double incomeTaxExpense;
-    double totalRevenue;
-    double totalOperatingExpenses;
-    double costOfRevenue;
-    double totalOtherIncomeExpenseNet;
-    double discontinuedOperations;
-    double netIncomeFromContinuingOps;
-    double netIncomeApplicableToCommonShares;
-    double preferredStockAndOtherAdjustments;
-
+financial_field_t<financial_income_value_t> INCOME_FIELDS[] = {
+
+    { FinancialIncome::netIncome, CTEXT("Net Income"), FIELD_KEY(netIncome), true },
+    { FinancialIncome::grossProfit, CTEXT("Gross Profit"), FIELD_KEY(grossProfit), true },
+    { FinancialIncome::totalRevenue, CTEXT("Total Revenue"), FIELD_KEY(totalRevenue), true },
+    { FinancialIncome::totalOperatingExpenses, CTEXT("Total Operating Expenses"), FIELD_KEY(totalOperatingExpenses) },
+    { FinancialIncome::costOfRevenue, CTEXT("Cost Of Revenue"), FIELD_KEY(costOfRevenue) },
+    { FinancialIncome::depreciationAndAmortization, CTEXT("Depreciation And Amortization"), FIELD_KEY(depreciationAndAmortization) },
+    { FinancialIncome::discontinuedOperations, CTEXT("Discontinued Operations"), FIELD_KEY(discontinuedOperations) },
+    { FinancialIncome::ebit, CTEXT("EBIT"), FIELD_KEY(ebit) },
+    { FinancialIncome::ebitda, CTEXT("EBITDA"), FIELD_KEY(ebitda) },
+    { FinancialIncome::effectOfAccountingCharges, CTEXT("Effect Of Accounting Charges"), FIELD_KEY(effectOfAccountingCharges) },
+    { FinancialIncome::extraordinaryItems, CTEXT("Extraordinary Items"), FIELD_KEY(extraordinaryItems) },
+    { FinancialIncome::incomeBeforeTax, CTEXT("Income Before Tax"), FIELD_KEY(incomeBeforeTax) },
+    { FinancialIncome::incomeTaxExpense, CTEXT("Income Tax Expense"), FIELD_KEY(incomeTaxExpense) },
+    { FinancialIncome::interestExpense, CTEXT("Interest Expense"), FIELD_KEY(interestExpense) },
+    { FinancialIncome::interestIncome, CTEXT("Interest Income"), FIELD_KEY(interestIncome) },
+    { FinancialIncome::minorityInterest, CTEXT("Minority Interest"), FIELD_KEY(minorityInterest) },
+    { FinancialIncome::netIncomeApplicableToCommonShares, CTEXT("Net Income Applicable To Common Shares"), FIELD_KEY(netIncomeApplicableToCommonShares) },
+    { FinancialIncome::netIncomeFromContinuingOps, CTEXT("Net Income From Continuing Ops"), FIELD_KEY(netIncomeFromContinuingOps) },
+    { FinancialIncome::netInterestIncome, CTEXT("Net Interest Income"), FIELD_KEY(netInterestIncome) },
+    { FinancialIncome::nonOperatingIncomeNetOther, CTEXT("Non Operating Income Net Other"), FIELD_KEY(nonOperatingIncomeNetOther) },
+    { FinancialIncome::nonRecurring, CTEXT("Non Recurring"), FIELD_KEY(nonRecurring) },
+    { FinancialIncome::operatingIncome, CTEXT("Operating Income"), FIELD_KEY(operatingIncome) },
+    { FinancialIncome::otherItems, CTEXT("Other Items"), FIELD_KEY(otherItems) },
+    { FinancialIncome::otherOperatingExpenses, CTEXT("Other Operating Expenses"), FIELD_KEY(otherOperatingExpenses) },
+    { FinancialIncome::preferredStockAndOtherAdjustments, CTEXT("Preferred Stock And Other Adjustments"), FIELD_KEY(preferredStockAndOtherAdjustments) },
+    { FinancialIncome::reconciledDepreciation, CTEXT("Reconciled Depreciation"), FIELD_KEY(reconciledDepreciation) },
+    { FinancialIncome::researchDevelopment, CTEXT("R&D"), FIELD_KEY(researchDevelopment), false },
+    { FinancialIncome::sellingAndMarketingExpenses, CTEXT("Selling And Marketing Expenses"), FIELD_KEY(sellingAndMarketingExpenses) },
+    { FinancialIncome::sellingGeneralAdministrative, CTEXT("Selling General Administrative"), FIELD_KEY(sellingGeneralAdministrative) },
+    { FinancialIncome::taxProvision, CTEXT("Tax Provision"), FIELD_KEY(taxProvision) },
+    { FinancialIncome::totalOtherIncomeExpenseNet, CTEXT("Total Other Income Expense Net"), FIELD_KEY(totalOtherIncomeExpenseNet) },
 };
 
-#undef FIELD_PLOT
-#define FIELD_PLOT(FIELD) \
-    offsetof(financial_income_sheet_t, FIELD),  \
-    [](int idx, void* user_data)->ImPlotPoint \
-    { \
-        return financial_field_plot<financial_income_sheet_t>(idx, user_data, offsetof(financial_income_sheet_t, FIELD)); \
-    } \
+//
+// # PRIVATE
+//
 
-struct {
-    financial_income_value_t code;
-    string_const_t name;
-    size_t field_offset{ 0 };
-    ImPlotGetter plot_fn{ nullptr };
+#define FINANCIALS_STORE_VERSION 1
 
-    bool selected{ false };
+/*! Age after which a store gets fetched again, in seconds. The expired store is used until the new one is built. */
+constexpr uint64_t FINANCIALS_STORE_MAX_AGE = 7 * 24ULL * 3600ULL;
 
-} INCOME_FIELDS[] = {
-
-    { FinancialIncome::netIncome, CTEXT("Net Income"), FIELD_PLOT(netIncome), true },
-    { FinancialIncome::grossProfit, CTEXT("Gross Profit"), FIELD_PLOT(grossProfit), true },
-    { FinancialIncome::totalRevenue, CTEXT("Total Revenue"), FIELD_PLOT(totalRevenue), true },
-    { FinancialIncome::totalOperatingExpenses, CTEXT("Total Operating Expenses"), FIELD_PLOT(totalOperatingExpenses) },
-    { FinancialIncome::costOfRevenue, CTEXT("Cost Of Revenue"), FIELD_PLOT(costOfRevenue) },
-    { FinancialIncome::depreciationAndAmortization, CTEXT("Depreciation And Amortization"), FIELD_PLOT(depreciationAndAmortization) },
-    { FinancialIncome::discontinuedOperations, CTEXT("Discontinued Operations"), FIELD_PLOT(discontinuedOperations) },
-    { FinancialIncome::ebit, CTEXT("EBIT"), FIELD_PLOT(ebit) },
-    { FinancialIncome::ebitda, CTEXT("EBITDA"), FIELD_PLOT(ebitda) },
-    { FinancialIncome::effectOfAccountingCharges, CTEXT("Effect Of Accounting Charges"), FIELD_PLOT(effectOfAccountingCharges) },
-    { FinancialIncome::extraordinaryItems, CTEXT("Extraordinary Items"), FIELD_PLOT(extraordinaryItems) },
-    { FinancialIncome::incomeBeforeTax, CTEXT("Income Before Tax"), FIELD_PLOT(incomeBeforeTax) },
-    { FinancialIncome::incomeTaxExpense, CTEXT("Income Tax Expense"), FIELD_PLOT(incomeTaxExpense) },
-    { FinancialIncome::interestExpense, CTEXT("Interest Expense"), FIELD_PLOT(interestExpense) },
-    { FinancialIncome::interestIncome, CTEXT("Interest Income"), FIELD_PLOT(interestIncome) },
-    { FinancialIncome::minorityInterest, CTEXT("Minority Interest"), FIELD_PLOT(minorityInterest) },
-    { FinancialIncome::netIncomeApplicableToCommonShares, CTEXT("Net Income Applicable To Common Shares"), FIELD_PLOT(netIncomeApplicableToCommonShares) },
-    { FinancialIncome::netIncomeFromContinuingOps, CTEXT("Net Income From Continuing Ops"), FIELD_PLOT(netIncomeFromContinuingOps) },
-    { FinancialIncome::netInterestIncome, CTEXT("Net Interest Income"), FIELD_PLOT(netInterestIncome) },
-    { FinancialIncome::nonOperatingIncomeNetOther, CTEXT("Non Operating Income Net Other"), FIELD_PLOT(nonOperatingIncomeNetOther) },
-    { FinancialIncome::nonRecurring, CTEXT("Non Recurring"), FIELD_PLOT(nonRecurring) },
-    { FinancialIncome::operatingIncome, CTEXT("Operating Income"), FIELD_PLOT(operatingIncome) },
-    { FinancialIncome::otherItems, CTEXT("Other Items"), FIELD_PLOT(otherItems) },
-    { FinancialIncome::otherOperatingExpenses, CTEXT("Other Operating Expenses"), FIELD_PLOT(otherOperatingExpenses) },
-    { FinancialIncome::preferredStockAndOtherAdjustments, CTEXT("Preferred Stock And Other Adjustments"), FIELD_PLOT(preferredStockAndOtherAdjustments) },
-    { FinancialIncome::reconciledDepreciation, CTEXT("Reconciled Depreciation"), FIELD_PLOT(reconciledDepreciation) },
-    { FinancialIncome::researchDevelopment, CTEXT("R&D"), FIELD_PLOT(researchDevelopment), false },
-    { FinancialIncome::sellingAndMarketingExpenses, CTEXT("Selling And Marketing Expenses"), FIELD_PLOT(sellingAndMarketingExpenses) },
-    { FinancialIncome::sellingGeneralAdministrative, CTEXT("Selling General Administrative"), FIELD_PLOT(sellingGeneralAdministrative) },
-    { FinancialIncome::taxProvision, CTEXT("Tax Provision"), FIELD_PLOT(taxProvision) },
-    { FinancialIncome::totalOtherIncomeExpenseNet, CTEXT("Total Other Income Expense Net"), FIELD_PLOT(totalOtherIncomeExpenseNet) },
+/*! Age of the cached fundamentals used to build a store, in seconds. */
+constexpr uint64_t FINANCIALS_FUNDAMENTALS_CACHE_MAX_AGE = 24ULL * 3600ULL;
+
+/*! Delay before the fundamentals of a symbol can be requested again if the last request did not build a store, in seconds. */
+constexpr double FINANCIALS_FETCH_RETRY_DELAY = 60.0;
+
+struct financial_statement_t
+{
+    unsigned count{ 0 };
+    unsigned field_count{ 0 };
+
+    time_t*  dates{ nullptr };  // Period dates ordered from older to newer
+    double*  values{ nullptr }; // One column of #count values per statement field
 };
 
-//
-// # PRIVATE
-//
+struct financials_store_t
+{
+    hash_t key{ 0 };
+    time_t built_at{ 0 };
+    financial_statement_t statements[FINANCIAL_STATEMENT_COUNT][FINANCIAL_PERIOD_COUNT];
+};
+
+FOUNDATION_ALIGNED_STRUCT(financials_store_header_t, 8)
+{
+    char magic[4] = { 0 };
+    uint32_t version = 0;
+    hash_t schema = 0;
+    int64_t built_at = 0;
+    uint32_t counts[FINANCIAL_STATEMENT_COUNT][FINANCIAL_PERIOD_COUNT] = { { 0 } };
+};
+
+struct financials_fetch_t
+{
+    hash_t key{ 0 };
+    tick_t requested_at{ 0 };
+};
+
+static struct FINANCIALS_MODULE {
+
+    mutex_t* lock{ nullptr };
+    financials_store_t** stores{ nullptr };
+
+    // Stores replaced by a newer one, kept until shutdown since their columns can still be referenced.
+    financials_store_t** retired_stores{ nullptr };
+
+    // Fundamentals requests in flight
+    financials_fetch_t* fetches{ nullptr };
+
+} *_financials = nullptr;
 
 struct financials_window_t
 {
     char title[64]{ 0 };
     char symbol[16]{ 0 };
+    hash_t key{ 0 };
 
     bool show_balance_values{ true };
     bool show_cash_flow_values{ false };
     bool show_income_values{ false };
 
-    financial_balance_sheet_t* balances{ nullptr };
-    financial_cash_flow_sheet_t* cash_flows{ nullptr };
-    financial_income_sheet_t* incomes{ nullptr };
+    const financials_store_t* volatile store{ nullptr };
 
     time_t min_date{ 0 }, max_date{ 0 };
 
@@ -525,215 +404,488 @@ struct financials_window_t
     bool rendered_once{ false };
 };
 
-FOUNDATION_STATIC financial_balance_sheet_t* financials_fetch_balance_sheets(const json_object_t& json)
-{    
-    const auto Financials = json["Financials"]["Balance_Sheet"]["quarterly"];
-    if (!Financials.is_valid())
-        return nullptr;
+struct financials_plot_context_t
+{
+    const time_t* dates;
+    const double* values;
+};
+
+FOUNDATION_STATIC ImPlotPoint financials_plot_column(int idx, void* user_data)
+{
+    const financials_plot_context_t* c = (const financials_plot_context_t*)user_data;
+    return ImPlotPoint((double)c->dates[idx], c->values[idx]);
+}
+
+FOUNDATION_STATIC unsigned financials_field_count(financial_statement_type_t statement)
+{
+    switch (statement)
+    {
+        case FINANCIAL_BALANCE_SHEET: return ARRAY_COUNT(BALANCE_FIELDS);
+        case FINANCIAL_CASH_FLOW: return ARRAY_COUNT(CASH_FLOW_FIELDS);
+        case FINANCIAL_INCOME_STATEMENT: return ARRAY_COUNT(INCOME_FIELDS);
+        case FINANCIAL_STATEMENT_COUNT: break;
+    }
+
+    return 0;
+}
+
+FOUNDATION_STATIC string_const_t financials_field_key(financial_statement_type_t statement, unsigned field)
+{
+    switch (statement)
+    {
+        case FINANCIAL_BALANCE_SHEET: return BALANCE_FIELDS[field].key;
+        case FINANCIAL_CASH_FLOW: return CASH_FLOW_FIELDS[field].key;
+        case FINANCIAL_INCOME_STATEMENT: return INCOME_FIELDS[field].key;
+        case FINANCIAL_STATEMENT_COUNT: break;
+    }
+
+    return string_null();
+}
+
+FOUNDATION_STATIC int financials_field_index(financial_statement_type_t statement, const char* field, size_t field_length)
+{
+    for (unsigned i = 0, end = financials_field_count(statement); i < end; ++i)
+    {
+        string_const_t key = financials_field_key(statement, i);
+        if (string_equal_nocase(STRING_ARGS(key), field, field_length))
+            return (int)i;
+    }
+
+    return -1;
+}
+
+FOUNDATION_STATIC const char* financials_statement_json_name(financial_statement_type_t statement)
+{
+    switch (statement)
+    {
+        case FINANCIAL_BALANCE_SHEET: return "Balance_Sheet";
+        case FINANCIAL_CASH_FLOW: return "Cash_Flow";
+        case FINANCIAL_INCOME_STATEMENT: return "Income_Statement";
+        case FINANCIAL_STATEMENT_COUNT: break;
+    }
+
+    return nullptr;
+}
+
+/*! Hash of all statement field keys used to invalidate persisted stores when fields change. */
+FOUNDATION_STATIC hash_t financials_store_schema()
+{
+    hash_t schema = FINANCIALS_STORE_VERSION;
+    for (int s = 0; s < FINANCIAL_STATEMENT_COUNT; ++s)
+    {
+        for (unsigned i = 0, end = financials_field_count((financial_statement_type_t)s); i < end; ++i)
+        {
+            string_const_t key = financials_field_key((financial_statement_type_t)s, i);
+            schema = schema * 31 + string_hash(STRING_ARGS(key));
+        }
+    }
+
+    return schema;
+}
+
+FOUNDATION_STATIC const double* financials_statement_column(const financial_statement_t& statement, unsigned field)
+{
+    FOUNDATION_ASSERT(field < statement.field_count);
+    return statement.values + (size_t)field * statement.count;
+}
+
+FOUNDATION_STATIC void financials_statement_allocate(financial_statement_t& statement, unsigned field_count, unsigned count)
+{
+    statement.count = count;
+    statement.field_count = field_count;
+    if (count == 0)
+        return;
 
-    financial_balance_sheet_t* sheets = nullptr;
-    for (auto e : Financials)
+    statement.dates = (time_t*)memory_allocate(HASH_FINANCIALS, sizeof(time_t) * count, 0, MEMORY_PERSISTENT);
+    statement.values = (double*)memory_allocate(HASH_FINANCIALS, sizeof(double) * count * field_count, 0, MEMORY_PERSISTENT);
+}
+
+FOUNDATION_STATIC void financials_statement_deallocate(financial_statement_t& statement)
+{
+    memory_deallocate(statement.dates);
+    memory_deallocate(statement.values);
+    statement = {};
+}
+
+FOUNDATION_EXTERN void financials_store_deallocate(financials_store_t* store)
+{
+    for (int s = 0; s < FINANCIAL_STATEMENT_COUNT; ++s)
     {
-        financial_balance_sheet_t sheet{};
+        for (int p = 0; p < FINANCIAL_PERIOD_COUNT; ++p)
+            financials_statement_deallocate(store->statements[s][p]);
+    }
 
+    MEM_DELETE(store);
+}
+
+FOUNDATION_STATIC void financials_statement_build(financial_statement_t& statement, financial_statement_type_t type, const json_object_t& sheets)
+{
+    const unsigned field_count = financials_field_count(type);
+
+    unsigned capacity = 0;
+    for (auto e : sheets)
+    {
+        FOUNDATION_UNUSED(e);
+        capacity++;
+    }
+
+    // Read each sheet directly in its column
+    financial_statement_t unsorted{};
+    financials_statement_allocate(unsorted, field_count, capacity);
+
+    unsigned count = 0;
+    for (auto e : sheets)
+    {
         string_const_t date_string = e["date"].as_string();
-        if (!string_try_convert_date(STRING_ARGS(date_string), sheet.date))
+        if (!string_try_convert_date(STRING_ARGS(date_string), unsorted.dates[count]))
             continue;
 
-        sheet.totalAssets = e["totalAssets"].as_number();
-        sheet.intangibleAssets = e["intangibleAssets"].as_number();
-        sheet.otherCurrentAssets = e["otherCurrentAssets"].as_number();
-        sheet.totalLiab = e["totalLiab"].as_number();
-        sheet.totalStockholderEquity = e["totalStockholderEquity"].as_number();
-        sheet.otherCurrentLiab = e["otherCurrentLiab"].as_number();
-        sheet.commonStock = e["commonStock"].as_number();
-        sheet.capitalStock = e["capitalStock"].as_number();
-        sheet.retainedEarnings = e["retainedEarnings"].as_number();
-        sheet.otherLiab = e["otherLiab"].as_number();
-        sheet.cash = e["cash"].as_number();
-        sheet.cashAndEquivalents = e["cashAndEquivalents"].as_number();
-        sheet.totalCurrentLiabilities = e["totalCurrentLiabilities"].as_number();
-        sheet.netDebt = e["netDebt"].as_number();
-        sheet.shortTermDebt = e["shortTermDebt"].as_number();
-        sheet.shortLongTermDebt = e["shortLongTermDebt"].as_number();
-        sheet.otherStockholderEquity = e["otherStockholderEquity"].as_number();
-        sheet.propertyPlantEquipment = e["propertyPlantEquipment"].as_number();
-        sheet.totalCurrentAssets = e["totalCurrentAssets"].as_number();
-        sheet.netTangibleAssets = e["netTangibleAssets"].as_number();
-        sheet.inventory = e["inventory"].as_number();
-        sheet.accountsPayable = e["accountsPayable"].as_number();
-        sheet.netReceivables = e["netReceivables"].as_number();
-        sheet.nonCurrrentAssetsOther = e["nonCurrrentAssetsOther"].as_number();
-        sheet.capitalLeaseObligations = e["capitalLeaseObligations"].as_number();
-        sheet.longTermDebtTotal = e["longTermDebtTotal"].as_number();
-        sheet.nonCurrentLiabilitiesTotal = e["nonCurrentLiabilitiesTotal"].as_number();
-        sheet.nonCurrentAssetsTotal = e["nonCurrentAssetsTotal"].as_number();
-        sheet.capitalSurpluse = e["capitalSurpluse"].as_number();
-        sheet.liabilitiesAndStockholdersEquity = e["liabilitiesAndStockholdersEquity"].as_number();
-        sheet.cashAndShortTermInvestments = e["cashAndShortTermInvestments"].as_number();
-        sheet.netWorkingCapital = e["netWorkingCapital"].as_number();
-        sheet.netInvestedCapital = e["netInvestedCapital"].as_number();
-        sheet.commonStockSharesOutstanding = e["commonStockSharesOutstanding"].as_number();
-        sheet.shortTermInvestments = e["shortTermInvestments"].as_number();
-        sheet.shortLongTermDebtTotal = e["shortLongTermDebtTotal"].as_number();
-        sheet.accumulatedOtherComprehensiveIncome = e["accumulatedOtherComprehensiveIncome"].as_number();
-        sheet.commonStockTotalEquity = e["commonStockTotalEquity"].as_number();
-        sheet.propertyPlantAndEquipmentGross = e["propertyPlantAndEquipmentGross"].as_number();
-        sheet.nonCurrentLiabilitiesOther = e["nonCurrentLiabilitiesOther"].as_number();
-        sheet.goodWill = e["goodWill"].as_number();
-        sheet.longTermInvestments = e["longTermInvestments"].as_number();
-        sheet.deferredLongTermLiab = e["deferredLongTermLiab"].as_number();
-        sheet.propertyPlantAndEquipmentNet = e["propertyPlantAndEquipmentNet"].as_number();
-        sheet.currentDeferredRevenue = e["currentDeferredRevenue"].as_number();
-        sheet.earningAssets = e["earningAssets"].as_number();
-        sheet.totalPermanentEquity = e["totalPermanentEquity"].as_number();
-        sheet.noncontrollingInterestInConsolidatedEntity = e["noncontrollingInterestInConsolidatedEntity"].as_number();
-        sheet.temporaryEquityRedeemableNoncontrollingInterests = e["temporaryEquityRedeemableNoncontrollingInterests"].as_number();
-        sheet.additionalPaidInCapital = e["additionalPaidInCapital"].as_number();
-        sheet.preferredStockTotalEquity = e["preferredStockTotalEquity"].as_number();
-        sheet.retainedEarningsTotalEquity = e["retainedEarningsTotalEquity"].as_number();
-        sheet.treasuryStock = e["treasuryStock"].as_number();
-        sheet.deferredLongTermAssetCharges = e["deferredLongTermAssetCharges"].as_number();
-        sheet.negativeGoodwill = e["negativeGoodwill"].as_number();
-        sheet.warrants = e["warrants"].as_number();
-        sheet.preferredStockRedeemable = e["preferredStockRedeemable"].as_number();
-        sheet.accumulatedDepreciation = e["accumulatedDepreciation"].as_number();
-
-        array_push_memcpy(sheets, &sheet);
-    }
-
-    // Sort by date
-    array_sort(sheets, ARRAY_COMPARE_EXPRESSION(a.date - b.date));
-    return sheets;
-}
-
-FOUNDATION_STATIC financial_cash_flow_sheet_t* financials_fetch_cash_flows(const json_object_t& json)
-{
-    const auto CashFlow = json["Financials"]["Cash_Flow"]["quarterly"];
-    if (!CashFlow.is_valid())
+        for (unsigned f = 0; f < field_count; ++f)
+            unsorted.values[(size_t)f * capacity + count] = e[financials_field_key(type, f)].as_number();
+        count++;
+    }
+
+    // Sort periods from older to newer
+    struct period_order_t { time_t date; unsigned index; };
+    period_order_t* order = nullptr;
+    array_reserve(order, count);
+    for (unsigned i = 0; i < count; ++i)
+        array_push(order, (period_order_t{ unsorted.dates[i], i }));
+    array_sort(order, ARRAY_COMPARE_EXPRESSION(a.date - b.date));
+
+    financials_statement_allocate(statement, field_count, count);
+    for (unsigned i = 0; i < count; ++i)
+        statement.dates[i] = order[i].date;
+    for (unsigned f = 0; f < field_count; ++f)
+    {
+        double* column = statement.values + (size_t)f * count;
+        const double* unsorted_column = unsorted.values + (size_t)f * capacity;
+        for (unsigned i = 0; i < count; ++i)
+            column[i] = unsorted_column[order[i].index];
+    }
+
+    array_deallocate(order);
+    financials_statement_deallocate(unsorted);
+}
+
+FOUNDATION_EXTERN financials_store_t* financials_store_build(hash_t key, const json_object_t& json)
+{
+    PERFORMANCE_TRACKER("financials_store_build");
+
+    const auto Financials = json["Financials"];
+    if (!Financials.is_valid())
         return nullptr;
 
-    financial_cash_flow_sheet_t* sheets = nullptr;
-    for (auto e : CashFlow)
+    financials_store_t* store = MEM_NEW(HASH_FINANCIALS, financials_store_t);
+    store->key = key;
+    store->built_at = time_now();
+
+    const char* PERIOD_NAMES[FINANCIAL_PERIOD_COUNT] = { "quarterly", "yearly" };
+    for (int s = 0; s < FINANCIAL_STATEMENT_COUNT; ++s)
     {
-        financial_cash_flow_sheet_t sheet{};
+        const auto Statement = Financials[financials_statement_json_name((financial_statement_type_t)s)];
+        for (int p = 0; p < FINANCIAL_PERIOD_COUNT; ++p)
+        {
+            const auto Sheets = Statement[PERIOD_NAMES[p]];
+            if (Sheets.is_valid())
+                financials_statement_build(store->statements[s][p], (financial_statement_type_t)s, Sheets);
+            else
+                store->statements[s][p].field_count = financials_field_count((financial_statement_type_t)s);
+        }
+    }
 
-        string_const_t date_string = e["date"].as_string();
-        if (!string_try_convert_date(STRING_ARGS(date_string), sheet.date))
-            continue;
-            
-        sheet.investments = e["investments"].as_number();
-        sheet.changeToLiabilities = e["changeToLiabilities"].as_number();
-        sheet.totalCashflowsFromInvestingActivities = e["totalCashflowsFromInvestingActivities"].as_number();
-        sheet.netBorrowings = e["netBorrowings"].as_number();
-        sheet.totalCashFromFinancingActivities = e["totalCashFromFinancingActivities"].as_number();
-        sheet.changeToOperatingActivities = e["changeToOperatingActivities"].as_number();
-        sheet.netIncome = e["netIncome"].as_number();
-        sheet.changeInCash = e["changeInCash"].as_number();
-        sheet.beginPeriodCashFlow = e["beginPeriodCashFlow"].as_number();
-        sheet.endPeriodCashFlow = e["endPeriodCashFlow"].as_number();
-        sheet.totalCashFromOperatingActivities = e["totalCashFromOperatingActivities"].as_number();
-        sheet.issuanceOfCapitalStock = e["issuanceOfCapitalStock"].as_number();
-        sheet.depreciation = e["depreciation"].as_number();
-        sheet.otherCashflowsFromInvestingActivities = e["otherCashflowsFromInvestingActivities"].as_number();
-        sheet.dividendsPaid = e["dividendsPaid"].as_number();
-        sheet.changeToInventory = e["changeToInventory"].as_number();
-        sheet.changeToAccountReceivables = e["changeToAccountReceivables"].as_number();
-        sheet.salePurchaseOfStock = e["salePurchaseOfStock"].as_number();
-        sheet.otherCashflowsFromFinancingActivities = e["otherCashflowsFromFinancingActivities"].as_number();
-        sheet.changeToNetincome = e["changeToNetincome"].as_number();
-        sheet.capitalExpenditures = e["capitalExpenditures"].as_number();
-        sheet.changeReceivables = e["changeReceivables"].as_number();
-        sheet.cashFlowsOtherOperating = e["cashFlowsOtherOperating"].as_number();
-        sheet.exchangeRateChanges = e["exchangeRateChanges"].as_number();
-        sheet.cashAndCashEquivalentsChanges = e["cashAndCashEquivalentsChanges"].as_number();
-        sheet.changeInWorkingCapital = e["changeInWorkingCapital"].as_number();
-        sheet.stockBasedCompensation = e["stockBasedCompensation"].as_number();
-        sheet.otherNonCashItems = e["otherNonCashItems"].as_number();
-        sheet.freeCashFlow = e["freeCashFlow"].as_number();
-        
-        array_push_memcpy(sheets, &sheet);
+    return store;
+}
+
+FOUNDATION_STATIC string_const_t financials_store_path(const char* symbol, size_t symbol_length)
+{
+    string_const_t file_name = fs_clean_file_name(symbol, symbol_length);
+    return session_get_user_file_path(STRING_ARGS(file_name), STRING_CONST("cache"), STRING_CONST("financials"));
+}
+
+/*! Size of the statement dates and values following the header of a persisted store. */
+FOUNDATION_STATIC uint64_t financials_store_payload_size(const financials_store_header_t& header)
+{
+    uint64_t size = 0;
+    for (int s = 0; s < FINANCIAL_STATEMENT_COUNT; ++s)
+    {
+        const uint64_t field_count = financials_field_count((financial_statement_type_t)s);
+        for (int p = 0; p < FINANCIAL_PERIOD_COUNT; ++p)
+            size += (uint64_t)header.counts[s][p] * (sizeof(int64_t) + sizeof(double) * field_count);
     }
-    
-    // Sort by date
-    array_sort(sheets, ARRAY_COMPARE_EXPRESSION(a.date - b.date));
-    return sheets;
+
+    return size;
+}
+
+/*! Write a store to a temporary file next to @path and then replace @path with it. */
+FOUNDATION_EXTERN bool financials_store_save(const financials_store_t* store, const char* path, size_t path_length)
+{
+    char temp_path_buffer[BUILD_MAX_PATHLEN];
+    string_t temp_path = string_format(STRING_BUFFER(temp_path_buffer), STRING_CONST("%.*s.tmp"), (int)path_length, path);
+    stream_t* stream = fs_open_file(STRING_ARGS(temp_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+    if (stream == nullptr)
+        return false;
+
+    financials_store_header_t header;
+    memcpy(header.magic, "FINS", sizeof(header.magic));
+    header.version = FINANCIALS_STORE_VERSION;
+    header.schema = financials_store_schema();
+    header.built_at = (int64_t)store->built_at;
+    for (int s = 0; s < FINANCIAL_STATEMENT_COUNT; ++s)
+    {
+        for (int p = 0; p < FINANCIAL_PERIOD_COUNT; ++p)
+            header.counts[s][p] = store->statements[s][p].count;
+    }
+    bool success = stream_write(stream, &header, sizeof(header)) == sizeof(header);
+
+    for (int s = 0; success && s < FINANCIAL_STATEMENT_COUNT; ++s)
+    {
+        for (int p = 0; success && p < FINANCIAL_PERIOD_COUNT; ++p)
+        {
+            const financial_statement_t& statement = store->statements[s][p];
+            if (statement.count == 0)
+                continue;
+            for (unsigned i = 0; i < statement.count; ++i)
+                stream_write_int64(stream, (int64_t)statement.dates[i]);
+            const size_t values_size = sizeof(double) * statement.count * statement.field_count;
+            success = stream_write(stream, statement.values, values_size) == values_size;
+        }
+    }
+
+    // Dates are written without a result, so the final size tells if they all made it.
+    success = success && stream_size(stream) == sizeof(header) + financials_store_payload_size(header);
+    stream_deallocate(stream);
+
+    if (!success || !system_replace_file(STRING_ARGS(temp_path), path, path_length))
+    {
+        log_warnf(HASH_FINANCIALS, WARNING_RESOURCE, STRING_CONST("Failed to write financials store %.*s"), (int)path_length, path);
+        fs_remove_file(STRING_ARGS(temp_path));
+        return false;
+    }
+
+    return true;
 }
 
-FOUNDATION_STATIC financial_income_sheet_t* financials_fetch_incomes(const json_object_t& json)
+/*! Read a store written by #financials_store_save.
+ *
+ *  @return The store, or null if it does not exist, expired or does not match the file size.
+ */
+FOUNDATION_EXTERN financials_store_t* financials_store_load(hash_t key, const char* path, size_t path_length)
 {
-    const auto CashFlow = json["Financials"]["Income_Statement"]["quarterly"];
-    if (!CashFlow.is_valid())
+    if (!fs_is_file(path, path_length))
         return nullptr;
 
-    financial_income_sheet_t* sheets = nullptr;
-    for (auto e : CashFlow)
+    stream_t* stream = fs_open_file(path, path_length, STREAM_IN | STREAM_BINARY);
+    if (stream == nullptr)
+        return nullptr;
+
+    // Counts are checked against the file size before allocating anything.
+    financials_store_header_t header;
+    if (stream_read(stream, &header, sizeof(header)) != sizeof(header) ||
+        !string_equal(header.magic, sizeof(header.magic), STRING_CONST("FINS")) ||
+        header.version != FINANCIALS_STORE_VERSION || header.schema != financials_store_schema() ||
+        stream_size(stream) != sizeof(header) + financials_store_payload_size(header) ||
+        time_elapsed_days((time_t)header.built_at, time_now()) * 24.0 * 3600.0 > FINANCIALS_STORE_MAX_AGE)
     {
-        financial_income_sheet_t sheet{};
+        stream_deallocate(stream);
+        return nullptr;
+    }
 
-        string_const_t date_string = e["date"].as_string();
-        if (!string_try_convert_date(STRING_ARGS(date_string), sheet.date))
-            continue;
+    financials_store_t* store = MEM_NEW(HASH_FINANCIALS, financials_store_t);
+    store->key = key;
+    store->built_at = (time_t)header.built_at;
+
+    bool valid = true;
+    for (int s = 0; valid && s < FINANCIAL_STATEMENT_COUNT; ++s)
+    {
+        const unsigned field_count = financials_field_count((financial_statement_type_t)s);
+        for (int p = 0; valid && p < FINANCIAL_PERIOD_COUNT; ++p)
+        {
+            financial_statement_t& statement = store->statements[s][p];
+            financials_statement_allocate(statement, field_count, header.counts[s][p]);
+            if (statement.count == 0)
+                continue;
+
+            for (unsigned i = 0; i < statement.count; ++i)
+                statement.dates[i] = (time_t)stream_read_int64(stream);
+
+            const size_t values_size = sizeof(double) * statement.count * statement.field_count;
+            valid = stream_read(stream, statement.values, values_size) == values_size;
+        }
+    }
+
+    stream_deallocate(stream);
+
+    if (!valid)
+    {
+        financials_store_deallocate(store);
+        return nullptr;
+    }
+
+    return store;
+}
+
+FOUNDATION_STATIC bool financials_store_write(const financials_store_t* store, const char* symbol, size_t symbol_length)
+{
+    string_const_t store_path = financials_store_path(symbol, symbol_length);
+    return financials_store_save(store, STRING_ARGS(store_path));
+}
+
+FOUNDATION_STATIC financials_store_t* financials_store_read(hash_t key, const char* symbol, size_t symbol_length)
+{
+    string_const_t store_path = financials_store_path(symbol, symbol_length);
+    return financials_store_load(key, STRING_ARGS(store_path));
+}
+
+FOUNDATION_STATIC const financials_store_t* financials_store_find(hash_t key)
+{
+    if (auto lock = scoped_mutex_t(_financials->lock))
+    {
+        for (unsigned i = 0, end = array_size(_financials->stores); i < end; ++i)
+        {
+            if (_financials->stores[i]->key == key)
+                return _financials->stores[i];
+        }
+    }
+
+    return nullptr;
+}
+
+FOUNDATION_STATIC bool financials_store_expired(const financials_store_t* store)
+{
+    return time_elapsed_days(store->built_at, time_now()) * 24.0 * 3600.0 > FINANCIALS_STORE_MAX_AGE;
+}
+
+/*! Publish a new store and return the one shared with other users of that symbol. 
+ *  A store built more recently replaces the previous one, which gets retired.
+ */
+FOUNDATION_STATIC const financials_store_t* financials_store_publish(financials_store_t* store)
+{
+    if (auto lock = scoped_mutex_t(_financials->lock))
+    {
+        for (unsigned i = 0, end = array_size(_financials->fetches); i < end; ++i)
+        {
+            if (_financials->fetches[i].key == store->key)
+            {
+                array_erase_memcpy(_financials->fetches, i);
+                break;
+            }
+        }
+
+        for (unsigned i = 0, end = array_size(_financials->stores); i < end; ++i)
+        {
+            financials_store_t* published_store = _financials->stores[i];
+            if (published_store->key != store->key)
+                continue;
+
+            if (store->built_at <= published_store->built_at)
+            {
+                // Another thread already published that store.
+                financials_store_deallocate(store);
+                return published_store;
+            }
+
+            array_push(_financials->retired_stores, published_store);
+            _financials->stores[i] = store;
+            return store;
+        }
+
+        array_push(_financials->stores, store);
+    }
+
+    return store;
+}
+
+FOUNDATION_STATIC const financials_store_t* financials_store_build_from_json(const char* symbol, size_t symbol_length, const json_object_t& json)
+{
+    const hash_t key = string_hash(symbol, symbol_length);
+    financials_store_t* store = financials_store_build(key, json);
+    if (store == nullptr)
+        return nullptr;
+
+    financials_store_write(store, symbol, symbol_length);
+    return financials_store_publish(store);
+}
+
+/*! Returns the symbol statement store if it was already built or persisted. */
+FOUNDATION_STATIC const financials_store_t* financials_store_load(const char* symbol, size_t symbol_length)
+{
+    const hash_t key = string_hash(symbol, symbol_length);
+    const financials_store_t* store = financials_store_find(key);
+    if (store)
+        return store;
+
+    financials_store_t* persisted_store = financials_store_read(key, symbol, symbol_length);
+    if (persisted_store)
+        return financials_store_publish(persisted_store);
+
+    return nullptr;
+}
+
+/*! Fetch the symbol fundamentals in the background to build its store, unless they are already being fetched. */
+FOUNDATION_STATIC void financials_store_fetch_async(const char* symbol, size_t symbol_length)
+{
+    const hash_t key = string_hash(symbol, symbol_length);
+    if (auto lock = scoped_mutex_t(_financials->lock))
+    {
+        financials_fetch_t* fetch = nullptr;
+        for (unsigned i = 0, end = array_size(_financials->fetches); i < end; ++i)
+        {
+            if (_financials->fetches[i].key == key)
+            {
+                fetch = &_financials->fetches[i];
+                break;
+            }
+        }
+
+        // A request that did not build any store is retried after a while.
+        if (fetch && time_elapsed(fetch->requested_at) < FINANCIALS_FETCH_RETRY_DELAY)
+            return;
+
+        if (fetch)
+            fetch->requested_at = time_current();
+        else
+            array_push(_financials->fetches, (financials_fetch_t{ key, time_current() }));
+    }
 
-        sheet.researchDevelopment = e["researchDevelopment"].as_number();
-        sheet.effectOfAccountingCharges = e["effectOfAccountingCharges"].as_number();
-        sheet.incomeBeforeTax = e["incomeBeforeTax"].as_number();
-        sheet.minorityInterest = e["minorityInterest"].as_number();
-        sheet.netIncome = e["netIncome"].as_number();
-        sheet.sellingGeneralAdministrative = e["sellingGeneralAdministrative"].as_number();
-        sheet.sellingAndMarketingExpenses = e["sellingAndMarketingExpenses"].as_number();
-        sheet.grossProfit = e["grossProfit"].as_number();
-        sheet.reconciledDepreciation = e["reconciledDepreciation"].as_number();
-        sheet.ebit = e["ebit"].as_number();
-        sheet.ebitda = e["ebitda"].as_number();
-        sheet.depreciationAndAmortization = e["depreciationAndAmortization"].as_number();
-        sheet.nonOperatingIncomeNetOther = e["nonOperatingIncomeNetOther"].as_number();
-        sheet.operatingIncome = e["operatingIncome"].as_number();
-        sheet.otherOperatingExpenses = e["otherOperatingExpenses"].as_number();
-        sheet.interestExpense = e["interestExpense"].as_number();
-        sheet.taxProvision = e["taxProvision"].as_number();
-        sheet.interestIncome = e["interestIncome"].as_number();
-        sheet.netInterestIncome = e["netInterestIncome"].as_number();
-        sheet.extraordinaryItems = e["extraordinaryItems"].as_number();
-        sheet.nonRecurring = e["nonRecurring"].as_number();
-        sheet.otherItems = e["otherItems"].as_number();
-        sheet.incomeTaxExpense = e["incomeTaxExpense"].as_number();
-        sheet.totalRevenue = e["totalRevenue"].as_number();
-        sheet.totalOperatingExpenses = e["totalOperatingExpenses"].as_number();
-        sheet.costOfRevenue = e["costOfRevenue"].as_number();
-        sheet.totalOtherIncomeExpenseNet = e["totalOtherIncomeExpenseNet"].as_number();
-        sheet.discontinuedOperations = e["discontinuedOperations"].as_number();
-        sheet.netIncomeFromContinuingOps = e["netIncomeFromContinuingOps"].as_number();
-        sheet.netIncomeApplicableToCommonShares = e["netIncomeApplicableToCommonShares"].as_number();
-        sheet.preferredStockAndOtherAdjustments = e["preferredStockAndOtherAdjustments"].as_number();
-
-        array_push_memcpy(sheets, &sheet);
-    }
-
-    // Sort by date
-    array_sort(sheets, ARRAY_COMPARE_EXPRESSION(a.date - b.date));
-    return sheets;
-}
-
-
-FOUNDATION_STATIC void financials_fetch_data(financials_window_t* window, const json_object_t& json)
+    char ticker[32];
+    string_copy(STRING_BUFFER(ticker), symbol, symbol_length);
+    if (!eod_fetch_async("fundamentals", ticker, FORMAT_JSON_CACHE, [ticker](const json_object_t& json)
+    {
+        financials_store_build_from_json(ticker, string_length(ticker), json);
+    }, FINANCIALS_FUNDAMENTALS_CACHE_MAX_AGE))
+    {
+        log_warnf(HASH_FINANCIALS, WARNING_RESOURCE, STRING_CONST("Failed to fetch %.*s financials data"), (int)symbol_length, symbol);
+    }
+}
+
+/*! Returns the symbol statement store if available and fetches it in the background if missing or expired. */
+FOUNDATION_STATIC const financials_store_t* financials_store_request(const char* symbol, size_t symbol_length)
+{
+    const financials_store_t* store = financials_store_load(symbol, symbol_length);
+    if (store == nullptr || financials_store_expired(store))
+        financials_store_fetch_async(symbol, symbol_length);
+
+    return store;
+}
+
+FOUNDATION_STATIC void financials_window_set_store(financials_window_t* window, const financials_store_t* store)
 {
     FOUNDATION_ASSERT(window);
 
-    MEMORY_TRACKER(HASH_FINANCIALS);
+    if (store == nullptr)
+        return;
 
-    window->balances = financials_fetch_balance_sheets(json);
-    window->cash_flows = financials_fetch_cash_flows(json);
-    window->incomes = financials_fetch_incomes(json);
-    
     // Compute sheets min and max dates
-    const unsigned int num_sheets = array_size(window->balances);
-    if (num_sheets > 0)
+    const financial_statement_t& balances = store->statements[FINANCIAL_BALANCE_SHEET][FINANCIAL_QUARTERLY];
+    if (balances.count > 0)
     {
-        window->min_date = window->balances[0].date;
-        window->max_date = window->balances[num_sheets - 1].date;
+        window->min_date = balances.dates[0];
+        window->max_date = balances.dates[balances.count - 1];
         window->auto_fit = true;
     }
+
+    window->store = store;
 }
 
 FOUNDATION_STATIC financials_window_t* financials_window_allocate(const char* symbol, size_t symbol_length)
@@ -742,13 +894,10 @@ FOUNDATION_STATIC financials_window_t* financials_window_allocate(const char* sy
 
     string_copy(STRING_BUFFER(window->symbol), symbol, symbol_length);
     string_format(STRING_BUFFER(window->title), STRING_CONST("Financials %.*s"), (int)symbol_length, symbol);
-    
-    if (!eod_fetch_async("fundamentals", symbol, FORMAT_JSON_CACHE, L1(financials_fetch_data(window, _1))))
-    {
-        log_warnf(HASH_FINANCIALS, WARNING_RESOURCE, 
-            STRING_CONST("Failed to fetch %*.s financials data"), (int)symbol_length, symbol);
-    }
+    window->key = string_hash(symbol, symbol_length);
 
+    // The window picks up the store once it gets built if it needs to be fetched first.
+    financials_window_set_store(window, financials_store_request(symbol, symbol_length));
     return window;
 }
 
@@ -757,30 +906,23 @@ FOUNDATION_STATIC void financials_window_deallocate(window_handle_t win)
     auto* window = (financials_window_t*)window_get_user_data(win);
     FOUNDATION_ASSERT(window);
 
-    array_deallocate(window->balances);
-    array_deallocate(window->cash_flows);
-    array_deallocate(window->incomes);
-
     MEM_DELETE(window);
 }
 
-template<typename T>
-FOUNDATION_STATIC bool financials_sheet_has_data_for_field(T* sheets, size_t field_offset)
+FOUNDATION_STATIC bool financials_statement_has_data_for_field(const financial_statement_t& statement, unsigned field)
 {
-    // For each sheet
-    for (size_t i = 0, end = array_size(sheets); i != end; ++i)
+    const double* column = financials_statement_column(statement, field);
+    for (unsigned i = 0; i < statement.count; ++i)
     {
-        T* sheet = sheets + i;
-        const double value = *(double*)(((const uint8_t*)sheet) + field_offset);
-        if (math_real_is_finite(value))
+        if (math_real_is_finite(column[i]))
             return true;
     }
 
     return false;
 }
 
-template<typename S, typename T, size_t N>
-FOUNDATION_STATIC bool financials_render_sheet_selector(const char* label, const S* sheets, T (&indicators)[N])
+template<typename T, size_t N>
+FOUNDATION_STATIC bool financials_render_sheet_selector(const char* label, const financial_statement_t& statement, T (&indicators)[N])
 {
     bool updated = false;
 
@@ -820,11 +962,9 @@ FOUNDATION_STATIC bool financials_render_sheet_selector(const char* label, const
         for (int i = 0; i != N; ++i)
         {
             auto& c = indicators[i];
-            if (c.plot_fn == nullptr)
-                continue;
 
             // Check if we have any data for that indicator
-            if (!financials_sheet_has_data_for_field(sheets, c.field_offset))
+            if (!financials_statement_has_data_for_field(statement, i))
                 continue;
                 
             string_const_t ex_id = tr(STRING_ARGS(c.name), false);
@@ -848,25 +988,33 @@ FOUNDATION_STATIC void financials_window_render(window_handle_t win)
     auto* window = (financials_window_t*)window_get_user_data(win);
     FOUNDATION_ASSERT(window);
 
-    if (array_empty(window->balances))
+    if (window->store == nullptr)
+        financials_window_set_store(window, financials_store_find(window->key));
+
+    const financials_store_t* store = window->store;
+    if (store == nullptr || store->statements[FINANCIAL_BALANCE_SHEET][FINANCIAL_QUARTERLY].count == 0)
         return ImGui::TrTextWrapped("No financial sheets to display");
 
+    const financial_statement_t& balances = store->statements[FINANCIAL_BALANCE_SHEET][FINANCIAL_QUARTERLY];
+    const financial_statement_t& incomes = store->statements[FINANCIAL_INCOME_STATEMENT][FINANCIAL_QUARTERLY];
+    const financial_statement_t& cash_flows = store->statements[FINANCIAL_CASH_FLOW][FINANCIAL_QUARTERLY];
+
     if (ImGui::Checkbox("##BalanceCheck", &window->show_balance_values))
         window->auto_fit = true;
     ImGui::SameLine();
-    if (financials_render_sheet_selector(tr("Balance"), window->balances, BALANCE_FIELDS))
+    if (financials_render_sheet_selector(tr("Balance"), balances, BALANCE_FIELDS))
         window->auto_fit = true;
 
     if (ImGui::Checkbox("##IncomeCheck", &window->show_income_values))
         window->auto_fit = true;
     ImGui::SameLine();
-    if (financials_render_sheet_selector(tr("Incomes"), window->incomes, INCOME_FIELDS))
+    if (financials_render_sheet_selector(tr("Incomes"), incomes, INCOME_FIELDS))
         window->auto_fit = true;
 
     if (ImGui::Checkbox("##CashFlowCheck", &window->show_cash_flow_values))
         window->auto_fit = true;
     ImGui::SameLine();
-    if (financials_render_sheet_selector(tr("Cash Flow"), window->cash_flows, CASH_FLOW_FIELDS))
+    if (financials_render_sheet_selector(tr("Cash Flow"), cash_flows, CASH_FLOW_FIELDS))
         window->auto_fit = true;
 
     if (window->auto_fit && window->rendered_once)
@@ -952,11 +1100,11 @@ FOUNDATION_STATIC void financials_window_render(window_handle_t win)
         for (int i = 0; i < ARRAY_COUNT(CASH_FLOW_FIELDS); ++i)
         {
             const auto& c = CASH_FLOW_FIELDS[i];
-            if (!c.selected || c.plot_fn == nullptr)
+            if (!c.selected)
                 continue;
 
-            const auto record_count = array_size(window->cash_flows);
-            ImPlot::PlotBarsG(c.name.str, c.plot_fn, (void*)window->cash_flows, to_int(record_count), bar_size, ImPlotBarsFlags_None);
+            financials_plot_context_t plot_context{ cash_flows.dates, financials_statement_column(cash_flows, i) };
+            ImPlot::PlotBarsG(c.name.str, financials_plot_column, &plot_context, to_int(cash_flows.count), bar_size, ImPlotBarsFlags_None);
         }
     }
 
@@ -966,11 +1114,11 @@ FOUNDATION_STATIC void financials_window_render(window_handle_t win)
         for (int i = 0; i < ARRAY_COUNT(INCOME_FIELDS); ++i)
         {
             const auto& c = INCOME_FIELDS[i];
-            if (!c.selected || c.plot_fn == nullptr)
+            if (!c.selected)
                 continue;
 
-            const auto record_count = array_size(window->incomes);
-            ImPlot::PlotLineG(c.name.str, c.plot_fn, (void*)window->incomes, to_int(record_count), ImPlotLineFlags_SkipNaN);
+            financials_plot_context_t plot_context{ incomes.dates, financials_statement_column(incomes, i) };
+            ImPlot::PlotLineG(c.name.str, financials_plot_column, &plot_context, to_int(incomes.count), ImPlotLineFlags_SkipNaN);
         }
     }
 
@@ -980,11 +1128,11 @@ FOUNDATION_STATIC void financials_window_render(window_handle_t win)
         for (int i = 0; i < ARRAY_COUNT(BALANCE_FIELDS); ++i)
         {
             const auto& c = BALANCE_FIELDS[i];
-            if (!c.selected || c.plot_fn == nullptr)
+            if (!c.selected)
                 continue;
 
-            const auto record_count = array_size(window->balances);
-            ImPlot::PlotLineG(c.name.str, c.plot_fn, (void*)window->balances, to_int(record_count), ImPlotLineFlags_SkipNaN);
+            financials_plot_context_t plot_context{ balances.dates, financials_statement_column(balances, i) };
+            ImPlot::PlotLineG(c.name.str, financials_plot_column, &plot_context, to_int(balances.count), ImPlotLineFlags_SkipNaN);
         }
     }
     
@@ -996,6 +1144,36 @@ FOUNDATION_STATIC void financials_window_render(window_handle_t win)
 // # PUBLIC API
 //
 
+bool financials_get_column(
+    const char* symbol, size_t symbol_length,
+    financial_statement_type_t statement, financial_period_t period,
+    const char* field, size_t field_length,
+    financial_column_t* out_column)
+{
+    FOUNDATION_ASSERT(statement < FINANCIAL_STATEMENT_COUNT && period < FINANCIAL_PERIOD_COUNT);
+
+    const int field_index = financials_field_index(statement, field, field_length);
+    if (field_index < 0)
+        return false;
+
+    const financials_store_t* store = financials_store_request(symbol, symbol_length);
+    if (store == nullptr)
+        return false;
+
+    const financial_statement_t& s = store->statements[statement][period];
+    if (s.count == 0 || !financials_statement_has_data_for_field(s, field_index))
+        return false;
+
+    if (out_column)
+    {
+        out_column->count = s.count;
+        out_column->dates = s.dates;
+        out_column->values = financials_statement_column(s, field_index);
+    }
+
+    return true;
+}
+
 void financials_open_window(const char* symbol, size_t symbol_length)
 {
     auto* window = financials_window_allocate(symbol, symbol_length);
@@ -1007,4 +1185,112 @@ void financials_open_window(const char* symbol, size_t symbol_length)
 // # SYSTEM
 //
 
-DEFINE_MODULE(FINANCIALS, [](){}, nullptr, MODULE_PRIORITY_UI);
+/*! Parse a field name optionally prefixed by its statement, i.e. cash_flow.netIncome.
+ *
+ *  Fields reported in more than one statement without any prefix are read from the
+ *  first statement of #FINANCIALS_STATEMENT_LOOKUP_ORDER that reports them.
+ *
+ *  @return The statement prefix or #FINANCIAL_STATEMENT_COUNT if the field has no prefix.
+ */
+FOUNDATION_STATIC financial_statement_type_t financials_expr_parse_field(string_const_t& field)
+{
+    static const struct { string_const_t prefix; financial_statement_type_t statement; } STATEMENT_PREFIXES[] = {
+        { CTEXT("balance"), FINANCIAL_BALANCE_SHEET },
+        { CTEXT("cash_flow"), FINANCIAL_CASH_FLOW },
+        { CTEXT("income"), FINANCIAL_INCOME_STATEMENT },
+    };
+
+    const size_t sep = string_find(STRING_ARGS(field), '.', 0);
+    if (sep == STRING_NPOS)
+        return FINANCIAL_STATEMENT_COUNT;
+
+    for (const auto& p : STATEMENT_PREFIXES)
+    {
+        if (string_equal_nocase(field.str, sep, STRING_ARGS(p.prefix)))
+        {
+            field = string_const(field.str + sep + 1, field.length - sep - 1);
+            return p.statement;
+        }
+    }
+
+    throw ExprError(EXPR_ERROR_INVALID_ARGUMENT, "Invalid statement %.*s, expected balance, cash_flow or income", (int)sep, field.str);
+}
+
+/*! Statements searched for fields without a statement prefix, i.e. netIncome is read from the income statement. */
+static const financial_statement_type_t FINANCIALS_STATEMENT_LOOKUP_ORDER[] = {
+    FINANCIAL_INCOME_STATEMENT, FINANCIAL_BALANCE_SHEET, FINANCIAL_CASH_FLOW
+};
+
+FOUNDATION_STATIC expr_result_t financials_expr_eval_field(const expr_func_t* f, vec_expr_t* args, void* c)
+{
+    FOUNDATION_UNUSED(f, c);
+
+    // Examples: FINANCIALS(AAPL.US, totalAssets)
+    //           FINANCIALS(AAPL.US, freeCashFlow, yearly)
+    //           MAP(FINANCIALS(U.US, netIncome), $2)
+    //           FINANCIALS(U.US, cash_flow.netIncome, yearly)
+
+    if (args->len < 2 || args->len > 3)
+        throw ExprError(EXPR_ERROR_INVALID_ARGUMENT, "Invalid arguments");
+
+    string_const_t symbol = expr_eval(args->get(0)).as_string();
+    string_const_t field = expr_eval(args->get(1)).as_string();
+
+    financial_period_t period = FINANCIAL_QUARTERLY;
+    if (args->len == 3)
+    {
+        string_const_t period_name = expr_eval(args->get(2)).as_string();
+        if (string_equal_nocase(STRING_ARGS(period_name), STRING_CONST("yearly")))
+            period = FINANCIAL_YEARLY;
+        else if (!string_equal_nocase(STRING_ARGS(period_name), STRING_CONST("quarterly")))
+            throw ExprError(EXPR_ERROR_INVALID_ARGUMENT, "Invalid period %.*s, expected quarterly or yearly", STRING_FORMAT(period_name));
+    }
+
+    const financial_statement_type_t field_statement = financials_expr_parse_field(field);
+
+    // Statements all come from the same store, which gets fetched in the background if it is not available yet.
+    if (financials_store_request(STRING_ARGS(symbol)) == nullptr)
+        return NIL;
+
+    for (const financial_statement_type_t s : FINANCIALS_STATEMENT_LOOKUP_ORDER)
+    {
+        if (field_statement != FINANCIAL_STATEMENT_COUNT && field_statement != s)
+            continue;
+
+        financial_column_t column;
+        if (!financials_get_column(STRING_ARGS(symbol), s, period, STRING_ARGS(field), &column))
+            continue;
+
+        expr_result_t* results = nullptr;
+        array_reserve(results, column.count);
+        for (unsigned i = 0; i < column.count; ++i)
+            array_push(results, expr_eval_pair((double)column.dates[i], column.values[i]));
+        return expr_eval_list(results);
+    }
+
+    return NIL;
+}
+
+FOUNDATION_STATIC void financials_initialize()
+{
+    _financials = MEM_NEW(HASH_FINANCIALS, FINANCIALS_MODULE);
+    _financials->lock = mutex_allocate(STRING_CONST("Financials"));
+
+    expr_register_function("FINANCIALS", financials_expr_eval_field);
+}
+
+FOUNDATION_STATIC void financials_shutdown()
+{
+    for (unsigned i = 0, end = array_size(_financials->stores); i < end; ++i)
+        financials_store_deallocate(_financials->stores[i]);
+    array_deallocate(_financials->stores);
+    for (unsigned i = 0, end = array_size(_financials->retired_stores); i < end; ++i)
+        financials_store_deallocate(_financials->retired_stores[i]);
+    array_deallocate(_financials->retired_stores);
+    array_deallocate(_financials->fetches);
+    mutex_deallocate(_financials->lock);
+
+    MEM_DELETE(_financials);
+}
+
+DEFINE_MODULE(FINANCIALS, financials_initialize, financials_shutdown, MODULE_PRIORITY_UI);
@@ -1,10 +1,66 @@
 /*
  * Copyright 2023 Wiimag Inc. All rights reserved.
  * License: https://wiimag.com/LICENSE
+ *
+ * The financials module manages per symbol financial statement stores.
+ * Each store keeps one dense column of values per accounting field across
+ * quarterly and yearly periods. Stores are built once from the cached fundamentals,
+ * persisted in a compact binary form and shared by the financials window and expressions.
  */
 
 #pragma once
 
 #include <foundation/platform.h>
 
+typedef enum {
+    FINANCIAL_BALANCE_SHEET = 0,
+    FINANCIAL_CASH_FLOW,
+    FINANCIAL_INCOME_STATEMENT,
+
+    FINANCIAL_STATEMENT_COUNT
+} financial_statement_type_t;
+
+typedef enum {
+    FINANCIAL_QUARTERLY = 0,
+    FINANCIAL_YEARLY,
+
+    FINANCIAL_PERIOD_COUNT
+} financial_period_t;
+
+/*! Read only view over a statement field column. */
+struct financial_column_t
+{
+    unsigned      count{ 0 };
+    const time_t* dates{ nullptr };  // Period dates ordered from older to newer
+    const double* values{ nullptr }; // Field values for each period, NAN if not reported
+};
+
+/*! Get the column of values of a financial statement field.
+ *
+ *  @remark The fundamentals of the symbol are fetched in the background on the first request
+ *          and again once its statements expire, so this never blocks on the network.
+ *          Until the statements are built, no column is returned.
+ *          The returned column remains valid until the module shuts down.
+ *
+ *  @param symbol        Stock symbol
+ *  @param symbol_length Length of the stock symbol
+ *  @param statement     Financial statement containing the field
+ *  @param period        Quarterly or yearly statements
+ *  @param field         Fundamentals field name, i.e. "totalAssets"
+ *  @param field_length  Length of the field name
+ *  @param out_column    Column view to fill
+ *
+ *  @return True if the symbol has values for that field.
+ */
+bool financials_get_column(
+    const char* symbol, size_t symbol_length,
+    financial_statement_type_t statement, financial_period_t period,
+    const char* field, size_t field_length,
+    financial_column_t* out_column);
+
+/*! Open the financials window for the given symbol.
+ *
+ *  @param symbol        Stock symbol
+ *  @param symbol_length Length of the stock symbol
+ */
 void financials_open_window(const char* symbol, size_t symbol_length);
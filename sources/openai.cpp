@@ -19,6 +19,7 @@
 #include <framework/config.h>
 #include <framework/string_builder.h>
 #include <framework/localization.h>
+#include <framework/epoch.h>
 #include <framework/jobs.h>
 #include <framework/dispatcher.h>
 
@@ -497,8 +498,19 @@ const openai_response_t* openai_generate_news_sentiment(
             return -1;
         }
 
-        const day_result_t* ed = stock_get_EOD((const stock_t*)stock, response->dateref, true);
-        if (!ed)
+        bool has_price_data = false;
+        double stock_price_change_that_day = DNAN;
+        {
+            EPOCH_SCOPE();
+            const day_result_t* ed = stock_get_EOD((const stock_t*)stock, response->dateref, true);
+            if (ed)
+            {
+                has_price_data = true;
+                stock_price_change_that_day = ed->change_p;
+            }
+        }
+
+        if (!has_price_data)
         {
             response->success = false;
             response->output = string_clone(STRING_CONST("Failed to fetch stock price data"));
@@ -506,7 +518,6 @@ const openai_response_t* openai_generate_news_sentiment(
         }
 
         string_const_t name = SYMBOL_CONST(stock->name);
-        const double stock_price_change_that_day = ed->change_p;
         
         string_const_t fmttr = tr(STRING_CONST("Resume the following article %.*s ; "
             "explain why it is related to %.*s and share any sentiment regarding the price change of %.3g%% "
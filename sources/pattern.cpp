@@ -668,6 +668,8 @@ FOUNDATION_STATIC const stock_t* pattern_refresh(pattern_t* pattern, FetchLevel
 
     if (minimal_required_levels != FetchLevel::NONE)
     {
+        if (any(minimal_required_levels, FetchLevel::REALTIME))
+            stock_flush_real_time_requests();
         tick_t timeout = time_current();
         while (!pattern->stock->has_resolve(minimal_required_levels) && time_elapsed(timeout) < 10)
             dispatcher_wait_for_wakeup_main_thread();
@@ -740,13 +742,14 @@ FOUNDATION_STATIC double pattern_average_volume_3months(pattern_t* pattern)
 
     double occurence = 0;
     double total_volume = 0;
-    for (unsigned i = 0, end = min(SIZE_C(60), s->history_count); i < end; ++i)
+    const day_result_t* history = s->history;
+    for (unsigned i = 0, end = min(60U, array_size(history)); i < end; ++i)
     {
-        if (s->history[i].volume == 0)
+        if (history[i].volume == 0)
             continue;
 
         occurence += 1.0;
-        total_volume += s->history[i].volume;
+        total_volume += history[i].volume;
     }
 
     pattern->average_volume_3months = total_volume / occurence;
@@ -1060,7 +1063,8 @@ FOUNDATION_STATIC void pattern_render_graph_trends(pattern_t* pattern, pattern_g
     if (s->has_resolve(FetchLevel::TECHNICAL_SLOPE | FetchLevel::TECHNICAL_CCI))
     {
         ImPlot::SetAxis(ImAxis_Y1);
-        plot_context_t c{ trend_date, min(s->history_count, iteration_count), 1, s->history };
+        const day_result_t* history = s->history;
+        plot_context_t c{ trend_date, min((size_t)array_size(history), iteration_count), 1, history };
         c.compacted = graph.compact;
         c.show_equation = pattern->show_trend_equation || graph.show_equation;
         c.lx = 0.0;
@@ -1258,7 +1262,9 @@ FOUNDATION_STATIC float pattern_render_decisions(pattern_t* pattern)
 FOUNDATION_STATIC void pattern_render_graph_change_high(pattern_t* pattern, const stock_t* s)
 {
     const size_t max_render_count = 1024;
-    plot_context_t c{ pattern->date, s->history_count, (s->history_count / max_render_count) + 1, s->history };
+    const day_result_t* history = s->history;
+    const size_t history_count = array_size(history);
+    plot_context_t c{ pattern->date, history_count, (history_count / max_render_count) + 1, history };
     c.show_equation = pattern->show_trend_equation;
     ImPlot::PlotLineG("Flex H", [](int idx, void* user_data)->ImPlotPoint
     {
@@ -1270,13 +1276,15 @@ FOUNDATION_STATIC void pattern_render_graph_change_high(pattern_t* pattern, cons
         double x = math_round((c->ref - ed->date) / (double)time_one_day());
         double y = ed->change_p_high;
         return ImPlotPoint(x, y);
-    }, & c, (int)min(s->history_count, max_render_count), ImPlotLineFlags_Shaded);
+    }, & c, (int)min(history_count, max_render_count), ImPlotLineFlags_Shaded);
 }
 
 FOUNDATION_STATIC void pattern_render_graph_change(pattern_t* pattern, const stock_t* s)
 {
     const size_t max_render_count = 1024;
-    plot_context_t c{ pattern->date, s->history_count, (s->history_count / max_render_count) + 1, s->history };
+    const day_result_t* history = s->history;
+    const size_t history_count = array_size(history);
+    plot_context_t c{ pattern->date, history_count, (history_count / max_render_count) + 1, history };
     c.show_equation = pattern->show_trend_equation;
     ImPlot::PlotLineG("Flex L", [](int idx, void* context)->ImPlotPoint
     {
@@ -1288,13 +1296,14 @@ FOUNDATION_STATIC void pattern_render_graph_change(pattern_t* pattern, const sto
         double x = math_round((c->ref - ed->date) / (double)time_one_day());
         double y = ed->change_p;
         return ImPlotPoint(x, y);
-    }, & c, (int)min(s->history_count, max_render_count), ImPlotLineFlags_Shaded);
+    }, & c, (int)min(history_count, max_render_count), ImPlotLineFlags_Shaded);
 }
 
 FOUNDATION_STATIC void pattern_render_graph_change_acc(pattern_t* pattern, const stock_t* s)
 {
     ImPlot::HideNextItem(true, ImPlotCond_Once);
-    plot_context_t c{ pattern->date, min(s->history_count, (size_t)pattern->range), 1, s->history, 0.0 };
+    const day_result_t* history = s->history;
+    plot_context_t c{ pattern->date, min((size_t)array_size(history), (size_t)pattern->range), 1, history, 0.0 };
     c.show_equation = pattern->show_trend_equation;
     ImPlot::PlotLineG("% Acc.", [](int idx, void* context)->ImPlotPoint
     {
@@ -1318,7 +1327,8 @@ FOUNDATION_STATIC void pattern_render_graph_change_acc(pattern_t* pattern, const
 
 FOUNDATION_STATIC void pattern_render_graph_day_value(const char* label, pattern_t* pattern, const stock_t* s, ImAxis y_axis, size_t offset, bool relative_dates = true)
 {
-    plot_context_t c{ pattern->date, min((size_t)4096, s->history_count), offset, s->history };
+    const day_result_t* history = s->history;
+    plot_context_t c{ pattern->date, min((size_t)4096, (size_t)array_size(history)), offset, history };
     c.show_equation = pattern->show_trend_equation;
     c.acc = pattern->range;
     c.mouse_pos = ImPlot::GetPlotMousePos();
@@ -1354,7 +1364,8 @@ FOUNDATION_STATIC void pattern_render_graph_day_value(const char* label, pattern
 
 FOUNDATION_STATIC void pattern_render_graph_price(pattern_t* pattern, const stock_t* s, ImAxis y_axis)
 {
-    plot_context_t c{ pattern->date, min(size_t(8096), s->history_count), 1, s->history };
+    const day_result_t* history = s->history;
+    plot_context_t c{ pattern->date, min(size_t(8096), (size_t)array_size(history)), 1, history };
     c.show_equation = pattern->show_trend_equation;
     c.acc = pattern->range;
     c.cursor_xy1 = { DBL_MAX, DNAN };
@@ -2142,9 +2153,10 @@ FOUNDATION_STATIC void pattern_render_graph_price(pattern_t* pattern, pattern_gr
     ImPlot::TagY(s->dma_50, ImColor::HSV(339 / 360.0f, 0.63f, 1.0f), "DMA");
     ImPlot::TagY(s->ws_target, ImColor::HSV(349 / 360.0f, 0.63f, 1.0f), "WS");
 
-    if (s->history_count > 1)
+    const day_result_t* history = s->history;
+    if (array_size(history) > 1)
     {
-        double sd = s->history[0].slope - s->history[1].slope;
+        double sd = history[0].slope - history[1].slope;
         ImPlot::TagY(s->current.adjusted_close + s->current.adjusted_close * sd, ImColor::HSV(239 / 360.0f, 0.73f, 1.0f), "PS %.2lf $", s->current.adjusted_close * sd);
     }
 
@@ -1,6 +1,15 @@
 /*
  * Copyright 2023 Wiimag Inc. All rights reserved.
  * License: https://wiimag.com/LICENSE
+ *
+ * Realtime stock records are appended to a journal for the current day.
+ * Journals of previous days are sealed in the background into daily segment files that
+ * store a symbol dictionary and the delta encoded records of each symbol. Segments are
+ * memory mapped at startup and only their footer index is read until a graph needs records.
+ *
+ * The latest ticks of each tracked symbol are also pushed to a fixed capacity ring with
+ * precomputed rolling aggregates. Rings are never moved nor released before shutdown and
+ * readers copy them without locking, retrying when the writer changed them meanwhile.
  */
  
 #include "realtime.h"
@@ -21,22 +30,113 @@
 #include <framework/string.h>
 #include <framework/array.h>
 #include <framework/generics.h>
+#include <framework/system.h>
+#include <framework/epoch.h>
+#include <framework/expr.h>
 
 #include <foundation/fs.h>
+#include <foundation/atomic.h>
+#include <foundation/hashtable.h>
+#include <foundation/path.h>
 #include <foundation/stream.h>
 #include <foundation/thread.h>
 
 #include <algorithm>
 
 #define REALTIME_STREAM_VERSION (1)
+#define REALTIME_SEGMENT_VERSION (1)
+#define REALTIME_SEGMENT_PRICE_SCALE (1e6)
+#define REALTIME_RETENTION_DAYS (31)
+#define REALTIME_RING_CAPACITY (1024U) // Must be a power of two
 #define HASH_REALTIME static_hash_string("realtime", 8, 0x29e09dfa4716c805ULL)
 
+/*! Record layout of the day journals and of the legacy realtime stream. */
+struct realtime_journal_record_t
+{
+    time_t timestamp;
+    char   code[16];
+    double price;
+    double volume;
+};
+static_assert(sizeof(realtime_journal_record_t) == 40, "Journal records must match the legacy stream layout");
+
+FOUNDATION_ALIGNED_STRUCT(realtime_segment_header_t, 8)
+{
+    char     magic[4] = { 0 };
+    uint32_t version = 0;
+    int64_t  day = 0;              // Days since epoch (UTC)
+    uint32_t symbol_count = 0;
+    uint32_t record_count = 0;
+    uint64_t footer_offset = 0;
+};
+
+/*! Footer entry of a segment. The footer is the segment symbol dictionary,
+ *  sorted by symbol key, and it gives the byte range of the encoded records of each symbol.
+ */
+FOUNDATION_ALIGNED_STRUCT(realtime_segment_symbol_t, 8)
+{
+    hash_t   key;
+    char     code[16];
+    uint64_t offset;
+    uint32_t size;
+    uint32_t count;
+    int64_t  first_timestamp;
+    int64_t  last_timestamp;
+    double   last_price;
+    double   last_volume;
+};
+
+struct realtime_segment_t
+{
+    int64_t                          day{ 0 };
+    size_t                           size{ 0 };
+    const uint8_t*                   data{ nullptr };
+    const realtime_segment_header_t* header{ nullptr };
+    const realtime_segment_symbol_t* symbols{ nullptr };
+};
+
+struct realtime_seal_record_t
+{
+    int64_t                   day;
+    hash_t                    key;
+    realtime_journal_record_t record;
+};
+
+/*! Latest ticks of a symbol.
+ *
+ *  Only one writer at a time pushes ticks, writers are serialized by the stocks mutex.
+ *  The sequence is odd while the writer updates the ring.
+ */
+struct realtime_ring_t
+{
+    hash_t           key{ 0 };
+    atomic32_t       sequence{};
+    uint32_t         count{ 0 };    // Ticks in the ring
+    uint64_t         head{ 0 };     // Ticks ever pushed, the next tick goes to head % capacity
+    realtime_stats_t stats{};
+
+    // Only used by the writer
+    double           price_volume_sum{ 0 };
+    double           volume_sum{ 0 };
+
+    stock_realtime_record_t ticks[REALTIME_RING_CAPACITY];
+};
+
 static struct REALTIME_MODULE {
-    stream_t* stream{ nullptr };
+    stream_t* journal{ nullptr };
+    int64_t   journal_day{ 0 };
+    int64_t   compacted_day{ 0 };
     thread_t* background_thread{ nullptr };
 
-    shared_mutex      stocks_mutex;
-    stock_realtime_t* stocks{ nullptr };
+    shared_mutex         stocks_mutex;
+    stock_realtime_t*    stocks{ nullptr };
+    realtime_segment_t** segments{ nullptr }; // Sorted by day
+
+    realtime_ring_t**    rings{ nullptr };        // Only modified with the stocks mutex locked for writing
+    atomicptr_t          ring_table{ nullptr };   // Ring of each symbol key, replaced when growing
+    size_t               ring_table_capacity{ 0 };
+
+    stock_realtime_record_t* graph_records{ nullptr };
 
     bool show_window{ false };
     table_t* table{ nullptr };
@@ -59,6 +159,265 @@ FOUNDATION_FORCEINLINE bool operator>(const stock_realtime_t& s, const hash_t& k
     return s.key > key;
 }
 
+FOUNDATION_FORCEINLINE bool operator<(const realtime_segment_symbol_t& s, const hash_t& key)
+{
+    return s.key < key;
+}
+
+FOUNDATION_FORCEINLINE bool operator>(const realtime_segment_symbol_t& s, const hash_t& key)
+{
+    return s.key > key;
+}
+
+FOUNDATION_FORCEINLINE bool operator<(const stock_realtime_record_t& r, const time_t& key)
+{
+    return r.timestamp < key;
+}
+
+FOUNDATION_FORCEINLINE bool operator>(const stock_realtime_record_t& r, const time_t& key)
+{
+    return r.timestamp > key;
+}
+
+FOUNDATION_FORCEINLINE int64_t realtime_day(time_t timestamp)
+{
+    return (int64_t)timestamp / (int64_t)time_one_day();
+}
+
+FOUNDATION_FORCEINLINE uint64_t realtime_zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+FOUNDATION_FORCEINLINE int64_t realtime_zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+FOUNDATION_STATIC void realtime_encode_varint(uint8_t*& buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        array_push(buffer, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    array_push(buffer, (uint8_t)value);
+}
+
+FOUNDATION_FORCEINLINE const uint8_t* realtime_decode_varint(const uint8_t* p, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+    {
+        const uint8_t b = *p++;
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return p;
+    }
+    return nullptr;
+}
+
+//
+// # RINGS
+//
+
+FOUNDATION_EXTERN realtime_ring_t* realtime_ring_allocate(hash_t key)
+{
+    realtime_ring_t* ring = MEM_NEW(HASH_REALTIME, realtime_ring_t);
+    ring->key = key;
+    return ring;
+}
+
+FOUNDATION_EXTERN void realtime_ring_deallocate(realtime_ring_t*& ring)
+{
+    MEM_DELETE(ring);
+}
+
+/*! Recompute the ring aggregates from all its ticks.
+ *  Running sums are also refreshed so they do not drift as ticks get evicted.
+ */
+FOUNDATION_STATIC void realtime_ring_aggregate(realtime_ring_t* ring)
+{
+    realtime_stats_t& stats = ring->stats;
+    stats.min = stats.max = NAN;
+    ring->price_volume_sum = ring->volume_sum = 0;
+    for (uint32_t i = 0; i < ring->count; ++i)
+    {
+        const stock_realtime_record_t& t = ring->ticks[(ring->head - ring->count + i) & (REALTIME_RING_CAPACITY - 1)];
+        stats.min = i == 0 ? t.price : min(stats.min, t.price);
+        stats.max = i == 0 ? t.price : max(stats.max, t.price);
+        ring->price_volume_sum += t.price * t.volume;
+        ring->volume_sum += t.volume;
+    }
+}
+
+/*! Push a tick to the ring and update its aggregates.
+ *
+ *  @remark Ticks that are not newer than the last one are ignored.
+ *
+ *  @return True if the tick was pushed.
+ */
+FOUNDATION_EXTERN bool realtime_ring_push(realtime_ring_t* ring, const stock_realtime_record_t& tick)
+{
+    constexpr uint32_t mask = REALTIME_RING_CAPACITY - 1;
+    if (ring->count > 0 && ring->ticks[(ring->head - 1) & mask].timestamp >= tick.timestamp)
+        return false;
+
+    const int32_t sequence = atomic_load32(&ring->sequence, memory_order_relaxed);
+    atomic_store32(&ring->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence_release();
+
+    realtime_stats_t& stats = ring->stats;
+    stock_realtime_record_t& slot = ring->ticks[ring->head & mask];
+
+    // Evicting the current min or max requires scanning the ring again.
+    bool rescan = false;
+    if (ring->count == REALTIME_RING_CAPACITY)
+    {
+        ring->price_volume_sum -= slot.price * slot.volume;
+        ring->volume_sum -= slot.volume;
+        rescan = slot.price <= stats.min || slot.price >= stats.max;
+    }
+    else
+    {
+        ring->count++;
+    }
+
+    const double previous_price = stats.price;
+    slot = tick;
+    ring->head++;
+
+    if (rescan || (ring->head & mask) == 0)
+    {
+        realtime_ring_aggregate(ring);
+    }
+    else
+    {
+        stats.min = ring->count == 1 ? tick.price : min(stats.min, tick.price);
+        stats.max = ring->count == 1 ? tick.price : max(stats.max, tick.price);
+        ring->price_volume_sum += tick.price * tick.volume;
+        ring->volume_sum += tick.volume;
+    }
+
+    stats.timestamp = tick.timestamp;
+    stats.price = tick.price;
+    stats.volume = tick.volume;
+    stats.vwap = ring->volume_sum > 0 ? ring->price_volume_sum / ring->volume_sum : NAN;
+    stats.change = ring->count > 1 ? tick.price - previous_price : 0;
+    stats.change_p = ring->count > 1 && previous_price != 0 ? stats.change / previous_price * 100.0 : 0;
+    stats.count = ring->count;
+
+    atomic_store32(&ring->sequence, sequence + 2, memory_order_release);
+    return true;
+}
+
+/*! Copy the ring aggregates without locking. */
+FOUNDATION_EXTERN realtime_stats_t realtime_ring_read_stats(const realtime_ring_t* ring)
+{
+    realtime_stats_t stats;
+    for (;;)
+    {
+        const int32_t sequence = atomic_load32(&ring->sequence, memory_order_acquire);
+        if (sequence & 1)
+            continue;
+
+        memcpy(&stats, &ring->stats, sizeof(stats));
+
+        atomic_thread_fence_acquire();
+        if (atomic_load32(&ring->sequence, memory_order_relaxed) == sequence)
+            return stats;
+    }
+}
+
+/*! Append the ring ticks received since a given time to @ticks without locking.
+ *
+ *  @return Number of ticks appended.
+ */
+FOUNDATION_EXTERN size_t realtime_ring_read_ticks(const realtime_ring_t* ring, time_t since, stock_realtime_record_t*& ticks)
+{
+    constexpr uint32_t mask = REALTIME_RING_CAPACITY - 1;
+    const unsigned base_size = array_size(ticks);
+    for (;;)
+    {
+        const int32_t sequence = atomic_load32(&ring->sequence, memory_order_acquire);
+        if (sequence & 1)
+            continue;
+
+        const uint64_t head = ring->head;
+        const uint32_t count = min(ring->count, REALTIME_RING_CAPACITY);
+
+        // Ticks are sorted by timestamp, find the oldest one to copy starting from the newest.
+        uint32_t first = count;
+        while (first > 0 && ring->ticks[(head - count + first - 1) & mask].timestamp >= since)
+            --first;
+
+        array_resize(ticks, base_size + (count - first));
+        for (uint32_t i = first; i < count; ++i)
+            ticks[base_size + i - first] = ring->ticks[(head - count + i) & mask];
+
+        atomic_thread_fence_acquire();
+        if (atomic_load32(&ring->sequence, memory_order_relaxed) == sequence)
+            return count - first;
+    }
+}
+
+/*! Returns the ring of a symbol or null if the symbol is not tracked.
+ *  @remark The caller must be inside an epoch as the ring table can be replaced when growing.
+ */
+FOUNDATION_STATIC const realtime_ring_t* realtime_ring_find(hash_t key)
+{
+    hashtable64_t* table = (hashtable64_t*)atomic_load_ptr(&_realtime_module->ring_table, memory_order_acquire);
+    if (table == nullptr)
+        return nullptr;
+    return (const realtime_ring_t*)(uintptr_t)hashtable64_get(table, key);
+}
+
+FOUNDATION_STATIC void realtime_ring_table_grow()
+{
+    hashtable64_t* old_table = (hashtable64_t*)atomic_load_ptr(&_realtime_module->ring_table, memory_order_relaxed);
+    _realtime_module->ring_table_capacity = max(_realtime_module->ring_table_capacity * size_t(2), size_t(256));
+    hashtable64_t* new_table = hashtable64_allocate(_realtime_module->ring_table_capacity);
+    foreach(r, _realtime_module->rings)
+        hashtable64_set(new_table, (*r)->key, (uint64_t)(uintptr_t)*r);
+
+    atomic_store_ptr(&_realtime_module->ring_table, new_table, memory_order_release);
+
+    // Readers might still be probing the previous table.
+    if (old_table)
+        epoch_retire(old_table, [](void* ptr) { hashtable64_deallocate((hashtable64_t*)ptr); });
+}
+
+/*! Give a tracked stock its ring, seeded with its latest records, and publish it to readers.
+ *  @remark The stocks mutex must be locked for writing.
+ */
+FOUNDATION_STATIC realtime_ring_t* realtime_stock_attach_ring(stock_realtime_t* stock)
+{
+    if (stock->ring)
+        return stock->ring;
+
+    realtime_ring_t* ring = realtime_ring_allocate(stock->key);
+    const unsigned record_count = array_size(stock->records);
+    for (unsigned i = record_count > REALTIME_RING_CAPACITY ? record_count - REALTIME_RING_CAPACITY : 0; i < record_count; ++i)
+        realtime_ring_push(ring, stock->records[i]);
+
+    stock->ring = ring;
+    array_push(_realtime_module->rings, ring);
+    if (array_size(_realtime_module->rings) * 2 > _realtime_module->ring_table_capacity)
+        realtime_ring_table_grow();
+    else
+        hashtable64_set((hashtable64_t*)atomic_load_ptr(&_realtime_module->ring_table, memory_order_relaxed), stock->key, (uint64_t)(uintptr_t)ring);
+    return ring;
+}
+
+/*! Attach a ring to the tracked stocks that do not have one yet.
+ *  @remark The stocks mutex must be locked for writing.
+ */
+FOUNDATION_STATIC void realtime_stocks_attach_rings()
+{
+    foreach(s, _realtime_module->stocks)
+        realtime_stock_attach_ring(s);
+}
+
 FOUNDATION_STATIC bool realtime_stock_add_record(stock_realtime_t* stock, const stock_realtime_record_t& record)
 {
     const int fidx = array_binary_search(stock->records, array_size(stock->records), record.timestamp);
@@ -73,9 +432,22 @@ FOUNDATION_STATIC bool realtime_stock_add_record(stock_realtime_t* stock, const
     }
 
     array_insert_memcpy(stock->records, ~fidx, &record);
+    if (stock->ring)
+        realtime_ring_push(stock->ring, record);
     return true;
 }
 
+FOUNDATION_STATIC bool realtime_journal_record_is_valid(const realtime_journal_record_t& r)
+{
+    if ((r.code[0] < 'A' || r.code[0] > 'Z') && r.code[0] != '.' && r.code[0] != '-')
+        return false;
+
+    if (r.code[sizeof(r.code) - 1] != '\0')
+        return false;
+
+    return r.timestamp > 0 && !math_real_is_nan(r.price) && r.price > 0;
+}
+
 FOUNDATION_STATIC bool realtime_register_new_stock(const dispatcher_event_args_t& args)
 {
     FOUNDATION_ASSERT(args.size == sizeof(stock_realtime_t));
@@ -108,224 +480,601 @@ FOUNDATION_STATIC bool realtime_register_new_stock(const dispatcher_event_args_t
     
     stock_realtime->refresh = true;
     stock_realtime->records = nullptr;
+    stock_realtime->ring = nullptr;
     realtime_stock_add_record(stock_realtime, r);
 
     fidx = ~fidx;
     array_insert_memcpy(_realtime_module->stocks, fidx, stock_realtime);
+    realtime_stock_attach_ring(&_realtime_module->stocks[fidx]);
     log_debugf(HASH_REALTIME, STRING_CONST("Registering new realtime stock %.*s (%" PRIhash ")"), STRING_FORMAT(code), stock_realtime->key);
     return true;
 }
 
-FOUNDATION_FORCEINLINE bool operator<(const stock_realtime_record_t& r, const time_t& key)
+//
+// # SEGMENTS
+//
+
+FOUNDATION_STATIC string_const_t realtime_store_dir()
 {
-    return r.timestamp < key;
+    string_const_t dir = session_get_user_dir(STRING_CONST("realtime"));
+    if (!fs_is_directory(STRING_ARGS(dir)))
+        fs_make_directory(STRING_ARGS(dir));
+    return dir;
 }
 
-FOUNDATION_FORCEINLINE bool operator>(const stock_realtime_record_t& r, const time_t& key)
+FOUNDATION_STATIC string_t realtime_day_file_path(char* buffer, size_t capacity, const char* dir, size_t dir_length, int64_t day, const char* extension, size_t extension_length)
 {
-    return r.timestamp > key;
+    // Use noon UTC so the local date names the same day in all common time zones.
+    char date_buffer[16];
+    string_t date = string_from_date(STRING_BUFFER(date_buffer), (time_t)(day * time_one_day() + time_one_day() / 2));
+
+    string_t path = string_copy(buffer, capacity, dir, dir_length);
+    path = path_append(STRING_ARGS(path), capacity, STRING_ARGS(date));
+    return string_append(STRING_ARGS(path), capacity, extension, extension_length);
 }
 
-FOUNDATION_STATIC void realtime_fetch_query_data(const json_object_t& res)
+/*! Write a segment of records for the given day.
+ *
+ *  Each stock records must be sorted by timestamp. Records of other days are skipped.
+ *  Timestamps, prices (scaled by #REALTIME_SEGMENT_PRICE_SCALE) and volumes are encoded
+ *  as varint deltas from the previous record of the same symbol.
+ */
+FOUNDATION_EXTERN bool realtime_segment_write(const char* path, size_t path_length, int64_t day, const stock_realtime_t* stocks, size_t stock_count)
 {
-    if (res.error_code > 0)
-        return;
-    
-    for (auto e : res)
+    realtime_segment_header_t header;
+    memcpy(header.magic, "RTSG", sizeof(header.magic));
+    header.version = REALTIME_SEGMENT_VERSION;
+    header.day = day;
+
+    uint8_t* data = nullptr;
+    realtime_segment_symbol_t* symbols = nullptr;
+    array_resize(data, sizeof(header));
+
+    const time_t day_start = (time_t)(day * time_one_day());
+    const time_t day_end = day_start + time_one_day();
+    for (size_t i = 0; i < stock_count; ++i)
     {
-        stock_realtime_record_t r;
-        r.price = e["close"].as_number();
-        if (math_real_is_nan(r.price))
-            continue;
+        const stock_realtime_t& stock = stocks[i];
 
-        r.timestamp = (time_t)e["timestamp"].as_number(0);
-        if (r.timestamp == 0)
+        realtime_segment_symbol_t symbol;
+        memset(&symbol, 0, sizeof(symbol));
+        symbol.key = stock.key;
+        string_copy(symbol.code, sizeof(symbol.code), stock.code, string_length(stock.code));
+        symbol.offset = array_size(data);
+
+        time_t timestamp = day_start;
+        int64_t price = 0, volume = 0;
+        foreach(r, stock.records)
+        {
+            if (r->timestamp < day_start || r->timestamp >= day_end)
+                continue;
+            if (symbol.count > 0 && r->timestamp <= timestamp)
+                continue;
+
+            const int64_t record_price = (int64_t)math_round(r->price * REALTIME_SEGMENT_PRICE_SCALE);
+            const int64_t record_volume = (int64_t)math_round(r->volume);
+            realtime_encode_varint(data, (uint64_t)(r->timestamp - timestamp));
+            realtime_encode_varint(data, realtime_zigzag_encode(record_price - price));
+            realtime_encode_varint(data, realtime_zigzag_encode(record_volume - volume));
+
+            if (symbol.count++ == 0)
+                symbol.first_timestamp = r->timestamp;
+            symbol.last_timestamp = r->timestamp;
+            symbol.last_price = r->price;
+            symbol.last_volume = r->volume;
+
+            timestamp = r->timestamp;
+            price = record_price;
+            volume = record_volume;
+        }
+
+        if (symbol.count == 0)
             continue;
 
-        r.volume = e["volume"].as_number(0);
+        symbol.size = (uint32_t)(array_size(data) - symbol.offset);
+        header.record_count += symbol.count;
+        array_push_memcpy(symbols, &symbol);
+    }
 
-        if (_realtime_module->stream == nullptr)
-            break;
+    array_sort(symbols, ARRAY_LESS_BY(key));
 
-        string_const_t code = e["code"].as_string();
-        const hash_t key = hash(STRING_ARGS(code));
-        
-        SHARED_READ_LOCK(_realtime_module->stocks_mutex);
-     
-        int fidx = array_binary_search(_realtime_module->stocks, array_size(_realtime_module->stocks), key);
-        if (fidx >= 0)
-        {
-            stock_realtime_t& stock = _realtime_module->stocks[fidx];
-                
-            if (realtime_stock_add_record(&stock, r))
-            {
-                log_debugf(HASH_REALTIME, STRING_CONST("Streaming new realtime values %.*s (%lld) > %lf (%" PRIsize " kb)"),
-                    STRING_FORMAT(code), (long long)r.timestamp, r.price, stream_size(_realtime_module->stream) / (size_t)1024);
-                        
-                stream_write(_realtime_module->stream, &r.timestamp, sizeof(r.timestamp));
-                stream_write(_realtime_module->stream, stock.code, sizeof(stock.code));
-                stream_write(_realtime_module->stream, &r.price, sizeof(r.price));
-                stream_write(_realtime_module->stream, &r.volume, sizeof(r.volume));
-            }
-        }
+    // Align the footer so it can be read in place once mapped
+    while (array_size(data) % 8 != 0)
+        array_push(data, (uint8_t)0);
+    header.symbol_count = array_size(symbols);
+    header.footer_offset = array_size(data);
+    memcpy(data, &header, sizeof(header));
+
+    bool success = false;
+    stream_t* stream = fs_open_file(path, path_length, STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+    if (stream)
+    {
+        success = stream_write(stream, data, array_size(data)) == array_size(data);
+        if (header.symbol_count > 0)
+            success &= stream_write(stream, symbols, sizeof(realtime_segment_symbol_t) * header.symbol_count) == sizeof(realtime_segment_symbol_t) * header.symbol_count;
+        stream_deallocate(stream);
     }
 
-    if (_realtime_module->stream)
-        stream_flush(_realtime_module->stream);
+    if (!success)
+    {
+        log_errorf(HASH_REALTIME, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to write realtime segment %.*s"), (int)path_length, path);
+        fs_remove_file(path, path_length);
+    }
+
+    array_deallocate(symbols);
+    array_deallocate(data);
+    return success;
 }
 
-FOUNDATION_STATIC stream_t* realtime_open_stream()
+FOUNDATION_EXTERN realtime_segment_t* realtime_segment_open(const char* path, size_t path_length)
 {
-    string_const_t realtime_stream_path = session_get_user_file_path(
-        STRING_CONST("realtime"), nullptr, 0, STRING_CONST("stream"));
-    stream_t* stream = fs_open_file(STRING_ARGS(realtime_stream_path), STREAM_CREATE | STREAM_IN | STREAM_OUT | STREAM_BINARY);
-    if (stream == nullptr)
+    size_t size = 0;
+    const uint8_t* data = (const uint8_t*)system_map_file(path, path_length, &size);
+    if (data == nullptr)
+        return nullptr;
+
+    const realtime_segment_header_t* header = (const realtime_segment_header_t*)data;
+    if (size < sizeof(realtime_segment_header_t) ||
+        !string_equal(header->magic, sizeof(header->magic), STRING_CONST("RTSG")) ||
+        header->version != REALTIME_SEGMENT_VERSION ||
+        header->footer_offset % 8 != 0 || header->footer_offset > size ||
+        (size - header->footer_offset) / sizeof(realtime_segment_symbol_t) < header->symbol_count)
     {
-        log_panic(HASH_REALTIME, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to open realtime stream"));
+        log_warnf(HASH_REALTIME, WARNING_INVALID_VALUE, STRING_CONST("Invalid realtime segment %.*s"), (int)path_length, path);
+        system_unmap_file(data, size);
         return nullptr;
     }
 
-    return stream;
+    realtime_segment_t* segment = MEM_NEW(HASH_REALTIME, realtime_segment_t);
+    segment->day = header->day;
+    segment->size = size;
+    segment->data = data;
+    segment->header = header;
+    segment->symbols = (const realtime_segment_symbol_t*)(data + header->footer_offset);
+    return segment;
 }
 
-FOUNDATION_STATIC void realtime_write_stream_header(stream_t* stream)
+FOUNDATION_EXTERN void realtime_segment_close(realtime_segment_t*& segment)
 {
-    stream_write(stream, "REAL", 4);
-    stream_write_int32(stream, REALTIME_STREAM_VERSION);
+    if (segment == nullptr)
+        return;
 
-    // Write 56 bytes of padding
-    char padding[56] = { '\0' };
-    stream_write(stream, padding, sizeof(padding));
+    system_unmap_file(segment->data, segment->size);
+    MEM_DELETE(segment);
+    segment = nullptr;
 }
 
-FOUNDATION_STATIC void realtime_migrate_stream(int& from, int to)
+FOUNDATION_STATIC const realtime_segment_symbol_t* realtime_segment_find(const realtime_segment_t* segment, hash_t key)
 {
-    // Create a new stream
-    stream_t* migrate_stream = fs_temporary_file();
-    FOUNDATION_ASSERT(migrate_stream);
+    const int fidx = array_binary_search(segment->symbols, segment->header->symbol_count, key);
+    if (fidx < 0)
+        return nullptr;
+    return &segment->symbols[fidx];
+}
 
-    realtime_write_stream_header(migrate_stream);
+/*! Decode the records of a symbol with a timestamp at or after @since and append them to @records.
+ *
+ *  @return Number of records appended.
+ */
+FOUNDATION_EXTERN size_t realtime_segment_decode(const realtime_segment_t* segment, hash_t key, time_t since, stock_realtime_record_t*& records)
+{
+    const realtime_segment_symbol_t* symbol = realtime_segment_find(segment, key);
+    if (symbol == nullptr || symbol->last_timestamp < since)
+        return 0;
 
-    char temp_path_buffer[BUILD_MAX_PATHLEN];
-    string_const_t temp_path_const = stream_path(migrate_stream);
-    string_t temp_path = string_copy(STRING_BUFFER(temp_path_buffer), temp_path_const.str, temp_path_const.length);
+    if (symbol->offset + symbol->size > segment->header->footer_offset)
+        return 0;
 
-    char current_stream_path_buffer[BUILD_MAX_PATHLEN];
-    string_const_t current_stream_path_const = stream_path(_realtime_module->stream);
-    string_t current_stream_path = string_copy(STRING_BUFFER(current_stream_path_buffer), current_stream_path_const.str, current_stream_path_const.length);
-    
-    if (from == 0 && to == 1)
+    const uint8_t* p = segment->data + symbol->offset;
+    const uint8_t* end = p + symbol->size;
+
+    time_t timestamp = (time_t)(segment->day * time_one_day());
+    int64_t price = 0, volume = 0;
+    size_t count = 0;
+    array_reserve(records, array_size(records) + symbol->count);
+    for (uint32_t i = 0; i < symbol->count; ++i)
     {
-        stream_seek(_realtime_module->stream, 0, STREAM_SEEK_BEGIN);
-        while (!stream_eos(_realtime_module->stream))
+        uint64_t dt, dp, dv;
+        if ((p = realtime_decode_varint(p, end, dt)) == nullptr ||
+            (p = realtime_decode_varint(p, end, dp)) == nullptr ||
+            (p = realtime_decode_varint(p, end, dv)) == nullptr)
         {
-            stock_realtime_t stock;
-            stock_realtime_record_t r;
-            r.volume = 0;
+            break;
+        }
+
+        timestamp += (time_t)dt;
+        price += realtime_zigzag_decode(dp);
+        volume += realtime_zigzag_decode(dv);
+        if (timestamp < since)
+            continue;
 
-            stream_read(_realtime_module->stream, &r.timestamp, sizeof(r.timestamp));
-            stream_read(_realtime_module->stream, stock.code, sizeof(stock.code));
-            stream_read(_realtime_module->stream, &r.price, sizeof(r.price));
+        stock_realtime_record_t r;
+        r.timestamp = timestamp;
+        r.price = (double)price / REALTIME_SEGMENT_PRICE_SCALE;
+        r.volume = (double)volume;
+        array_push_memcpy(records, &r);
+        count++;
+    }
 
-            if (r.timestamp <= 0 || math_real_is_nan(r.price))
-                continue;
+    return count;
+}
 
-            stream_write(migrate_stream, &r.timestamp, sizeof(r.timestamp));
-            stream_write(migrate_stream, stock.code, sizeof(stock.code));
-            stream_write(migrate_stream, &r.price, sizeof(r.price));
-            stream_write(migrate_stream, &r.volume, sizeof(r.volume));
+/*! Register the symbols of a segment, using the footer index only.
+ *
+ *  New stocks are inserted by key and the latest record of each symbol is
+ *  kept in the stock records so the last change can be computed without decoding the segment.
+ */
+FOUNDATION_EXTERN void realtime_segment_register_stocks(const realtime_segment_t* segment, stock_realtime_t*& stocks)
+{
+    for (uint32_t i = 0; i < segment->header->symbol_count; ++i)
+    {
+        const realtime_segment_symbol_t& symbol = segment->symbols[i];
+        if (symbol.count == 0 || symbol.code[sizeof(symbol.code) - 1] != '\0')
+            continue;
+
+        stock_realtime_record_t r;
+        r.timestamp = (time_t)symbol.last_timestamp;
+        r.price = symbol.last_price;
+        r.volume = symbol.last_volume;
+
+        int fidx = array_binary_search(stocks, array_size(stocks), symbol.key);
+        if (fidx < 0)
+        {
+            stock_realtime_t stock;
+            stock.key = symbol.key;
+            string_copy(stock.code, sizeof(stock.code), symbol.code, string_length(symbol.code));
+            stock.price = r.price;
+            stock.volume = r.volume;
+            stock.timestamp = r.timestamp;
+            stock.refresh = false;
+            stock.records = nullptr;
+            array_push_memcpy(stock.records, &r);
+            array_insert_memcpy(stocks, ~fidx, &stock);
+        }
+        else if (stocks[fidx].timestamp < r.timestamp)
+        {
+            realtime_stock_add_record(&stocks[fidx], r);
         }
-        
-        from = to;
     }
+}
 
-    stream_deallocate(migrate_stream);
-    stream_deallocate(_realtime_module->stream);
-    if (fs_copy_file(STRING_ARGS(temp_path), STRING_ARGS(current_stream_path)))
+/*! Open all segments of a directory for days at or after @oldest_day and delete older segments.
+ *
+ *  @return Segments sorted by day.
+ */
+FOUNDATION_EXTERN realtime_segment_t** realtime_segments_open(const char* dir, size_t dir_length, int64_t oldest_day)
+{
+    realtime_segment_t** segments = nullptr;
+    string_t* file_names = fs_matching_files(dir, dir_length, STRING_CONST("^.*\\.segment$"), false);
+    foreach(e, file_names)
     {
-        _realtime_module->stream = realtime_open_stream();
-        
-        // Read header
-        char file_format[4] = { '\0' };
-        stream_read(_realtime_module->stream, file_format, sizeof(file_format));
-        if (!string_equal(file_format, 4, STRING_CONST("REAL")))
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = path_concat(STRING_BUFFER(path_buffer), dir, dir_length, STRING_ARGS(*e));
+        realtime_segment_t* segment = realtime_segment_open(STRING_ARGS(path));
+        if (segment == nullptr)
+            continue;
+
+        if (segment->day < oldest_day)
         {
-            log_errorf(HASH_REALTIME, ERROR_INVALID_VALUE, STRING_CONST("Failed to migrate realtime stream"));
-            return;
+            log_debugf(HASH_REALTIME, STRING_CONST("Expiring realtime segment %.*s"), STRING_FORMAT(path));
+            realtime_segment_close(segment);
+            fs_remove_file(STRING_ARGS(path));
+            continue;
+        }
+
+        array_push(segments, segment);
+    }
+    string_array_deallocate(file_names);
+
+    array_sort(segments, [](const realtime_segment_t* a, const realtime_segment_t* b)
+    {
+        return a->day < b->day ? -1 : a->day > b->day ? 1 : 0;
+    });
+    return segments;
+}
+
+FOUNDATION_EXTERN void realtime_segments_close(realtime_segment_t**& segments)
+{
+    for (unsigned i = 0, end = array_size(segments); i < end; ++i)
+        realtime_segment_close(segments[i]);
+    array_deallocate(segments);
+}
+
+/*! Seal the journal records of a stream, starting at @offset, into segment files.
+ *
+ *  Records are grouped by day and merged with the segment already written for that day.
+ *  Each sealed segment is written next to its final path with a `.tmp` extension,
+ *  see #realtime_segment_commit.
+ *
+ *  @param days Days for which a segment was written.
+ *
+ *  @return False if the segment of any day could not be written.
+ */
+FOUNDATION_EXTERN bool realtime_journal_seal(const char* dir, size_t dir_length, stream_t* stream, size_t offset, int64_t*& days)
+{
+    realtime_seal_record_t* records = nullptr;
+    stream_seek(stream, offset, STREAM_SEEK_BEGIN);
+    while (!stream_eos(stream))
+    {
+        realtime_seal_record_t e;
+        if (stream_read(stream, &e.record, sizeof(e.record)) != sizeof(e.record))
+            break;
+        if (!realtime_journal_record_is_valid(e.record))
+            continue;
+
+        e.day = realtime_day(e.record.timestamp);
+        e.key = hash(e.record.code, string_length(e.record.code));
+        array_push_memcpy(records, &e);
+    }
+
+    array_sort(records, [](const realtime_seal_record_t& a, const realtime_seal_record_t& b)
+    {
+        if (a.day != b.day)
+            return a.day < b.day ? -1 : 1;
+        if (a.key != b.key)
+            return a.key < b.key ? -1 : 1;
+        return a.record.timestamp < b.record.timestamp ? -1 : a.record.timestamp > b.record.timestamp ? 1 : 0;
+    });
+
+    bool success = true;
+    for (unsigned i = 0, end = array_size(records); i < end;)
+    {
+        const int64_t day = records[i].day;
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t segment_path = realtime_day_file_path(STRING_BUFFER(path_buffer), dir, dir_length, day, STRING_CONST(".segment"));
+
+        // Start from the records already sealed for that day
+        stock_realtime_t* stocks = nullptr;
+        realtime_segment_t* existing = fs_is_file(STRING_ARGS(segment_path)) ? realtime_segment_open(STRING_ARGS(segment_path)) : nullptr;
+        if (existing)
+        {
+            for (uint32_t s = 0; s < existing->header->symbol_count; ++s)
+            {
+                const realtime_segment_symbol_t& symbol = existing->symbols[s];
+
+                stock_realtime_t stock;
+                stock.key = symbol.key;
+                string_copy(stock.code, sizeof(stock.code), symbol.code, string_length(symbol.code));
+                stock.price = symbol.last_price;
+                stock.volume = symbol.last_volume;
+                stock.timestamp = (time_t)symbol.last_timestamp;
+                stock.records = nullptr;
+                realtime_segment_decode(existing, symbol.key, 0, stock.records);
+                array_push_memcpy(stocks, &stock);
+            }
+            realtime_segment_close(existing);
         }
 
-        int stream_version;
-        stream_read(_realtime_module->stream, &stream_version, sizeof(stream_version));
-        if (stream_version != REALTIME_STREAM_VERSION)
+        for (; i < end && records[i].day == day; ++i)
         {
-            log_errorf(HASH_REALTIME, ERROR_INVALID_VALUE, STRING_CONST("Failed to migrate realtime stream"));
-            return;
+            const realtime_seal_record_t& e = records[i];
+            int fidx = array_binary_search(stocks, array_size(stocks), e.key);
+            if (fidx < 0)
+            {
+                stock_realtime_t stock;
+                stock.key = e.key;
+                string_copy(stock.code, sizeof(stock.code), e.record.code, string_length(e.record.code));
+                stock.records = nullptr;
+                fidx = ~fidx;
+                array_insert_memcpy(stocks, fidx, &stock);
+            }
+
+            stock_realtime_record_t r;
+            r.timestamp = e.record.timestamp;
+            r.price = e.record.price;
+            r.volume = e.record.volume;
+            realtime_stock_add_record(&stocks[fidx], r);
         }
 
-        // Skip padding
-        stream_seek(_realtime_module->stream, 56, STREAM_SEEK_CURRENT);
+        segment_path = string_append(STRING_ARGS(segment_path), sizeof(path_buffer), STRING_CONST(".tmp"));
+        if (realtime_segment_write(STRING_ARGS(segment_path), day, stocks, array_size(stocks)))
+            array_push(days, day);
+        else
+            success = false;
+
+        foreach(s, stocks)
+            array_deallocate(s->records);
+        array_deallocate(stocks);
     }
 
-    FOUNDATION_ASSERT(_realtime_module->stream);
+    array_deallocate(records);
+    return success;
 }
 
-FOUNDATION_STATIC void realtime_stream_stock_entries()
-{    
-    // Read stream version
-    int stream_version = 0;
-    if (!stream_eos(_realtime_module->stream))
+/*! Replace the segment of a day with the one written by #realtime_journal_seal. */
+FOUNDATION_EXTERN bool realtime_segment_commit(const char* dir, size_t dir_length, int64_t day)
+{
+    char segment_path_buffer[BUILD_MAX_PATHLEN];
+    string_t segment_path = realtime_day_file_path(STRING_BUFFER(segment_path_buffer), dir, dir_length, day, STRING_CONST(".segment"));
+
+    char temp_path_buffer[BUILD_MAX_PATHLEN];
+    string_t temp_path = string_copy(STRING_BUFFER(temp_path_buffer), STRING_ARGS(segment_path));
+    temp_path = string_append(STRING_ARGS(temp_path), sizeof(temp_path_buffer), STRING_CONST(".tmp"));
+
+    return system_replace_file(STRING_ARGS(temp_path), STRING_ARGS(segment_path));
+}
+
+/*! Install sealed segments in place of the mapped ones and register their symbols.
+ *
+ *  @return False if any segment could not be committed or opened.
+ */
+FOUNDATION_STATIC bool realtime_segments_replace(const char* dir, size_t dir_length, const int64_t* days)
+{
+    SHARED_WRITE_LOCK(_realtime_module->stocks_mutex);
+
+    bool success = true;
+    for (unsigned i = 0, end = array_size(days); i < end; ++i)
     {
-        char file_format[4] = { '\0' };
-        stream_read(_realtime_module->stream, file_format, sizeof(file_format));
-        if (!string_equal(file_format, 4, STRING_CONST("REAL")))
-            realtime_migrate_stream(stream_version, REALTIME_STREAM_VERSION);
-        else if (stream_read(_realtime_module->stream, &stream_version, sizeof(stream_version)) == sizeof(stream_version))
+        const int64_t day = days[i];
+
+        // The mapping must be released before the file can be replaced.
+        unsigned insert_at = array_size(_realtime_module->segments);
+        for (unsigned s = 0, send = array_size(_realtime_module->segments); s < send; ++s)
         {
-            if (stream_version != REALTIME_STREAM_VERSION)
-                realtime_migrate_stream(stream_version, REALTIME_STREAM_VERSION);
-            else
+            realtime_segment_t* segment = _realtime_module->segments[s];
+            if (segment->day < day)
+                continue;
+
+            insert_at = s;
+            if (segment->day == day)
             {
-                // Read padding
-                char padding[56] = { '\0' };
-                stream_read(_realtime_module->stream, padding, sizeof(padding));
+                realtime_segment_close(segment);
+                array_erase_ordered(_realtime_module->segments, s);
             }
+            break;
         }
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = realtime_day_file_path(STRING_BUFFER(path_buffer), dir, dir_length, day, STRING_CONST(".segment"));
+        if (!realtime_segment_commit(dir, dir_length, day))
+        {
+            // Map the previous segment again if it is still there.
+            success = false;
+            char temp_path_buffer[BUILD_MAX_PATHLEN];
+            string_t temp_path = string_copy(STRING_BUFFER(temp_path_buffer), STRING_ARGS(path));
+            temp_path = string_append(STRING_ARGS(temp_path), sizeof(temp_path_buffer), STRING_CONST(".tmp"));
+            fs_remove_file(STRING_ARGS(temp_path));
+        }
+
+        realtime_segment_t* segment = fs_is_file(STRING_ARGS(path)) ? realtime_segment_open(STRING_ARGS(path)) : nullptr;
+        if (segment == nullptr)
+        {
+            success = false;
+            continue;
+        }
+
+        array_insert(_realtime_module->segments, insert_at, segment);
+        realtime_segment_register_stocks(segment, _realtime_module->stocks);
     }
-    else
+
+    realtime_stocks_attach_rings();
+    return success;
+}
+
+FOUNDATION_STATIC void realtime_expire_segments(const char* dir, size_t dir_length, int64_t oldest_day)
+{
+    SHARED_WRITE_LOCK(_realtime_module->stocks_mutex);
+
+    while (array_size(_realtime_module->segments) > 0 && _realtime_module->segments[0]->day < oldest_day)
     {
-        realtime_write_stream_header(_realtime_module->stream);
+        realtime_segment_t* segment = _realtime_module->segments[0];
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = realtime_day_file_path(STRING_BUFFER(path_buffer), dir, dir_length, segment->day, STRING_CONST(".segment"));
+        log_debugf(HASH_REALTIME, STRING_CONST("Expiring realtime segment %.*s"), STRING_FORMAT(path));
+
+        realtime_segment_close(segment);
+        array_erase_ordered(_realtime_module->segments, 0);
+        fs_remove_file(STRING_ARGS(path));
     }
+}
 
-    shared_mutex& mutex = _realtime_module->stocks_mutex;
-    while (!thread_try_wait(0) && stream_version == REALTIME_STREAM_VERSION && !stream_eos(_realtime_module->stream))
+/*! Gather the records of a stock since a given time from the mapped segments and the journal records.
+ *
+ *  @remark The stocks mutex must be locked.
+ */
+FOUNDATION_STATIC size_t realtime_stock_gather_records(const stock_realtime_t* s, time_t since, stock_realtime_record_t*& records)
+{
+    array_clear(records);
+    for (unsigned i = 0, end = array_size(_realtime_module->segments); i < end; ++i)
     {
-        stock_realtime_t stock;
-        stock_realtime_record_t r;
+        const realtime_segment_t* segment = _realtime_module->segments[i];
+        if ((time_t)((segment->day + 1) * time_one_day()) <= since)
+            continue;
+        realtime_segment_decode(segment, s->key, since, records);
+    }
 
-        stream_read(_realtime_module->stream, &r.timestamp, sizeof(r.timestamp));
-        stream_read(_realtime_module->stream, stock.code, sizeof(stock.code));
-        stream_read(_realtime_module->stream, &r.price, sizeof(r.price));
-        stream_read(_realtime_module->stream, &r.volume, sizeof(r.volume));
+    const time_t last_sealed = array_size(records) > 0 ? array_last(records)->timestamp : 0;
+    foreach(r, s->records)
+    {
+        if (r->timestamp > last_sealed && r->timestamp >= since)
+            array_push_memcpy(records, r);
+    }
 
-        if ((stock.code[0] < 'A' || stock.code[0] > 'Z') && stock.code[0] != '.' && stock.code[0] != '-')
-            continue;
+    return array_size(records);
+}
 
-        if (r.timestamp <= 0 || math_real_is_nan(r.price) || r.price <= 0)
+/*! Count the records of a stock without decoding segments.
+ *
+ *  @remark The stocks mutex must be locked.
+ */
+FOUNDATION_STATIC size_t realtime_stock_record_count(const stock_realtime_t* s)
+{
+    size_t count = 0;
+    time_t last_sealed = 0;
+    for (unsigned i = 0, end = array_size(_realtime_module->segments); i < end; ++i)
+    {
+        const realtime_segment_symbol_t* symbol = realtime_segment_find(_realtime_module->segments[i], s->key);
+        if (symbol == nullptr)
             continue;
+        count += symbol->count;
+        last_sealed = max(last_sealed, (time_t)symbol->last_timestamp);
+    }
 
-        if (time_elapsed_days(r.timestamp, time_now()) > 31)
-        {
-            log_debugf(HASH_REALTIME, STRING_CONST("Ignoring realtime stock record %s (%lld) as it is too old."), stock.code, (long long)r.timestamp);
+    foreach(r, s->records)
+    {
+        if (r->timestamp > last_sealed)
+            count++;
+    }
+
+    return count;
+}
+
+//
+// # JOURNAL
+//
+
+FOUNDATION_STATIC void realtime_journal_rotate(int64_t day)
+{
+    if (_realtime_module->journal && _realtime_module->journal_day == day)
+        return;
+
+    stream_deallocate(_realtime_module->journal);
+    _realtime_module->journal = nullptr;
+
+    char path_buffer[BUILD_MAX_PATHLEN];
+    string_const_t dir = realtime_store_dir();
+    string_t path = realtime_day_file_path(STRING_BUFFER(path_buffer), STRING_ARGS(dir), day, STRING_CONST(".journal"));
+    _realtime_module->journal = fs_open_file(STRING_ARGS(path), STREAM_CREATE | STREAM_IN | STREAM_OUT | STREAM_BINARY);
+    if (_realtime_module->journal == nullptr)
+    {
+        log_errorf(HASH_REALTIME, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to open realtime journal %.*s"), STRING_FORMAT(path));
+        return;
+    }
+
+    stream_seek(_realtime_module->journal, 0, STREAM_SEEK_END);
+    _realtime_module->journal_day = day;
+}
+
+FOUNDATION_STATIC void realtime_journal_replay(stream_t* stream)
+{
+    shared_mutex& mutex = _realtime_module->stocks_mutex;
+
+    stream_seek(stream, 0, STREAM_SEEK_BEGIN);
+    while (!thread_try_wait(0) && !stream_eos(stream))
+    {
+        realtime_journal_record_t e;
+        if (stream_read(stream, &e, sizeof(e)) != sizeof(e))
+            break;
+
+        if (!realtime_journal_record_is_valid(e))
             continue;
-        }
 
-        const size_t code_length = string_length(stock.code);
-        stock.key = hash(stock.code, code_length);
+        stock_realtime_record_t r;
+        r.timestamp = e.timestamp;
+        r.price = e.price;
+        r.volume = e.volume;
+
+        const hash_t key = hash(e.code, string_length(e.code));
 
         SHARED_WRITE_LOCK(mutex);
-        int fidx = array_binary_search(_realtime_module->stocks, array_size(_realtime_module->stocks), stock.key);
+        int fidx = array_binary_search(_realtime_module->stocks, array_size(_realtime_module->stocks), key);
         if (fidx < 0)
         {
+            stock_realtime_t stock;
+            stock.key = key;
+            string_copy(stock.code, sizeof(stock.code), e.code, string_length(e.code));
             stock.price = r.price;
             stock.timestamp = r.timestamp;
             stock.volume = r.volume;
@@ -334,20 +1083,215 @@ FOUNDATION_STATIC void realtime_stream_stock_entries()
             array_push_memcpy(stock.records, &r);
 
             array_insert_memcpy(_realtime_module->stocks, ~fidx, &stock);
-            //log_debugf(HASH_REALTIME, STRING_CONST("Streaming new realtime stock %s (%" PRIhash ")"), stock.code, stock.key);
+            realtime_stock_attach_ring(&_realtime_module->stocks[~fidx]);
         }
         else
         {
             realtime_stock_add_record(&_realtime_module->stocks[fidx], r);
         }
     }
+
+    stream_seek(stream, 0, STREAM_SEEK_END);
+}
+
+/*! Seal the records of the legacy single file realtime stream into segments. */
+FOUNDATION_STATIC void realtime_migrate_stream(const char* dir, size_t dir_length)
+{
+    string_const_t legacy_stream_path = session_get_user_file_path(STRING_CONST("realtime"), nullptr, 0, STRING_CONST("stream"));
+    if (!fs_is_file(STRING_ARGS(legacy_stream_path)))
+        return;
+
+    stream_t* stream = fs_open_file(STRING_ARGS(legacy_stream_path), STREAM_IN | STREAM_BINARY);
+    if (stream == nullptr)
+        return;
+
+    char file_format[4] = { '\0' };
+    int stream_version = 0;
+    stream_read(stream, file_format, sizeof(file_format));
+    stream_read(stream, &stream_version, sizeof(stream_version));
+    if (!string_equal(file_format, sizeof(file_format), STRING_CONST("REAL")) || stream_version != REALTIME_STREAM_VERSION)
+    {
+        log_warnf(HASH_REALTIME, WARNING_UNSUPPORTED, STRING_CONST("Unsupported realtime stream version %d, records will not be migrated"), stream_version);
+        stream_deallocate(stream);
+        return;
+    }
+
+    // Skip the header and its padding
+    int64_t* days = nullptr;
+    bool success = realtime_journal_seal(dir, dir_length, stream, 64, days);
+    stream_deallocate(stream);
+
+    for (unsigned i = 0, end = array_size(days); i < end; ++i)
+        success &= realtime_segment_commit(dir, dir_length, days[i]);
+
+    log_infof(HASH_REALTIME, STRING_CONST("Migrated realtime stream to %u daily segments"), array_size(days));
+    array_deallocate(days);
+
+    if (success)
+        fs_remove_file(STRING_ARGS(legacy_stream_path));
+}
+
+/*! Seal the journals of previous days, expire old segments and drop the journal records already sealed. */
+FOUNDATION_STATIC void realtime_compact(int64_t today)
+{
+    char dir_buffer[BUILD_MAX_PATHLEN];
+    string_const_t store_dir = realtime_store_dir();
+    string_t dir = string_copy(STRING_BUFFER(dir_buffer), STRING_ARGS(store_dir));
+
+    char today_journal_buffer[BUILD_MAX_PATHLEN];
+    string_t today_journal_path = realtime_day_file_path(STRING_BUFFER(today_journal_buffer), STRING_ARGS(dir), today, STRING_CONST(".journal"));
+    string_const_t today_journal_name = path_file_name(STRING_ARGS(today_journal_path));
+
+    string_t* journal_names = fs_matching_files(STRING_ARGS(dir), STRING_CONST("^.*\\.journal$"), false);
+    foreach(e, journal_names)
+    {
+        if (string_equal(STRING_ARGS(*e), STRING_ARGS(today_journal_name)))
+            continue;
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = path_concat(STRING_BUFFER(path_buffer), STRING_ARGS(dir), STRING_ARGS(*e));
+        stream_t* stream = fs_open_file(STRING_ARGS(path), STREAM_IN | STREAM_BINARY);
+        if (stream == nullptr)
+            continue;
+
+        int64_t* days = nullptr;
+        bool sealed = realtime_journal_seal(STRING_ARGS(dir), stream, 0, days);
+        stream_deallocate(stream);
+
+        sealed &= realtime_segments_replace(STRING_ARGS(dir), days);
+        array_deallocate(days);
+
+        // Keep the journal until all its records are committed to segments, sealing it again at the next compaction is harmless.
+        if (!sealed)
+        {
+            log_warnf(HASH_REALTIME, WARNING_SYSTEM_CALL_FAIL, STRING_CONST("Failed to seal realtime journal %.*s, it will be sealed again later"), STRING_FORMAT(*e));
+            continue;
+        }
+
+        log_infof(HASH_REALTIME, STRING_CONST("Sealed realtime journal %.*s"), STRING_FORMAT(*e));
+        fs_remove_file(STRING_ARGS(path));
+    }
+    string_array_deallocate(journal_names);
+
+    realtime_expire_segments(STRING_ARGS(dir), today - REALTIME_RETENTION_DAYS);
+
+    // Records of sealed days are now served from the segments, only keep the latest one of each stock.
+    const time_t today_start = (time_t)(today * time_one_day());
+    SHARED_WRITE_LOCK(_realtime_module->stocks_mutex);
+    foreach(s, _realtime_module->stocks)
+    {
+        const unsigned record_count = array_size(s->records);
+        if (record_count <= 1)
+            continue;
+
+        int fidx = array_binary_search(s->records, record_count, today_start);
+        if (fidx < 0)
+            fidx = ~fidx;
+        const unsigned sealed_count = min((unsigned)fidx, record_count - 1);
+        if (sealed_count > 0)
+            array_erase_ordered_range(s->records, 0, sealed_count);
+    }
+
+    _realtime_module->compacted_day = today;
+}
+
+FOUNDATION_STATIC void realtime_load_store()
+{
+    char dir_buffer[BUILD_MAX_PATHLEN];
+    string_const_t store_dir = realtime_store_dir();
+    string_t dir = string_copy(STRING_BUFFER(dir_buffer), STRING_ARGS(store_dir));
+
+    realtime_migrate_stream(STRING_ARGS(dir));
+
+    const int64_t today = realtime_day(time_now());
+    realtime_segment_t** segments = realtime_segments_open(STRING_ARGS(dir), today - REALTIME_RETENTION_DAYS);
+    {
+        SHARED_WRITE_LOCK(_realtime_module->stocks_mutex);
+        FOUNDATION_ASSERT(_realtime_module->segments == nullptr);
+        _realtime_module->segments = segments;
+        for (unsigned i = 0, end = array_size(segments); i < end; ++i)
+            realtime_segment_register_stocks(segments[i], _realtime_module->stocks);
+        realtime_stocks_attach_rings();
+    }
+
+    realtime_compact(today);
+
+    realtime_journal_rotate(today);
+    if (_realtime_module->journal)
+        realtime_journal_replay(_realtime_module->journal);
+
+    log_infof(HASH_REALTIME, STRING_CONST("Loaded %u realtime segments for %u stocks"),
+        array_size(_realtime_module->segments), array_size(_realtime_module->stocks));
+}
+
+FOUNDATION_STATIC void realtime_fetch_query_data(const json_object_t& res)
+{
+    if (res.error_code > 0)
+        return;
+    
+    for (auto e : res)
+    {
+        stock_realtime_record_t r;
+        r.price = e["close"].as_number();
+        if (math_real_is_nan(r.price))
+            continue;
+
+        r.timestamp = (time_t)e["timestamp"].as_number(0);
+        if (r.timestamp == 0)
+            continue;
+
+        r.volume = e["volume"].as_number(0);
+
+        if (_realtime_module->journal == nullptr)
+            break;
+
+        string_const_t code = e["code"].as_string();
+        const hash_t key = hash(STRING_ARGS(code));
+        
+        bool new_record = false;
+        {
+            // Records are read by graphs under the read lock, only the rings are read without locking.
+            SHARED_WRITE_LOCK(_realtime_module->stocks_mutex);
+         
+            int fidx = array_binary_search(_realtime_module->stocks, array_size(_realtime_module->stocks), key);
+            if (fidx >= 0)
+            {
+                stock_realtime_t& stock = _realtime_module->stocks[fidx];
+                    
+                if (realtime_stock_add_record(&stock, r))
+                {
+                    log_debugf(HASH_REALTIME, STRING_CONST("Streaming new realtime values %.*s (%lld) > %lf (%" PRIsize " kb)"),
+                        STRING_FORMAT(code), (long long)r.timestamp, r.price, stream_size(_realtime_module->journal) / (size_t)1024);
+                            
+                    realtime_journal_record_t jr;
+                    jr.timestamp = r.timestamp;
+                    memcpy(jr.code, stock.code, sizeof(jr.code));
+                    jr.price = r.price;
+                    jr.volume = r.volume;
+                    stream_write(_realtime_module->journal, &jr, sizeof(jr));
+                    new_record = true;
+                }
+            }
+        }
+
+        // Update the loaded stock with the new values, which publishes the change to the stock listeners (i.e. alerts).
+        const stock_index_t stock_index = new_record ? ::stock_index(STRING_ARGS(code)) : 0;
+        if (stock_index > 0)
+        {
+            day_result_t d{};
+            stock_read_real_time_results(stock_index, e, d);
+        }
+    }
+
+    if (_realtime_module->journal)
+        stream_flush(_realtime_module->journal);
 }
 
 FOUNDATION_STATIC void* realtime_background_thread_fn(void*)
 {
     shared_mutex& mutex = _realtime_module->stocks_mutex;
     
-    realtime_stream_stock_entries();
+    realtime_load_store();
 
     if (environment_argument("disable-realtime"))
         return to_ptr(1);
@@ -370,6 +1314,15 @@ FOUNDATION_STATIC void* realtime_background_thread_fn(void*)
         if (quit_thread)
             continue;
 
+        // Stocks are read while fetching, but the thread must not stay in an epoch while it sleeps.
+        EPOCH_SCOPE();
+
+        // Start a new journal each day and seal the previous ones in the background.
+        const int64_t today = realtime_day(time_now());
+        realtime_journal_rotate(today);
+        if (_realtime_module->compacted_day != today)
+            realtime_compact(today);
+
         const time_t now = time_now();
         {
             SHARED_READ_LOCK(mutex);
@@ -423,6 +1376,7 @@ FOUNDATION_STATIC void* realtime_background_thread_fn(void*)
     return 0;
 }
 
+
 FOUNDATION_STATIC int realtime_format_volume_label(double value, char* buff, int size, void* user_data)
 {
     const double abs_value = math_abs(value);
@@ -504,50 +1458,56 @@ FOUNDATION_STATIC table_cell_t realtime_table_draw_title(table_element_ptr_t ele
     return s->code;
 }
 
+FOUNDATION_STATIC realtime_stats_t realtime_stock_stats(const stock_realtime_t* s)
+{
+    if (s->ring == nullptr)
+        return realtime_stats_t{};
+    return realtime_ring_read_stats(s->ring);
+}
+
 FOUNDATION_STATIC table_cell_t realtime_table_column_time(table_element_ptr_t element, const table_column_t* column)
 {
     const stock_realtime_t* s = (const stock_realtime_t*)element;
+    const realtime_stats_t stats = realtime_stock_stats(s);
 
     if (column->flags & COLUMN_RENDER_ELEMENT)
     {
         char time_buffer[64];
-        string_t time_string = localization_string_from_time(STRING_BUFFER(time_buffer), (tick_t)s->timestamp * (tick_t)1000, true);
+        string_t time_string = localization_string_from_time(STRING_BUFFER(time_buffer), (tick_t)stats.timestamp * (tick_t)1000, true);
         ImGui::TextWrapped("%.*s", STRING_FORMAT(time_string));
     }
 
-    return s->timestamp;
+    return stats.timestamp;
 }
 
 FOUNDATION_STATIC table_cell_t realtime_table_column_price(table_element_ptr_t element, const table_column_t* column)
 {
     const stock_realtime_t* s = (const stock_realtime_t*)element;
-    return s->price;
+    return realtime_stock_stats(s).price;
 }
 
 FOUNDATION_STATIC table_cell_t realtime_table_column_volume(table_element_ptr_t element, const table_column_t* column)
 {
     const stock_realtime_t* s = (const stock_realtime_t*)element;
-    return s->volume;
+    return realtime_stock_stats(s).volume;
 }
 
 FOUNDATION_STATIC table_cell_t realtime_table_column_last_change_p(table_element_ptr_t element, const table_column_t* column)
 {
     const stock_realtime_t* s = (const stock_realtime_t*)element;
+    return realtime_stock_stats(s).change_p;
+}
 
-    const auto record_count = array_size(s->records);
-    if (record_count <= 1)
-        return 0.0;
-
-    const auto last = s->records[record_count - 1].price;
-    const auto prev = s->records[record_count - 2].price;
-
-    return (last - prev) / prev * 100.0;
+FOUNDATION_STATIC table_cell_t realtime_table_column_vwap(table_element_ptr_t element, const table_column_t* column)
+{
+    const stock_realtime_t* s = (const stock_realtime_t*)element;
+    return realtime_stock_stats(s).vwap;
 }
 
 FOUNDATION_STATIC table_cell_t realtime_table_column_sample_count(table_element_ptr_t element, const table_column_t* column)
 {
     const stock_realtime_t* s = (const stock_realtime_t*)element;
-    return (double)array_size(s->records);
+    return (double)realtime_stock_record_count(s);
 }
 
 FOUNDATION_STATIC const char* realtime_monitor_price_format(const stock_realtime_t* s)
@@ -565,25 +1525,15 @@ FOUNDATION_STATIC const char* realtime_monitor_price_format(const stock_realtime
 
 FOUNDATION_STATIC bool realtime_render_graph(const stock_realtime_t* s, time_t since, float width, float height)
 {
-    const auto record_count = array_size(s->records);
-    if (record_count <= 1)
-        return false;
-        
-    stock_realtime_record_t* first = &s->records[0];
-    const stock_realtime_record_t* last = array_last(s->records);
-
-    if (since != 0)
-    {
-        int fidx = array_binary_search(s->records, record_count, since);
-        if (fidx < 0)
-            fidx = max(0, min(~fidx, to_int(record_count - 1)));
-        first = &s->records[fidx];
-    }
-
-    const int visible_record_count = (int)(last - first) + 1;
+    // Decode the visible records from the mapped segments, the plot getters read them in place.
+    stock_realtime_record_t*& records = _realtime_module->graph_records;
+    const int visible_record_count = (int)realtime_stock_gather_records(s, since, records);
     if (visible_record_count <= 1)
         return false;
 
+    const stock_realtime_record_t* first = &records[0];
+    const stock_realtime_record_t* last = array_last(records);
+
     if (!ImPlot::BeginPlot(s->code, { width, height }, ImPlotFlags_NoTitle))
         return false;
 
@@ -631,9 +1581,9 @@ FOUNDATION_STATIC table_cell_t realtime_table_draw_monitor(table_element_ptr_t e
 {
     const stock_realtime_t* s = (const stock_realtime_t*)element;
 
+    const size_t record_count = realtime_stock_record_count(s);
     if (column->flags & COLUMN_RENDER_ELEMENT)
     {
-        const size_t record_count = array_size(s->records);
         const time_t since = _realtime_module->time_lapse > 0 ? time_add_hours(time_now(), -_realtime_module->time_lapse) : 0;
         ImGui::PushID(_realtime_module->time_lapse);
         if (record_count < 2 || !realtime_render_graph(s, since, -1.0f, _realtime_module->table->row_fixed_height))
@@ -643,7 +1593,7 @@ FOUNDATION_STATIC table_cell_t realtime_table_draw_monitor(table_element_ptr_t e
         ImGui::PopID();
     }
 
-    return (double)array_size(s->records);
+    return (double)record_count;
 }
 
 FOUNDATION_STATIC void realtime_code_selected(table_element_ptr_const_t element, const table_column_t* column, const table_cell_t* cell)
@@ -705,6 +1655,7 @@ FOUNDATION_STATIC void realtime_render_window()
             table_add_column(_realtime_module->table, "Price", realtime_table_column_price, COLUMN_FORMAT_CURRENCY, COLUMN_SORTABLE | COLUMN_VALIGN_TOP);
             table_add_column(_realtime_module->table, "Volume", realtime_table_column_volume, COLUMN_FORMAT_NUMBER, COLUMN_SORTABLE | COLUMN_VALIGN_TOP | COLUMN_HIDE_DEFAULT | COLUMN_NUMBER_ABBREVIATION);
             table_add_column(_realtime_module->table, "%||Change %", realtime_table_column_last_change_p, COLUMN_FORMAT_PERCENTAGE, COLUMN_SORTABLE | COLUMN_VALIGN_TOP | COLUMN_HIDE_DEFAULT);
+            table_add_column(_realtime_module->table, "VWAP", realtime_table_column_vwap, COLUMN_FORMAT_CURRENCY, COLUMN_SORTABLE | COLUMN_VALIGN_TOP | COLUMN_HIDE_DEFAULT);
             table_add_column(_realtime_module->table, "Monitor", realtime_table_draw_monitor, COLUMN_FORMAT_NUMBER, 
                 COLUMN_SORTABLE | COLUMN_STRETCH | COLUMN_CUSTOM_DRAWING | COLUMN_LEFT_ALIGN | COLUMN_DEFAULT_SORT);
             table_add_column(_realtime_module->table, "#||Samples", realtime_table_column_sample_count, COLUMN_FORMAT_NUMBER, COLUMN_SORTABLE | COLUMN_VALIGN_TOP | COLUMN_HIDE_DEFAULT);
@@ -733,6 +1684,77 @@ FOUNDATION_STATIC void realtime_menu()
     ImGui::EndMenuBar();
 }
 
+FOUNDATION_STATIC expr_result_t realtime_expr_eval(const expr_func_t* f, vec_expr_t* args, void* c)
+{
+    // Examples: RT(AAPL.US, price)
+    //           RT(AAPL.US, vwap)
+    //           RT(AAPL.US, change_p) > 2
+    //           RT(AAPL.US, ticks, NOW() - 3600)
+
+    if (args->len < 2 || args->len > 3)
+        throw ExprError(EXPR_ERROR_INVALID_ARGUMENT, "Invalid arguments");
+
+    string_const_t code = expr_eval(args->get(0)).as_string();
+    string_const_t field_name = expr_eval(args->get(1)).as_string();
+
+    // Requesting the real-time data of a symbol starts tracking its ticks.
+    stock_request(STRING_ARGS(code), FetchLevel::REALTIME);
+
+    EPOCH_SCOPE();
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("ticks")))
+    {
+        time_t since = 0;
+        if (args->len == 3)
+        {
+            expr_result_t since_arg = expr_eval(args->get(2));
+            if (since_arg.type == EXPR_RESULT_SYMBOL)
+            {
+                string_const_t date_string = since_arg.as_string();
+                since = string_to_date(STRING_ARGS(date_string));
+            }
+            else
+            {
+                since = (time_t)since_arg.as_number(0);
+            }
+        }
+
+        stock_realtime_record_t* ticks = nullptr;
+        if (realtime_ticks(STRING_ARGS(code), since, ticks) == 0)
+            return NIL;
+
+        expr_result_t* results = nullptr;
+        foreach(t, ticks)
+            array_push(results, expr_eval_pair((double)t->timestamp, t->price));
+        array_deallocate(ticks);
+        return expr_eval_list(results);
+    }
+
+    realtime_stats_t stats;
+    if (!realtime_stats(STRING_ARGS(code), stats))
+        return NIL;
+
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("price")))
+        return stats.price;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("volume")))
+        return stats.volume;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("min")))
+        return stats.min;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("max")))
+        return stats.max;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("vwap")))
+        return stats.vwap;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("change")))
+        return stats.change;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("change_p")))
+        return stats.change_p;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("count")))
+        return (double)stats.count;
+    if (string_equal_nocase(STRING_ARGS(field_name), STRING_CONST("date")))
+        return (double)stats.timestamp;
+
+    throw ExprError(EXPR_ERROR_INVALID_ARGUMENT, "Invalid field name %.*s", STRING_FORMAT(field_name));
+}
+
 //
 // # PUBLIC API
 //
@@ -740,6 +1762,8 @@ FOUNDATION_STATIC void realtime_menu()
 bool realtime_render_graph(const char* code, size_t code_length, time_t since /*= 0*/, float width /*= -1.0f*/, float height /*= -1.0f*/)
 {
     const hash_t key = hash(code, code_length);
+
+    SHARED_READ_LOCK(_realtime_module->stocks_mutex);
     const int fidx = array_binary_search(_realtime_module->stocks, array_size(_realtime_module->stocks), key);
     if (fidx < 0)
         return false;
@@ -748,6 +1772,27 @@ bool realtime_render_graph(const char* code, size_t code_length, time_t since /*
     return realtime_render_graph(s, since, width, height);
 }
 
+bool realtime_stats(const char* code, size_t code_length, realtime_stats_t& stats)
+{
+    EPOCH_SCOPE();
+    const realtime_ring_t* ring = realtime_ring_find(hash(code, code_length));
+    if (ring == nullptr)
+        return false;
+
+    stats = realtime_ring_read_stats(ring);
+    return true;
+}
+
+size_t realtime_ticks(const char* code, size_t code_length, time_t since, stock_realtime_record_t*& ticks)
+{
+    EPOCH_SCOPE();
+    const realtime_ring_t* ring = realtime_ring_find(hash(code, code_length));
+    if (ring == nullptr)
+        return 0;
+
+    return realtime_ring_read_ticks(ring, since, ticks);
+}
+
 //
 // # SYSTEM
 //
@@ -759,9 +1804,6 @@ FOUNDATION_STATIC void realtime_initialize()
     _realtime_module->show_window = session_get_bool("realtime_show_window", _realtime_module->show_window);
     _realtime_module->time_lapse = session_get_integer("realtime_time_lapse_days", _realtime_module->time_lapse);
 
-    // Open realtime stock stream.
-    _realtime_module->stream = realtime_open_stream();
-
     // Create thread to query realtime stock
     if (main_is_interactive_mode())
     {
@@ -775,6 +1817,10 @@ FOUNDATION_STATIC void realtime_initialize()
 
     dispatcher_register_event_listener(EVENT_STOCK_REQUESTED, realtime_register_new_stock);
 
+    // Report columns and alerts read real-time stats and ticks through expressions.
+    expr_register_function("RT", realtime_expr_eval);
+    expr_register_function("REALTIME", realtime_expr_eval);
+
     #if BUILD_DEVELOPMENT
     module_register_menu(HASH_REALTIME, realtime_menu);
     module_register_window(HASH_REALTIME, realtime_render_window);
@@ -797,15 +1843,24 @@ FOUNDATION_STATIC void realtime_shutdown()
 
     {
         SHARED_WRITE_LOCK(_realtime_module->stocks_mutex);
-        stream_deallocate(_realtime_module->stream);
-        _realtime_module->stream = nullptr;
+        stream_deallocate(_realtime_module->journal);
+        _realtime_module->journal = nullptr;
+        realtime_segments_close(_realtime_module->segments);
     }
 
     foreach(s, _realtime_module->stocks)
         array_deallocate(s->records);
     array_deallocate(_realtime_module->stocks);
+    array_deallocate(_realtime_module->graph_records);
+
+    hashtable64_t* ring_table = (hashtable64_t*)atomic_load_ptr(&_realtime_module->ring_table, memory_order_acquire);
+    if (ring_table)
+        hashtable64_deallocate(ring_table);
+    for (unsigned i = 0, end = array_size(_realtime_module->rings); i < end; ++i)
+        realtime_ring_deallocate(_realtime_module->rings[i]);
+    array_deallocate(_realtime_module->rings);
 
     MEM_DELETE(_realtime_module);
 }
 
-DEFINE_MODULE(REALTIME, realtime_initialize, realtime_shutdown, MODULE_PRIORITY_UI_HEADLESS);
+DEFINE_MODULE(REALTIME, realtime_initialize, realtime_shutdown, MODULE_PRIORITY_UI_HEADLESS, MODULE_FLAGS_NONE, "STOCK,EOD");
@@ -6,5 +6,63 @@
 #pragma once
 
 #include <foundation/time.h>
+#include <foundation/math.h>
+
+struct stock_realtime_t;
+struct stock_realtime_record_t;
+
+/*! Latest realtime values of a symbol and rolling aggregates of the ticks held in its ring. */
+struct realtime_stats_t
+{
+    time_t   timestamp{ 0 };
+    double   price{ NAN };
+    double   volume{ NAN };
+    double   min{ NAN };
+    double   max{ NAN };
+    double   vwap{ NAN };       // Volume weighted average price of the ring ticks
+    double   change{ 0 };       // Price change since the previous tick
+    double   change_p{ 0 };     // Price change since the previous tick in percent
+    uint32_t count{ 0 };        // Number of ticks in the ring
+};
 
 bool realtime_render_graph(const char* code, size_t code_length, time_t since = 0, float width = -1.0f, float height = -1.0f);
+
+/*! Read the latest realtime values of a symbol without locking.
+ *
+ *  @remark The caller must be inside an epoch, which is the case on the main thread and in job handlers.
+ *
+ *  @return False if the symbol is not tracked.
+ */
+bool realtime_stats(const char* code, size_t code_length, realtime_stats_t& stats);
+
+/*! Append the ticks of a symbol ring received since a given time to @ticks without locking.
+ *
+ *  @remark The caller must be inside an epoch, which is the case on the main thread and in job handlers.
+ *
+ *  @return Number of ticks appended.
+ */
+size_t realtime_ticks(const char* code, size_t code_length, time_t since, stock_realtime_record_t*& ticks);
+
+#if BUILD_TESTS
+
+struct stream_t;
+struct realtime_segment_t;
+struct realtime_ring_t;
+
+/*! Storage and ring internals exposed to the realtime tests. */
+FOUNDATION_EXTERN bool realtime_segment_write(const char* path, size_t path_length, int64_t day, const stock_realtime_t* stocks, size_t stock_count);
+FOUNDATION_EXTERN realtime_segment_t* realtime_segment_open(const char* path, size_t path_length);
+FOUNDATION_EXTERN void realtime_segment_close(realtime_segment_t*& segment);
+FOUNDATION_EXTERN size_t realtime_segment_decode(const realtime_segment_t* segment, hash_t key, time_t since, stock_realtime_record_t*& records);
+FOUNDATION_EXTERN void realtime_segment_register_stocks(const realtime_segment_t* segment, stock_realtime_t*& stocks);
+FOUNDATION_EXTERN realtime_segment_t** realtime_segments_open(const char* dir, size_t dir_length, int64_t oldest_day);
+FOUNDATION_EXTERN void realtime_segments_close(realtime_segment_t**& segments);
+FOUNDATION_EXTERN bool realtime_journal_seal(const char* dir, size_t dir_length, stream_t* stream, size_t offset, int64_t*& days);
+FOUNDATION_EXTERN bool realtime_segment_commit(const char* dir, size_t dir_length, int64_t day);
+FOUNDATION_EXTERN realtime_ring_t* realtime_ring_allocate(hash_t key);
+FOUNDATION_EXTERN void realtime_ring_deallocate(realtime_ring_t*& ring);
+FOUNDATION_EXTERN bool realtime_ring_push(realtime_ring_t* ring, const stock_realtime_record_t& tick);
+FOUNDATION_EXTERN realtime_stats_t realtime_ring_read_stats(const realtime_ring_t* ring);
+FOUNDATION_EXTERN size_t realtime_ring_read_ticks(const realtime_ring_t* ring, time_t since, stock_realtime_record_t*& ticks);
+
+#endif
@@ -37,6 +37,10 @@
 #include <framework/localization.h>
 #include <framework/system.h>
 #include <framework/window.h>
+#include <framework/profiler.h>
+#include <framework/jobs.h>
+#include <framework/shared_mutex.h>
+#include <framework/epoch.h>
 
 #include <foundation/uuid.h>
 #include <foundation/path.h>
@@ -63,6 +67,91 @@ typedef enum report_column_formula_enum_t : unsigned int {
     REPORT_FORMULA_PS,
 } report_column_formula_t;
 
+/*! Delay after which the report summary is recomputed for all titles, so that values depending on the current day 
+ *  or on exchange rates fetched later on do not drift from the incremental updates. */
+constexpr double REPORT_SUMMARY_FULL_UPDATE_DELAY = 5.0 * 60.0;
+
+/*! Title values summed in the report summary. 
+ * 
+ *  @remark All fields are doubles so that values can be added or removed from the totals at once.
+ */
+struct report_summary_values_t
+{
+    double days{ 0 };
+    double active_titles{ 0 };
+    double value{ 0 };
+    double investment{ 0 };
+    double sell_gain_if_kept{ 0 };
+    double sell_gain_if_kept_p{ 0 };
+    double title_sell_count{ 0 };
+    double sell_rated{ 0 };
+    double sell_gain_rated{ 0 };
+    double projected_sell_loses{ 0 };
+    double buy_rated{ 0 };
+    double nq{ 0 };
+    double nq_count{ 0 };
+    double day_gain{ 0 };
+    double daily_average_p{ 0 };
+    double resolved_count{ 0 };
+    double dividends{ 0 };
+};
+
+/*! Values of a title in the report summary and the inputs they were computed from. */
+struct report_summary_title_t
+{
+    const title_t*          title;
+    const stock_t*          stock;
+    tick_t                  stock_update_time;
+    uint32_t                title_revision;
+    report_summary_values_t values;
+};
+
+/*! Running totals of the report summary, updated with the changes of each title. */
+struct report_summary_t
+{
+    report_summary_values_t totals{};
+    report_summary_title_t* titles{ nullptr }; // Sorted by title pointer
+    tick_t                  last_full_update{ 0 };
+    int                     eod_days{ 0 };     // Rounded wallet average days the title values were computed with
+    bool                    invalidated{ true };
+};
+
+/*! Report content that titles refer to, released once background passes cannot read it anymore. */
+struct report_retired_content_t
+{
+    wallet_t*       wallet{ nullptr };
+    config_handle_t data{};
+};
+
+/*! Maximum number of titles of the same exchange requested by a single sync job. */
+constexpr unsigned REPORT_SYNC_JOB_MAX_TITLES = 16;
+
+/*! Title resolved by a report sync, also used as the context of its stock resolution waiter. */
+struct report_sync_title_t
+{
+    report_sync_t*  sync;
+    title_t*        title;
+    string_const_t  exchange;
+};
+
+/*! Titles of a report being resolved in the background. */
+struct report_sync_t
+{
+    report_t*                      report{ nullptr };
+    report_sync_progress_handler_t progress{ nullptr };
+    report_sync_title_t*           titles{ nullptr };   // Never resized once requests are sent
+    title_t**                      skipped{ nullptr };  // Titles already resolved or not synced (i.e. indexes)
+    title_t**                      resolved{ nullptr }; // Titles resolved since the last wait, protected by the lock
+    unsigned                       processed_count{ 0 };
+    atomic32_t                     pending{};           // Titles left to resolve
+    atomic32_t                     failed{};            // Titles that could not be requested
+    atomic32_t                     jobs_running{};
+    shared_mutex                   lock;
+    event_handle                   signal;              // Raised when a title resolves or a job ends
+    tick_t                         started{ 0 };
+    bool                           completed{ false };
+};
+
 static report_t* _reports = nullptr;
 static bool* _last_show_ui_ptr = nullptr;
 // 
@@ -105,6 +194,7 @@ FOUNDATION_STATIC void report_title_remove(report_handle_t report_handle, const
     auto ctitles = report->data["titles"];
     if (config_remove(ctitles, title->code, title->code_length))
     {
+        report_expression_columns_release(report);
         for (int i = 0, end = array_size(report->titles); i != end; ++i)
         {
             if (title == report->titles[i])
@@ -1337,6 +1427,8 @@ FOUNDATION_STATIC void report_delete(report_t* report)
     string_const_t report_save_file = report_get_save_file_path(report);
     if (fs_is_file(STRING_ARGS(report_save_file)))
         fs_remove_file(STRING_ARGS(report_save_file));
+    wallet_history_delete_store(report->wallet);
+    timeline_delete_store(report);
 }
 
 FOUNDATION_STATIC void report_toggle_show_summary(report_t* report)
@@ -1587,6 +1679,7 @@ FOUNDATION_STATIC bool report_initial_sync(report_t* report)
     array_deallocate(update_jobs);
 
     report_filter_out_titles(report);
+    report_summary_invalidate(report);
     report_summary_update(report);
     wallet_update_tracking_history(report, report->wallet);
 
@@ -1647,6 +1740,9 @@ FOUNDATION_STATIC report_handle_t report_allocate(const char* name, size_t name_
         cid = config_set(report->data, STRING_CONST("id"), STRING_ARGS(id_str));
     }
 
+    // Load the wallet daily valuation history store
+    wallet_history_load(report->wallet, STRING_ARGS(string_from_uuid_static(report->id)));
+
     report->save_index = report->data["order"].as_integer();
     report->show_summary = report->data["show_summary"].as_boolean();
     report->show_sold_title = report->data["show_sold_title"].as_boolean(true);
@@ -1900,143 +1996,265 @@ FOUNDATION_STATIC bool report_handle_shortcuts(report_t* report)
     return false;
 }
 
-// 
-// # PUBLIC API
-//
+FOUNDATION_STATIC void report_summary_values_add(report_summary_values_t& totals, const report_summary_values_t& values, double sign)
+{
+    static_assert(sizeof(report_summary_values_t) % sizeof(double) == 0, "Summary values must only be doubles");
+    double* t = (double*)&totals;
+    const double* v = (const double*)&values;
+    for (size_t i = 0; i < sizeof(report_summary_values_t) / sizeof(double); ++i)
+        t[i] += v[i] * sign;
+}
 
-void report_summary_update(report_t* report)
+FOUNDATION_STATIC bool report_summary_values_are_finite(const report_summary_values_t& values)
 {
-    // Update report average days
-    double total_days = 0;
-    double total_value = 0;
-    double total_investment = 0;
-    double total_sell_gain_if_kept = 0;
-    double total_sell_gain_if_kept_p = 0;
-    double total_title_sell_count = 0;
-    double total_sell_rated = 0;
-    double total_sell_gain_rated = 0;
-    double total_projected_sell_loses = 0;
-    double total_buy_rated = 0;
-    double average_nq = 0;
-    double average_nq_count = 0;
-    double total_day_gain = 0;
-    double total_daily_average_p = 0;
-    double title_resolved_count = 0;
-    double total_dividends = 0;
-    double total_active_titles = 0;
-    const size_t title_count = array_size(report->titles);
-    for (size_t i = 0; i < title_count; ++i)
+    const double* v = (const double*)&values;
+    for (size_t i = 0; i < sizeof(report_summary_values_t) / sizeof(double); ++i)
     {
-        const title_t* t = report->titles[i];
-        FOUNDATION_ASSERT(t);
+        if (!math_real_is_finite(v[i]))
+            return false;
+    }
+    return true;
+}
 
-        if (title_is_index(t))
-            continue;
+FOUNDATION_STATIC report_summary_values_t report_summary_title_values(const title_t* t, int eod_days)
+{
+    report_summary_values_t v{};
+    if (title_is_index(t))
+        return v;
 
-        if (t->average_quantity > 0)
-        {
-            const double days_held = title_average_days_held(t);
-            
-            total_days += days_held;
-            total_active_titles++;
-        }
+    if (t->average_quantity > 0)
+    {
+        v.days = title_average_days_held(t);
+        v.active_titles = 1;
+    }
 
-        const bool title_is_sold = title_sold(t);
-        if (!title_is_sold)
-            total_investment += title_total_bought_price(t);
+    const bool title_is_sold = title_sold(t);
+    if (!title_is_sold)
+        v.investment = title_total_bought_price(t);
 
-        const stock_t* s = t->stock;
-        const bool stock_valid = s && !math_real_is_nan(s->current.change_p);
-        // Make sure the stock is still valid today, it might have been delisted.
-        if (stock_valid)
+    const stock_t* s = t->stock;
+    const bool stock_valid = s && !math_real_is_nan(s->current.change_p);
+    // Make sure the stock is still valid today, it might have been delisted.
+    if (stock_valid)
+    {
+        if (!title_is_sold)
         {
-            if (!title_is_sold)
-            {
-                total_value += title_get_total_value(t);
-                average_nq += s->current.change_p / 100.0;
-                average_nq_count++;
+            v.value = title_get_total_value(t);
+            v.nq += s->current.change_p / 100.0;
+            v.nq_count++;
 
-                average_nq += title_get_yesterday_change(t, s) / 100.0;
-                average_nq_count++;
-            }
+            v.nq += title_get_yesterday_change(t, s) / 100.0;
+            v.nq_count++;
+        }
 
-            const day_result_t* ed = stock_get_EOD(s, -math_round(report->wallet->average_days), true);
-            if (ed)
-            {
-                double eod_change_p = math_change_p(t->stock->current.price, ed->adjusted_close);
-                average_nq += eod_change_p;
-                average_nq_count++;
-            }
+        const day_result_t* ed = stock_get_EOD(s, -eod_days, true);
+        if (ed)
+        {
+            double eod_change_p = math_change_p(s->current.price, ed->adjusted_close);
+            v.nq += eod_change_p;
+            v.nq_count++;
+        }
 
-            if (!math_real_is_nan(s->current.change))
-                total_day_gain += math_ifnan(title_get_day_change(t, s), 0);
+        if (!math_real_is_nan(s->current.change))
+            v.day_gain = math_ifnan(title_get_day_change(t, s), 0);
 
-            total_daily_average_p += s->current.change_p;
+        v.daily_average_p = s->current.change_p;
+        v.resolved_count = 1;
+    }
+    else if (!title_is_sold)
+    {
+        v.value = t->average_quantity * t->average_price;
+    }
 
-            title_resolved_count++;
-        }
-        else if (!title_is_sold)
+    v.buy_rated = t->buy_total_price_rated;
+    v.sell_rated = t->sell_total_price_rated;
+    v.dividends = t->total_dividends;
+
+    if (stock_valid && t->sell_total_quantity > 0)
+    {
+        const double sell_adjusted_price = t->sell_total_price_rated / t->sell_total_quantity;
+        const double sell_gain_if_kept = (s->current.adjusted_close - sell_adjusted_price) * t->sell_total_quantity;
+        const double sell_p = (s->current.price - sell_adjusted_price) / sell_adjusted_price;
+        if (!math_real_is_nan(sell_p))
         {
-            total_value += t->average_quantity * t->average_price;
+            v.sell_gain_if_kept_p = sell_p;
+            v.sell_gain_if_kept = sell_gain_if_kept;
+            v.title_sell_count = 1;
+            v.sell_gain_rated = title_get_sell_gain_rated(t, true);
+            v.projected_sell_loses = title_get_sell_gain_rated(t, false);
         }
+    }
 
-        total_buy_rated += t->buy_total_price_rated;
-        total_sell_rated += t->sell_total_price_rated;
-        total_dividends += t->total_dividends;
+    return v;
+}
 
-        if (stock_valid && t->sell_total_quantity > 0)
-        {
-            const double sell_adjusted_price = t->sell_total_price_rated / t->sell_total_quantity;
-            const double sell_gain_if_kept = (s->current.adjusted_close - sell_adjusted_price) * t->sell_total_quantity;
-            const double sell_p = (s->current.price - sell_adjusted_price) / sell_adjusted_price;
-            if (!math_real_is_nan(sell_p))
-            {
-                total_sell_gain_if_kept_p += sell_p;
-                total_sell_gain_if_kept += sell_gain_if_kept;
-                total_title_sell_count++;
-                total_sell_gain_rated += title_get_sell_gain_rated(t, true);
-                total_projected_sell_loses += title_get_sell_gain_rated(t, false);
-            }
-        }
+FOUNDATION_STATIC void report_summary_title_record(report_summary_title_t& record, const title_t* t, int eod_days)
+{
+    const stock_t* s = t->stock;
+    record.title = t;
+    record.stock = s;
+    record.stock_update_time = s ? s->last_update_time : 0;
+    record.title_revision = title_revision(t);
+    record.values = report_summary_title_values(t, eod_days);
+}
+
+FOUNDATION_STATIC bool report_summary_title_changed(const report_summary_title_t& record)
+{
+    const title_t* t = record.title;
+    const stock_t* s = t->stock;
+    if (record.stock != s || record.title_revision != title_revision(t))
+        return true;
+    return s && record.stock_update_time != s->last_update_time;
+}
+
+FOUNDATION_STATIC int report_summary_find_title(const report_summary_t* summary, const title_t* title)
+{
+    return array_binary_search_compare(summary->titles, title, [](const report_summary_title_t& record, const title_t* t)
+    {
+        if (record.title < t)
+            return -1;
+        if (record.title > t)
+            return 1;
+        return 0;
+    });
+}
+
+/*! Recompute the values of all titles. */
+FOUNDATION_STATIC void report_summary_compute_all(report_t* report, report_summary_t* summary)
+{
+    summary->eod_days = math_round(report->wallet->average_days);
+    summary->totals = {};
+    array_clear(summary->titles);
+
+    const size_t title_count = array_size(report->titles);
+    array_reserve(summary->titles, title_count);
+    for (size_t i = 0; i < title_count; ++i)
+    {
+        const title_t* t = report->titles[i];
+        FOUNDATION_ASSERT(t);
+
+        report_summary_title_t record;
+        report_summary_title_record(record, t, summary->eod_days);
+        report_summary_values_add(summary->totals, record.values, 1.0);
+        array_push_memcpy(summary->titles, &record);
     }
 
-    if (total_active_titles > 0)
-        report->wallet->average_days = total_days / total_active_titles;
+    array_sort(summary->titles, [](const report_summary_title_t& a, const report_summary_title_t& b)
+    {
+        return a.title < b.title ? -1 : a.title > b.title ? 1 : 0;
+    });
+
+    summary->last_full_update = time_current();
+    summary->invalidated = false;
+}
 
-    if (average_nq_count > 0)
-        average_nq /= average_nq_count;
+/*! Update the values of the titles whose orders or stock changed since the last update.
+ * 
+ *  @return False if titles were added or removed and all values must be recomputed.
+ */
+FOUNDATION_STATIC bool report_summary_compute_changes(report_t* report, report_summary_t* summary)
+{
+    const size_t title_count = array_size(report->titles);
+    if (title_count != array_size(summary->titles))
+        return false;
 
-    report->wallet->total_title_sell_count = total_title_sell_count;
-    report->wallet->total_sell_gain_if_kept = total_sell_gain_if_kept;
-    if (total_title_sell_count > 0)
-        total_sell_gain_if_kept_p /= total_title_sell_count;
-    else
-        total_sell_gain_if_kept_p = 0;
-
-    report->total_daily_average_p = total_daily_average_p / title_resolved_count;
-    report->total_value = total_value;
-    report->total_investment = total_investment;
-    report->total_gain = total_value - total_investment + total_dividends;
-    if (total_investment != 0)
-        report->total_gain_p = report->total_gain / total_investment;
+    for (size_t i = 0; i < title_count; ++i)
+    {
+        const title_t* t = report->titles[i];
+        const int record_index = report_summary_find_title(summary, t);
+        if (record_index < 0)
+            return false;
+
+        report_summary_title_t& record = summary->titles[record_index];
+        if (!report_summary_title_changed(record))
+            continue;
+
+        // Values that were not finite cannot be removed from the totals.
+        if (!report_summary_values_are_finite(record.values))
+            return false;
+
+        report_summary_values_add(summary->totals, record.values, -1.0);
+        report_summary_title_record(record, t, summary->eod_days);
+        if (!report_summary_values_are_finite(record.values))
+            return false;
+        report_summary_values_add(summary->totals, record.values, 1.0);
+    }
+
+    return true;
+}
+
+/*! Update the report and wallet summary values from the summary totals. */
+FOUNDATION_STATIC void report_summary_publish(report_t* report, const report_summary_values_t& totals)
+{
+    double average_nq = totals.nq;
+    if (totals.nq_count > 0)
+        average_nq /= totals.nq_count;
+
+    if (totals.active_titles > 0)
+        report->wallet->average_days = totals.days / totals.active_titles;
+
+    report->wallet->total_title_sell_count = totals.title_sell_count;
+    report->wallet->total_sell_gain_if_kept = totals.sell_gain_if_kept;
+
+    double total_sell_gain_if_kept_p = 0;
+    if (totals.title_sell_count > 0)
+        total_sell_gain_if_kept_p = totals.sell_gain_if_kept_p / totals.title_sell_count;
+
+    report->total_daily_average_p = totals.daily_average_p / totals.resolved_count;
+    report->total_value = totals.value;
+    report->total_investment = totals.investment;
+    report->total_gain = totals.value - totals.investment + totals.dividends;
+    if (totals.investment != 0)
+        report->total_gain_p = report->total_gain / totals.investment;
     else
         report->total_gain_p = 0;
-    report->total_day_gain = total_day_gain;
+    report->total_day_gain = totals.day_gain;
     report->summary_last_update = time_current();
 
     // Update historical values
-    report->wallet->sell_average = total_sell_rated / total_title_sell_count;
-    report->wallet->sell_total_gain = total_sell_gain_rated;
-    report->wallet->sell_total_projected_gain = total_projected_sell_loses;
-    report->wallet->sell_gain_average = total_sell_gain_rated / total_title_sell_count;
+    report->wallet->sell_average = totals.sell_rated / totals.title_sell_count;
+    report->wallet->sell_total_gain = totals.sell_gain_rated;
+    report->wallet->sell_total_projected_gain = totals.projected_sell_loses;
+    report->wallet->sell_gain_average = totals.sell_gain_rated / totals.title_sell_count;
     report->wallet->total_sell_gain_if_kept_p = total_sell_gain_if_kept_p;
     report->wallet->target_ask = report->wallet->main_target + report->total_gain_p;
     report->wallet->profit_ask = 
         max(report->wallet->target_ask + 
-            min(total_sell_gain_if_kept_p, max(report->wallet->target_ask * total_title_sell_count, 0.0)) +
+            min(total_sell_gain_if_kept_p, max(report->wallet->target_ask * totals.title_sell_count, 0.0)) +
             math_abs(average_nq), 0.03);
     report->wallet->enhanced_earnings = math_abs(report->wallet->sell_gain_average) * (1.0 + report->wallet->main_target);
-    report->wallet->total_dividends = total_dividends;
+    report->wallet->total_dividends = totals.dividends;
+}
+
+// 
+// # PUBLIC API
+//
+
+void report_summary_invalidate(report_t* report)
+{
+    FOUNDATION_ASSERT(report);
+    if (report->summary)
+        report->summary->invalidated = true;
+}
+
+void report_summary_update(report_t* report)
+{
+    PERFORMANCE_TRACKER("report_summary_update");
+
+    FOUNDATION_ASSERT(report);
+    if (report->summary == nullptr)
+        report->summary = MEM_NEW(HASH_REPORT, report_summary_t);
+
+    report_summary_t* summary = report->summary;
+    if (summary->invalidated ||
+        summary->eod_days != math_round(report->wallet->average_days) ||
+        time_elapsed(summary->last_full_update) > REPORT_SUMMARY_FULL_UPDATE_DELAY ||
+        !report_summary_compute_changes(report, summary))
+    {
+        report_summary_compute_all(report, summary);
+    }
+
+    report_summary_publish(report, summary->totals);
 }
 
 bool report_is_loading(report_t* report)
@@ -2228,11 +2446,20 @@ bool report_save(report_t* report, const char* file_path, size_t file_path_lengt
 
     report_expression_columns_save(report);    
 
-    wallet_save(report->wallet, config_set_object(report->data, STRING_CONST("wallet")));
+    // Wallet history lives in its own store, so it is only embedded when the report gets exported.
+    string_const_t save_file_path = report_get_save_file_path(report);
+    const bool exporting = !string_equal(file_path, file_path_length, STRING_ARGS(save_file_path));
+
+    config_handle_t wallet_data = config_set_object(report->data, STRING_CONST("wallet"));
+    wallet_save(report->wallet, wallet_data, exporting);
 
     string_const_t report_file_path = string_const(file_path, file_path_length);
-    return config_write_file(report_file_path, report->data,
+    const bool saved = config_write_file(report_file_path, report->data,
         CONFIG_OPTION_WRITE_SKIP_NULL | CONFIG_OPTION_WRITE_SKIP_DOUBLE_COMMA_FIELDS | CONFIG_OPTION_WRITE_NO_SAVE_ON_DATA_EQUAL);
+
+    if (exporting)
+        config_remove(wallet_data, wallet_data["history"]);
+    return saved;
 }
 
 void report_save(report_t* report)
@@ -2259,6 +2486,9 @@ void report_render(report_t* report)
     imgui_frame_render_callback_t summary_frame = nullptr;
     if (report->show_summary)
     {
+        // Only titles that changed since the last frame are recomputed.
+        report_summary_update(report);
+
         summary_frame = [report](const ImRect& rect)
         {
             ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(2.0F, 0));
@@ -2361,71 +2591,221 @@ bool report_handle_is_valid(report_handle_t handle)
     return !uuid_is_null(handle);
 }
 
-bool report_sync_titles(report_t* report, double timeout_seconds /*= 60.0*/)
+FOUNDATION_STATIC void report_sync_title_resolved(const stock_t* stock, void* context)
 {
-    const size_t title_count = array_size(report->titles);
+    report_sync_title_t* entry = (report_sync_title_t*)context;
+    report_sync_t* sync = entry->sync;
 
-    job_t** update_jobs = nullptr;
+    {
+        SHARED_WRITE_LOCK(sync->lock);
+        array_push(sync->resolved, entry->title);
+    }
 
-    // Trigger updates
-    for (size_t i = 0; i < title_count; ++i)
+    atomic_decr32(&sync->pending, memory_order_release);
+    sync->signal.signal();
+}
+
+FOUNDATION_STATIC void report_sync_request_titles(report_sync_t* sync, unsigned begin, unsigned end)
+{
+    for (unsigned i = begin; i < end; ++i)
     {
-        title_t* t = report->titles[i];
-        if (title_is_index(t))
-            continue;
+        report_sync_title_t* entry = &sync->titles[i];
+        title_t* t = entry->title;
+        log_debugf(HASH_REPORT, STRING_CONST("Syncing title %s"), t->code);
 
-        if (!title_is_resolved(t))
+        title_update(t, 5.0);
+        const stock_t* s = t->stock;
+        if (s == nullptr)
         {
-            job_t* job = job_execute([](void* context)->int
-            {
-                title_t* t = (title_t*)context;
-                log_debugf(HASH_REPORT, STRING_CONST("Syncing title %s"), t->code);
-                title_update(t, 5.0);
-                return 0;
-            }, t);
-            array_push(update_jobs, job);
+            log_warnf(HASH_REPORT, WARNING_RESOURCE, STRING_CONST("Failed to request title %s"), t->code);
+            atomic_incr32(&sync->failed, memory_order_relaxed);
+            atomic_decr32(&sync->pending, memory_order_release);
+            sync->signal.signal();
+            continue;
         }
+
+        stock_on_resolved(s, title_minimum_fetch_level(t), report_sync_title_resolved, entry);
     }
 
-    // Wait for updates
-    for (unsigned i = 0, count = array_size(update_jobs); i < count; ++i)
+    // The main thread may be blocked waiting for the sync, so it cannot fire the real-time batch timer.
+    stock_flush_real_time_requests();
+
+    // Signal under the lock so that a deallocating sync cannot release the signal while we raise it.
+    SHARED_WRITE_LOCK(sync->lock);
+    atomic_decr32(&sync->jobs_running, memory_order_release);
+    sync->signal.signal();
+}
+
+FOUNDATION_STATIC void report_sync_process_resolved_titles(report_sync_t* sync)
+{
+    title_t** resolved = nullptr;
     {
-        job_t* job = update_jobs[i];
-        while (!job_completed(job))
-            dispatcher_wait_for_wakeup_main_thread();
-        job_deallocate(job);
+        SHARED_WRITE_LOCK(sync->lock);
+        resolved = sync->resolved;
+        sync->resolved = nullptr;
     }
-    array_deallocate(update_jobs);
 
-    // Wait for title resolution
-    tick_t timer = time_current();
-    for (size_t i = 0; i < title_count; ++i)
+    const unsigned title_count = array_size(sync->titles);
+    foreach(pt, resolved)
     {
-        title_t* t = report->titles[i];
-        if (title_is_index(t))
+        title_t* t = *pt;
+        title_refresh(t);
+        sync->processed_count++;
+        log_debugf(HASH_REPORT, STRING_CONST(">>> Title %s synced"), t->code);
+
+        if (sync->progress)
+            sync->progress(sync->report, t, sync->processed_count, title_count);
+    }
+    array_deallocate(resolved);
+}
+
+FOUNDATION_STATIC void report_sync_complete(report_sync_t* sync)
+{
+    report_t* report = sync->report;
+    foreach(pt, sync->skipped)
+        title_refresh(*pt);
+
+    // Synced titles were refreshed as they resolved, the summary only picks up their changes.
+    report_summary_update(report);
+    if (report->table)
+        report->table->needs_sorting = true;
+
+    sync->completed = true;
+    log_infof(HASH_REPORT, STRING_CONST("Report %s synced completed in %.3g seconds"), SYMBOL_CSTR(report->name), time_elapsed(sync->started));
+}
+
+report_sync_t* report_sync_titles_async(report_t* report, const report_sync_progress_handler_t& progress /*= nullptr*/)
+{
+    FOUNDATION_ASSERT(report);
+
+    report_sync_t* sync = MEM_NEW(HASH_REPORT, report_sync_t);
+    sync->report = report;
+    sync->progress = progress;
+    sync->started = time_current();
+
+    foreach(pt, report->titles)
+    {
+        title_t* t = *pt;
+        if (title_is_index(t) || title_is_resolved(t))
+        {
+            array_push(sync->skipped, t);
             continue;
-            
-        while (!title_is_resolved(t))
+        }
+
+        string_const_t exchange{ t->code + t->code_length, 0 };
+        const size_t dot = string_rfind(t->code, t->code_length, '.', STRING_NPOS);
+        if (dot != STRING_NPOS)
+            exchange = string_const(t->code + dot + 1, t->code_length - dot - 1);
+
+        report_sync_title_t entry{ sync, t, exchange };
+        array_push_memcpy(sync->titles, &entry);
+    }
+
+    const unsigned title_count = array_size(sync->titles);
+    atomic_store32(&sync->pending, (int32_t)title_count, memory_order_release);
+    if (title_count == 0)
+        return sync;
+
+    // Group titles of the same exchange so that each job requests a single exchange.
+    array_sort(sync->titles, [](const report_sync_title_t& a, const report_sync_title_t& b)
+    {
+        const int cmp = string_compare(STRING_ARGS(a.exchange), STRING_ARGS(b.exchange));
+        if (cmp != 0)
+            return cmp;
+        return string_compare(a.title->code, a.title->code_length, b.title->code, b.title->code_length);
+    });
+
+    unsigned begin = 0;
+    while (begin < title_count)
+    {
+        unsigned end = begin + 1;
+        while (end < title_count && end - begin < REPORT_SYNC_JOB_MAX_TITLES &&
+            string_equal(STRING_ARGS(sync->titles[end].exchange), STRING_ARGS(sync->titles[begin].exchange)))
         {
-            if (time_elapsed(timer) > timeout_seconds)
-                return false;
+            ++end;
+        }
 
-            dispatcher_wait_for_wakeup_main_thread(50);
+        atomic_incr32(&sync->jobs_running, memory_order_relaxed);
+        job_execute([sync, begin, end](payload_t*)
+        {
+            report_sync_request_titles(sync, begin, end);
+            return 0;
+        }, nullptr, JOB_DEALLOCATE_AFTER_EXECUTION);
+        begin = end;
+    }
+
+    return sync;
+}
+
+bool report_sync_wait(report_sync_t* sync, double timeout_seconds)
+{
+    FOUNDATION_ASSERT(sync);
+
+    const tick_t timer = time_current();
+    for (;;)
+    {
+        report_sync_process_resolved_titles(sync);
+
+        if (atomic_load32(&sync->pending, memory_order_acquire) == 0)
+        {
+            // Titles resolved by a waiter are all queued before the pending count reaches zero.
+            report_sync_process_resolved_titles(sync);
+            if (!sync->completed)
+                report_sync_complete(sync);
+            return atomic_load32(&sync->failed, memory_order_relaxed) == 0;
         }
 
-        log_debugf(HASH_REPORT, STRING_CONST(">>> Title %s synced"), t->code);
+        const double remaining = timeout_seconds - time_elapsed(timer);
+        if (remaining <= 0)
+            return false;
+
+        sync->signal.wait((int)math_ceil(remaining * 1000.0));
     }
+}
 
-    // Update report summary
-    report_summary_update(report);
-    for (size_t i = 0; i < title_count; ++i)
-        title_refresh(report->titles[i]);
-    report_summary_update(report);
-    if (report->table)
-        report->table->needs_sorting = true;
+unsigned report_sync_resolved_count(const report_sync_t* sync)
+{
+    FOUNDATION_ASSERT(sync);
+    return array_size(sync->titles) - (unsigned)atomic_load32(&sync->pending, memory_order_acquire);
+}
 
-    log_infof(HASH_REPORT, STRING_CONST("Report %s synced completed in %.3g seconds"), SYMBOL_CSTR(report->name), time_elapsed(timer));
-    return true;
+unsigned report_sync_title_count(const report_sync_t* sync)
+{
+    FOUNDATION_ASSERT(sync);
+    return array_size(sync->titles);
+}
+
+void report_sync_deallocate(report_sync_t*& sync)
+{
+    if (sync == nullptr)
+        return;
+
+    // Jobs only send requests, so they never take long to end.
+    for (;;)
+    {
+        {
+            SHARED_READ_LOCK(sync->lock);
+            if (atomic_load32(&sync->jobs_running, memory_order_acquire) == 0)
+                break;
+        }
+        sync->signal.wait(100);
+    }
+
+    foreach(e, sync->titles)
+        stock_cancel_on_resolved(report_sync_title_resolved, e);
+
+    array_deallocate(sync->titles);
+    array_deallocate(sync->skipped);
+    array_deallocate(sync->resolved);
+    MEM_DELETE(sync);
+}
+
+bool report_sync_titles(report_t* report, double timeout_seconds /*= 60.0*/)
+{
+    report_sync_t* sync = report_sync_titles_async(report);
+    const bool synced = report_sync_wait(sync, timeout_seconds);
+    report_sync_deallocate(sync);
+    return synced;
 }
 
 title_t* report_add_title(report_t* report, const char* code, size_t code_length)
@@ -2433,16 +2813,36 @@ title_t* report_add_title(report_t* report, const char* code, size_t code_length
     return report_title_add(report, string_const(code, code_length));
 }
 
+FOUNDATION_STATIC void report_retired_content_deallocate(void* ptr)
+{
+    report_retired_content_t* content = (report_retired_content_t*)ptr;
+    wallet_deallocate(content->wallet);
+    config_deallocate(content->data);
+    MEM_DELETE(content);
+}
+
 void report_deallocate(report_t* report)
 {
     table_deallocate(report->table);
+    report_expression_columns_release(report);
 
     foreach (title, report->titles)
         title_deallocate(*title);
     array_deallocate(report->titles);
     array_deallocate(report->transactions);
-    wallet_deallocate(report->wallet);
-    config_deallocate(report->data);
+    if (report->summary)
+    {
+        array_deallocate(report->summary->titles);
+        MEM_DELETE(report->summary);
+    }
+
+    // Titles being retired still refer to the wallet and the report data.
+    report_retired_content_t* content = MEM_NEW(HASH_REPORT, report_retired_content_t);
+    content->wallet = report->wallet;
+    content->data = report->data;
+    epoch_retire(content, report_retired_content_deallocate);
+    report->wallet = nullptr;
+    report->data = {};
     array_deallocate(report->expression_columns);
 }
 
@@ -2507,6 +2907,18 @@ void report_table_rebuild(report_t* report)
     }
 }
 
+bool report_export_csv(report_t* report, const char* path, size_t path_length)
+{
+    FOUNDATION_ASSERT(report);
+
+    if (report->table == nullptr)
+        report->table = report_create_table(report);
+
+    report_filter_out_titles(report);
+    table_update_rows(report->table, report->titles, (int)report->active_titles, sizeof(title_t*));
+    return table_export_csv(report->table, path, path_length);
+}
+
 report_handle_t report_get_handle(const report_t* report_ptr)
 {
     foreach (p, _reports)
@@ -2604,4 +3016,4 @@ FOUNDATION_STATIC void report_shutdown()
     _reports = nullptr;
 }
 
-DEFINE_MODULE(REPORT, report_initialize, report_shutdown, MODULE_PRIORITY_HIGH);
+DEFINE_MODULE(REPORT, report_initialize, report_shutdown, MODULE_PRIORITY_HIGH, MODULE_FLAGS_NONE, "STOCK,EOD,LOCALIZATION");
@@ -16,7 +16,12 @@
 struct title_t;
 struct table_t;
 struct wallet_t;
+struct expr_t;
+struct expr_result_t;
+struct report_summary_t;
+struct report_sync_t;
 struct report_expression_column_t;
+enum class FetchLevel;
 
 /*! Represents a report handle that can be used to resolve a report pointer later on. */
 typedef uuid_t report_handle_t;
@@ -62,6 +67,7 @@ struct report_t
 
     // Report summary values
     wallet_t* wallet{ nullptr };
+    report_summary_t* summary{ nullptr };
     tick_t summary_last_update{ 0 };
     double total_gain { 0 };
     double total_gain_p { 0 };
@@ -170,11 +176,19 @@ bool report_handle_is_valid(report_handle_t handle);
 void report_open_create_dialog();
 
 /*! Initiate a report summary update (that is displayed in the summary panel)
+ * 
+ * @remark Only the titles whose orders or stock changed since the last update are recomputed.
  * 
  * @param report    The report to update.
  */
 void report_summary_update(report_t* report);
 
+/*! Recompute all titles on the next report summary update, i.e. when the wallet settings change.
+ * 
+ * @param report    The report to invalidate.
+ */
+void report_summary_invalidate(report_t* report);
+
 /*! Initiate a report refreshing process.
  * 
  * @param report   The report to refresh.
@@ -190,9 +204,49 @@ bool report_is_loading(report_t* report);
  * 
  * @param report            The report to synchronize.
  * @param timeout_seconds   The maximum amount of time to spend on the synchronization.
+ * 
+ * @return                  True if all titles were resolved before the timeout.
  */
 bool report_sync_titles(report_t* report, double timeout_seconds = 60.0);
 
+/*! Invoked on the thread waiting for a report sync each time a title gets resolved.
+ *  The title values are already refreshed, so they can be used before the whole report is synced.
+ */
+typedef function<void(report_t* report, title_t* title, unsigned resolved_count, unsigned title_count)> report_sync_progress_handler_t;
+
+/*! Start resolving the report titles in the background.
+ *  Requests are grouped by exchange and the titles get refreshed as they resolve when waiting on the sync.
+ * 
+ * @param report    The report to synchronize.
+ * @param progress  Optional handler invoked for each resolved title.
+ * 
+ * @return          The sync operation, to release with #report_sync_deallocate.
+ */
+report_sync_t* report_sync_titles_async(report_t* report, const report_sync_progress_handler_t& progress = nullptr);
+
+/*! Wait for a report sync to complete without polling.
+ *  Titles resolved so far are refreshed and reported to the progress handler on the calling thread.
+ *  Once all titles are resolved, the report summary gets updated and the report table sorted.
+ * 
+ * @param sync              The sync operation.
+ * @param timeout_seconds   Maximum time to wait, zero only processes titles resolved so far.
+ * 
+ * @return                  True if all titles are resolved.
+ */
+bool report_sync_wait(report_sync_t* sync, double timeout_seconds);
+
+/*! Returns the number of titles resolved so far by a report sync. */
+unsigned report_sync_resolved_count(const report_sync_t* sync);
+
+/*! Returns the number of titles a report sync has to resolve. */
+unsigned report_sync_title_count(const report_sync_t* sync);
+
+/*! Release a report sync operation, whether it completed or not.
+ * 
+ * @param sync  The sync operation, set to null once released.
+ */
+void report_sync_deallocate(report_sync_t*& sync);
+
 /*! Sort all loaded reports from their usage. */
 void report_sort_order();
 
@@ -288,6 +342,87 @@ void report_load_expression_columns(report_t* report);
  */
 void report_expression_column_reset(report_t* report);
 
+/*! Evaluate the expression columns of a report over all its titles on worker threads.
+ *  Each column expression is compiled once and evaluated for all titles in a single pass,
+ *  publishing the title values as they complete.
+ * 
+ *  @param report    The report to evaluate the expression columns for.
+ * 
+ *  @return          True once the values of all columns are computed for all titles.
+ */
+bool report_expression_columns_update(report_t* report);
+
+/*! Returns the value computed by an expression column for a title.
+ * 
+ *  @param report        The report owning the expression column.
+ *  @param column_index  Index of the expression column.
+ *  @param title         The title to get the value for.
+ * 
+ *  @return              The column value or null if it is not computed yet.
+ */
+expr_result_t report_expression_column_value(report_t* report, unsigned column_index, const title_t* title);
+
+/*! Stop evaluating the expression columns of a report and release their compiled expressions.
+ *
+ *  @remark Passes still running are cancelled and their compiled expressions released on a later frame.
+ *          Titles they could be reading are retired with the epoch, so they remain valid until the passes end.
+ * 
+ *  @param report    The report to release the expression columns for.
+ */
+void report_expression_columns_release(report_t* report);
+
+/*! Returns the index of a report field that can be evaluated directly with #report_field_evaluate.
+ * 
+ *  @param field_name         Name of the field, i.e. "price" or "gain".
+ *  @param field_name_length  Length of the field name.
+ *  @param stock_only         Only look for fields read from the title stock, like S() does.
+ * 
+ *  @return                   The field index or -1 if the field is unknown.
+ */
+int report_field_find(const char* field_name, size_t field_name_length, bool stock_only);
+
+/*! Evaluate a report field for a title, resolving the stock data it needs first.
+ * 
+ *  @param field_index  Index returned by #report_field_find.
+ *  @param title        The title to evaluate the field for.
+ *  @param filter_out   Return null for values that are filtered out of field sets, like S() does.
+ * 
+ *  @return             The field value.
+ */
+expr_result_t report_field_evaluate(int field_index, title_t* title, bool filter_out);
+
+/*! Returns the stock data levels a report field reads.
+ * 
+ *  @param field_index  Index returned by #report_field_find.
+ * 
+ *  @return             The fetch levels, or FetchLevel::NONE if the field does not read resolved stock data.
+ */
+FetchLevel report_field_fetch_level(int field_index);
+
+/*! Start evaluating expressions in a background pass on the calling thread.
+ * 
+ *  Until #report_expression_pass_end is called, report functions request the stock data they are missing 
+ *  instead of waiting for it, so the value can be evaluated again by a later pass.
+ */
+void report_expression_pass_begin();
+
+/*! Stop evaluating expressions in a background pass on the calling thread.
+ * 
+ *  @return True if all the stock data read since #report_expression_pass_begin was resolved.
+ */
+bool report_expression_pass_end();
+
+/*! Checks if a compiled expression can be evaluated by a worker thread.
+ * 
+ *  @remark Functions showing windows (i.e. TABLE and PLOT), fetching arbitrary data (FETCH) or 
+ *          reading other reports (R) must be evaluated on the main thread.
+ * 
+ *  @param e    The compiled expression.
+ * 
+ *  @return     True if the expression only calls functions that can be evaluated by worker threads.
+ */
+bool report_expression_thread_safe(const expr_t* e);
+
 /*! Save the expression columns of a report. 
  *
  *  @param report    The report to save the expression columns for.
@@ -308,6 +443,18 @@ report_handle_t report_get_handle(const report_t* report_ptr);
  */
 void report_table_rebuild(report_t* report);
 
+/*! Export the active titles of a report as they appear in the report table to a CSV file.
+ * 
+ *  @remark The report table gets created if the report was never rendered.
+ * 
+ *  @param report       The report to export.
+ *  @param path         The path of the CSV file.
+ *  @param path_length  The length of the path.
+ * 
+ *  @return True if the report was exported.
+ */
+bool report_export_csv(report_t* report, const char* path, size_t path_length);
+
 /*! Delete a report.
  * 
  * @param report    The report to delete.
@@ -15,6 +15,10 @@
 #include <framework/database.h>
 #include <framework/array.h>
 #include <framework/console.h>
+#include <framework/jobs.h>
+#include <framework/epoch.h>
+
+#include <foundation/thread.h>
 
 struct report_expression_column_t
 {
@@ -41,8 +45,64 @@ FOUNDATION_FORCEINLINE hash_t hash(const report_expression_cache_value_t& value)
     return value.key;
 }
 
-static tick_t _report_expression_last_eval_ts = 0;
+/*! Time during which an expression column value is used before being evaluated again. */
+constexpr double REPORT_EXPRESSION_CACHE_DURATION = 5 * 60.0;
+
+/*! Delay before evaluating a column again for titles that could not be evaluated by the previous pass. */
+constexpr double REPORT_EXPRESSION_PASS_RETRY_DELAY = 1.0;
+
+/*! Time spent evaluating a column that can only be evaluated on the main thread before resuming on a later frame. */
+constexpr double REPORT_EXPRESSION_MAIN_THREAD_BUDGET = 0.004;
+
+/*! Minimum time between the steps of a pass evaluated on the main thread, so it only takes a part of each frame. */
+constexpr double REPORT_EXPRESSION_MAIN_THREAD_INTERVAL = 0.016;
+
+/*! Expression column compiled once and evaluated for all the titles of a report in a single pass.
+ *  
+ *  Programs are only created, scheduled and released on the main thread, 
+ *  while the pass job is the only one evaluating the compiled expression.
+ *  Programs released while their pass job runs are cancelled and deallocated on a later frame.
+ */
+struct report_expression_program_t
+{
+    hash_t          key{ 0 };       // Report, column name and expression
+    report_handle_t report{};
+    column_format_t format{ COLUMN_FORMAT_TEXT };
+    string_t        name{};
+    string_t        source{};
+    hash_t          report_hash{ 0 };
+    hash_t          expression_hash{ 0 };
+
+    expr_t*         expr{ nullptr };
+    expr_var_list_t vars{};
+    expr_var_t*     title_var{ nullptr };
+    expr_var_t*     report_var{ nullptr };
+    expr_var_t*     column_var{ nullptr };
+    expr_var_t*     format_var{ nullptr };
+    unsigned        field_count{ 0 };  // Number of field calls resolved to direct getters
+
+    bool            main_thread{ false }; // Calls functions that only the main thread can call
+    atomic32_t      running{};            // Set while a pass job evaluates the program
+    bool            pass_pending{ false };// Set while a main thread pass continues over the next frames
+    tick_t          pass_paused{ 0 };     // Set when a main thread pass stops until a later frame
+    title_t**       titles{ nullptr };    // Titles evaluated by the current pass
+    unsigned        next_title{ 0 };      // Index of the next title evaluated by the current pass
+    title_t*        title{ nullptr };     // Title being evaluated
+    atomic32_t      cancel{};
+    tick_t          pass_ended{ 0 };      // Set by the pass when it ends
+};
+
+/*! Context of a field call resolved to a direct getter. */
+struct report_expression_field_t
+{
+    report_expression_program_t* program;
+    int                          field_index;
+    bool                         filter_out;
+};
+
 static database<report_expression_cache_value_t>* _report_expression_cache;
+static report_expression_program_t** _report_expression_programs = nullptr;
+static report_expression_program_t** _report_expression_retired_programs = nullptr;
 
 FOUNDATION_STATIC table_cell_t report_column_cache_value_to_cell(const report_expression_cache_value_t& cvalue, const report_expression_column_t* ec)
 {
@@ -65,6 +125,361 @@ FOUNDATION_STATIC table_cell_t report_column_cache_value_to_cell(const report_ex
     return nullptr;
 }
 
+FOUNDATION_FORCEINLINE hash_t report_expression_cache_key(hash_t report_hash, const title_t* title, hash_t expression_hash)
+{
+    return hash_combine(report_hash, string_hash(title->code, title->code_length), expression_hash);
+}
+
+FOUNDATION_STATIC expr_result_t report_expression_field_evaluate(const expr_func_t* f, vec_expr_t* args, void* context)
+{
+    const report_expression_field_t* field = (const report_expression_field_t*)context;
+    return report_field_evaluate(field->field_index, field->program->title, field->filter_out);
+}
+
+static expr_func_t _report_expression_field_func{ CTEXT("FIELD"), report_expression_field_evaluate, nullptr, 0 };
+
+FOUNDATION_STATIC bool report_expression_field_name(const report_expression_program_t* program, expr_t* e, string_const_t& field_name)
+{
+    if (e->type != OP_CONST && e->type != OP_VAR)
+        return false;
+
+    // Macro variables change for each title.
+    if (e->type == OP_VAR && e->token.length > 0 && e->token.str[0] == '$')
+        return false;
+
+    field_name = expr_eval(e).as_string();
+    return field_name.length > 0;
+}
+
+/*! Replace calls reading a field of the evaluated title, i.e. S($TITLE, price) or R($REPORT, $TITLE, gain), 
+ *  with getters reading the field directly from the title.
+ */
+FOUNDATION_STATIC void report_expression_program_bind_fields(report_expression_program_t* program, expr_t* e)
+{
+    if (e->type == OP_CONST || e->type == OP_VAR)
+        return;
+
+    for (int i = 0; i < e->args.len; ++i)
+        report_expression_program_bind_fields(program, &e->args.buf[i]);
+
+    if (e->type != OP_FUNC || e->param.func.context != nullptr || program->title_var == nullptr)
+        return;
+
+    const auto is_var = [](const expr_t* arg, const expr_var_t* var)
+    {
+        return var && arg->type == OP_VAR && arg->param.var.value == &var->value;
+    };
+
+    bool stock_only = false;
+    string_const_t field_name{};
+    string_const_t fn_name = e->param.func.f->name;
+    if (e->args.len == 2 && 
+        (string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("S")) || string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("STOCK")) || 
+         string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("EOD"))))
+    {
+        if (!is_var(&e->args.buf[0], program->title_var) || !report_expression_field_name(program, &e->args.buf[1], field_name))
+            return;
+        stock_only = true;
+    }
+    else if (e->args.len == 3 && 
+        (string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("R")) || string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("REPORT"))))
+    {
+        if (!is_var(&e->args.buf[0], program->report_var) || !is_var(&e->args.buf[1], program->title_var) ||
+            !report_expression_field_name(program, &e->args.buf[2], field_name))
+        {
+            return;
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    const int field_index = report_field_find(STRING_ARGS(field_name), stock_only);
+    if (field_index < 0)
+        return;
+
+    // The context is released with the expression.
+    report_expression_field_t* field = (report_expression_field_t*)memory_allocate(HASH_REPORT, sizeof(report_expression_field_t), 0, MEMORY_PERSISTENT);
+    field->program = program;
+    field->field_index = field_index;
+    field->filter_out = stock_only;
+    e->param.func.f = &_report_expression_field_func;
+    e->param.func.context = field;
+    program->field_count++;
+}
+
+FOUNDATION_STATIC expr_var_t* report_expression_program_find_var(report_expression_program_t* program, const char* name, size_t name_length)
+{
+    for (expr_var_t* v = program->vars.head; v; v = v->next)
+    {
+        if (string_equal(STRING_ARGS(v->name), name, name_length))
+            return v;
+    }
+
+    return nullptr;
+}
+
+FOUNDATION_STATIC report_expression_program_t* report_expression_program_compile(report_t* report, const report_expression_column_t* ec, hash_t key)
+{
+    report_expression_program_t* program = MEM_NEW(HASH_REPORT, report_expression_program_t);
+    program->key = key;
+    program->report = report->id;
+    program->format = ec->format;
+    program->name = string_clone(ec->name, string_length(ec->name));
+    program->source = string_clone(ec->expression, string_length(ec->expression));
+
+    string_const_t report_name = SYMBOL_CONST(report->name);
+    program->report_hash = string_hash(STRING_ARGS(report_name));
+    program->expression_hash = string_hash(STRING_ARGS(program->source));
+
+    program->expr = expr_compile(STRING_ARGS(program->source), &program->vars);
+    program->title_var = report_expression_program_find_var(program, STRING_CONST("$TITLE"));
+    program->report_var = report_expression_program_find_var(program, STRING_CONST("$REPORT"));
+    program->column_var = report_expression_program_find_var(program, STRING_CONST("$COLUMN"));
+    program->format_var = report_expression_program_find_var(program, STRING_CONST("$FORMAT"));
+
+    if (program->report_var)
+        program->report_var->value = expr_result_t(report_name);
+    if (program->column_var)
+        program->column_var->value = expr_result_t(string_to_const(program->name));
+    if (program->format_var)
+        program->format_var->value = expr_result_t((double)program->format);
+
+    if (program->expr)
+    {
+        report_expression_program_bind_fields(program, program->expr);
+        program->main_thread = !report_expression_thread_safe(program->expr);
+    }
+
+    log_debugf(HASH_REPORT, STRING_CONST("Compiled expression '%.*s' for report '%.*s' (%u direct fields)"),
+        STRING_FORMAT(program->source), STRING_FORMAT(report_name), program->field_count);
+    return program;
+}
+
+FOUNDATION_STATIC bool report_expression_program_is_running(const report_expression_program_t* program)
+{
+    return atomic_load32(&program->running, memory_order_acquire) != 0;
+}
+
+FOUNDATION_STATIC void report_expression_program_free(report_expression_program_t* program)
+{
+    expr_compile_release(program->expr, &program->vars);
+    array_deallocate(program->titles);
+    string_deallocate(program->name.str);
+    string_deallocate(program->source.str);
+    MEM_DELETE(program);
+}
+
+/*! Cancel the pass of a program and release it, or once its pass job ends if it is still running. */
+FOUNDATION_STATIC void report_expression_program_deallocate(report_expression_program_t*& program)
+{
+    if (program == nullptr)
+        return;
+
+    atomic_store32(&program->cancel, 1, memory_order_release);
+    if (report_expression_program_is_running(program))
+        array_push(_report_expression_retired_programs, program);
+    else
+        report_expression_program_free(program);
+    program = nullptr;
+}
+
+/*! Release the cancelled programs whose pass job ended. */
+FOUNDATION_STATIC void report_expression_programs_collect()
+{
+    for (unsigned i = 0; i < array_size(_report_expression_retired_programs);)
+    {
+        report_expression_program_t* program = _report_expression_retired_programs[i];
+        if (report_expression_program_is_running(program))
+        {
+            ++i;
+            continue;
+        }
+
+        report_expression_program_free(program);
+        array_erase_memcpy(_report_expression_retired_programs, i);
+    }
+}
+
+FOUNDATION_STATIC report_expression_program_t* report_expression_program_get(report_t* report, const report_expression_column_t* ec)
+{
+    string_const_t report_name = SYMBOL_CONST(report->name);
+    const hash_t key = hash_combine(
+        string_hash(STRING_ARGS(report_name)),
+        string_hash(ec->name, string_length(ec->name)),
+        string_hash(ec->expression, string_length(ec->expression)));
+
+    if (_report_expression_retired_programs)
+        report_expression_programs_collect();
+
+    for (unsigned i = 0, end = array_size(_report_expression_programs); i < end; ++i)
+    {
+        report_expression_program_t* program = _report_expression_programs[i];
+        if (program->key != key)
+            continue;
+
+        if (program->format == ec->format)
+            return program;
+
+        report_expression_program_deallocate(program);
+        array_erase_memcpy(_report_expression_programs, i);
+        break;
+    }
+
+    report_expression_program_t* program = report_expression_program_compile(report, ec, key);
+    array_push(_report_expression_programs, program);
+    return program;
+}
+
+FOUNDATION_STATIC void report_expression_program_publish(const report_expression_program_t* program, const title_t* title, const expr_result_t& result)
+{
+    report_expression_cache_value_t cvalue{};
+    cvalue.key = report_expression_cache_key(program->report_hash, title, program->expression_hash);
+    cvalue.format = program->format;
+    cvalue.time = time_current();
+
+    if (program->format == COLUMN_FORMAT_CURRENCY || program->format == COLUMN_FORMAT_NUMBER || program->format == COLUMN_FORMAT_PERCENTAGE)
+        cvalue.number = result.as_number();
+    else if (program->format == COLUMN_FORMAT_BOOLEAN)
+        cvalue.number = result.as_boolean() ? 1.0 : 0.0;
+    else if (program->format == COLUMN_FORMAT_DATE)
+        cvalue.date = (time_t)result.as_number();
+    else
+        cvalue.symbol = string_table_encode(result.as_string());
+
+    _report_expression_cache->put(cvalue);
+}
+
+FOUNDATION_STATIC bool report_expression_program_has_value(const report_expression_program_t* program, const title_t* title)
+{
+    report_expression_cache_value_t cvalue{};
+    const hash_t key = report_expression_cache_key(program->report_hash, title, program->expression_hash);
+    return _report_expression_cache->select(key, cvalue) && cvalue.format == program->format && time_elapsed(cvalue.time) < REPORT_EXPRESSION_CACHE_DURATION;
+}
+
+/*! Evaluate the titles of the current pass.
+ *
+ *  @param time_budget  Time after which the pass stops until called again, or 0 to evaluate all the titles.
+ *
+ *  @return True once the pass ended.
+ */
+FOUNDATION_STATIC bool report_expression_program_evaluate_titles(report_expression_program_t* program, double time_budget = 0)
+{
+    const bool uses_title = program->title_var != nullptr;
+
+    const tick_t start = time_current();
+    for (; program->next_title < array_size(program->titles); ++program->next_title)
+    {
+        if (atomic_load32(&program->cancel, memory_order_acquire))
+            break;
+
+        if (time_budget > 0 && time_elapsed(start) >= time_budget)
+            return false;
+
+        // Titles not resolved yet are evaluated by a later pass.
+        title_t* title = program->titles[program->next_title];
+        if (uses_title && !title_is_resolved(title))
+            continue;
+
+        program->title = title;
+        if (uses_title)
+            program->title_var->value = expr_result_t(string_const(title->code, title->code_length));
+
+        // Values missing stock data are not published, so a later pass evaluates them again rather than waiting.
+        report_expression_pass_begin();
+        expr_result_t result = expr_eval_compiled(program->expr, &program->vars, string_to_const(program->source));
+        if (report_expression_pass_end())
+            report_expression_program_publish(program, title, result);
+    }
+
+    program->title = nullptr;
+    program->pass_ended = time_current();
+    return true;
+}
+
+FOUNDATION_STATIC bool report_expression_program_is_waiting(const report_expression_program_t* program)
+{
+    return program->pass_ended != 0 && time_elapsed(program->pass_ended) < REPORT_EXPRESSION_PASS_RETRY_DELAY;
+}
+
+/*! Start a pass evaluating the column for the report titles without a value, unless one is running already.
+ *
+ *  @return True if the column still has titles to evaluate.
+ */
+FOUNDATION_STATIC bool report_expression_program_update(report_expression_program_t* program, report_t* report)
+{
+    if (program->expr == nullptr)
+        return false;
+
+    if (report_expression_program_is_running(program))
+        return true;
+
+    if (program->pass_pending)
+    {
+        if (time_elapsed(program->pass_paused) < REPORT_EXPRESSION_MAIN_THREAD_INTERVAL)
+            return true;
+
+        program->pass_pending = !report_expression_program_evaluate_titles(program, REPORT_EXPRESSION_MAIN_THREAD_BUDGET);
+        program->pass_paused = time_current();
+        if (program->pass_pending)
+            return true;
+    }
+
+    array_clear(program->titles);
+    foreach(pt, report->titles)
+    {
+        title_t* title = *pt;
+        if (!title_is_index(title) && !report_expression_program_has_value(program, title))
+            array_push(program->titles, title);
+    }
+
+    if (array_size(program->titles) == 0)
+        return false;
+
+    if (report_expression_program_is_waiting(program) || (program->report_var && report_is_loading(report)))
+        return true;
+
+    // Use application global variables as they are when the pass is scheduled.
+    for (expr_var_t* v = program->vars.head; v; v = v->next)
+    {
+        if (v == program->title_var || v == program->report_var || v == program->column_var || v == program->format_var)
+            continue;
+
+        const expr_result_t global_value = expr_get_global_var_value(STRING_ARGS(v->name));
+        if (!global_value.is_null() && global_value.type != EXPR_RESULT_ARRAY)
+            v->value = global_value;
+    }
+
+    log_debugf(HASH_REPORT, STRING_CONST("Evaluating expression '%.*s' for %u titles of report '%.*s'"),
+        STRING_FORMAT(program->source), array_size(program->titles), STRING_FORMAT(SYMBOL_CONST(report->name)));
+
+    program->next_title = 0;
+    if (program->main_thread)
+    {
+        // Functions that only the main thread can call get evaluated over a few frames.
+        program->pass_pending = !report_expression_program_evaluate_titles(program, REPORT_EXPRESSION_MAIN_THREAD_BUDGET);
+        program->pass_paused = time_current();
+        return true;
+    }
+
+    atomic_store32(&program->running, 1, memory_order_release);
+    job_execute([](payload_t* payload)
+    {
+        report_expression_program_t* program = (report_expression_program_t*)payload;
+        {
+            // Passes never wait, so they read the titles inside a single epoch.
+            EPOCH_SCOPE();
+            report_expression_program_evaluate_titles(program);
+        }
+
+        // Once cleared, the main thread can release a cancelled program.
+        atomic_store32(&program->running, 0, memory_order_release);
+        return 0;
+    }, (payload_t*)program, JOB_DEALLOCATE_AFTER_EXECUTION);
+    return true;
+}
+
 FOUNDATION_STATIC table_cell_t report_column_evaluate_expression(table_element_ptr_t element, const table_column_t* column, 
                                                            report_handle_t report_handle, const report_expression_column_t* ec)
 {
@@ -76,13 +491,10 @@ FOUNDATION_STATIC table_cell_t report_column_evaluate_expression(table_element_p
     string_const_t report_name = SYMBOL_CONST(report->name);
     string_const_t title_code = string_const(title->code, title->code_length);
     string_const_t expression_string = string_const(ec->expression, string_length(ec->expression));
-    hash_t key = hash_combine(
-        string_hash(STRING_ARGS(report_name)), 
-        string_hash(STRING_ARGS(title_code)), 
-        string_hash(STRING_ARGS(expression_string)));
+    hash_t key = report_expression_cache_key(string_hash(STRING_ARGS(report_name)), title, string_hash(STRING_ARGS(expression_string)));
 
     report_expression_cache_value_t cvalue{};
-    if (_report_expression_cache->select(key, cvalue) && time_elapsed(cvalue.time) < 5 * 60.0)
+    if (_report_expression_cache->select(key, cvalue) && time_elapsed(cvalue.time) < REPORT_EXPRESSION_CACHE_DURATION)
     {
         if (cvalue.format == ec->format)
         {
@@ -95,61 +507,11 @@ FOUNDATION_STATIC table_cell_t report_column_evaluate_expression(table_element_p
         }
     }
 
-    // Check if we are ready to evaluate another expression right away?
-    // We are doing this here so we do not block the UI thread for too long
-    if (time_elapsed(_report_expression_last_eval_ts) < 0.050)
-         return report_column_cache_value_to_cell(cvalue, ec);
-
-    if (string_find_string(STRING_ARGS(expression_string), STRING_CONST("$TITLE"), 0) != STRING_NPOS)
-    {
-        if (!title_is_resolved(title))
-            return report_column_cache_value_to_cell(cvalue, ec);
-    }
-
-    if (string_find_string(STRING_ARGS(expression_string), STRING_CONST("$REPORT"), 0) != STRING_NPOS)
-    {
-        if (report_is_loading(report))
-            return report_column_cache_value_to_cell(cvalue, ec);
-    }
-
-    log_debugf(HASH_REPORT, STRING_CONST("Evaluating expression '%.*s' for title '%.*s' in report '%.*s'"),
-           STRING_FORMAT(expression_string), STRING_FORMAT(title_code), STRING_FORMAT(report_name));
-
-    cvalue.key = key;
-    cvalue.format = ec->format;
-    _report_expression_last_eval_ts = cvalue.time = time_current();
-
-    string_const_t column_name = string_const(ec->name, string_length(ec->name));
-    
-    expr_set_or_create_global_var(STRING_CONST("$TITLE"), expr_result_t(title_code));
-    expr_set_or_create_global_var(STRING_CONST("$REPORT"), expr_result_t(report_name));
-    expr_set_or_create_global_var(STRING_CONST("$COLUMN"), expr_result_t(column_name));
-    expr_set_or_create_global_var(STRING_CONST("$FORMAT"), expr_result_t((double)ec->format));
-    auto result = eval(STRING_ARGS(expression_string));
-
-    if (ec->format == COLUMN_FORMAT_CURRENCY || ec->format == COLUMN_FORMAT_NUMBER || ec->format == COLUMN_FORMAT_PERCENTAGE)
-    { 
-        cvalue.number = result.as_number();
-        _report_expression_cache->put(cvalue);
-        return cvalue.number;
-    }
-    if (ec->format == COLUMN_FORMAT_BOOLEAN)
-    {
-        cvalue.number = result.as_boolean() ? 1.0 : 0.0;
-        _report_expression_cache->put(cvalue);
-        return cvalue.number;
-    }
-    if (ec->format == COLUMN_FORMAT_DATE)
-    {
-        cvalue.date = (time_t)result.as_number();
-        _report_expression_cache->put(cvalue);
-        return cvalue.date;
-    }
-    
-    string_const_t str_value = result.as_string();
-    cvalue.symbol = string_table_encode(str_value);
-    _report_expression_cache->put(cvalue);
-    return str_value;
+    // Evaluate the whole column in the background and show the previous value meanwhile.
+    report_expression_program_t* program = report_expression_program_get(report, ec);
+    if (!report_expression_program_is_running(program) && (program->pass_pending || !report_expression_program_is_waiting(program)))
+        report_expression_program_update(program, report);
+    return report_column_cache_value_to_cell(cvalue, ec);
 }
 
 FOUNDATION_STATIC const char* report_expression_column_format_name(column_format_t format)
@@ -373,11 +735,20 @@ void report_expression_columns_initialize()
 
 void report_expression_columns_finalize()
 {
+    foreach(p, _report_expression_programs)
+        report_expression_program_deallocate(*p);
+    array_deallocate(_report_expression_programs);
+
+    // Jobs are shut down before modules, so programs whose pass job never ran can be released too.
+    foreach(rp, _report_expression_retired_programs)
+        report_expression_program_free(*rp);
+    array_deallocate(_report_expression_retired_programs);
     MEM_DELETE(_report_expression_cache);
 }
 
 void report_expression_column_reset(report_t* report)
 {
+    report_expression_columns_release(report);
     for (auto e = _report_expression_cache->begin_exclusive_lock(); e != _report_expression_cache->end_exclusive_lock(); ++e)
     {
         e->time = 0;
@@ -385,6 +756,56 @@ void report_expression_column_reset(report_t* report)
     //_report_expression_cache->clear();
 }
 
+void report_expression_columns_release(report_t* report)
+{
+    for (unsigned i = 0; i < array_size(_report_expression_programs);)
+    {
+        report_expression_program_t* program = _report_expression_programs[i];
+        if (!uuid_equal(program->report, report->id))
+        {
+            ++i;
+            continue;
+        }
+
+        report_expression_program_deallocate(program);
+        array_erase_memcpy(_report_expression_programs, i);
+    }
+}
+
+bool report_expression_columns_update(report_t* report)
+{
+    report_expression_programs_collect();
+
+    bool completed = true;
+    foreach(c, report->expression_columns)
+    {
+        report_expression_program_t* program = report_expression_program_get(report, c);
+        if (report_expression_program_update(program, report))
+            completed = false;
+    }
+
+    return completed;
+}
+
+expr_result_t report_expression_column_value(report_t* report, unsigned column_index, const title_t* title)
+{
+    FOUNDATION_ASSERT(column_index < array_size(report->expression_columns));
+    const report_expression_column_t* ec = &report->expression_columns[column_index];
+
+    string_const_t report_name = SYMBOL_CONST(report->name);
+    const hash_t key = report_expression_cache_key(string_hash(STRING_ARGS(report_name)), title, string_hash(ec->expression, string_length(ec->expression)));
+
+    report_expression_cache_value_t cvalue{};
+    if (!_report_expression_cache->select(key, cvalue) || cvalue.format != ec->format || time_elapsed(cvalue.time) >= REPORT_EXPRESSION_CACHE_DURATION)
+        return NIL;
+
+    if (ec->format == COLUMN_FORMAT_DATE)
+        return expr_result_t((double)cvalue.date);
+    if (ec->format == COLUMN_FORMAT_TEXT)
+        return expr_result_t(SYMBOL_CONST(cvalue.symbol));
+    return expr_result_t(cvalue.number);
+}
+
 void report_expression_columns_save(report_t* report)
 {
     auto cv_columns = config_set_array(report->data, STRING_CONST("columns"));
@@ -12,6 +12,7 @@
 #include <framework/module.h>
 #include <framework/dispatcher.h>
 #include <framework/array.h>
+#include <framework/epoch.h>
 
 #define HASH_REPORT_EXPRESSION static_hash_string("report_expr", 11, 0x44456b54e62624e0ULL)
 
@@ -20,6 +21,17 @@
 
 constexpr uint32_t STOCK_ONLY_PROPERTY_EVALUATOR_START_INDEX = 28;
 
+/*! Functions that show windows, fetch arbitrary data or read other reports, which only the main thread can do. */
+constexpr string_const_t REPORT_EXPRESSION_MAIN_THREAD_FUNCTIONS[] = {
+    CTEXT("TABLE"), CTEXT("PLOT"), CTEXT("FETCH"), CTEXT("R"), CTEXT("REPORT")
+};
+
+/*! Set while the calling thread evaluates a background pass, which must not wait for stock data. */
+static thread_local bool _report_expression_pass = false;
+
+/*! Set when a background pass evaluated a value that was missing stock data. */
+static thread_local bool _report_expression_pass_unresolved = false;
+
 FOUNDATION_FORCEINLINE expr_result_t stock_change_p_range(const stock_t* s, int rel_days)
 {
     string_const_t code = SYMBOL_CONST(s->code);
@@ -194,6 +206,15 @@ FOUNDATION_STATIC bool report_eval_report_field_resolve_level(stock_handle_t& st
     {
         if (stock_resolve(stock_handle, request_level) >= 0)
         {
+            // Background passes evaluate the value again once the data is resolved.
+            if (_report_expression_pass)
+            {
+                _report_expression_pass_unresolved = true;
+                return false;
+            }
+
+            if (any(request_level, FetchLevel::REALTIME))
+                stock_flush_real_time_requests();
             const tick_t timeout = time_current();
             while (!s->has_resolve(request_level) && time_elapsed(timeout) < timeout_expired)
                 dispatcher_wait_for_wakeup_main_thread();
@@ -346,6 +367,7 @@ FOUNDATION_STATIC expr_result_t report_expr_eval_stock(const expr_func_t* f, vec
                 array_push(results, expr_eval_pair((double)s->current.date, se.handler(s, &s->current)));
                 
                 // Find the closest date in the stock history
+                EPOCH_SCOPE();
                 const day_result_t* history = s->history;
                 foreach(d, history)
                 {
@@ -389,6 +411,7 @@ FOUNDATION_STATIC expr_result_t report_expr_eval_stock(const expr_func_t* f, vec
                     return se.handler(s, &s->current);
 
                 // Find the closest date in the stock history
+                EPOCH_SCOPE();
                 const day_result_t* history = s->history;
                 foreach(d, history)
                 {
@@ -554,6 +577,7 @@ FOUNDATION_STATIC expr_result_t report_eval_report_field(const expr_func_t* f, v
     // If we only have the report name as argument, return the report title symbols
     if (args->len == 1)
     {
+        EPOCH_SCOPE();
         expr_result_t* titles = nullptr;
         for (unsigned i = 0, end = array_size(report->titles); i < end; ++i)
         {
@@ -584,13 +608,11 @@ FOUNDATION_STATIC expr_result_t report_eval_report_field(const expr_func_t* f, v
         field_name_index = 2;
     }
 
-    tick_t s = time_current();
-    while (title_filter.length == 0 && !report_sync_titles(report))
-    {
-        if (time_elapsed(s) > 30.0f)
-            throw ExprError(EXPR_ERROR_EVALUATION_TIMEOUT, "Sync timeout, retry later...", STRING_FORMAT(report_name));
-        dispatcher_wait_for_wakeup_main_thread(100);
-    }
+    if (title_filter.length == 0 && !report_sync_titles(report, 30.0))
+        throw ExprError(EXPR_ERROR_EVALUATION_TIMEOUT, "Sync timeout, retry later...", STRING_FORMAT(report_name));
+
+    // Titles removed from the report meanwhile are released once this evaluation leaves its epoch.
+    EPOCH_SCOPE();
 
     expr_result_t* results = nullptr;
     expr_t* field_expr = args->get(field_name_index);
@@ -783,6 +805,85 @@ FOUNDATION_STATIC expr_result_t report_eval_list_fields(const expr_func_t* f, ve
     return expr_eval_list(field_names);
 }
 
+//
+// # PUBLIC API
+//
+
+int report_field_find(const char* field_name, size_t field_name_length, bool stock_only)
+{
+    const int start = stock_only ? STOCK_ONLY_PROPERTY_EVALUATOR_START_INDEX : 0;
+    for (int i = start; i < ARRAY_COUNT(report_field_property_evalutors); ++i)
+    {
+        const auto& pe = report_field_property_evalutors[i];
+        if (string_equal_nocase(STRING_LENGTH(pe.property_name), field_name, field_name_length))
+            return i;
+    }
+
+    return -1;
+}
+
+expr_result_t report_field_evaluate(int field_index, title_t* title, bool filter_out)
+{
+    FOUNDATION_ASSERT(field_index >= 0 && field_index < ARRAY_COUNT(report_field_property_evalutors));
+
+    const auto& pe = report_field_property_evalutors[field_index];
+    if (pe.required_level != FetchLevel::NONE)
+        report_eval_report_field_resolve_level(title, pe.required_level);
+
+    const stock_t* s = title->stock;
+    if (s == nullptr)
+        return NIL;
+
+    expr_result_t value = pe.handler(title, s);
+    if (filter_out && pe.filter_out && pe.filter_out(value))
+        return NIL;
+    return value;
+}
+
+void report_expression_pass_begin()
+{
+    FOUNDATION_ASSERT(!_report_expression_pass);
+    _report_expression_pass = true;
+    _report_expression_pass_unresolved = false;
+}
+
+bool report_expression_pass_end()
+{
+    FOUNDATION_ASSERT(_report_expression_pass);
+    _report_expression_pass = false;
+    return !_report_expression_pass_unresolved;
+}
+
+bool report_expression_thread_safe(const expr_t* e)
+{
+    if (e == nullptr)
+        return true;
+
+    if (e->type == OP_FUNC && e->param.func.f)
+    {
+        string_const_t fn_name = e->param.func.f->name;
+        for (const auto& name : REPORT_EXPRESSION_MAIN_THREAD_FUNCTIONS)
+        {
+            if (string_equal_nocase(STRING_ARGS(fn_name), STRING_ARGS(name)))
+                return false;
+        }
+    }
+
+    for (int i = 0; i < e->args.len; ++i)
+    {
+        if (!report_expression_thread_safe(&e->args.buf[i]))
+            return false;
+    }
+
+    return true;
+}
+
+FetchLevel report_field_fetch_level(int field_index)
+{
+    FOUNDATION_ASSERT(field_index >= 0 && field_index < ARRAY_COUNT(report_field_property_evalutors));
+    return report_field_property_evalutors[field_index].required_level;
+}
+
 //
 // # SYSTEM
 //
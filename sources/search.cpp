@@ -29,14 +29,29 @@
 #include <framework/array.h>
 #include <framework/system.h>
 #include <framework/shared_mutex.h>
+#include <framework/epoch.h>
 
 #include <foundation/stream.h>
 #include <foundation/thread.h>
+#include <foundation/atomic.h>
 
 #define HASH_SEARCH static_hash_string("search", 6, 0xc9d4e54fbae76425ULL)
 
 constexpr const char* SEARCH_EXCHANGES_SESSION_KEY = "search_exchanges";
 
+/*! Number of symbols fetched and indexed by an indexing thread before being merged. */
+constexpr unsigned SEARCH_INDEXER_BATCH_SIZE = 32;
+
+/*! Maximum number of indexing threads running at the same time. 
+ *  Indexing makes blocking requests, so it runs on its own threads rather than on the shared job pool. */
+constexpr unsigned SEARCH_INDEXER_MAX_THREADS = 4;
+
+/*! Maximum number of threads fetching the symbols of the stock exchanges at the same time. */
+constexpr unsigned SEARCH_EXCHANGE_FETCH_MAX_THREADS = 4;
+
+/*! Maximum number of documents completed from the local index for a simple search text. */
+constexpr unsigned SEARCH_COMPLETION_MAX_RESULTS = 20;
+
 constexpr string_const_t COMMON_STOCK_WORDS[] = {
     CTEXT("the"), CTEXT("and"), CTEXT("inc"), CTEXT("this"), CTEXT("that"), CTEXT("not"), CTEXT("are"),
     CTEXT("was"), CTEXT("were"), CTEXT("been"), CTEXT("have"), CTEXT("has"), CTEXT("had"), CTEXT("does"),
@@ -113,6 +128,13 @@ constexpr string_const_t SEARCH_SKIP_FIELDS_FOR_INDEXING[] = {
 };
 
 struct search_window_t;
+struct search_indexer_t;
+
+/*! Fetch the fundamental data of a symbol and invoke #index_fn with it.
+ *
+ *  @return False if the data could not be fetched.
+ */
+typedef function<bool(string_const_t symbol, const function<void(const json_object_t& json)>& index_fn)> search_indexer_fetch_t;
 
 typedef enum class SearchResultSourceType {
 
@@ -162,6 +184,7 @@ static struct SEARCH_MODULE {
     search_database_t*          db{ nullptr };
     char                        query[1024] = { 0 };
     dispatcher_thread_handle_t  indexing_thread{};
+    search_indexer_t*           indexer{ nullptr };
     string_t*                   saved_queries{ nullptr };
     event_handle_t              startup_signal{};
 
@@ -295,10 +318,8 @@ FOUNDATION_STATIC bool search_database_index_property_skip_common_words(
     return true;
 }
 
-FOUNDATION_STATIC void search_index_news_data(const json_object_t& json, search_document_handle_t doc)
+FOUNDATION_STATIC void search_index_news_data(search_database_t* db, const json_object_t& json, search_document_handle_t doc)
 {
-    search_database_t* db = _search->db;
-
     for (auto n : json)
     {
         time_t date;
@@ -393,39 +414,41 @@ FOUNDATION_STATIC unsigned int search_json_token_next_index(const json_token_t&
     return index;
 }
 
-FOUNDATION_STATIC void search_index_fundamental_data(const json_object_t& json, string_const_t symbol)
+FOUNDATION_STATIC search_document_handle_t search_index_ignore_symbol(string_const_t symbol)
 {
-    MEMORY_TRACKER(HASH_SEARCH);
+    stock_ignore_symbol(STRING_ARGS(symbol));
+    return SEARCH_DOCUMENT_INVALID_ID;
+}
 
-    search_database_t* db = _search->db;
+/*! Index the fundamental data of a symbol.
+ *
+ *  @return The indexed document or #SEARCH_DOCUMENT_INVALID_ID if the symbol is skipped.
+ */
+FOUNDATION_EXTERN search_document_handle_t search_index_fundamental_document(search_database_t* db, const json_object_t& json, string_const_t symbol)
+{
+    MEMORY_TRACKER(HASH_SEARCH);
 
     const auto General = json["General"];
     if (General.root == nullptr || General.root->child == 0)
-        return;
+        return SEARCH_DOCUMENT_INVALID_ID;
 
     string_const_t code = General["Code"].as_string();
     if (string_is_null(code))
-        return (void)stock_ignore_symbol(STRING_ARGS(symbol));
+        return search_index_ignore_symbol(symbol);
 
     const auto Technicals = json["Technicals"];
     if (Technicals.root == nullptr || Technicals.root->child == 0)
-    {
-        return (void)stock_ignore_symbol(STRING_ARGS(symbol));
-        return;
-    }
+        return search_index_ignore_symbol(symbol);
 
     const auto Valuation = json["Valuation"];
     if (Valuation.root == nullptr || Valuation.root->child == 0)
-    {
-        return (void)stock_ignore_symbol(STRING_ARGS(symbol));
-        return;
-    }
+        return search_index_ignore_symbol(symbol);
         
     const bool is_delisted = General["IsDelisted"].as_boolean();
     if (is_delisted || json.token_count <= 1)
     {
         log_debugf(HASH_SEARCH, STRING_CONST("%.*s is delisted, skipping for indexing"), STRING_FORMAT(code));
-        return;
+        return SEARCH_DOCUMENT_INVALID_ID;
     }
 
     time_t updated_at = 0;
@@ -436,13 +459,13 @@ FOUNDATION_STATIC void search_index_fundamental_data(const json_object_t& json,
         if (updated_elapsed_time > 180)
         {
             log_debugf(HASH_SEARCH, STRING_CONST("%.*s is too old (%lf days), skipping for indexing"), STRING_FORMAT(symbol), updated_elapsed_time);
-            return (void)stock_ignore_symbol(STRING_ARGS(symbol));
+            return search_index_ignore_symbol(symbol);
         }
     }
     
     string_const_t exchange = General["Exchange"].as_string();
     if (string_is_null(exchange))
-        return;
+        return SEARCH_DOCUMENT_INVALID_ID;
 
     // Do not index FUND stock and those with no ISIN
     string_const_t isin = General["ISIN"].as_string();
@@ -451,16 +474,16 @@ FOUNDATION_STATIC void search_index_fundamental_data(const json_object_t& json,
 
     string_const_t type = General["Type"].as_string();
     if (string_equal_nocase(STRING_ARGS(type), STRING_CONST("FUND")))
-        return;
+        return SEARCH_DOCUMENT_INVALID_ID;
 
     string_const_t description = General["Description"].as_string();
     if (string_is_null(description) || description.length < 32)
-        return (void)stock_ignore_symbol(STRING_ARGS(symbol));
+        return search_index_ignore_symbol(symbol);
 
     // Ignore symbols with negative Beta
     const double beta = Technicals["Beta"].as_number();
     if (beta < 0)
-        return (void)stock_ignore_symbol(STRING_ARGS(symbol));
+        return search_index_ignore_symbol(symbol);
 
     string_const_t name = General["Name"].as_string();
     string_const_t country = General["Country"].as_string();
@@ -474,14 +497,8 @@ FOUNDATION_STATIC void search_index_fundamental_data(const json_object_t& json,
     string_const_t category = General["Category"].as_string();
     string_const_t home_category = General["HomeCategory"].as_string();
         
-    bool new_document_added = false;
-    search_document_handle_t doc = search_database_find_document(db, STRING_ARGS(symbol));
-    if (doc == SEARCH_DOCUMENT_INVALID_ID)
-    {
-        new_document_added = true;
-        FOUNDATION_ASSERT(symbol.length);
-        doc = search_database_add_document(db, STRING_ARGS(symbol));
-    }
+    FOUNDATION_ASSERT(symbol.length);
+    search_document_handle_t doc = search_database_get_or_add_document(db, STRING_ARGS(symbol));
 
     TIME_TRACKER(2.0, HASH_SEARCH, "[%u] Indexing [%12.*s] %-7.*s -> %.*s -> %.*s",
         doc, STRING_FORMAT(isin), STRING_FORMAT(symbol), STRING_FORMAT(type), STRING_FORMAT(name));
@@ -489,6 +506,12 @@ FOUNDATION_STATIC void search_index_fundamental_data(const json_object_t& json,
     // Index symbol
     search_database_index_word(db, doc, STRING_ARGS(symbol), true);
 
+    // Index labels completed as the user types in the search window
+    search_database_index_label(db, doc, STRING_ARGS(symbol));
+    search_database_index_label(db, doc, STRING_ARGS(code));
+    search_database_index_label(db, doc, STRING_ARGS(name));
+    search_database_index_label(db, doc, STRING_ARGS(isin));
+
     // Index basic information
     search_database_index_text_skip_common_words(db, doc, STRING_ARGS(name), true);
     search_database_index_exact_match(db, doc, STRING_ARGS(isin), false);
@@ -615,15 +638,23 @@ FOUNDATION_STATIC void search_index_fundamental_data(const json_object_t& json,
                 search_database_index_property_skip_common_words(db, doc, STRING_ARGS(id), STRING_ARGS(value), false);
         }
     }
-    
+
+    return doc;
+}
+
+/*! Index the news and the EOD data of an indexed symbol, which requires additional requests. */
+FOUNDATION_STATIC void search_index_fundamental_extras(search_database_t* db, search_document_handle_t doc, string_const_t symbol, bool new_document)
+{
+    MEMORY_TRACKER(HASH_SEARCH);
+
     // Index some news data
-    if (!eod_fetch("news", nullptr, FORMAT_JSON_CACHE, "s", symbol.str, "limit", "10", LC1(search_index_news_data(_1, doc)), 8 * 24 * 60 * 60ULL))
+    if (!eod_fetch("news", nullptr, FORMAT_JSON_CACHE, "s", symbol.str, "limit", "10", LC1(search_index_news_data(db, _1, doc)), 8 * 24 * 60 * 60ULL))
     {
         log_warnf(HASH_SEARCH, WARNING_RESOURCE, STRING_CONST("Failed to fetch news for symbol %*.s"), STRING_FORMAT(symbol));
     }
 
     // Index EOD stock data
-    if (new_document_added)
+    if (new_document)
     {
         time_t start = 0;
         if (stock_get_time_range(STRING_ARGS(symbol), &start, nullptr, 5.0))
@@ -639,46 +670,274 @@ FOUNDATION_STATIC void search_index_fundamental_data(const json_object_t& json,
     }
 }
 
-FOUNDATION_STATIC void search_index_exchange_symbols(const json_object_t& data, const char* market, size_t market_length, bool* stop_indexing)
+//
+// # INDEXER
+//
+
+/*! Symbol waiting to be fetched and indexed. */
+struct search_indexer_symbol_t
+{
+    string_t symbol{};
+    bool     new_document{ false };
+};
+
+/*! Batch of symbols indexed by a thread into its own partial database. */
+struct search_indexer_batch_t
+{
+    search_indexer_t*        indexer{ nullptr };
+    search_indexer_symbol_t* symbols{ nullptr };
+    search_database_t*       db{ nullptr };
+    thread_t*                thread{ nullptr };
+    atomic32_t               completed{ 0 };
+};
+
+/*! Search indexing pipeline.
+ *
+ *  Exchange symbol lists are queued by one thread per exchange. Indexing threads fetch and index
+ *  batches of queued symbols in partial databases, which the indexing thread merges in bulk
+ *  into the main database. This way indexing threads never contend on the main database lock.
+ *
+ *  Fetching symbols can block for a long time, so none of this runs on the shared job pool.
+ */
+struct search_indexer_t
+{
+    search_database_t*        db{ nullptr };
+    search_database_flags_t   flags{ SearchDatabaseFlags::None };
+    search_indexer_fetch_t    fetch{};
+    bool                      index_extras{ true };
+    atomic32_t                stop{ 0 };
+
+    shared_mutex              queue_lock{};
+    search_indexer_symbol_t*  queue{ nullptr };
+    unsigned                  queue_offset{ 0 };
+
+    search_indexer_batch_t**  batches{ nullptr };
+
+    tick_t                    started{ 0 };
+    atomic32_t                queued{ 0 };
+    atomic32_t                fetched{ 0 };
+    atomic32_t                failed{ 0 };
+    atomic32_t                skipped{ 0 };
+    atomic32_t                indexed{ 0 };
+    atomic32_t                merged{ 0 };
+};
+
+FOUNDATION_STATIC void* search_indexer_batch_thread_fn(void* data)
 {
     MEMORY_TRACKER(HASH_SEARCH);
 
-    search_database_t* db = _search->db;
+    search_indexer_batch_t* batch = (search_indexer_batch_t*)data;
+    search_indexer_t* indexer = batch->indexer;
 
-    // Wait to connect to EOD services
-    const tick_t timeout = time_current();
-    while (!eod_availalble() && time_elapsed(timeout) < 30.0)
+    foreach(e, batch->symbols)
     {
-        if (thread_try_wait(100))
-        {
-            *stop_indexing = true;
-            return;
-        }
-    }
+        if (atomic_load32(&indexer->stop, memory_order_relaxed))
+            break;
 
-    for(auto e : data)
-    {   
-        if (thread_try_wait(50))
+        // Only stay in an epoch for each symbol, so stocks retired while indexing get reclaimed.
+        EPOCH_SCOPE();
+
+        string_const_t symbol = string_to_const(e->symbol);
+        search_document_handle_t doc = SEARCH_DOCUMENT_INVALID_ID;
+
+        // The JSON data is only valid in the fetch callback, so it gets indexed right away.
+        if (!indexer->fetch(symbol, [batch, symbol, &doc](const json_object_t& json)
         {
-            *stop_indexing = true;
-            break;
+            doc = search_index_fundamental_document(batch->db, json, symbol);
+        }))
+        {
+            atomic_incr32(&indexer->failed, memory_order_relaxed);
+            log_warnf(HASH_SEARCH, WARNING_RESOURCE, STRING_CONST("Failed to fetch %.*s fundamental"), STRING_FORMAT(symbol));
+            continue;
         }
 
-        if (!eod_availalble())
+        atomic_incr32(&indexer->fetched, memory_order_relaxed);
+        if (doc == SEARCH_DOCUMENT_INVALID_ID)
         {
-            *stop_indexing = true;
-            log_warnf(HASH_SEARCH, WARNING_NETWORK, STRING_CONST("Failed to connect to EOD services, terminating indexing"));
-            return;
+            atomic_incr32(&indexer->skipped, memory_order_relaxed);
+            continue;
         }
 
-        if (eod_capacity() > 0.8)
+        if (indexer->index_extras)
+            search_index_fundamental_extras(batch->db, doc, symbol, e->new_document);
+        atomic_incr32(&indexer->indexed, memory_order_relaxed);
+    }
+
+    atomic_store32(&batch->completed, 1, memory_order_release);
+    return 0;
+}
+
+FOUNDATION_STATIC search_indexer_batch_t* search_indexer_next_batch(search_indexer_t* indexer)
+{
+    SHARED_WRITE_LOCK(indexer->queue_lock);
+
+    const unsigned queue_size = array_size(indexer->queue);
+    if (indexer->queue_offset >= queue_size)
+        return nullptr;
+
+    search_indexer_batch_t* batch = MEM_NEW(HASH_SEARCH, search_indexer_batch_t);
+    batch->indexer = indexer;
+    batch->db = search_database_allocate(indexer->flags);
+
+    const unsigned batch_end = min(indexer->queue_offset + SEARCH_INDEXER_BATCH_SIZE, queue_size);
+    array_reserve(batch->symbols, batch_end - indexer->queue_offset);
+    for (; indexer->queue_offset < batch_end; ++indexer->queue_offset)
+        array_push_memcpy(batch->symbols, &indexer->queue[indexer->queue_offset]);
+
+    // The batch now owns the symbol strings
+    if (indexer->queue_offset == queue_size)
+    {
+        array_clear(indexer->queue);
+        indexer->queue_offset = 0;
+    }
+
+    return batch;
+}
+
+FOUNDATION_STATIC void search_indexer_merge_batch(search_indexer_t* indexer, search_indexer_batch_t*& batch)
+{
+    thread_join(batch->thread);
+    thread_deallocate(batch->thread);
+
+    if (search_database_document_count(batch->db) > 0)
+    {
+        const uint32_t merge_count = search_database_merge(indexer->db, batch->db);
+        atomic_add32(&indexer->merged, (int32_t)merge_count, memory_order_relaxed);
+    }
+
+    search_database_deallocate(batch->db);
+    foreach(e, batch->symbols)
+        string_deallocate(e->symbol.str);
+    array_deallocate(batch->symbols);
+    MEM_DELETE(batch);
+}
+
+/*! Create an indexing pipeline that indexes queued symbols into #db.
+ *
+ *  @param db            Database receiving the indexed documents
+ *  @param flags         Flags of #db, used to create the partial databases
+ *  @param fetch         Function fetching the fundamental data of a symbol
+ *  @param index_extras  Index the news and EOD data of the symbols, which requires additional requests
+ */
+FOUNDATION_EXTERN search_indexer_t* search_indexer_allocate(search_database_t* db, search_database_flags_t flags, const search_indexer_fetch_t& fetch, bool index_extras)
+{
+    search_indexer_t* indexer = MEM_NEW(HASH_SEARCH, search_indexer_t);
+    indexer->db = db;
+    indexer->flags = flags;
+    indexer->fetch = fetch;
+    indexer->index_extras = index_extras;
+    indexer->started = time_current();
+    return indexer;
+}
+
+/*! Queue a symbol to be indexed. Can be called from any thread. */
+FOUNDATION_EXTERN void search_indexer_queue(search_indexer_t* indexer, const char* symbol, size_t symbol_length, bool new_document)
+{
+    search_indexer_symbol_t e;
+    e.symbol = string_clone(symbol, symbol_length);
+    e.new_document = new_document;
+
+    SHARED_WRITE_LOCK(indexer->queue_lock);
+    array_push_memcpy(indexer->queue, &e);
+    atomic_incr32(&indexer->queued, memory_order_relaxed);
+}
+
+/*! Merge the completed batches and schedule new ones. Must always be called from the same thread.
+ *
+ *  @return True while symbols are waiting to be indexed or merged.
+ */
+FOUNDATION_EXTERN bool search_indexer_update(search_indexer_t* indexer)
+{
+    for (unsigned i = 0; i < array_size(indexer->batches);)
+    {
+        search_indexer_batch_t* batch = indexer->batches[i];
+        if (!atomic_load32(&batch->completed, memory_order_acquire))
         {
-            *stop_indexing = true;
-            log_warnf(HASH_SEARCH, WARNING_NETWORK, STRING_CONST("EOD full api usage is near, stopping search indexing."));
-            return;
+            ++i;
+            continue;
         }
+
+        search_indexer_merge_batch(indexer, batch);
+        array_erase_memcpy(indexer->batches, i);
+    }
+
+    const bool stopped = atomic_load32(&indexer->stop, memory_order_relaxed) != 0;
+    while (!stopped && array_size(indexer->batches) < SEARCH_INDEXER_MAX_THREADS)
+    {
+        search_indexer_batch_t* batch = search_indexer_next_batch(indexer);
+        if (batch == nullptr)
+            break;
+
+        batch->thread = thread_allocate(search_indexer_batch_thread_fn, batch, STRING_CONST("search_indexer"), THREAD_PRIORITY_BELOWNORMAL, 0);
+        thread_start(batch->thread);
+        array_push(indexer->batches, batch);
+    }
+
+    if (array_size(indexer->batches) > 0)
+        return true;
+
+    if (stopped)
+        return false;
+
+    SHARED_READ_LOCK(indexer->queue_lock);
+    return indexer->queue_offset < array_size(indexer->queue);
+}
+
+/*! Stop scheduling new batches, the running ones still need to be merged with #search_indexer_update. */
+FOUNDATION_EXTERN void search_indexer_stop(search_indexer_t* indexer)
+{
+    atomic_store32(&indexer->stop, 1, memory_order_release);
+}
+
+/*! Returns the number of indexed documents per second since the indexer was created. */
+FOUNDATION_EXTERN double search_indexer_throughput(const search_indexer_t* indexer)
+{
+    const double elapsed = time_elapsed(indexer->started);
+    if (elapsed <= 0)
+        return 0;
+    return atomic_load32(&indexer->indexed, memory_order_relaxed) / elapsed;
+}
+
+/*! Stop the indexer, wait for its running batches and release it. */
+FOUNDATION_EXTERN void search_indexer_deallocate(search_indexer_t*& indexer)
+{
+    if (indexer == nullptr)
+        return;
+
+    search_indexer_stop(indexer);
+    while (search_indexer_update(indexer))
+        thread_sleep(10);
+
+    foreach(e, indexer->queue)
+        string_deallocate(e->symbol.str);
+    array_deallocate(indexer->queue);
+    array_deallocate(indexer->batches);
+    MEM_DELETE(indexer);
+}
+
+FOUNDATION_STATIC bool search_indexer_fetch_fundamentals(string_const_t symbol, const function<void(const json_object_t& json)>& index_fn)
+{
+    // Check that the stock is still valid and current
+    if (!stock_valid(STRING_ARGS(symbol)))
+    {
+        log_debugf(HASH_SEARCH, STRING_CONST("Symbol %.*s is not valid, skipping it for indexing"), STRING_FORMAT(symbol));
+        return true;
+    }
+
+    return eod_fetch("fundamentals", symbol.str, FORMAT_JSON_CACHE, index_fn, 25 * 24 * 60 * 60ULL);
+}
+
+FOUNDATION_STATIC void search_index_exchange_symbols(search_indexer_t* indexer, const json_object_t& data, const char* market, size_t market_length)
+{
+    MEMORY_TRACKER(HASH_SEARCH);
+
+    search_database_t* db = indexer->db;
+
+    for(auto e : data)
+    {   
+        if (atomic_load32(&indexer->stop, memory_order_relaxed))
+            break;
     
-        const tick_t st = time_current();
         if (e.root == nullptr || e.root->type != JSON_OBJECT)
             continue;
 
@@ -694,7 +953,6 @@ FOUNDATION_STATIC void search_index_exchange_symbols(const json_object_t& data,
             continue;
         }
 
-        string_const_t isin = e["Isin"].as_string();
         string_const_t type = e["Type"].as_string();
 
         // Do not index FUND stock and those with no ISIN
@@ -718,20 +976,47 @@ FOUNDATION_STATIC void search_index_exchange_symbols(const json_object_t& data,
                 continue;
         }
 
-        // Check that the stock is still valid and current
-        if (!stock_valid(STRING_ARGS(symbol)))
-        {
-            log_debugf(HASH_SEARCH, STRING_CONST("Symbol %.*s is not valid, skipping it for indexing"), STRING_FORMAT(symbol));
-            continue;
-        }
+        search_indexer_queue(indexer, STRING_ARGS(symbol), doc == SEARCH_DOCUMENT_INVALID_ID);
+    }
+}
+
+/*! Exchange symbol list fetched by its own thread to feed the indexer. */
+/*! Queue of stock exchanges whose symbols are fetched by a few threads. */
+struct search_indexer_exchanges_t
+{
+    search_indexer_t* indexer{ nullptr };
+    const string_t*   markets{ nullptr };
+    unsigned          market_count{ 0 };
+    atomic32_t        next{ 0 };
+    atomic32_t        running{ 0 };
+};
+
+FOUNDATION_STATIC void* search_indexer_exchange_thread_fn(void* data)
+{
+    MEMORY_TRACKER(HASH_SEARCH);
+
+    search_indexer_exchanges_t* exchanges = (search_indexer_exchanges_t*)data;
+    search_indexer_t* indexer = exchanges->indexer;
 
-        // Fetch symbol fundamental data
-        if (!eod_fetch("fundamentals", symbol.str, FORMAT_JSON_CACHE, 
-            LC1(search_index_fundamental_data(_1, string_to_const(symbol))), 25 * 24 * 60 * 60ULL))
+    // Each fetch blocks until the exchange symbols are received, so threads take the next exchange once done.
+    while (!thread_try_wait(0))
+    {
+        const unsigned index = (unsigned)atomic_incr32(&exchanges->next, memory_order_relaxed) - 1;
+        if (index >= exchanges->market_count)
+            break;
+
+        const string_t* market = &exchanges->markets[index];
+        auto fetch_fn = [indexer, market](const json_object_t& data)
         {
-            log_warnf(HASH_SEARCH, WARNING_RESOURCE, STRING_CONST("Failed to fetch %.*s fundamental"), STRING_FORMAT(symbol));
-        }
+            EPOCH_SCOPE();
+            search_index_exchange_symbols(indexer, data, STRING_ARGS(*market));
+        };
+        if (!eod_fetch("exchange-symbol-list", market->str, FORMAT_JSON_CACHE, fetch_fn, 30 * 24 * 60 * 60ULL))
+            tr_warn(HASH_SEARCH, WARNING_RESOURCE, "Failed to fetch {0} symbols", *market);
     }
+
+    atomic_decr32(&exchanges->running, memory_order_release);
+    return 0;
 }
 
 FOUNDATION_STATIC void* search_indexing_thread_fn(void* data)
@@ -739,12 +1024,26 @@ FOUNDATION_STATIC void* search_indexing_thread_fn(void* data)
     MEMORY_TRACKER(HASH_SEARCH);
 
     // Load search database
-    _search->db = search_database_allocate(SearchDatabaseFlags::SkipCommonWords);
+    const search_database_flags_t db_flags = SearchDatabaseFlags::SkipCommonWords;
+    _search->db = search_database_allocate(db_flags);
+
+    // Mapping the search database is immediate, so it is available before indexing starts.
+    {
+        TIME_TRACKER("Loading search database");
+        string_const_t search_db_path = session_get_user_file_path(STRING_CONST("search.db"));
+        if (!search_database_map(_search->db, STRING_ARGS(search_db_path)))
+        {
+            // Keep using the previous file version in memory if it could not be converted.
+            if (!search_database_upgrade_file(STRING_ARGS(search_db_path)) || !search_database_map(_search->db, STRING_ARGS(search_db_path)))
+                search_database_load_file(_search->db, STRING_ARGS(search_db_path));
+        }
+    }
+    
+    dispatcher_post_event(EVENT_SEARCH_DATABASE_LOADED);
 
     // Wait a few seconds before starting the indexing process.
     // Delaying the start of the indexing process helps when the users wants to
-    // quickly close the application after starting it, as the indexing process
-    // takes a few seconds just to load the search database
+    // quickly close the application after starting it.
     if (_search->startup_signal.wait(30000))
     {
         log_debugf(0, STRING_CONST("Search indexing kick off"));
@@ -758,26 +1057,6 @@ FOUNDATION_STATIC void* search_indexing_thread_fn(void* data)
         return 0;
     }
 
-    string_const_t search_db_path = session_get_user_file_path(STRING_CONST("search.db"));
-    stream_t* search_db_stream = fs_open_file(STRING_ARGS(search_db_path), STREAM_IN | STREAM_BINARY);
-    if (search_db_stream)
-    {
-        if (thread_try_wait(0))
-        {
-            stream_deallocate(search_db_stream);
-            return 0;
-        }
-            
-        TIME_TRACKER("Loading search database");
-        search_database_load(_search->db, search_db_stream);
-        stream_deallocate(search_db_stream);
-
-        if (thread_try_wait(0))
-            return 0;
-    }
-    
-    dispatcher_post_event(EVENT_SEARCH_DATABASE_LOADED);
-
     // If using demo key, skip indexing
     string_const_t eod_key = string_to_const(eod_get_key().str);
     if (string_equal_nocase(STRING_ARGS(eod_key), STRING_CONST("demo")))
@@ -804,29 +1083,77 @@ FOUNDATION_STATIC void* search_indexing_thread_fn(void* data)
     if (thread_try_wait(0))
         return 0;
     
-    // Fetch all titles from stock exchange market
+    // Wait to connect to EOD services
+    const tick_t timeout = time_current();
+    while (!eod_availalble() && time_elapsed(timeout) < 30.0)
+    {
+        if (thread_try_wait(100))
+            return 0;
+    }
+
+    search_indexer_t* indexer = search_indexer_allocate(_search->db, db_flags, search_indexer_fetch_fundamentals, true);
+    _search->indexer = indexer;
+    
+    // Fetch all titles from stock exchange markets in parallel to feed the indexer
     SHARED_READ_LOCK(_search->exchanges_lock);
 
-    bool stop_indexing = false;
-    foreach (market, _search->exchanges)
+    search_indexer_exchanges_t exchanges;
+    exchanges.indexer = indexer;
+    exchanges.markets = _search->exchanges;
+    exchanges.market_count = array_size(_search->exchanges);
+
+    thread_t** exchange_threads = nullptr;
+    const unsigned exchange_thread_count = min(exchanges.market_count, SEARCH_EXCHANGE_FETCH_MAX_THREADS);
+    atomic_store32(&exchanges.running, (int32_t)exchange_thread_count, memory_order_release);
+    for (unsigned i = 0; i < exchange_thread_count; ++i)
+    {
+        thread_t* thread = thread_allocate(search_indexer_exchange_thread_fn, &exchanges, STRING_CONST("search_exchange"), THREAD_PRIORITY_BELOWNORMAL, 0);
+        thread_start(thread);
+        array_push(exchange_threads, thread);
+    }
+
+    for (;;)
     {
-        if (stop_indexing)
+        // Indexing reads stocks, the dispatcher thread only stays in an epoch for each update.
+        EPOCH_SCOPE();
+
+        const bool fetching_exchanges = atomic_load32(&exchanges.running, memory_order_acquire) > 0;
+
+        if (!search_indexer_update(indexer) && !fetching_exchanges)
             break;
-            
-        if (thread_try_wait(1000))
+
+        if (thread_try_wait(50))
             break;
-            
-        auto fetch_fn = [market, &stop_indexing](const json_object_t& data) 
-        { 
-            search_index_exchange_symbols(data, STRING_ARGS(*market), &stop_indexing); 
-        };
-        if (!eod_fetch("exchange-symbol-list", market->str, FORMAT_JSON_CACHE, fetch_fn, 30 * 24 * 60 * 60ULL))
+
+        if (!eod_availalble())
         {
-            tr_warn(HASH_SEARCH, WARNING_RESOURCE, "Failed to fetch {0} symbols", *market);
+            log_warnf(HASH_SEARCH, WARNING_NETWORK, STRING_CONST("Failed to connect to EOD services, terminating indexing"));
+            break;
         }
 
-        tr_info(HASH_SEARCH, "Search indexing completed for the market {0}", *market);
-    }    
+        if (eod_capacity() > 0.8)
+        {
+            log_warnf(HASH_SEARCH, WARNING_NETWORK, STRING_CONST("EOD full api usage is near, stopping search indexing."));
+            break;
+        }
+    }
+
+    // Merge what has been indexed so far
+    search_indexer_stop(indexer);
+    while (search_indexer_update(indexer))
+        thread_sleep(10);
+
+    foreach(t, exchange_threads)
+    {
+        thread_signal(*t);
+        thread_join(*t);
+        thread_deallocate(*t);
+    }
+    array_deallocate(exchange_threads);
+
+    log_infof(HASH_SEARCH, STRING_CONST("Search indexing completed, %d documents indexed out of %d symbols in %.1lf seconds (%.1lf docs/s)"),
+        atomic_load32(&indexer->indexed, memory_order_relaxed), atomic_load32(&indexer->queued, memory_order_relaxed),
+        time_elapsed(indexer->started), search_indexer_throughput(indexer));
 
     return 0;
 }
@@ -980,6 +1307,34 @@ FOUNDATION_STATIC void search_window_clear_results(search_window_t* sw)
 }
 
 
+/*! Add a database document to the search window results if it is not already listed.
+ * 
+ *  @remark The search window lock must be held for writing.
+ */
+FOUNDATION_STATIC bool search_window_add_database_result(search_window_t* sw, search_database_t* db, search_document_handle_t doc)
+{
+    search_result_entry_t entry{};
+    entry.db = db;
+    entry.doc = doc;
+    entry.window = sw;
+    entry.source_type = SearchResultSourceType::Database;
+
+    string_const_t symbol = search_database_document_name(db, doc);
+    string_copy(STRING_BUFFER(entry.symbol), STRING_ARGS(symbol));
+
+    // Check that we do not already have this symbol in the list
+    for (unsigned i = 0, end = array_size(sw->results); i < end; ++i)
+    {
+        const search_result_entry_t* re = sw->results + i;
+        string_const_t re_symbol = search_entry_resolve_symbol(re);
+        if (string_equal(STRING_ARGS(re_symbol), STRING_ARGS(symbol)))
+            return false;
+    }
+
+    array_push_memcpy(sw->results, &entry);
+    return true;
+}
+
 FOUNDATION_STATIC void search_window_execute_query(search_window_t* sw, const char* search_text, size_t search_text_length)
 {
     FOUNDATION_ASSERT(sw);
@@ -994,16 +1349,33 @@ FOUNDATION_STATIC void search_window_execute_query(search_window_t* sw, const ch
     sw->query_tick = time_current();
     try
     {
-        // Start with a query to EOD /api/search
         window_handle_t sw_handle = sw->handle;
 
-        // Run simple EOD API query if the search text does not contain any special characters
-        if (search_text_length > 1 &&
+        // Start by completing symbols, names and ISINs from the local index if the search text does not contain any special characters
+        const bool simple_search_text =
             string_find(search_text, search_text_length, ':', 1) == STRING_NPOS &&
             string_find(search_text, search_text_length, '=', 1) == STRING_NPOS &&
             string_find(search_text, search_text_length, '!', 1) == STRING_NPOS &&
             string_find(search_text, search_text_length, '<', 1) == STRING_NPOS &&
-            string_find(search_text, search_text_length, '>', 1) == STRING_NPOS)
+            string_find(search_text, search_text_length, '>', 1) == STRING_NPOS;
+
+        bool completed = false;
+        if (simple_search_text)
+        {
+            search_result_t* completions = search_database_complete(db, search_text, search_text_length, SEARCH_COMPLETION_MAX_RESULTS);
+            {
+                SHARED_WRITE_LOCK(sw->lock);
+                foreach(c, completions)
+                    completed |= search_window_add_database_result(sw, db, (search_document_handle_t)c->id);
+            }
+            array_deallocate(completions);
+
+            if (completed && sw->table)
+                dispatcher_post_event(EVENT_SEARCH_QUERY_UPDATED);
+        }
+
+        // Run simple EOD API query if nothing could be completed locally
+        if (simple_search_text && !completed && search_text_length > 1)
         {
             hash_t search_query_hash = string_hash(search_text, search_text_length);
             eod_fetch_async("search", search_text, FORMAT_JSON, "limit", "5",
@@ -1028,32 +1400,7 @@ FOUNDATION_STATIC void search_window_execute_query(search_window_t* sw, const ch
             const search_result_t* results = search_database_query_results(db, query);
 
             foreach(r, results)
-            {
-                search_result_entry_t entry{};
-                entry.db = db;
-                entry.doc = (search_document_handle_t)r->id;
-                entry.window = sw;
-                entry.source_type = SearchResultSourceType::Database;
-
-                string_const_t symbol = search_database_document_name(db, (search_document_handle_t)r->id);
-                string_copy(STRING_BUFFER(entry.symbol), STRING_ARGS(symbol));
-
-                // Check that we do not already have this symbol in the list
-                bool unique = true;
-                for (unsigned i = 0, end = array_size(sw->results); i < end; ++i)
-                {
-                    const search_result_entry_t* re = sw->results + i;
-                    string_const_t re_symbol = search_entry_resolve_symbol(re);
-                    if (string_equal(STRING_ARGS(re_symbol), STRING_ARGS(symbol)))
-                    {
-                        unique = false;
-                        break;
-                    }
-                }
-
-                if (unique)
-                    array_push_memcpy(sw->results, &entry);
-            }
+                search_window_add_database_result(sw, db, (search_document_handle_t)r->id);
 
             // TODO: Remove duplicates
 
@@ -1753,6 +2100,16 @@ FOUNDATION_STATIC expr_result_t search_expr_stats(const expr_func_t* f, vec_expr
 
     search_database_print_stats(db);
 
+    const search_indexer_t* indexer = _search->indexer;
+    if (indexer)
+    {
+        log_infof(HASH_SEARCH, STRING_CONST("Search indexer\n\tQueued: %d\n\tFetched: %d\n\tFailed: %d\n\tSkipped: %d\n\tIndexed: %d\n\tMerged: %d\n\tThroughput: %.1lf docs/s"),
+            atomic_load32(&indexer->queued, memory_order_relaxed), atomic_load32(&indexer->fetched, memory_order_relaxed),
+            atomic_load32(&indexer->failed, memory_order_relaxed), atomic_load32(&indexer->skipped, memory_order_relaxed),
+            atomic_load32(&indexer->indexed, memory_order_relaxed), atomic_load32(&indexer->merged, memory_order_relaxed),
+            search_indexer_throughput(indexer));
+    }
+
     return NIL;
 }
 
@@ -1762,12 +2119,20 @@ FOUNDATION_STATIC expr_result_t search_expr_index_document(const expr_func_t* f,
     FOUNDATION_ASSERT(db);
 
     string_const_t symbol = expr_eval_get_string_arg(args, 0, "Failed to get document name");
-    if (!eod_fetch("fundamentals", symbol.str, FORMAT_JSON, LC1(search_index_fundamental_data(_1, symbol))))
+    const bool new_document = search_database_find_document(db, STRING_ARGS(symbol)) == SEARCH_DOCUMENT_INVALID_ID;
+    search_document_handle_t doc = SEARCH_DOCUMENT_INVALID_ID;
+    if (!eod_fetch("fundamentals", symbol.str, FORMAT_JSON, [db, symbol, &doc](const json_object_t& json)
+    {
+        doc = search_index_fundamental_document(db, json, symbol);
+    }))
     {
         log_warnf(HASH_SEARCH, WARNING_RESOURCE, STRING_CONST("Failed to fetch %.*s fundamental"), STRING_FORMAT(symbol));
         return false;
     }
 
+    if (doc != SEARCH_DOCUMENT_INVALID_ID)
+        search_index_fundamental_extras(db, doc, symbol, new_document);
+
     log_infof(HASH_SEARCH, STRING_CONST("Indexed %.*s\n\tSymbols: %u\n\tProperties: %u"), 
         STRING_FORMAT(symbol), search_database_document_count(db), search_database_index_count(db));
 
@@ -1993,19 +2358,16 @@ FOUNDATION_STATIC bool search_stop_indexing(bool save_db)
         return false;
     _search->indexing_thread = 0;
 
+    search_indexer_deallocate(_search->indexer);
+
     if (save_db && search_database_is_dirty(_search->db))
     {
         if (main_is_interactive_mode())
         {
             // Save search database on disk
             string_const_t search_db_path = session_get_user_file_path(STRING_CONST("search.db"));
-            stream_t* search_db_stream = fs_open_file(STRING_ARGS(search_db_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
-            if (search_db_stream)
-            {
-                TIME_TRACKER("Saving search database");
-                search_database_save(_search->db, search_db_stream);
-                stream_deallocate(search_db_stream);
-            }
+            TIME_TRACKER("Saving search database");
+            search_database_save_file(_search->db, STRING_ARGS(search_db_path));
         }
         else
         {
@@ -2076,6 +2438,15 @@ bool search_render_settings()
     ImGui::TrTextWrapped("Changing that setting will restart the indexing process but if will not delete already indexed stock from removed exchanges. "
         "Indexing a new stock exchange can take between 1 to 3 hours.");
 
+    const search_indexer_t* indexer = _search->indexer;
+    if (indexer)
+    {
+        const int32_t queued = atomic_load32(&indexer->queued, memory_order_relaxed);
+        const int32_t processed = atomic_load32(&indexer->fetched, memory_order_relaxed) + atomic_load32(&indexer->failed, memory_order_relaxed);
+        ImGui::TrTextWrapped("Indexing progress: %d/%d symbols, %d documents indexed (%.1lf docs/s)", 
+            processed, queued, atomic_load32(&indexer->indexed, memory_order_relaxed), search_indexer_throughput(indexer));
+    }
+
     return updated;
 }
 
@@ -2140,4 +2511,4 @@ FOUNDATION_STATIC void search_shutdown()
     MEM_DELETE(_search);
 }
 
-DEFINE_MODULE(SEARCH, search_initialize, search_shutdown, MODULE_PRIORITY_MODULE);
+DEFINE_MODULE(SEARCH, search_initialize, search_shutdown, MODULE_PRIORITY_MODULE, MODULE_FLAGS_NONE, "STOCK,EOD,LOCALIZATION");
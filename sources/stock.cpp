@@ -21,10 +21,14 @@
 #include <framework/localization.h>
 #include <framework/database.h>
 #include <framework/session.h>
+#include <framework/epoch.h>
+#include <framework/jobs.h>
+#include <framework/system.h>
 
 #include <foundation/path.h>
 #include <foundation/hashtable.h>
 #include <foundation/stream.h>
+#include <foundation/thread.h>
 
 #define HASH_STOCK static_hash_string("stock", 5, 0x1a0dd7af24ebee7aLL)
 
@@ -52,39 +56,184 @@ FOUNDATION_FORCEINLINE hash_t stock_invalid_symbol_hash(const stock_invalid_symb
 
 typedef database<stock_invalid_symbol_t, stock_invalid_symbol_hash> stock_invalid_symbol_db_t;
 
+constexpr uint32_t STOCK_EOD_HISTORY_VERSION = 2;
+
+/*! Header of the local EOD history files.
+ *  It is followed by #count #day_result_t sorted from the most recent day,
+ *  so that a mapped file can be used directly as a stock history.
+ */
+struct stock_eod_history_header_t
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t day_size;  // Size of #day_result_t when the file was written
+    hash_t   checksum;  // Hash of the days following the header
+    uint32_t array[4];  // Foundation array header, so array functions work on the mapped days
+};
+
+/*! Mapped EOD history file used as a stock history. */
+struct stock_history_map_t
+{
+    const void* data{ nullptr };
+    size_t      size{ 0 };
+};
+
+typedef enum StockExchangeRateState : int32_t {
+    STOCK_EXCHANGE_RATE_EMPTY = 0,
+    STOCK_EXCHANGE_RATE_LOADING,
+    STOCK_EXCHANGE_RATE_READY
+} stock_exchange_rate_state_t;
+
+/*! Daily exchange rates of a currency pair.
+ *  Dates and rates are dense arrays sorted by date that never change once the series is ready.
+ */
+struct stock_exchange_rate_series_t
+{
+    hash_t      key{ 0 };
+    char        code[32]{ 0 };
+    atomic32_t  state{ STOCK_EXCHANGE_RATE_EMPTY };
+    time_t*     dates{ nullptr };
+    double*     rates{ nullptr };
+    atomic64_t  current{ 0 };         // Bits of the latest real-time rate, 0 until fetched
+    atomic64_t  current_time{ 0 };    // Time at which the real-time rate was fetched
+    event_handle loaded;              // Signaled once the series is ready
+};
+
+/*! Time after which the real-time exchange rate of a currency pair is fetched again. */
+constexpr time_t STOCK_EXCHANGE_RATE_REALTIME_MAX_AGE = 60 * 60;
+
+/*! Stocks are stored in fixed size chunks that never move, so stock pointers remain valid until shutdown. */
+constexpr uint32_t STOCK_CHUNK_SIZE = 256;
+constexpr uint32_t STOCK_MAX_CHUNKS = 1024;
+
+/*! Maximum number of symbols fetched by a single real-time query. */
+constexpr uint32_t STOCK_REALTIME_BATCH_MAX_SYMBOLS = 32;
+
+/*! Time during which real-time requests are collected before being fetched together. */
+constexpr unsigned STOCK_REALTIME_BATCH_WINDOW_MS = 10;
+
 static size_t _db_capacity;
-static shared_mutex _db_lock;
-static day_result_t** _trashed_history = nullptr;
-static stock_t* _db_stocks = nullptr;
-static hashtable64_t* _db_hashes = nullptr;
-static hashtable64_t* _exchange_rates = nullptr;
+static shared_mutex _db_lock; // Serializes the creation of new stocks
+static atomic32_t _db_count{};
+static atomicptr_t _db_chunks[STOCK_MAX_CHUNKS]{};
+static atomicptr_t _db_hashes{};
+static shared_mutex _exchange_rates_lock;
+static stock_exchange_rate_series_t** _exchange_rates = nullptr;
 static stock_invalid_symbol_db_t* _invalid_symbols = nullptr;
 
+struct stock_resolved_waiter_t
+{
+    const stock_t*            stock;
+    fetch_level_t             fetch_levels;
+    stock_resolved_callback_t callback;
+    void*                     context;
+};
+
+static shared_mutex _resolved_waiters_lock;
+static atomic32_t _resolved_waiter_count{}; // Lets resolved stocks skip the lock when nobody waits
+static stock_resolved_waiter_t* _resolved_waiters = nullptr;
+
+struct stock_change_listener_t
+{
+    stock_changed_callback_t callback;
+    void*                    context;
+};
+
+static shared_mutex _change_listeners_lock;
+static atomic32_t _change_listener_count{}; // Lets stock updates skip the lock when nobody listens
+static stock_change_listener_t* _change_listeners = nullptr;
+
+static shared_mutex _realtime_batch_lock;
+static stock_index_t* _realtime_batch = nullptr; // Stocks waiting to be fetched by the next real-time query
+static bool _realtime_batch_scheduled = false;
+
+/*! Returns the stock stored at a given index or null if the index was never allocated.
+ *  Reading a stock never locks.
+ */
+FOUNDATION_FORCEINLINE stock_t* stock_entry(stock_index_t index)
+{
+    if (index == 0 || index >= (stock_index_t)atomic_load32(&_db_count, memory_order_acquire))
+        return nullptr;
+
+    stock_t* chunk = (stock_t*)atomic_load_ptr(&_db_chunks[index / STOCK_CHUNK_SIZE], memory_order_acquire);
+    return &chunk[index % STOCK_CHUNK_SIZE];
+}
+
+/*! Returns the stock index hash table.
+ *  @remark The caller must be inside an epoch as the table can be replaced when growing.
+ */
+FOUNDATION_FORCEINLINE hashtable64_t* stock_hashes()
+{
+    return (hashtable64_t*)atomic_load_ptr(&_db_hashes, memory_order_acquire);
+}
+
+FOUNDATION_STATIC void stock_history_deallocate(void* ptr)
+{
+    day_result_t* history = (day_result_t*)ptr;
+    array_deallocate(history);
+}
+
 FOUNDATION_STATIC void stock_grow_db()
 {
-    hashtable64_t* old_table = _db_hashes;
+    hashtable64_t* old_table = stock_hashes();
     _db_capacity *= size_t(2);
     hashtable64_t* new_hash_table = hashtable64_allocate(_db_capacity);
-    for (int i = 1, end = array_size(_db_stocks); i < end; ++i)
-        hashtable64_set(new_hash_table, _db_stocks[i].id, i);
+    for (stock_index_t i = 1, end = atomic_load32(&_db_count, memory_order_acquire); i < end; ++i)
+        hashtable64_set(new_hash_table, stock_entry(i)->id, i);
 
-    _db_hashes = new_hash_table;
+    atomic_store_ptr(&_db_hashes, new_hash_table, memory_order_release);
 
-    for (size_t i = 0; i < array_size(_trashed_history); ++i)
-        array_deallocate(_trashed_history[i]);
-    array_clear(_trashed_history);
+    // Readers might still be probing the previous table.
+    epoch_retire(old_table, [](void* ptr) { hashtable64_deallocate((hashtable64_t*)ptr); });
+}
 
-    hashtable64_deallocate(old_table);
+FOUNDATION_EXTERN void stock_history_map_deallocate(void* ptr)
+{
+    stock_history_map_t* map = (stock_history_map_t*)ptr;
+    system_unmap_file(map->data, map->size);
+    MEM_DELETE(map);
+}
+
+/*! Replace the EOD history of a stock with an array or the days of a mapped history file.
+ *  The previous history is released once no reader can be iterating it anymore.
+ *
+ *  @param out_previous_map If set, receives the previous mapped history instead of retiring it,
+ *                          so the caller can retire it with its own deleter.
+ */
+FOUNDATION_STATIC void stock_history_replace(stock_t* entry, day_result_t* history, stock_history_map_t* map, stock_history_map_t** out_previous_map = nullptr)
+{
+    day_result_t* previous_history = entry->history;
+    stock_history_map_t* previous_map = entry->history_map;
+
+    // Readers load the history pointer once and get its size from it, so the days must be visible before the pointer.
+    atomic_thread_fence_release();
+    entry->history = history;
+    entry->history_map = map;
+
+    if (out_previous_map)
+        *out_previous_map = previous_map;
+
+    if (previous_map == nullptr)
+        epoch_retire(previous_history, stock_history_deallocate);
+    else if (out_previous_map == nullptr)
+        epoch_retire(previous_map, stock_history_map_deallocate);
+}
+
+/*! Replace the EOD history of a stock.
+ *  The previous history is released once no reader can be iterating it anymore.
+ */
+FOUNDATION_EXTERN void stock_swap_history(stock_t* entry, day_result_t* history)
+{
+    stock_history_replace(entry, history, nullptr);
 }
 
 template <size_t field_length>
 FOUNDATION_STATIC bool stock_fetch_earnings_trend(stock_index_t stock_index, const char(&field)[field_length], double& value)
 {
-    if (_db_stocks == nullptr || stock_index >= array_size(_db_stocks))
+    const stock_t* s = stock_entry(stock_index);
+    if (s == nullptr)
         return false;
-
-    SHARED_READ_LOCK(_db_lock);
-    const stock_t* s = &_db_stocks[stock_index];
     if (s == nullptr || !s->has_resolve(FetchLevel::FUNDAMENTALS))
         return false;
 
@@ -114,8 +263,7 @@ FOUNDATION_STATIC bool stock_fetch_earnings_trend(stock_index_t stock_index, con
 
         const double value_avg = value_count > 0 ? value_total / value_count : 0;
         
-        SHARED_READ_LOCK(_db_lock);
-        stock_t* s = &_db_stocks[stock_index];
+        stock_t* s = stock_entry(stock_index);
 
         if (string_equal(field, field_length-1, STRING_CONST("actual")))
             s->earning_trend_actual = value_avg;
@@ -130,11 +278,9 @@ FOUNDATION_STATIC bool stock_fetch_earnings_trend(stock_index_t stock_index, con
 
 FOUNDATION_STATIC bool stock_fetch_short_name(stock_index_t stock_index, string_table_symbol_t& value)
 {
-    if (_db_stocks == nullptr || stock_index >= array_size(_db_stocks))
+    const stock_t* s = stock_entry(stock_index);
+    if (s == nullptr)
         return false;
-
-    SHARED_READ_LOCK(_db_lock);
-    const stock_t* s = &_db_stocks[stock_index];
     
     if (!s->has_resolve(FetchLevel::FUNDAMENTALS))
         return false;
@@ -154,29 +300,20 @@ FOUNDATION_STATIC bool stock_fetch_short_name(stock_index_t stock_index, string_
 
 FOUNDATION_STATIC bool stock_fetch_description(stock_index_t stock_index, string_table_symbol_t& value)
 {
-    if (_db_stocks == nullptr || stock_index >= array_size(_db_stocks))
-        return false;	
-
-    SHARED_READ_LOCK(_db_lock);
-    const stock_t* s = &_db_stocks[stock_index];
+    const stock_t* s = stock_entry(stock_index);
+    if (s == nullptr)
+        return false;
     const char* ticker = string_table_decode(s->code);
     return eod_fetch_async("fundamentals", ticker, FORMAT_JSON_CACHE, "filter", "General::Description", [stock_index](const json_object_t& json)
     {
         if (json.root == nullptr)
             return;
 
-        SHARED_READ_LOCK(_db_lock);
-        stock_t* stock_data = &_db_stocks[stock_index];
+        stock_t* stock_data = stock_entry(stock_index);
         stock_data->description = string_table_encode_unescape(json_token_value(json.buffer, json.root));
     }, UINT64_MAX);
 }
 
-FOUNDATION_STATIC void stock_read_real_time_results(const json_object_t& json, stock_index_t index)
-{
-    day_result_t d{};
-    stock_read_real_time_results(index, json, d);
-}
-
 bool stock_read_real_time_results(stock_index_t index, const json_object_t& json, day_result_t& d)
 {
     string_const_t code = json["code"].as_string();
@@ -187,15 +324,16 @@ bool stock_read_real_time_results(stock_index_t index, const json_object_t& json
 
         if (index > 0)
         {
-            SHARED_READ_LOCK(_db_lock);
-            stock_t* entry = &_db_stocks[index];
+            stock_t* entry = stock_entry(index);
 
             // Still try to grab the previous close price and set it as current price
             double previous_close = json_read_number(json, STRING_CONST("previousClose"));
             entry->current.open = entry->current.price = entry->current.adjusted_close = previous_close;
 
-            if (entry->history_count > 0)
-                entry->current.date = entry->history[0].date;
+            EPOCH_SCOPE();
+            const day_result_t* history = entry->history;
+            if (array_size(history) > 0)
+                entry->current.date = history[0].date;
 
             entry->fetch_errors++;
             entry->mark_resolved(FetchLevel::REALTIME, true);
@@ -218,8 +356,7 @@ bool stock_read_real_time_results(stock_index_t index, const json_object_t& json
 
     if (index > 0)
     {
-        SHARED_READ_LOCK(_db_lock);
-        stock_t* entry = &_db_stocks[index];
+        stock_t* entry = stock_entry(index);
 
         if (entry->current.date < d.date && !math_real_is_nan(d.close))
         {
@@ -250,10 +387,129 @@ bool stock_read_real_time_results(stock_index_t index, const json_object_t& json
     return true;
 }
 
+FOUNDATION_STATIC void stock_read_real_time_batch_results(const json_object_t& json, stock_index_t* batch)
+{
+    const auto read_result = [batch](const json_object_t& result)
+    {
+        string_const_t code = result["code"].as_string();
+        for (unsigned i = 0, end = array_size(batch); i < end; ++i)
+        {
+            if (batch[i] == 0)
+                continue;
+
+            string_const_t stock_code = string_table_decode_const(stock_entry(batch[i])->code);
+            if (!string_equal_nocase(STRING_ARGS(stock_code), STRING_ARGS(code)))
+                continue;
+
+            day_result_t d{};
+            stock_read_real_time_results(batch[i], result, d);
+            batch[i] = 0;
+            break;
+        }
+    };
+
+    // A query for a single symbol returns an object instead of an array.
+    if (json.root && json.root->type == JSON_OBJECT)
+    {
+        read_result(json);
+    }
+    else if (json.root && json.root->type == JSON_ARRAY)
+    {
+        for (auto e : json)
+            read_result(e);
+    }
+
+    foreach(index, batch)
+    {
+        if (*index == 0)
+            continue;
+
+        stock_t* entry = stock_entry(*index);
+        entry->fetch_errors++;
+        entry->mark_resolved(FetchLevel::REALTIME, true);
+        log_warnf(HASH_STOCK, WARNING_RESOURCE, STRING_CONST("[%u] No real-time results for %s"), entry->fetch_errors, string_table_decode(entry->code));
+    }
+
+    array_deallocate(batch);
+}
+
+/*! Fetch the real-time data of many stocks with a single query, i.e. real-time/A.US?s=B.US,C.US
+ *  The batch is released once the results are read.
+ */
+FOUNDATION_STATIC void stock_fetch_real_time_batch(stock_index_t* batch)
+{
+    if (array_size(batch) == 0)
+    {
+        array_deallocate(batch);
+        return;
+    }
+
+    char ticker[64] { 0 };
+    string_const_t first_code = string_table_decode_const(stock_entry(batch[0])->code);
+    string_copy(STRING_BUFFER(ticker), STRING_ARGS(first_code));
+
+    char symbols_buffer[STOCK_REALTIME_BATCH_MAX_SYMBOLS * 32] { 0 };
+    string_t symbols = string_copy(STRING_BUFFER(symbols_buffer), nullptr, 0);
+    for (unsigned i = 1, end = array_size(batch); i < end; ++i)
+    {
+        string_const_t code = string_table_decode_const(stock_entry(batch[i])->code);
+        if (symbols.length > 0)
+            symbols = string_append(STRING_ARGS(symbols), sizeof(symbols_buffer), STRING_CONST(","));
+        symbols = string_append(STRING_ARGS(symbols), sizeof(symbols_buffer), STRING_ARGS(code));
+    }
+
+    bool fetching = false;
+    if (symbols.length == 0)
+        fetching = eod_fetch_async("real-time", ticker, FORMAT_JSON, LC1(stock_read_real_time_batch_results(_1, batch)), 0);
+    else
+        fetching = eod_fetch_async("real-time", ticker, FORMAT_JSON, "s", symbols.str, LC1(stock_read_real_time_batch_results(_1, batch)), 0);
+
+    if (fetching)
+        return;
+
+    foreach(index, batch)
+    {
+        stock_t* entry = stock_entry(*index);
+        entry->fetch_errors++;
+        entry->mark_resolved(FetchLevel::REALTIME, true);
+        log_warnf(HASH_STOCK, WARNING_RESOURCE, STRING_CONST("[%u] Failed to fetch real-time results for %s"), entry->fetch_errors, string_table_decode(entry->code));
+    }
+    array_deallocate(batch);
+}
+
+/*! Queue a stock for the next real-time query. 
+ *  The queue is fetched once it is full, after #STOCK_REALTIME_BATCH_WINDOW_MS on the main thread 
+ *  or as soon as someone waits for the real-time data of a stock.
+ */
+FOUNDATION_STATIC void stock_request_real_time(stock_index_t index)
+{
+    bool schedule = false;
+    stock_index_t* batch = nullptr;
+    {
+        SHARED_WRITE_LOCK(_realtime_batch_lock);
+        array_push(_realtime_batch, index);
+        if (array_size(_realtime_batch) >= STOCK_REALTIME_BATCH_MAX_SYMBOLS)
+        {
+            batch = _realtime_batch;
+            _realtime_batch = nullptr;
+        }
+        else if (!_realtime_batch_scheduled)
+        {
+            _realtime_batch_scheduled = schedule = true;
+        }
+    }
+
+    if (batch)
+        stock_fetch_real_time_batch(batch);
+
+    // Let other requests join the batch.
+    if (schedule)
+        dispatch([]() { stock_flush_real_time_requests(); }, STOCK_REALTIME_BATCH_WINDOW_MS);
+}
+
 FOUNDATION_STATIC void stock_read_fundamentals_results(const json_object_t& json, uint64_t index)
 {	        
-    SHARED_READ_LOCK(_db_lock);
-    stock_t& entry = _db_stocks[index];
+    stock_t& entry = *stock_entry(index);
 
     if (!json.resolved())
     {
@@ -356,8 +612,7 @@ FOUNDATION_STATIC void stock_read_fundamentals_results(const json_object_t& json
 
 FOUNDATION_STATIC void stock_read_technical_results(const json_object_t& json, stock_index_t index, FetchLevel level, const technical_descriptor_t& desc)
 {
-    SHARED_READ_LOCK(_db_lock);
-    stock_t* s = &_db_stocks[index];
+    stock_t* s = stock_entry(index);
 
     if (!json.resolved())
     {
@@ -367,6 +622,7 @@ FOUNDATION_STATIC void stock_read_technical_results(const json_object_t& json, s
         return s->mark_resolved(level, true);
     }
     
+    EPOCH_SCOPE();
     day_result_t* history = s->history;
     unsigned h = 0, h_end = array_size(history);
     for (size_t i = 0; i < json.root->value_length; ++i)
@@ -406,7 +662,7 @@ FOUNDATION_STATIC void stock_fetch_technical_results(
     const char* ticker, stock_index_t index, const char* fn_name, 
     const technical_descriptor_t& desc)
 {
-    stock_t* entry = &_db_stocks[index];
+    stock_t* entry = stock_entry(index);
 
     if ((fetch_levels & access_level) && ((entry->fetch_level | entry->resolved_level) & access_level) == 0)
     {
@@ -466,8 +722,7 @@ FOUNDATION_STATIC void stock_fetch_technical_results(
 
 FOUNDATION_STATIC bool stock_read_eod_intraday_results(stock_index_t index, day_result_t*& history)
 {
-    SHARED_READ_LOCK(_db_lock);
-    stock_t& entry = _db_stocks[index];
+    stock_t& entry = *stock_entry(index);
 
     string_t code = string_table_decode(SHARED_BUFFER(16), entry.code);
     time_t first_intraday_date = time_add_days(history[0].date, -5);
@@ -521,7 +776,353 @@ FOUNDATION_STATIC bool stock_read_eod_intraday_results(stock_index_t index, day_
     }, 60 * 60 * 12ULL);
 }
 
-FOUNDATION_STATIC void stock_read_eod_results(const json_object_t& json, stock_index_t index)
+/*! Returns the path of the local EOD history file of a symbol. */
+FOUNDATION_EXTERN string_t stock_eod_history_path(char* buffer, size_t capacity, const char* symbol, size_t symbol_length)
+{
+    string_const_t dir = session_get_user_dir(STRING_CONST("eod"));
+    if (!fs_is_directory(STRING_ARGS(dir)))
+        fs_make_directory(STRING_ARGS(dir));
+
+    string_t path = string_copy(buffer, capacity, STRING_ARGS(dir));
+    path = path_append(STRING_ARGS(path), capacity, symbol, symbol_length);
+    return string_append(STRING_ARGS(path), capacity, STRING_CONST(".history"));
+}
+
+/*! Parse daily bars from an EOD response.
+ *
+ *  @return Bars sorted by date, the last bar of a duplicated day is kept.
+ */
+FOUNDATION_EXTERN stock_eod_bar_t* stock_eod_bars_parse(const json_object_t& json)
+{
+    if (json.root == nullptr || json.root->type != JSON_ARRAY)
+        return nullptr;
+
+    stock_eod_bar_t* bars = nullptr;
+    array_reserve(bars, json.root->value_length);
+    for (auto jday : json)
+    {
+        string_const_t date_str = jday["date"].as_string();
+
+        stock_eod_bar_t bar;
+        bar.date = string_to_date(STRING_ARGS(date_str));
+        if (bar.date <= 0)
+            continue;
+        bar.open = jday["open"].as_number();
+        bar.high = jday["high"].as_number();
+        bar.low = jday["low"].as_number();
+        bar.close = jday["close"].as_number();
+        bar.adjusted_close = jday["adjusted_close"].as_number();
+        bar.volume = jday["volume"].as_number();
+
+        int idx = array_binary_search(bars, array_size(bars), bar.date);
+        if (idx >= 0)
+        {
+            bars[idx] = bar;
+            continue;
+        }
+
+        idx = ~idx;
+        array_insert_memcpy(bars, idx, &bar);
+    }
+
+    return bars;
+}
+
+/*! Merge newly fetched bars into the stored ones.
+ *
+ *  @param out_changed Set to true if any stored bar was added or updated.
+ *
+ *  @return False if an overlapping day has a different adjustment factor, meaning that a split or a
+ *          dividend adjusted the whole series and it needs to be fetched again.
+ */
+FOUNDATION_EXTERN bool stock_eod_bars_merge(stock_eod_bar_t*& bars, const stock_eod_bar_t* delta, bool* out_changed)
+{
+    bool changed = false;
+    foreach(bar, delta)
+    {
+        int idx = array_binary_search(bars, array_size(bars), bar->date);
+        if (idx >= 0)
+        {
+            const stock_eod_bar_t& stored = bars[idx];
+            const double stored_factor = stored.adjusted_close / stored.close;
+            const double factor = bar->adjusted_close / bar->close;
+            if (math_real_is_finite(stored_factor) && math_real_is_finite(factor) && math_abs(stored_factor - factor) > 1e-6)
+                return false;
+
+            changed |= memcmp(&stored, bar, sizeof(stock_eod_bar_t)) != 0;
+            bars[idx] = *bar;
+            continue;
+        }
+
+        idx = ~idx;
+        array_insert_memcpy(bars, idx, bar);
+        changed = true;
+    }
+
+    if (out_changed)
+        *out_changed = changed;
+    return true;
+}
+
+FOUNDATION_STATIC const stock_eod_history_header_t* stock_eod_history_validate(const void* data, size_t size, const char* path, size_t path_length)
+{
+    const stock_eod_history_header_t* header = (const stock_eod_history_header_t*)data;
+    if (size < sizeof(stock_eod_history_header_t) ||
+        !string_equal(header->magic, sizeof(header->magic), STRING_CONST("EODH")) ||
+        header->version != STOCK_EOD_HISTORY_VERSION ||
+        header->day_size != sizeof(day_result_t) || header->count == 0 ||
+        (size - sizeof(stock_eod_history_header_t)) / sizeof(day_result_t) != header->count ||
+        header->array[0] != header->count || header->array[1] != header->count)
+    {
+        log_warnf(HASH_STOCK, WARNING_INVALID_VALUE, STRING_CONST("Invalid EOD history file %.*s"), (int)path_length, path);
+        return nullptr;
+    }
+
+    return header;
+}
+
+/*! Map a local EOD history file so that its days can be used as a stock history.
+ *  Pages are only read once accessed and the days can be updated in memory (i.e. technical indicators)
+ *  without changing the file.
+ *
+ *  @remark Only the header is validated, the checksum is verified when the history gets updated.
+ *
+ *  @return The mapped days as a read-only sized array or null if the file is missing or invalid.
+ */
+FOUNDATION_EXTERN day_result_t* stock_eod_history_map(const char* path, size_t path_length, stock_history_map_t** out_map)
+{
+    size_t size = 0;
+    const void* data = system_map_file(path, path_length, &size, true);
+    if (data == nullptr)
+        return nullptr;
+
+    if (stock_eod_history_validate(data, size, path, path_length) == nullptr)
+    {
+        system_unmap_file(data, size);
+        return nullptr;
+    }
+
+    stock_history_map_t* map = MEM_NEW(HASH_STOCK, stock_history_map_t);
+    map->data = data;
+    map->size = size;
+    *out_map = map;
+    return (day_result_t*)((uint8_t*)data + sizeof(stock_eod_history_header_t));
+}
+
+/*! Load the daily bars of a local EOD history file.
+ *
+ *  @return Bars sorted by date or null if the file is missing, invalid or corrupted.
+ */
+FOUNDATION_EXTERN stock_eod_bar_t* stock_eod_history_load(const char* path, size_t path_length)
+{
+    size_t size = 0;
+    const void* data = system_map_file(path, path_length, &size);
+    if (data == nullptr)
+        return nullptr;
+
+    stock_eod_bar_t* bars = nullptr;
+    const stock_eod_history_header_t* header = stock_eod_history_validate(data, size, path, path_length);
+    if (header)
+    {
+        const day_result_t* days = (const day_result_t*)(header + 1);
+        if (hash(days, sizeof(day_result_t) * header->count) == header->checksum)
+        {
+            array_reserve(bars, header->count);
+            for (int i = (int)header->count - 1; i >= 0; --i)
+            {
+                const day_result_t& d = days[i];
+                stock_eod_bar_t bar{ d.date, d.open, d.high, d.low, d.close, d.adjusted_close, d.volume };
+                array_push_memcpy(bars, &bar);
+            }
+        }
+        else
+        {
+            log_warnf(HASH_STOCK, WARNING_INVALID_VALUE, STRING_CONST("Corrupted EOD history file %.*s"), (int)path_length, path);
+        }
+    }
+
+    system_unmap_file(data, size);
+    return bars;
+}
+
+FOUNDATION_STATIC string_t stock_eod_history_temp_path(char* buffer, size_t capacity, const char* path, size_t path_length)
+{
+    string_t temp_path = string_copy(buffer, capacity, path, path_length);
+    return string_append(STRING_ARGS(temp_path), capacity, STRING_CONST(".tmp"));
+}
+
+/*! Write the history of a stock to the temporary file of a local EOD history file, see #stock_eod_history_commit. */
+FOUNDATION_STATIC bool stock_eod_history_write(const char* path, size_t path_length, const day_result_t* history)
+{
+    stock_eod_history_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "EODH", sizeof(header.magic));
+    header.version = STOCK_EOD_HISTORY_VERSION;
+    header.count = array_size(history);
+    header.day_size = sizeof(day_result_t);
+    header.checksum = hash(history, sizeof(day_result_t) * header.count);
+
+    // Copy the header of the array being saved so that the mapped days pass array validation.
+    memcpy(header.array, (const uint32_t*)history - 4, sizeof(header.array));
+    header.array[0] = header.array[1] = header.count;
+
+    // Write to a temporary file first so readers never see a partial history.
+    char temp_path_buffer[BUILD_MAX_PATHLEN];
+    string_t temp_path = stock_eod_history_temp_path(STRING_BUFFER(temp_path_buffer), path, path_length);
+
+    bool success = false;
+    stream_t* stream = fs_open_file(STRING_ARGS(temp_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+    if (stream)
+    {
+        success = stream_write(stream, &header, sizeof(header)) == sizeof(header);
+        success &= stream_write(stream, history, sizeof(day_result_t) * header.count) == sizeof(day_result_t) * header.count;
+        stream_deallocate(stream);
+    }
+
+    return success;
+}
+
+/*! Replace a local EOD history file with the temporary file written by #stock_eod_history_write.
+ *
+ *  @remark The history file must not be mapped anymore, otherwise it cannot be replaced on Windows.
+ */
+FOUNDATION_STATIC bool stock_eod_history_commit(const char* path, size_t path_length, bool written)
+{
+    char temp_path_buffer[BUILD_MAX_PATHLEN];
+    string_t temp_path = stock_eod_history_temp_path(STRING_BUFFER(temp_path_buffer), path, path_length);
+
+    if (!written || !system_replace_file(STRING_ARGS(temp_path), path, path_length))
+    {
+        log_errorf(HASH_STOCK, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to write EOD history %.*s"), (int)path_length, path);
+        fs_remove_file(STRING_ARGS(temp_path));
+        return false;
+    }
+
+    return true;
+}
+
+/*! Write the history of a stock to a local EOD history file. */
+FOUNDATION_EXTERN bool stock_eod_history_save(const char* path, size_t path_length, const day_result_t* history)
+{
+    return stock_eod_history_commit(path, path_length, stock_eod_history_write(path, path_length, history));
+}
+
+/*! Build the stock history from daily bars, skipping days with invalid data.
+ *
+ *  @return History sorted from the most recent day to the oldest one.
+ */
+FOUNDATION_EXTERN day_result_t* stock_eod_history_build(string_const_t code, bool is_index, const stock_eod_bar_t* bars, double& first_price_factor)
+{
+    day_result_t* history = nullptr;
+    array_reserve(history, array_size(bars) + 1);
+
+    double next_close = DNAN;
+    for (int b = (int)array_size(bars) - 1, i = 0; b >= 0; --b, ++i)
+    {
+        const stock_eod_bar_t& bar = bars[b];
+        if (!is_index && bar.volume < 1.0 && i >= 7)
+            continue;
+
+        day_result_t d{};
+
+        d.date = bar.date;
+        d.gmtoffset = 0;
+
+        d.volume = bar.volume;
+        d.open = bar.open;
+        d.close = bar.close;
+        d.low = bar.low;
+        d.high = bar.high;
+        d.adjusted_close = bar.adjusted_close;
+
+        // Skip days with ridiculous prices (probably an error on the server provider)
+        const double diff = i == 0 ? 1.0 : math_abs(
+            max(math_change_p(d.adjusted_close, next_close, DNAN),
+                math_change_p(next_close, d.adjusted_close, DNAN)));
+        if (diff < 8.0/* && d.adjusted_close < 999998.99*/)
+        {
+            d.price_factor = d.adjusted_close / d.close;
+            if (math_real_is_nan(first_price_factor) && !math_real_is_nan(d.price_factor))
+                first_price_factor = d.price_factor;            
+        
+            d.change = d.close - d.open;
+            d.change_p = d.change * 100.0 / d.open;
+            d.change_p_high = (max(d.close, d.high) - min(d.open, d.low)) * 100.0 / math_ifnan(d.previous_close, d.close);
+            
+            d.previous_close = b > 0 ? bars[b - 1].adjusted_close : DNAN;
+        
+            next_close = d.adjusted_close;
+            array_push_memcpy(history, &d);
+        }
+        else
+        {
+            log_debugf(HASH_STOCK, 
+                STRING_CONST("Skipping %.*s EOD %.*s with close price %lf>%lf"), 
+                STRING_FORMAT(code), STRING_FORMAT(string_from_date(d.date)), d.adjusted_close, next_close);
+        }
+    }
+
+    return history;
+}
+
+FOUNDATION_STATIC void stock_eod_history_publish(
+    stock_index_t index, day_result_t* history, stock_history_map_t* map, double first_price_factor, 
+    stock_history_map_t** out_previous_map = nullptr)
+{
+    stock_t& entry = *stock_entry(index);
+    stock_history_replace(&entry, history, map, out_previous_map);
+
+    if (math_real_is_nan(entry.current.price_factor) && !math_real_is_nan(first_price_factor))
+        entry.current.price_factor = first_price_factor;
+
+    entry.mark_resolved(FetchLevel::EOD);
+
+    // Check if we need to fetch any awaiting technical results 
+    // since now we have EOD stock data
+    const fetch_level_t cfetch_level = entry.fetch_level & TECHINICAL_CHARTS;
+    if (cfetch_level != 0)
+    {
+        // Remove technical fetch levels so we make sure the request is not
+        // reissued if the stock is already resolved
+        entry.fetch_level &= ~TECHINICAL_CHARTS;
+
+        string_table_symbol_t ccode = entry.code;
+        dispatch([ccode, cfetch_level]()
+        {
+            string_const_t symbol = SYMBOL_CONST(ccode);
+            stock_request(STRING_ARGS(symbol), cfetch_level);
+        });
+    }
+}
+
+/*! Background write of a local EOD history file.
+ *  The history is written to a temporary file by a job, but the file can only be replaced once the
+ *  previous history mapping it is released, so whoever of the job or the epoch releasing the
+ *  previous history finishes last replaces the file.
+ */
+struct stock_eod_history_write_t
+{
+    string_t             path{};
+    day_result_t*        history{ nullptr };
+    stock_history_map_t* previous_map{ nullptr };
+    atomic32_t           refs{ 1 };
+    bool                 written{ false };
+};
+
+FOUNDATION_STATIC void stock_eod_history_write_release(stock_eod_history_write_t* write)
+{
+    if (atomic_decr32(&write->refs, memory_order_acq_rel) > 0)
+        return;
+
+    stock_eod_history_commit(STRING_ARGS(write->path), write->written);
+
+    string_deallocate(write->path.str);
+    array_deallocate(write->history);
+    MEM_DELETE(write);
+}
+
+/*! Rebuild the stock history from daily bars and save it in the background for the next sessions. */
+FOUNDATION_STATIC void stock_eod_history_update(stock_index_t index, const stock_eod_bar_t* bars)
 {
     MEMORY_TRACKER(HASH_STOCK);
 
@@ -529,124 +1130,144 @@ FOUNDATION_STATIC void stock_read_eod_results(const json_object_t& json, stock_i
     bool is_index = false;
     char code_buffer[16];
     {
-        SHARED_READ_LOCK(_db_lock);
-        stock_t& entry = _db_stocks[index];
+        stock_t& entry = *stock_entry(index);
         code = string_table_decode(STRING_BUFFER(code_buffer), entry.code);
         is_index = string_ends_with(code.str, code.length, STRING_CONST("INDX"));
     }
 
-    if (!json.resolved())
+    double first_price_factor = DNAN;
+    day_result_t* history = stock_eod_history_build(string_to_const(code), is_index, bars, first_price_factor);
+
+    // Read intraday data from the last few days
+    //stock_read_eod_intraday_results(index, history);
+
+    if (array_size(history) == 0)
+        return stock_eod_history_publish(index, history, nullptr, first_price_factor);
+
+    // The stock history gets updated with technical indicators, so save a copy of it.
+    char history_path_buffer[BUILD_MAX_PATHLEN];
+    string_t history_path = stock_eod_history_path(STRING_BUFFER(history_path_buffer), STRING_ARGS(code));
+    stock_eod_history_write_t* write = MEM_NEW(HASH_STOCK, stock_eod_history_write_t);
+    write->path = string_clone(STRING_ARGS(history_path));
+    array_copy(write->history, history);
+
+    stock_eod_history_publish(index, history, nullptr, first_price_factor, &write->previous_map);
+
+    // Unmap the previous history file before replacing it.
+    if (write->previous_map)
     {
-        SHARED_READ_LOCK(_db_lock);
-        stock_t& entry = _db_stocks[index];
+        atomic_incr32(&write->refs, memory_order_relaxed);
+        epoch_retire(write, [](void* ptr)
+        {
+            stock_eod_history_write_t* write = (stock_eod_history_write_t*)ptr;
+            stock_history_map_deallocate(write->previous_map);
+            write->previous_map = nullptr;
+            stock_eod_history_write_release(write);
+        });
+    }
+
+    job_execute([](payload_t* payload)
+    {
+        stock_eod_history_write_t* write = (stock_eod_history_write_t*)payload;
+        write->written = stock_eod_history_write(STRING_ARGS(write->path), write->history);
+        stock_eod_history_write_release(write);
+        return 0;
+    }, write, JOB_DEALLOCATE_AFTER_EXECUTION);
+}
+
+FOUNDATION_STATIC void stock_read_eod_results(const json_object_t& json, stock_index_t index)
+{
+    char code_buffer[16];
+    string_t code = string_table_decode(STRING_BUFFER(code_buffer), stock_entry(index)->code);
+
+    stock_eod_bar_t* bars = json.resolved() ? stock_eod_bars_parse(json) : nullptr;
+    if (bars == nullptr)
+    {
+        stock_t& entry = *stock_entry(index);
         log_warnf(HASH_STOCK, WARNING_INVALID_VALUE, STRING_CONST("Stock '%.*s' has no EOD data"), STRING_FORMAT(code));
         entry.fetch_errors++;
         return entry.mark_resolved(FetchLevel::EOD, true);
     }
 
-    day_result_t* history = nullptr;
-    array_reserve(history, json.root->value_length + 1);
+    stock_eod_history_update(index, bars);
+    array_deallocate(bars);
+}
 
-    bool logged_skip_eod_data = false;
-    double first_price_factor = DNAN;
-    const int element_count = json.root->value_length;
-    const json_token_t* e = &json.tokens[json.root->child];
-    double next_close = DNAN;
-    for (int i = 0; i < element_count; ++i)
+FOUNDATION_STATIC void stock_fetch_eod_full_history(stock_index_t index, const char* ticker, uint64_t invalid_cache_query_after_seconds)
+{
+    if (!eod_fetch_async("eod", ticker, FORMAT_JSON_WITH_ERROR, 
+        "order", "d", LC1(stock_read_eod_results(_1, index)), invalid_cache_query_after_seconds))
     {
-        json_object_t jday(json, e);
-        string_const_t date_str = jday["date"].as_string();
-        const double volume = jday["volume"].as_number();
-        if (is_index || volume >= 1.0 || i < 7)
-        {
-            day_result_t d{};
+        stock_t* entry = stock_entry(index);
+        entry->fetch_errors++;
+        entry->mark_resolved(FetchLevel::EOD, true);
+    }
+}
 
-            d.date = string_to_date(STRING_ARGS(date_str));
-            d.gmtoffset = 0;
-
-            d.volume = volume;
-            d.open = jday["open"].as_number();
-            d.close = jday["close"].as_number();
-            d.low = jday["low"].as_number();
-            d.high = jday["high"].as_number();
-            d.adjusted_close = jday["adjusted_close"].as_number();
-
-            // Skip days with ridiculous prices (probably an error on the server provider)
-            const double diff = i == 0 ? 1.0 : math_abs(
-                max(math_change_p(d.adjusted_close, next_close, DNAN),
-                    math_change_p(next_close, d.adjusted_close, DNAN)));
-            if (diff < 8.0/* && d.adjusted_close < 999998.99*/)
-            {
-                d.price_factor = d.adjusted_close / d.close;
-                if (math_real_is_nan(first_price_factor) && !math_real_is_nan(d.price_factor))
-                    first_price_factor = d.price_factor;            
-            
-                d.change = d.close - d.open;
-                d.change_p = d.change * 100.0 / d.open;
-                d.change_p_high = (max(d.close, d.high) - min(d.open, d.low)) * 100.0 / math_ifnan(d.previous_close, d.close);
-                
-                d.previous_close = NAN;
-                if (e->sibling != 0)
-                {
-                    json_object_t yday(json, &json.tokens[e->sibling]);
-                    d.previous_close = yday["adjusted_close"].as_number();
-                }
-            
-                next_close = d.adjusted_close;
-                array_push_memcpy(history, &d);
-            }
-            else
-            {
-                log_debugf(HASH_STOCK, 
-                    STRING_CONST("Skipping %.*s EOD %.*s with close price %lf>%lf"), 
-                    STRING_FORMAT(code), STRING_FORMAT(date_str), d.adjusted_close, next_close);
-            }
-        }
-        else if (!logged_skip_eod_data)
-        {
-            log_debugf(HASH_STOCK, STRING_CONST("Skipping EOD result for %.*s on %.*s using %.*s"), 
-                STRING_FORMAT(code), STRING_FORMAT(date_str), STRING_FORMAT(json.query));
-            logged_skip_eod_data = true;
-        }
+FOUNDATION_STATIC void stock_read_eod_delta_results(const json_object_t& json, stock_index_t index)
+{
+    char code_buffer[16];
+    string_t code = string_table_decode(STRING_BUFFER(code_buffer), stock_entry(index)->code);
 
-        if (e->sibling == 0)
-            break;
-        e = &json.tokens[e->sibling];
-    }
+    char history_path_buffer[BUILD_MAX_PATHLEN];
+    string_t history_path = stock_eod_history_path(STRING_BUFFER(history_path_buffer), STRING_ARGS(code));
+    stock_eod_bar_t* bars = stock_eod_history_load(STRING_ARGS(history_path));
+    if (bars == nullptr)
+        return stock_fetch_eod_full_history(index, code.str, 0);
 
-    // Read intraday data from the last few days
-    //stock_read_eod_intraday_results(index, history);
+    if (!json.resolved())
+    {
+        // Keep using the stored history until we can get new bars.
+        log_warnf(HASH_STOCK, WARNING_RESOURCE, STRING_CONST("Failed to update '%.*s' EOD data, using local history"), STRING_FORMAT(code));
+        array_deallocate(bars);
+        return;
+    }
 
+    bool changed = false;
+    stock_eod_bar_t* delta = stock_eod_bars_parse(json);
+    if (!stock_eod_bars_merge(bars, delta, &changed))
     {
-        SHARED_READ_LOCK(_db_lock);
-        stock_t& entry = _db_stocks[index];
-        if (entry.history != nullptr)
-            array_push(_trashed_history, entry.history);
-        entry.history = history;
-        entry.history_count = array_size(history);
+        log_infof(HASH_STOCK, STRING_CONST("Stock '%.*s' EOD data was adjusted, fetching full history"), STRING_FORMAT(code));
+        stock_fetch_eod_full_history(index, code.str, 0);
+    }
+    else if (changed)
+    {
+        stock_eod_history_update(index, bars);
+    }
+
+    array_deallocate(delta);
+    array_deallocate(bars);
+}
 
-        if (math_real_is_nan(entry.current.price_factor) && !math_real_is_nan(first_price_factor))
-            entry.current.price_factor = first_price_factor;
+/*! Fetch the EOD history of a stock.
+ *  A history stored locally is mapped and used right away, then only the days since the last stored one are fetched.
+ */
+FOUNDATION_STATIC bool stock_fetch_eod_history(stock_index_t index, const char* ticker)
+{
+    char history_path_buffer[BUILD_MAX_PATHLEN];
+    string_t history_path = stock_eod_history_path(STRING_BUFFER(history_path_buffer), ticker, string_length(ticker));
+    
+    stock_history_map_t* map = nullptr;
+    day_result_t* days = stock_eod_history_map(STRING_ARGS(history_path), &map);
+    if (days == nullptr)
+    {
+        return eod_fetch_async("eod", ticker, FORMAT_JSON_WITH_ERROR, 
+            "order", "d", LC1(stock_read_eod_results(_1, index)), 12ULL * 3600ULL);
+    }
 
-        entry.mark_resolved(FetchLevel::EOD);
+    // Most recent days come first, so only a few pages get read.
+    double first_price_factor = DNAN;
+    for (unsigned i = 0, end = min(array_size(days), 7U); i < end && math_real_is_nan(first_price_factor); ++i)
+        first_price_factor = days[i].price_factor;
 
-        // Check if we need to fetch any awaiting technical results 
-        // since now we have EOD stock data
-        const fetch_level_t cfetch_level = entry.fetch_level & TECHINICAL_CHARTS;
-        if (cfetch_level != 0)
-        {
-            // Remove technical fetch levels so we make sure the request is not
-            // reissued if the stock is already resolved
-            entry.fetch_level &= ~TECHINICAL_CHARTS;
+    // Include the last stored day to detect if the series was adjusted since then.
+    char from_date_buffer[16];
+    string_t from_date = string_from_date(STRING_BUFFER(from_date_buffer), days[0].date);
+    stock_eod_history_publish(index, days, map, first_price_factor);
 
-            string_table_symbol_t ccode = entry.code;
-            dispatch([ccode, cfetch_level]()
-            {
-                string_const_t symbol = SYMBOL_CONST(ccode);
-                stock_request(STRING_ARGS(symbol), cfetch_level);
-            });
-        }
-    }
+    eod_fetch_async("eod", ticker, FORMAT_JSON_WITH_ERROR, 
+        "order", "d", "from", from_date.str, LC1(stock_read_eod_delta_results(_1, index)), 12ULL * 3600ULL);
+    return true;
 }
 
 FOUNDATION_STATIC void stock_load_invalid_symbols(stock_invalid_symbol_db_t* db)
@@ -703,6 +1324,8 @@ stock_handle_t stock_resolve(const char* _symbol, size_t symbol_length, fetch_le
         return {};
 
     // Wait for handle to resolve
+    if (any(fetch_levels, FetchLevel::REALTIME))
+        stock_flush_real_time_requests();
     tick_t timeout_ticks = time_current();
     while (!stock->has_resolve(fetch_levels) )
     {
@@ -734,80 +1357,90 @@ status_t stock_resolve(stock_handle_t& handle, fetch_level_t fetch_levels)
         return STATUS_ERROR_INVALID_HANDLE;
 
     // Check if we have a slot index for that stock
-    if (!_db_lock.shared_lock())
-        return STATUS_ERROR_DB_ACCESS;
-
+    EPOCH_SCOPE();
     stock_t* entry = nullptr;
-    stock_index_t index = hashtable64_get(_db_hashes, handle.id);
-    if (index != 0)
+    stock_index_t index = hashtable64_get(stock_hashes(), handle.id);
+    if (index != 0 && (entry = stock_entry(index)) != nullptr)
     {
-        FOUNDATION_ASSERT(index > 0 && index < array_size(_db_stocks));
-
-        handle.ptr = entry = &_db_stocks[index];
-        FOUNDATION_ASSERT(entry);
+        handle.ptr = entry;
         FOUNDATION_ASSERT(entry->id == handle.id);
 
         if (((entry->fetch_level | entry->resolved_level) & fetch_levels) == fetch_levels)
-        {
-            _db_lock.shared_unlock();
             return STATUS_OK;
-        }
 
         if (entry->fetch_errors >= 20)
         {
             if (entry->fetch_errors == 20)
                 log_errorf(HASH_STOCK, ERROR_EXCEPTION, STRING_CONST("Too many fetch failures %s"), string_table_decode(entry->code));
-            _db_lock.shared_unlock();
             return STATUS_ERROR_INVALID_REQUEST;
         }
-        _db_lock.shared_unlock();
     }
-    else if (_db_lock.shared_unlock() && index == 0 && _db_lock.exclusive_lock())
+    else
     {
-        // Create stock slot and trigger async resolution.
-        if (array_size(_db_stocks) >= _db_capacity)
-        {
-            for (size_t i = 0; i < array_size(_trashed_history); ++i)
-                array_deallocate(_trashed_history[i]);
-            array_clear(_trashed_history);
-
-            stock_grow_db();
-        }
+        // The stock is either unknown or being created by another thread.
+        SHARED_WRITE_LOCK(_db_lock);
 
-        // Create slot
-        _db_stocks = array_push(_db_stocks, stock_t{});
-        index = array_size(_db_stocks) - 1;
-        FOUNDATION_ASSERT(index > 0);
-
-        handle.ptr = entry = &_db_stocks[index];
-        FOUNDATION_ASSERT(entry);
-
-        // Initialize stock entries
-        entry->id = handle.id;
-        entry->code = handle.code;
-        entry->earning_trend_actual.reset(LR1(stock_fetch_earnings_trend(index, "actual", _1)));
-        entry->earning_trend_estimate.reset(LR1(stock_fetch_earnings_trend(index, "estimate", _1)));
-        entry->earning_trend_difference.reset(LR1(stock_fetch_earnings_trend(index, "difference", _1)));
-        entry->earning_trend_percent.reset(LR1(stock_fetch_earnings_trend(index, "percent", _1)));
-        entry->description.reset(LR1(stock_fetch_description(index, _1)));
-        entry->short_name.reset(LR1(stock_fetch_short_name(index, _1)));
-
-        FOUNDATION_ASSERT(handle.id != 0);
-        if (!hashtable64_set(_db_hashes, handle.id, index))
+        // Another thread might have created the stock while we were waiting for the lock.
+        index = hashtable64_get(stock_hashes(), handle.id);
+        if (index != 0)
         {
-            _db_lock.exclusive_unlock();
-            return STATUS_ERROR_HASH_TABLE_NOT_LARGE_ENOUGH;
+            handle.ptr = entry = stock_entry(index);
+            FOUNDATION_ASSERT(entry && entry->id == handle.id);
         }
+        else
+        {
+            // Create stock slot and trigger async resolution.
+            index = atomic_load32(&_db_count, memory_order_relaxed);
+            if (index >= STOCK_CHUNK_SIZE * STOCK_MAX_CHUNKS)
+            {
+                log_errorf(HASH_STOCK, ERROR_OUT_OF_MEMORY, STRING_CONST("Too many stocks, cannot create %s"), string_table_decode(handle.code));
+                return STATUS_ERROR_DB_ACCESS;
+            }
+
+            if (index >= _db_capacity)
+                stock_grow_db();
+
+            stock_t* chunk = (stock_t*)atomic_load_ptr(&_db_chunks[index / STOCK_CHUNK_SIZE], memory_order_relaxed);
+            if (chunk == nullptr)
+            {
+                chunk = (stock_t*)memory_allocate(HASH_STOCK, sizeof(stock_t) * STOCK_CHUNK_SIZE, alignof(stock_t), MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+                atomic_store_ptr(&_db_chunks[index / STOCK_CHUNK_SIZE], chunk, memory_order_release);
+            }
+
+            // Create slot
+            entry = new (&chunk[index % STOCK_CHUNK_SIZE]) stock_t{};
+            FOUNDATION_ASSERT(index > 0);
+
+            // Initialize stock entries
+            entry->id = handle.id;
+            entry->code = handle.code;
+            entry->earning_trend_actual.reset(LR1(stock_fetch_earnings_trend(index, "actual", _1)));
+            entry->earning_trend_estimate.reset(LR1(stock_fetch_earnings_trend(index, "estimate", _1)));
+            entry->earning_trend_difference.reset(LR1(stock_fetch_earnings_trend(index, "difference", _1)));
+            entry->earning_trend_percent.reset(LR1(stock_fetch_earnings_trend(index, "percent", _1)));
+            entry->description.reset(LR1(stock_fetch_description(index, _1)));
+            entry->short_name.reset(LR1(stock_fetch_short_name(index, _1)));
+
+            // Initialize a minimal set of data, the rest will be initialized asynchronously.
+            entry->last_update_time = time_current();
+            entry->fetch_level = FetchLevel::NONE;
+            entry->resolved_level = FetchLevel::NONE;
+
+            FOUNDATION_ASSERT(handle.id != 0);
+            if (!hashtable64_set(stock_hashes(), handle.id, index))
+            {
+                entry->~stock_t();
+                return STATUS_ERROR_HASH_TABLE_NOT_LARGE_ENOUGH;
+            }
 
-        // Initialize a minimal set of data, the rest will be initialized asynchronously.
-        entry->last_update_time = time_current();
-        entry->fetch_level = FetchLevel::NONE;
-        entry->resolved_level = FetchLevel::NONE;
+            // Publish the slot once it is indexed and fully initialized. Readers finding the index 
+            // before the slot is published see no stock and wait for the creation lock.
+            atomic_store32(&_db_count, (int32_t)(index + 1), memory_order_release);
 
-        _db_lock.exclusive_unlock();
+            handle.ptr = entry;
+        }
     }
     
-    SHARED_READ_LOCK(_db_lock);
     // Fetch stock data
     char ticker[64] { 0 };
     string_const_t code_string = string_table_decode_const(handle.code);
@@ -816,17 +1449,10 @@ status_t stock_resolve(stock_handle_t& handle, fetch_level_t fetch_levels)
     status_t status = STATUS_OK;
     if ((fetch_levels & FetchLevel::REALTIME) && ((entry->fetch_level | entry->resolved_level) & FetchLevel::REALTIME) == 0)
     {
-        if (eod_fetch_async("real-time", ticker, FORMAT_JSON, 
-            LC1(stock_read_real_time_results(_1, index)), 0))
-        {
-            entry->mark_fetched(FetchLevel::REALTIME);
-            status = STATUS_RESOLVING;
-        }
-        else
-        {
-            entry->fetch_errors++;
-            log_warnf(HASH_STOCK, WARNING_RESOURCE, STRING_CONST("[%u] Failed to fetch real-time results for %s"), entry->fetch_errors, ticker);
-        }
+        // Real-time data is fetched for many stocks at once, see #stock_request_real_time.
+        entry->mark_fetched(FetchLevel::REALTIME);
+        stock_request_real_time(index);
+        status = STATUS_RESOLVING;
     }
         
     if ((fetch_levels & FetchLevel::FUNDAMENTALS) && ((entry->fetch_level | entry->resolved_level) & FetchLevel::FUNDAMENTALS) == 0)
@@ -845,8 +1471,7 @@ status_t stock_resolve(stock_handle_t& handle, fetch_level_t fetch_levels)
 
     if ((fetch_levels & FetchLevel::EOD) && ((entry->fetch_level | entry->resolved_level) & FetchLevel::EOD) == 0)
     {
-        if (eod_fetch_async("eod", ticker, FORMAT_JSON_WITH_ERROR, 
-            "order", "d", LC1(stock_read_eod_results(_1, index)), 12ULL * 3600ULL))
+        if (stock_fetch_eod_history(index, ticker))
         {
             entry->mark_fetched(FetchLevel::EOD);
             status = STATUS_RESOLVING;
@@ -873,33 +1498,177 @@ status_t stock_resolve(stock_handle_t& handle, fetch_level_t fetch_levels)
     return status;
 }
 
+void stock_on_resolved(const stock_t* stock, fetch_level_t fetch_levels, stock_resolved_callback_t callback, void* context)
+{
+    FOUNDATION_ASSERT(stock && callback);
+
+    {
+        SHARED_WRITE_LOCK(_resolved_waiters_lock);
+
+        // Publish the waiter before checking the stock, see #stock_notify_resolved.
+        atomic_incr32(&_resolved_waiter_count, memory_order_seq_cst);
+        atomic_thread_fence_sequentially_consistent();
+        if (!stock->has_resolve(fetch_levels))
+        {
+            stock_resolved_waiter_t waiter{ stock, fetch_levels, callback, context };
+            array_push_memcpy(_resolved_waiters, &waiter);
+            return;
+        }
+        atomic_decr32(&_resolved_waiter_count, memory_order_relaxed);
+    }
+
+    callback(stock, context);
+}
+
+void stock_cancel_on_resolved(stock_resolved_callback_t callback, void* context)
+{
+    SHARED_WRITE_LOCK(_resolved_waiters_lock);
+    for (unsigned i = 0; i < array_size(_resolved_waiters);)
+    {
+        const stock_resolved_waiter_t& waiter = _resolved_waiters[i];
+        if (waiter.callback != callback || waiter.context != context)
+        {
+            ++i;
+            continue;
+        }
+
+        array_erase_memcpy(_resolved_waiters, i);
+        atomic_decr32(&_resolved_waiter_count, memory_order_relaxed);
+    }
+}
+
+void stock_flush_real_time_requests()
+{
+    stock_index_t* batch = nullptr;
+    {
+        SHARED_WRITE_LOCK(_realtime_batch_lock);
+        batch = _realtime_batch;
+        _realtime_batch = nullptr;
+        _realtime_batch_scheduled = false;
+    }
+
+    stock_fetch_real_time_batch(batch);
+}
+
+bool stock_wait_resolved(const stock_t* stock, fetch_level_t fetch_levels, unsigned timeout_ms /*= UINT32_MAX*/)
+{
+    if (stock == nullptr)
+        return false;
+
+    if (stock->has_resolve(fetch_levels))
+        return true;
+
+    FOUNDATION_ASSERT_MSG(!thread_is_main(), "Waiting for stocks would block the main thread");
+
+    // Do not wait for the real-time batch window to end, the main thread might be busy.
+    if (any(fetch_levels, FetchLevel::REALTIME))
+        stock_flush_real_time_requests();
+
+    event_handle resolved;
+    const stock_resolved_callback_t signal_resolved = [](const stock_t* stock, void* context)
+    {
+        ((event_handle*)context)->signal();
+    };
+    stock_on_resolved(stock, fetch_levels, signal_resolved, &resolved);
+
+    if (resolved.wait(timeout_ms == UINT32_MAX ? -1 : (int)timeout_ms) == 0)
+        return true;
+
+    // The callback is not running anymore once canceled, so the event can be released safely.
+    stock_cancel_on_resolved(signal_resolved, &resolved);
+    return stock->has_resolve(fetch_levels);
+}
+
+void stock_notify_resolved(const stock_t* stock, fetch_level_t resolved_level)
+{
+    stock_publish_change(stock->id, resolved_level);
+
+    // Pairs with the fence of #stock_on_resolved so that either the waiter sees the resolved level or we see the waiter.
+    atomic_thread_fence_sequentially_consistent();
+    if (atomic_load32(&_resolved_waiter_count, memory_order_relaxed) == 0)
+        return;
+
+    SHARED_WRITE_LOCK(_resolved_waiters_lock);
+    for (unsigned i = 0; i < array_size(_resolved_waiters);)
+    {
+        const stock_resolved_waiter_t waiter = _resolved_waiters[i];
+        if (waiter.stock != stock || !stock->has_resolve(waiter.fetch_levels))
+        {
+            ++i;
+            continue;
+        }
+
+        array_erase_memcpy(_resolved_waiters, i);
+        atomic_decr32(&_resolved_waiter_count, memory_order_relaxed);
+        waiter.callback(stock, waiter.context);
+    }
+}
+
+void stock_register_change_listener(stock_changed_callback_t callback, void* context)
+{
+    FOUNDATION_ASSERT(callback);
+
+    SHARED_WRITE_LOCK(_change_listeners_lock);
+    stock_change_listener_t listener{ callback, context };
+    array_push_memcpy(_change_listeners, &listener);
+    atomic_incr32(&_change_listener_count, memory_order_release);
+}
+
+void stock_unregister_change_listener(stock_changed_callback_t callback, void* context)
+{
+    SHARED_WRITE_LOCK(_change_listeners_lock);
+    for (unsigned i = 0; i < array_size(_change_listeners);)
+    {
+        const stock_change_listener_t& listener = _change_listeners[i];
+        if (listener.callback != callback || listener.context != context)
+        {
+            ++i;
+            continue;
+        }
+
+        array_erase_memcpy(_change_listeners, i);
+        atomic_decr32(&_change_listener_count, memory_order_relaxed);
+    }
+}
+
+void stock_publish_change(hash_t stock_id, fetch_level_t changed_levels)
+{
+    if (atomic_load32(&_change_listener_count, memory_order_acquire) == 0)
+        return;
+
+    SHARED_READ_LOCK(_change_listeners_lock);
+    foreach(listener, _change_listeners)
+        listener->callback(stock_id, changed_levels, listener->context);
+}
+
 stock_index_t stock_index(const char* symbol, size_t symbol_length)
 {
-    FOUNDATION_ASSERT(_db_hashes);
+    EPOCH_SCOPE();
+    FOUNDATION_ASSERT(stock_hashes());
     
     const hash_t id = hash(symbol, symbol_length);
-    return (stock_index_t)hashtable64_get(_db_hashes, id);
+    return (stock_index_t)hashtable64_get(stock_hashes(), id);
 }
 
 bool stock_request(const stock_handle_t& handle, const stock_t** out_stock)
 {
     FOUNDATION_ASSERT(handle.id);
     FOUNDATION_ASSERT(out_stock);
-    FOUNDATION_ASSERT(_db_hashes);
+
+    EPOCH_SCOPE();
+    FOUNDATION_ASSERT(stock_hashes());
 
     *out_stock = nullptr;
-    uint64_t index = hashtable64_get(_db_hashes, handle.id);
+    uint64_t index = hashtable64_get(stock_hashes(), handle.id);
     if (index == 0)
         return false;
 
-    FOUNDATION_ASSERT(_db_stocks);
-
-    SHARED_READ_LOCK(_db_lock);
-    FOUNDATION_ASSERT(index > 0 && index < array_size(_db_stocks));
+    const stock_t* s = stock_entry((stock_index_t)index);
+    if (s == nullptr)
+        return false;
 
-    const stock_t& s = _db_stocks[index];
-    FOUNDATION_ASSERT(s.id == handle.id);
-    *out_stock = &s;
+    FOUNDATION_ASSERT(s->id == handle.id);
+    *out_stock = s;
     return true;
 }
 
@@ -919,68 +1688,203 @@ stock_handle_t stock_request(const char* symbol, size_t symbol_length, fetch_lev
     return stock_handle;
 }
 
-double stock_exchange_rate(const char* from, size_t from_length, const char* to, size_t to_length, time_t at /*= 0*/)
+FOUNDATION_STATIC stock_exchange_rate_series_t* stock_exchange_rate_series(const char* from, size_t from_length, const char* to, size_t to_length)
 {
-    if (_exchange_rates == nullptr)
-        _exchange_rates = hashtable64_allocate(16);
-
-    if (string_equal(from, from_length, to, to_length))
-        return 1.0;
-
-    if (string_equal(STRING_CONST("NA"), from, from_length))
-        return 1.0;
-
     char exchange_code[32];
     string_t exg = string_format(exchange_code, sizeof(exchange_code), STRING_CONST("%.*s%.*s.FOREX"), (int)from_length, from, (int)to_length, to);
-    const hash_t exchange_hash = string_hash(STRING_ARGS(exg)) + at;
+    const hash_t key = string_hash(STRING_ARGS(exg));
 
-    double rate = 1;
-    uint64_t xr = hashtable64_get(_exchange_rates, exchange_hash);
-    if (xr != 0)
-        rate = *(double*)&xr;
-    else
     {
-        if (at == 0)
+        SHARED_READ_LOCK(_exchange_rates_lock);
+        foreach(e, _exchange_rates)
         {
-            eod_fetch("real-time", exchange_code, FORMAT_JSON_CACHE, [&rate](const json_object_t& json)
-            {
-                rate = json["close"].as_number(rate);
-            }, 60 * 60ULL);
+            if ((*e)->key == key)
+                return *e;
         }
-        else
+    }
+
+    SHARED_WRITE_LOCK(_exchange_rates_lock);
+    foreach(e, _exchange_rates)
+    {
+        if ((*e)->key == key)
+            return *e;
+    }
+
+    stock_exchange_rate_series_t* series = MEM_NEW(HASH_STOCK, stock_exchange_rate_series_t);
+    series->key = key;
+    string_copy(STRING_BUFFER(series->code), STRING_ARGS(exg));
+    array_push(_exchange_rates, series);
+    return series;
+}
+
+/*! Fetch the whole daily series of a currency pair at once.
+ *  Only the thread that moves the series out of the empty state fetches it.
+ */
+FOUNDATION_STATIC void stock_exchange_rate_series_load(stock_exchange_rate_series_t* series)
+{
+    if (!atomic_cas32(&series->state, STOCK_EXCHANGE_RATE_LOADING, STOCK_EXCHANGE_RATE_EMPTY, memory_order_acquire, memory_order_relaxed))
+        return;
+
+    time_t* dates = nullptr;
+    double* rates = nullptr;
+    const char* eod_url = eod_build_url("eod", FORMAT_JSON_CACHE, "%s?order=a", series->code);
+    query_execute_json(eod_url, FORMAT_JSON_CACHE, [&dates, &rates](const json_object_t& json)
+    {
+        if (json.root == nullptr)
+            return;
+
+        array_reserve(dates, json.root->value_length);
+        array_reserve(rates, json.root->value_length);
+        for (auto e : json)
         {
-            string_const_t from_date_str = string_from_date(at - time_one_day() * 5);
-            if (!string_is_null(from_date_str))
+            string_const_t date_string = e["date"].as_string();
+            const time_t date = string_to_date(STRING_ARGS(date_string));
+            const double rate = e["adjusted_close"].as_number();
+            if (date <= 0 || !math_real_is_finite(rate) || rate <= 0)
+                continue;
+
+            // Keep the series sorted and the latest rate of a duplicated day.
+            int idx = array_binary_search(dates, array_size(dates), date);
+            if (idx >= 0)
             {
-                string_const_t to_date_str = string_from_date(at);
-                const char* eod_url = eod_build_url("eod", FORMAT_JSON_CACHE, "%s?from=%.*s&to=%.*s&order=d", exchange_code, STRING_FORMAT(from_date_str), STRING_FORMAT(to_date_str));
-                query_execute_json(eod_url, FORMAT_JSON_CACHE, [eod_url, &rate](const auto& json)
-                {
-                    if (json.root == nullptr)
-                        return;
-
-                    if (json.root->value_length != 0)
-                    {
-                        const json_object_t& jc = json.get(0)["adjusted_close"];
-                        rate = jc.as_number(rate);
-                    }
-                    else
-                    {
-                        log_warnf(HASH_STOCK, WARNING_SUSPICIOUS, STRING_CONST("Failed to get exchange rate with %s"), eod_url);
-                    }
-                }, UINT64_MAX);
+                rates[idx] = rate;
+                continue;
             }
+
+            idx = ~idx;
+            array_insert_memcpy(dates, idx, &date);
+            array_insert_memcpy(rates, idx, &rate);
         }
+    }, 12 * 60 * 60ULL);
+
+    if (array_size(dates) == 0)
+        log_warnf(HASH_STOCK, WARNING_SUSPICIOUS, STRING_CONST("Failed to get exchange rates with %s"), eod_url);
+
+    series->dates = dates;
+    series->rates = rates;
+    atomic_store32(&series->state, STOCK_EXCHANGE_RATE_READY, memory_order_release);
+    series->loaded.signal();
+}
+
+/*! Block until the daily series of a currency pair is ready. */
+FOUNDATION_STATIC void stock_exchange_rate_series_wait(stock_exchange_rate_series_t* series)
+{
+    if (atomic_load32(&series->state, memory_order_acquire) == STOCK_EXCHANGE_RATE_READY)
+        return;
+
+    while (atomic_load32(&series->state, memory_order_acquire) != STOCK_EXCHANGE_RATE_READY)
+        series->loaded.wait(-1);
+
+    // Wake up the next thread waiting for the same series.
+    series->loaded.signal();
+}
+
+/*! Returns the rate of the last trading day on or before #at, or the first known rate if #at predates the series. */
+FOUNDATION_STATIC double stock_exchange_rate_series_lookup(const stock_exchange_rate_series_t* series, time_t at, double default_rate)
+{
+    const unsigned count = array_size(series->dates);
+    if (count == 0)
+        return default_rate;
+
+    int idx = array_binary_search(series->dates, count, at);
+    if (idx < 0)
+        idx = max(0, ~idx - 1);
+    return series->rates[idx];
+}
+
+double stock_exchange_rate(const char* from, size_t from_length, const char* to, size_t to_length, time_t at /*= 0*/)
+{
+    if (string_equal(from, from_length, to, to_length))
+        return 1.0;
+
+    if (string_equal(STRING_CONST("NA"), from, from_length))
+        return 1.0;
+
+    stock_exchange_rate_series_t* series = stock_exchange_rate_series(from, from_length, to, to_length);
+
+    double rate = 1;
+    if (at == 0)
+    {
+        const time_t now = time_now();
+        uint64_t current = atomic_load64(&series->current, memory_order_acquire);
+        if (current != 0 && now - (time_t)atomic_load64(&series->current_time, memory_order_relaxed) < STOCK_EXCHANGE_RATE_REALTIME_MAX_AGE)
+            return *(double*)&current;
 
-        if (!hashtable64_set(_exchange_rates, exchange_hash, *(uint64_t*)&rate))
+        eod_fetch("real-time", series->code, FORMAT_JSON_CACHE, [&rate](const json_object_t& json)
         {
-            size_t new_size = hashtable64_size(_exchange_rates) * 2;
-            hashtable64_deallocate(_exchange_rates);
-            _exchange_rates = hashtable64_allocate(new_size);
-        }
+            rate = json["close"].as_number(rate);
+        }, STOCK_EXCHANGE_RATE_REALTIME_MAX_AGE);
+
+        atomic_store64(&series->current_time, (int64_t)now, memory_order_relaxed);
+        atomic_store64(&series->current, *(int64_t*)&rate, memory_order_release);
+        return rate;
     }
 
-    return rate;
+    // Wait for another thread that might already be fetching the series.
+    stock_exchange_rate_series_load(series);
+    stock_exchange_rate_series_wait(series);
+
+    return stock_exchange_rate_series_lookup(series, at, rate);
+}
+
+void stock_exchange_rate_prefetch(const char* from, size_t from_length, const char* to, size_t to_length)
+{
+    if (string_equal(from, from_length, to, to_length))
+        return;
+
+    if (string_equal(STRING_CONST("NA"), from, from_length))
+        return;
+
+    stock_exchange_rate_series_t* series = stock_exchange_rate_series(from, from_length, to, to_length);
+    if (atomic_load32(&series->state, memory_order_acquire) != STOCK_EXCHANGE_RATE_EMPTY)
+        return;
+
+    job_execute([](payload_t* payload)
+    {
+        stock_exchange_rate_series_load((stock_exchange_rate_series_t*)payload);
+        return 0;
+    }, series, JOB_DEALLOCATE_AFTER_EXECUTION);
+}
+
+/*! Returns the currency of a stock if it can be known without waiting for the stock to resolve. */
+FOUNDATION_STATIC bool stock_try_get_currency(const char* code, size_t code_length, string_const_t& currency)
+{
+    // Make some quick assumption based on the code itself.
+    string_const_t exchange = path_file_extension(code, code_length);
+    if (string_equal(STRING_ARGS(exchange), STRING_CONST("TO"))) { currency = CTEXT("CAD"); return true; }
+    if (string_equal(STRING_ARGS(exchange), STRING_CONST("V"))) { currency = CTEXT("CAD"); return true; }
+    if (string_equal(STRING_ARGS(exchange), STRING_CONST("US"))) { currency = CTEXT("USD"); return true; }
+    if (string_equal(STRING_ARGS(exchange), STRING_CONST("NEO"))) { currency = CTEXT("CAD"); return true; }
+
+    const stock_t* s = stock_entry(stock_index(code, code_length));
+    if (s == nullptr || s->currency == STRING_TABLE_NULL_SYMBOL)
+        return false;
+
+    currency = SYMBOL_CONST(s->currency);
+    return true;
+}
+
+void stock_exchange_rate_prefetch_symbol(const char* code, size_t code_length, const char* to, size_t to_length)
+{
+    string_const_t currency;
+    if (stock_try_get_currency(code, code_length, currency))
+        return stock_exchange_rate_prefetch(STRING_ARGS(currency), to, to_length);
+
+    // Prefetch rates once the stock fundamentals tell its currency.
+    stock_handle_t handle = stock_request(code, code_length, FetchLevel::FUNDAMENTALS);
+    const stock_t* s = handle.resolve();
+    if (s == nullptr)
+        return;
+
+    const string_table_symbol_t to_symbol = string_table_encode(to, to_length);
+    stock_on_resolved(s, FetchLevel::FUNDAMENTALS, [](const stock_t* s, void* context)
+    {
+        if (s->currency == STRING_TABLE_NULL_SYMBOL)
+            return;
+        string_const_t currency = SYMBOL_CONST(s->currency);
+        string_const_t to = SYMBOL_CONST((string_table_symbol_t)(uintptr_t)context);
+        stock_exchange_rate_prefetch(STRING_ARGS(currency), STRING_ARGS(to));
+    }, (void*)(uintptr_t)to_symbol);
 }
 
 const day_result_t* stock_get_EOD(const stock_t* stock_data, time_t day_time, bool take_last /*= false*/)
@@ -989,8 +1893,8 @@ const day_result_t* stock_get_EOD(const stock_t* stock_data, time_t day_time, bo
         return nullptr;
 
     const day_result_t* history = stock_data->history;
-    const size_t history_count = stock_data->history_count;
-    if (!history || history_count == 0)
+    const size_t history_count = array_size(history);
+    if (history_count == 0)
         return nullptr;
 
     constexpr const time_t ONE_DAY = time_one_day();
@@ -1086,6 +1990,8 @@ day_result_t stock_get_eod(const char* code, size_t code_length, time_t at)
 
     while(!s->has_resolve(FetchLevel::EOD))
         dispatcher_wait_for_wakeup_main_thread();
+
+    EPOCH_SCOPE();
     const day_result_t* ed = stock_get_EOD(s, at, true);
     if (ed == nullptr)
         return {};
@@ -1161,25 +2067,24 @@ double stock_get_split_adjusted_factor(const char* code, size_t code_length, tim
 
 string_const_t stock_get_name(const char* code, size_t code_length)
 {
-    SHARED_READ_LOCK(_db_lock);
-    stock_index_t index = stock_index(code, code_length);
-    if (index == 0)
+    const stock_t* s = stock_entry(stock_index(code, code_length));
+    if (s == nullptr)
         return {};
         
-    return SYMBOL_CONST(_db_stocks[index].name);
+    return SYMBOL_CONST(s->name);
 }
 
 string_const_t stock_get_short_name(const char* code, size_t code_length)
 {
-    SHARED_READ_LOCK(_db_lock);
     stock_index_t index = stock_index(code, code_length);
-    if (index == 0)
+    stock_t* s = stock_entry(index);
+    if (s == nullptr)
         return {};
 
     string_table_symbol_t symbol;
     if (!stock_fetch_short_name(index, symbol))
         return {};
-    _db_stocks[index].short_name = symbol;
+    s->short_name = symbol;
     return SYMBOL_CONST(symbol);
 }
 
@@ -1198,33 +2103,27 @@ string_const_t stock_get_short_name(const stock_handle_t& handle)
 
 string_const_t stock_get_currency(const char* code, size_t code_length)
 {
-    // Make some quick assumption based on the code itself.
-    string_const_t exchange = path_file_extension(code, code_length);
-    if (string_equal(STRING_ARGS(exchange), STRING_CONST("TO"))) return CTEXT("CAD");
-    if (string_equal(STRING_ARGS(exchange), STRING_CONST("V"))) return CTEXT("CAD");
-    if (string_equal(STRING_ARGS(exchange), STRING_CONST("US"))) return CTEXT("USD");
-    if (string_equal(STRING_ARGS(exchange), STRING_CONST("NEO"))) return CTEXT("CAD");
-
-    SHARED_READ_LOCK(_db_lock);
-    stock_index_t index = stock_index(code, code_length);
+    string_const_t currency;
+    if (stock_try_get_currency(code, code_length, currency))
+        return currency;
 
-    if (index == 0 || _db_stocks[index].currency == STRING_TABLE_NULL_SYMBOL)
+    stock_handle_t handle = stock_request(code, code_length, FetchLevel::FUNDAMENTALS);
+    if (!thread_is_main())
     {
-        tick_t timeout = time_current();
-        stock_handle_t handle = stock_request(code, code_length, FetchLevel::FUNDAMENTALS);
-        while (handle->currency == 0 && time_elapsed(timeout) < 5)
-            dispatcher_wait_for_wakeup_main_thread(250);
-            
-        if (handle->currency != STRING_TABLE_NULL_SYMBOL)
-            return SYMBOL_CONST(handle->currency);
-            
-        log_warnf(HASH_STOCK, WARNING_INVALID_VALUE,
-            STRING_CONST("Failed to get stock '%.*s' currency"), (int)code_length, code);
+        stock_wait_resolved(handle, FetchLevel::FUNDAMENTALS, 5000);
     }
     else
     {
-        return SYMBOL_CONST(_db_stocks[index].currency);
+        tick_t timeout = time_current();
+        while (handle->currency == 0 && !handle->has_resolve(FetchLevel::FUNDAMENTALS) && time_elapsed(timeout) < 5)
+            dispatcher_wait_for_wakeup_main_thread(250);
     }
+        
+    if (handle->currency != STRING_TABLE_NULL_SYMBOL)
+        return SYMBOL_CONST(handle->currency);
+        
+    log_warnf(HASH_STOCK, WARNING_INVALID_VALUE,
+        STRING_CONST("Failed to get stock '%.*s' currency"), (int)code_length, code);
 
     return string_const(SETTINGS.preferred_currency, string_length(SETTINGS.preferred_currency));
 }
@@ -1234,6 +2133,8 @@ double stock_current_price(stock_handle_t& handle)
     if (stock_resolve(handle, FetchLevel::REALTIME) < 0)
         return NAN;
 
+    // The main thread cannot fire the real-time batch timer while waiting.
+    stock_flush_real_time_requests();
     const tick_t timeout = time_current();
     while (!handle->has_resolve(FetchLevel::REALTIME) && time_elapsed(timeout) < 5)
         dispatcher_wait_for_wakeup_main_thread(250);
@@ -1250,6 +2151,7 @@ double stock_price_on_date(stock_handle_t& handle, time_t at)
     while (!handle->has_resolve(FetchLevel::EOD) && time_elapsed(timeout) < 5)
         dispatcher_wait_for_wakeup_main_thread(250);
 
+    EPOCH_SCOPE();
     const day_result_t* ed = stock_get_EOD(handle, at, true);
     if (ed == nullptr)
         return NAN;
@@ -1397,15 +2299,17 @@ bool stock_get_time_range(const char* symbol, size_t symbol_length, time_t* star
     if (!handle->has_resolve(FetchLevel::EOD))
         return false;
 
+    EPOCH_SCOPE();
     const stock_t* stock = handle.resolve();
-    if (stock == nullptr || stock->history_count == 0)
+    const day_result_t* history = stock ? stock->history : nullptr;
+    if (array_size(history) == 0)
         return false;
 
     if (start_time)
-        *start_time = array_last(stock->history)->date;
+        *start_time = array_last(history)->date;
 
     if (end_time)
-        *end_time = array_first(stock->history)->date;
+        *end_time = array_first(history)->date;
 
     return true;
 }
@@ -1417,8 +2321,12 @@ bool stock_get_time_range(const char* symbol, size_t symbol_length, time_t* star
 FOUNDATION_STATIC void stock_initialize()
 {
     _db_capacity = 256;
-    _db_hashes = hashtable64_allocate(_db_capacity);
-    array_push(_db_stocks, stock_t{});
+    atomic_store_ptr(&_db_hashes, hashtable64_allocate(_db_capacity), memory_order_release);
+
+    // The first slot is reserved so that a null index never resolves to a stock.
+    void* chunk = memory_allocate(HASH_STOCK, sizeof(stock_t) * STOCK_CHUNK_SIZE, alignof(stock_t), MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+    atomic_store_ptr(&_db_chunks[0], chunk, memory_order_release);
+    atomic_store32(&_db_count, 1, memory_order_release);
 
     _invalid_symbols = MEM_NEW(HASH_STOCK, stock_invalid_symbol_db_t);
     stock_load_invalid_symbols(_invalid_symbols);
@@ -1429,28 +2337,58 @@ FOUNDATION_STATIC void stock_shutdown()
     stock_save_invalid_symbols(_invalid_symbols);
     MEM_DELETE(_invalid_symbols);
 
-    hashtable64_deallocate(_exchange_rates);
-    _exchange_rates = nullptr;
+    {
+        SHARED_WRITE_LOCK(_resolved_waiters_lock);
+        array_deallocate(_resolved_waiters);
+        atomic_store32(&_resolved_waiter_count, 0, memory_order_release);
+    }
 
     {
-        SHARED_WRITE_LOCK(_db_lock);
-        for (size_t i = 0; i < array_size(_trashed_history); ++i)
-            array_deallocate(_trashed_history[i]);
-        array_deallocate(_trashed_history);
+        SHARED_WRITE_LOCK(_change_listeners_lock);
+        array_deallocate(_change_listeners);
+        atomic_store32(&_change_listener_count, 0, memory_order_release);
+    }
+
+    {
+        SHARED_WRITE_LOCK(_realtime_batch_lock);
+        array_deallocate(_realtime_batch);
+    }
+
+    foreach(e, _exchange_rates)
+    {
+        stock_exchange_rate_series_t* series = *e;
+        array_deallocate(series->dates);
+        array_deallocate(series->rates);
+        MEM_DELETE(series);
+    }
+    array_deallocate(_exchange_rates);
 
-        for (size_t i = 1; i < array_size(_db_stocks); ++i)
+    {
+        SHARED_WRITE_LOCK(_db_lock);
+        for (stock_index_t i = 1, end = atomic_load32(&_db_count, memory_order_acquire); i < end; ++i)
         {
-            stock_t* stock_data = &_db_stocks[i];
+            stock_t* stock_data = stock_entry(i);
             array_deallocate(stock_data->previous);
-            array_deallocate(stock_data->history);
-            stock_data->history_count = 0;
+            if (stock_data->history_map)
+                stock_history_map_deallocate(stock_data->history_map);
+            else
+                array_deallocate(stock_data->history);
+            stock_data->history = nullptr;
+            stock_data->history_map = nullptr;
         }
 
-        array_deallocate(_db_stocks);
-        _db_stocks = nullptr;
+        atomic_store32(&_db_count, 0, memory_order_release);
+        for (uint32_t i = 0; i < STOCK_MAX_CHUNKS; ++i)
+        {
+            void* chunk = atomic_load_ptr(&_db_chunks[i], memory_order_acquire);
+            if (chunk == nullptr)
+                break;
+            memory_deallocate(chunk);
+            atomic_store_ptr(&_db_chunks[i], nullptr, memory_order_release);
+        }
 
-        hashtable64_deallocate(_db_hashes);
-        _db_hashes = nullptr;
+        hashtable64_deallocate(stock_hashes());
+        atomic_store_ptr(&_db_hashes, nullptr, memory_order_release);
     }
 }
 
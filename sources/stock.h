@@ -52,6 +52,8 @@ FOUNDATION_ALIGNED_STRUCT(stock_realtime_record_t, 8)
     double volume;
 };
 
+struct realtime_ring_t;
+
 /*! Represents stock realtime data. */
 FOUNDATION_ALIGNED_STRUCT(stock_realtime_t, 8)
 {
@@ -63,6 +65,7 @@ FOUNDATION_ALIGNED_STRUCT(stock_realtime_t, 8)
     bool   refresh{ false };
 
     stock_realtime_record_t* records{ nullptr };
+    realtime_ring_t*         ring{ nullptr }; // Latest ticks, readable without locking
 };
 
 FOUNDATION_ALIGNED_STRUCT(stock_eod_record_t, 8)
@@ -120,6 +123,21 @@ FOUNDATION_ALIGNED_STRUCT(day_result_t, 8)
     double cci{ DNAN };
 };
 
+/*! Daily bar as returned by the EOD API and stored in the local EOD history files. */
+struct stock_eod_bar_t
+{
+    time_t date;
+    double open;
+    double high;
+    double low;
+    double close;
+    double adjusted_close;
+    double volume;
+};
+
+FOUNDATION_FORCEINLINE bool operator<(const stock_eod_bar_t& b, const time_t& date) { return b.date < date; }
+FOUNDATION_FORCEINLINE bool operator>(const stock_eod_bar_t& b, const time_t& date) { return b.date > date; }
+
 /*! Represents a stock. */
 FOUNDATION_ALIGNED_STRUCT(stock_t, 8)
 {
@@ -167,9 +185,11 @@ FOUNDATION_ALIGNED_STRUCT(stock_t, 8)
     time_t updated_at{ 0 };
 
     day_result_t current{};
+    /*! EOD history, most recent day first. The history is replaced as a whole, so load the pointer 
+     *  once and use array_size on it to iterate a consistent snapshot. */
     day_result_t* history{ nullptr };
-    size_t history_count{ 0 };
     day_result_t* previous{ nullptr };
+    struct stock_history_map_t* history_map{ nullptr }; // Mapped EOD history file backing #history if any
 
     double_option_t earning_trend_actual{ DNAN };
     double_option_t earning_trend_estimate{ DNAN };
@@ -217,6 +237,9 @@ FOUNDATION_ALIGNED_STRUCT(stock_t, 8)
         this->last_update_time = time_current();
         if (!keep_errors)
             this->fetch_errors = 0;
+
+        extern void stock_notify_resolved(const stock_t* stock, fetch_level_t resolved_level);
+        stock_notify_resolved(this, resolved_level);
     }
 };
 
@@ -247,6 +270,10 @@ struct stock_handle_t
         if (id == 0)
             return nullptr;
 
+        // Stocks never move once created.
+        if (ptr)
+            return ptr;
+
         if (stock_request(*this, &ptr))
             return ptr;
         return nullptr;
@@ -273,7 +300,8 @@ struct stock_handle_t
 };
 
 /*! Request the stock data pointer if already resolved.
- *  The returned pointer is unsafe as it might get invalidated over time. 
+ *  The returned pointer remains valid until the stock module shuts down,
+ *  but arrays it references (i.e. history) must only be read inside an epoch.
  * 
  *  @param handle The stock handle.
  *  @param out_stock The stock pointer.
@@ -282,6 +310,87 @@ struct stock_handle_t
  */
 bool stock_request(const stock_handle_t& handle, const stock_t** out_stock);
 
+/*! Callback invoked once a stock resolves the fetch levels it waits for.
+ * 
+ *  @param stock   The resolved stock.
+ *  @param context The context given to #stock_on_resolved.
+ */
+typedef void(*stock_resolved_callback_t)(const stock_t* stock, void* context);
+
+/*! Invoke a callback once a stock resolves some fetch levels.
+ *  Failed fetches also resolve their level, so check #stock_t::fetch_errors to know if data is missing.
+ * 
+ *  @remark The callback is invoked right away if the stock is already resolved, otherwise by the thread
+ *          resolving the stock while the resolution waiters are locked. It must be short and must not
+ *          register or cancel other waiters.
+ * 
+ *  @param stock        The stock to wait for.
+ *  @param fetch_levels The fetch levels that must be resolved.
+ *  @param callback     The callback to invoke.
+ *  @param context      The context passed back to the callback.
+ */
+void stock_on_resolved(const stock_t* stock, fetch_level_t fetch_levels, stock_resolved_callback_t callback, void* context);
+
+/*! Remove a callback registered with #stock_on_resolved that was not invoked yet.
+ *  Once this returns, the callback is not running and will not be invoked for that context.
+ * 
+ *  @param callback The registered callback.
+ *  @param context  The registered context.
+ */
+void stock_cancel_on_resolved(stock_resolved_callback_t callback, void* context);
+
+/*! Block the calling thread until a stock resolves some fetch levels.
+ *
+ *  @remark Must not be called from the main thread, use #stock_on_resolved instead.
+ * 
+ *  @param stock        The stock to wait for.
+ *  @param fetch_levels The fetch levels that must be resolved.
+ *  @param timeout_ms   Maximum time to wait in milliseconds.
+ * 
+ *  @return True if the stock resolved the fetch levels, false if it timed out.
+ */
+bool stock_wait_resolved(const stock_t* stock, fetch_level_t fetch_levels, unsigned timeout_ms = UINT32_MAX);
+
+/*! Fetch the stocks waiting for the next real-time query without waiting for the batch window to end.
+ *
+ *  @remark Call this before waiting for real-time data on the main thread, which fires the batch timer.
+ */
+void stock_flush_real_time_requests();
+
+/*! Callback invoked when new data is published for a stock.
+ * 
+ *  @param stock_id       The stock id, see #stock_handle_t::id.
+ *  @param changed_levels The fetch levels of the data that changed.
+ *  @param context        The context given to #stock_register_change_listener.
+ */
+typedef void(*stock_changed_callback_t)(hash_t stock_id, fetch_level_t changed_levels, void* context);
+
+/*! Register a callback invoked every time new data is published for any stock.
+ * 
+ *  @remark The callback is invoked by the thread publishing the data while the listeners are locked. 
+ *          It must be short and must not register or unregister listeners.
+ * 
+ *  @param callback The callback to invoke.
+ *  @param context  The context passed back to the callback.
+ */
+void stock_register_change_listener(stock_changed_callback_t callback, void* context);
+
+/*! Unregister a callback registered with #stock_register_change_listener.
+ *  Once this returns, the callback is not running and will not be invoked for that context anymore.
+ * 
+ *  @param callback The registered callback.
+ *  @param context  The registered context.
+ */
+void stock_unregister_change_listener(stock_changed_callback_t callback, void* context);
+
+/*! Notify the change listeners that new data is available for a stock.
+ *  Stocks publish the levels they resolve, so this only needs to be called for data stored outside of #stock_t.
+ * 
+ *  @param stock_id       The stock id, see #stock_handle_t::id.
+ *  @param changed_levels The fetch levels of the data that changed.
+ */
+void stock_publish_change(hash_t stock_id, fetch_level_t changed_levels);
+
 /*! Initialize a stock handle structure. 
  *  The stock handle is used to reference stocks without having to keep a pointer to the stock_t object.
  * 
@@ -352,12 +461,34 @@ bool stock_update(const char* code, size_t code_length, stock_handle_t& handle,
  *  @param from_length The length of the currency code to convert from.
  *  @param to The currency code to convert to.
  *  @param to_length The length of the currency code to convert to.
- *  @param at The date to get the exchange rate at.
+ *  @param at The date to get the exchange rate at, or 0 to get the latest real-time rate.
+ * 
+ *  @remark Dates without a rate (i.e. weekends and holidays) use the rate of the previous trading day.
  * 
  *  @return The exchange rate between the two currencies.
  */
 double stock_exchange_rate(const char* from, size_t from_length, const char* to, size_t to_length, time_t at = 0);
 
+/*! Fetch the daily exchange rates of a currency pair in the background.
+ *  Later calls to #stock_exchange_rate with a date for that pair will not have to wait for a request.
+ * 
+ *  @param from The currency code to convert from.
+ *  @param from_length The length of the currency code to convert from.
+ *  @param to The currency code to convert to.
+ *  @param to_length The length of the currency code to convert to.
+ */
+void stock_exchange_rate_prefetch(const char* from, size_t from_length, const char* to, size_t to_length);
+
+/*! Fetch in the background the daily exchange rates from the currency of a stock to another currency.
+ *  If the stock currency is not known yet, rates are fetched once the stock fundamentals resolve, so this never blocks.
+ * 
+ *  @param code The stock symbol code.
+ *  @param code_length The length of the stock symbol code.
+ *  @param to The currency code to convert to.
+ *  @param to_length The length of the currency code to convert to.
+ */
+void stock_exchange_rate_prefetch_symbol(const char* code, size_t code_length, const char* to, size_t to_length);
+
 /*! Returns the end-of-day data for a stock from a given range based on today.
  * 
  *  @param stock_data The stock data.
@@ -365,6 +496,8 @@ double stock_exchange_rate(const char* from, size_t from_length, const char* to,
  *  @param take_last If true, the last available data will be returned if the given date is not available.
  * 
  *  @return The end-of-day data for the stock at the given date.
+ *
+ *  @remark The caller must stay inside an epoch while it reads the returned day, as the history can be replaced.
  */
 const day_result_t* stock_get_EOD(const stock_t* stock_data, int rel_day, bool take_last = false);
 
@@ -375,6 +508,8 @@ const day_result_t* stock_get_EOD(const stock_t* stock_data, int rel_day, bool t
  *  @param take_last If true, the last available data will be returned if the given date is not available.
  * 
  *  @return The end-of-day data for the stock at the given date.
+ *
+ *  @remark The caller must stay inside an epoch while it reads the returned day, as the history can be replaced.
  */
 const day_result_t* stock_get_EOD(const stock_t* stock_data, time_t day_time, bool take_last = false);
 
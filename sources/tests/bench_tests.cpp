@@ -0,0 +1,362 @@
+/*
+ * License: https://wiimag.com/LICENSE
+ * Copyright 2023 Wiimag Inc. All rights reserved.
+ *
+ * End-to-end scenarios timed with --bench against recorded fixtures served by query mocks.
+ */
+
+#include <framework/tests/test_utils.h>
+
+#if BUILD_TESTS
+
+#include <framework/tests/bench.h>
+
+#include "test_helpers.h"
+
+#include <title.h>
+#include <report.h>
+#include <wallet.h>
+#include <timeline.h>
+
+#include <framework/search_database.h>
+#include <framework/string_builder.h>
+#include <framework/dispatcher.h>
+#include <framework/table.h>
+#include <framework/array.h>
+#include <framework/query.h>
+
+#include <foundation/environment.h>
+#include <foundation/thread.h>
+#include <foundation/path.h>
+#include <foundation/fs.h>
+
+FOUNDATION_EXTERN search_document_handle_t search_index_fundamental_document(search_database_t* db, const json_object_t& json, string_const_t symbol);
+
+constexpr int BENCH_SYMBOL_COUNT = 200;
+constexpr int BENCH_REPORT_COUNT = 4;
+constexpr int BENCH_REPORT_TITLE_COUNT = 100;
+constexpr int BENCH_HISTORY_DAY_COUNT = 260;
+constexpr int BENCH_SEARCH_DOCUMENT_COUNT = 5000;
+
+constexpr const char* BENCH_SECTORS[] = { "Energy", "Technology", "Healthcare", "Utilities", "Financial Services", "Industrials" };
+constexpr const char* BENCH_INDUSTRIES[] = { "Oil Gas", "Software", "Biotechnology", "Renewable", "Banks", "Aerospace", "Mining" };
+constexpr const char* BENCH_COUNTRIES[] = { "Canada", "USA", "Germany", "Japan" };
+constexpr const char* BENCH_WORDS[] = { "Northern", "Pacific", "Silver", "Quantum", "Atlas", "Harbor", "Summit", "Golden" };
+
+constexpr const char* BENCH_COLUMN_EXPRESSIONS[] = {
+    "S($TITLE, price) * 2",
+    "R($REPORT, $TITLE, gain)",
+    "R($REPORT, $TITLE, total_value) / S($TITLE, close)",
+    "MAX(S($TITLE, open), S($TITLE, close))",
+    "R($REPORT, $TITLE, days_held)",
+    "IF(R($REPORT, $TITLE, active), 1, 0)"
+};
+
+constexpr const char* BENCH_SEARCH_QUERIES[] = {
+    "energy",
+    "canada or japan",
+    "technology -canada",
+    "(quantum or atlas) and software",
+    "\"northern pacific\"",
+    "MarketCapitalization>100000 and TrailingPE<20"
+};
+
+static bool _bench_fixtures_recorded = false;
+
+FOUNDATION_STATIC string_t bench_symbol_code(char* buffer, size_t capacity, int index)
+{
+    return string_format(buffer, capacity, STRING_CONST("BENCH%d.US"), index);
+}
+
+/*! Generate the fundamentals recorded for a symbol, which are valid for indexing. */
+FOUNDATION_STATIC string_t bench_record_fundamentals(int index)
+{
+    const char* sector = BENCH_SECTORS[index % ARRAY_COUNT(BENCH_SECTORS)];
+    const char* industry = BENCH_INDUSTRIES[(index / 5) % ARRAY_COUNT(BENCH_INDUSTRIES)];
+    const char* country = BENCH_COUNTRIES[(index / 3) % ARRAY_COUNT(BENCH_COUNTRIES)];
+    const char* word1 = BENCH_WORDS[index % ARRAY_COUNT(BENCH_WORDS)];
+    const char* word2 = BENCH_WORDS[(index / ARRAY_COUNT(BENCH_WORDS)) % ARRAY_COUNT(BENCH_WORDS)];
+    string_const_t updated_at = string_from_date(time_now());
+
+    return string_allocate_format(STRING_CONST(R"({
+        "General":{"Code":"BENCH%d","Type":"Common Stock","Name":"%s %s %d","Exchange":"US","CurrencyCode":"USD",
+            "Country":"%s","ISIN":"XX%010d","Sector":"%s","Industry":"%s","UpdatedAt":"%.*s","IsDelisted":false,
+            "Description":"%s %s develops %s products for %s customers in %s and abroad."},
+        "Highlights":{"DividendYield":0.0%d,"MarketCapitalization":%d000},
+        "Valuation":{"TrailingPE":%d.5,"ForwardPE":12.25},
+        "Technicals":{"Beta":1.%d,"52WeekHigh":%d}})"),
+        index, word1, word2, index, country, index, sector, industry, STRING_FORMAT(updated_at),
+        word1, word2, industry, sector, country,
+        index % 9, index + 1, index % 40, index % 10, 10 + index % 90);
+}
+
+/*! Register the real-time, fundamentals and end-of-day responses of all the symbols used by the reports. */
+FOUNDATION_STATIC void bench_record_symbols()
+{
+    const time_t today = time_now();
+    for (int i = 0; i < BENCH_SYMBOL_COUNT; ++i)
+    {
+        char code_buffer[16];
+        string_t code = bench_symbol_code(STRING_BUFFER(code_buffer), i);
+
+        test_mock_realtime(STRING_ARGS(code), today, 10 + i);
+
+        char query_buffer[64];
+        string_t fundamentals = bench_record_fundamentals(i);
+        string_t query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/fundamentals/%.*s"), STRING_FORMAT(code));
+        query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(fundamentals));
+        string_deallocate(fundamentals.str);
+
+        // A year of daily history, from the oldest day like the end-of-day API returns it.
+        string_builder_t* sb = string_builder_allocate(BENCH_HISTORY_DAY_COUNT * 128);
+        string_builder_append(sb, '[');
+        for (int d = BENCH_HISTORY_DAY_COUNT - 1; d >= 0; --d)
+        {
+            char date_buffer[16];
+            string_t date = string_from_date(STRING_BUFFER(date_buffer), time_add_days(today, -d));
+            const double close = 10.0 + i + ((d * 7 + i) % 23) * 0.05;
+            string_builder_append_format(sb, "%s{\"date\":\"%.*s\",\"open\":%.2lf,\"high\":%.2lf,\"low\":%.2lf,\"close\":%.2lf,\"adjusted_close\":%.2lf,\"volume\":1000}",
+                d == BENCH_HISTORY_DAY_COUNT - 1 ? "" : ",", STRING_FORMAT(date), close, close + 0.5, close - 0.5, close, close);
+        }
+        string_builder_append(sb, ']');
+
+        string_const_t history = string_builder_text(sb);
+        query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/eod/%.*s"), STRING_FORMAT(code));
+        query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(history));
+        string_builder_deallocate(sb);
+    }
+}
+
+/*! Save reports with a few orders per title and expression columns, and return their file paths. */
+FOUNDATION_STATIC string_t* bench_record_reports()
+{
+    if (!_bench_fixtures_recorded)
+    {
+        // Mocks are only read once registered, so they are recorded once for all scenarios.
+        bench_record_symbols();
+        _bench_fixtures_recorded = true;
+    }
+
+    string_t* report_paths = nullptr;
+    string_const_t temp_dir = environment_temporary_directory();
+    for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+    {
+        char name_buffer[16];
+        string_t name = string_format(STRING_BUFFER(name_buffer), STRING_CONST("Bench %d"), r);
+        report_handle_t handle = test_report_create(STRING_CONST("USD"), STRING_ARGS(name));
+        report_t* report = report_get(handle);
+
+        // Reports share part of their titles like most portfolios do.
+        for (int i = 0; i < BENCH_REPORT_TITLE_COUNT; ++i)
+        {
+            const int symbol_index = (r * BENCH_SYMBOL_COUNT / (BENCH_REPORT_COUNT * 2) + i) % BENCH_SYMBOL_COUNT;
+
+            char code_buffer[16];
+            string_t code = bench_symbol_code(STRING_BUFFER(code_buffer), symbol_index);
+            title_t* title = report_add_title(report, STRING_ARGS(code));
+            for (int o = 0; o < 3; ++o)
+                test_title_add_order(title, time_add_days(time_now(), -60 * (3 - o) - i % 30), o != 2 || (i % 4) != 0, 10.0 + o, 9.0 + symbol_index + o);
+        }
+
+        config_handle_t columns = config_set_array(report->data, STRING_CONST("columns"));
+        for (unsigned c = 0; c < ARRAY_COUNT(BENCH_COLUMN_EXPRESSIONS); ++c)
+        {
+            char column_name_buffer[16];
+            string_t column_name = string_format(STRING_BUFFER(column_name_buffer), STRING_CONST("C%u"), c);
+            config_handle_t column = config_array_push(columns, CONFIG_VALUE_OBJECT);
+            config_set(column, STRING_CONST("name"), STRING_ARGS(column_name));
+            config_set(column, STRING_CONST("expression"), BENCH_COLUMN_EXPRESSIONS[c], string_length(BENCH_COLUMN_EXPRESSIONS[c]));
+            config_set(column, STRING_CONST("format"), (double)COLUMN_FORMAT_NUMBER);
+        }
+        report_load_expression_columns(report);
+
+        char file_name_buffer[32];
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t file_name = string_format(STRING_BUFFER(file_name_buffer), STRING_CONST("bench_%d.report"), r);
+        string_t path = path_concat(STRING_BUFFER(path_buffer), STRING_ARGS(temp_dir), STRING_ARGS(file_name));
+        REQUIRE(report_save(report, STRING_ARGS(path)));
+        array_push(report_paths, string_clone(STRING_ARGS(path)));
+
+        report_deallocate(handle);
+    }
+
+    return report_paths;
+}
+
+FOUNDATION_STATIC report_t* bench_load_report(const string_t& path)
+{
+    report_handle_t handle = report_load(string_to_const(path));
+    report_t* report = report_get(handle);
+    REQUIRE_NE(report, nullptr);
+
+    // Benchmark reports are never saved with the user reports.
+    report->save = false;
+    return report;
+}
+
+/*! Forget the stock data resolved for the report titles, so that the next sync fetches it again. */
+FOUNDATION_STATIC void bench_reset_report_stocks(report_t* report)
+{
+    foreach(pt, report->titles)
+    {
+        title_t* t = *pt;
+        stock_t* s = (stock_t*)(const stock_t*)t->stock;
+        if (s == nullptr)
+            continue;
+
+        const fetch_level_t levels = title_minimum_fetch_level(t);
+        s->resolved_level = s->resolved_level & ~levels;
+        s->fetch_level = s->fetch_level & ~levels;
+    }
+}
+
+FOUNDATION_STATIC size_t bench_search_query_count(search_database_t* db, const char* query_string)
+{
+    search_query_handle_t query = search_database_query(db, query_string, string_length(query_string));
+    if (query == SEARCH_QUERY_INVALID_ID)
+        return SIZE_MAX;
+
+    while (!search_database_query_is_completed(db, query))
+        dispatcher_wait_for_wakeup_main_thread(10);
+
+    const search_result_t* results = search_database_query_results(db, query);
+    const size_t count = array_size(results);
+    search_database_query_dispose(db, query);
+    return count;
+}
+
+TEST_SUITE(BENCH_TEST_SUITE)
+{
+    TEST_CASE("Reports" * doctest::timeout(1800.0))
+    {
+        string_t* report_paths = bench_record_reports();
+        report_t* reports[BENCH_REPORT_COUNT] = {};
+
+        bench_run(STRING_CONST("reports.load"), [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                reports[r] = bench_load_report(report_paths[r]);
+        }, [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                report_deallocate(report_get_handle(reports[r]));
+        });
+
+        for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+            reports[r] = bench_load_report(report_paths[r]);
+
+        // Stocks stay resolved once synced, so each iteration fetches the recorded responses again.
+        bench_run(STRING_CONST("reports.sync"), [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                CHECK(report_sync_titles(reports[r]));
+        }, [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                bench_reset_report_stocks(reports[r]);
+        });
+
+        // Other scenarios read the synced titles.
+        for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+            CHECK(report_sync_titles(reports[r]));
+
+        bench_run(STRING_CONST("reports.columns"), [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+            {
+                while (!report_expression_columns_update(reports[r]))
+                    thread_sleep(1);
+            }
+        }, [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                report_expression_column_reset(reports[r]);
+        });
+
+        // Exported rows read the column values computed once more.
+        for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+        {
+            while (!report_expression_columns_update(reports[r]))
+                thread_sleep(1);
+        }
+
+        string_t* csv_paths = nullptr;
+        foreach(p, report_paths)
+        {
+            string_const_t report_dir = path_directory_name(STRING_ARGS(*p));
+            string_const_t report_file_name = path_base_file_name(STRING_ARGS(*p));
+            char csv_path_buffer[BUILD_MAX_PATHLEN];
+            string_t csv_path = path_concat(STRING_BUFFER(csv_path_buffer), STRING_ARGS(report_dir), STRING_ARGS(report_file_name));
+            csv_path = string_concat(STRING_BUFFER(csv_path_buffer), STRING_ARGS(csv_path), STRING_CONST(".csv"));
+            array_push(csv_paths, string_clone(STRING_ARGS(csv_path)));
+        }
+
+        bench_run(STRING_CONST("reports.export_csv"), [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                CHECK(report_export_csv(reports[r], STRING_ARGS(csv_paths[r])));
+        });
+
+        for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+            CHECK_GT(fs_size(STRING_ARGS(csv_paths[r])), 0);
+
+        bench_run(STRING_CONST("timelines.rebuild"), [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                CHECK_GT(timeline_rebuild(reports[r]), 0);
+        }, [&](unsigned)
+        {
+            for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+                timeline_delete_store(reports[r]);
+        });
+
+        for (int r = 0; r < BENCH_REPORT_COUNT; ++r)
+        {
+            fs_remove_file(STRING_ARGS(csv_paths[r]));
+            fs_remove_file(STRING_ARGS(report_paths[r]));
+            report_deallocate(report_get_handle(reports[r]));
+        }
+        string_array_deallocate(csv_paths);
+        string_array_deallocate(report_paths);
+    }
+
+    TEST_CASE("Search" * doctest::timeout(1800.0))
+    {
+        string_t* records = nullptr;
+        for (int i = 0; i < BENCH_SEARCH_DOCUMENT_COUNT; ++i)
+            array_push(records, bench_record_fundamentals(i));
+
+        search_database_t* db = nullptr;
+        bench_run(STRING_CONST("search.index"), [&](unsigned)
+        {
+            db = search_database_allocate(SearchDatabaseFlags::SkipCommonWords);
+            for (int i = 0; i < BENCH_SEARCH_DOCUMENT_COUNT; ++i)
+            {
+                char code_buffer[16];
+                string_t code = bench_symbol_code(STRING_BUFFER(code_buffer), i);
+                search_index_fundamental_document(db, json_object_t(records[i]), string_to_const(code));
+            }
+        }, [&](unsigned iteration)
+        {
+            // Keep the last database to query it.
+            if (iteration + 1 < bench_iteration_count())
+                search_database_deallocate(db);
+        });
+
+        REQUIRE_NE(db, nullptr);
+        CHECK_EQ(search_database_document_count(db), BENCH_SEARCH_DOCUMENT_COUNT);
+
+        bench_run(STRING_CONST("search.query"), [&](unsigned)
+        {
+            for (const char* query : BENCH_SEARCH_QUERIES)
+                CHECK_NE(bench_search_query_count(db, query), SIZE_MAX);
+        });
+
+        CHECK_GT(bench_search_query_count(db, "energy"), 0);
+
+        search_database_deallocate(db);
+        string_array_deallocate(records);
+    }
+}
+
+#endif // BUILD_TESTS
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2023 Wiimag Inc. All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ */
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS
+
+#include <framework/tests/test_utils.h>
+
+#include <financials.h>
+
+#include <framework/query.h>
+#include <framework/string.h>
+
+#include <foundation/fs.h>
+#include <foundation/path.h>
+#include <foundation/stream.h>
+
+struct financials_store_t;
+
+FOUNDATION_EXTERN financials_store_t* financials_store_build(hash_t key, const json_object_t& json);
+FOUNDATION_EXTERN bool financials_store_save(const financials_store_t* store, const char* path, size_t path_length);
+FOUNDATION_EXTERN financials_store_t* financials_store_load(hash_t key, const char* path, size_t path_length);
+FOUNDATION_EXTERN void financials_store_deallocate(financials_store_t* store);
+
+constexpr const char FINANCIALS_TEST_JSON[] = R"({
+    "Financials": {
+        "Balance_Sheet": {
+            "quarterly": {
+                "2023-06-30": { "date": "2023-06-30", "totalAssets": "1200.5", "cash": "300" },
+                "2023-03-31": { "date": "2023-03-31", "totalAssets": "1100", "cash": "250.25" }
+            },
+            "yearly": {
+                "2022-12-31": { "date": "2022-12-31", "totalAssets": "1000", "cash": "200" }
+            }
+        },
+        "Income_Statement": {
+            "quarterly": {
+                "2023-03-31": { "date": "2023-03-31", "totalRevenue": "420" }
+            }
+        }
+    }
+})";
+
+FOUNDATION_STATIC string_t financials_test_read_file(const char* path, size_t path_length)
+{
+    stream_t* stream = fs_open_file(path, path_length, STREAM_IN | STREAM_BINARY);
+    if (stream == nullptr)
+        return string_t{};
+
+    const size_t size = stream_size(stream);
+    string_t content = string_allocate(size, size + 1);
+    stream_read(stream, content.str, size);
+    stream_deallocate(stream);
+    return content;
+}
+
+FOUNDATION_STATIC bool financials_test_write_file(const char* path, size_t path_length, const void* data, size_t size)
+{
+    stream_t* stream = fs_open_file(path, path_length, STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+    if (stream == nullptr)
+        return false;
+
+    const bool written = stream_write(stream, data, size) == size;
+    stream_deallocate(stream);
+    return written;
+}
+
+TEST_SUITE("Financials")
+{
+    TEST_CASE("Store round trip")
+    {
+        const hash_t key = hash(STRING_CONST("FINTEST.US"));
+        financials_store_t* store = financials_store_build(key, json_object_t(string_const(STRING_CONST(FINANCIALS_TEST_JSON))));
+        REQUIRE_NE(store, nullptr);
+
+        char store_path_buffer[BUILD_MAX_PATHLEN];
+        string_t store_path = string_copy(STRING_BUFFER(store_path_buffer), STRING_ARGS(path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN))));
+        REQUIRE(financials_store_save(store, STRING_ARGS(store_path)));
+        string_const_t temp_path = string_format_static(STRING_CONST("%.*s.tmp"), STRING_FORMAT(store_path));
+        CHECK_FALSE(fs_is_file(STRING_ARGS(temp_path)));
+
+        financials_store_t* loaded_store = financials_store_load(key, STRING_ARGS(store_path));
+        REQUIRE_NE(loaded_store, nullptr);
+
+        // Saving the loaded store produces the same file.
+        char copy_path_buffer[BUILD_MAX_PATHLEN];
+        string_t copy_path = string_copy(STRING_BUFFER(copy_path_buffer), STRING_ARGS(path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN))));
+        REQUIRE(financials_store_save(loaded_store, STRING_ARGS(copy_path)));
+
+        string_t content = financials_test_read_file(STRING_ARGS(store_path));
+        string_t copy_content = financials_test_read_file(STRING_ARGS(copy_path));
+        REQUIRE_GT(content.length, 0);
+        REQUIRE_EQ(copy_content.length, content.length);
+        CHECK_EQ(memcmp(copy_content.str, content.str, content.length), 0);
+
+        string_deallocate(copy_content.str);
+        string_deallocate(content.str);
+        financials_store_deallocate(loaded_store);
+        financials_store_deallocate(store);
+        fs_remove_file(STRING_ARGS(copy_path));
+        fs_remove_file(STRING_ARGS(store_path));
+    }
+
+    TEST_CASE("Store rejects truncated files")
+    {
+        const hash_t key = hash(STRING_CONST("FINTEST.US"));
+        financials_store_t* store = financials_store_build(key, json_object_t(string_const(STRING_CONST(FINANCIALS_TEST_JSON))));
+        REQUIRE_NE(store, nullptr);
+
+        char store_path_buffer[BUILD_MAX_PATHLEN];
+        string_t store_path = string_copy(STRING_BUFFER(store_path_buffer), STRING_ARGS(path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN))));
+        REQUIRE(financials_store_save(store, STRING_ARGS(store_path)));
+        financials_store_deallocate(store);
+
+        string_t content = financials_test_read_file(STRING_ARGS(store_path));
+        REQUIRE_GT(content.length, 8);
+
+        // Missing values are detected before anything gets allocated from the header counts.
+        REQUIRE(financials_test_write_file(STRING_ARGS(store_path), content.str, content.length - 8));
+        CHECK_EQ(financials_store_load(key, STRING_ARGS(store_path)), nullptr);
+
+        // Only the header and a few dates are left.
+        REQUIRE(financials_test_write_file(STRING_ARGS(store_path), content.str, 64));
+        CHECK_EQ(financials_store_load(key, STRING_ARGS(store_path)), nullptr);
+
+        // Trailing bytes do not match the header counts either.
+        string_t padded = string_allocate_concat(STRING_ARGS(content), STRING_CONST("garbage!"));
+        REQUIRE(financials_test_write_file(STRING_ARGS(store_path), padded.str, padded.length));
+        CHECK_EQ(financials_store_load(key, STRING_ARGS(store_path)), nullptr);
+
+        string_deallocate(padded.str);
+        string_deallocate(content.str);
+        fs_remove_file(STRING_ARGS(store_path));
+    }
+}
+
+#endif // BUILD_TESTS
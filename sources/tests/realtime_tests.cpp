@@ -0,0 +1,597 @@
+/*
+ * License: https://wiimag.com/LICENSE
+ * Copyright 2023 Wiimag Inc. All rights reserved.
+ */
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS
+
+#include <framework/tests/test_utils.h>
+#include <framework/tests/bench.h>
+
+#include <stock.h>
+#include <realtime.h>
+
+#include <framework/array.h>
+#include <framework/shared_mutex.h>
+#include <framework/function.h>
+
+#include <foundation/fs.h>
+#include <foundation/path.h>
+#include <foundation/stream.h>
+#include <foundation/atomic.h>
+#include <foundation/thread.h>
+
+#include <doctest/doctest.h>
+
+constexpr int REALTIME_TEST_DAY_COUNT = 180;
+constexpr int REALTIME_TEST_SYMBOL_COUNT = 500;
+constexpr int REALTIME_TEST_RECORDS_PER_DAY = 13; // Every 30 minutes during market hours
+constexpr uint32_t REALTIME_TEST_RING_CAPACITY = 1024;
+constexpr int REALTIME_TEST_RING_TICK_COUNT = 200000;
+constexpr int REALTIME_TEST_RING_READER_COUNT = 4;
+constexpr int REALTIME_TEST_TICK_SYMBOL_COUNT = 1000;
+constexpr int REALTIME_TEST_TICK_SECONDS = 60 * 60;
+constexpr time_t REALTIME_TEST_TICK_START = 1700000000;
+
+struct realtime_ring_test_t
+{
+    realtime_ring_t* ring;
+    realtime_ring_t** rings;
+    stock_realtime_t* stocks;
+    shared_mutex stocks_mutex;
+    atomic32_t running_writers;
+    atomic32_t read_count;
+    atomic32_t error_count;
+};
+
+static realtime_ring_test_t* _realtime_ring_test = nullptr;
+
+FOUNDATION_FORCEINLINE bool operator<(const stock_realtime_record_t& r, const time_t& key)
+{
+    return r.timestamp < key;
+}
+
+FOUNDATION_FORCEINLINE bool operator>(const stock_realtime_record_t& r, const time_t& key)
+{
+    return r.timestamp > key;
+}
+
+FOUNDATION_STATIC stock_realtime_record_t realtime_test_tick(int index)
+{
+    stock_realtime_record_t tick;
+    tick.timestamp = REALTIME_TEST_TICK_START + index;
+    tick.price = 100.0 + ((index * 7) % 101) * 0.01;
+    tick.volume = (double)(1 + index % 13);
+    return tick;
+}
+
+FOUNDATION_STATIC double realtime_test_price(int symbol, int64_t day, int record)
+{
+    return math_round((10.0 + symbol + math_sin((double)(day * REALTIME_TEST_RECORDS_PER_DAY + record) * 0.1) * 2.0) * 100.0) / 100.0;
+}
+
+FOUNDATION_STATIC string_t realtime_test_make_dir(char* buffer, size_t capacity)
+{
+    string_t dir = path_make_temporary(buffer, capacity);
+    fs_make_directory(STRING_ARGS(dir));
+    return dir;
+}
+
+FOUNDATION_STATIC stock_realtime_t* realtime_test_allocate_stocks()
+{
+    stock_realtime_t* stocks = nullptr;
+    for (int i = 0; i < REALTIME_TEST_SYMBOL_COUNT; ++i)
+    {
+        stock_realtime_t stock;
+        string_t code = string_format(STRING_BUFFER(stock.code), STRING_CONST("SYM%03d.US"), i);
+        stock.key = hash(STRING_ARGS(code));
+        stock.records = nullptr;
+        array_push_memcpy(stocks, &stock);
+    }
+    return stocks;
+}
+
+FOUNDATION_STATIC void realtime_test_deallocate_stocks(stock_realtime_t*& stocks)
+{
+    foreach(s, stocks)
+        array_deallocate(s->records);
+    array_deallocate(stocks);
+}
+
+FOUNDATION_STATIC void realtime_test_write_segments(const char* dir, size_t dir_length, int64_t first_day, int day_count)
+{
+    stock_realtime_t* stocks = realtime_test_allocate_stocks();
+    for (int64_t day = first_day; day < first_day + day_count; ++day)
+    {
+        for (int i = 0; i < REALTIME_TEST_SYMBOL_COUNT; ++i)
+        {
+            stock_realtime_t& stock = stocks[i];
+            array_clear(stock.records);
+            for (int r = 0; r < REALTIME_TEST_RECORDS_PER_DAY; ++r)
+            {
+                stock_realtime_record_t record;
+                record.timestamp = (time_t)(day * time_one_day() + (13 * 60 + 30) * 60 + r * 30 * 60);
+                record.price = realtime_test_price(i, day, r);
+                record.volume = (double)((r + 1) * 1000 + i);
+                array_push_memcpy(stock.records, &record);
+            }
+        }
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t file_name = string_format(STRING_BUFFER(path_buffer), STRING_CONST("%lld.segment"), (long long)day);
+        char segment_path_buffer[BUILD_MAX_PATHLEN];
+        string_t segment_path = path_concat(STRING_BUFFER(segment_path_buffer), dir, dir_length, STRING_ARGS(file_name));
+        REQUIRE(realtime_segment_write(STRING_ARGS(segment_path), day, stocks, array_size(stocks)));
+    }
+    realtime_test_deallocate_stocks(stocks);
+}
+
+FOUNDATION_STATIC void* realtime_ring_writer_thread_fn(void* arg)
+{
+    realtime_ring_test_t* test = _realtime_ring_test;
+    for (int i = 0; i < REALTIME_TEST_RING_TICK_COUNT; ++i)
+    {
+        if (!realtime_ring_push(test->ring, realtime_test_tick(i)))
+            atomic_incr32(&test->error_count, memory_order_relaxed);
+    }
+
+    atomic_decr32(&test->running_writers, memory_order_release);
+    return 0;
+}
+
+FOUNDATION_STATIC bool realtime_ring_check_stats(const realtime_stats_t& stats)
+{
+    if (stats.count == 0)
+        return stats.timestamp == 0;
+    if (stats.count > REALTIME_TEST_RING_CAPACITY)
+        return false;
+
+    // Aggregates must match the window of ticks ending at the last tick.
+    const int last = (int)(stats.timestamp - REALTIME_TEST_TICK_START);
+    const int first = last - (int)stats.count + 1;
+    if (first < 0 || stats.price != realtime_test_tick(last).price)
+        return false;
+    if (stats.count > 1 && stats.change != realtime_test_tick(last).price - realtime_test_tick(last - 1).price)
+        return false;
+
+    double min = INFINITY, max = -INFINITY, price_volume_sum = 0, volume_sum = 0;
+    for (int i = first; i <= last; ++i)
+    {
+        const stock_realtime_record_t tick = realtime_test_tick(i);
+        min = ::min(min, tick.price);
+        max = ::max(max, tick.price);
+        price_volume_sum += tick.price * tick.volume;
+        volume_sum += tick.volume;
+    }
+
+    return stats.min == min && stats.max == max && math_abs(stats.vwap - price_volume_sum / volume_sum) < 1e-6;
+}
+
+FOUNDATION_STATIC void* realtime_ring_reader_thread_fn(void* arg)
+{
+    realtime_ring_test_t* test = _realtime_ring_test;
+
+    stock_realtime_record_t* ticks = nullptr;
+    while (atomic_load32(&test->running_writers, memory_order_acquire) > 0)
+    {
+        if (!realtime_ring_check_stats(realtime_ring_read_stats(test->ring)))
+            atomic_incr32(&test->error_count, memory_order_relaxed);
+
+        // Ticks must be a contiguous window of the pushed ticks.
+        array_clear(ticks);
+        const size_t tick_count = realtime_ring_read_ticks(test->ring, 0, ticks);
+        if (tick_count > REALTIME_TEST_RING_CAPACITY)
+            atomic_incr32(&test->error_count, memory_order_relaxed);
+        for (unsigned i = 0; i < tick_count; ++i)
+        {
+            const int index = (int)(ticks[i].timestamp - REALTIME_TEST_TICK_START);
+            if ((i > 0 && ticks[i].timestamp != ticks[i - 1].timestamp + 1) || ticks[i].price != realtime_test_tick(index).price)
+            {
+                atomic_incr32(&test->error_count, memory_order_relaxed);
+                break;
+            }
+        }
+
+        atomic_incr32(&test->read_count, memory_order_relaxed);
+    }
+
+    array_deallocate(ticks);
+    return 0;
+}
+
+/*! Reads the latest values of every symbol like a frame of the realtime window would. */
+FOUNDATION_STATIC void* realtime_tick_ring_reader_thread_fn(void* arg)
+{
+    realtime_ring_test_t* test = _realtime_ring_test;
+
+    double checksum = 0;
+    while (atomic_load32(&test->running_writers, memory_order_acquire) > 0)
+    {
+        for (int i = 0; i < REALTIME_TEST_TICK_SYMBOL_COUNT; ++i)
+        {
+            const realtime_stats_t stats = realtime_ring_read_stats(test->rings[i]);
+            checksum += stats.change_p + stats.vwap;
+        }
+        atomic_incr32(&test->read_count, memory_order_relaxed);
+    }
+
+    return to_ptr(checksum != 0);
+}
+
+/*! Same frame reads on sorted records shared through the stocks mutex, as done before rings. */
+FOUNDATION_STATIC void* realtime_tick_records_reader_thread_fn(void* arg)
+{
+    realtime_ring_test_t* test = _realtime_ring_test;
+
+    double checksum = 0;
+    while (atomic_load32(&test->running_writers, memory_order_acquire) > 0)
+    {
+        for (int i = 0; i < REALTIME_TEST_TICK_SYMBOL_COUNT; ++i)
+        {
+            SHARED_READ_LOCK(test->stocks_mutex);
+            const stock_realtime_t& s = test->stocks[i];
+            const unsigned record_count = array_size(s.records);
+            if (record_count > 1)
+                checksum += (s.records[record_count - 1].price - s.records[record_count - 2].price) / s.records[record_count - 2].price * 100.0;
+        }
+        atomic_incr32(&test->read_count, memory_order_relaxed);
+    }
+
+    return to_ptr(checksum != 0);
+}
+
+FOUNDATION_STATIC double realtime_test_run_tick_readers(thread_fn reader_fn, const function<void(int second, int symbol)>& push_tick)
+{
+    realtime_ring_test_t* test = _realtime_ring_test;
+    atomic_store32(&test->read_count, 0, memory_order_release);
+    atomic_store32(&test->running_writers, 1, memory_order_release);
+
+    thread_t* threads[2];
+    for (size_t i = 0; i < ARRAY_COUNT(threads); ++i)
+    {
+        threads[i] = thread_allocate(reader_fn, nullptr, STRING_CONST("realtime_reader"), THREAD_PRIORITY_NORMAL, 0);
+        thread_start(threads[i]);
+    }
+
+    const tick_t start_time = time_current();
+    for (int second = 0; second < REALTIME_TEST_TICK_SECONDS; ++second)
+    {
+        for (int i = 0; i < REALTIME_TEST_TICK_SYMBOL_COUNT; ++i)
+            push_tick(second, i);
+    }
+    const double elapsed_time = time_elapsed(start_time);
+
+    atomic_store32(&test->running_writers, 0, memory_order_release);
+    for (size_t i = 0; i < ARRAY_COUNT(threads); ++i)
+    {
+        thread_join(threads[i]);
+        thread_deallocate(threads[i]);
+    }
+
+    return elapsed_time;
+}
+
+TEST_SUITE("Realtime")
+{
+    TEST_CASE("Seal journal")
+    {
+        char dir_buffer[BUILD_MAX_PATHLEN];
+        string_t dir = realtime_test_make_dir(STRING_BUFFER(dir_buffer));
+
+        const int64_t day = time_now() / time_one_day() - 2;
+        const time_t day_start = (time_t)(day * time_one_day());
+        stream_t* journal = fs_temporary_file();
+        REQUIRE(journal);
+
+        // Write records out of order and twice to check they are sorted and deduplicated once sealed.
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (int r = 9; r >= 0; --r)
+            {
+                const time_t timestamp = day_start + 14 * 3600 + r * 60;
+                const double price = 100.25 + r * 0.01;
+                const double volume = 1000.0 * r;
+                char code[16] = "AAPL.US";
+                stream_write(journal, &timestamp, sizeof(timestamp));
+                stream_write(journal, code, sizeof(code));
+                stream_write(journal, &price, sizeof(price));
+                stream_write(journal, &volume, sizeof(volume));
+            }
+        }
+
+        int64_t* days = nullptr;
+        REQUIRE(realtime_journal_seal(STRING_ARGS(dir), journal, 0, days));
+        REQUIRE_EQ(array_size(days), 1);
+        CHECK_EQ(days[0], day);
+        REQUIRE(realtime_segment_commit(STRING_ARGS(dir), day));
+
+        // Sealing the same journal again merges with the existing segment.
+        array_deallocate(days);
+        REQUIRE(realtime_journal_seal(STRING_ARGS(dir), journal, 0, days));
+        REQUIRE_EQ(array_size(days), 1);
+        REQUIRE(realtime_segment_commit(STRING_ARGS(dir), day));
+        array_deallocate(days);
+        stream_deallocate(journal);
+
+        realtime_segment_t** segments = realtime_segments_open(STRING_ARGS(dir), day);
+        REQUIRE_EQ(array_size(segments), 1);
+
+        stock_realtime_record_t* records = nullptr;
+        const hash_t key = hash(STRING_CONST("AAPL.US"));
+        CHECK_EQ(realtime_segment_decode(segments[0], key, 0, records), 10);
+        for (unsigned i = 0; i < array_size(records); ++i)
+        {
+            CHECK_EQ(records[i].timestamp, day_start + 14 * 3600 + i * 60);
+            CHECK_EQ(records[i].price, doctest::Approx(100.25 + i * 0.01).epsilon(1e-9));
+            CHECK_EQ(records[i].volume, 1000.0 * i);
+        }
+
+        array_clear(records);
+        CHECK_EQ(realtime_segment_decode(segments[0], key, day_start + 14 * 3600 + 5 * 60, records), 5);
+        CHECK_EQ(realtime_segment_decode(segments[0], hash(STRING_CONST("MSFT.US")), 0, records), 0);
+        array_deallocate(records);
+
+        stock_realtime_t* stocks = nullptr;
+        realtime_segment_register_stocks(segments[0], stocks);
+        REQUIRE_EQ(array_size(stocks), 1);
+        CHECK_EQ(string_const(stocks[0].code, string_length(stocks[0].code)), CTEXT("AAPL.US"));
+        CHECK_EQ(stocks[0].timestamp, day_start + 14 * 3600 + 9 * 60);
+        CHECK_EQ(stocks[0].price, doctest::Approx(100.34));
+        realtime_test_deallocate_stocks(stocks);
+
+        realtime_segments_close(segments);
+        fs_remove_directory(STRING_ARGS(dir));
+    }
+
+    TEST_CASE("Seal journal failure")
+    {
+        // Segments cannot be written in a directory that does not exist.
+        string_t dir = path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN));
+        REQUIRE_FALSE(fs_is_directory(STRING_ARGS(dir)));
+
+        const int64_t day = time_now() / time_one_day() - 2;
+        stream_t* journal = fs_temporary_file();
+        REQUIRE(journal);
+
+        const time_t timestamp = (time_t)(day * time_one_day()) + 14 * 3600;
+        const double price = 100.25, volume = 1000.0;
+        char code[16] = "AAPL.US";
+        stream_write(journal, &timestamp, sizeof(timestamp));
+        stream_write(journal, code, sizeof(code));
+        stream_write(journal, &price, sizeof(price));
+        stream_write(journal, &volume, sizeof(volume));
+
+        // The journal must then be kept, see realtime_compact.
+        int64_t* days = nullptr;
+        CHECK_FALSE(realtime_journal_seal(STRING_ARGS(dir), journal, 0, days));
+        CHECK_EQ(array_size(days), 0);
+        CHECK_FALSE(realtime_segment_commit(STRING_ARGS(dir), day));
+
+        array_deallocate(days);
+        stream_deallocate(journal);
+    }
+
+    TEST_CASE("Expire segments")
+    {
+        char dir_buffer[BUILD_MAX_PATHLEN];
+        string_t dir = realtime_test_make_dir(STRING_BUFFER(dir_buffer));
+
+        const int64_t today = time_now() / time_one_day();
+        realtime_test_write_segments(STRING_ARGS(dir), today - 10, 10);
+
+        realtime_segment_t** segments = realtime_segments_open(STRING_ARGS(dir), today - 4);
+        CHECK_EQ(array_size(segments), 4);
+        realtime_segments_close(segments);
+
+        // Expired segments were deleted
+        string_t* file_names = fs_matching_files(STRING_ARGS(dir), STRING_CONST("^.*\\.segment$"), false);
+        CHECK_EQ(array_size(file_names), 4);
+        string_array_deallocate(file_names);
+
+        fs_remove_directory(STRING_ARGS(dir));
+    }
+
+    TEST_CASE("Benchmark startup" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(120))
+    {
+        char dir_buffer[BUILD_MAX_PATHLEN];
+        string_t dir = realtime_test_make_dir(STRING_BUFFER(dir_buffer));
+
+        const int64_t today = time_now() / time_one_day();
+        const int64_t first_day = today - REALTIME_TEST_DAY_COUNT;
+        tick_t start_time = time_current();
+        realtime_test_write_segments(STRING_ARGS(dir), first_day, REALTIME_TEST_DAY_COUNT);
+        const double write_elapsed_time = time_elapsed(start_time);
+
+        size_t store_size = 0;
+        string_t* file_names = fs_matching_files(STRING_ARGS(dir), STRING_CONST("^.*\\.segment$"), false);
+        foreach(e, file_names)
+        {
+            char path_buffer[BUILD_MAX_PATHLEN];
+            string_t path = path_concat(STRING_BUFFER(path_buffer), STRING_ARGS(dir), STRING_ARGS(*e));
+            store_size += fs_size(STRING_ARGS(path));
+        }
+        string_array_deallocate(file_names);
+
+        // Startup maps the segments and only reads their footer index
+        start_time = time_current();
+        stock_realtime_t* stocks = nullptr;
+        realtime_segment_t** segments = realtime_segments_open(STRING_ARGS(dir), first_day);
+        for (unsigned i = 0, end = array_size(segments); i < end; ++i)
+            realtime_segment_register_stocks(segments[i], stocks);
+        const double startup_elapsed_time = time_elapsed(start_time);
+
+        REQUIRE_EQ(array_size(segments), REALTIME_TEST_DAY_COUNT);
+        REQUIRE_EQ(array_size(stocks), REALTIME_TEST_SYMBOL_COUNT);
+
+        // Decoding every record of every symbol is what the former linear replay did at startup.
+        size_t record_count = 0;
+        stock_realtime_record_t* records = nullptr;
+        start_time = time_current();
+        foreach(s, stocks)
+        {
+            array_clear(records);
+            for (unsigned i = 0, end = array_size(segments); i < end; ++i)
+                record_count += realtime_segment_decode(segments[i], s->key, 0, records);
+        }
+        const double decode_elapsed_time = time_elapsed(start_time);
+        CHECK_EQ(record_count, (size_t)REALTIME_TEST_DAY_COUNT * REALTIME_TEST_SYMBOL_COUNT * REALTIME_TEST_RECORDS_PER_DAY);
+
+        // Prices round trip through the delta encoding
+        array_clear(records);
+        const hash_t key = hash(STRING_CONST("SYM042.US"));
+        REQUIRE_EQ(realtime_segment_decode(segments[7], key, 0, records), REALTIME_TEST_RECORDS_PER_DAY);
+        for (int r = 0; r < REALTIME_TEST_RECORDS_PER_DAY; ++r)
+            CHECK_EQ(records[r].price, doctest::Approx(realtime_test_price(42, first_day + 7, r)).epsilon(1e-9));
+
+        // A graph of the last two days only decodes the matching segments
+        array_clear(records);
+        start_time = time_current();
+        const time_t since = (time_t)((today - 2) * time_one_day());
+        for (unsigned i = 0, end = array_size(segments); i < end; ++i)
+            realtime_segment_decode(segments[i], key, since, records);
+        const double graph_elapsed_time = time_elapsed(start_time);
+        CHECK_EQ(array_size(records), 2 * REALTIME_TEST_RECORDS_PER_DAY);
+
+        MESSAGE(string_format_static_const("%d days x %d symbols (%zu records, %.2lf MB on disk, %.2lf bytes/record), written in %.3lf seconds",
+            REALTIME_TEST_DAY_COUNT, REALTIME_TEST_SYMBOL_COUNT, record_count,
+            store_size / 1024.0 / 1024.0, (double)store_size / record_count, write_elapsed_time));
+        MESSAGE(string_format_static_const("Startup %.3lf ms, full replay %.3lf ms, 2 days graph %.3lf ms",
+            startup_elapsed_time * 1000.0, decode_elapsed_time * 1000.0, graph_elapsed_time * 1000.0));
+
+        array_deallocate(records);
+        realtime_test_deallocate_stocks(stocks);
+        realtime_segments_close(segments);
+        fs_remove_directory(STRING_ARGS(dir));
+    }
+
+    TEST_CASE("Tick ring aggregates")
+    {
+        realtime_ring_t* ring = realtime_ring_allocate(hash(STRING_CONST("RING.US")));
+
+        realtime_stats_t stats = realtime_ring_read_stats(ring);
+        CHECK_EQ(stats.count, 0);
+
+        for (int i = 0; i < 3000; ++i)
+        {
+            REQUIRE(realtime_ring_push(ring, realtime_test_tick(i)));
+            if (i % 97 == 0)
+                CHECK(realtime_ring_check_stats(realtime_ring_read_stats(ring)));
+        }
+
+        // Ticks older than the last one are ignored
+        CHECK_FALSE(realtime_ring_push(ring, realtime_test_tick(2999)));
+        CHECK_FALSE(realtime_ring_push(ring, realtime_test_tick(10)));
+
+        stats = realtime_ring_read_stats(ring);
+        CHECK_EQ(stats.count, REALTIME_TEST_RING_CAPACITY);
+        CHECK_EQ(stats.timestamp, realtime_test_tick(2999).timestamp);
+        CHECK(realtime_ring_check_stats(stats));
+        CHECK_EQ(stats.change_p, doctest::Approx(stats.change / realtime_test_tick(2998).price * 100.0));
+
+        stock_realtime_record_t* ticks = nullptr;
+        CHECK_EQ(realtime_ring_read_ticks(ring, 0, ticks), REALTIME_TEST_RING_CAPACITY);
+        CHECK_EQ(ticks[0].timestamp, realtime_test_tick(3000 - REALTIME_TEST_RING_CAPACITY).timestamp);
+        array_clear(ticks);
+        CHECK_EQ(realtime_ring_read_ticks(ring, realtime_test_tick(2990).timestamp, ticks), 10);
+        CHECK_EQ(ticks[0].timestamp, realtime_test_tick(2990).timestamp);
+        array_deallocate(ticks);
+
+        realtime_ring_deallocate(ring);
+        CHECK_EQ(ring, nullptr);
+    }
+
+    TEST_CASE("Tick ring concurrent readers" * doctest::timeout(60))
+    {
+        _realtime_ring_test = MEM_NEW(0, realtime_ring_test_t);
+        realtime_ring_test_t* test = _realtime_ring_test;
+        test->ring = realtime_ring_allocate(hash(STRING_CONST("RING.US")));
+
+        thread_t* threads[REALTIME_TEST_RING_READER_COUNT + 1];
+        int thread_count = 0;
+        atomic_store32(&test->running_writers, 1, memory_order_release);
+        for (int i = 0; i < REALTIME_TEST_RING_READER_COUNT; ++i)
+            threads[thread_count++] = thread_allocate(realtime_ring_reader_thread_fn, nullptr, STRING_CONST("ring_reader"), THREAD_PRIORITY_NORMAL, 0);
+        threads[thread_count++] = thread_allocate(realtime_ring_writer_thread_fn, nullptr, STRING_CONST("ring_writer"), THREAD_PRIORITY_NORMAL, 0);
+
+        const tick_t start_time = time_current();
+        for (int i = 0; i < thread_count; ++i)
+            thread_start(threads[i]);
+
+        for (int i = 0; i < thread_count; ++i)
+        {
+            thread_join(threads[i]);
+            thread_deallocate(threads[i]);
+        }
+        const double elapsed_time = time_elapsed(start_time);
+
+        CHECK_EQ(atomic_load32(&test->error_count, memory_order_acquire), 0);
+        CHECK_GT(atomic_load32(&test->read_count, memory_order_acquire), 0);
+        CHECK(realtime_ring_check_stats(realtime_ring_read_stats(test->ring)));
+
+        MESSAGE(string_format_static_const("Pushed %d ticks in %.3lf seconds while %d readers read the ring %d times",
+            REALTIME_TEST_RING_TICK_COUNT, elapsed_time, REALTIME_TEST_RING_READER_COUNT, atomic_load32(&test->read_count, memory_order_acquire)));
+
+        realtime_ring_deallocate(test->ring);
+        MEM_DELETE(_realtime_ring_test);
+    }
+
+    TEST_CASE("Benchmark 1000 symbols at 1 second ticks" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(120))
+    {
+        _realtime_ring_test = MEM_NEW(0, realtime_ring_test_t);
+        realtime_ring_test_t* test = _realtime_ring_test;
+
+        for (int i = 0; i < REALTIME_TEST_TICK_SYMBOL_COUNT; ++i)
+        {
+            char code_buffer[16];
+            string_t code = string_format(STRING_BUFFER(code_buffer), STRING_CONST("TICK%03d.US"), i);
+            array_push(test->rings, realtime_ring_allocate(hash(STRING_ARGS(code))));
+
+            stock_realtime_t stock;
+            string_copy(STRING_BUFFER(stock.code), STRING_ARGS(code));
+            stock.key = hash(STRING_ARGS(code));
+            array_push_memcpy(test->stocks, &stock);
+        }
+
+        // Rings, readers never wait for the writer
+        const double ring_elapsed_time = realtime_test_run_tick_readers(realtime_tick_ring_reader_thread_fn, [test](int second, int symbol)
+        {
+            realtime_ring_push(test->rings[symbol], realtime_test_tick(second + symbol));
+        });
+        const int32_t ring_frame_count = atomic_load32(&test->read_count, memory_order_acquire);
+
+        // Sorted records behind the stocks mutex
+        const double records_elapsed_time = realtime_test_run_tick_readers(realtime_tick_records_reader_thread_fn, [test](int second, int symbol)
+        {
+            stock_realtime_record_t tick = realtime_test_tick(second + symbol);
+            SHARED_WRITE_LOCK(test->stocks_mutex);
+            stock_realtime_t& s = test->stocks[symbol];
+            int fidx = array_binary_search(s.records, array_size(s.records), tick.timestamp);
+            if (fidx < 0)
+                array_insert_memcpy(s.records, ~fidx, &tick);
+        });
+        const int32_t records_frame_count = atomic_load32(&test->read_count, memory_order_acquire);
+
+        for (int i = 0; i < REALTIME_TEST_TICK_SYMBOL_COUNT; ++i)
+        {
+            const realtime_stats_t stats = realtime_ring_read_stats(test->rings[i]);
+            CHECK_EQ(stats.count, REALTIME_TEST_RING_CAPACITY);
+            CHECK_EQ(stats.price, array_last(test->stocks[i].records)->price);
+        }
+
+        const size_t tick_count = (size_t)REALTIME_TEST_TICK_SYMBOL_COUNT * REALTIME_TEST_TICK_SECONDS;
+        MESSAGE(string_format_static_const("%d symbols x %d seconds (%zu ticks), rings %.3lf seconds (%.0lf ns/tick, %d reader frames), records %.3lf seconds (%.0lf ns/tick, %d reader frames)",
+            REALTIME_TEST_TICK_SYMBOL_COUNT, REALTIME_TEST_TICK_SECONDS, tick_count,
+            ring_elapsed_time, ring_elapsed_time * 1e9 / tick_count, ring_frame_count,
+            records_elapsed_time, records_elapsed_time * 1e9 / tick_count, records_frame_count));
+
+        for (unsigned i = 0, end = array_size(test->rings); i < end; ++i)
+            realtime_ring_deallocate(test->rings[i]);
+        array_deallocate(test->rings);
+        realtime_test_deallocate_stocks(test->stocks);
+        MEM_DELETE(_realtime_ring_test);
+    }
+}
+
+#endif
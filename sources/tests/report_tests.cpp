@@ -4,12 +4,115 @@
  */
 
 #include <framework/tests/test_utils.h>
+#include <framework/tests/bench.h>
 
 #if BUILD_TESTS
 
+#include "test_helpers.h"
+
 #include <title.h>
 #include <report.h>
 #include <wallet.h>
+#include <stock.h>
+#include <alerts.h>
+
+#include <framework/expr.h>
+#include <framework/dispatcher.h>
+#include <framework/table.h>
+#include <framework/array.h>
+#include <framework/query.h>
+#include <framework/system.h>
+
+#include <foundation/thread.h>
+#include <foundation/environment.h>
+#include <foundation/path.h>
+#include <foundation/fs.h>
+
+constexpr int REPORT_TEST_SUMMARY_TITLE_COUNT = 500;
+constexpr int REPORT_TEST_COLUMNS_TITLE_COUNT = 300;
+constexpr int REPORT_TEST_ALERTS_COUNT = 250;
+
+/*! Create a report with titles whose stocks are resolved offline, each with a few orders. */
+FOUNDATION_STATIC report_handle_t report_test_create_summary_report(stock_t** stocks, int title_count = REPORT_TEST_SUMMARY_TITLE_COUNT)
+{
+    report_handle_t handle = test_report_create(STRING_CONST("USD"));
+    report_t* report = report_get(handle);
+
+    for (int i = 0; i < title_count; ++i)
+    {
+        char code_buffer[16];
+        string_t code = string_format(STRING_BUFFER(code_buffer), STRING_CONST("RSUM%d.US"), i);
+
+        stock_handle_t stock_handle;
+        stock_t* s = test_stock_create(STRING_ARGS(code), &stock_handle);
+        s->current.price = s->current.close = s->current.adjusted_close = 10.0 + i;
+        s->current.change = 0.1;
+        s->current.change_p = 0.1 / (10.0 + i) * 100.0;
+        s->mark_resolved(TITLE_MINIMUM_FETCH_LEVEL);
+        stocks[i] = s;
+
+        title_t* title = report_add_title(report, STRING_ARGS(code));
+        title->stock = stock_handle;
+
+        for (int o = 0; o < 3; ++o)
+            test_title_add_order(title, time_add_days(time_now(), -30 * (3 - o) - i % 30), o != 2 || (i % 4) != 0, 10.0 + o, 9.0 + i + o);
+        title_refresh(title);
+    }
+
+    return handle;
+}
+
+constexpr int REPORT_TEST_SYNC_TITLE_COUNT = 300;
+
+/*! Create a report whose titles resolve from mocked real-time, fundamentals and EOD queries. */
+FOUNDATION_STATIC report_handle_t report_test_create_sync_report()
+{
+    static const char* exchanges[] = { "US", "TO", "V" };
+
+    report_handle_t handle = test_report_create(STRING_CONST("USD"));
+    report_t* report = report_get(handle);
+
+    char date_buffer[16];
+    string_t date = string_from_date(STRING_BUFFER(date_buffer), time_add_days(time_now(), -1));
+    for (int i = 0; i < REPORT_TEST_SYNC_TITLE_COUNT; ++i)
+    {
+        const char* exchange = exchanges[i % ARRAY_COUNT(exchanges)];
+
+        char code_buffer[16];
+        string_t code = string_format(STRING_BUFFER(code_buffer), STRING_CONST("RSYNC%d.%s"), i, exchange);
+
+        test_mock_realtime(STRING_ARGS(code), time_now(), 10 + i);
+
+        char query_buffer[64];
+        char response_buffer[512];
+        string_t query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/fundamentals/%.*s"), STRING_FORMAT(code));
+        string_t response = string_format(STRING_BUFFER(response_buffer),
+            STRING_CONST("{\"General\":{\"Code\":\"RSYNC%d\",\"Type\":\"Common Stock\",\"Name\":\"Sync %d\",\"Exchange\":\"%s\",\"CurrencyCode\":\"USD\"}}"),
+            i, i, exchange);
+        query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(response));
+
+        query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/eod/%.*s"), STRING_FORMAT(code));
+        response = string_format(STRING_BUFFER(response_buffer),
+            STRING_CONST("[{\"date\":\"%.*s\",\"open\":%d,\"high\":%d.5,\"low\":%d,\"close\":%d,\"adjusted_close\":%d,\"volume\":1000}]"),
+            STRING_FORMAT(date), 10 + i, 10 + i, 9 + i, 10 + i, 10 + i);
+        query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(response));
+
+        title_t* title = report_add_title(report, STRING_ARGS(code));
+        test_title_add_order(title, time_add_days(time_now(), -30), true, 10.0, 9.0 + i);
+    }
+
+    return handle;
+}
+
+/*! Move the price of a stock like a realtime update would. */
+FOUNDATION_STATIC void report_test_move_price(stock_t* s, int tick)
+{
+    const double previous_close = s->current.price - s->current.change;
+    s->current.price = s->current.close = s->current.adjusted_close = previous_close + ((tick % 7) - 3) * 0.05;
+    s->current.change = s->current.price - previous_close;
+    s->current.change_p = s->current.change / previous_close * 100.0;
+    s->mark_resolved(FetchLevel::REALTIME);
+}
 
 TEST_SUITE("Report")
 {
@@ -27,17 +130,87 @@ TEST_SUITE("Report")
         report_deallocate(handle);
     }
 
-    TEST_CASE("Buy & Sell Some")
+    TEST_CASE("Wallet history records a day once")
     {
         string_t name = string_random(SHARED_BUFFER(16));
         report_handle_t handle = report_allocate(STRING_ARGS(name));
         report_t* report = report_get(handle);
-        CHECK(report != 0);
-        CHECK_NE(report->wallet, nullptr);
 
+        const time_t today = time_now();
+        wallet_history_record(report, report->wallet, time_add_days(today, -2));
+        wallet_history_record(report, report->wallet, time_add_days(today, -1));
+        wallet_history_record(report, report->wallet, today);
+        CHECK_EQ(array_size(report->wallet->history), 3);
+
+        // Update days that are not the most recent entry.
+        wallet_history_record(report, report->wallet, time_add_days(today, -2));
+        wallet_history_record(report, report->wallet, time_add_days(today, -1));
+        wallet_history_record(report, report->wallet, today);
+        CHECK_EQ(array_size(report->wallet->history), 3);
+
+        // The store must hold a single record per day as well.
+        config_handle_t empty_wallet_data = config_allocate(CONFIG_VALUE_OBJECT);
+        wallet_t* reloaded = wallet_allocate(empty_wallet_data);
+        wallet_history_load(reloaded, STRING_ARGS(string_from_uuid_static(report->id)));
+        CHECK_EQ(array_size(reloaded->history), 3);
+        if (array_size(reloaded->history) == 3)
+        {
+            CHECK(time_date_equal(reloaded->history[0].date, today));
+            CHECK(time_date_equal(reloaded->history[2].date, time_add_days(today, -2)));
+        }
+        wallet_deallocate(reloaded);
+        config_deallocate(empty_wallet_data);
+
+        wallet_history_delete_store(report->wallet);
+        report_deallocate(handle);
+    }
+
+    TEST_CASE("Export wallet history")
+    {
+        string_t name = string_random(SHARED_BUFFER(16));
+        report_handle_t handle = report_allocate(STRING_ARGS(name));
+        report_t* report = report_get(handle);
+
+        const time_t today = time_now();
+        for (int i = 4; i >= 0; --i)
+            wallet_history_record(report, report->wallet, time_add_days(today, -i));
+        REQUIRE_EQ(array_size(report->wallet->history), 5);
+
+        // Exporting the report embeds the history so it can be imported elsewhere.
+        char export_path_buffer[BUILD_MAX_PATHLEN];
+        string_const_t temp_dir = environment_temporary_directory();
+        string_t export_path = path_concat(STRING_BUFFER(export_path_buffer), STRING_ARGS(temp_dir), STRING_CONST("wallet_history_export.json"));
+        REQUIRE(report_save(report, STRING_ARGS(export_path)));
+
+        // The history is not kept in the report config saved in the user cache.
+        CHECK_FALSE(config_is_valid(report->data["wallet"]["history"]));
+
+        config_handle_t exported = config_parse_file(STRING_ARGS(export_path), CONFIG_OPTION_PRESERVE_INSERTION_ORDER);
+        REQUIRE(config_is_valid(exported));
+        CHECK_EQ(config_size(exported["wallet"]["history"]), 5);
+
+        wallet_t* imported = wallet_allocate(exported["wallet"]);
+        CHECK_EQ(array_size(imported->history), 5);
+        if (array_size(imported->history) == 5)
+        {
+            CHECK(time_date_equal(imported->history[0].date, today));
+            CHECK_EQ(imported->history[0].total_value, report->wallet->history[0].total_value);
+        }
+        wallet_deallocate(imported);
+        config_deallocate(exported);
+
+        fs_remove_file(STRING_ARGS(export_path));
+        wallet_history_delete_store(report->wallet);
+        report_deallocate(handle);
+    }
+
+    TEST_CASE("Buy & Sell Some")
+    {
         // Make sure we work in CAD
-        string_deallocate(report->wallet->preferred_currency.str);
-        report->wallet->preferred_currency = string_clone(STRING_CONST("CAD"));
+        report_handle_t handle = test_report_create(STRING_CONST("CAD"));
+        report_t* report = report_get(handle);
+        CHECK(report != 0);
+        CHECK_NE(report->wallet, nullptr);
 
         // Add a title
         title_t* title = report_add_title(report, STRING_CONST("SXP.TO"));
@@ -94,13 +267,9 @@ TEST_SUITE("Report")
 
     TEST_CASE("Buy, Split and Sell")
     {
-        string_t name = string_random(SHARED_BUFFER(16));
-        report_handle_t handle = report_allocate(STRING_ARGS(name));
-        report_t* report = report_get(handle);
-
         // Make sure we work in CAD
-        string_deallocate(report->wallet->preferred_currency.str);
-        report->wallet->preferred_currency = string_clone(STRING_CONST("CAD"));
+        report_handle_t handle = test_report_create(STRING_CONST("CAD"));
+        report_t* report = report_get(handle);
 
         // Add a title
         title_t* title = report_add_title(report, STRING_CONST("SHOP.TO"));
@@ -138,11 +307,8 @@ TEST_SUITE("Report")
 
     TEST_CASE("Buy, Sell All, Re-buy")
     {
-        string_t name = string_random(SHARED_BUFFER(16));
-        report_handle_t handle = report_allocate(STRING_ARGS(name));
+        report_handle_t handle = test_report_create(STRING_CONST("CAD"));
         report_t* report = report_get(handle);
-        string_deallocate(report->wallet->preferred_currency.str);
-        report->wallet->preferred_currency = string_clone(STRING_CONST("CAD"));
 
         title_t* title = report_add_title(report, STRING_CONST("NTR.TO"));
         report_title_buy(report, title, string_to_date(STRING_CONST("2023-05-03")), 110.00, 93.54);
@@ -161,6 +327,291 @@ TEST_SUITE("Report")
 
         report_deallocate(handle);
      }
+
+    TEST_CASE("Summary follows title changes")
+    {
+        stock_t* stocks[REPORT_TEST_SUMMARY_TITLE_COUNT];
+        report_handle_t handle = report_test_create_summary_report(stocks);
+        report_t* report = report_get(handle);
+
+        report_summary_update(report);
+        report_summary_update(report);
+
+        // Change prices and orders of a few titles and compare with a summary recomputed from scratch
+        for (int tick = 0; tick < 50; ++tick)
+            report_test_move_price(stocks[(tick * 37) % REPORT_TEST_SUMMARY_TITLE_COUNT], tick);
+        report_title_buy(report, report->titles[3], time_add_days(time_now(), -2), 5.0, 12.0);
+        report_summary_update(report);
+
+        const double incremental_value = report->total_value;
+        const double incremental_investment = report->total_investment;
+        const double incremental_day_gain = report->total_day_gain;
+        const double incremental_sell_gain = report->wallet->sell_total_projected_gain;
+
+        report_summary_invalidate(report);
+        report_summary_update(report);
+        CHECK_NEAR_EQ(incremental_value, report->total_value);
+        CHECK_NEAR_EQ(incremental_investment, report->total_investment);
+        CHECK_NEAR_EQ(incremental_day_gain, report->total_day_gain);
+        CHECK_NEAR_EQ(incremental_sell_gain, report->wallet->sell_total_projected_gain);
+
+        // Removing a title is a structural change
+        title_t* removed = report->titles[0];
+        const double removed_value = title_get_total_value(removed);
+        array_erase(report->titles, 0);
+        report_summary_update(report);
+        CHECK_NEAR_EQ(report->total_value, incremental_value - removed_value);
+        title_deallocate(removed);
+
+        report_deallocate(handle);
+    }
+
+    TEST_CASE("Benchmark summary update with one title changing per tick" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(300.0))
+    {
+        constexpr int TICK_COUNT = 5000;
+
+        stock_t* stocks[REPORT_TEST_SUMMARY_TITLE_COUNT];
+        report_handle_t handle = report_test_create_summary_report(stocks);
+        report_t* report = report_get(handle);
+
+        report_summary_update(report);
+        report_summary_update(report);
+
+        auto run_ticks = [report, &stocks](bool full)
+        {
+            const tick_t start = time_current();
+            for (int tick = 0; tick < TICK_COUNT; ++tick)
+            {
+                report_test_move_price(stocks[(tick * 37) % REPORT_TEST_SUMMARY_TITLE_COUNT], tick);
+                if (full)
+                    report_summary_invalidate(report);
+                report_summary_update(report);
+            }
+            return time_elapsed(start) * 1000.0 / TICK_COUNT;
+        };
+
+        const double full_update_ms = run_ticks(true);
+        const double incremental_update_ms = run_ticks(false);
+        CHECK_LT(incremental_update_ms, full_update_ms);
+
+        MESSAGE(string_format_static_const("%d titles, %d ticks, full update %.4lf ms/tick, incremental update %.4lf ms/tick (%.1lfx)",
+            REPORT_TEST_SUMMARY_TITLE_COUNT, TICK_COUNT, full_update_ms, incremental_update_ms, full_update_ms / incremental_update_ms));
+
+        report_deallocate(handle);
+    }
+
+    TEST_CASE("Benchmark syncing titles from mocked queries" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(120.0))
+    {
+        report_handle_t handle = report_test_create_sync_report();
+        report_t* report = report_get(handle);
+
+        unsigned progress_count = 0;
+        unsigned progress_errors = 0;
+        double first_title_elapsed = 0;
+
+        const double cpu_time_start = system_process_cpu_time();
+        const tick_t start = time_current();
+        report_sync_t* sync = report_sync_titles_async(report, [&](report_t* r, title_t* t, unsigned resolved_count, unsigned title_count)
+        {
+            // Titles are usable as soon as they are reported, before the whole report is synced.
+            if (r != report || resolved_count != ++progress_count || title_count != REPORT_TEST_SYNC_TITLE_COUNT || !title_is_resolved(t))
+                progress_errors++;
+            if (progress_count == 1)
+                first_title_elapsed = time_elapsed(start);
+        });
+        CHECK_EQ(report_sync_title_count(sync), REPORT_TEST_SYNC_TITLE_COUNT);
+
+        const bool synced = report_sync_wait(sync, 60.0);
+        const double elapsed = time_elapsed(start);
+        const double cpu_time = system_process_cpu_time() - cpu_time_start;
+        CHECK_EQ(report_sync_resolved_count(sync), REPORT_TEST_SYNC_TITLE_COUNT);
+        report_sync_deallocate(sync);
+        CHECK_EQ(sync, nullptr);
+
+        CHECK(synced);
+        CHECK_EQ(progress_count, REPORT_TEST_SYNC_TITLE_COUNT);
+        CHECK_EQ(progress_errors, 0);
+        foreach(pt, report->titles)
+            CHECK(title_is_resolved(*pt));
+
+        // Already resolved titles do not wait on anything.
+        const tick_t resync_start = time_current();
+        CHECK(report_sync_titles(report));
+        const double resync_elapsed = time_elapsed(resync_start);
+
+        MESSAGE(string_format_static_const("%d titles synced in %.3lf seconds (first title after %.3lf seconds, resync %.4lf seconds), "
+            "process CPU time %.3lf seconds (%.0lf%% of one core)",
+            REPORT_TEST_SYNC_TITLE_COUNT, elapsed, first_title_elapsed, resync_elapsed, cpu_time, cpu_time * 100.0 / elapsed));
+
+        report_deallocate(handle);
+    }
+
+    TEST_CASE("Benchmark expression columns" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(600.0))
+    {
+        static const char* expressions[] = {
+            "S($TITLE, price) * 2",
+            "R($REPORT, $TITLE, gain)",
+            "R($REPORT, $TITLE, total_value) / S($TITLE, close)",
+            "S($TITLE, change_p)",
+            "MAX(S($TITLE, open), S($TITLE, close))",
+            "R($REPORT, $TITLE, qty) * S($TITLE, price)",
+            "R($REPORT, $TITLE, days_held)",
+            "IF(R($REPORT, $TITLE, active), 1, 0)",
+            "ROUND(S($TITLE, yesterday) - 1)",
+            "R($REPORT, $TITLE, buy_total_price) + R($REPORT, $TITLE, sell_total_price)"
+        };
+        constexpr int COLUMN_COUNT = ARRAY_COUNT(expressions);
+
+        stock_t* stocks[REPORT_TEST_COLUMNS_TITLE_COUNT];
+        report_handle_t handle = report_test_create_summary_report(stocks, REPORT_TEST_COLUMNS_TITLE_COUNT);
+        report_t* report = report_get(handle);
+        string_const_t report_name = SYMBOL_CONST(report->name);
+
+        config_handle_t columns = config_set_array(report->data, STRING_CONST("columns"));
+        for (int c = 0; c < COLUMN_COUNT; ++c)
+        {
+            char name_buffer[16];
+            string_t name = string_format(STRING_BUFFER(name_buffer), STRING_CONST("C%d"), c);
+            config_handle_t column = config_array_push(columns, CONFIG_VALUE_OBJECT);
+            config_set(column, STRING_CONST("name"), STRING_ARGS(name));
+            config_set(column, STRING_CONST("expression"), expressions[c], string_length(expressions[c]));
+            config_set(column, STRING_CONST("format"), (double)COLUMN_FORMAT_NUMBER);
+        }
+        report_load_expression_columns(report);
+
+        // Previous path: each cell sets the macro variables and parses its expression again.
+        double* expected_values = nullptr;
+        tick_t start = time_current();
+        foreach(pt, report->titles)
+        {
+            const title_t* t = *pt;
+            for (int c = 0; c < COLUMN_COUNT; ++c)
+            {
+                char name_buffer[16];
+                string_t name = string_format(STRING_BUFFER(name_buffer), STRING_CONST("C%d"), c);
+                expr_set_or_create_global_var(STRING_CONST("$TITLE"), expr_result_t(string_const(t->code, t->code_length)));
+                expr_set_or_create_global_var(STRING_CONST("$REPORT"), expr_result_t(report_name));
+                expr_set_or_create_global_var(STRING_CONST("$COLUMN"), expr_result_t(string_to_const(name)));
+                expr_set_or_create_global_var(STRING_CONST("$FORMAT"), expr_result_t((double)COLUMN_FORMAT_NUMBER));
+                array_push(expected_values, eval(expressions[c], string_length(expressions[c])).as_number());
+            }
+        }
+        const double interpreted_elapsed = time_elapsed(start);
+        const int cell_count = REPORT_TEST_COLUMNS_TITLE_COUNT * COLUMN_COUNT;
+
+        // Compiled columns evaluated over all titles on worker threads.
+        start = time_current();
+        while (!report_expression_columns_update(report))
+            thread_sleep(1);
+        const double columns_elapsed = time_elapsed(start);
+
+        int mismatch_count = 0;
+        for (int i = 0; i < REPORT_TEST_COLUMNS_TITLE_COUNT; ++i)
+        {
+            for (int c = 0; c < COLUMN_COUNT; ++c)
+            {
+                const double expected = expected_values[i * COLUMN_COUNT + c];
+                const double value = report_expression_column_value(report, c, report->titles[i]).as_number();
+                if (math_real_is_nan(expected) != math_real_is_nan(value) || 
+                    (!math_real_is_nan(expected) && math_abs(expected - value) > 1e-9 * max(1.0, (double)math_abs(expected))))
+                {
+                    mismatch_count++;
+                }
+            }
+        }
+        array_deallocate(expected_values);
+        CHECK_EQ(mismatch_count, 0);
+        CHECK_LT(columns_elapsed, interpreted_elapsed + cell_count * 0.050);
+
+        MESSAGE(string_format_static_const("%d titles x %d columns populated in %.3lf seconds, "
+            "previous path %.3lf seconds evaluating plus %.1lf seconds of throttling (%.0lfx)",
+            REPORT_TEST_COLUMNS_TITLE_COUNT, COLUMN_COUNT, columns_elapsed, interpreted_elapsed, cell_count * 0.050,
+            (interpreted_elapsed + cell_count * 0.050) / columns_elapsed));
+
+        report_deallocate(handle);
+    }
+
+    TEST_CASE("Benchmark alerts triggered by stock changes" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(120.0))
+    {
+        stock_t* stocks[REPORT_TEST_ALERTS_COUNT];
+        for (int i = 0; i < REPORT_TEST_ALERTS_COUNT; ++i)
+        {
+            char code_buffer[16];
+            string_t code = string_format(STRING_BUFFER(code_buffer), STRING_CONST("RALERT%d.US"), i);
+
+            stock_t* s = test_stock_create(STRING_ARGS(code));
+            s->name = string_table_encode(STRING_ARGS(code));
+            s->current.price = s->current.close = s->current.adjusted_close = 10.0 + i;
+            s->mark_resolved(TITLE_MINIMUM_FETCH_LEVEL);
+            stocks[i] = s;
+
+            REQUIRE(alerts_add_price_increase(STRING_ARGS(code), 11.0 + i));
+        }
+
+        // Let the alerts evaluate once with the current prices.
+        thread_sleep(500);
+        dispatcher_update();
+
+        double delays[REPORT_TEST_ALERTS_COUNT];
+        tick_t changed_ticks[REPORT_TEST_ALERTS_COUNT];
+        for (int i = 0; i < REPORT_TEST_ALERTS_COUNT; ++i)
+        {
+            stock_t* s = stocks[i];
+            string_const_t code = SYMBOL_CONST(s->code);
+            CHECK_FALSE(alerts_is_triggered(STRING_ARGS(code)));
+
+            delays[i] = -1.0;
+            changed_ticks[i] = time_current();
+            s->current.price = s->current.close = s->current.adjusted_close = 12.0 + i;
+            s->mark_resolved(FetchLevel::REALTIME);
+        }
+
+        // Notifications are pushed once the main thread dispatches them.
+        int triggered_count = 0;
+        const tick_t start = time_current();
+        while (triggered_count < REPORT_TEST_ALERTS_COUNT && time_elapsed(start) < 30.0)
+        {
+            dispatcher_update();
+            for (int i = 0; i < REPORT_TEST_ALERTS_COUNT; ++i)
+            {
+                if (delays[i] >= 0)
+                    continue;
+
+                string_const_t code = SYMBOL_CONST(stocks[i]->code);
+                if (!alerts_is_triggered(STRING_ARGS(code)))
+                    continue;
+
+                delays[i] = time_elapsed(changed_ticks[i]) * 1000.0;
+                triggered_count++;
+            }
+            thread_yield();
+        }
+        CHECK_EQ(triggered_count, REPORT_TEST_ALERTS_COUNT);
+
+        double* sorted_delays = nullptr;
+        for (int i = 0; i < REPORT_TEST_ALERTS_COUNT; ++i)
+        {
+            if (delays[i] >= 0)
+                array_push(sorted_delays, delays[i]);
+        }
+        array_sort(sorted_delays, [](const double& a, const double& b) { return a < b ? -1 : (a > b ? 1 : 0); });
+
+        if (array_size(sorted_delays) > 0)
+        {
+            const unsigned count = array_size(sorted_delays);
+            MESSAGE(string_format_static_const("%d price alerts triggered after p50 %.3lf ms, p99 %.3lf ms, max %.3lf ms "
+                "(evaluating one alert every 5 seconds took up to %d seconds)",
+                count, sorted_delays[count / 2], sorted_delays[min(count - 1, (unsigned)math_ceil(count * 0.99) - 1)], sorted_delays[count - 1],
+                REPORT_TEST_ALERTS_COUNT * 5));
+        }
+        array_deallocate(sorted_delays);
+
+        for (int i = 0; i < REPORT_TEST_ALERTS_COUNT; ++i)
+        {
+            string_const_t code = SYMBOL_CONST(stocks[i]->code);
+            CHECK_EQ(alerts_delete(STRING_ARGS(code)), 1);
+        }
+    }
 }
 
 #endif // BUILD_TESTS
@@ -8,6 +8,7 @@
 #if BUILD_TESTS
  
 #include <framework/tests/test_utils.h>
+#include <framework/tests/bench.h>
 
 #include <eod.h>
 #include <stock.h>
@@ -16,8 +17,159 @@
 #include <framework/search_query.h>
 #include <framework/search_database.h>
 #include <framework/array.h>
+#include <framework/query.h>
+#include <framework/function.h>
+#include <framework/dispatcher.h>
 
 #include <foundation/random.h>
+#include <foundation/thread.h>
+#include <foundation/stream.h>
+#include <foundation/bufferstream.h>
+#include <foundation/path.h>
+#include <foundation/fs.h>
+#include <foundation/atomic.h>
+
+struct search_indexer_t;
+typedef function<bool(string_const_t symbol, const function<void(const json_object_t& json)>& index_fn)> search_indexer_fetch_t;
+
+FOUNDATION_EXTERN search_document_handle_t search_index_fundamental_document(search_database_t* db, const json_object_t& json, string_const_t symbol);
+FOUNDATION_EXTERN search_indexer_t* search_indexer_allocate(search_database_t* db, search_database_flags_t flags, const search_indexer_fetch_t& fetch, bool index_extras);
+FOUNDATION_EXTERN void search_indexer_queue(search_indexer_t* indexer, const char* symbol, size_t symbol_length, bool new_document);
+FOUNDATION_EXTERN bool search_indexer_update(search_indexer_t* indexer);
+FOUNDATION_EXTERN double search_indexer_throughput(const search_indexer_t* indexer);
+FOUNDATION_EXTERN void search_indexer_deallocate(search_indexer_t*& indexer);
+FOUNDATION_EXTERN bool search_database_save_stream(search_database_t* db, stream_t* stream);
+
+/*! Number of recorded fundamentals used to benchmark the indexing of an exchange. */
+constexpr unsigned SEARCH_TEST_EXCHANGE_SYMBOL_COUNT = 20000;
+
+constexpr const char* SEARCH_TEST_SECTORS[] = { "Energy", "Technology", "Healthcare", "Utilities", "Financial Services", "Industrials", "Basic Materials" };
+constexpr const char* SEARCH_TEST_INDUSTRIES[] = { "Oil Gas", "Software", "Biotechnology", "Renewable", "Banks", "Aerospace", "Mining", "Semiconductors", "Insurance" };
+constexpr const char* SEARCH_TEST_COUNTRIES[] = { "Canada", "USA", "Germany", "France", "Japan" };
+constexpr const char* SEARCH_TEST_WORDS[] = { "Northern", "Pacific", "Silver", "Quantum", "Atlas", "Harbor", "Summit", "Golden", "Crescent", "Vertex", "Maple", "Orion" };
+
+/*! Generate fundamentals recorded from an exchange, which are all valid for indexing. */
+FOUNDATION_STATIC string_t* search_test_record_fundamentals(unsigned count)
+{
+    string_t* records = nullptr;
+    string_const_t updated_at = string_from_date(time_now());
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const char* sector = SEARCH_TEST_SECTORS[i % ARRAY_COUNT(SEARCH_TEST_SECTORS)];
+        const char* industry = SEARCH_TEST_INDUSTRIES[(i / 7) % ARRAY_COUNT(SEARCH_TEST_INDUSTRIES)];
+        const char* country = SEARCH_TEST_COUNTRIES[(i / 3) % ARRAY_COUNT(SEARCH_TEST_COUNTRIES)];
+        const char* word1 = SEARCH_TEST_WORDS[i % ARRAY_COUNT(SEARCH_TEST_WORDS)];
+        const char* word2 = SEARCH_TEST_WORDS[(i / ARRAY_COUNT(SEARCH_TEST_WORDS)) % ARRAY_COUNT(SEARCH_TEST_WORDS)];
+
+        string_t record = string_allocate_format(STRING_CONST(R"({
+            "General":{"Code":"S%05u","Type":"Common Stock","Name":"%s %s %u","Exchange":"TEST","CurrencyCode":"USD",
+                "Country":"%s","ISIN":"XX%010u","Sector":"%s","Industry":"%s","UpdatedAt":"%.*s","IsDelisted":false,
+                "Description":"%s %s develops %s products for %s customers in %s and abroad."},
+            "Highlights":{"DividendYield":0.0%u,"MarketCapitalization":%u000},
+            "Valuation":{"TrailingPE":%u.5,"ForwardPE":12.25},
+            "Technicals":{"Beta":1.%u,"52WeekHigh":%u}})"),
+            i, word1, word2, i, country, i, sector, industry, STRING_FORMAT(updated_at),
+            word1, word2, industry, sector, country,
+            i % 9, i + 1, i % 40, i % 10, 10 + i % 90);
+        array_push(records, record);
+    }
+
+    return records;
+}
+
+FOUNDATION_STATIC string_t search_test_record_symbol(char* buffer, size_t capacity, unsigned index)
+{
+    return string_format(buffer, capacity, STRING_CONST("S%05u.TEST"), index);
+}
+
+FOUNDATION_STATIC size_t search_test_query_count(search_database_t* db, const char* query_string)
+{
+    search_query_handle_t query = search_database_query(db, query_string, string_length(query_string));
+    if (query == SEARCH_QUERY_INVALID_ID)
+        return SIZE_MAX;
+
+    while (!search_database_query_is_completed(db, query))
+    {
+        if (thread_is_main())
+            dispatcher_wait_for_wakeup_main_thread(10);
+        else
+            thread_yield();
+    }
+
+    const search_result_t* results = search_database_query_results(db, query);
+    const size_t count = array_size(results);
+    search_database_query_dispose(db, query);
+    return count;
+}
+
+/*! Add a document with its own word, words shared with other documents and a rank property. */
+FOUNDATION_STATIC search_document_handle_t search_test_add_ranked_document(search_database_t* db, unsigned rank)
+{
+    char name_buffer[16];
+    string_t name = string_format(STRING_BUFFER(name_buffer), STRING_CONST("D%05u"), rank);
+    search_document_handle_t doc = search_database_add_document(db, STRING_ARGS(name));
+
+    char word_buffer[16];
+    string_t word = string_format(STRING_BUFFER(word_buffer), STRING_CONST("word%05u"), rank);
+    search_database_index_word(db, doc, STRING_ARGS(word));
+    search_database_index_word(db, doc, STRING_CONST("common"));
+    const char* parity = (rank % 2) ? "odd" : "even";
+    search_database_index_word(db, doc, parity, string_length(parity));
+    search_database_index_property(db, doc, STRING_CONST("rank"), (double)rank);
+    return doc;
+}
+
+/*! Add a document with the labels completed in the search window. */
+FOUNDATION_STATIC search_document_handle_t search_test_add_labeled_document(
+    search_database_t* db, const char* symbol, const char* name, const char* isin)
+{
+    search_document_handle_t doc = search_database_add_document(db, symbol, string_length(symbol));
+    const size_t symbol_length = string_length(symbol);
+    const size_t code_length = string_find(symbol, symbol_length, '.', 0);
+    search_database_index_label(db, doc, symbol, symbol_length);
+    if (code_length != STRING_NPOS)
+        search_database_index_label(db, doc, symbol, code_length);
+    search_database_index_label(db, doc, name, string_length(name));
+    search_database_index_label(db, doc, isin, string_length(isin));
+    return doc;
+}
+
+/*! Returns the name of the best document completing the text or an empty string. */
+FOUNDATION_STATIC string_const_t search_test_complete_first(search_database_t* db, const char* text)
+{
+    string_const_t name{};
+    search_result_t* results = search_database_complete(db, text, string_length(text));
+    if (array_size(results) > 0)
+        name = search_database_document_name(db, (search_document_handle_t)results[0].id);
+    array_deallocate(results);
+    return name;
+}
+
+struct search_test_reader_t
+{
+    search_database_t*  db{ nullptr };
+    atomic32_t          running{ 0 };
+    atomic32_t          query_count{ 0 };
+    atomic64_t          total_ticks{ 0 };
+    atomic64_t          max_ticks{ 0 };
+};
+
+FOUNDATION_STATIC void* search_test_reader_thread_fn(void* arg)
+{
+    search_test_reader_t* reader = (search_test_reader_t*)arg;
+    while (atomic_load32(&reader->running, memory_order_acquire))
+    {
+        const tick_t start = time_current();
+        search_test_query_count(reader->db, "common rank<100");
+        const tick_t elapsed = time_diff(start, time_current());
+
+        atomic_add64(&reader->total_ticks, elapsed, memory_order_relaxed);
+        if (elapsed > atomic_load64(&reader->max_ticks, memory_order_relaxed))
+            atomic_store64(&reader->max_ticks, elapsed, memory_order_relaxed);
+        atomic_incr32(&reader->query_count, memory_order_relaxed);
+    }
+    return nullptr;
+}
 
 #include <doctest/doctest.h>
 
@@ -1044,6 +1196,551 @@ TEST_SUITE("SearchQuery")
     {
         // TODO: Add support to explicit index a title in order to run this test
     }
+
+    TEST_CASE("Merge")
+    {
+        search_database_t* db = search_database_allocate();
+        search_database_t* partial = search_database_allocate();
+
+        auto aaa = search_database_add_document(db, STRING_CONST("AAA.TO"));
+        search_database_index_word(db, aaa, STRING_CONST("alpha"));
+        search_database_index_property(db, aaa, STRING_CONST("sector"), STRING_CONST("energy"));
+
+        // Documents are matched by name regardless of their case
+        auto paaa = search_database_add_document(partial, STRING_CONST("aaa.to"));
+        auto pbbb = search_database_add_document(partial, STRING_CONST("BBB.TO"));
+        search_database_index_word(partial, paaa, STRING_CONST("gamma"));
+        search_database_index_word(partial, paaa, STRING_CONST("alpha"));
+        search_database_index_word(partial, pbbb, STRING_CONST("alpha"));
+        search_database_index_property(partial, pbbb, STRING_CONST("sector"), STRING_CONST("energy"));
+        search_database_index_property(partial, pbbb, STRING_CONST("yield"), 3.5);
+
+        CHECK_EQ(search_database_merge(db, partial), 2);
+        CHECK_EQ(search_database_document_count(db), 2);
+        CHECK_EQ(search_database_document_count(partial), 2);
+        CHECK(search_database_is_dirty(db));
+
+        auto bbb = search_database_find_document(db, STRING_CONST("BBB.TO"));
+        REQUIRE_NE(bbb, SEARCH_DOCUMENT_INVALID_ID);
+
+        CHECK_EQ(search_database_word_document_count(db, STRING_CONST("alpha")), 2);
+        CHECK_EQ(search_database_word_document_count(db, STRING_CONST("gamma")), 1);
+        CHECK(search_database_contains_word(db, STRING_CONST("gamma")));
+
+        const char* queries[] = { "sector=energy", "yield>3", "gamma" };
+        const size_t expected_counts[] = { 2, 1, 1 };
+        for (size_t i = 0; i < ARRAY_COUNT(queries); ++i)
+        {
+            search_query_handle_t query = search_database_query(db, queries[i], string_length(queries[i]));
+            REQUIRE_NE(query, SEARCH_QUERY_INVALID_ID);
+            while (!search_database_query_is_completed(db, query))
+                dispatcher_wait_for_wakeup_main_thread(100);
+
+            const search_result_t* results = search_database_query_results(db, query);
+            CHECK_EQ(array_size(results), expected_counts[i]);
+            if (i == 1 && array_size(results) == 1)
+                CHECK_EQ(results[0].id, bbb);
+            CHECK(search_database_query_dispose(db, query));
+        }
+
+        // Merging the same documents again does not duplicate them
+        CHECK_EQ(search_database_merge(db, partial), 2);
+        CHECK_EQ(search_database_document_count(db), 2);
+        CHECK_EQ(search_database_word_document_count(db, STRING_CONST("alpha")), 2);
+
+        search_database_deallocate(partial);
+        search_database_deallocate(db);
+    }
+
+    TEST_CASE("Benchmark indexing 20k recorded fundamentals" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(600))
+    {
+        string_t* records = search_test_record_fundamentals(SEARCH_TEST_EXCHANGE_SYMBOL_COUNT);
+
+        // Serial baseline indexing all documents in the main database
+        search_database_t* serial_db = search_database_allocate(SearchDatabaseFlags::SkipCommonWords);
+        tick_t start_time = time_current();
+        for (unsigned i = 0; i < SEARCH_TEST_EXCHANGE_SYMBOL_COUNT; ++i)
+        {
+            char symbol_buffer[16];
+            string_t symbol = search_test_record_symbol(STRING_BUFFER(symbol_buffer), i);
+            json_object_t json(records[i]);
+            search_index_fundamental_document(serial_db, json, string_to_const(symbol));
+        }
+        const double serial_elapsed_time = time_elapsed(start_time);
+
+        // Pipelined indexing in partial databases merged in bulk
+        search_database_t* pipeline_db = search_database_allocate(SearchDatabaseFlags::SkipCommonWords);
+        search_indexer_t* indexer = search_indexer_allocate(pipeline_db, SearchDatabaseFlags::SkipCommonWords, 
+            [records](string_const_t symbol, const function<void(const json_object_t& json)>& index_fn)
+        {
+            const unsigned index = (unsigned)string_to_uint(symbol.str + 1, 5, false);
+            if (index >= array_size(records))
+                return false;
+            index_fn(json_object_t(records[index]));
+            return true;
+        }, false);
+
+        start_time = time_current();
+        for (unsigned i = 0; i < SEARCH_TEST_EXCHANGE_SYMBOL_COUNT; ++i)
+        {
+            char symbol_buffer[16];
+            string_t symbol = search_test_record_symbol(STRING_BUFFER(symbol_buffer), i);
+            search_indexer_queue(indexer, STRING_ARGS(symbol), true);
+        }
+
+        while (search_indexer_update(indexer))
+            thread_sleep(1);
+        const double pipeline_elapsed_time = time_elapsed(start_time);
+        const double pipeline_throughput = search_indexer_throughput(indexer);
+        search_indexer_deallocate(indexer);
+
+        CHECK_EQ(search_database_document_count(serial_db), SEARCH_TEST_EXCHANGE_SYMBOL_COUNT);
+        CHECK_EQ(search_database_document_count(pipeline_db), SEARCH_TEST_EXCHANGE_SYMBOL_COUNT);
+        CHECK_EQ(search_database_index_count(pipeline_db), search_database_index_count(serial_db));
+        for (const char* word : { "energy", "canada", "quantum", "s00042.test" })
+        {
+            CHECK_EQ(search_database_word_document_count(pipeline_db, word, string_length(word)),
+                search_database_word_document_count(serial_db, word, string_length(word)));
+        }
+
+        MESSAGE(string_format_static_const("%u symbols, serial %.3lf seconds (%.0lf docs/s), pipeline %.3lf seconds (%.0lf docs/s, %.0lf docs/s since allocated)",
+            SEARCH_TEST_EXCHANGE_SYMBOL_COUNT,
+            serial_elapsed_time, SEARCH_TEST_EXCHANGE_SYMBOL_COUNT / serial_elapsed_time,
+            pipeline_elapsed_time, SEARCH_TEST_EXCHANGE_SYMBOL_COUNT / pipeline_elapsed_time, pipeline_throughput));
+
+        search_database_deallocate(pipeline_db);
+        search_database_deallocate(serial_db);
+        string_array_deallocate(records);
+    }
+
+    TEST_CASE("Segments and tombstones" * doctest::timeout(60))
+    {
+        constexpr unsigned DOCUMENT_COUNT = 4000;
+
+        search_database_t* db = search_database_allocate();
+        search_document_handle_t* docs = nullptr;
+        for (unsigned i = 0; i < DOCUMENT_COUNT; ++i)
+            array_push(docs, search_test_add_ranked_document(db, i));
+
+        CHECK_EQ(search_database_document_count(db), DOCUMENT_COUNT);
+        CHECK_EQ(search_database_word_document_count(db, STRING_CONST("common")), DOCUMENT_COUNT);
+        CHECK_EQ(search_test_query_count(db, "rank<100"), 100);
+        const uint32_t index_count = search_database_index_count(db);
+        CHECK_GT(index_count, DOCUMENT_COUNT);
+
+        // Remove all the odd documents
+        for (unsigned i = 1; i < DOCUMENT_COUNT; i += 2)
+            CHECK(search_database_remove_document(db, docs[i]));
+        CHECK_FALSE(search_database_remove_document(db, docs[1]));
+
+        CHECK_EQ(search_database_document_count(db), DOCUMENT_COUNT / 2);
+        CHECK_EQ(search_database_word_document_count(db, STRING_CONST("common")), DOCUMENT_COUNT / 2);
+        CHECK_EQ(search_database_word_document_count(db, STRING_CONST("odd")), 0);
+        CHECK_EQ(search_database_word_document_count(db, STRING_CONST("word00003")), 0);
+        CHECK_EQ(search_test_query_count(db, "rank<100"), 50);
+        CHECK_EQ(search_test_query_count(db, "common"), DOCUMENT_COUNT / 2);
+        CHECK_EQ(search_test_query_count(db, "odd"), 0);
+
+        const uint32_t live_index_count = search_database_index_count(db);
+        CHECK_LT(live_index_count, index_count);
+
+        // Removed slots are not reused while segments still refer to them
+        search_document_handle_t new_doc = search_test_add_ranked_document(db, DOCUMENT_COUNT);
+        CHECK_FALSE(array_contains(docs, new_doc));
+        CHECK_EQ(search_test_query_count(db, "rank>=3999"), 1);
+        CHECK(search_database_remove_document(db, new_doc));
+
+        // Saved indexes drop the tombstones
+        stream_t* stream = buffer_stream_allocate(nullptr, STREAM_IN | STREAM_OUT | STREAM_BINARY, 0, 0, true, true);
+        CHECK(search_database_save(db, stream));
+        stream_seek(stream, 0, STREAM_SEEK_BEGIN);
+
+        search_database_t* loaded = search_database_allocate();
+        CHECK(search_database_load(loaded, stream));
+        CHECK_EQ(search_database_document_count(loaded), DOCUMENT_COUNT / 2);
+        CHECK_EQ(search_database_index_count(loaded), live_index_count);
+        CHECK_EQ(search_database_word_document_count(loaded, STRING_CONST("common")), DOCUMENT_COUNT / 2);
+        CHECK_EQ(search_test_query_count(loaded, "rank<100"), 50);
+        CHECK_EQ(search_test_query_count(loaded, "even"), DOCUMENT_COUNT / 2);
+
+        stream_deallocate(stream);
+        search_database_deallocate(loaded);
+        search_database_deallocate(db);
+        array_deallocate(docs);
+    }
+
+    TEST_CASE("Benchmark insert throughput and query latency while indexing" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(600))
+    {
+        constexpr unsigned DOCUMENT_COUNT = 20000;
+
+        search_test_reader_t reader{};
+        reader.db = search_database_allocate();
+        for (unsigned i = 0; i < 100; ++i)
+            search_test_add_ranked_document(reader.db, i);
+
+        atomic_store32(&reader.running, 1, memory_order_release);
+        thread_t* thread = thread_allocate(search_test_reader_thread_fn, &reader, STRING_CONST("search_reader"), THREAD_PRIORITY_NORMAL, 0);
+        thread_start(thread);
+
+        const tick_t start_time = time_current();
+        for (unsigned i = 100; i < DOCUMENT_COUNT; ++i)
+            search_test_add_ranked_document(reader.db, i);
+        const double elapsed_time = time_elapsed(start_time);
+
+        atomic_store32(&reader.running, 0, memory_order_release);
+        thread_join(thread);
+        thread_deallocate(thread);
+
+        CHECK_EQ(search_database_document_count(reader.db), DOCUMENT_COUNT);
+        CHECK_EQ(search_test_query_count(reader.db, "common rank<100"), 100);
+
+        const int32_t query_count = atomic_load32(&reader.query_count, memory_order_acquire);
+        const double ticks_per_ms = time_ticks_per_second() / 1000.0;
+        const double average_latency = query_count > 0 ? atomic_load64(&reader.total_ticks, memory_order_acquire) / ticks_per_ms / query_count : 0;
+        const double max_latency = atomic_load64(&reader.max_ticks, memory_order_acquire) / ticks_per_ms;
+        MESSAGE(string_format_static_const("%u documents, %u indexes in %.3lf seconds (%.0lf docs/s), %d concurrent queries (avg %.3lf ms, max %.3lf ms)",
+            DOCUMENT_COUNT, search_database_index_count(reader.db), elapsed_time, (DOCUMENT_COUNT - 100) / elapsed_time,
+            query_count, average_latency, max_latency));
+
+        search_database_deallocate(reader.db);
+    }
+
+    TEST_CASE("Map database file" * doctest::timeout(60))
+    {
+        constexpr unsigned DOCUMENT_COUNT = 3000;
+
+        search_database_t* db = search_database_allocate();
+        for (unsigned i = 0; i < DOCUMENT_COUNT; ++i)
+            search_test_add_ranked_document(db, i);
+        CHECK(search_database_remove_document(db, search_database_find_document(db, STRING_CONST("D00001"))));
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = path_make_temporary(STRING_BUFFER(path_buffer));
+        REQUIRE(search_database_save_file(db, STRING_ARGS(path)));
+        CHECK_FALSE(search_database_is_dirty(db));
+
+        search_database_t* mapped = search_database_allocate();
+        REQUIRE(search_database_map(mapped, STRING_ARGS(path)));
+        CHECK_FALSE(search_database_is_dirty(mapped));
+        CHECK_EQ(search_database_document_count(mapped), DOCUMENT_COUNT - 1);
+        CHECK_EQ(search_database_index_count(mapped), search_database_index_count(db));
+        CHECK_EQ(search_database_word_document_count(mapped, STRING_CONST("common")), DOCUMENT_COUNT - 1);
+        CHECK_EQ(search_test_query_count(mapped, "rank<100"), 99);
+        CHECK_EQ(search_test_query_count(mapped, "word00042"), 1);
+        CHECK_EQ(search_database_find_document(mapped, STRING_CONST("D00001")), SEARCH_DOCUMENT_INVALID_ID);
+
+        const search_document_handle_t doc42 = search_database_find_document(mapped, STRING_CONST("D00042"));
+        REQUIRE_NE(doc42, SEARCH_DOCUMENT_INVALID_ID);
+        string_const_t name = search_database_document_name(mapped, doc42);
+        CHECK(string_equal(STRING_ARGS(name), STRING_CONST("D00042")));
+
+        // The mapped database keeps being updated in memory, with new strings growing its string table.
+        for (unsigned i = DOCUMENT_COUNT; i < DOCUMENT_COUNT + 500; ++i)
+            search_test_add_ranked_document(mapped, i);
+        CHECK(search_database_remove_document(mapped, doc42));
+        CHECK(search_database_is_dirty(mapped));
+        CHECK_EQ(search_test_query_count(mapped, "rank>=3000"), 500);
+        CHECK_EQ(search_test_query_count(mapped, "word00042"), 0);
+        CHECK_EQ(search_test_query_count(mapped, "word03333"), 1);
+        CHECK_EQ(search_database_word_document_count(mapped, STRING_CONST("common")), DOCUMENT_COUNT + 500 - 2);
+
+        // Saving over the file being mapped
+        REQUIRE(search_database_save_file(mapped, STRING_ARGS(path)));
+        search_database_t* remapped = search_database_allocate();
+        REQUIRE(search_database_map(remapped, STRING_ARGS(path)));
+        CHECK_EQ(search_database_document_count(remapped), DOCUMENT_COUNT + 500 - 2);
+        CHECK_EQ(search_database_index_count(remapped), search_database_index_count(mapped));
+        CHECK_EQ(search_test_query_count(remapped, "common rank>=2990"), 510);
+        CHECK_EQ(search_test_query_count(remapped, "word00042"), 0);
+
+        search_database_deallocate(remapped);
+        search_database_deallocate(mapped);
+        search_database_deallocate(db);
+        fs_remove_file(STRING_ARGS(path));
+    }
+
+    TEST_CASE("Convert previous database version")
+    {
+        search_database_t* db = search_database_allocate();
+        for (unsigned i = 0; i < 500; ++i)
+            search_test_add_ranked_document(db, i);
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = path_make_temporary(STRING_BUFFER(path_buffer));
+        stream_t* stream = fs_open_file(STRING_ARGS(path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+        REQUIRE(stream);
+        CHECK(search_database_save_stream(db, stream));
+        stream_deallocate(stream);
+
+        // Previous versions cannot be mapped until converted
+        search_database_t* mapped = search_database_allocate();
+        CHECK_FALSE(search_database_map(mapped, STRING_ARGS(path)));
+        REQUIRE(search_database_upgrade_file(STRING_ARGS(path)));
+        CHECK_FALSE(search_database_upgrade_file(STRING_ARGS(path)));
+        REQUIRE(search_database_map(mapped, STRING_ARGS(path)));
+
+        CHECK_EQ(search_database_document_count(mapped), 500);
+        CHECK_EQ(search_database_index_count(mapped), search_database_index_count(db));
+        CHECK_EQ(search_test_query_count(mapped, "even rank<100"), 50);
+
+        search_database_deallocate(mapped);
+        search_database_deallocate(db);
+        fs_remove_file(STRING_ARGS(path));
+    }
+
+    TEST_CASE("Benchmark opening 20k fundamentals database" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(600))
+    {
+        constexpr unsigned WARM_OPEN_COUNT = 10;
+
+        string_t* records = search_test_record_fundamentals(SEARCH_TEST_EXCHANGE_SYMBOL_COUNT);
+        search_database_t* db = search_database_allocate(SearchDatabaseFlags::SkipCommonWords);
+        for (unsigned i = 0; i < SEARCH_TEST_EXCHANGE_SYMBOL_COUNT; ++i)
+        {
+            char symbol_buffer[16];
+            string_t symbol = search_test_record_symbol(STRING_BUFFER(symbol_buffer), i);
+            json_object_t json(records[i]);
+            search_index_fundamental_document(db, json, string_to_const(symbol));
+        }
+        string_array_deallocate(records);
+
+        char stream_path_buffer[BUILD_MAX_PATHLEN];
+        string_t stream_path = path_make_temporary(STRING_BUFFER(stream_path_buffer));
+        stream_t* stream = fs_open_file(STRING_ARGS(stream_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+        REQUIRE(stream);
+        search_database_save_stream(db, stream);
+        stream_deallocate(stream);
+
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = path_make_temporary(STRING_BUFFER(path_buffer));
+        REQUIRE(search_database_save_file(db, STRING_ARGS(path)));
+
+        // Open the database and run a first query, which reads the pages it needs
+        const auto open_database = [](const function<bool(search_database_t* db)>& open_fn, double& query_time)
+        {
+            search_database_t* db = search_database_allocate(SearchDatabaseFlags::SkipCommonWords);
+            const tick_t start_time = time_current();
+            REQUIRE(open_fn(db));
+            const double open_time = time_elapsed(start_time);
+
+            const tick_t query_start_time = time_current();
+            CHECK_GT(search_test_query_count(db, "energy"), 0);
+            query_time = time_elapsed(query_start_time);
+            search_database_deallocate(db);
+            return open_time;
+        };
+
+        const auto load_stream = [&stream_path](search_database_t* db)
+        {
+            stream_t* stream = fs_open_file(STRING_ARGS(stream_path), STREAM_IN | STREAM_BINARY);
+            const bool loaded = stream && search_database_load(db, stream);
+            stream_deallocate(stream);
+            return loaded;
+        };
+        const auto map_file = [&path](search_database_t* db) { return search_database_map(db, STRING_ARGS(path)); };
+
+        double stream_query_time = 0, map_query_time = 0, query_time = 0;
+        const double cold_stream_time = open_database(load_stream, stream_query_time);
+        const double cold_map_time = open_database(map_file, map_query_time);
+
+        double warm_stream_time = 0, warm_map_time = 0;
+        for (unsigned i = 0; i < WARM_OPEN_COUNT; ++i)
+        {
+            warm_stream_time += open_database(load_stream, query_time) / WARM_OPEN_COUNT;
+            warm_map_time += open_database(map_file, query_time) / WARM_OPEN_COUNT;
+        }
+
+        MESSAGE(string_format_static_const("%u documents, version 12 stream load %.3lf ms cold (first query %.3lf ms), %.3lf ms warm, "
+            "mapped %.3lf ms cold (first query %.3lf ms), %.3lf ms warm",
+            search_database_document_count(db),
+            cold_stream_time * 1000.0, stream_query_time * 1000.0, warm_stream_time * 1000.0,
+            cold_map_time * 1000.0, map_query_time * 1000.0, warm_map_time * 1000.0));
+
+        search_database_deallocate(db);
+        fs_remove_file(STRING_ARGS(stream_path));
+        fs_remove_file(STRING_ARGS(path));
+    }
+
+    TEST_CASE("Complete labels")
+    {
+        struct { const char* symbol; const char* name; const char* isin; } companies[] = {
+            { "AAPL.US", "Apple Inc", "US0378331005" },
+            { "AMAT.US", "Applied Materials Inc", "US0382221051" },
+            { "AMZN.US", "Amazon.com Inc", "US0231351067" },
+            { "MSFT.US", "Microsoft Corporation", "US5949181045" },
+            { "MU.US", "Micron Technology Inc", "US5951121038" },
+            { "TSLA.US", "Tesla Inc", "US88160R1014" },
+            { "SHOP.TO", "Shopify Inc", "CA82509L1076" },
+            { "RY.TO", "Royal Bank of Canada", "CA7800871021" },
+            { "TD.TO", "Toronto-Dominion Bank", "CA8911605092" },
+            { "BCE.TO", "BCE Inc", "CA05534B7604" },
+        };
+
+        search_database_t* db = search_database_allocate();
+        for (const auto& c : companies)
+            CHECK_NE(search_test_add_labeled_document(db, c.symbol, c.name, c.isin), SEARCH_DOCUMENT_INVALID_ID);
+
+        struct { const char* text; const char* expected; } relevance[] = {
+            { "aapl", "AAPL.US" },              // Exact code
+            { "AAPL.US", "AAPL.US" },           // Exact symbol
+            { "appl", "AAPL.US" },              // Prefix of the shortest name
+            { "applied", "AMAT.US" },           // Prefix of a longer name
+            { "US0378331005", "AAPL.US" },      // Exact ISIN
+            { "us03782", "AAPL.US" },           // Partial ISIN
+            { "microsft", "MSFT.US" },          // Missing letter
+            { "micorn", "MU.US" },              // Swapped letters
+            { "shopfy", "SHOP.TO" },            // Missing letter
+            { "telsa", "TSLA.US" },             // Swapped letters
+            { "royal bank", "RY.TO" },          // Prefix with spaces
+            { "td", "TD.TO" },                  // Short code
+            { "toronto dominion", "TD.TO" },    // Different separator
+        };
+
+        for (const auto& r : relevance)
+        {
+            string_const_t first = search_test_complete_first(db, r.text);
+            INFO(r.text);
+            CHECK(string_equal(STRING_ARGS(first), r.expected, string_length(r.expected)));
+        }
+
+        // Prefixes complete every document starting with them and nothing else
+        search_result_t* results = search_database_complete(db, STRING_CONST("ap"));
+        CHECK_EQ(array_size(results), 2);
+        array_deallocate(results);
+        CHECK_EQ(search_test_complete_first(db, "zzz").length, 0);
+        CHECK_EQ(search_test_complete_first(db, "xyzwvut").length, 0);
+
+        // Labels are not matched by regular queries
+        CHECK_EQ(search_test_query_count(db, "shopify"), 0);
+
+        // Removed documents are no longer completed
+        CHECK(search_database_remove_document(db, search_database_find_document(db, STRING_CONST("AAPL.US"))));
+        string_const_t first = search_test_complete_first(db, "appl");
+        CHECK(string_equal(STRING_ARGS(first), STRING_CONST("AMAT.US")));
+
+        // Labels are saved with the database and completed from the mapped file
+        char path_buffer[BUILD_MAX_PATHLEN];
+        string_t path = path_make_temporary(STRING_BUFFER(path_buffer));
+        REQUIRE(search_database_save_file(db, STRING_ARGS(path)));
+        search_database_t* mapped = search_database_allocate();
+        REQUIRE(search_database_map(mapped, STRING_ARGS(path)));
+        first = search_test_complete_first(mapped, "microsft");
+        CHECK(string_equal(STRING_ARGS(first), STRING_CONST("MSFT.US")));
+        CHECK_EQ(search_test_complete_first(mapped, "aapl").length, 0);
+
+        search_test_add_labeled_document(mapped, "ENB.TO", "Enbridge Inc", "CA29250N1050");
+        first = search_test_complete_first(mapped, "enbrige");
+        CHECK(string_equal(STRING_ARGS(first), STRING_CONST("ENB.TO")));
+
+        search_database_deallocate(mapped);
+        search_database_deallocate(db);
+        fs_remove_file(STRING_ARGS(path));
+    }
+
+    TEST_CASE("Benchmark completing 150k symbols" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(600))
+    {
+        constexpr unsigned DOCUMENT_COUNT = 150000;
+        constexpr unsigned QUERY_COUNT = 1000;
+        static const char* SYLLABLES[] = {
+            "ka", "mo", "ru", "te", "vi", "lan", "dor", "pex", "sun", "tri", "gal", "net", "zo", "bra", "quin", "fel" };
+
+        // Names made of syllables, so that many labels share trigrams like real company names do.
+        auto make_name = [](char* buffer, size_t capacity, unsigned i) -> string_t
+        {
+            uint32_t seed = i * 2654435761u + 1;
+            size_t length = 0;
+            for (unsigned w = 0, word_count = 2 + (i % 2); w < word_count; ++w)
+            {
+                if (w > 0)
+                    buffer[length++] = ' ';
+                for (unsigned k = 0; k < 3; ++k)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    const char* syllable = SYLLABLES[(seed >> 16) % ARRAY_COUNT(SYLLABLES)];
+                    length += string_copy(buffer + length, capacity - length, syllable, string_length(syllable)).length;
+                }
+            }
+            return string_t{ buffer, length };
+        };
+
+        // Codes of four or five letters spread over the alphabet like exchange tickers.
+        auto make_code = [](char* buffer, size_t capacity, unsigned i) -> string_t
+        {
+            size_t length = 0;
+            for (unsigned n = i + 26 * 26 * 26; n > 0 && length < capacity - 1; n /= 26)
+                buffer[length++] = (char)('A' + (n % 26));
+            buffer[length] = 0;
+            return string_t{ buffer, length };
+        };
+
+        search_database_t* db = search_database_allocate();
+        const tick_t index_start = time_current();
+        for (unsigned i = 0; i < DOCUMENT_COUNT; ++i)
+        {
+            char code_buffer[8], symbol_buffer[16], name_buffer[64], isin_buffer[16];
+            string_t code = make_code(STRING_BUFFER(code_buffer), i);
+            string_t symbol = string_format(STRING_BUFFER(symbol_buffer), STRING_CONST("%.*s.US"), STRING_FORMAT(code));
+            string_t name = make_name(STRING_BUFFER(name_buffer), i);
+            string_t isin = string_format(STRING_BUFFER(isin_buffer), STRING_CONST("US%010u"), i * 7919u);
+            search_test_add_labeled_document(db, symbol.str, name.str, isin.str);
+        }
+        const double index_time = time_elapsed(index_start);
+        REQUIRE_EQ(search_database_document_count(db), DOCUMENT_COUNT);
+
+        auto run_queries = [db](const char* label, const function<string_t(char*, size_t, unsigned)>& make_text)
+        {
+            tick_t total_ticks = 0, max_ticks = 0;
+            unsigned completed_count = 0;
+            for (unsigned q = 0; q < QUERY_COUNT; ++q)
+            {
+                char text_buffer[64];
+                string_t text = make_text(STRING_BUFFER(text_buffer), (q * 7331u) % DOCUMENT_COUNT);
+
+                const tick_t start = time_current();
+                search_result_t* results = search_database_complete(db, STRING_ARGS(text));
+                const tick_t elapsed = time_diff(start, time_current());
+
+                total_ticks += elapsed;
+                max_ticks = max(max_ticks, elapsed);
+                completed_count += array_size(results) > 0 ? 1 : 0;
+                array_deallocate(results);
+            }
+
+            const double ticks_per_ms = time_ticks_per_second() / 1000.0;
+            MESSAGE(string_format_static_const("%s: %u/%u completed (avg %.3lf ms, max %.3lf ms, target 5 ms)",
+                label, completed_count, QUERY_COUNT, total_ticks / ticks_per_ms / QUERY_COUNT, max_ticks / ticks_per_ms));
+            return completed_count;
+        };
+
+        // Prefixes of names as typed
+        CHECK_EQ(run_queries("Name prefixes", [&make_name](char* buffer, size_t capacity, unsigned i)
+        {
+            string_t name = make_name(buffer, capacity, i);
+            name.length = min(name.length, (size_t)5);
+            buffer[name.length] = 0;
+            return name;
+        }), QUERY_COUNT);
+
+        // Names with a missing letter
+        CHECK_EQ(run_queries("Misspelled names", [&make_name](char* buffer, size_t capacity, unsigned i)
+        {
+            string_t name = make_name(buffer, capacity, i);
+            memmove(buffer + 3, buffer + 4, name.length - 3);
+            name.length--;
+            return name;
+        }), QUERY_COUNT);
+
+        // Partial symbols and ISINs
+        CHECK_EQ(run_queries("Codes", make_code), QUERY_COUNT);
+        CHECK_EQ(run_queries("ISINs", [](char* buffer, size_t capacity, unsigned i)
+        {
+            return string_format(buffer, capacity, STRING_CONST("US%010u"), i * 7919u);
+        }), QUERY_COUNT);
+
+        MESSAGE(string_format_static_const("%u documents, %u indexes labeled in %.3lf seconds",
+            DOCUMENT_COUNT, search_database_index_count(db), index_time));
+
+        search_database_deallocate(db);
+    }
 }
 
 #endif // BUILD_TESTS
@@ -8,13 +8,26 @@
 #if BUILD_TESTS
 
 #include <framework/tests/test_utils.h>
+#include <framework/tests/bench.h>
+
+#include "test_helpers.h"
 
 #include <stock.h>
 #include <events.h>
 
 #include <framework/dispatcher.h>
+#include <framework/epoch.h>
+#include <framework/query.h>
+#include <framework/jobs.h>
+#include <framework/array.h>
+#include <framework/system.h>
 
 #include <foundation/system.h>
+#include <foundation/thread.h>
+#include <foundation/atomic.h>
+#include <foundation/path.h>
+#include <foundation/fs.h>
+#include <foundation/stream.h>
 
 #include <doctest/doctest.h>
 
@@ -73,6 +86,221 @@ static const char* stock500[] = {
     "YUM.US", "ZBRA.US", "ZBH.US", "ZION.US", "ZTS.US"
 };
 
+FOUNDATION_EXTERN void stock_swap_history(stock_t* entry, day_result_t* history);
+FOUNDATION_EXTERN stock_eod_bar_t* stock_eod_bars_parse(const json_object_t& json);
+FOUNDATION_EXTERN bool stock_eod_bars_merge(stock_eod_bar_t*& bars, const stock_eod_bar_t* delta, bool* out_changed);
+FOUNDATION_EXTERN stock_eod_bar_t* stock_eod_history_load(const char* path, size_t path_length);
+FOUNDATION_EXTERN bool stock_eod_history_save(const char* path, size_t path_length, const day_result_t* history);
+FOUNDATION_EXTERN day_result_t* stock_eod_history_build(string_const_t code, bool is_index, const stock_eod_bar_t* bars, double& first_price_factor);
+FOUNDATION_EXTERN day_result_t* stock_eod_history_map(const char* path, size_t path_length, stock_history_map_t** out_map);
+FOUNDATION_EXTERN void stock_history_map_deallocate(void* ptr);
+FOUNDATION_EXTERN string_t stock_eod_history_path(char* buffer, size_t capacity, const char* symbol, size_t symbol_length);
+
+constexpr int STOCK_STRESS_RESOLVER_COUNT = 4;
+constexpr int STOCK_STRESS_READER_COUNT = 4;
+constexpr int STOCK_STRESS_STOCK_PER_RESOLVER = 1500;
+constexpr int STOCK_STRESS_HISTORY_SWAPS = 2000;
+constexpr int STOCK_STRESS_HISTORY_SIZE = 64;
+
+struct stock_stress_test_t
+{
+    atomic32_t running_resolvers;
+    atomic32_t running_writers;
+    atomic32_t created_count[STOCK_STRESS_RESOLVER_COUNT];
+    atomicptr_t created_stocks[STOCK_STRESS_RESOLVER_COUNT][STOCK_STRESS_STOCK_PER_RESOLVER];
+    atomic32_t read_count;
+    atomic32_t error_count;
+    stock_handle_t history_handle;
+};
+
+static stock_stress_test_t* _stock_stress_test = nullptr;
+
+FOUNDATION_STATIC string_t stock_stress_code(char* buffer, size_t capacity, int resolver, int index)
+{
+    return string_format(buffer, capacity, STRING_CONST("STRESS%d_%d.TEST"), resolver, index);
+}
+
+FOUNDATION_STATIC void* stock_stress_resolver_thread_fn(void* arg)
+{
+    const int resolver = (int)(uintptr_t)arg;
+    stock_stress_test_t* test = _stock_stress_test;
+
+    char code_buffer[64];
+    for (int i = 0; i < STOCK_STRESS_STOCK_PER_RESOLVER; ++i)
+    {
+        string_t code = stock_stress_code(STRING_BUFFER(code_buffer), resolver, i);
+
+        stock_handle_t handle{};
+        if (stock_initialize(STRING_ARGS(code), &handle) != STATUS_OK || stock_resolve(handle, FetchLevel::NONE) < 0 || handle.ptr == nullptr)
+        {
+            atomic_incr32(&test->error_count, memory_order_relaxed);
+            continue;
+        }
+
+        atomic_store_ptr(&test->created_stocks[resolver][i], (void*)handle.ptr, memory_order_release);
+        atomic_store32(&test->created_count[resolver], i + 1, memory_order_release);
+    }
+
+    atomic_decr32(&test->running_resolvers, memory_order_release);
+    return 0;
+}
+
+FOUNDATION_STATIC void* stock_stress_reader_thread_fn(void* arg)
+{
+    stock_stress_test_t* test = _stock_stress_test;
+
+    uint32_t seed = 1 + (uint32_t)(uintptr_t)arg;
+    char code_buffer[64];
+    while (atomic_load32(&test->running_resolvers, memory_order_acquire) > 0 || atomic_load32(&test->running_writers, memory_order_acquire) > 0)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const int resolver = (seed >> 8) % STOCK_STRESS_RESOLVER_COUNT;
+        const int32_t created_count = atomic_load32(&test->created_count[resolver], memory_order_acquire);
+        if (created_count > 0)
+        {
+            // Stocks created earlier must still be found at the same address.
+            const int index = (seed >> 12) % created_count;
+            string_t code = stock_stress_code(STRING_BUFFER(code_buffer), resolver, index);
+            const stock_t* expected = (const stock_t*)atomic_load_ptr(&test->created_stocks[resolver][index], memory_order_acquire);
+
+            stock_handle_t handle{};
+            handle.id = hash(STRING_ARGS(code));
+            const stock_t* s = nullptr;
+            if (expected == nullptr || !stock_request(handle, &s) || s != expected || s->id != handle.id)
+                atomic_incr32(&test->error_count, memory_order_relaxed);
+        }
+
+        {
+            // Iterate the history while the writer keeps replacing it.
+            EPOCH_SCOPE();
+            const stock_t* s = test->history_handle.ptr;
+            const day_result_t* history = s->history;
+            for (unsigned i = 0, end = array_size(history); i < end; ++i)
+            {
+                if (history[i].date != history[0].date || history[i].close != (double)i)
+                    atomic_incr32(&test->error_count, memory_order_relaxed);
+            }
+        }
+
+        atomic_incr32(&test->read_count, memory_order_relaxed);
+    }
+
+    return 0;
+}
+
+FOUNDATION_STATIC void* stock_stress_history_writer_thread_fn(void* arg)
+{
+    stock_stress_test_t* test = _stock_stress_test;
+    stock_t* s = (stock_t*)test->history_handle.ptr;
+
+    for (int generation = 1; generation <= STOCK_STRESS_HISTORY_SWAPS; ++generation)
+    {
+        day_result_t* history = nullptr;
+        array_reserve(history, STOCK_STRESS_HISTORY_SIZE);
+        for (int i = 0; i < STOCK_STRESS_HISTORY_SIZE; ++i)
+        {
+            day_result_t d{};
+            d.date = generation;
+            d.close = (double)i;
+            array_push_memcpy(history, &d);
+        }
+
+        EPOCH_SCOPE();
+        stock_swap_history(s, history);
+    }
+
+    atomic_decr32(&test->running_writers, memory_order_release);
+    return 0;
+}
+
+constexpr int STOCK_EOD_BENCHMARK_TITLE_COUNT = 300;
+constexpr int STOCK_EOD_BENCHMARK_DAY_COUNT = 2500;
+constexpr int STOCK_EOD_STARTUP_BENCHMARK_TITLE_COUNT = 500;
+constexpr int STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT = 1000;
+constexpr int STOCK_SEARCH_BENCHMARK_ROW_COUNT = 500;
+
+/*! Build an EOD response sorted from the most recent day like the EOD API does. */
+FOUNDATION_STATIC string_t stock_eod_test_json(time_t first_date, int day_count, double adjustment_factor)
+{
+    const size_t capacity = day_count * 160 + 16;
+    string_t json = string_allocate(0, capacity);
+    json = string_append(STRING_ARGS(json), capacity, STRING_CONST("["));
+    for (int i = day_count - 1; i >= 0; --i)
+    {
+        char date_buffer[16];
+        string_t date = string_from_date(STRING_BUFFER(date_buffer), first_date + i * time_one_day());
+        const double close = 100.0 + i * 0.1;
+        char day_buffer[160];
+        string_t day = string_format(STRING_BUFFER(day_buffer),
+            STRING_CONST("{\"date\":\"%.*s\",\"open\":%.2lf,\"high\":%.2lf,\"low\":%.2lf,\"close\":%.2lf,\"adjusted_close\":%.4lf,\"volume\":%d}%s"),
+            STRING_FORMAT(date), close - 0.5, close + 1.0, close - 1.0, close, close * adjustment_factor, 1000 + i, i > 0 ? "," : "");
+        json = string_append(STRING_ARGS(json), capacity, STRING_ARGS(day));
+    }
+    return string_append(STRING_ARGS(json), capacity, STRING_CONST("]"));
+}
+
+FOUNDATION_STATIC stock_eod_bar_t* stock_eod_test_parse(time_t first_date, int day_count, double adjustment_factor, size_t* out_size = nullptr)
+{
+    string_t json_string = stock_eod_test_json(first_date, day_count, adjustment_factor);
+    if (out_size)
+        *out_size = json_string.length;
+    json_object_t json = json_parse(json_string);
+    stock_eod_bar_t* bars = stock_eod_bars_parse(json);
+    string_deallocate(json_string.str);
+    return bars;
+}
+
+FOUNDATION_STATIC bool stock_eod_test_save(const char* path, size_t path_length, const stock_eod_bar_t* bars)
+{
+    double first_price_factor = DNAN;
+    day_result_t* history = stock_eod_history_build(CTEXT("TEST.US"), false, bars, first_price_factor);
+    const bool saved = stock_eod_history_save(path, path_length, history);
+    array_deallocate(history);
+    return saved;
+}
+
+/*! Wait until the history of a stock has some number of days and returns the most recent one. */
+FOUNDATION_STATIC day_result_t stock_eod_test_wait_history(const stock_t* s, unsigned day_count)
+{
+    const tick_t start = time_current();
+    while (time_elapsed(start) < 10.0)
+    {
+        {
+            EPOCH_SCOPE();
+            const day_result_t* history = s->history;
+            if (array_size(history) == day_count)
+                return history[0];
+        }
+        dispatcher_wait_for_wakeup_main_thread(50);
+    }
+
+    return day_result_t{};
+}
+
+/*! Wait until the local EOD history of a symbol is saved with some number of days, then remove it.
+ *
+ *  @return The number of days of the last saved history.
+ */
+FOUNDATION_STATIC unsigned stock_eod_test_remove_history(const char* symbol, size_t symbol_length, unsigned day_count)
+{
+    char history_path_buffer[BUILD_MAX_PATHLEN];
+    string_t history_path = stock_eod_history_path(STRING_BUFFER(history_path_buffer), symbol, symbol_length);
+
+    unsigned saved_count = 0;
+    const tick_t start = time_current();
+    while (saved_count != day_count && time_elapsed(start) < 10.0)
+    {
+        stock_eod_bar_t* bars = stock_eod_history_load(STRING_ARGS(history_path));
+        saved_count = array_size(bars);
+        array_deallocate(bars);
+        if (saved_count != day_count)
+            thread_sleep(10);
+    }
+
+    fs_remove_file(STRING_ARGS(history_path));
+    return saved_count;
+}
+
 // Invalid stock: "WLTW.US", "VIAC.US", "VAR.US", "TWTR.US", "TIF.US", "PBCT.US", "NLOK.US", "ALXN.US", "NBL.US", "NLSN.US", "MYL.US"
 //                "MXIM.US", "LB.US", "KSU.US", "INFO.US", "HFC.US", "FLIR.US", "ETFC.US", "DRE.US"
 
@@ -135,7 +363,7 @@ TEST_SUITE("Stocks")
         CHECK_EQ(s->id, handle.id);
         CHECK_EQ(s->code, handle.code);
         CHECK_EQ(s->history, nullptr);
-        CHECK_EQ(s->history_count, 0);
+        CHECK_EQ(array_size(s->history), 0);
         CHECK_EQ(s->previous, nullptr);
 
         CHECK(math_real_is_nan(s->current.open));
@@ -153,7 +381,7 @@ TEST_SUITE("Stocks")
         const stock_t* s = handle;
         REQUIRE_NE(s, nullptr);
         CHECK_EQ(s->history, nullptr);
-        CHECK_EQ(s->history_count, 0);
+        CHECK_EQ(array_size(s->history), 0);
         CHECK_EQ(s->previous, nullptr);
 
         static bool stock_was_requested = false;
@@ -173,7 +401,10 @@ TEST_SUITE("Stocks")
         string_copy(STRING_BUFFER(realtime.code), STRING_ARGS(code));
 
         while (!s->has_resolve(FetchLevel::REALTIME))
+        {
+            dispatcher_update();
             dispatcher_wait_for_wakeup_main_thread();
+        }
         dispatcher_post_event(EVENT_STOCK_REQUESTED, (void*)&realtime, sizeof(realtime), DISPATCHER_EVENT_OPTION_COPY_DATA);
         dispatcher_poll(nullptr);
         
@@ -233,7 +464,10 @@ TEST_SUITE("Stocks")
         stock_handle_t handle = stock_request(STRING_ARGS(code), FetchLevel::REALTIME);
         
         while (handle->description.fetch() == STRING_TABLE_NULL_SYMBOL)
+        {
+            dispatcher_update();
             dispatcher_wait_for_wakeup_main_thread();
+        }
 
         // This type of fetching does not fetch full level data.
         CHECK_FALSE(handle->has_resolve(FetchLevel::FUNDAMENTALS));
@@ -529,7 +763,10 @@ TEST_SUITE("Stocks")
         CHECK_EQ(s->previous, nullptr);
 
         while (!s->has_resolve(FetchLevel::REALTIME))
+        {
+            dispatcher_update();
             dispatcher_wait_for_wakeup_main_thread();
+        }
 
         const time_t current_date = s->current.date;
         REQUIRE_GT(current_date, 1);
@@ -539,6 +776,7 @@ TEST_SUITE("Stocks")
             dispatcher_wait_for_wakeup_main_thread();
             handle->resolved_level = FetchLevel::NONE;
             stock_update(handle, FetchLevel::REALTIME);
+            dispatcher_update();
             dispatcher_wait_for_wakeup_main_thread();
         }
 
@@ -573,6 +811,508 @@ TEST_SUITE("Stocks")
         REQUIRE_EQ(xgr, 1.0);
     }
 
+    TEST_CASE("Exchange rate weekends and holidays")
+    {
+        // Friday December 30th is followed by a weekend and the New Year's Day holiday on Monday.
+        static const char FX_SERIES[] = R"([
+            {"date":"2022-12-28","adjusted_close":1.351},
+            {"date":"2022-12-29","adjusted_close":1.352},
+            {"date":"2023-01-03","adjusted_close":1.363},
+            {"date":"2022-12-30","adjusted_close":1.353},
+            {"date":"2023-01-04","adjusted_close":1.364},
+            {"date":"2023-01-05","adjusted_close":1.365},
+            {"date":"2023-01-06","adjusted_close":1.366},
+            {"date":"2023-01-09","adjusted_close":1.369}
+        ])";
+        query_mock_register_request_response(STRING_CONST("api/eod/TSAUSD.FOREX"), STRING_CONST(FX_SERIES));
+
+        #define FX_RATE_AT(date) stock_exchange_rate(STRING_CONST("TSA"), STRING_CONST("USD"), string_to_date(STRING_CONST(date)))
+
+        CHECK_EQ(FX_RATE_AT("2022-12-29"), doctest::Approx(1.352));
+        CHECK_EQ(FX_RATE_AT("2022-12-30"), doctest::Approx(1.353));
+
+        // Weekend and holiday use the previous trading day.
+        CHECK_EQ(FX_RATE_AT("2022-12-31"), doctest::Approx(1.353));
+        CHECK_EQ(FX_RATE_AT("2023-01-01"), doctest::Approx(1.353));
+        CHECK_EQ(FX_RATE_AT("2023-01-02"), doctest::Approx(1.353));
+        CHECK_EQ(FX_RATE_AT("2023-01-03"), doctest::Approx(1.363));
+        CHECK_EQ(FX_RATE_AT("2023-01-07"), doctest::Approx(1.366));
+        CHECK_EQ(FX_RATE_AT("2023-01-08"), doctest::Approx(1.366));
+        CHECK_EQ(FX_RATE_AT("2023-01-09"), doctest::Approx(1.369));
+
+        // Dates outside of the series use the closest known rate.
+        CHECK_EQ(FX_RATE_AT("2022-06-01"), doctest::Approx(1.351));
+        CHECK_EQ(FX_RATE_AT("2023-02-15"), doctest::Approx(1.369));
+
+        // A time during the day uses the rate of that day.
+        const time_t afternoon = string_to_date(STRING_CONST("2023-01-05")) + 15 * 60 * 60;
+        CHECK_EQ(stock_exchange_rate(STRING_CONST("TSA"), STRING_CONST("USD"), afternoon), doctest::Approx(1.365));
+
+        #undef FX_RATE_AT
+    }
+
+    TEST_CASE("Exchange rate concurrent readers" * doctest::timeout(30))
+    {
+        static const char FX_SERIES[] = R"([
+            {"date":"2023-03-01","adjusted_close":0.91},
+            {"date":"2023-03-02","adjusted_close":0.92},
+            {"date":"2023-03-03","adjusted_close":0.93},
+            {"date":"2023-03-06","adjusted_close":0.96}
+        ])";
+        query_mock_register_request_response(STRING_CONST("api/eod/TSBUSD.FOREX"), STRING_CONST(FX_SERIES));
+
+        stock_exchange_rate_prefetch(STRING_CONST("TSB"), STRING_CONST("USD"));
+
+        static atomic32_t error_count;
+        atomic_store32(&error_count, 0, memory_order_release);
+
+        job_t* jobs[16];
+        for (int i = 0; i < ARRAY_COUNT(jobs); ++i)
+        {
+            jobs[i] = job_execute([](payload_t* payload)
+            {
+                const time_t sunday = string_to_date(STRING_CONST("2023-03-05"));
+                for (int k = 0; k < 1000; ++k)
+                {
+                    if (math_abs(stock_exchange_rate(STRING_CONST("TSB"), STRING_CONST("USD"), sunday) - 0.93) > 1e-9)
+                        atomic_incr32(&error_count, memory_order_relaxed);
+                }
+                return 0;
+            });
+        }
+
+        for (int i = 0; i < ARRAY_COUNT(jobs); ++i)
+        {
+            while (!job_completed(jobs[i]))
+                thread_yield();
+            job_deallocate(jobs[i]);
+        }
+
+        CHECK_EQ(atomic_load32(&error_count, memory_order_acquire), 0);
+        CHECK_EQ(stock_exchange_rate(STRING_CONST("TSB"), STRING_CONST("USD"), string_to_date(STRING_CONST("2023-03-06"))), doctest::Approx(0.96));
+    }
+
+    TEST_CASE("EOD history merge overlapping days")
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2023-01-02"));
+
+        stock_eod_bar_t* bars = stock_eod_test_parse(first_date, 10, 1.0);
+        REQUIRE_EQ(array_size(bars), 10);
+        CHECK_EQ(bars[0].date, first_date);
+        CHECK_EQ(array_last(bars)->date, first_date + 9 * time_one_day());
+
+        // The delta starts with the last stored day and brings 3 new days.
+        stock_eod_bar_t* delta = stock_eod_test_parse(first_date + 9 * time_one_day(), 4, 1.0);
+        REQUIRE_EQ(array_size(delta), 4);
+        bool changed = false;
+        CHECK(stock_eod_bars_merge(bars, delta, &changed));
+        CHECK(changed);
+        CHECK_EQ(array_size(bars), 13);
+        for (unsigned i = 1; i < array_size(bars); ++i)
+            CHECK_EQ(bars[i].date, bars[i - 1].date + time_one_day());
+
+        // Merging the same bars again changes nothing.
+        CHECK(stock_eod_bars_merge(bars, delta, &changed));
+        CHECK_FALSE(changed);
+        CHECK_EQ(array_size(bars), 13);
+
+        array_deallocate(delta);
+        array_deallocate(bars);
+    }
+
+    TEST_CASE("EOD history merge adjusted days")
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2023-01-02"));
+
+        stock_eod_bar_t* bars = stock_eod_test_parse(first_date, 10, 1.0);
+
+        // A split or a dividend changes the adjusted close of the overlapping day.
+        stock_eod_bar_t* delta = stock_eod_test_parse(first_date + 9 * time_one_day(), 2, 0.5);
+        CHECK_FALSE(stock_eod_bars_merge(bars, delta, nullptr));
+
+        array_deallocate(delta);
+        array_deallocate(bars);
+    }
+
+    TEST_CASE("EOD history store")
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2020-01-01"));
+        stock_eod_bar_t* bars = stock_eod_test_parse(first_date, 100, 0.98);
+
+        double first_price_factor = DNAN;
+        day_result_t* history = stock_eod_history_build(CTEXT("TEST.US"), false, bars, first_price_factor);
+        REQUIRE_GT(array_size(history), 0);
+
+        string_t history_path = path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN));
+        REQUIRE(stock_eod_history_save(STRING_ARGS(history_path), history));
+
+        // The mapped days can be used as is as a stock history.
+        stock_history_map_t* map = nullptr;
+        day_result_t* days = stock_eod_history_map(STRING_ARGS(history_path), &map);
+        REQUIRE(days);
+        REQUIRE(map);
+        REQUIRE_EQ(array_size(days), array_size(history));
+        CHECK_EQ(memcmp(days, history, sizeof(day_result_t) * array_size(history)), 0);
+
+        // Mapped days are copy-on-write, so updating them does not change the file.
+        days[0].ema = 42.0;
+        stock_history_map_deallocate(map);
+
+        stock_eod_bar_t* loaded_bars = stock_eod_history_load(STRING_ARGS(history_path));
+        REQUIRE_EQ(array_size(loaded_bars), array_size(history));
+        CHECK_EQ(array_last(loaded_bars)->date, history[0].date);
+        CHECK_EQ(array_last(loaded_bars)->adjusted_close, history[0].adjusted_close);
+        CHECK_EQ(loaded_bars[0].date, array_last(history)->date);
+        array_deallocate(loaded_bars);
+
+        // A corrupted history is discarded.
+        stream_t* stream = fs_open_file(STRING_ARGS(history_path), STREAM_IN | STREAM_OUT | STREAM_BINARY);
+        REQUIRE(stream);
+        stream_seek(stream, -8, STREAM_SEEK_END);
+        const uint8_t garbage[4] = { 0xDE, 0xAD, 0xBE, 0xEF };
+        stream_write(stream, garbage, sizeof(garbage));
+        stream_deallocate(stream);
+        CHECK_EQ(stock_eod_history_load(STRING_ARGS(history_path)), nullptr);
+
+        array_deallocate(history);
+        array_deallocate(bars);
+        fs_remove_file(STRING_ARGS(history_path));
+    }
+
+    TEST_CASE("EOD history query mock" * doctest::timeout(30.0))
+    {
+        string_t json = stock_eod_test_json(string_to_date(STRING_CONST("2023-01-02")), 5, 1.0);
+        query_mock_register_request_response(STRING_CONST("api/eod/TSTEOD.TEST"), STRING_ARGS(json));
+        string_deallocate(json.str);
+
+        // The first run fetches the full history, later runs only fetch days since the stored ones.
+        stock_handle_t handle = stock_request(STRING_CONST("TSTEOD.TEST"), FetchLevel::EOD);
+        REQUIRE(handle);
+        while (!handle->has_resolve(FetchLevel::EOD))
+            dispatcher_wait_for_wakeup_main_thread();
+
+        const stock_t* s = handle;
+        CHECK_EQ(array_size(s->history), 5);
+        CHECK_EQ(s->history[0].date, string_to_date(STRING_CONST("2023-01-06")));
+        CHECK_EQ(s->history[4].date, string_to_date(STRING_CONST("2023-01-02")));
+        CHECK_EQ(s->history[0].previous_close, doctest::Approx(s->history[1].adjusted_close));
+
+        // Do not leave the history saved in the background in the user EOD directory.
+        CHECK_EQ(stock_eod_test_remove_history(STRING_CONST("TSTEOD.TEST"), 5), 5);
+    }
+
+    TEST_CASE("EOD history query mock overlapping delta" * doctest::timeout(30.0))
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2023-01-02"));
+
+        // Store 10 days, then the delta starts with the last stored day and brings 3 new days.
+        char history_path_buffer[BUILD_MAX_PATHLEN];
+        string_t history_path = stock_eod_history_path(STRING_BUFFER(history_path_buffer), STRING_CONST("TSTEODO.TEST"));
+        stock_eod_bar_t* bars = stock_eod_test_parse(first_date, 10, 1.0);
+        REQUIRE(stock_eod_test_save(STRING_ARGS(history_path), bars));
+        array_deallocate(bars);
+
+        string_t json = stock_eod_test_json(first_date + 9 * time_one_day(), 4, 1.0);
+        query_mock_register_request_response(STRING_CONST("api/eod/TSTEODO.TEST"), STRING_ARGS(json));
+        string_deallocate(json.str);
+
+        // The stored history resolves right away, then the delta gets merged.
+        stock_handle_t handle = stock_request(STRING_CONST("TSTEODO.TEST"), FetchLevel::EOD);
+        REQUIRE(handle);
+        while (!handle->has_resolve(FetchLevel::EOD))
+            dispatcher_wait_for_wakeup_main_thread();
+
+        const day_result_t latest = stock_eod_test_wait_history(handle, 13);
+        CHECK_EQ(latest.date, first_date + 12 * time_one_day());
+        CHECK_EQ(latest.price_factor, doctest::Approx(1.0));
+
+        CHECK_EQ(stock_eod_test_remove_history(STRING_CONST("TSTEODO.TEST"), 13), 13);
+    }
+
+    TEST_CASE("EOD history query mock adjusted delta" * doctest::timeout(30.0))
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2023-01-02"));
+
+        char history_path_buffer[BUILD_MAX_PATHLEN];
+        string_t history_path = stock_eod_history_path(STRING_BUFFER(history_path_buffer), STRING_CONST("TSTEODA.TEST"));
+        stock_eod_bar_t* bars = stock_eod_test_parse(first_date, 10, 1.0);
+        REQUIRE(stock_eod_test_save(STRING_ARGS(history_path), bars));
+        array_deallocate(bars);
+
+        // A split changed the adjusted close of the overlapping day, so the full history gets fetched again,
+        // which the mock answers with the same 4 adjusted days.
+        string_t json = stock_eod_test_json(first_date + 9 * time_one_day(), 4, 0.5);
+        query_mock_register_request_response(STRING_CONST("api/eod/TSTEODA.TEST"), STRING_ARGS(json));
+        string_deallocate(json.str);
+
+        stock_handle_t handle = stock_request(STRING_CONST("TSTEODA.TEST"), FetchLevel::EOD);
+        REQUIRE(handle);
+        while (!handle->has_resolve(FetchLevel::EOD))
+            dispatcher_wait_for_wakeup_main_thread();
+
+        const day_result_t latest = stock_eod_test_wait_history(handle, 4);
+        CHECK_EQ(latest.date, first_date + 12 * time_one_day());
+        CHECK_EQ(latest.price_factor, doctest::Approx(0.5));
+
+        CHECK_EQ(stock_eod_test_remove_history(STRING_CONST("TSTEODA.TEST"), 4), 4);
+    }
+
+    TEST_CASE("Benchmark EOD portfolio refresh" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(60.0))
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2013-01-01"));
+        const time_t last_date = first_date + (STOCK_EOD_BENCHMARK_DAY_COUNT - 1) * time_one_day();
+
+        string_t full_json = stock_eod_test_json(first_date, STOCK_EOD_BENCHMARK_DAY_COUNT, 0.95);
+        string_t delta_json = stock_eod_test_json(last_date, 2, 0.95);
+
+        // Full refresh: download and parse the whole series of each title.
+        tick_t start_time = time_current();
+        stock_eod_bar_t* bars = nullptr;
+        for (int i = 0; i < STOCK_EOD_BENCHMARK_TITLE_COUNT; ++i)
+        {
+            array_deallocate(bars);
+            json_object_t json = json_parse(full_json);
+            bars = stock_eod_bars_parse(json);
+        }
+        const double full_elapsed_time = time_elapsed(start_time);
+        REQUIRE_EQ(array_size(bars), STOCK_EOD_BENCHMARK_DAY_COUNT);
+
+        string_t history_path = path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN));
+        REQUIRE(stock_eod_test_save(STRING_ARGS(history_path), bars));
+        array_deallocate(bars);
+
+        // Incremental refresh: download the new days, then merge them in the stored history.
+        start_time = time_current();
+        for (int i = 0; i < STOCK_EOD_BENCHMARK_TITLE_COUNT; ++i)
+        {
+            json_object_t json = json_parse(delta_json);
+            stock_eod_bar_t* delta = stock_eod_bars_parse(json);
+            bars = stock_eod_history_load(STRING_ARGS(history_path));
+            CHECK(stock_eod_bars_merge(bars, delta, nullptr));
+            CHECK(stock_eod_test_save(STRING_ARGS(history_path), bars));
+            array_deallocate(delta);
+            array_deallocate(bars);
+        }
+        const double delta_elapsed_time = time_elapsed(start_time);
+
+        MESSAGE(string_format_static_const("%d titles full refresh %.2lf MB in %.3lf seconds, incremental refresh %.2lf KB in %.3lf seconds",
+            STOCK_EOD_BENCHMARK_TITLE_COUNT,
+            full_json.length * STOCK_EOD_BENCHMARK_TITLE_COUNT / 1024.0 / 1024.0, full_elapsed_time,
+            delta_json.length * STOCK_EOD_BENCHMARK_TITLE_COUNT / 1024.0, delta_elapsed_time));
+
+        fs_remove_file(STRING_ARGS(history_path));
+        string_deallocate(delta_json.str);
+        string_deallocate(full_json.str);
+    }
+
+    TEST_CASE("Benchmark EOD history startup" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(120.0))
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2019-01-01"));
+        string_t json_string = stock_eod_test_json(first_date, STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT, 0.97);
+
+        day_result_t* history = nullptr;
+        {
+            json_object_t json = json_parse(json_string);
+            stock_eod_bar_t* bars = stock_eod_bars_parse(json);
+            double first_price_factor = DNAN;
+            history = stock_eod_history_build(CTEXT("TEST.US"), false, bars, first_price_factor);
+            array_deallocate(bars);
+        }
+        REQUIRE_GT(array_size(history), 0);
+
+        string_t* history_paths = nullptr;
+        for (int i = 0; i < STOCK_EOD_STARTUP_BENCHMARK_TITLE_COUNT; ++i)
+        {
+            string_t history_path = path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN));
+            REQUIRE(stock_eod_history_save(STRING_ARGS(history_path), history));
+            array_push(history_paths, string_clone(STRING_ARGS(history_path)));
+        }
+
+        // Mapped startup: map the stored histories and only read the most recent day like the watch lists do.
+        // It runs first, so the process peak memory only grows with the pages it reads.
+        size_t mapped_size = 0;
+        double latest_close_sum = 0;
+        stock_history_map_t** maps = nullptr;
+        size_t peak_memory = system_process_peak_memory();
+        tick_t start_time = time_current();
+        foreach(history_path, history_paths)
+        {
+            stock_history_map_t* map = nullptr;
+            day_result_t* days = stock_eod_history_map(STRING_ARGS(*history_path), &map);
+            REQUIRE(days);
+            latest_close_sum += days[0].close;
+            mapped_size += array_size(days) * sizeof(day_result_t);
+            array_push(maps, map);
+        }
+        const double map_elapsed_time = time_elapsed(start_time);
+        const size_t map_peak_memory = system_process_peak_memory() - peak_memory;
+        CHECK_EQ(latest_close_sum, doctest::Approx(history[0].close * STOCK_EOD_STARTUP_BENCHMARK_TITLE_COUNT));
+
+        // Previous startup: parse the downloaded series of each title and build its history.
+        day_result_t** histories = nullptr;
+        peak_memory = system_process_peak_memory();
+        start_time = time_current();
+        for (int i = 0; i < STOCK_EOD_STARTUP_BENCHMARK_TITLE_COUNT; ++i)
+        {
+            json_object_t json = json_parse(json_string);
+            stock_eod_bar_t* bars = stock_eod_bars_parse(json);
+            double first_price_factor = DNAN;
+            array_push(histories, stock_eod_history_build(CTEXT("TEST.US"), false, bars, first_price_factor));
+            array_deallocate(bars);
+        }
+        const double json_elapsed_time = time_elapsed(start_time);
+        const size_t json_peak_memory = system_process_peak_memory() - peak_memory;
+
+        MESSAGE(string_format_static_const("%d titles of %d days, JSON %.3lf seconds for %.2lf MB of peak memory, mapped %.3lf seconds for %.2lf MB of peak memory of %.2lf MB mapped",
+            STOCK_EOD_STARTUP_BENCHMARK_TITLE_COUNT, STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT,
+            json_elapsed_time, json_peak_memory / 1024.0 / 1024.0,
+            map_elapsed_time, map_peak_memory / 1024.0 / 1024.0, mapped_size / 1024.0 / 1024.0));
+
+        foreach(h, histories)
+            array_deallocate(*h);
+        array_deallocate(histories);
+        foreach(map, maps)
+            stock_history_map_deallocate(*map);
+        array_deallocate(maps);
+        foreach(file_path, history_paths)
+        {
+            fs_remove_file(STRING_ARGS(*file_path));
+            string_deallocate(file_path->str);
+        }
+        array_deallocate(history_paths);
+        array_deallocate(history);
+        string_deallocate(json_string.str);
+    }
+
+    TEST_CASE("Benchmark EOD history time to first frame" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(120.0))
+    {
+        const time_t first_date = string_to_date(STRING_CONST("2019-01-01"));
+        const time_t last_date = first_date + (STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT - 1) * time_one_day();
+        string_t full_json = stock_eod_test_json(first_date, STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT, 0.97);
+        string_t delta_json = stock_eod_test_json(last_date, 2, 0.97);
+
+        // Titles of a session with a stored history only fetch new days, others fetch their full history.
+        stock_eod_bar_t* bars = stock_eod_test_parse(first_date, STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT, 0.97);
+        string_t* mapped_symbols = nullptr;
+        string_t* json_symbols = nullptr;
+        for (int i = 0; i < STOCK_EOD_STARTUP_BENCHMARK_TITLE_COUNT; ++i)
+        {
+            char query_buffer[64];
+            string_t symbol = string_format(STRING_BUFFER(query_buffer), STRING_CONST("TSTFFM%d.TEST"), i);
+            array_push(mapped_symbols, string_clone(STRING_ARGS(symbol)));
+
+            char history_path_buffer[BUILD_MAX_PATHLEN];
+            string_t history_path = stock_eod_history_path(STRING_BUFFER(history_path_buffer), STRING_ARGS(symbol));
+            REQUIRE(stock_eod_test_save(STRING_ARGS(history_path), bars));
+
+            string_t query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/eod/TSTFFM%d.TEST"), i);
+            query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(delta_json));
+
+            symbol = string_format(STRING_BUFFER(query_buffer), STRING_CONST("TSTFFJ%d.TEST"), i);
+            array_push(json_symbols, string_clone(STRING_ARGS(symbol)));
+
+            query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/eod/TSTFFJ%d.TEST"), i);
+            query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(full_json));
+        }
+        array_deallocate(bars);
+
+        // The first frame of a report can show values once every title has resolved its EOD history.
+        const auto time_to_first_frame = [](const string_t* symbols, size_t& out_peak_memory)
+        {
+            const size_t peak_memory = system_process_peak_memory();
+            const tick_t start_time = time_current();
+
+            stock_handle_t* handles = nullptr;
+            foreach(symbol, symbols)
+                array_push(handles, stock_request(STRING_ARGS(*symbol), FetchLevel::EOD));
+
+            for (unsigned resolved_count = 0; resolved_count < array_size(handles);)
+            {
+                resolved_count = 0;
+                foreach(h, handles)
+                    resolved_count += (*h)->has_resolve(FetchLevel::EOD) ? 1 : 0;
+                if (resolved_count < array_size(handles))
+                    dispatcher_wait_for_wakeup_main_thread(10);
+            }
+
+            const double elapsed_time = time_elapsed(start_time);
+            out_peak_memory = system_process_peak_memory() - peak_memory;
+            array_deallocate(handles);
+            return elapsed_time;
+        };
+
+        // Mapped histories first, so the process peak memory only grows with what they use.
+        size_t mapped_peak_memory = 0, json_peak_memory = 0;
+        const double mapped_elapsed_time = time_to_first_frame(mapped_symbols, mapped_peak_memory);
+        const double json_elapsed_time = time_to_first_frame(json_symbols, json_peak_memory);
+
+        MESSAGE(string_format_static_const("%d titles of %d days, time to first frame JSON %.3lf seconds for %.2lf MB of peak memory, mapped %.3lf seconds for %.2lf MB of peak memory",
+            STOCK_EOD_STARTUP_BENCHMARK_TITLE_COUNT, STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT,
+            json_elapsed_time, json_peak_memory / 1024.0 / 1024.0,
+            mapped_elapsed_time, mapped_peak_memory / 1024.0 / 1024.0));
+
+        // Remove the histories saved in the background once the new days are merged.
+        foreach(symbol, mapped_symbols)
+        {
+            stock_eod_test_remove_history(STRING_ARGS(*symbol), STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT + 1);
+            string_deallocate(symbol->str);
+        }
+        foreach(json_symbol, json_symbols)
+        {
+            stock_eod_test_remove_history(STRING_ARGS(*json_symbol), STOCK_EOD_STARTUP_BENCHMARK_DAY_COUNT);
+            string_deallocate(json_symbol->str);
+        }
+        array_deallocate(mapped_symbols);
+        array_deallocate(json_symbols);
+        string_deallocate(delta_json.str);
+        string_deallocate(full_json.str);
+    }
+
+    TEST_CASE("Benchmark resolving search results real-time data" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(60.0))
+    {
+        for (int i = 0; i < STOCK_SEARCH_BENCHMARK_ROW_COUNT; ++i)
+        {
+            char code_buffer[16];
+            string_t code = string_format(STRING_BUFFER(code_buffer), STRING_CONST("SRCH%d.US"), i);
+            test_mock_realtime(STRING_ARGS(code), time_now(), 10 + i);
+        }
+
+        // Search result rows request the real-time data of their symbol as they get displayed.
+        const unsigned request_count_start = query_mock_request_count();
+        const tick_t start = time_current();
+        stock_handle_t handles[STOCK_SEARCH_BENCHMARK_ROW_COUNT];
+        for (int i = 0; i < STOCK_SEARCH_BENCHMARK_ROW_COUNT; ++i)
+        {
+            char code_buffer[16];
+            string_t code = string_format(STRING_BUFFER(code_buffer), STRING_CONST("SRCH%d.US"), i);
+            handles[i] = stock_request(STRING_ARGS(code), FetchLevel::REALTIME);
+        }
+
+        int resolved_count = 0;
+        while (resolved_count < STOCK_SEARCH_BENCHMARK_ROW_COUNT && time_elapsed(start) < 30.0)
+        {
+            resolved_count = 0;
+            for (int i = 0; i < STOCK_SEARCH_BENCHMARK_ROW_COUNT; ++i)
+                resolved_count += handles[i]->has_resolve(FetchLevel::REALTIME) ? 1 : 0;
+            dispatcher_update();
+            thread_yield();
+        }
+        const double elapsed = time_elapsed(start);
+        const unsigned request_count = query_mock_request_count() - request_count_start;
+
+        REQUIRE_EQ(resolved_count, STOCK_SEARCH_BENCHMARK_ROW_COUNT);
+        for (int i = 0; i < STOCK_SEARCH_BENCHMARK_ROW_COUNT; ++i)
+        {
+            const stock_t* s = handles[i];
+            CHECK_EQ(s->fetch_errors, 0);
+            CHECK_EQ(s->current.close, doctest::Approx(10.25 + i));
+        }
+        CHECK_LT(request_count, STOCK_SEARCH_BENCHMARK_ROW_COUNT / 10);
+
+        MESSAGE(string_format_static_const("%d search results resolved in %.3lf seconds with %u real-time queries (%d queries before batching)",
+            STOCK_SEARCH_BENCHMARK_ROW_COUNT, elapsed, request_count, STOCK_SEARCH_BENCHMARK_ROW_COUNT));
+    }
+
     TEST_CASE("History")
     {
         string_const_t code = CTEXT("AVGO.US");
@@ -666,6 +1406,66 @@ TEST_SUITE("Stocks")
         stock = stock_resolve(STRING_CONST("NONEXISTING.STOCK"), FetchLevel::FUNDAMENTALS);
         REQUIRE_FALSE(stock);
     }
+
+    TEST_CASE("Stable addresses under concurrent resolvers and readers" * doctest::timeout(60))
+    {
+        _stock_stress_test = MEM_NEW(0, stock_stress_test_t);
+        stock_stress_test_t* test = _stock_stress_test;
+
+        REQUIRE_EQ(stock_initialize(STRING_CONST("STRESS.HISTORY"), &test->history_handle), STATUS_OK);
+        REQUIRE_GE(stock_resolve(test->history_handle, FetchLevel::NONE), 0);
+        REQUIRE_NE(test->history_handle.ptr, nullptr);
+
+        thread_t* threads[STOCK_STRESS_RESOLVER_COUNT + STOCK_STRESS_READER_COUNT + 1];
+        int thread_count = 0;
+        atomic_store32(&test->running_resolvers, STOCK_STRESS_RESOLVER_COUNT, memory_order_release);
+        atomic_store32(&test->running_writers, 1, memory_order_release);
+        for (int i = 0; i < STOCK_STRESS_RESOLVER_COUNT; ++i)
+            threads[thread_count++] = thread_allocate(stock_stress_resolver_thread_fn, (void*)(uintptr_t)i, STRING_CONST("stock_resolver"), THREAD_PRIORITY_NORMAL, 0);
+        for (int i = 0; i < STOCK_STRESS_READER_COUNT; ++i)
+            threads[thread_count++] = thread_allocate(stock_stress_reader_thread_fn, (void*)(uintptr_t)i, STRING_CONST("stock_reader"), THREAD_PRIORITY_NORMAL, 0);
+        threads[thread_count++] = thread_allocate(stock_stress_history_writer_thread_fn, nullptr, STRING_CONST("stock_writer"), THREAD_PRIORITY_NORMAL, 0);
+
+        const tick_t start_time = time_current();
+        for (int i = 0; i < thread_count; ++i)
+            thread_start(threads[i]);
+
+        // Reclaim retired memory like the main loop would do.
+        size_t released_count = 0;
+        while (atomic_load32(&test->running_resolvers, memory_order_acquire) > 0 || atomic_load32(&test->running_writers, memory_order_acquire) > 0)
+        {
+            released_count += epoch_collect();
+            thread_yield();
+        }
+
+        for (int i = 0; i < thread_count; ++i)
+        {
+            thread_join(threads[i]);
+            thread_deallocate(threads[i]);
+        }
+        const double elapsed_time = time_elapsed(start_time);
+
+        CHECK_EQ(atomic_load32(&test->error_count, memory_order_acquire), 0);
+        CHECK_GT(atomic_load32(&test->read_count, memory_order_acquire), 0);
+        for (int i = 0; i < STOCK_STRESS_RESOLVER_COUNT; ++i)
+            CHECK_EQ(atomic_load32(&test->created_count[i], memory_order_acquire), STOCK_STRESS_STOCK_PER_RESOLVER);
+
+        // Once every reader left, all retired memory can be released.
+        const tick_t collect_time = time_current();
+        while (epoch_pending_count() > 0 && time_elapsed(collect_time) < 5.0)
+        {
+            released_count += epoch_collect();
+            thread_yield();
+        }
+        CHECK_EQ(epoch_pending_count(), 0);
+        CHECK_GE(released_count, (size_t)STOCK_STRESS_HISTORY_SWAPS);
+
+        MESSAGE(string_format_static_const("Created %d stocks and swapped history %d times in %.3lf seconds while reading %d times",
+            STOCK_STRESS_RESOLVER_COUNT * STOCK_STRESS_STOCK_PER_RESOLVER, STOCK_STRESS_HISTORY_SWAPS, elapsed_time,
+            atomic_load32(&test->read_count, memory_order_acquire)));
+
+        MEM_DELETE(_stock_stress_test);
+    }
 }
 
 #endif // BUILD_TESTS
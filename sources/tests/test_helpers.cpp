@@ -0,0 +1,76 @@
+/*
+ * License: https://wiimag.com/LICENSE
+ * Copyright 2023 Wiimag Inc. All rights reserved.
+ */
+
+#include <framework/tests/test_utils.h>
+
+#if BUILD_TESTS
+
+#include "test_helpers.h"
+
+#include <title.h>
+#include <report.h>
+#include <wallet.h>
+#include <stock.h>
+
+#include <framework/query.h>
+
+void test_mock_realtime(const char* code, size_t code_length, time_t timestamp, int price)
+{
+    char query_buffer[64];
+    char response_buffer[512];
+    string_t query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/real-time/%.*s"), (int)code_length, code);
+    string_t response = string_format(STRING_BUFFER(response_buffer),
+        STRING_CONST("{\"code\":\"%.*s\",\"timestamp\":%lld,\"gmtoffset\":0,\"open\":%d,\"high\":%d.5,\"low\":%d,\"close\":%d.25,"
+            "\"volume\":1000,\"previousClose\":%d,\"change\":0.25,\"change_p\":0.1}"),
+        (int)code_length, code, (long long)timestamp, price, price, price - 1, price, price);
+    query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(response));
+}
+
+stock_t* test_stock_create(const char* code, size_t code_length, stock_handle_t* out_handle /*= nullptr*/)
+{
+    stock_handle_t handle;
+    REQUIRE_EQ(stock_initialize(code, code_length, &handle), STATUS_OK);
+    REQUIRE_GE(stock_resolve(handle, FetchLevel::NONE), 0);
+
+    stock_t* s = (stock_t*)handle.ptr;
+    s->currency = string_table_encode(STRING_CONST("USD"));
+    if (out_handle)
+        *out_handle = handle;
+    return s;
+}
+
+report_handle_t test_report_create(const char* currency, size_t currency_length, const char* name /*= nullptr*/, size_t name_length /*= 0*/)
+{
+    if (name == nullptr)
+    {
+        string_t random_name = string_random(SHARED_BUFFER(16));
+        name = random_name.str;
+        name_length = random_name.length;
+    }
+
+    report_handle_t handle = report_allocate(name, name_length);
+    report_t* report = report_get(handle);
+    string_deallocate(report->wallet->preferred_currency.str);
+    report->wallet->preferred_currency = string_clone(currency, currency_length);
+    return handle;
+}
+
+void test_title_add_order(title_t* title, time_t date, bool buy, double qty, double price)
+{
+    config_handle_t orders = config_set_array(title->data, STRING_CONST("orders"));
+    config_handle_t order = config_array_push(orders, CONFIG_VALUE_OBJECT);
+    string_const_t date_str = string_from_date(date);
+    config_set(order, STRING_CONST("date"), STRING_ARGS(date_str));
+    if (buy)
+        config_set(order, STRING_CONST("buy"), true);
+    else
+        config_set(order, STRING_CONST("sell"), true);
+    config_set(order, STRING_CONST("qty"), qty);
+    config_set(order, STRING_CONST("price"), price);
+    config_set(order, STRING_CONST("split"), 1.0);
+    config_set(order, STRING_CONST("xcg"), 1.0);
+}
+
+#endif // BUILD_TESTS
@@ -0,0 +1,59 @@
+/*
+ * License: https://wiimag.com/LICENSE
+ * Copyright 2023 Wiimag Inc. All rights reserved.
+ *
+ * Setup helpers shared by the application test cases, i.e. mocked stock queries and reports with orders.
+ */
+
+#pragma once
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS
+
+#include <stock.h>
+#include <report.h>
+
+struct title_t;
+
+/*! Register the mocked real-time response of a symbol.
+ *
+ *  @param code         Symbol code, i.e. "SRCH1.US".
+ *  @param code_length  Length of the symbol code.
+ *  @param timestamp    Time of the real-time quote.
+ *  @param price        Open and previous close of the quote, other prices are derived from it.
+ */
+void test_mock_realtime(const char* code, size_t code_length, time_t timestamp, int price);
+
+/*! Create a stock resolved offline, so that nothing gets fetched for it.
+ *
+ *  @param code         Symbol code of the stock.
+ *  @param code_length  Length of the symbol code.
+ *  @param out_handle   Receives the stock handle if not null.
+ *
+ *  @return The stock, using USD as its currency.
+ */
+stock_t* test_stock_create(const char* code, size_t code_length, stock_handle_t* out_handle = nullptr);
+
+/*! Allocate a report using a given currency.
+ *
+ *  @param currency         Preferred currency of the report wallet.
+ *  @param currency_length  Length of the currency.
+ *  @param name             Name of the report, a random name is used if null.
+ *  @param name_length      Length of the report name.
+ *
+ *  @return Handle of the new report.
+ */
+report_handle_t test_report_create(const char* currency, size_t currency_length, const char* name = nullptr, size_t name_length = 0);
+
+/*! Add an order to a title. The order already has its split factor and exchange rate so that nothing gets fetched.
+ *
+ *  @param title    Title receiving the order.
+ *  @param date     Date of the order.
+ *  @param buy      True for a buy order, otherwise a sell order.
+ *  @param qty      Quantity of the order.
+ *  @param price    Price of the order.
+ */
+void test_title_add_order(title_t* title, time_t date, bool buy, double qty, double price);
+
+#endif // BUILD_TESTS
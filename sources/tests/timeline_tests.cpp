@@ -0,0 +1,498 @@
+/*
+ * Copyright 2023 Wiimag Inc. All rights reserved.
+ * License: https://wiimag.com/LICENSE
+ */
+
+#include <foundation/platform.h>
+
+#if BUILD_TESTS
+
+#include <framework/tests/test_utils.h>
+#include <framework/tests/bench.h>
+
+#include "test_helpers.h"
+
+#include <stock.h>
+#include <timeline.h>
+
+#include <framework/array.h>
+#include <framework/string.h>
+#include <framework/query.h>
+
+#include <foundation/fs.h>
+#include <foundation/path.h>
+
+struct timeline_valuation_t;
+
+FOUNDATION_EXTERN void stock_swap_history(stock_t* entry, day_result_t* history);
+FOUNDATION_EXTERN const double* timeline_valuation_update(timeline_valuation_t* valuation, const timeline_transaction_t* transactions, string_const_t preferred_currency, time_t until);
+FOUNDATION_EXTERN timeline_valuation_t* timeline_valuation_load(const char* path, size_t path_length);
+FOUNDATION_EXTERN bool timeline_valuation_save(const timeline_valuation_t* valuation, const char* path, size_t path_length);
+FOUNDATION_EXTERN void timeline_valuation_deallocate(timeline_valuation_t*& valuation);
+FOUNDATION_EXTERN void timeline_transactions_prepare(timeline_transaction_t* transactions, string_const_t preferred_currency);
+
+constexpr int TIMELINE_TEST_TITLE_COUNT = 200;
+constexpr int TIMELINE_TEST_DAY_COUNT = 10 * 365;
+constexpr int TIMELINE_TEST_ORDER_INTERVAL = 90;
+constexpr int TIMELINE_TEST_ORDER_COUNT = 20000;
+
+static bool _timeline_test_stocks_created = false;
+
+struct timeline_test_position_t
+{
+    const timeline_transaction_t* transaction;
+    double qty;
+};
+
+FOUNDATION_STATIC time_t timeline_test_first_date()
+{
+    return string_to_date(STRING_CONST("2013-01-02"));
+}
+
+/*! Stocks stay in the stock database until shutdown, so test stocks use an exchange that no real symbol or other test uses. */
+FOUNDATION_STATIC string_t timeline_test_code(char* buffer, size_t capacity, int index)
+{
+    return string_format(buffer, capacity, STRING_CONST("TLV%d.TLTEST"), index);
+}
+
+/*! Create stocks with a daily history skipping weekends, sorted from the most recent day. */
+FOUNDATION_STATIC void timeline_test_create_stocks()
+{
+    if (_timeline_test_stocks_created)
+        return;
+    _timeline_test_stocks_created = true;
+
+    const time_t first_date = timeline_test_first_date();
+    for (int i = 0; i < TIMELINE_TEST_TITLE_COUNT; ++i)
+    {
+        char code_buffer[16];
+        string_t code = timeline_test_code(STRING_BUFFER(code_buffer), i);
+
+        stock_t* s = test_stock_create(STRING_ARGS(code));
+
+        day_result_t* history = nullptr;
+        array_reserve(history, TIMELINE_TEST_DAY_COUNT);
+        for (int d = TIMELINE_TEST_DAY_COUNT - 1; d >= 0; --d)
+        {
+            if (d % 7 == 5 || d % 7 == 6)
+                continue;
+
+            day_result_t ed{};
+            ed.date = first_date + d * time_one_day();
+            ed.close = ed.adjusted_close = 10.0 + i + d * 0.01;
+            array_push_memcpy(history, &ed);
+        }
+
+        stock_swap_history(s, history);
+        s->mark_resolved(FetchLevel::EOD);
+    }
+}
+
+FOUNDATION_STATIC timeline_transaction_t* timeline_test_transactions()
+{
+    const time_t first_date = timeline_test_first_date();
+
+    timeline_transaction_t* transactions = nullptr;
+    for (int d = 0; d < TIMELINE_TEST_DAY_COUNT; ++d)
+    {
+        for (int i = 0; i < TIMELINE_TEST_TITLE_COUNT; ++i)
+        {
+            // Each title gets an order every few months, starting at different days.
+            const int title_day = d - (i * 3) % TIMELINE_TEST_ORDER_INTERVAL;
+            if (title_day < 0 || title_day % TIMELINE_TEST_ORDER_INTERVAL != 0)
+                continue;
+
+            const int order_index = title_day / TIMELINE_TEST_ORDER_INTERVAL;
+            timeline_transaction_t t{};
+            t.date = first_date + d * time_one_day();
+            timeline_test_code(STRING_BUFFER(t.code), i);
+            t.code_key = string_hash(t.code, string_length(t.code));
+            t.type = (order_index % 3 == 2) ? TimelineTransactionType::SELL : TimelineTransactionType::BUY;
+            t.qty = 10.0 + (order_index % 5);
+            t.price = 10.0 + i;
+            t.exchange_rate = 1.0;
+            array_push(transactions, t);
+        }
+    }
+
+    return transactions;
+}
+
+/*! Orders of each title in the order they are read from a report, some titles having many orders on the same day. */
+FOUNDATION_STATIC timeline_transaction_t* timeline_test_orders()
+{
+    const time_t first_date = timeline_test_first_date();
+
+    uint32_t seed = 42;
+    timeline_transaction_t* transactions = nullptr;
+    array_reserve(transactions, TIMELINE_TEST_ORDER_COUNT);
+    for (int i = 0; i < TIMELINE_TEST_ORDER_COUNT; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const int title = i * TIMELINE_TEST_TITLE_COUNT / TIMELINE_TEST_ORDER_COUNT;
+
+        timeline_transaction_t t{};
+        timeline_test_code(STRING_BUFFER(t.code), title);
+        t.code_key = string_hash(t.code, string_length(t.code));
+
+        // Some orders are made on the same day as the previous order of the title.
+        const timeline_transaction_t* previous = array_last(transactions);
+        if ((seed >> 28) < 4 && previous && previous->code_key == t.code_key)
+            t.date = previous->date;
+        else
+            t.date = first_date + ((seed >> 8) % TIMELINE_TEST_DAY_COUNT) * time_one_day();
+        t.type = (seed >> 4) % 3 == 0 ? TimelineTransactionType::SELL : TimelineTransactionType::BUY;
+        t.qty = 1.0 + (seed >> 12) % 100;
+        t.price = 10.0 + title;
+        t.exchange_rate = (seed >> 20) % 2 == 0 ? 1.25 : DNAN;
+
+        // Split factors of orders on trading days are resolved from the history, others are set by the user.
+        const int day = (int)((t.date - first_date) / time_one_day());
+        t.split_factor = (seed >> 24) % 2 == 0 && day % 7 != 5 && day % 7 != 6 ? DNAN : 1.0;
+        array_push(transactions, t);
+    }
+
+    return transactions;
+}
+
+FOUNDATION_STATIC int timeline_test_same_day_count(const timeline_transaction_t* transactions, hash_t code, time_t date)
+{
+    int counter = 0;
+    foreach(t, transactions)
+    {
+        if (t->code_key == code && t->date == date)
+            counter++;
+    }
+
+    return counter;
+}
+
+/*! Resolve and sort orders one by one the way the timeline did before transactions were prepared in batches. */
+FOUNDATION_STATIC timeline_transaction_t* timeline_test_reference_prepare(timeline_transaction_t* transactions)
+{
+    foreach(t, transactions)
+    {
+        const size_t code_length = string_length(t->code);
+        day_result_t ed = stock_get_eod(t->code, code_length, t->date);
+        t->close = ed.close;
+        t->adjusted_close = ed.adjusted_close;
+
+        if (math_real_is_nan(t->exchange_rate))
+        {
+            stock_handle_t handle = stock_request(t->code, code_length, FetchLevel::NONE);
+            string_const_t title_currency = SYMBOL_CONST(handle->currency);
+            t->exchange_rate = stock_exchange_rate(STRING_ARGS(title_currency), STRING_CONST("USD"), t->date);
+        }
+
+        // Test stocks were never adjusted, so they never split.
+        if (math_real_is_nan(t->split_factor))
+            t->split_factor = 1.0;
+
+        t->split_close = ed.close * t->split_factor;
+        t->adjusted_factor = t->adjusted_close / t->split_close;
+    }
+
+    return array_sort(transactions, [transactions](const timeline_transaction_t& a, const timeline_transaction_t& b)
+    {
+        if (a.date < b.date)
+            return -1;
+
+        if (a.date > b.date)
+            return 1;
+
+        int ca = timeline_test_same_day_count(transactions, a.code_key, a.date);
+        int cb = timeline_test_same_day_count(transactions, b.code_key, a.date);
+
+        if (ca < cb)
+            return -1;
+
+        if (ca > cb)
+            return 1;
+
+        if (ca == 1)
+        {
+            if (a.type > b.type)
+                return -1;
+
+            if (a.type < b.type)
+                return 1;
+        }
+
+        if (a.type < b.type)
+            return -1;
+
+        if (a.type > b.type)
+            return 1;
+
+        return 0;
+    });
+}
+
+/*! Create a stock that split 4 for 1 after #split_day, with the EOD and split adjusted queries it answers.
+ *  Prices before the split are 100 and 25 after, so the split factor of days before the split is 0.25.
+ */
+FOUNDATION_STATIC void timeline_test_create_split_stock(const char* code, size_t code_length, int day_count, int split_day)
+{
+    const time_t first_date = timeline_test_first_date();
+
+    stock_t* s = test_stock_create(code, code_length);
+
+    const size_t capacity = day_count * 128 + 16;
+    string_t eod_json = string_allocate(0, capacity);
+    eod_json = string_append(STRING_ARGS(eod_json), capacity, STRING_CONST("["));
+
+    day_result_t* history = nullptr;
+    for (int d = day_count - 1; d >= 0; --d)
+    {
+        day_result_t ed{};
+        ed.date = first_date + d * time_one_day();
+        ed.close = d < split_day ? 100.0 : 25.0;
+        ed.adjusted_close = 25.0;
+        array_push_memcpy(history, &ed);
+
+        char date_buffer[16];
+        string_t date = string_from_date(STRING_BUFFER(date_buffer), ed.date);
+        char day_buffer[128];
+        string_t day = string_format(STRING_BUFFER(day_buffer),
+            STRING_CONST("{\"date\":\"%.*s\",\"open\":%.2lf,\"high\":%.2lf,\"low\":%.2lf,\"close\":%.2lf,\"adjusted_close\":%.2lf,\"volume\":1000}%s"),
+            STRING_FORMAT(date), ed.close, ed.close, ed.close, ed.close, ed.adjusted_close, d > 0 ? "," : "");
+        eod_json = string_append(STRING_ARGS(eod_json), capacity, STRING_ARGS(day));
+    }
+    eod_json = string_append(STRING_ARGS(eod_json), capacity, STRING_CONST("]"));
+
+    stock_swap_history(s, history);
+    s->mark_resolved(FetchLevel::EOD);
+
+    // Split adjusted prices are queried for a single day, so the same response serves every day before the split.
+    char query_buffer[64];
+    string_t query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/eod/%.*s"), (int)code_length, code);
+    query_mock_register_request_response(STRING_ARGS(query), STRING_ARGS(eod_json));
+    query = string_format(STRING_BUFFER(query_buffer), STRING_CONST("api/technical/%.*s"), (int)code_length, code);
+    query_mock_register_request_response(STRING_ARGS(query), 
+        STRING_CONST("[{\"date\":\"2013-01-02\",\"open\":25,\"high\":25,\"low\":25,\"close\":25,\"volume\":1000}]"));
+
+    string_deallocate(eod_json.str);
+}
+
+FOUNDATION_STATIC timeline_transaction_t timeline_test_split_order(const char* code, int day, double split_factor)
+{
+    timeline_transaction_t t{};
+    t.date = timeline_test_first_date() + day * time_one_day();
+    string_copy(STRING_BUFFER(t.code), code, string_length(code));
+    t.code_key = string_hash(t.code, string_length(t.code));
+    t.type = TimelineTransactionType::BUY;
+    t.qty = 10.0;
+    t.price = 100.0;
+    t.exchange_rate = 1.0;
+    t.split_factor = split_factor;
+    return t;
+}
+
+/*! Daily values computed the way the timeline did before the valuation engine, for every held title every day. */
+FOUNDATION_STATIC double* timeline_test_reference_totals(const timeline_transaction_t* transactions, time_t until)
+{
+    const time_t first_date = transactions[0].date;
+    timeline_test_position_t* positions = nullptr;
+
+    double* totals = nullptr;
+    unsigned tidx = 0;
+    const unsigned transaction_count = array_size(transactions);
+    for (time_t at = first_date; at <= until; at += time_one_day())
+    {
+        for (; tidx < transaction_count && transactions[tidx].date <= at; ++tidx)
+        {
+            const timeline_transaction_t* t = &transactions[tidx];
+            timeline_test_position_t* position = nullptr;
+            foreach(p, positions)
+            {
+                if (p->transaction->code_key == t->code_key)
+                    position = p;
+            }
+
+            if (position == nullptr)
+            {
+                timeline_test_position_t p{ t, 0 };
+                array_push(positions, p);
+                position = array_last(positions);
+            }
+
+            if (t->type == TimelineTransactionType::BUY)
+                position->qty += t->qty;
+            else
+                position->qty -= min(position->qty, t->qty);
+        }
+
+        double total_value = 0;
+        foreach(p, positions)
+        {
+            if (p->qty <= 0)
+                continue;
+
+            const char* code = p->transaction->code;
+            const size_t code_length = string_length(code);
+            const day_result_t ed = stock_get_eod(code, code_length, at);
+            string_const_t stock_currency = stock_get_currency(code, code_length);
+            const double that_day_exchange_rate = stock_exchange_rate(STRING_ARGS(stock_currency), STRING_CONST("USD"), at);
+            total_value += p->qty * ed.close * that_day_exchange_rate;
+        }
+
+        array_push(totals, total_value);
+    }
+
+    array_deallocate(positions);
+    return totals;
+}
+
+TEST_SUITE("Timeline")
+{
+    TEST_CASE("Benchmark transaction ordering" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(300.0))
+    {
+        timeline_test_create_stocks();
+
+        timeline_transaction_t* reference_transactions = timeline_test_orders();
+        timeline_transaction_t* transactions = nullptr;
+        array_copy(transactions, reference_transactions);
+        REQUIRE_EQ(array_size(transactions), TIMELINE_TEST_ORDER_COUNT);
+
+        tick_t start_time = time_current();
+        reference_transactions = timeline_test_reference_prepare(reference_transactions);
+        const double reference_elapsed_time = time_elapsed(start_time);
+
+        start_time = time_current();
+        timeline_transactions_prepare(transactions, CTEXT("USD"));
+        const double elapsed_time = time_elapsed(start_time);
+
+        // Transactions must be processed in the same order as before.
+        unsigned same_day_count = 0;
+        for (unsigned i = 0; i < TIMELINE_TEST_ORDER_COUNT; ++i)
+        {
+            const timeline_transaction_t& r = reference_transactions[i];
+            const timeline_transaction_t& t = transactions[i];
+            REQUIRE_EQ(t.date, r.date);
+            REQUIRE_EQ(t.code_key, r.code_key);
+            REQUIRE_EQ(t.type, r.type);
+            REQUIRE_EQ(t.qty, r.qty);
+            REQUIRE_EQ(t.close, r.close);
+            REQUIRE_EQ(t.adjusted_close, r.adjusted_close);
+            REQUIRE_EQ(t.exchange_rate, r.exchange_rate);
+            REQUIRE_EQ(t.split_factor, r.split_factor);
+            REQUIRE_EQ(t.adjusted_factor, r.adjusted_factor);
+            if (t.same_day_count > 1)
+                same_day_count++;
+        }
+        CHECK_GT(same_day_count, 0);
+
+        MESSAGE(string_format_static_const("%d orders (%u on days with many orders of the same title), previous %.3lf seconds, batched %.3lf seconds",
+            TIMELINE_TEST_ORDER_COUNT, same_day_count, reference_elapsed_time, elapsed_time));
+
+        array_deallocate(transactions);
+        array_deallocate(reference_transactions);
+    }
+
+    TEST_CASE("Split factors" * doctest::timeout(30.0))
+    {
+        static const char SPLIT_CODE[] = "TLS0.TLTEST";
+        timeline_test_create_split_stock(STRING_CONST(SPLIT_CODE), 20, 10);
+
+        // Days that were not adjusted do not query the split adjusted prices.
+        timeline_transaction_t* transactions = nullptr;
+        array_push(transactions, timeline_test_split_order(SPLIT_CODE, 12, DNAN));
+        array_push(transactions, timeline_test_split_order(SPLIT_CODE, 15, DNAN));
+        array_push(transactions, timeline_test_split_order(SPLIT_CODE, 15, 2.0));
+
+        unsigned request_count = query_mock_request_count();
+        timeline_transactions_prepare(transactions, CTEXT("USD"));
+        CHECK_EQ(query_mock_request_count(), request_count);
+        CHECK_EQ(transactions[0].close, 25.0);
+        CHECK_EQ(transactions[0].split_factor, 1.0);
+        CHECK_EQ(transactions[0].adjusted_factor, 1.0);
+
+        // The split factor set by the user is kept.
+        CHECK_EQ(min(transactions[1].split_factor, transactions[2].split_factor), 1.0);
+        CHECK_EQ(max(transactions[1].split_factor, transactions[2].split_factor), 2.0);
+        CHECK_EQ(max(transactions[1].split_close, transactions[2].split_close), 50.0);
+        array_deallocate(transactions);
+
+        // Days adjusted by the split fall back to the split adjusted prices.
+        array_push(transactions, timeline_test_split_order(SPLIT_CODE, 2, DNAN));
+        array_push(transactions, timeline_test_split_order(SPLIT_CODE, 2, DNAN));
+        array_push(transactions, timeline_test_split_order(SPLIT_CODE, 11, DNAN));
+
+        request_count = query_mock_request_count();
+        timeline_transactions_prepare(transactions, CTEXT("USD"));
+        CHECK_GT(query_mock_request_count(), request_count);
+        REQUIRE_EQ(transactions[0].date, transactions[1].date);
+        for (int i = 0; i < 2; ++i)
+        {
+            CHECK_EQ(transactions[i].close, 100.0);
+            CHECK_EQ(transactions[i].split_factor, doctest::Approx(0.25));
+            CHECK_EQ(transactions[i].split_close, doctest::Approx(25.0));
+            CHECK_EQ(transactions[i].adjusted_factor, doctest::Approx(1.0));
+        }
+        CHECK_EQ(transactions[2].close, 25.0);
+        CHECK_EQ(transactions[2].split_factor, 1.0);
+
+        array_deallocate(transactions);
+    }
+
+    TEST_CASE("Benchmark valuation" * doctest::test_suite(BENCH_TEST_SUITE) * doctest::timeout(300.0))
+    {
+        timeline_test_create_stocks();
+
+        timeline_transaction_t* transactions = timeline_test_transactions();
+        REQUIRE_GT(array_size(transactions), 0);
+        const time_t until = timeline_test_first_date() + (TIMELINE_TEST_DAY_COUNT - 1) * time_one_day();
+
+        tick_t start_time = time_current();
+        double* reference_totals = timeline_test_reference_totals(transactions, until);
+        const double reference_elapsed_time = time_elapsed(start_time);
+        REQUIRE_EQ(array_size(reference_totals), TIMELINE_TEST_DAY_COUNT);
+
+        string_t store_path = path_make_temporary(SHARED_BUFFER(BUILD_MAX_PATHLEN));
+        timeline_valuation_t* valuation = timeline_valuation_load(STRING_ARGS(store_path));
+        REQUIRE(valuation);
+
+        // Full rebuild
+        start_time = time_current();
+        const double* totals = timeline_valuation_update(valuation, transactions, CTEXT("USD"), until);
+        const double full_elapsed_time = time_elapsed(start_time);
+        REQUIRE(totals);
+        for (int d = 0; d < TIMELINE_TEST_DAY_COUNT; ++d)
+            REQUIRE_EQ(totals[d], doctest::Approx(reference_totals[d]));
+
+        // Change a single order near the end of the timeline.
+        const unsigned changed_index = array_size(transactions) - TIMELINE_TEST_TITLE_COUNT;
+        transactions[changed_index].qty += 100.0;
+        array_deallocate(reference_totals);
+        reference_totals = timeline_test_reference_totals(transactions, until);
+
+        start_time = time_current();
+        totals = timeline_valuation_update(valuation, transactions, CTEXT("USD"), until);
+        const double incremental_elapsed_time = time_elapsed(start_time);
+        for (int d = 0; d < TIMELINE_TEST_DAY_COUNT; ++d)
+            REQUIRE_EQ(totals[d], doctest::Approx(reference_totals[d]));
+
+        // The valuation survives restarts.
+        REQUIRE(timeline_valuation_save(valuation, STRING_ARGS(store_path)));
+        timeline_valuation_deallocate(valuation);
+
+        start_time = time_current();
+        valuation = timeline_valuation_load(STRING_ARGS(store_path));
+        totals = timeline_valuation_update(valuation, transactions, CTEXT("USD"), until);
+        const double restart_elapsed_time = time_elapsed(start_time);
+        REQUIRE(totals);
+        for (int d = 0; d < TIMELINE_TEST_DAY_COUNT; ++d)
+            REQUIRE_EQ(totals[d], doctest::Approx(reference_totals[d]));
+
+        MESSAGE(string_format_static_const("%d titles over %d days (%u orders), previous %.3lf seconds, full rebuild %.3lf seconds, one order changed %.3lf seconds, restart %.3lf seconds",
+            TIMELINE_TEST_TITLE_COUNT, TIMELINE_TEST_DAY_COUNT, array_size(transactions),
+            reference_elapsed_time, full_elapsed_time, incremental_elapsed_time, restart_elapsed_time));
+
+        timeline_valuation_deallocate(valuation);
+        fs_remove_file(STRING_ARGS(store_path));
+        array_deallocate(reference_totals);
+        array_deallocate(transactions);
+    }
+}
+
+#endif // BUILD_TESTS
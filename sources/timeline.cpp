@@ -15,17 +15,16 @@
 #include <framework/string.h>
 #include <framework/window.h>
 #include <framework/array.h>
+#include <framework/jobs.h>
+#include <framework/session.h>
+#include <framework/profiler.h>
+#include <framework/system.h>
+#include <framework/epoch.h>
 
-#define HASH_TIMELINE static_hash_string("timeline", 8, 0x8982c42357327efeULL)
+#include <foundation/fs.h>
+#include <foundation/stream.h>
 
-typedef enum class TimelineTransactionType
-{
-    UNDEFINED = 0,
-    BUY,
-    SELL,
-    DIVIDEND,
-    EXCHANGE_RATE
-} timeline_transaction_type_t;
+#define HASH_TIMELINE static_hash_string("timeline", 8, 0x8982c42357327efeULL)
 
 struct plot_axis_format_t
 {
@@ -34,25 +33,6 @@ struct plot_axis_format_t
     ImPlotRect limits;
 };
 
-struct timeline_transaction_t
-{
-    time_t date{ 0 };
-    hash_t code_key{ 0 };
-    char code[16] = { '\0' };
-
-    double qty{ NAN };
-    double price{ NAN };
-    timeline_transaction_type_t type { TimelineTransactionType::UNDEFINED };
-
-    double close{ NAN };
-    double split_close{ NAN };
-    double adjusted_close{ NAN };
-    double exchange_rate{ NAN };
-
-    double split_factor{ 1.0 };
-    double adjusted_factor{ 1.0 };
-};
-
 struct timeline_stock_t
 {
     hash_t          key{ 0 };
@@ -81,9 +61,22 @@ struct timeline_report_t
     timeline_transaction_t* transactions{ nullptr };
     
     string_t title{};
-    string_const_t preferred_currency{};
+    string_t preferred_currency{};
+    string_t store_path{};
+    report_handle_t report{};
 
     bool first_render{ true };
+    bool building{ false };     // Set once the job computing #days is launched
+
+    atomic32_t built{ 0 };      // Set by the job once #days are computed
+    atomic32_t refs{ 1 };       // References held by the window and the job computing #days
+};
+
+struct timeline_transaction_key_t
+{
+    hash_t   code_key;
+    time_t   date;
+    unsigned index;
 };
 
 struct timeline_plot_day_t
@@ -92,6 +85,73 @@ struct timeline_plot_day_t
     const function<double(const timeline_t* day)>& fn;
 };
 
+constexpr uint32_t TIMELINE_VALUATION_STORE_VERSION = 1;
+
+/*! Number of most recent days always revalued since their prices can still change. */
+constexpr unsigned TIMELINE_VALUATION_REFRESH_DAYS = 5;
+
+/*! Transaction fingerprint used to find from which day a title valuation changed. */
+struct timeline_valuation_order_t
+{
+    int64_t date;
+    hash_t  hash;
+};
+
+struct timeline_valuation_currency_t
+{
+    hash_t         key{ 0 };
+    string_const_t code{};
+    unsigned       first_day{ UINT32_MAX };
+    double*        rates{ nullptr };
+};
+
+struct timeline_valuation_title_t
+{
+    hash_t  key{ 0 };
+    char    code[16] = { '\0' };
+    unsigned first_day{ 0 }; // Day index of the first title transaction
+    unsigned dirty_day{ 0 }; // Values from this day index need to be computed again
+
+    timeline_valuation_order_t* orders{ nullptr };  // Transactions the values were computed from
+    double*                     values{ nullptr };  // Daily position values since #first_day in the preferred currency
+
+    // Only used while updating the valuation
+    const timeline_transaction_t**  transactions{ nullptr };
+    const stock_t*                  stock{ nullptr };
+    unsigned                        currency{ 0 };
+};
+
+/*! Daily valuation of the report titles since the first transaction.
+ *  Values are kept per title so that changing a transaction only revalues that title from the transaction day.
+ */
+struct timeline_valuation_t
+{
+    hash_t   currency_key{ 0 };
+    time_t   first_date{ 0 };
+    unsigned day_count{ 0 };
+
+    timeline_valuation_title_t* titles{ nullptr }; // Sorted by key
+    double*                     totals{ nullptr };
+};
+
+FOUNDATION_ALIGNED_STRUCT(timeline_valuation_store_header_t, 8) {
+    char     magic[4] = { 0 };
+    uint32_t version = 0;
+    uint32_t title_count = 0;
+    uint32_t day_count = 0;
+    int64_t  first_date = 0;
+    hash_t   currency_key = 0;
+};
+
+FOUNDATION_ALIGNED_STRUCT(timeline_valuation_store_title_t, 8) {
+    hash_t   key = 0;
+    char     code[16] = { 0 };
+    uint32_t first_day = 0;
+    uint32_t order_count = 0;
+    uint32_t value_count = 0;
+    uint32_t reserved = 0;
+};
+
 //
 // # PRIVATE
 //
@@ -105,19 +165,184 @@ FOUNDATION_FORCEINLINE bool operator>(const timeline_t& s, const time_t& date) {
 FOUNDATION_FORCEINLINE bool operator<(const timeline_transaction_t& s, const time_t& date) { return s.date < date; }
 FOUNDATION_FORCEINLINE bool operator>(const timeline_transaction_t& s, const time_t& date) { return s.date > date; }
 
-FOUNDATION_FORCEINLINE int timeline_transaction_same_day_count(timeline_transaction_t* transactions, hash_t code, time_t date)
+FOUNDATION_STATIC void timeline_wait_jobs(job_t**& jobs)
 {
-    int counter = 0;
-    foreach(t, transactions)
+    foreach(j, jobs)
+    {
+        job_wait(*j);
+        job_deallocate(*j);
+    }
+    array_clear(jobs);
+}
+
+/*! Order transactions by date, then title orders that are alone on their day come first.
+ *  Sell orders come before buy orders for titles with a single order that day, otherwise buy orders come first.
+ */
+FOUNDATION_STATIC int timeline_transaction_compare(const timeline_transaction_t& a, const timeline_transaction_t& b)
+{
+    if (a.date < b.date)
+        return -1;
+
+    if (a.date > b.date)
+        return 1;
+
+    if (a.same_day_count < b.same_day_count)
+        return -1;
+
+    if (a.same_day_count > b.same_day_count)
+        return 1;
+
+    if (a.same_day_count == 1)
+    {
+        if (a.type > b.type)
+            return -1;
+
+        if (a.type < b.type)
+            return 1;
+    }
+
+    if (a.type < b.type)
+        return -1;
+
+    if (a.type > b.type)
+        return 1;
+
+    return 0;
+}
+
+/*! Resolve prices, exchange rates and split factors of all the transactions of a title.
+ *
+ *  @param keys     Transaction keys of the title sorted by date.
+ */
+FOUNDATION_STATIC int timeline_transactions_resolve_title(timeline_transaction_t* transactions, const timeline_transaction_key_t* keys, unsigned count, string_const_t preferred_currency)
+{
+    const char* code = transactions[keys[0].index].code;
+    const size_t code_length = string_length(code);
+
+    stock_handle_t handle = stock_request(code, code_length, FetchLevel::EOD);
+    stock_wait_resolved(handle, FetchLevel::EOD);
+
+    const stock_t* s = handle;
+    string_const_t currency = s ? SYMBOL_CONST(s->currency) : string_null();
+
+    // Read prices from the history first, so that the history is not kept alive while rates and split factors get fetched.
     {
-        if (t->code_key == code && t->date == date)
-            counter++;
+        EPOCH_SCOPE();
+        const day_result_t* history = s ? s->history : nullptr;
+
+        // History is sorted from the most recent day, so walk it backward along with the transactions.
+        int hidx = to_int(array_size(history)) - 1;
+        for (unsigned i = 0, end = 0; i < count; i = end)
+        {
+            const time_t date = keys[i].date;
+            for (end = i + 1; end < count && keys[end].date == date; ++end)
+                ;
+
+            // Take the last day of the history on or before that day, or the first one, like #stock_get_EOD.
+            const time_t day_trunc = date / time_one_day();
+            while (hidx > 0 && history[hidx - 1].date / time_one_day() <= day_trunc)
+                hidx--;
+            const day_result_t ed = hidx >= 0 ? history[hidx] : day_result_t{};
+
+            // Same as #stock_get_split_factor without reading the EOD data again if the day was not adjusted.
+            const bool unadjusted_day = hidx >= 0 && ed.date == date && math_abs(time_elapsed_days(date, time_now())) > 3 &&
+                (math_abs(ed.adjusted_close - ed.close) / min(ed.close, ed.adjusted_close)) < 1.0;
+
+            for (unsigned k = i; k < end; ++k)
+            {
+                timeline_transaction_t& t = transactions[keys[k].index];
+                t.same_day_count = end - i;
+                t.close = ed.close;
+                t.adjusted_close = ed.adjusted_close;
+                if (unadjusted_day && math_real_is_nan(t.split_factor))
+                    t.split_factor = 1.0;
+            }
+        }
     }
 
-    return counter;
+    for (unsigned i = 0, end = 0; i < count; i = end)
+    {
+        const time_t date = keys[i].date;
+        for (end = i + 1; end < count && keys[end].date == date; ++end)
+            ;
+
+        // Transactions of the same day share the same exchange rate and split factor.
+        double exchange_rate = DNAN;
+        double split_factor = DNAN;
+        for (unsigned k = i; k < end; ++k)
+        {
+            timeline_transaction_t& t = transactions[keys[k].index];
+            if (math_real_is_nan(t.exchange_rate))
+            {
+                if (math_real_is_nan(exchange_rate))
+                    exchange_rate = stock_exchange_rate(STRING_ARGS(currency), STRING_ARGS(preferred_currency), date);
+                t.exchange_rate = exchange_rate;
+            }
+
+            if (math_real_is_nan(t.split_factor))
+            {
+                if (math_real_is_nan(split_factor))
+                    split_factor = stock_get_split_factor(code, code_length, date);
+                t.split_factor = split_factor;
+            }
+
+            t.split_close = t.close * t.split_factor;
+            t.adjusted_factor = t.adjusted_close / t.split_close;
+        }
+    }
+
+    return 0;
+}
+
+/*! Resolve transaction prices, exchange rates and split factors for each title in parallel, then sort transactions.
+ *
+ *  @param transactions         Transactions to resolve and sort. Exchange rates and split factors that are already set are kept.
+ *  @param preferred_currency   Currency to convert transaction prices to.
+ */
+FOUNDATION_EXTERN void timeline_transactions_prepare(timeline_transaction_t* transactions, string_const_t preferred_currency)
+{
+    PERFORMANCE_TRACKER("timeline_transactions_prepare");
+
+    const unsigned transaction_count = array_size(transactions);
+    if (transaction_count == 0)
+        return;
+
+    // Group transactions by title and day
+    timeline_transaction_key_t* keys = nullptr;
+    array_resize(keys, transaction_count);
+    for (unsigned i = 0; i < transaction_count; ++i)
+        keys[i] = { transactions[i].code_key, transactions[i].date, i };
+    array_sort(keys, [](const timeline_transaction_key_t& a, const timeline_transaction_key_t& b)
+    {
+        if (a.code_key != b.code_key)
+            return a.code_key < b.code_key ? -1 : 1;
+        if (a.date != b.date)
+            return a.date < b.date ? -1 : 1;
+        return 0;
+    });
+
+    job_t** jobs = nullptr;
+    for (unsigned i = 0, end = 0; i < transaction_count; i = end)
+    {
+        for (end = i + 1; end < transaction_count && keys[end].code_key == keys[i].code_key; ++end)
+            ;
+
+        const timeline_transaction_key_t* title_keys = keys + i;
+        const unsigned title_key_count = end - i;
+        array_push(jobs, job_execute([transactions, title_keys, title_key_count, preferred_currency](payload_t* payload)
+        {
+            return timeline_transactions_resolve_title(transactions, title_keys, title_key_count, preferred_currency);
+        }));
+    }
+    timeline_wait_jobs(jobs);
+    array_deallocate(jobs);
+    array_deallocate(keys);
+
+    array_sort(transactions, timeline_transaction_compare);
 }
 
-FOUNDATION_STATIC timeline_transaction_t* timeline_report_compute_transactions(const report_t* report, string_const_t preferred_currency)
+/*! Collect the orders of the report titles, see #timeline_transactions_prepare to resolve them. */
+FOUNDATION_STATIC timeline_transaction_t* timeline_report_compute_transactions(const report_t* report)
 {
     timeline_transaction_t* transactions = nullptr;
 
@@ -125,9 +350,6 @@ FOUNDATION_STATIC timeline_transaction_t* timeline_report_compute_transactions(c
     {
         title_t* t = *tt;
         string_const_t code = string_const(t->code, t->code_length);
-
-        while (!title_is_resolved(t) && title_update(t, 10.0))
-            dispatcher_wait_for_wakeup_main_thread(10000);
                     
         for (auto order : t->data["orders"])
         {
@@ -177,64 +399,12 @@ FOUNDATION_STATIC timeline_transaction_t* timeline_report_compute_transactions(c
             transaction.price = price;
             transaction.type = buy ? TimelineTransactionType::BUY : TimelineTransactionType::SELL;
 
-            day_result_t ed = stock_get_eod(STRING_ARGS(code), date);
-            transaction.close = ed.close;
-            transaction.adjusted_close = ed.adjusted_close;
-            
             transaction.exchange_rate = order["xcg"].as_number();
-            if (math_real_is_nan(transaction.exchange_rate))
-            {
-                string_const_t title_currency = SYMBOL_CONST(t->stock->currency);
-                transaction.exchange_rate = stock_exchange_rate(STRING_ARGS(title_currency), STRING_ARGS(preferred_currency), date);
-            }
-
             transaction.split_factor = order["split"].as_number();
-            if (math_real_is_nan(transaction.split_factor))
-                transaction.split_factor = stock_get_split_factor(STRING_ARGS(code), date);
-            transaction.split_close = ed.close * transaction.split_factor;
-            transaction.adjusted_factor = transaction.adjusted_close / transaction.split_close;
-
             array_push(transactions, transaction);
         }
     }
 
-    transactions = array_sort(transactions, [transactions](const timeline_transaction_t& a, const timeline_transaction_t& b)
-    {
-        if (a.date < b.date)
-            return -1;
-
-        if (a.date > b.date)
-            return 1;
-
-        int ca = timeline_transaction_same_day_count(transactions, a.code_key, a.date);
-        int cb = timeline_transaction_same_day_count(transactions, b.code_key, a.date);
-
-        if (ca < cb)
-            return -1;
-
-        if (ca > cb)
-            return 1;
-
-        if (ca == 1)
-        {
-            // Sort buy transactions first for the same day.
-            if (a.type > b.type)
-                return -1;
-
-            if (a.type < b.type)
-                return 1;
-        }
-
-        // Sort buy transactions first for the same day.
-        if (a.type < b.type)
-            return -1;
-
-        if (a.type > b.type)
-            return 1;
-
-        return 0;
-    });
-
     return transactions;
 }
 
@@ -254,42 +424,7 @@ FOUNDATION_STATIC int timeline_add_new_stock(const timeline_transaction_t* t, ti
     return insert_at;
 }
 
-FOUNDATION_STATIC double timeline_compute_day_total_value(const timeline_stock_t* stocks, time_t at, string_const_t preferred_currency)
-{
-    double total_value = 0;
-    foreach(s, stocks)
-    {
-        const day_result_t ed = stock_get_eod(STRING_ARGS(s->code), at);
-        
-        string_const_t stock_currency = stock_get_currency(STRING_ARGS(s->code));
-        const double that_day_exchange_rate = stock_exchange_rate(STRING_ARGS(stock_currency), STRING_ARGS(preferred_currency));
-
-        const double investment_value = s->qty * s->average_price;
-        const double current_value = s->qty * ed.close * that_day_exchange_rate;
-
-        #if BUILD_DEBUG
-        const double idiff = math_abs(investment_value - s->total_value);
-        if (idiff > 0.001)
-        {
-            log_warnf(HASH_TIMELINE, WARNING_SUSPICIOUS,
-                STRING_CONST("Compare investment and stock total value: %.2lf <> %.2lf"),
-                investment_value, s->total_value);
-        }
-        #endif
-
-        total_value += current_value;
-        FOUNDATION_ASSERT(math_real_is_finite(total_value));
-    }
-
-    return total_value;
-}
-
-FOUNDATION_STATIC void timeline_day_update_total_value(timeline_t& day, string_const_t preferred_currency)
-{
-    day.total_value = timeline_compute_day_total_value(day.stocks, day.date, preferred_currency);
-}
-
-FOUNDATION_STATIC void timeline_update_day(timeline_t& day, const timeline_transaction_t* t, string_const_t preferred_currency)
+FOUNDATION_STATIC void timeline_update_day(timeline_t& day, const timeline_transaction_t* t)
 {
     int sidx = array_binary_search(day.stocks, array_size(day.stocks), t->code_key);
     if (sidx < 0)
@@ -352,8 +487,6 @@ FOUNDATION_STATIC void timeline_update_day(timeline_t& day, const timeline_trans
     {
         FOUNDATION_ASSERT_FAIL("Transaction type not supported");
     }
-
-    timeline_day_update_total_value(day, preferred_currency);
 }
 
 FOUNDATION_STATIC int timeline_add_new_day(const timeline_transaction_t* t, timeline_t*& days, int insert_at)
@@ -404,7 +537,7 @@ FOUNDATION_STATIC int timeline_add_new_day(const timeline_transaction_t* t, time
     return insert_at;
 }
 
-FOUNDATION_STATIC timeline_t* timeline_build(const timeline_transaction_t* transactions, string_const_t preferred_currency)
+FOUNDATION_STATIC timeline_t* timeline_build(const timeline_transaction_t* transactions)
 {
     LOG_PREFIX(false);
 
@@ -426,7 +559,7 @@ FOUNDATION_STATIC timeline_t* timeline_build(const timeline_transaction_t* trans
             fidx = timeline_add_new_day(t, days, ~fidx);
         
         timeline_t& day = days[fidx];
-        timeline_update_day(day, t, preferred_currency);
+        timeline_update_day(day, t);
 
         #if BUILD_DEBUG
         log_debugf(HASH_TIMELINE, STRING_CONST(
@@ -462,16 +595,456 @@ FOUNDATION_STATIC void timeline_deallocate(timeline_t*& timeline)
     timeline = nullptr;
 }
 
+FOUNDATION_FORCEINLINE bool operator<(const timeline_valuation_title_t& s, const hash_t& key) { return s.key < key; }
+FOUNDATION_FORCEINLINE bool operator>(const timeline_valuation_title_t& s, const hash_t& key) { return s.key > key; }
+
+FOUNDATION_FORCEINLINE unsigned timeline_valuation_day_index(const timeline_valuation_t* valuation, time_t date)
+{
+    // Round to the nearest day so that daylight saving time changes do not shift days.
+    return (unsigned)((date - valuation->first_date + time_one_day() / 2) / time_one_day());
+}
+
+FOUNDATION_STATIC hash_t timeline_valuation_order_hash(const timeline_transaction_t* t)
+{
+    // Only the quantities change the position of a title.
+    const double order[]{ (double)t->type, t->qty };
+    return hash(order, sizeof(order));
+}
+
+FOUNDATION_STATIC void timeline_valuation_title_deallocate(timeline_valuation_title_t& title)
+{
+    array_deallocate(title.orders);
+    array_deallocate(title.values);
+    array_deallocate(title.transactions);
+}
+
+FOUNDATION_STATIC void timeline_valuation_clear(timeline_valuation_t* valuation)
+{
+    foreach(t, valuation->titles)
+        timeline_valuation_title_deallocate(*t);
+    array_deallocate(valuation->titles);
+    array_deallocate(valuation->totals);
+    valuation->day_count = 0;
+}
+
+FOUNDATION_EXTERN void timeline_valuation_deallocate(timeline_valuation_t*& valuation)
+{
+    if (valuation == nullptr)
+        return;
+    timeline_valuation_clear(valuation);
+    MEM_DELETE(valuation);
+    valuation = nullptr;
+}
+
+/*! Returns the first day index for which the stored title values do not match the new title orders. */
+FOUNDATION_STATIC unsigned timeline_valuation_title_changed_day(const timeline_valuation_t* valuation, const timeline_valuation_title_t& title, const timeline_valuation_order_t* orders)
+{
+    const unsigned stored_count = array_size(title.orders);
+    const unsigned order_count = array_size(orders);
+    for (unsigned i = 0, end = min(stored_count, order_count); i < end; ++i)
+    {
+        if (orders[i].date != title.orders[i].date || orders[i].hash != title.orders[i].hash)
+            return timeline_valuation_day_index(valuation, (time_t)min(orders[i].date, title.orders[i].date));
+    }
+
+    if (order_count > stored_count)
+        return timeline_valuation_day_index(valuation, (time_t)orders[stored_count].date);
+    if (stored_count > order_count)
+        return timeline_valuation_day_index(valuation, (time_t)title.orders[order_count].date);
+    return UINT32_MAX;
+}
+
+FOUNDATION_STATIC int timeline_valuation_compute_rates(const timeline_valuation_t* valuation, timeline_valuation_currency_t* currency, string_const_t preferred_currency)
+{
+    array_resize(currency->rates, valuation->day_count);
+    for (unsigned d = currency->first_day; d < valuation->day_count; ++d)
+    {
+        const time_t date = valuation->first_date + d * time_one_day();
+        currency->rates[d] = stock_exchange_rate(STRING_ARGS(currency->code), STRING_ARGS(preferred_currency), date);
+    }
+
+    return 0;
+}
+
+FOUNDATION_STATIC int timeline_valuation_compute_title(const timeline_valuation_t* valuation, timeline_valuation_title_t* title, const double* rates)
+{
+    array_resize(title->values, valuation->day_count - title->first_day);
+
+    EPOCH_SCOPE();
+    const day_result_t* history = title->stock ? title->stock->history : nullptr;
+    const int history_count = to_int(array_size(history));
+
+    double qty = 0;
+    unsigned tidx = 0;
+    const unsigned transaction_count = array_size(title->transactions);
+
+    // History is sorted from the most recent day, so walk it backward along with the days.
+    int hidx = history_count - 1;
+    for (unsigned d = title->first_day; d < valuation->day_count; ++d)
+    {
+        // Apply the day transactions the same way #timeline_update_day does.
+        for (; tidx < transaction_count && timeline_valuation_day_index(valuation, title->transactions[tidx]->date) <= d; ++tidx)
+        {
+            const timeline_transaction_t* t = title->transactions[tidx];
+            if (t->type == TimelineTransactionType::BUY)
+                qty += t->qty;
+            else if (t->type == TimelineTransactionType::SELL)
+                qty -= min(qty, t->qty);
+        }
+
+        if (d < title->dirty_day)
+            continue;
+
+        // Take the last day of the history on or before that day, or the first one, like #stock_get_EOD.
+        const time_t day_trunc = (valuation->first_date + d * time_one_day()) / time_one_day();
+        while (hidx > 0 && history[hidx - 1].date / time_one_day() <= day_trunc)
+            hidx--;
+
+        double& value = title->values[d - title->first_day];
+        if (qty > 0 && hidx >= 0)
+            value = qty * history[hidx].close * rates[d];
+        else
+            value = 0;
+    }
+
+    return 0;
+}
+
+/*! Update the daily valuation for a new set of transactions.
+ *
+ *  @param valuation            Valuation previously computed or loaded, only days affected by changed transactions are revalued.
+ *  @param transactions         Transactions sorted by date.
+ *  @param preferred_currency   Currency in which values are expressed.
+ *  @param until                Date of the last day to value.
+ *
+ *  @return Total value of all titles for each day since the first transaction.
+ */
+FOUNDATION_EXTERN const double* timeline_valuation_update(timeline_valuation_t* valuation, const timeline_transaction_t* transactions, string_const_t preferred_currency, time_t until)
+{
+    PERFORMANCE_TRACKER("timeline_valuation_update");
+
+    const unsigned transaction_count = array_size(transactions);
+    if (transaction_count == 0)
+    {
+        timeline_valuation_clear(valuation);
+        return nullptr;
+    }
+
+    // All day indexes change if the first transaction moved.
+    const hash_t currency_key = string_hash(STRING_ARGS(preferred_currency));
+    if (valuation->currency_key != currency_key || valuation->first_date != transactions[0].date)
+    {
+        timeline_valuation_clear(valuation);
+        valuation->currency_key = currency_key;
+        valuation->first_date = transactions[0].date;
+    }
+
+    const unsigned previous_day_count = valuation->day_count;
+    const unsigned day_count = max(
+        timeline_valuation_day_index(valuation, until),
+        timeline_valuation_day_index(valuation, array_last(transactions)->date)) + 1;
+    const unsigned refresh_day = previous_day_count > TIMELINE_VALUATION_REFRESH_DAYS ? previous_day_count - TIMELINE_VALUATION_REFRESH_DAYS : 0;
+
+    // Group transactions by title
+    timeline_valuation_title_t* titles = nullptr;
+    foreach(t, transactions)
+    {
+        int idx = array_binary_search(titles, array_size(titles), t->code_key);
+        if (idx < 0)
+        {
+            idx = ~idx;
+            timeline_valuation_title_t title{};
+            title.key = t->code_key;
+            title.first_day = timeline_valuation_day_index(valuation, t->date);
+            string_copy(STRING_BUFFER(title.code), t->code, string_length(t->code));
+            array_insert_memcpy(titles, idx, &title);
+        }
+
+        timeline_valuation_title_t& title = titles[idx];
+        array_push(title.transactions, t);
+
+        timeline_valuation_order_t order{ (int64_t)t->date, timeline_valuation_order_hash(t) };
+        array_push_memcpy(title.orders, &order);
+    }
+
+    // Keep the values of previous transactions up to the first changed one.
+    foreach(title, titles)
+    {
+        title->dirty_day = title->first_day;
+
+        const int pidx = array_binary_search(valuation->titles, array_size(valuation->titles), title->key);
+        if (pidx < 0)
+            continue;
+
+        timeline_valuation_title_t& previous = valuation->titles[pidx];
+        if (previous.first_day == title->first_day)
+        {
+            const unsigned changed_day = timeline_valuation_title_changed_day(valuation, previous, title->orders);
+            title->dirty_day = max(title->first_day, min(min(changed_day, refresh_day), previous.first_day + array_size(previous.values)));
+            title->values = previous.values;
+            previous.values = nullptr;
+        }
+    }
+
+    timeline_valuation_clear(valuation);
+    valuation->titles = titles;
+    valuation->day_count = day_count;
+
+    // Resolve stocks and currencies of titles to revalue
+    timeline_valuation_currency_t* currencies = nullptr;
+    foreach(dirty_title, titles)
+    {
+        if (dirty_title->dirty_day >= valuation->day_count)
+            continue;
+
+        const size_t code_length = string_length(dirty_title->code);
+        stock_handle_t handle = stock_request(dirty_title->code, code_length, FetchLevel::EOD);
+        stock_wait_resolved(handle, FetchLevel::EOD);
+        dirty_title->stock = handle;
+
+        string_const_t currency_code = stock_get_currency(dirty_title->code, code_length);
+        const hash_t currency_key = string_hash(STRING_ARGS(currency_code));
+        unsigned cidx = 0;
+        for (unsigned end = array_size(currencies); cidx < end; ++cidx)
+        {
+            if (currencies[cidx].key == currency_key)
+                break;
+        }
+
+        if (cidx == array_size(currencies))
+        {
+            timeline_valuation_currency_t currency{};
+            currency.key = currency_key;
+            currency.code = currency_code;
+            array_push(currencies, currency);
+        }
+
+        currencies[cidx].first_day = min(currencies[cidx].first_day, dirty_title->dirty_day);
+        dirty_title->currency = cidx;
+    }
+
+    // Value titles in parallel once exchange rates are known
+    job_t** jobs = nullptr;
+    foreach(c, currencies)
+    {
+        array_push(jobs, job_execute([valuation, c, preferred_currency](payload_t* payload)
+        {
+            return timeline_valuation_compute_rates(valuation, c, preferred_currency);
+        }));
+    }
+    timeline_wait_jobs(jobs);
+
+    foreach(job_title, titles)
+    {
+        if (job_title->dirty_day >= valuation->day_count)
+            continue;
+
+        const double* rates = currencies[job_title->currency].rates;
+        array_push(jobs, job_execute([valuation, job_title, rates](payload_t* payload)
+        {
+            return timeline_valuation_compute_title(valuation, job_title, rates);
+        }));
+    }
+    timeline_wait_jobs(jobs);
+    array_deallocate(jobs);
+
+    foreach(currency, currencies)
+        array_deallocate(currency->rates);
+    array_deallocate(currencies);
+
+    // Reduce title values into daily totals
+    array_resize(valuation->totals, valuation->day_count);
+    memset(valuation->totals, 0, sizeof(double) * valuation->day_count);
+    foreach(valued_title, titles)
+    {
+        array_deallocate(valued_title->transactions);
+        valued_title->stock = nullptr;
+        valued_title->dirty_day = valuation->day_count;
+
+        const double* values = valued_title->values;
+        double* totals = valuation->totals + valued_title->first_day;
+        for (unsigned i = 0, end = array_size(values); i < end; ++i)
+            totals[i] += values[i];
+    }
+
+    return valuation->totals;
+}
+
+/*! Load a daily valuation stored with #timeline_valuation_save.
+ *
+ *  @return A valuation to update, empty if the store does not exist or is invalid.
+ */
+FOUNDATION_EXTERN timeline_valuation_t* timeline_valuation_load(const char* path, size_t path_length)
+{
+    timeline_valuation_t* valuation = MEM_NEW(HASH_TIMELINE, timeline_valuation_t);
+
+    stream_t* stream = fs_open_file(path, path_length, STREAM_IN | STREAM_BINARY);
+    if (stream == nullptr)
+        return valuation;
+
+    timeline_valuation_store_header_t header;
+    if (stream_read(stream, &header, sizeof(header)) != sizeof(header) || !string_equal(header.magic, 4, STRING_CONST("TLVS")) ||
+        header.version != TIMELINE_VALUATION_STORE_VERSION)
+    {
+        log_warnf(HASH_TIMELINE, WARNING_INVALID_VALUE, STRING_CONST("Invalid timeline valuation store %.*s"), (int)path_length, path);
+        stream_deallocate(stream);
+        return valuation;
+    }
+
+    valuation->currency_key = header.currency_key;
+    valuation->first_date = (time_t)header.first_date;
+    valuation->day_count = header.day_count;
+
+    // Counts are checked against the bytes left before allocating anything, so a corrupt store is rebuilt instead.
+    uint64_t remaining_size = stream_size(stream) - sizeof(header);
+    bool valid = (uint64_t)header.title_count * sizeof(timeline_valuation_store_title_t) <= remaining_size;
+    for (unsigned i = 0; valid && i < header.title_count; ++i)
+    {
+        timeline_valuation_store_title_t st;
+        if (stream_read(stream, &st, sizeof(st)) != sizeof(st) || 
+            st.first_day > header.day_count || st.value_count > header.day_count - st.first_day)
+        {
+            valid = false;
+            break;
+        }
+
+        const uint64_t orders_size = sizeof(timeline_valuation_order_t) * (uint64_t)st.order_count;
+        const uint64_t values_size = sizeof(double) * (uint64_t)st.value_count;
+        remaining_size -= sizeof(st);
+        if (orders_size + values_size > remaining_size)
+        {
+            valid = false;
+            break;
+        }
+        remaining_size -= orders_size + values_size;
+
+        timeline_valuation_title_t title{};
+        title.key = st.key;
+        title.first_day = st.first_day;
+        title.dirty_day = header.day_count;
+        memcpy(title.code, st.code, sizeof(title.code));
+        title.code[sizeof(title.code) - 1] = '\0';
+        array_resize(title.orders, st.order_count);
+        array_resize(title.values, st.value_count);
+
+        valid = stream_read(stream, title.orders, orders_size) == orders_size && stream_read(stream, title.values, values_size) == values_size;
+        array_push_memcpy(valuation->titles, &title);
+    }
+    stream_deallocate(stream);
+
+    if (!valid)
+    {
+        log_warnf(HASH_TIMELINE, WARNING_INVALID_VALUE, STRING_CONST("Corrupted timeline valuation store %.*s"), (int)path_length, path);
+        timeline_valuation_clear(valuation);
+    }
+
+    return valuation;
+}
+
+FOUNDATION_EXTERN bool timeline_valuation_save(const timeline_valuation_t* valuation, const char* path, size_t path_length)
+{
+    // The store is written next to the previous one and then replaces it, so a crash never leaves a partial store.
+    char temp_path_buffer[BUILD_MAX_PATHLEN];
+    string_t temp_path = string_format(STRING_BUFFER(temp_path_buffer), STRING_CONST("%.*s.tmp"), (int)path_length, path);
+    stream_t* stream = fs_open_file(STRING_ARGS(temp_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+    if (stream == nullptr)
+    {
+        log_errorf(HASH_TIMELINE, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to write timeline valuation store %.*s"), (int)path_length, path);
+        return false;
+    }
+
+    timeline_valuation_store_header_t header{ { 'T', 'L', 'V', 'S' }, TIMELINE_VALUATION_STORE_VERSION, 
+        array_size(valuation->titles), valuation->day_count, (int64_t)valuation->first_date, valuation->currency_key };
+    bool success = stream_write(stream, &header, sizeof(header)) == sizeof(header);
+
+    foreach(title, valuation->titles)
+    {
+        if (!success)
+            break;
+
+        timeline_valuation_store_title_t st;
+        st.key = title->key;
+        memcpy(st.code, title->code, sizeof(st.code));
+        st.first_day = title->first_day;
+        st.order_count = array_size(title->orders);
+        st.value_count = array_size(title->values);
+
+        const size_t orders_size = sizeof(timeline_valuation_order_t) * st.order_count;
+        const size_t values_size = sizeof(double) * st.value_count;
+        success = stream_write(stream, &st, sizeof(st)) == sizeof(st) &&
+            stream_write(stream, title->orders, orders_size) == orders_size &&
+            stream_write(stream, title->values, values_size) == values_size;
+    }
+
+    stream_deallocate(stream);
+
+    if (!success || !system_replace_file(STRING_ARGS(temp_path), path, path_length))
+    {
+        log_errorf(HASH_TIMELINE, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to write timeline valuation store %.*s"), (int)path_length, path);
+        fs_remove_file(STRING_ARGS(temp_path));
+        return false;
+    }
+
+    return true;
+}
+
+FOUNDATION_STATIC string_const_t timeline_valuation_store_path(const report_t* report)
+{
+    string_const_t report_id = string_from_uuid_static(report->id);
+    return session_get_user_file_path(STRING_ARGS(report_id), STRING_CONST("reports"), STRING_CONST("timeline"));
+}
+
+/*! Insert a day for each day without transactions and set the daily total values. */
+FOUNDATION_STATIC timeline_t* timeline_fill_days(timeline_t* transaction_days, const timeline_valuation_t* valuation, const double* totals)
+{
+    const unsigned transaction_day_count = array_size(transaction_days);
+
+    timeline_t* days = nullptr;
+    array_reserve(days, valuation->day_count + transaction_day_count);
+    for (unsigned d = 0, tidx = 0; d < valuation->day_count; ++d)
+    {
+        bool has_transactions = false;
+        for (; tidx < transaction_day_count && timeline_valuation_day_index(valuation, transaction_days[tidx].date) <= d; ++tidx)
+        {
+            timeline_t day = transaction_days[tidx];
+            day.total_value = totals[d];
+            array_push(days, day);
+            has_transactions = true;
+        }
+
+        if (has_transactions || array_size(days) == 0)
+            continue;
+
+        const timeline_t* previous_day = array_last(days);
+
+        timeline_t day;
+        day.date = valuation->first_date + d * time_one_day();
+        day.stocks = nullptr;
+        day.total_gain = previous_day->total_gain;
+        day.total_dividends = previous_day->total_dividends;
+        day.total_value = totals[d];
+        day.total_fund = previous_day->total_fund;
+        day.total_investment = previous_day->total_investment;
+        array_push(days, day);
+    }
+
+    // Stocks of transaction days were moved to the new days.
+    array_deallocate(transaction_days);
+    return days;
+}
+
 FOUNDATION_STATIC timeline_report_t* timeline_report_allocate(const report_t* report)
 {
-    timeline_report_t* timeline_report = (timeline_report_t*)memory_allocate(HASH_TIMELINE, sizeof(timeline_report_t), 0, MEMORY_PERSISTENT);
-    timeline_report->days = nullptr;
-    timeline_report->transactions = nullptr;
+    timeline_report_t* timeline_report = MEM_NEW(HASH_TIMELINE, timeline_report_t);
     
     string_const_t report_name = SYMBOL_CONST(report->name);
     string_const_t fmttr = RTEXT("Timeline %.*s");
     timeline_report->title = string_allocate_format(STRING_ARGS(fmttr), STRING_FORMAT(report_name));
-    timeline_report->preferred_currency = string_to_const(report->wallet->preferred_currency);
+    timeline_report->preferred_currency = string_clone(STRING_ARGS(report->wallet->preferred_currency));
+
+    string_const_t store_path = timeline_valuation_store_path(report);
+    timeline_report->store_path = string_clone(STRING_ARGS(store_path));
+    timeline_report->report = report->id;
 
     return timeline_report;
 }
@@ -479,10 +1052,20 @@ FOUNDATION_STATIC timeline_report_t* timeline_report_allocate(const report_t* re
 FOUNDATION_STATIC void timeline_report_deallocate(timeline_report_t*& timeline_report)
 {
     string_deallocate(timeline_report->title.str);
+    string_deallocate(timeline_report->preferred_currency.str);
+    string_deallocate(timeline_report->store_path.str);
     timeline_deallocate(timeline_report->days);
     array_deallocate(timeline_report->transactions);
-    memory_deallocate(timeline_report);
-    timeline_report = nullptr;
+    MEM_DELETE(timeline_report);
+}
+
+/*! Release a reference to a timeline report, the last one deallocates it. */
+FOUNDATION_STATIC void timeline_report_release(timeline_report_t* timeline_report)
+{
+    if (atomic_decr32(&timeline_report->refs, memory_order_acq_rel) > 0)
+        return;
+
+    timeline_report_deallocate(timeline_report);
 }
 
 FOUNDATION_STATIC void timeline_report_plot_day_value(const char* title, size_t title_length, const timeline_t* timeline, function<double(const timeline_t* day)>&& fn, float line_weight = 2.0f, bool default_hide = false)
@@ -770,10 +1353,100 @@ FOUNDATION_STATIC void timeline_report_toolbar(timeline_report_t* report)
     ImGui::EndGroup();
 }
 
+/*! Collect the transactions of the report once all its titles are resolved.
+ *
+ *  @return False if some titles are still resolving.
+ */
+FOUNDATION_STATIC bool timeline_report_collect_transactions(timeline_report_t* timeline_report, const report_t* report)
+{
+    bool resolved = true;
+    foreach(tt, report->titles)
+    {
+        title_t* t = *tt;
+        if (!title_is_resolved(t) && title_update(t, 10.0))
+            resolved = false;
+    }
+
+    if (!resolved)
+        return false;
+
+    // Load exchange rate series in parallel before they get queried for every order and day.
+    foreach(pt, report->titles)
+    {
+        const title_t* t = *pt;
+        stock_exchange_rate_prefetch_symbol(t->code, t->code_length, STRING_ARGS(timeline_report->preferred_currency));
+    }
+
+    timeline_report->transactions = timeline_report_compute_transactions(report);
+    return true;
+}
+
+/*! Compute the timeline days of a report and update its stored daily valuation.
+ *  This waits for stocks and exchange rates to resolve, so it must run in a job.
+ */
+FOUNDATION_STATIC void timeline_report_build(timeline_report_t* timeline_report)
+{
+    string_const_t preferred_currency = string_to_const(timeline_report->preferred_currency);
+    timeline_transactions_prepare(timeline_report->transactions, preferred_currency);
+    timeline_t* transaction_days = timeline_build(timeline_report->transactions);
+
+    // Only value days since the first transaction that changed from the stored valuation.
+    timeline_valuation_t* valuation = timeline_valuation_load(STRING_ARGS(timeline_report->store_path));
+    const double* totals = timeline_valuation_update(valuation, timeline_report->transactions, preferred_currency, time_now());
+    if (totals)
+    {
+        timeline_report->days = timeline_fill_days(transaction_days, valuation, totals);
+        timeline_valuation_save(valuation, STRING_ARGS(timeline_report->store_path));
+    }
+    else
+    {
+        timeline_report->days = transaction_days;
+    }
+    timeline_valuation_deallocate(valuation);
+
+    atomic_store32(&timeline_report->built, 1, memory_order_release);
+}
+
+/*! Launch the job computing the timeline days once the report titles are resolved.
+ *
+ *  @return True once the timeline days are computed.
+ */
+FOUNDATION_STATIC bool timeline_report_update_build(timeline_report_t* timeline_report)
+{
+    if (atomic_load32(&timeline_report->built, memory_order_acquire))
+        return true;
+
+    if (timeline_report->building)
+        return false;
+
+    const report_t* report = report_get(timeline_report->report);
+    if (report == nullptr || !timeline_report_collect_transactions(timeline_report, report))
+        return false;
+
+    // The job keeps the timeline report alive if the window gets closed in the meantime.
+    timeline_report->building = true;
+    atomic_incr32(&timeline_report->refs, memory_order_relaxed);
+    job_execute([](payload_t* payload)
+    {
+        timeline_report_t* timeline_report = (timeline_report_t*)payload;
+        timeline_report_build(timeline_report);
+        timeline_report_release(timeline_report);
+        return 0;
+    }, timeline_report, JOB_DEALLOCATE_AFTER_EXECUTION);
+
+    return false;
+}
+
 FOUNDATION_STATIC bool timeline_report_graph_dialog(void* user_data)
 {
     timeline_report_t* report = (timeline_report_t*)user_data;
 
+    if (!timeline_report_update_build(report))
+    {
+        ImGui::TrTextUnformatted("Building timeline...");
+        return true;
+    }
+
     if (array_size(report->days) <= 2)
     {
         ImGui::TrTextUnformatted("No transactions to display");
@@ -787,7 +1460,7 @@ FOUNDATION_STATIC bool timeline_report_graph_dialog(void* user_data)
 FOUNDATION_STATIC void timeline_report_graph_close(void* user_data)
 {
     timeline_report_t* timeline_report = (timeline_report_t*)user_data;
-    timeline_report_deallocate(timeline_report);
+    timeline_report_release(timeline_report);
 }
 
 FOUNDATION_STATIC void timeline_window_render_report(window_handle_t window_handle)
@@ -795,6 +1468,9 @@ FOUNDATION_STATIC void timeline_window_render_report(window_handle_t window_hand
     timeline_report_t* report = (timeline_report_t*)window_get_user_data(window_handle);
     FOUNDATION_ASSERT(report);
 
+    if (!timeline_report_update_build(report))
+        return ImGui::TrTextUnformatted("Building timeline...");
+
     if (array_size(report->days) <= 2)
         return ImGui::TrTextUnformatted("No transactions to display");
 
@@ -813,7 +1489,7 @@ FOUNDATION_STATIC void timeline_window_report_close(window_handle_t window_handl
     timeline_report_t* report = (timeline_report_t*)window_get_user_data(window_handle);
     FOUNDATION_ASSERT(report);
     
-    timeline_report_deallocate(report);
+    timeline_report_release(report);
 }
 
 //
@@ -823,46 +1499,36 @@ FOUNDATION_STATIC void timeline_window_report_close(window_handle_t window_handl
 void timeline_render_graph(const report_t* report)
 {
     timeline_report_t* timeline_report = timeline_report_allocate(report);
-    timeline_report->transactions = timeline_report_compute_transactions(report, timeline_report->preferred_currency);
-    timeline_report->days = timeline_build(timeline_report->transactions, timeline_report->preferred_currency);
-
-    // Insert new days with updated total current value
-    auto days = timeline_report->days;
-    for (time_t d = days[0].date, end = time_now() + time_one_day() / 2; d <= end; d += time_one_day())
-    {
-        int didx = array_binary_search(days, array_size(days), d);
-        if (didx >= 0)
-            continue;
-
-        didx = ~didx;        
-        int idx = didx;
-        timeline_t* previous_day = nullptr;
-        while (idx >= 0)
-        {
-            if (to_uint(idx) < array_size(days) && days[idx].stocks)
-            {
-                previous_day = &days[idx];
-                break;
-            }
-            idx--;
-        }
-
-        if (previous_day == nullptr)
-            continue;
-
-        timeline_t day;
-        day.date = d;
-        day.stocks = nullptr;
-        day.total_gain = previous_day->total_gain;
-        day.total_dividends = previous_day->total_dividends;
-        day.total_value = day.total_value = timeline_compute_day_total_value(previous_day->stocks, day.date, timeline_report->preferred_currency);
-        day.total_fund = previous_day->total_fund;
-        day.total_investment = previous_day->total_investment;
-        timeline_report->days = array_insert(days, didx, day);
-    }
+    timeline_report_update_build(timeline_report);
 
     window_open(
         "timeline_window", STRING_ARGS(timeline_report->title), 
         timeline_window_render_report, timeline_window_report_close, 
         timeline_report, WindowFlags::Transient | WindowFlags::Maximized);
 }
+
+unsigned timeline_rebuild(const report_t* report)
+{
+    timeline_report_t* timeline_report = timeline_report_allocate(report);
+    while (!timeline_report_collect_transactions(timeline_report, report))
+        dispatcher_wait_for_wakeup_main_thread(10000);
+
+    job_t* build_job = job_execute([timeline_report](payload_t* payload)
+    {
+        timeline_report_build(timeline_report);
+        return 0;
+    });
+    job_wait(build_job);
+    job_deallocate(build_job);
+
+    const unsigned day_count = array_size(timeline_report->days);
+    timeline_report_deallocate(timeline_report);
+    return day_count;
+}
+
+void timeline_delete_store(const report_t* report)
+{
+    string_const_t store_path = timeline_valuation_store_path(report);
+    if (fs_is_file(STRING_ARGS(store_path)))
+        fs_remove_file(STRING_ARGS(store_path));
+}
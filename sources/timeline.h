@@ -5,6 +5,50 @@
 
 #pragma once
 
+#include <foundation/hash.h>
+#include <foundation/math.h>
+
 struct report_t;
 
+typedef enum class TimelineTransactionType
+{
+    UNDEFINED = 0,
+    BUY,
+    SELL,
+    DIVIDEND,
+    EXCHANGE_RATE
+} timeline_transaction_type_t;
+
+/*! Report title order used to build the timeline. */
+struct timeline_transaction_t
+{
+    time_t date{ 0 };
+    hash_t code_key{ 0 };
+    char code[16] = { '\0' };
+
+    double qty{ NAN };
+    double price{ NAN };
+    timeline_transaction_type_t type { TimelineTransactionType::UNDEFINED };
+
+    double close{ NAN };
+    double split_close{ NAN };
+    double adjusted_close{ NAN };
+    double exchange_rate{ NAN };
+
+    double split_factor{ 1.0 };
+    double adjusted_factor{ 1.0 };
+
+    unsigned same_day_count{ 0 }; // Number of transactions of the same title on that day
+};
+
+/*! Open a window showing the evolution of the report values since its first transaction. */
 void timeline_render_graph(const report_t* report);
+
+/*! Compute the report timeline and update its stored daily valuation without opening a window.
+ *
+ *  @return The number of days in the timeline.
+ */
+unsigned timeline_rebuild(const report_t* report);
+
+/*! Delete the daily valuation series stored for the report timeline. */
+void timeline_delete_store(const report_t* report);
@@ -13,6 +13,7 @@
 #include <framework/string.h>
 #include <framework/array.h>
 #include <framework/jobs.h>
+#include <framework/epoch.h>
 
 #define FIELD_FILTERS_INTERNAL "::filters"
 
@@ -144,11 +145,14 @@ FOUNDATION_STATIC bool title_fetch_ask_price(const title_t* t, double& value)
     unsigned samples = 0;
     double sampling_average_fg = 0.0f;
     unsigned max_samping_days = math_floor(days_held / 2.0f);
-    for (unsigned i = 2, end = array_size(s->history); i < end && samples < max_samping_days; ++i)
+
+    EPOCH_SCOPE();
+    const day_result_t* history = s->history;
+    for (unsigned i = 2, end = array_size(history); i < end && samples < max_samping_days; ++i)
     {
-        if (s->history[i].date > t->date_average)
+        if (history[i].date > t->date_average)
         {
-            sampling_average_fg += s->history[i].adjusted_close;
+            sampling_average_fg += history[i].adjusted_close;
             samples++;
         }
     }
@@ -232,12 +236,14 @@ double title_get_total_gain_p(const title_t* t)
 
 double title_get_yesterday_change(const title_t* t, const stock_t* s)
 {
+    EPOCH_SCOPE();
     const day_result_t* ed = stock_get_EOD(s, -1);
     return ed ? ed->change_p : DNAN;
 }
 
 double title_get_range_change_p(const title_t* t, const stock_t* s, int rel_days, bool take_last /*= false*/)
 {
+    EPOCH_SCOPE();
     const day_result_t* ed = stock_get_EOD(s, rel_days, take_last);
     if (ed == nullptr)
         return DNAN;
@@ -518,6 +524,14 @@ void title_init(title_t* t, wallet_t* wallet, const config_handle_t& data)
     t->ps.reset([t](double& value){ return title_fetch_ps(t, value); });
     t->ask_price.reset([t](double& value){ return title_fetch_ask_price(t, value); });
     t->today_exchange_rate.reset([t](double& value){ return title_fetch_today_exchange_rate(t, value); });
+
+    // Publish the new revision once all the values are computed, i.e. when refreshed by a job.
+    atomic_incr32(&t->revision, memory_order_release);
+}
+
+uint32_t title_revision(const title_t* t)
+{
+    return (uint32_t)atomic_load32(&t->revision, memory_order_acquire);
 }
 
 bool title_refresh(title_t* title)
@@ -606,11 +620,22 @@ title_t* title_allocate(wallet_t* wallet /*= nullptr*/, const config_handle_t& d
     return new_title;
 }
 
-void title_deallocate(title_t*& title)
+FOUNDATION_STATIC void title_retired_deallocate(void* ptr)
 {
+    title_t* title = (title_t*)ptr;
     MEM_DELETE(title);
 }
 
+void title_deallocate(title_t*& title)
+{
+    if (title == nullptr)
+        return;
+
+    // Background passes evaluating report expressions can read the title until they leave their epoch.
+    epoch_retire(title, title_retired_deallocate);
+    title = nullptr;
+}
+
 time_t title_last_transaction_date(const title_t* t)
 {
     time_t last_date = 0;
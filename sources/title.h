@@ -14,6 +14,7 @@
 #include <framework/config.h>
 
 #include <foundation/string.h>
+#include <foundation/atomic.h>
 
 struct wallet_t;
 
@@ -76,6 +77,10 @@ FOUNDATION_ALIGNED_STRUCT(title_t, 8)
     double_option_t ask_price{ DNAN };
     double_option_t today_exchange_rate{ 1.0 };
     mutable double_option_t average_days_held{ DNAN };
+
+    // Incremented once the values computed from the orders are updated, so that values derived from them can be invalidated.
+    // Read it with #title_revision, which synchronizes with the values it was published with.
+    atomic32_t revision{ 0 };
 };
 
 /*! Allocates a new title to be assigned to a report wallet.
@@ -203,6 +208,14 @@ void title_init(title_t* t, wallet_t* wallet, const config_handle_t& data);
  */
 bool title_refresh(title_t* title);
 
+/*! Returns the revision of the title values, which changes each time they are computed again.
+ *
+ *  @param t The title to check.
+ *
+ *  @return The revision of the title, values read after it are at least as recent.
+ */
+uint32_t title_revision(const title_t* t);
+
 /*! Return the minimal stock fetch level for this title. 
  *
  *  @remark We take into account the title type and the stock type.
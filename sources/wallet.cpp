@@ -22,14 +22,237 @@
 
 #include <foundation/hash.h>
 #include <foundation/uuid.h>
+#include <foundation/fs.h>
+#include <foundation/stream.h>
 
-FOUNDATION_STATIC void wallet_history_update_entry(report_t* report, wallet_t* wallet, wallet_history_t* entry)
+#define WALLET_HISTORY_STORE_VERSION 1
+
+constexpr string_const_t WALLET_HISTORY_STORE_DIR_NAME = CTEXT("reports");
+
+/*! Daily valuation record as written in the wallet history store.
+ *  Records are written in chronological order so that daily updates only append (or rewrite) the last record.
+ */
+struct wallet_history_record_t
+{
+    int64_t date;
+    double funds;
+    double gain;
+    double investments;
+    double total_value;
+    double broker_value;
+    double other_assets;
+};
+
+FOUNDATION_ALIGNED_STRUCT(wallet_history_store_header_t, 8) {
+    char magic[4] = { 0 };
+    uint32_t version = 0;
+    uint32_t record_size = 0;
+    uint32_t record_count = 0;
+};
+
+FOUNDATION_STATIC void wallet_history_prepare(wallet_t* wallet)
+{
+    const unsigned history_count = array_size(wallet->history);
+
+    // Compute values that only depend on the entry itself.
+    for (unsigned i = 0; i < history_count; ++i)
+    {
+        wallet_history_t& h = wallet->history[i];
+        h.source = wallet;
+        h.total_value_gain = (h.total_value - h.investments) + (h.gain + h.funds);
+        h.wealth = h.total_value_gain + h.other_assets;
+
+        if (h.investments == 0)
+        {
+            h.total_gain_p = NAN;
+        }
+        else
+        {
+            const double cash_flow = math_ifzero(h.funds, h.investments);
+            h.total_gain_p = (h.total_value_gain - cash_flow) / cash_flow * 100.0;
+        }
+    }
+
+    // History is sorted from newer to older, so the previous entry is always the next one.
+    for (unsigned i = 0; i < history_count; ++i)
+    {
+        wallet_history_t& h = wallet->history[i];
+        if (i + 1 >= history_count)
+        {
+            h.change = NAN;
+            h.change_p = NAN;
+            continue;
+        }
+
+        const wallet_history_t& p = wallet->history[i + 1];
+        h.change = h.total_value_gain - p.total_value_gain;
+
+        if (math_real_is_zero(p.total_value))
+            h.change_p = NAN;
+        else if (math_real_is_zero(p.total_value_gain) || !math_real_is_finite(p.total_value_gain))
+            h.change_p = 0.0;
+        else
+            h.change_p = h.change / p.total_value_gain * 100.0;
+    }
+
+    // Prepare graph date range and ticks
+    time_t last = 0;
+    wallet->history_min_date = time_now();
+    wallet->history_max_date = 0;
+    wallet->history_day_space = 1;
+    for (unsigned i = 0; i < history_count; ++i)
+    {
+        const wallet_history_t& h = wallet->history[i];
+        if (last != 0)
+            wallet->history_day_space = math_round(time_elapsed_days(h.date, last));
+        last = h.date;
+        wallet->history_max_date = max(wallet->history_max_date, h.date);
+        wallet->history_min_date = min(wallet->history_min_date, h.date);
+    }
+
+    array_clear(wallet->history_dates);
+    for (int i = history_count - 1; i >= 0; --i)
+        array_push(wallet->history_dates, (double)wallet->history[i].date);
+    double* hd = wallet->history_dates;
+    for (int i = 0, end = array_size(hd); i < end - 1; ++i)
+    {
+        if (time_elapsed_days((time_t)hd[i], (time_t)hd[i + 1]) < wallet->history_day_space)
+            hd[i] = NAN;
+    }
+}
+
+FOUNDATION_STATIC wallet_history_record_t wallet_history_to_record(const wallet_history_t& h)
+{
+    wallet_history_record_t r;
+    r.date = (int64_t)h.date;
+    r.funds = h.funds;
+    r.gain = h.gain;
+    r.investments = h.investments;
+    r.total_value = h.total_value;
+    r.broker_value = h.broker_value;
+    r.other_assets = h.other_assets;
+    return r;
+}
+
+FOUNDATION_STATIC bool wallet_history_store_write(wallet_t* wallet)
+{
+    if (wallet->history_store_path.length == 0)
+        return false;
+
+    stream_t* stream = fs_open_file(STRING_ARGS(wallet->history_store_path), STREAM_CREATE | STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+    if (stream == nullptr)
+    {
+        log_errorf(HASH_REPORT, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to write wallet history store %.*s"), STRING_FORMAT(wallet->history_store_path));
+        return false;
+    }
+
+    const unsigned history_count = array_size(wallet->history);
+    wallet_history_store_header_t header{ { 'W', 'H', 'I', 'S' }, WALLET_HISTORY_STORE_VERSION, sizeof(wallet_history_record_t), history_count };
+    stream_write(stream, &header, sizeof(header));
+
+    // Write records from older to newer
+    for (int i = history_count - 1; i >= 0; --i)
+    {
+        const wallet_history_record_t r = wallet_history_to_record(wallet->history[i]);
+        stream_write(stream, &r, sizeof(r));
+    }
+
+    stream_deallocate(stream);
+    wallet->history_store_dirty = false;
+    return true;
+}
+
+/*! Write the most recent history entry to the store without rewriting older records.
+ * 
+ *  @param wallet       The wallet owning the history store.
+ *  @param replace_last True if the last stored record is the same day as the entry and must be overwritten.
+ */
+FOUNDATION_STATIC bool wallet_history_store_append(wallet_t* wallet, const wallet_history_t& entry, bool replace_last)
+{
+    if (wallet->history_store_path.length == 0)
+        return false;
+
+    if (wallet->history_store_dirty || !fs_is_file(STRING_ARGS(wallet->history_store_path)))
+        return wallet_history_store_write(wallet);
+
+    stream_t* stream = fs_open_file(STRING_ARGS(wallet->history_store_path), STREAM_IN | STREAM_OUT | STREAM_BINARY);
+    if (stream == nullptr)
+        return wallet_history_store_write(wallet);
+
+    wallet_history_store_header_t header;
+    if (stream_read(stream, &header, sizeof(header)) != sizeof(header) || 
+        header.version != WALLET_HISTORY_STORE_VERSION || header.record_size != sizeof(wallet_history_record_t) ||
+        (replace_last && header.record_count == 0))
+    {
+        stream_deallocate(stream);
+        return wallet_history_store_write(wallet);
+    }
+
+    if (!replace_last)
+        header.record_count++;
+
+    const wallet_history_record_t r = wallet_history_to_record(entry);
+    stream_seek(stream, sizeof(header) + (header.record_count - 1) * sizeof(wallet_history_record_t), STREAM_SEEK_BEGIN);
+    stream_write(stream, &r, sizeof(r));
+
+    stream_seek(stream, 0, STREAM_SEEK_BEGIN);
+    stream_write(stream, &header, sizeof(header));
+    stream_deallocate(stream);
+    return true;
+}
+
+FOUNDATION_STATIC bool wallet_history_store_read(wallet_t* wallet)
+{
+    stream_t* stream = fs_open_file(STRING_ARGS(wallet->history_store_path), STREAM_IN | STREAM_BINARY);
+    if (stream == nullptr)
+        return false;
+
+    wallet_history_store_header_t header;
+    if (stream_read(stream, &header, sizeof(header)) != sizeof(header) || !string_equal(header.magic, 4, STRING_CONST("WHIS")) ||
+        header.version != WALLET_HISTORY_STORE_VERSION || header.record_size != sizeof(wallet_history_record_t))
+    {
+        log_warnf(HASH_REPORT, WARNING_INVALID_VALUE, STRING_CONST("Invalid wallet history store %.*s"), STRING_FORMAT(wallet->history_store_path));
+        stream_deallocate(stream);
+        return false;
+    }
+
+    wallet_history_record_t* records = nullptr;
+    array_resize(records, header.record_count);
+    const size_t records_size = header.record_count * sizeof(wallet_history_record_t);
+    const bool valid = stream_read(stream, records, records_size) == records_size;
+    stream_deallocate(stream);
+
+    if (valid)
+    {
+        array_clear(wallet->history);
+        array_reserve(wallet->history, header.record_count);
+        for (int i = (int)header.record_count - 1; i >= 0; --i)
+        {
+            const wallet_history_record_t& r = records[i];
+
+            wallet_history_t h{ (time_t)r.date };
+            h.funds = r.funds;
+            h.gain = r.gain;
+            h.investments = r.investments;
+            h.total_value = r.total_value;
+            h.broker_value = r.broker_value;
+            h.other_assets = r.other_assets;
+            h.source = wallet;
+            array_push_memcpy(wallet->history, &h);
+        }
+    }
+
+    array_deallocate(records);
+    return valid;
+}
+
+FOUNDATION_STATIC void wallet_history_update_entry(report_t* report, wallet_t* wallet, wallet_history_t* entry, time_t date)
 {
     FOUNDATION_ASSERT(report);
     FOUNDATION_ASSERT(wallet);
     FOUNDATION_ASSERT(entry);
 
-    entry->date = time_now();
+    entry->date = date;
     entry->source = wallet;
     entry->funds = wallet_total_funds(wallet);
     entry->investments = report->total_investment;
@@ -53,13 +276,17 @@ FOUNDATION_STATIC void wallet_history_sort(wallet_t* wallet)
     {
         return b.date - a.date;
     });
+
+    wallet_history_prepare(wallet);
 }
 
 FOUNDATION_STATIC void wallet_history_delete_entry(report_t* report, wallet_history_t* h)
 {
     size_t pos = h - &h->source->history[0];
     array_erase(h->source->history, pos);
+    h->source->history_store_dirty = true;
     wallet_history_sort(report->wallet);
+    report_summary_invalidate(report);
     report_summary_update(report);
     report->dirty = true;
 }
@@ -74,7 +301,9 @@ FOUNDATION_STATIC bool wallet_history_refresh_entry(report_t* report, wallet_t*
     }
     
     entry.source = wallet;
-    wallet_history_update_entry(report, wallet, &entry);
+    wallet_history_update_entry(report, wallet, &entry, time_now());
+    wallet->history_store_dirty = true;
+    wallet_history_prepare(wallet);
     
     return true;
 }
@@ -187,7 +416,9 @@ FOUNDATION_STATIC void wallet_open_history_edit_dialog(report_t* report, wallet_
             if (updated)
             {
                 WAIT_CURSOR;
+                h->source->history_store_dirty = true;
                 wallet_history_sort(h->source);
+                report_summary_invalidate(report);
                 report_summary_update(report);
             }
         }
@@ -375,98 +606,28 @@ FOUNDATION_STATIC table_cell_t wallet_history_column_assets(table_element_ptr_t
     return h->other_assets;
 }
 
-FOUNDATION_STATIC double wallet_history_total_value_gain(const wallet_history_t* h)
-{
-    return (h->total_value - h->investments) + (h->gain + h->funds);
-}
-
-FOUNDATION_STATIC const wallet_history_t* wallet_history_get_previous(const wallet_history_t* h)
-{
-    if (!h->source)
-        return nullptr;
-
-    const size_t h_count = array_size(h->source->history);
-    if (h_count < 2)
-        return nullptr;
-
-    const wallet_history_t* p = h + 1;
-    const size_t pos = pointer_diff(p, &h->source->history[0]) / sizeof(wallet_history_t);
-
-    if (pos >= h_count)
-        return nullptr;
-
-    if (h->source->history_period == WALLET_HISTORY_MONTLY)
-    {
-        // TODO:
-    }
-    else if (h->source->history_period == WALLET_HISTORY_YEARLY)
-    {
-        // TODO:
-    }
-
-    return p;
-}
-
-FOUNDATION_STATIC double wallet_history_total_gain_p(const wallet_history_t* h)
-{
-    if (h->investments == 0)
-        return NAN;
-
-    const double total_gain = wallet_history_total_value_gain(h);
-    const double cash_flow = math_ifzero(h->funds, h->investments);
-    const double diff = total_gain - cash_flow;
-    const double adjusted_total_gain = total_gain + h->gain;
-    return diff / cash_flow * 100.0;
-}
-
 FOUNDATION_STATIC table_cell_t wallet_history_column_total_gain_p(table_element_ptr_t element, const table_column_t* column)
 {
     wallet_history_t* h = (wallet_history_t*)element;
-    return wallet_history_total_gain_p(h);
-}
-
-FOUNDATION_STATIC double wallet_history_wealth(const wallet_history_t* h)
-{
-    return wallet_history_total_value_gain(h) + h->other_assets;
+    return h->total_gain_p;
 }
 
 FOUNDATION_STATIC table_cell_t wallet_history_column_wealth(table_element_ptr_t element, const table_column_t* column)
 {
     wallet_history_t* h = (wallet_history_t*)element;
-    return wallet_history_wealth(h);
+    return h->wealth;
 }
 
 FOUNDATION_STATIC table_cell_t wallet_history_column_change(table_element_ptr_t element, const table_column_t* column)
 {
     wallet_history_t* h = (wallet_history_t*)element;
-    const wallet_history_t* p = wallet_history_get_previous(h);
-    if (!p)
-        return NAN;
-
-    return wallet_history_total_value_gain(h) - wallet_history_total_value_gain(p);
-}
-
-FOUNDATION_STATIC double wallet_history_change_p(const wallet_history_t* h)
-{
-    const wallet_history_t* p = wallet_history_get_previous(h);
-    if (!p)
-        return NAN;
-
-    if (math_real_is_zero(p->total_value))
-        return NAN;
-
-    const double prev_value = wallet_history_total_value_gain(p);
-    const double diff = wallet_history_total_value_gain(h) - prev_value;
-
-    if (math_real_is_zero(prev_value) || !math_real_is_finite(prev_value))
-        return 0.0;
-    return diff / prev_value * 100.0;
+    return h->change;
 }
 
 FOUNDATION_STATIC table_cell_t wallet_history_column_change_p(table_element_ptr_t element, const table_column_t* column)
 {
     wallet_history_t* h = (wallet_history_t*)element;
-    table_cell_t cv(wallet_history_change_p(h));
+    table_cell_t cv(h->change_p);
     
     if (cv.number <= 0)
     {
@@ -510,22 +671,6 @@ FOUNDATION_STATIC table_t* wallet_history_create_table(report_t* report)
     return history_table;
 }
 
-FOUNDATION_STATIC void wallet_history_min_max_date(wallet_t* wallet, time_t& min, time_t& max, double& space)
-{
-    min = time_now();
-    max = 0;
-    space = 1;
-    time_t last = 0;
-    foreach (h, wallet->history)
-    {
-        if (last != 0)
-            space = math_round(time_elapsed_days(h->date, last));
-        last = h->date;
-        max = ::max(max, h->date);
-        min = ::min(min, h->date);
-    }
-}
-
 FOUNDATION_STATIC void wallet_history_draw_graph(report_t* report, wallet_t* wallet)
 {
     const unsigned history_count = array_size(wallet->history);
@@ -535,29 +680,15 @@ FOUNDATION_STATIC void wallet_history_draw_graph(report_t* report, wallet_t* wal
         return;
     }
 
-    double day_space;
-    time_t min_d, max_d;
-    wallet_history_min_max_date(wallet, min_d, max_d, day_space);
+    double day_space = wallet->history_day_space;
+    const time_t min_d = wallet->history_min_date;
+    const time_t max_d = wallet->history_max_date;
 
     const double day_range = time_elapsed_days(min_d, max_d);
     const ImVec2 graph_offset = ImVec2(-ImGui::GetStyle().CellPadding.x, -ImGui::GetStyle().CellPadding.y);
     if (!ImPlot::BeginPlot(string_format_static_const("History###%s", string_table_decode(report->name)), graph_offset, ImPlotFlags_NoChild | ImPlotFlags_NoFrame | ImPlotFlags_NoTitle))
         return;
 
-    if (array_size(wallet->history_dates) != history_count)
-    {
-        array_deallocate(wallet->history_dates);
-        foreach (h, wallet->history)
-            array_push(wallet->history_dates, (double)h->date);
-        array_sort(wallet->history_dates);
-        double* hd = wallet->history_dates;
-        for (int i = 0, end = array_size(hd); i < end - 1; ++i)
-        {
-            if (time_elapsed_days((time_t)hd[i], (time_t)hd[i+1]) < day_space)
-                hd[i] = NAN;
-        }
-    }
-
     const double bar_width = time_one_day() * day_space * 0.8;
     ImPlot::SetupLegend(ImPlotLocation_NorthWest, ImPlotLegendFlags_Horizontal);
 
@@ -612,7 +743,7 @@ FOUNDATION_STATIC void wallet_history_draw_graph(report_t* report, wallet_t* wal
     {
         const wallet_history_t& h = c->get_user_data<wallet_history_t>()[idx];
         const double x = (double)h.date;
-        const double y = wallet_history_total_value_gain(&h);
+        const double y = h.total_value_gain;
         return ImPlotPoint(x, y);
     });
 
@@ -640,7 +771,7 @@ FOUNDATION_STATIC void wallet_history_draw_graph(report_t* report, wallet_t* wal
         const plot_context_t* c = (plot_context_t*)user_data;
         const wallet_history_t& h = ((const wallet_history_t*)c->user_data)[idx];
         const double x = (double)h.date;
-        const double y = wallet_history_total_gain_p(&h);
+        const double y = h.total_gain_p;
         return ImPlotPoint(x, y);
     }, &c, (int)c.range, ImPlotLineFlags_SkipNaN);
 
@@ -653,7 +784,7 @@ FOUNDATION_STATIC void wallet_history_draw_graph(report_t* report, wallet_t* wal
             const plot_context_t* c = (plot_context_t*)user_data;
             const wallet_history_t& h = ((const wallet_history_t*)c->user_data)[idx];
             const double x = (double)h.date;
-            const double y = wallet_history_change_p(&h);
+            const double y = h.change_p;
             return ImPlotPoint(x, y);
         }, &c, (int)c.range, ImPlotLineFlags_SkipNaN);
     }
@@ -743,7 +874,36 @@ wallet_t* wallet_allocate(config_handle_t wallet_data)
     return wallet;
 }
 
-void wallet_save(wallet_t* wallet, config_handle_t wallet_data)
+void wallet_history_load(wallet_t* wallet, const char* store_name, size_t store_name_length)
+{
+    FOUNDATION_ASSERT(wallet);
+
+    string_const_t store_file_name = fs_clean_file_name(store_name, store_name_length);
+    string_const_t store_path = session_get_user_file_path(STRING_ARGS(store_file_name), STRING_ARGS(WALLET_HISTORY_STORE_DIR_NAME), STRING_CONST("history"));
+    string_deallocate(wallet->history_store_path.str);
+    wallet->history_store_path = string_clone(STRING_ARGS(store_path));
+
+    if (fs_is_file(STRING_ARGS(wallet->history_store_path)))
+    {
+        if (wallet_history_store_read(wallet))
+            wallet->history_store_dirty = false;
+    }
+    else if (array_size(wallet->history) > 0)
+    {
+        // Migrate history entries loaded from the report config.
+        wallet->history_store_dirty = true;
+    }
+
+    wallet_history_sort(wallet);
+}
+
+void wallet_history_delete_store(wallet_t* wallet)
+{
+    if (wallet->history_store_path.length && fs_is_file(STRING_ARGS(wallet->history_store_path)))
+        fs_remove_file(STRING_ARGS(wallet->history_store_path));
+}
+
+void wallet_save(wallet_t* wallet, config_handle_t wallet_data, bool embed_history /*= false*/)
 {
     config_set(wallet_data, "main_target", wallet->main_target);
     config_set(wallet_data, "show_extra_charts", wallet->show_extra_charts);
@@ -761,6 +921,16 @@ void wallet_save(wallet_t* wallet, config_handle_t wallet_data)
     }
 
     config_remove(wallet_data, wallet_data["history"]);
+
+    // History is saved in its own store if the wallet has one, unless the wallet gets exported.
+    if (wallet->history_store_path.length)
+    {
+        if (wallet->history_store_dirty)
+            wallet_history_store_write(wallet);
+        if (!embed_history)
+            return;
+    }
+
     config_handle_t history_data = config_set_array(wallet_data, STRING_CONST("history"));
     for (size_t i = 0; i < array_size(wallet->history); ++i)
     {
@@ -785,6 +955,7 @@ void wallet_deallocate(wallet_t* wallet)
     }
     array_deallocate(wallet->history);
     array_deallocate(wallet->history_dates);
+    string_deallocate(wallet->history_store_path.str);
 
     foreach(f, wallet->funds)
         string_deallocate(f->currency);
@@ -811,38 +982,35 @@ double wallet_total_funds(wallet_t* wallet)
     return total;
 }
 
-void wallet_update_tracking_history(report_t* report, wallet_t* wallet)
+void wallet_history_record(report_t* report, wallet_t* wallet, time_t date)
 {
     FOUNDATION_ASSERT(report);
     FOUNDATION_ASSERT(wallet);
 
-    if (!wallet->track_history)
-        return;
-
-    if (time_is_weekend())
-        return;
+    string_const_t report_name = ::report_name(report);
+    string_const_t date_str = string_from_date(date);
 
-    // Check that we have an entry for today.
-    const time_t today = time_now();
+    // Update the entry of that day if any.
     foreach (h, wallet->history)
     {
-        if (!time_date_equal(today, h->date))
+        if (!time_date_equal(date, h->date))
             continue;
 
-        if (!time_is_working_hours())
-            return;
-
-        if (time_elapsed_days(h->date, today) < 0.1)
-            return; // Already up-to-date (or almost, lets retry later)
+        tr_info(HASH_REPORT, "Updating wallet history entry for {0} on {1}", report_name, date_str);
+        const bool most_recent = h == array_first(wallet->history);
+        wallet_history_update_entry(report, wallet, h, date);
+        wallet_history_prepare(wallet);
 
-        string_const_t report_name = ::report_name(report);
-        tr_info(HASH_REPORT, "Updating wallet history entry for {0} on {1}", report_name, string_from_date(today));
-        return wallet_history_update_entry(report, wallet, h);
+        // Only the most recent entry is the last stored record, others require the store to be rewritten.
+        if (!most_recent)
+            wallet->history_store_dirty = true;
+        wallet_history_store_append(wallet, *h, most_recent);
+        return;
     }
 
     // Add a new entry if none already
-    wallet_history_t new_entry{ today };
-    wallet_history_update_entry(report, wallet, &new_entry);
+    wallet_history_t new_entry{ date };
+    wallet_history_update_entry(report, wallet, &new_entry, date);
     if (array_size(wallet->history) > 0)
     {
         const wallet_history_t& fh = wallet->history[0];
@@ -853,11 +1021,43 @@ void wallet_update_tracking_history(report_t* report, wallet_t* wallet)
     array_push_memcpy(wallet->history, &new_entry);
     wallet_history_sort(wallet);
 
-    string_const_t report_name = ::report_name(report);
-    string_const_t date_str = string_from_date(new_entry.date);
+    // Appending a record is only possible if the new entry is the most recent one.
+    if (!time_date_equal(wallet->history[0].date, date))
+        wallet->history_store_dirty = true;
+    wallet_history_store_append(wallet, new_entry, false);
+
     tr_info(HASH_REPORT, "Added new wallet history entry for {0} on {1}", report_name, date_str);
 }
 
+void wallet_update_tracking_history(report_t* report, wallet_t* wallet)
+{
+    FOUNDATION_ASSERT(report);
+    FOUNDATION_ASSERT(wallet);
+
+    if (!wallet->track_history)
+        return;
+
+    if (time_is_weekend())
+        return;
+
+    // Check if we already have an entry for today.
+    const time_t today = time_now();
+    foreach (h, wallet->history)
+    {
+        if (!time_date_equal(today, h->date))
+            continue;
+
+        if (!time_is_working_hours())
+            return;
+
+        if (time_elapsed_days(h->date, today) < 0.1)
+            return; // Already up-to-date (or almost, lets retry later)
+        break;
+    }
+
+    wallet_history_record(report, wallet, today);
+}
+
 bool wallet_draw(wallet_t* wallet, float available_space)
 {
     bool updated = false;
@@ -30,6 +30,13 @@ struct wallet_history_t
     double other_assets{ 0 };
 
     wallet_t* source{ nullptr };
+
+    // Derived values prepared once by #wallet_history_prepare
+    double total_value_gain{ NAN };
+    double total_gain_p{ NAN };
+    double wealth{ NAN };
+    double change{ NAN };
+    double change_p{ NAN };
 };
 
 struct wallet_fund_t
@@ -65,7 +72,13 @@ struct wallet_t
     wallet_history_t* history{ nullptr };
     table_t* history_table{ nullptr };
     double* history_dates{ nullptr };
+    time_t history_min_date{ 0 };
+    time_t history_max_date{ 0 };
+    double history_day_space{ 1.0 };
     wallet_history_period_t history_period{ WALLET_HISTORY_ALL };
+
+    string_t history_store_path{};
+    bool history_store_dirty{ false };
 };
 
 /*! Draw the wallet table summary. 
@@ -84,8 +97,9 @@ void wallet_history_draw();
  * 
  *  @param[in] wallet The wallet to save.
  *  @param[in] wallet_data The config file to save to.
+ *  @param[in] embed_history True to also save the history entries in the config, i.e. when exporting the wallet.
  */
-void wallet_save(wallet_t* wallet, config_handle_t wallet_data);
+void wallet_save(wallet_t* wallet, config_handle_t wallet_data, bool embed_history = false);
 
 /*! Allocate a new wallet object. 
  * 
@@ -95,6 +109,23 @@ void wallet_save(wallet_t* wallet, config_handle_t wallet_data);
  */
 wallet_t* wallet_allocate(config_handle_t wallet_data);
 
+/*! Load the wallet history from its daily valuation store.
+ * 
+ *  History entries previously saved in the report config are migrated
+ *  to the store the first time it gets loaded.
+ * 
+ *  @param[in] wallet           The wallet to load the history for.
+ *  @param[in] store_name       Name of the store, usually the report unique identifier.
+ *  @param[in] store_name_length Length of the store name.
+ */
+void wallet_history_load(wallet_t* wallet, const char* store_name, size_t store_name_length);
+
+/*! Delete the wallet history store from disk, i.e. when the owning report is deleted. 
+ * 
+ *  @param[in] wallet The wallet owning the history store.
+ */
+void wallet_history_delete_store(wallet_t* wallet);
+
 /*! Deallocate a wallet object. 
  * 
  *  @param[in] wallet The wallet to deallocate.
@@ -111,6 +142,14 @@ void wallet_deallocate(wallet_t* wallet);
  */
 double wallet_total_funds(wallet_t* wallet);
 
+/*! Record the wallet valuation of a day in its history, replacing the entry of that day if any.
+ * 
+ *  @param[in] report The report owning the wallet.
+ *  @param[in] wallet The wallet to record the valuation for.
+ *  @param[in] date   Day of the entry.
+ */
+void wallet_history_record(report_t* report, wallet_t* wallet, time_t date);
+
 /*! Update the wallet history with the latest data. 
  * 
  *  @param[in] wallet The wallet to update the history for.
@@ -5,15 +5,53 @@
 
 #include "watches.h"
 
+#include "stock.h"
+
 #include <framework/app.h>
 #include <framework/array.h>
 #include <framework/memory.h>
 #include <framework/table.h>
 #include <framework/expr.h>
+#include <framework/jobs.h>
 #include <framework/session.h>
+#include <framework/profiler.h>
+
+#include <foundation/thread.h>
 
 #define HASH_WATCHES static_hash_string("watches", 7, 0xd9a79e530f96dc6cULL)
 
+struct watch_variable_dependency_t
+{
+    expr_var_t* var;
+    unsigned    version; // Version of the context variable last bound to var, or UINT32_MAX if never bound
+    string_t    text;    // Copy of the text value bound to var, owned by the program
+};
+
+struct watch_stock_dependency_t
+{
+    expr_t*               call; // S(...) or F(...) expression node
+    stock_handle_t        stock;
+    string_table_symbol_t field;
+    tick_t                last_update_time;
+};
+
+struct watch_program_t
+{
+    string_t                     source{};
+    expr_t*                      expr{ nullptr };
+    expr_var_list_t              vars{ nullptr };
+
+    watch_variable_dependency_t* variables{ nullptr };
+    watch_stock_dependency_t*    stocks{ nullptr };
+
+    bool                         dirty{ true };
+    job_t*                       job{ nullptr };
+
+    // Written by the evaluation job and collected on the main thread once the job completes.
+    watch_value_t                result{ WATCH_VALUE_UNDEFINED };
+    double                       elapsed_time{ 0 };
+};
+
 watch_context_t* _shared_context = nullptr;
 watch_context_t* _active_context = nullptr;
 
@@ -50,46 +88,246 @@ FOUNDATION_STATIC watch_point_t* watch_point_find(watch_context_t* context, cons
     return nullptr;
 }
 
-FOUNDATION_STATIC bool watch_point_evaluate(watch_context_t* context, watch_point_t* point, bool share = false)
+FOUNDATION_STATIC void watch_value_deallocate(watch_value_t& value)
 {
-    if (point->expression.length == 0)
-        return false;
-
-    for (unsigned i = 0, end = array_size(context->variables); i < end; ++i)
-    {
-        watch_variable_t* var = context->variables + i;
-        expr_result_t var_value = NIL;
-        if (var->value.type == WATCH_VALUE_TEXT)
-            var_value = expr_result_t(string_to_const(var->value.text));
-        else
-            var_value = expr_result_t(var->value.number);
-        expr_set_or_create_global_var(STRING_ARGS(var->name), var_value);
-    }
-
-    expr_result_t result = eval(point->expression.str, point->expression.length);
+    if (value.type == WATCH_VALUE_TEXT)
+        string_deallocate(value.text.str);
+    value.type = WATCH_VALUE_UNDEFINED;
+}
 
-    if (point->record.type == WATCH_VALUE_TEXT)
-        string_deallocate(point->record.text.str);
+FOUNDATION_STATIC void watch_value_set(watch_value_t& value, const expr_result_t& result)
+{
+    watch_value_deallocate(value);
 
-    if (point->type == WATCH_POINT_UNDEFINED)
-        point->type = WATCH_POINT_VALUE;
-        
     if (result.type == EXPR_RESULT_NULL)
     {
-        point->record.type = WATCH_VALUE_NULL;
+        value.type = WATCH_VALUE_NULL;
     }
     else if (result.type == EXPR_RESULT_NUMBER)
     {
-        point->record.type = WATCH_VALUE_NUMBER;
-        point->record.number = result.as_number();
+        value.type = WATCH_VALUE_NUMBER;
+        value.number = result.as_number();
     }
     else
     {
         string_const_t str = result.as_string();
-        point->record.type = WATCH_VALUE_TEXT;
-        point->record.text = string_clone(str.str, str.length);
+        value.type = WATCH_VALUE_TEXT;
+        value.text = string_clone(str.str, str.length);
+    }
+}
+
+FOUNDATION_STATIC void watch_value_copy(watch_value_t& dst, const watch_value_t& src)
+{
+    watch_value_deallocate(dst);
+
+    dst.type = src.type;
+    if (src.type == WATCH_VALUE_TEXT)
+        dst.text = string_clone(STRING_ARGS(src.text));
+    else
+        dst.number = src.number;
+}
+
+FOUNDATION_STATIC void watch_program_wait(watch_program_t* program)
+{
+    if (program->job == nullptr)
+        return;
+
+    job_wait(program->job);
+    job_deallocate(program->job);
+}
+
+FOUNDATION_STATIC void watch_program_deallocate(watch_program_t*& program)
+{
+    if (program == nullptr)
+        return;
+
+    watch_program_wait(program);
+
+    expr_compile_release(program->expr, &program->vars);
+    watch_value_deallocate(program->result);
+    foreach(dep, program->variables)
+        string_deallocate(dep->text.str);
+    array_deallocate(program->variables);
+    array_deallocate(program->stocks);
+    string_deallocate(program->source.str);
+
+    MEM_DELETE(program);
+    program = nullptr;
+}
+
+FOUNDATION_STATIC void watch_program_collect_stock_calls(watch_program_t* program, expr_t* e)
+{
+    if (e->type == OP_CONST || e->type == OP_VAR)
+        return;
+
+    if (e->type == OP_FUNC && e->args.len >= 2)
+    {
+        string_const_t fn_name = e->param.func.f->name;
+        if (string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("S")) || string_equal_nocase(STRING_ARGS(fn_name), STRING_CONST("F")))
+        {
+            watch_stock_dependency_t dep{ e };
+            array_push_memcpy(program->stocks, &dep);
+        }
+    }
+
+    for (int i = 0; i < e->args.len; ++i)
+        watch_program_collect_stock_calls(program, &e->args.buf[i]);
+}
+
+/*! Compile the watch point expression if it changed since it was last compiled.
+ *  
+ *  The compiled program keeps the variables and stock fields read by the expression 
+ *  so the watch point only gets evaluated again when one of them changes.
+ */
+FOUNDATION_STATIC watch_program_t* watch_point_compile(watch_point_t* point)
+{
+    if (point->program && string_equal(STRING_ARGS(point->program->source), STRING_ARGS(point->expression)))
+        return point->program;
+
+    watch_program_deallocate(point->program);
+
+    watch_program_t* program = MEM_NEW(HASH_WATCHES, watch_program_t);
+    program->source = string_clone(STRING_ARGS(point->expression));
+    program->expr = expr_compile(STRING_ARGS(program->source), &program->vars);
+
+    for (expr_var_t* v = program->vars.head; v; v = v->next)
+    {
+        watch_variable_dependency_t dep{ v, UINT32_MAX, {} };
+        array_push_memcpy(program->variables, &dep);
     }
 
+    if (program->expr)
+        watch_program_collect_stock_calls(program, program->expr);
+
+    point->program = program;
+    return program;
+}
+
+FOUNDATION_STATIC bool watch_program_is_dirty(watch_context_t* context, const watch_program_t* program)
+{
+    if (program->dirty)
+        return true;
+
+    for (unsigned i = 0, end = array_size(program->variables); i < end; ++i)
+    {
+        const watch_variable_dependency_t& dep = program->variables[i];
+        const watch_variable_t* var = watch_find_variable(context, STRING_ARGS(dep.var->name));
+        if (var && var->version != dep.version)
+            return true;
+    }
+
+    for (unsigned i = 0, end = array_size(program->stocks); i < end; ++i)
+    {
+        const watch_stock_dependency_t& dep = program->stocks[i];
+        const stock_t* s = dep.stock;
+        if (s && s->last_update_time != dep.last_update_time)
+            return true;
+    }
+
+    return false;
+}
+
+/*! Bind context variables to the compiled program variables and 
+ *  capture the stocks read by the expression. Must be called on the main thread
+ *  while no job evaluates the program.
+ * 
+ *  Bound values are copied in the program, so context variables can be changed
+ *  or removed while the program gets evaluated on a job thread.
+ */
+FOUNDATION_STATIC void watch_program_bind(watch_context_t* context, watch_program_t* program)
+{
+    FOUNDATION_ASSERT(program->job == nullptr);
+
+    for (unsigned i = 0, end = array_size(program->variables); i < end; ++i)
+    {
+        watch_variable_dependency_t& dep = program->variables[i];
+        const watch_variable_t* var = watch_find_variable(context, STRING_ARGS(dep.var->name));
+        if (var)
+        {
+            string_deallocate(dep.text.str);
+            dep.text = {};
+            if (var->value.type == WATCH_VALUE_TEXT)
+            {
+                dep.text = string_clone(STRING_ARGS(var->value.text));
+                dep.var->value = expr_result_t(string_to_const(dep.text));
+            }
+            else
+            {
+                dep.var->value = expr_result_t(var->value.number);
+            }
+            dep.version = var->version;
+        }
+        else
+        {
+            // Use application global variables as they are when the evaluation is scheduled.
+            // Only values that do not reference memory owned by someone else are bound.
+            const expr_result_t global_value = expr_get_global_var_value(STRING_ARGS(dep.var->name));
+            if (!global_value.is_null() && global_value.type != EXPR_RESULT_ARRAY && global_value.type != EXPR_RESULT_POINTER)
+                dep.var->value = global_value;
+        }
+    }
+
+    for (unsigned i = 0, end = array_size(program->stocks); i < end; ++i)
+    {
+        watch_stock_dependency_t& dep = program->stocks[i];
+        expr_t* symbol_arg = &dep.call->args.buf[0];
+        expr_t* field_arg = &dep.call->args.buf[1];
+
+        dep.stock = {};
+        dep.field = 0;
+        dep.last_update_time = 0;
+        if (symbol_arg->type != OP_CONST && symbol_arg->type != OP_VAR)
+            continue;
+
+        string_const_t symbol = expr_eval(symbol_arg).as_string();
+        if (symbol.length == 0)
+            continue;
+
+        dep.stock = stock_request(STRING_ARGS(symbol), FetchLevel::NONE);
+        if (field_arg->type == OP_CONST || field_arg->type == OP_VAR)
+            dep.field = string_table_encode(expr_eval(field_arg).as_string());
+
+        const stock_t* s = dep.stock;
+        if (s)
+            dep.last_update_time = s->last_update_time;
+    }
+
+    program->dirty = false;
+}
+
+/*! Evaluate a compiled program. Can be called from any thread, but only one thread at a time. */
+FOUNDATION_STATIC bool watch_program_evaluate(watch_program_t* program)
+{
+    const tick_t start_time = time_current();
+    expr_result_t result = expr_eval_compiled(program->expr, &program->vars, string_to_const(program->source));
+    watch_value_set(program->result, result);
+    program->elapsed_time = time_elapsed(start_time) * 1000.0;
+    return !result.is_null();
+}
+
+FOUNDATION_STATIC void watch_point_collect(watch_point_t* point)
+{
+    watch_program_t* program = point->program;
+    FOUNDATION_ASSERT(program && program->job == nullptr);
+
+    if (point->type == WATCH_POINT_UNDEFINED)
+        point->type = WATCH_POINT_VALUE;
+
+    watch_value_copy(point->record, program->result);
+    point->elapsed_time = program->elapsed_time;
+}
+
+FOUNDATION_STATIC bool watch_point_evaluate(watch_context_t* context, watch_point_t* point, bool share = false)
+{
+    if (point->expression.length == 0)
+        return false;
+
+    watch_program_t* program = watch_point_compile(point);
+    watch_program_wait(program);
+    watch_program_bind(context, program);
+    const bool valid = watch_program_evaluate(program);
+    watch_point_collect(point);
+
     // Update shared context with this watch point
     if (share && _shared_context)
     { 
@@ -109,7 +347,48 @@ FOUNDATION_STATIC bool watch_point_evaluate(watch_context_t* context, watch_poin
         }
     }
 
-    return !result.is_null();
+    return valid;
+}
+
+FOUNDATION_STATIC int watch_program_evaluate_job(payload_t* payload)
+{
+    watch_program_t* program = (watch_program_t*)payload;
+    return watch_program_evaluate(program) ? 0 : 1;
+}
+
+/*! Collect completed evaluations and schedule the evaluation of dirty watch points on the job pool.
+ *  Plot and table watch points are still only evaluated on demand on the main thread.
+ */
+FOUNDATION_STATIC void watch_context_update(watch_context_t* context)
+{
+    PERFORMANCE_TRACKER("watch_context_update");
+
+    for (unsigned i = 0, end = array_size(context->points); i < end; ++i)
+    {
+        watch_point_t* point = context->points + i;
+        if (point->expression.length == 0)
+            continue;
+
+        if (point->type != WATCH_POINT_UNDEFINED && point->type != WATCH_POINT_VALUE &&
+            point->type != WATCH_POINT_DATE && point->type != WATCH_POINT_INTEGER)
+            continue;
+
+        watch_program_t* program = watch_point_compile(point);
+        if (program->job)
+        {
+            if (!job_completed(program->job))
+                continue;
+
+            job_deallocate(program->job);
+            watch_point_collect(point);
+        }
+
+        if (!watch_program_is_dirty(context, program))
+            continue;
+
+        watch_program_bind(context, program);
+        program->job = job_execute(watch_program_evaluate_job, program);
+    }
 }
 
 FOUNDATION_STATIC const char* watch_point_format_string(watch_point_type_t type)
@@ -255,12 +534,9 @@ FOUNDATION_STATIC table_cell_t watch_point_column_value(table_element_ptr_t elem
 
     if (point->type == WATCH_POINT_VALUE)
     {
+        // Value is still being evaluated
         if (point->record.type == WATCH_VALUE_UNDEFINED)
-        {
-            if (!watch_point_evaluate(point->context, point))
-                return nullptr;
-            FOUNDATION_ASSERT(point->record.type != WATCH_VALUE_UNDEFINED);
-        }
+            return nullptr;
 
         if (column->flags & COLUMN_RENDER_ELEMENT)
         {
@@ -300,12 +576,9 @@ FOUNDATION_STATIC table_cell_t watch_point_column_value(table_element_ptr_t elem
     }
     else if (point->type == WATCH_POINT_DATE)
     {
+        // Value is still being evaluated
         if (point->record.type == WATCH_VALUE_UNDEFINED)
-        {
-            if (!watch_point_evaluate(point->context, point))
-                return nullptr;
-            FOUNDATION_ASSERT(point->record.type != WATCH_VALUE_UNDEFINED);
-        }
+            return nullptr;
 
         if (column->flags & COLUMN_RENDER_ELEMENT)
         {
@@ -317,12 +590,9 @@ FOUNDATION_STATIC table_cell_t watch_point_column_value(table_element_ptr_t elem
     }
     else if (point->type == WATCH_POINT_INTEGER)
     {
+        // Value is still being evaluated
         if (point->record.type == WATCH_VALUE_UNDEFINED)
-        {
-            if (!watch_point_evaluate(point->context, point))
-                return nullptr;
-            FOUNDATION_ASSERT(point->record.type != WATCH_VALUE_UNDEFINED);
-        }
+            return nullptr;
 
         if (column->flags & COLUMN_RENDER_ELEMENT)
             ImGui::Text("%.0lf", point->record.number);
@@ -338,10 +608,19 @@ FOUNDATION_STATIC table_cell_t watch_point_column_value(table_element_ptr_t elem
     return nullptr;
 }
 
+FOUNDATION_STATIC table_cell_t watch_point_column_elapsed_time(table_element_ptr_t element, const table_column_t* column)
+{
+    watch_point_t* point = (watch_point_t*)element;
+    if (point->record.type == WATCH_VALUE_UNDEFINED)
+        return nullptr;
+
+    return point->elapsed_time;
+}
+
 FOUNDATION_STATIC void watch_point_deallocate(watch_point_t* w)
 {
-    if (w->record.type == WATCH_VALUE_TEXT)
-        string_deallocate(w->record.text.str);
+    watch_program_deallocate(w->program);
+    watch_value_deallocate(w->record);
             
     memory_deallocate(w->expression_edit_buffer);
     string_deallocate(w->expression.str);
@@ -437,6 +716,8 @@ FOUNDATION_STATIC table_t* watch_create_table(watch_context_t*)
 
     table_add_column(table, watch_point_column_name, "Name", COLUMN_FORMAT_TEXT, COLUMN_SORTABLE | COLUMN_SEARCHABLE);
     table_add_column(table, watch_point_column_value, "Value", COLUMN_FORMAT_TEXT, COLUMN_SORTABLE | COLUMN_SEARCHABLE | COLUMN_CUSTOM_DRAWING);
+    table_add_column(table, watch_point_column_elapsed_time, ICON_MD_TIMER "||Evaluation Time (ms)", COLUMN_FORMAT_NUMBER, COLUMN_SORTABLE | COLUMN_ZERO_USE_DASH)
+        .set_width(IM_SCALEF(50));
     table_add_column(table, watch_point_column_edit_expression, ICON_MD_FUNCTIONS "||Edit Expression", COLUMN_FORMAT_NUMBER, COLUMN_SORTABLE | COLUMN_CUSTOM_DRAWING | COLUMN_CENTER_ALIGN)
         .set_width(IM_SCALEF(20));
 
@@ -565,6 +846,7 @@ void watches_render(watch_context_t* context)
         context->table = watch_create_table(context);
 
     watch_render_new_point(context);
+    watch_context_update(context);
 
     _active_context = context;
     table_render(
@@ -585,11 +867,15 @@ void watch_set_variable(watch_context_t* context, const char* name, size_t name_
     watch_variable_t* var = watch_find_variable(context, name, name_length);
     if (var)
     {
+        if (var->value.type == WATCH_VALUE_NUMBER && var->value.number == number)
+            return;
+
         if (var->value.type == WATCH_VALUE_TEXT)
             string_deallocate(var->value.text.str);
 
         var->value.type = WATCH_VALUE_NUMBER;
         var->value.number = (double)number;
+        var->version++;
     }
     else
     {
@@ -597,6 +883,7 @@ void watch_set_variable(watch_context_t* context, const char* name, size_t name_
         new_var.name = string_clone(name, name_length);
         new_var.value.type = WATCH_VALUE_NUMBER;
         new_var.value.number = (double)number;
+        new_var.version = 0;
         array_push_memcpy(context->variables, &new_var);
     }
 }
@@ -617,6 +904,8 @@ void watch_point_add(watch_context_t* context,
     new_point.context = context;
     new_point.expression_edit_buffer = nullptr;
     new_point.expression_edit_buffer_size = 0;
+    new_point.program = nullptr;
+    new_point.elapsed_time = 0;
 
     if (new_point.expression.length > 0)
     {
@@ -637,11 +926,15 @@ void watch_set_variable(watch_context_t* context, const char* name, size_t name_
     watch_variable_t* var = watch_find_variable(context, name, name_length);
     if (var)
     {
+        if (var->value.type == WATCH_VALUE_DATE && var->value.number == (double)date)
+            return;
+
         if (var->value.type == WATCH_VALUE_TEXT)
             string_deallocate(var->value.text.str);
 
         var->value.type = WATCH_VALUE_DATE;
         var->value.number = (double)date;
+        var->version++;
     }
     else
     {
@@ -649,6 +942,7 @@ void watch_set_variable(watch_context_t* context, const char* name, size_t name_
         new_var.name = string_clone(name, name_length);
         new_var.value.type = WATCH_VALUE_DATE;
         new_var.value.number = (double)date;
+        new_var.version = 0;
         array_push_memcpy(context->variables, &new_var);
     }
 }
@@ -661,10 +955,15 @@ void watch_set_variable(watch_context_t* context, const char* name, size_t name_
     if (var)
     {
         if (var->value.type == WATCH_VALUE_TEXT)
+        {
+            if (string_equal(STRING_ARGS(var->value.text), value, value_length))
+                return;
             string_deallocate(var->value.text.str);
+        }
 
         var->value.type = WATCH_VALUE_TEXT;
         var->value.text = string_clone(value, value_length);
+        var->version++;
     }
     else
     {
@@ -672,6 +971,7 @@ void watch_set_variable(watch_context_t* context, const char* name, size_t name_
         new_var.name = string_clone(name, name_length);
         new_var.value.type = WATCH_VALUE_TEXT;
         new_var.value.text = string_clone(value, value_length);
+        new_var.version = 0;
         array_push_memcpy(context->variables, &new_var);
     }
 }
@@ -692,6 +992,8 @@ void watch_load(watch_context_t* context, config_handle_t data)
         p.context = context;
         p.expression_edit_buffer = nullptr;
         p.expression_edit_buffer_size = 0;
+        p.program = nullptr;
+        p.elapsed_time = 0;
 
         array_push_memcpy(context->points, &p);
     }
@@ -46,6 +46,7 @@ struct watch_value_t
 };
 
 struct watch_context_t;
+struct watch_program_t;
 struct watch_point_t
 {
     string_t             name;
@@ -57,6 +58,9 @@ struct watch_point_t
     char*                expression_edit_buffer;
     size_t               expression_edit_buffer_size;
 
+    watch_program_t*     program;      // Compiled expression and dependencies of the watch point
+    double               elapsed_time; // Last evaluation time in milliseconds
+
     char                 name_buffer[64];
 };
 
@@ -64,6 +68,7 @@ struct watch_variable_t
 {
     string_t           name;
     watch_value_t      value;
+    unsigned           version; // Incremented each time the value changes
 };
 
 struct watch_context_t